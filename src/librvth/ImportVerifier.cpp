@@ -0,0 +1,343 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * ImportVerifier.cpp: Read-back verification for imported disc images.    *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "ImportVerifier.hpp"
+
+#include "nhcd_structs.h"
+#include "RefFile.hpp"
+#include "reader/Reader.hpp"
+
+// zlib
+#include <zlib.h>
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+
+// C++ includes.
+#include <algorithm>
+using std::vector;
+
+// Read buffer size for the verification thread. (1 MiB)
+#define VERIFY_BUF_SIZE (1024U*1024U)
+#define VERIFY_BUF_LBA BYTES_TO_LBA(VERIFY_BUF_SIZE)
+
+/**
+ * Calculate the CRC32 of a block.
+ * @param data Block data. (If NULL, the block is all zeroes.)
+ * @param lba_len Length of the block, in LBAs.
+ * @return CRC32.
+ */
+static inline uint32_t block_crc32(const uint8_t *data, uint32_t lba_len)
+{
+	static const uint8_t zero_buf[LBA_TO_BYTES(RVTH_VERIFY_BLOCK_LBA)] = { 0 };
+	assert(lba_len <= RVTH_VERIFY_BLOCK_LBA);
+	return static_cast<uint32_t>(crc32(crc32(0, nullptr, 0),
+		(data ? data : zero_buf), static_cast<uInt>(LBA_TO_BYTES(lba_len))));
+}
+
+/**
+ * Create a read-back verifier.
+ * The verification thread isn't started until start() is called.
+ * @param filename	[in] Destination filename. (RVT-H device or disk image)
+ * @param lba_start	[in] Starting LBA of the destination bank.
+ * @param lba_len	[in] Number of LBAs being written.
+ */
+ImportVerifier::ImportVerifier(const TCHAR *filename, uint32_t lba_start, uint32_t lba_len)
+	: m_filename(filename)
+	, m_file(nullptr)
+	, m_lba_start(lba_start)
+	, m_lba_len(lba_len)
+	, m_buf(nullptr)
+	, m_running(false)
+	, m_lba_written(0)
+	, m_lba_committed(0)
+	, m_lba_verified(0)
+	, m_stop(false)
+	, m_cancel(false)
+{ }
+
+ImportVerifier::~ImportVerifier()
+{
+	cancel();
+	free(m_buf);
+	if (m_file) {
+		m_file->unref();
+	}
+}
+
+/**
+ * Open the destination for reading and start the verification thread.
+ * @param lba_first	[in] First LBA that will be written. (Must be block-aligned.)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ImportVerifier::start(uint32_t lba_first)
+{
+	assert(!m_file);
+	assert(lba_first % RVTH_VERIFY_BLOCK_LBA == 0);
+	if (m_file) {
+		// Already started.
+		return -EBUSY;
+	}
+
+	// Open a separate handle for reading so the
+	// writer's file position isn't affected.
+	m_file = new RefFile(m_filename.c_str());
+	if (!m_file->isOpen()) {
+		int err = m_file->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		m_file->unref();
+		m_file = nullptr;
+		return -err;
+	}
+
+	m_buf = static_cast<uint8_t*>(malloc(VERIFY_BUF_SIZE));
+	if (!m_buf) {
+		return -ENOMEM;
+	}
+	m_crcs.resize((m_lba_len + RVTH_VERIFY_BLOCK_LBA - 1) / RVTH_VERIFY_BLOCK_LBA);
+
+	m_lba_written = lba_first;
+	m_lba_committed = lba_first;
+	m_lba_verified = lba_first;
+
+	// Start the verification thread.
+	int ret = threadw_mutex_init(&m_mutex);
+	if (ret != 0) {
+		return ret;
+	}
+	ret = threadw_event_init(&m_event);
+	if (ret != 0) {
+		threadw_mutex_destroy(&m_mutex);
+		return ret;
+	}
+	ret = threadw_thread_create(&m_thread, runThread, this);
+	if (ret != 0) {
+		// Unable to start the verification thread.
+		threadw_event_destroy(&m_event);
+		threadw_mutex_destroy(&m_mutex);
+		return ret;
+	}
+	m_running = true;
+	return 0;
+}
+
+/**
+ * Record a chunk that was written to the destination.
+ * Chunks must be written sequentially.
+ * @param reader_dest	[in] Destination disc image reader. (Synced before verifying.)
+ * @param lba_start	[in] Starting LBA of the chunk. (Must be block-aligned.)
+ * @param data		[in] Chunk data as written to the destination. (If NULL, the chunk is all zeroes.)
+ * @param lba_len	[in] Length of the chunk, in LBAs.
+ * @return 0 on success; negative POSIX error code if the destination couldn't be synced.
+ */
+int ImportVerifier::addChunk(Reader *reader_dest, uint32_t lba_start, const uint8_t *data, uint32_t lba_len)
+{
+	assert(lba_start == m_lba_written);
+	assert(lba_start % RVTH_VERIFY_BLOCK_LBA == 0);
+	assert(lba_len <= m_lba_len - lba_start);
+	if (lba_start != m_lba_written || lba_len > m_lba_len - lba_start) {
+		// Not sequential, or out of range.
+		return -EINVAL;
+	}
+
+	for (uint32_t lba = 0; lba < lba_len; lba += RVTH_VERIFY_BLOCK_LBA) {
+		const uint32_t block_len = std::min(RVTH_VERIFY_BLOCK_LBA, lba_len - lba);
+		m_crcs[(lba_start + lba) / RVTH_VERIFY_BLOCK_LBA] =
+			block_crc32((data ? &data[LBA_TO_BYTES(lba)] : nullptr), block_len);
+	}
+	m_lba_written = lba_start + lba_len;
+
+	// NOTE: m_lba_committed is only modified on this thread.
+	if (m_lba_written - m_lba_committed >= RVTH_VERIFY_COMMIT_LBA) {
+		return commit(reader_dest, m_lba_written);
+	}
+	return 0;
+}
+
+/**
+ * Hand the written data to the verification thread.
+ * @param reader_dest	[in] Destination disc image reader.
+ * @param lba_end	[in] End of the written data.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ImportVerifier::commit(Reader *reader_dest, uint32_t lba_end)
+{
+	// The data has to be on the device before it can be
+	// read back. Otherwise, it would be read from the cache.
+	int ret = reader_dest->file()->sync();
+	if (ret != 0) {
+		return ret;
+	}
+
+	threadw_mutex_lock(&m_mutex);
+	m_lba_committed = lba_end;
+	threadw_mutex_unlock(&m_mutex);
+	threadw_event_set(&m_event);
+	return 0;
+}
+
+/**
+ * Verify the rest of the written data and stop the verification thread.
+ * @param reader_dest	[in] Destination disc image reader. (Synced before verifying.)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ImportVerifier::finish(Reader *reader_dest)
+{
+	if (!m_running) {
+		// Verification thread isn't running.
+		return -EBADF;
+	}
+
+	int ret = 0;
+	if (m_lba_written > m_lba_committed) {
+		ret = commit(reader_dest, m_lba_written);
+		if (ret != 0) {
+			cancel();
+			return ret;
+		}
+	}
+
+	stop(false);
+	return ret;
+}
+
+/**
+ * Stop the verification thread without verifying the rest of the data.
+ */
+void ImportVerifier::cancel(void)
+{
+	if (!m_running) {
+		// Verification thread isn't running.
+		return;
+	}
+	stop(true);
+}
+
+/**
+ * Signal the verification thread to stop and wait for it.
+ * @param cancel	[in] If true, stop immediately; otherwise, verify all committed data first.
+ */
+void ImportVerifier::stop(bool cancel)
+{
+	assert(m_running);
+	threadw_mutex_lock(&m_mutex);
+	if (cancel) {
+		m_cancel = true;
+	} else {
+		m_stop = true;
+	}
+	threadw_mutex_unlock(&m_mutex);
+	threadw_event_set(&m_event);
+
+	threadw_thread_join(m_thread);
+	threadw_event_destroy(&m_event);
+	threadw_mutex_destroy(&m_mutex);
+	m_running = false;
+}
+
+/**
+ * Verify a range of blocks.
+ * Called on the verification thread.
+ * @param lba_start	[in] Starting LBA. (Must be block-aligned.)
+ * @param lba_end	[in] Ending LBA.
+ */
+void ImportVerifier::verifyRange(uint32_t lba_start, uint32_t lba_end)
+{
+	assert(lba_start % RVTH_VERIFY_BLOCK_LBA == 0);
+	for (uint32_t lba = lba_start; lba < lba_end && !m_cancel; lba += VERIFY_BUF_LBA) {
+		const uint32_t lba_count = std::min(VERIFY_BUF_LBA, lba_end - lba);
+		const int64_t offset = LBA_TO_BYTES(m_lba_start + lba);
+		const size_t size = static_cast<size_t>(LBA_TO_BYTES(lba_count));
+
+		// Make sure the data is read from the device.
+		m_file->dropCache(offset, size);
+		if (m_file->seekoAndRead(offset, SEEK_SET, m_buf, 1, size) != size) {
+			// Data that can't be read back is reported as a mismatch.
+			addError(lba, lba_count);
+			continue;
+		}
+
+		for (uint32_t i = 0; i < lba_count; i += RVTH_VERIFY_BLOCK_LBA) {
+			const uint32_t block_len = std::min(RVTH_VERIFY_BLOCK_LBA, lba_count - i);
+			if (block_crc32(&m_buf[LBA_TO_BYTES(i)], block_len) !=
+			    m_crcs[(lba + i) / RVTH_VERIFY_BLOCK_LBA])
+			{
+				addError(lba + i, block_len);
+			}
+		}
+	}
+}
+
+/**
+ * Add a range of LBAs to the error list.
+ * Called on the verification thread.
+ * Adjacent ranges are merged.
+ * @param lba_start	[in] Starting LBA.
+ * @param lba_len	[in] Length, in LBAs.
+ */
+void ImportVerifier::addError(uint32_t lba_start, uint32_t lba_len)
+{
+	if (!m_errors.empty()) {
+		RvtH_VerifyError &last = m_errors.back();
+		if (last.lba_start + last.lba_len == lba_start) {
+			// Extend the previous range.
+			last.lba_len += lba_len;
+			return;
+		}
+	}
+
+	RvtH_VerifyError error;
+	error.lba_start = lba_start;
+	error.lba_len = lba_len;
+	m_errors.push_back(error);
+}
+
+/**
+ * Verification thread.
+ */
+void ImportVerifier::run(void)
+{
+	for (;;) {
+		threadw_mutex_lock(&m_mutex);
+		const bool stop = m_stop;
+		const uint32_t lba_start = m_lba_verified;
+		const uint32_t lba_end = m_lba_committed;
+		threadw_mutex_unlock(&m_mutex);
+
+		if (m_cancel || (stop && lba_start == lba_end)) {
+			// Finished.
+			break;
+		} else if (lba_start == lba_end) {
+			// Wait for more data to be committed.
+			threadw_event_wait(&m_event);
+			continue;
+		}
+
+		// Verify the newly-committed data without holding the lock,
+		// so the writer can keep going.
+		verifyRange(lba_start, lba_end);
+		threadw_mutex_lock(&m_mutex);
+		m_lba_verified = lba_end;
+		threadw_mutex_unlock(&m_mutex);
+	}
+}
+
+/**
+ * Verification thread entry point.
+ * @param userdata	[in] ImportVerifier
+ */
+void ImportVerifier::runThread(void *userdata)
+{
+	static_cast<ImportVerifier*>(userdata)->run();
+}
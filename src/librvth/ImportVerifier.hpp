@@ -0,0 +1,181 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * ImportVerifier.hpp: Read-back verification for imported disc images.    *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_IMPORTVERIFIER_HPP__
+#define __RVTHTOOL_LIBRVTH_IMPORTVERIFIER_HPP__
+
+#include "rvth.hpp"
+
+// C includes.
+#include <stdint.h>
+
+// C++ includes.
+#include <atomic>
+#include <string>
+#include <vector>
+
+// libwiicrypto
+#include "libwiicrypto/threadw.h"
+
+class RefFile;
+class Reader;
+
+// Verification block size, in LBAs. (32 KiB)
+// Mismatches are reported with this granularity.
+#define RVTH_VERIFY_BLOCK_LBA		64U
+
+// Written data is handed to the verification thread after
+// every 32 MiB, so verification runs 32-64 MiB behind the writer.
+#define RVTH_VERIFY_COMMIT_LBA		BYTES_TO_LBA(32U*1024U*1024U)
+
+/**
+ * Read-back verification for imported disc images.
+ *
+ * A CRC32 of each block is recorded as it's written. A separate
+ * thread reads the blocks back from the destination a fixed
+ * distance behind the writer and compares them against the
+ * recorded CRC32s, so verification overlaps with writing.
+ *
+ * The destination is opened separately for reading, and its
+ * cached data is dropped before reading, so the data actually
+ * has to come back from the device.
+ */
+class ImportVerifier
+{
+	public:
+		/**
+		 * Create a read-back verifier.
+		 * The verification thread isn't started until start() is called.
+		 * @param filename	[in] Destination filename. (RVT-H device or disk image)
+		 * @param lba_start	[in] Starting LBA of the destination bank.
+		 * @param lba_len	[in] Number of LBAs being written.
+		 */
+		ImportVerifier(const TCHAR *filename, uint32_t lba_start, uint32_t lba_len);
+		~ImportVerifier();
+
+	private:
+		DISABLE_COPY(ImportVerifier)
+
+	public:
+		/**
+		 * Open the destination for reading and start the verification thread.
+		 * @param lba_first	[in] First LBA that will be written. (Must be block-aligned.)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int start(uint32_t lba_first = 0);
+
+		/**
+		 * Record a chunk that was written to the destination.
+		 * Chunks must be written sequentially.
+		 * @param reader_dest	[in] Destination disc image reader. (Synced before verifying.)
+		 * @param lba_start	[in] Starting LBA of the chunk. (Must be block-aligned.)
+		 * @param data		[in] Chunk data as written to the destination. (If NULL, the chunk is all zeroes.)
+		 * @param lba_len	[in] Length of the chunk, in LBAs.
+		 * @return 0 on success; negative POSIX error code if the destination couldn't be synced.
+		 */
+		int addChunk(Reader *reader_dest, uint32_t lba_start, const uint8_t *data, uint32_t lba_len);
+
+		/**
+		 * Verify the rest of the written data and stop the verification thread.
+		 * @param reader_dest	[in] Destination disc image reader. (Synced before verifying.)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int finish(Reader *reader_dest);
+
+		/**
+		 * Stop the verification thread without verifying the rest of the data.
+		 */
+		void cancel(void);
+
+		/**
+		 * Get the ranges of LBAs that didn't match.
+		 * Only valid after finish() has returned.
+		 * LBAs are relative to the start of the bank.
+		 * @return Mismatched LBA ranges, sorted by LBA.
+		 */
+		inline const std::vector<RvtH_VerifyError> &errors(void) const
+		{
+			return m_errors;
+		}
+
+	private:
+		/**
+		 * Hand the written data to the verification thread.
+		 * @param reader_dest	[in] Destination disc image reader.
+		 * @param lba_end	[in] End of the written data.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int commit(Reader *reader_dest, uint32_t lba_end);
+
+		/**
+		 * Verify a range of blocks.
+		 * Called on the verification thread.
+		 * @param lba_start	[in] Starting LBA. (Must be block-aligned.)
+		 * @param lba_end	[in] Ending LBA.
+		 */
+		void verifyRange(uint32_t lba_start, uint32_t lba_end);
+
+		/**
+		 * Add a range of LBAs to the error list.
+		 * Called on the verification thread.
+		 * Adjacent ranges are merged.
+		 * @param lba_start	[in] Starting LBA.
+		 * @param lba_len	[in] Length, in LBAs.
+		 */
+		void addError(uint32_t lba_start, uint32_t lba_len);
+
+		/**
+		 * Signal the verification thread to stop and wait for it.
+		 * @param cancel	[in] If true, stop immediately; otherwise, verify all committed data first.
+		 */
+		void stop(bool cancel);
+
+		/**
+		 * Verification thread.
+		 */
+		void run(void);
+
+		/**
+		 * Verification thread entry point.
+		 * @param userdata	[in] ImportVerifier
+		 */
+		static void runThread(void *userdata);
+
+	private:
+		std::tstring m_filename;
+		RefFile *m_file;		// Destination, opened for reading.
+		uint32_t m_lba_start;		// Starting LBA of the destination bank.
+		uint32_t m_lba_len;		// Number of LBAs being written.
+		uint8_t *m_buf;			// Read buffer for the verification thread.
+
+		// CRC32 of each block, as written. (host-endian)
+		// Each entry is written before its block is committed,
+		// and isn't modified afterwards.
+		std::vector<uint32_t> m_crcs;
+
+		// Mismatched LBA ranges.
+		// Only accessed by the verification thread until it stops.
+		std::vector<RvtH_VerifyError> m_errors;
+
+		// Verification thread state.
+		// NOTE: threadw is used instead of std::thread so this
+		// works on the same Windows versions as the rest of the
+		// program. m_mutex protects the fields below, and m_event
+		// is set after changing them to wake up the thread.
+		threadw_thread_t m_thread;
+		threadw_mutex_t m_mutex;
+		threadw_event_t m_event;
+		bool m_running;			// True if the verification thread is running.
+		uint32_t m_lba_written;		// End of the written data. (writer only)
+		uint32_t m_lba_committed;	// End of the data that can be verified.
+		uint32_t m_lba_verified;	// End of the verified data.
+		bool m_stop;			// Stop once all committed data has been verified.
+		std::atomic<bool> m_cancel;	// Stop immediately.
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_IMPORTVERIFIER_HPP__ */
@@ -0,0 +1,98 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * ProgressSink.cpp: Lock-free progress reporting and cancellation.        *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "ProgressSink.hpp"
+
+// C++ includes.
+#include <chrono>
+using std::chrono::steady_clock;
+
+ProgressSink::ProgressSink()
+	: m_generation(0)
+	, m_type(RVTH_PROGRESS_UNKNOWN)
+	, m_lba_processed(0)
+	, m_lba_total(0)
+	, m_bytes_read(0)
+	, m_bytes_written(0)
+	, m_bytes_skipped(0)
+	, m_bytes_hashed(0)
+	, m_start_time(0)
+	, m_cancel(false)
+{ }
+
+/**
+ * Start a new operation.
+ * The counters are reset. Cancellation isn't reset.
+ * @param type		[in] Progress type.
+ * @param lba_total	[in] Total number of LBAs.
+ */
+void ProgressSink::begin(RvtH_Progress_Type type, uint32_t lba_total)
+{
+	// Mark the counters as being reset.
+	m_generation.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	m_type.store(type, std::memory_order_relaxed);
+	m_lba_processed.store(0, std::memory_order_relaxed);
+	m_lba_total.store(lba_total, std::memory_order_relaxed);
+	m_bytes_read.store(0, std::memory_order_relaxed);
+	m_bytes_written.store(0, std::memory_order_relaxed);
+	m_bytes_skipped.store(0, std::memory_order_relaxed);
+	m_bytes_hashed.store(0, std::memory_order_relaxed);
+	m_start_time.store(steady_clock::now().time_since_epoch().count(),
+		std::memory_order_relaxed);
+
+	// The counters are valid once the UI sees the new generation.
+	m_generation.fetch_add(1, std::memory_order_release);
+}
+
+/**
+ * Get a snapshot of the current progress.
+ * This may be called from any thread.
+ * @param snapshot	[out] Progress snapshot.
+ */
+void ProgressSink::snapshot(RvtH_Progress_Snapshot *snapshot) const
+{
+	// Retry if begin() resets the counters while they're being read.
+	// Otherwise, counters from two different operations could be mixed.
+	uint32_t generation;
+	int64_t start_time = 0;
+	do {
+		generation = m_generation.load(std::memory_order_acquire);
+		if (generation & 1) {
+			// begin() is resetting the counters.
+			continue;
+		}
+
+		snapshot->type = static_cast<RvtH_Progress_Type>(m_type.load(std::memory_order_relaxed));
+		snapshot->lba_processed = m_lba_processed.load(std::memory_order_relaxed);
+		snapshot->lba_total = m_lba_total.load(std::memory_order_relaxed);
+		snapshot->bytes_read = m_bytes_read.load(std::memory_order_relaxed);
+		snapshot->bytes_written = m_bytes_written.load(std::memory_order_relaxed);
+		snapshot->bytes_skipped = m_bytes_skipped.load(std::memory_order_relaxed);
+		snapshot->bytes_hashed = m_bytes_hashed.load(std::memory_order_relaxed);
+		start_time = m_start_time.load(std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((generation & 1) || m_generation.load(std::memory_order_relaxed) != generation);
+
+	snapshot->elapsed_ms = 0;
+	snapshot->throughput = 0;
+	if (snapshot->type == RVTH_PROGRESS_UNKNOWN) {
+		// Not started yet.
+		return;
+	}
+
+	const steady_clock::duration elapsed = steady_clock::now().time_since_epoch() -
+		steady_clock::duration(start_time);
+	const int64_t elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count();
+	if (elapsed_ms > 0) {
+		snapshot->elapsed_ms = static_cast<uint64_t>(elapsed_ms);
+		snapshot->throughput = (snapshot->bytes_read + snapshot->bytes_skipped) * 1000 / snapshot->elapsed_ms;
+	}
+}
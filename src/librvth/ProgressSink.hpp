@@ -0,0 +1,168 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * ProgressSink.hpp: Lock-free progress reporting and cancellation.        *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_PROGRESSSINK_HPP__
+#define __RVTHTOOL_LIBRVTH_PROGRESSSINK_HPP__
+
+#include "rvth.hpp"
+
+// C includes.
+#include <stdint.h>
+
+// C++ includes.
+#include <atomic>
+
+// Snapshot of a ProgressSink, for display.
+typedef struct _RvtH_Progress_Snapshot {
+	RvtH_Progress_Type type;	// Progress type. (RVTH_PROGRESS_UNKNOWN if not started)
+	uint32_t lba_processed;		// LBAs processed.
+	uint32_t lba_total;		// Total number of LBAs.
+
+	uint64_t bytes_read;		// Bytes read from the source.
+	uint64_t bytes_written;		// Bytes written to the destination.
+	uint64_t bytes_skipped;		// Bytes skipped. (holes in the source)
+	uint64_t bytes_hashed;		// Bytes hashed. (Wii encryption and import verification)
+
+	uint64_t elapsed_ms;		// Time since the operation started, in milliseconds.
+	uint64_t throughput;		// Source bytes processed per second. (read + skipped)
+} RvtH_Progress_Snapshot;
+
+/**
+ * Lock-free progress reporting and cancellation.
+ *
+ * Set a ProgressSink on an RvtH object using RvtH::setProgressSink().
+ * The copy loops update the counters using relaxed atomic operations
+ * and check the cancellation flag, so they never wait on the UI.
+ * The UI polls the counters at its own rate using snapshot().
+ *
+ * A single ProgressSink can be shared by multiple threads.
+ * The counters are only approximately consistent with each other,
+ * but a snapshot never mixes counters from two different operations.
+ */
+class ProgressSink
+{
+	public:
+		ProgressSink();
+
+	private:
+		DISABLE_COPY(ProgressSink)
+
+	public:
+		/** Worker functions **/
+
+		/**
+		 * Start a new operation.
+		 * The counters are reset. Cancellation isn't reset.
+		 * @param type		[in] Progress type.
+		 * @param lba_total	[in] Total number of LBAs.
+		 */
+		void begin(RvtH_Progress_Type type, uint32_t lba_total);
+
+		/**
+		 * Update the number of LBAs processed.
+		 * @param lba_processed	[in] Number of LBAs processed.
+		 * @return True to continue; false if the operation was cancelled.
+		 */
+		inline bool update(uint32_t lba_processed)
+		{
+			m_lba_processed.store(lba_processed, std::memory_order_relaxed);
+			return !m_cancel.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * Add bytes read from the source.
+		 * @param bytes	[in] Number of bytes.
+		 */
+		inline void addRead(uint64_t bytes)
+		{
+			m_bytes_read.fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Add bytes written to the destination.
+		 * @param bytes	[in] Number of bytes.
+		 */
+		inline void addWritten(uint64_t bytes)
+		{
+			m_bytes_written.fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Add bytes that were skipped without being read.
+		 * @param bytes	[in] Number of bytes.
+		 */
+		inline void addSkipped(uint64_t bytes)
+		{
+			m_bytes_skipped.fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Add bytes that were hashed.
+		 * @param bytes	[in] Number of bytes.
+		 */
+		inline void addHashed(uint64_t bytes)
+		{
+			m_bytes_hashed.fetch_add(bytes, std::memory_order_relaxed);
+		}
+
+	public:
+		/** Cancellation **/
+
+		/**
+		 * Cancel the operation.
+		 * The copy loops stop at the next update() and return -ECANCELED.
+		 * This may be called from any thread.
+		 */
+		inline void cancel(void)
+		{
+			m_cancel.store(true, std::memory_order_relaxed);
+		}
+
+		/**
+		 * Has the operation been cancelled?
+		 * @return True if cancelled.
+		 */
+		inline bool isCancelled(void) const
+		{
+			return m_cancel.load(std::memory_order_relaxed);
+		}
+
+	public:
+		/** UI functions **/
+
+		/**
+		 * Get a snapshot of the current progress.
+		 * This may be called from any thread.
+		 * @param snapshot	[out] Progress snapshot.
+		 */
+		void snapshot(RvtH_Progress_Snapshot *snapshot) const;
+
+	private:
+		// Generation counter. Incremented before and after
+		// begin() resets the counters, so it's odd while the
+		// counters are being reset. snapshot() retries if the
+		// generation is odd or changes while it's reading.
+		std::atomic<uint32_t> m_generation;
+
+		std::atomic<int> m_type;	// RvtH_Progress_Type
+		std::atomic<uint32_t> m_lba_processed;
+		std::atomic<uint32_t> m_lba_total;
+
+		std::atomic<uint64_t> m_bytes_read;
+		std::atomic<uint64_t> m_bytes_written;
+		std::atomic<uint64_t> m_bytes_skipped;
+		std::atomic<uint64_t> m_bytes_hashed;
+
+		// Start time, in steady_clock ticks.
+		std::atomic<int64_t> m_start_time;
+
+		// Cancellation flag.
+		std::atomic<bool> m_cancel;
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_PROGRESSSINK_HPP__ */
@@ -33,6 +33,7 @@
 #ifdef _WIN32
 # include <windows.h>
 # include <io.h>
+# include <fcntl.h>
 # include <winioctl.h>
 #else /* !_WIN32 */
 # include <sys/ioctl.h>
@@ -67,6 +68,7 @@ RefFile::RefFile(const TCHAR *filename, bool create)
 	, m_lastError(0)
 	, m_file(nullptr)
 	, m_isWritable(false)
+	, m_isStream(false)
 {
 	if (!filename) {
 		// No filename...
@@ -77,6 +79,46 @@ RefFile::RefFile(const TCHAR *filename, bool create)
 	// Save the filename.
 	m_filename = filename;
 
+	if (isStreamFilename(filename)) {
+		// Use stdin or stdout.
+		// The file descriptor is duplicated so fclose()
+		// doesn't close the standard stream.
+#ifdef _WIN32
+		const int fd = _dup(create ? _fileno(stdout) : _fileno(stdin));
+		if (fd >= 0) {
+			_setmode(fd, _O_BINARY);
+			m_file = _fdopen(fd, (create ? "wb" : "rb"));
+			if (!m_file) {
+				_close(fd);
+			}
+		}
+#else /* !_WIN32 */
+		const int fd = dup(create ? STDOUT_FILENO : STDIN_FILENO);
+		if (fd >= 0) {
+			m_file = fdopen(fd, (create ? "wb" : "rb"));
+			if (!m_file) {
+				close(fd);
+			}
+		}
+#endif /* _WIN32 */
+		if (!m_file) {
+			// Could not open the stream.
+			m_lastError = errno;
+			if (m_lastError == 0) {
+				m_lastError = EIO;
+			}
+			return;
+		}
+
+		// Disable buffering. Data is read and written in
+		// large blocks, and the file descriptor may be used
+		// directly for splice().
+		setvbuf(m_file, nullptr, _IONBF, 0);
+		m_isWritable = create;
+		m_isStream = true;
+		return;
+	}
+
 	// Open the file.
 	const TCHAR *const mode = (create ? _T("wb+") : _T("rb"));
 	m_file = _tfopen(filename, mode);
@@ -114,6 +156,9 @@ int RefFile::makeWritable(void)
 	} else if (!m_file) {
 		// File is not open.
 		return -EBADF;
+	} else if (m_isStream) {
+		// stdin can't be reopened as writable.
+		return -ESPIPE;
 	}
 
 	// Get the current position.
@@ -166,8 +211,8 @@ int RefFile::makeWritable(void)
  */
 bool RefFile::isDevice(void) const
 {
-	if (!m_file) {
-		// No file...
+	if (!m_file || m_isStream) {
+		// No file, or this is stdin/stdout.
 		return false;
 	}
 
@@ -275,6 +320,104 @@ int RefFile::makeSparse(int64_t size)
 	return 0;
 }
 
+/**
+ * Truncate the file to the specified size.
+ * If the file is extended, the new space is filled with zero bytes.
+ * @param size New size.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RefFile::truncate(int64_t size)
+{
+	if (!m_file) {
+		// No file...
+		return -EBADF;
+	} else if (m_isStream) {
+		// Streams can't be truncated.
+		return -ESPIPE;
+	}
+
+	// Flush any buffered writes first.
+	fflush(m_file);
+
+#ifdef _WIN32
+	const errno_t err = _chsize_s(_fileno(m_file), size);
+	if (err != 0) {
+		m_lastError = err;
+		return -err;
+	}
+#elif defined(HAVE_FTRUNCATE)
+	if (ftruncate(fileno(m_file), size) != 0) {
+		m_lastError = errno;
+		return -m_lastError;
+	}
+#else /* !_WIN32 && !HAVE_FTRUNCATE */
+	((void)size);
+	return -ENOTSUP;
+#endif
+
+	return 0;
+}
+
+/**
+ * Flush buffered writes and wait for them to reach the storage device.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int RefFile::sync(void)
+{
+	if (!m_file) {
+		// No file...
+		return -EBADF;
+	}
+
+	errno = 0;
+	if (fflush(m_file) != 0) {
+		m_lastError = (errno != 0 ? errno : EIO);
+		return -m_lastError;
+	}
+
+#ifdef _WIN32
+	HANDLE hFile = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(m_file)));
+	if (hFile != INVALID_HANDLE_VALUE && !FlushFileBuffers(hFile)) {
+		// NOTE: Flushing fails with ERROR_ACCESS_DENIED
+		// if the file isn't writable. That's fine.
+		if (GetLastError() != ERROR_ACCESS_DENIED) {
+			m_lastError = EIO;
+			return -m_lastError;
+		}
+	}
+#elif defined(HAVE_FSYNC)
+	if (fsync(fileno(m_file)) != 0) {
+		m_lastError = errno;
+		return -m_lastError;
+	}
+#endif
+
+	return 0;
+}
+
+/**
+ * Drop cached data for a range of the file, so the next read
+ * has to go to the storage device. Dirty data isn't dropped;
+ * call sync() first to make sure it has been written.
+ * This is only a hint, and it's a no-op on some systems.
+ * @param offset	[in] Starting offset.
+ * @param size		[in] Number of bytes.
+ */
+void RefFile::dropCache(int64_t offset, int64_t size)
+{
+	if (!m_file || m_isStream) {
+		// No file, or it's a stream.
+		return;
+	}
+
+#if !defined(_WIN32) && defined(HAVE_POSIX_FADVISE)
+	posix_fadvise(fileno(m_file), offset, size, POSIX_FADV_DONTNEED);
+#else
+	((void)offset);
+	((void)size);
+#endif
+}
+
 /**
  * Get the size of the file.
  * @return Size of file, or -1 on error.
@@ -341,3 +484,142 @@ int64_t RefFile::size(void)
 	}
 	return ret;
 }
+
+/**
+ * Find the next region of the file that contains data.
+ * If the OS or file system doesn't support SEEK_DATA,
+ * the entire file is treated as data.
+ * @param offset	[in] Starting offset.
+ * @return Offset of the next data region; -ENXIO if there's no more data; or negative POSIX error code on error.
+ */
+int64_t RefFile::seekData(int64_t offset)
+{
+	if (!m_file) {
+		// No file...
+		return -EBADF;
+	}
+
+#if !defined(_WIN32) && defined(SEEK_DATA)
+	// NOTE: The stdio file position must not be changed,
+	// so the file descriptor's offset is restored afterwards.
+	const int fd = fileno(m_file);
+	const off_t orig_pos = lseek(fd, 0, SEEK_CUR);
+	if (orig_pos >= 0) {
+		const off_t ret = lseek(fd, offset, SEEK_DATA);
+		const int err = errno;
+		lseek(fd, orig_pos, SEEK_SET);
+		if (ret >= 0) {
+			return ret;
+		} else if (err == ENXIO) {
+			// No more data.
+			return -ENXIO;
+		}
+		// SEEK_DATA isn't supported.
+		// Treat the entire file as data.
+	}
+#endif /* !_WIN32 && SEEK_DATA */
+
+	const int64_t filesize = this->size();
+	if (filesize < 0) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return (offset < filesize ? offset : -ENXIO);
+}
+
+/**
+ * Find the next hole in the file.
+ * If the OS or file system doesn't support SEEK_HOLE,
+ * the only hole is at the end of the file.
+ * @param offset	[in] Starting offset.
+ * @return Offset of the next hole (or end of file), or negative POSIX error code on error.
+ */
+int64_t RefFile::seekHole(int64_t offset)
+{
+	if (!m_file) {
+		// No file...
+		return -EBADF;
+	}
+
+#if !defined(_WIN32) && defined(SEEK_HOLE)
+	// NOTE: The stdio file position must not be changed,
+	// so the file descriptor's offset is restored afterwards.
+	const int fd = fileno(m_file);
+	const off_t orig_pos = lseek(fd, 0, SEEK_CUR);
+	if (orig_pos >= 0) {
+		const off_t ret = lseek(fd, offset, SEEK_HOLE);
+		const int err = errno;
+		lseek(fd, orig_pos, SEEK_SET);
+		if (ret >= 0) {
+			return ret;
+		} else if (err == ENXIO) {
+			// Offset is past the end of the file.
+			return -ENXIO;
+		}
+		// SEEK_HOLE isn't supported.
+	}
+#endif /* !_WIN32 && SEEK_HOLE */
+
+	const int64_t filesize = this->size();
+	if (filesize < 0) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return (offset < filesize ? filesize : -ENXIO);
+}
+
+/**
+ * Clone a range of this file into another file.
+ * The destination shares the source's data blocks (reflink),
+ * so no data is copied and holes are preserved.
+ * Both files must be on the same copy-on-write file system.
+ * NOTE: Both files must be flushed beforehand.
+ * NOTE: The offsets must be aligned to the file system's
+ * block size, and so must the size, unless the range ends
+ * at the end of the source file.
+ * @param offset	[in] Source offset.
+ * @param dest		[in] Destination file.
+ * @param dest_offset	[in] Destination offset.
+ * @param size		[in] Number of bytes to clone.
+ * @return 0 on success; -ENOTSUP if reflinks aren't supported for these files; or negative POSIX error code on error.
+ */
+int RefFile::cloneRange(int64_t offset, RefFile *dest, int64_t dest_offset, int64_t size)
+{
+	if (!m_file || !dest || !dest->m_file) {
+		// No file...
+		return -EBADF;
+	} else if (!dest->m_isWritable) {
+		// Destination isn't writable.
+		return -EROFS;
+	}
+
+#if defined(__linux__) && defined(FICLONERANGE)
+	struct file_clone_range fcr;
+	fcr.src_fd = fileno(m_file);
+	fcr.src_offset = static_cast<uint64_t>(offset);
+	fcr.src_length = static_cast<uint64_t>(size);
+	fcr.dest_offset = static_cast<uint64_t>(dest_offset);
+	int ret;
+	do {
+		ret = ioctl(fileno(dest->m_file), FICLONERANGE, &fcr);
+	} while (ret < 0 && errno == EINTR);
+	if (ret == 0) {
+		return 0;
+	}
+
+	// NOTE: EOPNOTSUPP may be equal to ENOTSUP.
+	// EINVAL is returned for unaligned ranges.
+	const int err = errno;
+	if (err == ENOSYS || err == ENOTTY || err == EXDEV || err == EINVAL ||
+	    err == EOPNOTSUPP || err == ENOTSUP)
+	{
+		// Reflinks aren't supported for these files.
+		return -ENOTSUP;
+	}
+	return -err;
+#else /* !(__linux__ && FICLONERANGE) */
+	// TODO: FSCTL_DUPLICATE_EXTENTS_TO_FILE on Windows (ReFS).
+	((void)offset);
+	((void)dest_offset);
+	((void)size);
+	return -ENOTSUP;
+#endif /* __linux__ && FICLONERANGE */
+}
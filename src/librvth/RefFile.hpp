@@ -35,6 +35,9 @@ class RefFile
 		 * Check isOpen() after constructing the object to determine
 		 * if the file was opened successfully.
 		 *
+		 * If the filename is "-", stdin (or stdout, if create is true)
+		 * is used as a sequential stream. Seeking is not supported.
+		 *
 		 * @param filename Filename.
 		 * @param create If true, create the file if it doesn't exist.
 		 *               File will be opened in read/write mode.
@@ -111,12 +114,71 @@ class RefFile
 		 */
 		int makeSparse(int64_t size = 0);
 
+		/**
+		 * Truncate the file to the specified size.
+		 * If the file is extended, the new space is filled with zero bytes.
+		 * @param size New size.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int truncate(int64_t size);
+
+		/**
+		 * Flush buffered writes and wait for them to reach the storage device.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int sync(void);
+
+		/**
+		 * Drop cached data for a range of the file, so the next read
+		 * has to go to the storage device. Dirty data isn't dropped;
+		 * call sync() first to make sure it has been written.
+		 * This is only a hint, and it's a no-op on some systems.
+		 * @param offset	[in] Starting offset.
+		 * @param size		[in] Number of bytes.
+		 */
+		void dropCache(int64_t offset, int64_t size);
+
 		/**
 		 * Get the size of the file.
 		 * @return Size of file, or -1 on error.
 		 */
 		int64_t size(void);
 
+		/**
+		 * Find the next region of the file that contains data.
+		 * If the OS or file system doesn't support SEEK_DATA,
+		 * the entire file is treated as data.
+		 * @param offset	[in] Starting offset.
+		 * @return Offset of the next data region; -ENXIO if there's no more data; or negative POSIX error code on error.
+		 */
+		int64_t seekData(int64_t offset);
+
+		/**
+		 * Find the next hole in the file.
+		 * If the OS or file system doesn't support SEEK_HOLE,
+		 * the only hole is at the end of the file.
+		 * @param offset	[in] Starting offset.
+		 * @return Offset of the next hole (or end of file), or negative POSIX error code on error.
+		 */
+		int64_t seekHole(int64_t offset);
+
+		/**
+		 * Clone a range of this file into another file.
+		 * The destination shares the source's data blocks (reflink),
+		 * so no data is copied and holes are preserved.
+		 * Both files must be on the same copy-on-write file system.
+		 * NOTE: Both files must be flushed beforehand.
+		 * NOTE: The offsets must be aligned to the file system's
+		 * block size, and so must the size, unless the range ends
+		 * at the end of the source file.
+		 * @param offset	[in] Source offset.
+		 * @param dest		[in] Destination file.
+		 * @param dest_offset	[in] Destination offset.
+		 * @param size		[in] Number of bytes to clone.
+		 * @return 0 on success; -ENOTSUP if reflinks aren't supported for these files; or negative POSIX error code on error.
+		 */
+		int cloneRange(int64_t offset, RefFile *dest, int64_t dest_offset, int64_t size);
+
 	public:
 		/** Convenience wrappers for stdio functions. **/
 		// NOTE: These functions set errno, **NOT** m_lastError!
@@ -178,12 +240,46 @@ class RefFile
 			return m_isWritable;
 		}
 
+		/**
+		 * Is this file stdin or stdout?
+		 * @return True if this is a sequential stream; false if not.
+		 */
+		inline bool isStream(void) const
+		{
+			return m_isStream;
+		}
+
+		/**
+		 * Get the file descriptor.
+		 * NOTE: Call flush() before using the file descriptor directly.
+		 * @return File descriptor.
+		 */
+		inline int fd(void) const
+		{
+#ifdef _WIN32
+			return ::_fileno(m_file);
+#else /* !_WIN32 */
+			return ::fileno(m_file);
+#endif /* _WIN32 */
+		}
+
+		/**
+		 * Is a filename stdin or stdout?
+		 * @param filename Filename.
+		 * @return True if the filename is "-"; false if not.
+		 */
+		static inline bool isStreamFilename(const TCHAR *filename)
+		{
+			return (filename && filename[0] == _T('-') && filename[1] == 0);
+		}
+
 	private:
 		int m_refCount;			// Reference count
 		int m_lastError;		// Last error code
 		FILE *m_file;			// FILE pointer
 		std::tstring m_filename;	// Filename for reopening as writable
 		bool m_isWritable;		// Is the file writable?
+		bool m_isStream;		// Is this stdin or stdout?
 };
 
 #else /* !__cplusplus */
@@ -18,15 +18,24 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
  ***************************************************************************/
 
+#include "config.librvth.h"
+
 #include "rvth.hpp"
 #include "ptbl.h"
+#include "junk.hpp"
+#include "journal.hpp"
+#include "ImportVerifier.hpp"
+#include "ProgressSink.hpp"
 #include "rvth_error.h"
+#include "bank_init.h"
+#include "disc_header.hpp"
 
 #include "byteswap.h"
 #include "nhcd_structs.h"
 
-// Disc image reader.
+// Disc image reader and writer.
 #include "reader/Reader.hpp"
+#include "writer/Writer.hpp"
 
 // libwiicrypto
 #include "libwiicrypto/sig_tools.h"
@@ -34,6 +43,9 @@
 // C includes.
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SPLICE
+# include <fcntl.h>
+#endif /* HAVE_SPLICE */
 
 // C includes. (C++ namespace)
 #include <cassert>
@@ -42,8 +54,11 @@
 #include <ctime>
 
 // C++ includes.
+#include <algorithm>
 #include <string>
+#include <vector>
 using std::string;
+using std::vector;
 using std::wstring;
 
 // for disk free space
@@ -134,25 +149,109 @@ static int64_t getDiskFreeSpace_lba(const TCHAR *filename)
 	return freeSpace_lba;
 }
 
+/**
+ * Check if a block is used according to a scrub map.
+ * @param usedMap Scrub map. (If empty, all blocks are used.)
+ * @param offset Offset, in bytes.
+ * @return True if the block is used; false if it can be scrubbed.
+ */
+static inline bool isScrubBlockUsed(const vector<bool> &usedMap, uint64_t offset)
+{
+	const uint64_t block = offset / RVTH_SCRUB_BLOCK_SIZE;
+	return (block >= usedMap.size() || usedMap[static_cast<size_t>(block)]);
+}
+
+/**
+ * Check if a range of LBAs is entirely within a hole in the source disc image.
+ * @param reader	[in] Source disc image reader.
+ * @param extent	[in,out] Current data extent. (Initialize to {0, 0}.)
+ * @param lba_start	[in] Starting LBA.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return True if the LBAs are empty and don't need to be read; false if not.
+ */
+static bool isSourceHole(Reader *reader, Reader::Extent &extent, uint32_t lba_start, uint32_t lba_len)
+{
+	if (lba_start >= extent.lba_start + extent.lba_len) {
+		// Past the current extent. Find the next one.
+		if (!reader->nextExtent(lba_start, extent)) {
+			// The rest of the disc image is empty.
+			extent.lba_start = reader->lba_len();
+			extent.lba_len = 0;
+		}
+	}
+	return (lba_start + lba_len <= extent.lba_start);
+}
+
+/**
+ * Check if a bank can be extracted.
+ * @param entry Bank entry.
+ * @return 0 if the bank can be extracted; otherwise, RvtH_Errors. (errno is set)
+ */
+static int checkBankExtractable(const RvtH_BankEntry *entry)
+{
+	switch (entry->type) {
+		case RVTH_BankType_GCN:
+		case RVTH_BankType_Wii_SL:
+		case RVTH_BankType_Wii_DL:
+			// Bank can be extracted.
+			return 0;
+
+		case RVTH_BankType_Unknown:
+		default:
+			// Unknown bank status...
+			errno = EIO;
+			return RVTH_ERROR_BANK_UNKNOWN;
+
+		case RVTH_BankType_Empty:
+			// Bank is empty.
+			errno = ENOENT;
+			return RVTH_ERROR_BANK_EMPTY;
+
+		case RVTH_BankType_Wii_DL_Bank2:
+			// Second bank of a dual-layer Wii disc image.
+			// TODO: Automatically select the first bank?
+			errno = EIO;
+			return RVTH_ERROR_BANK_DL_2;
+	}
+}
+
 /**
  * Copy a bank from this RVT-H HDD or standalone disc image to a writable standalone disc image.
  * @param rvth_dest	[out] Destination RvtH object.
  * @param bank_src	[in] Source bank number. (0-7)
  * @param callback	[in,opt] Progress callback.
  * @param userdata	[in,opt] User data for progress callback.
+ * @param flags		[in,opt] Flags. (See RvtH_Extract_Flags; only RVTH_EXTRACT_SCRUB and RVTH_EXTRACT_STRIP_JUNK are used here.)
+ * @param journal	[in,opt] Resume journal. If it has completed chunks, copying resumes after them.
  * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
  */
-int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callback callback, void *userdata)
+int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callback callback, void *userdata,
+	unsigned int flags, Journal *journal)
 {
 	uint32_t lba_copy_len;	// Total number of LBAs to copy. (entry_src->lba_len)
 	uint32_t lba_count;
+	uint32_t lba_resume;	// First LBA to copy. (non-zero if resuming)
 	uint32_t lba_buf_max;	// Highest LBA that can be written using the buffer.
 	uint32_t lba_nonsparse;	// Last LBA written that wasn't sparse.
 	unsigned int sprs;		// Sparse counter.
+	unsigned int sz_written;	// Bytes written from the current buffer.
 
 	// Callback state.
 	RvtH_Progress_State state;
 
+	// Scrub map. If empty, all blocks are copied.
+	vector<bool> usedMap;
+
+	// Junk runs detected in the source bank.
+	vector<RvtH_JunkRun> junkRuns;
+	JunkDetector junkDetector(junkRuns);
+	bool stripJunk;
+
+	// Holes in the source image are skipped, unless
+	// junk data has to be regenerated in them.
+	Reader::Extent extent = {0, 0};
+	bool skipHoles;
+
 	int ret = 0;	// errno or RvtH_Errors
 	int err = 0;	// errno setting
 
@@ -174,29 +273,22 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 
 	// Check if the source bank can be extracted.
 	const RvtH_BankEntry *const entry_src = &m_entries[bank_src];
-	switch (entry_src->type) {
-		case RVTH_BankType_GCN:
-		case RVTH_BankType_Wii_SL:
-		case RVTH_BankType_Wii_DL:
-			// Bank can be extracted.
-			break;
-
-		case RVTH_BankType_Unknown:
-		default:
-			// Unknown bank status...
-			errno = EIO;
-			return RVTH_ERROR_BANK_UNKNOWN;
+	ret = checkBankExtractable(entry_src);
+	if (ret != 0) {
+		return ret;
+	}
 
-		case RVTH_BankType_Empty:
-			// Bank is empty.
-			errno = ENOENT;
-			return RVTH_ERROR_BANK_EMPTY;
+	// Junk data is only stripped from GameCube disc images.
+	// Wii junk data is encrypted along with the partition data.
+	stripJunk = ((flags & RVTH_EXTRACT_STRIP_JUNK) && entry_src->type == RVTH_BankType_GCN);
 
-		case RVTH_BankType_Wii_DL_Bank2:
-			// Second bank of a dual-layer Wii disc image.
-			// TODO: Automatically select the first bank?
-			errno = EIO;
-			return RVTH_ERROR_BANK_DL_2;
+	if (flags & RVTH_EXTRACT_SCRUB) {
+		// Determine which blocks are actually used.
+		// Unused blocks will be written as holes.
+		ret = getScrubMap(bank_src, usedMap);
+		if (ret != 0) {
+			return ret;
+		}
 	}
 
 	// Process 1 MB at a time.
@@ -215,9 +307,29 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 
 	// FIXME: If the file existed and wasn't 0 bytes,
 	// either truncate it or don't do sparse writes.
+	entry_dest = &rvth_dest->m_entries[0];
+	lba_resume = 0;
+	if (journal) {
+		// Verify the chunks that were completed before the
+		// extraction was interrupted, and discard everything
+		// after them, since empty blocks aren't written.
+		static_assert(RVTH_JOURNAL_CHUNK_LBA == LBA_COUNT_BUF,
+			"Journal chunk size must match the copy buffer size.");
+		journal->verify(entry_dest->reader, buf);
+		lba_resume = journal->resumeLba();
+		ret = rvth_dest->m_file->truncate(
+			LBA_TO_BYTES(entry_dest->reader->lba_start() + lba_resume));
+		if (ret != 0) {
+			err = -ret;
+			goto end;
+		}
+
+		// NOTE: If the journal can't be written,
+		// copying continues without it.
+		journal->create();
+	}
 
 	// Make this a sparse file.
-	entry_dest = &rvth_dest->m_entries[0];
 	ret = rvth_dest->m_file->makeSparse(LBA_TO_BYTES(entry_dest->lba_len));
 	if (ret != 0) {
 		// Error managing the sparse file.
@@ -262,11 +374,40 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 		state.lba_processed = 0;
 		state.lba_total = lba_copy_len;
 	}
+	if (m_progress) {
+		m_progress->begin(RVTH_PROGRESS_EXTRACT, lba_copy_len);
+	}
+
+	if (usedMap.empty() && !stripJunk && m_junkRuns.empty() && lba_resume == 0) {
+		// The data doesn't need to be modified.
+		// Try cloning the bank's data blocks. (reflink)
+		// NOTE: The fast path doesn't record chunks in the journal,
+		// so it's only used if nothing is being resumed. If it's
+		// interrupted, the journal is empty and the next attempt
+		// starts over from the beginning.
+		ret = copyToGcm_reflink(entry_dest->reader, bank_src, callback, userdata, &state);
+		if (ret != -ENOTSUP) {
+			if (ret < 0) {
+				err = -ret;
+			}
+			goto end;
+		}
+		// Not supported. Use the regular copy loop,
+		// which keeps zero blocks sparse.
+		ret = 0;
+	}
 
 	// TODO: Optimize seeking? (Reader::write() seeks every time.)
 	lba_buf_max = entry_dest->lba_len & ~(LBA_COUNT_BUF-1);
 	lba_nonsparse = 0;
-	for (lba_count = 0; lba_count < lba_buf_max; lba_count += LBA_COUNT_BUF) {
+	skipHoles = m_junkRuns.empty();
+	for (lba_count = lba_resume; lba_count < lba_buf_max; lba_count += LBA_COUNT_BUF) {
+		if (m_progress && !m_progress->update(lba_count)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
 		if (callback) {
 			bool bRet;
 			state.lba_processed = lba_count;
@@ -279,8 +420,33 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 			}
 		}
 
-		// TODO: Error handling.
-		entry_src->reader->read(buf, lba_count, LBA_COUNT_BUF);
+		// Empty source blocks are written as holes,
+		// so they don't need to be read.
+		// NOTE: LBA 0 is always read in case the disc header
+		// needs to be restored.
+		if (skipHoles && lba_count != 0 &&
+		    isSourceHole(entry_src->reader, extent, lba_count, LBA_COUNT_BUF))
+		{
+			if (journal) {
+				journal->addChunk(entry_dest->reader, lba_count, nullptr, LBA_COUNT_BUF);
+			}
+			if (m_progress) {
+				m_progress->addSkipped(BUF_SIZE);
+			}
+			continue;
+		}
+
+		errno = 0;
+		if (entry_src->reader->read(buf, lba_count, LBA_COUNT_BUF) != LBA_COUNT_BUF) {
+			// Read error.
+			err = (errno != 0 ? errno : EIO);
+			ret = -err;
+			goto end;
+		}
+		fillJunk(buf, lba_count, LBA_COUNT_BUF);
+		if (m_progress) {
+			m_progress->addRead(BUF_SIZE);
+		}
 
 		if (lba_count == 0) {
 			// Make sure we copy the disc header in if the
@@ -296,22 +462,50 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 			}
 		}
 
-		// Check for empty 4 KB blocks.
+		// Check for empty, unused, or junk 4 KB blocks.
+		sz_written = 0;
 		for (sprs = 0; sprs < BUF_SIZE; sprs += 4096) {
-			if (!isBlockEmpty(&buf[sprs], 4096)) {
+			if (isScrubBlockUsed(usedMap, LBA_TO_BYTES(lba_count) + sprs) &&
+			    !isBlockEmpty(&buf[sprs], 4096) &&
+			    !(stripJunk && junkDetector.check(&buf[sprs], LBA_TO_BYTES(lba_count) + sprs, 4096)))
+			{
 				// 4 KB block is not empty.
 				lba_nonsparse = lba_count + (sprs / 512);
-				entry_dest->reader->write(&buf[sprs], lba_nonsparse, 8);
+				errno = 0;
+				if (entry_dest->reader->write(&buf[sprs], lba_nonsparse, 8) != 8) {
+					// Write error.
+					err = (errno != 0 ? errno : EIO);
+					ret = -err;
+					goto end;
+				}
 				lba_nonsparse += 7;
+				sz_written += 4096;
+			} else if (journal) {
+				// Block is written as a hole.
+				// Clear it so the journal has the correct CRC.
+				memset(&buf[sprs], 0, 4096);
 			}
 		}
+
+		if (m_progress) {
+			m_progress->addWritten(sz_written);
+		}
+		if (journal) {
+			journal->addChunk(entry_dest->reader, lba_count, buf, LBA_COUNT_BUF);
+		}
 	}
 
 	// Process any remaining LBAs.
 	if (lba_count < lba_copy_len) {
 		const unsigned int lba_left = lba_copy_len - lba_count;
-		const unsigned int sz_left = (unsigned int)BYTES_TO_LBA(lba_left);
+		const unsigned int sz_left = (unsigned int)LBA_TO_BYTES(lba_left);
 
+		if (m_progress && !m_progress->update(lba_count)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
 		if (callback) {
 			bool bRet;
 			state.lba_processed = lba_count;
@@ -323,18 +517,69 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 				goto end;
 			}
 		}
-		entry_src->reader->read(buf, lba_count, lba_left);
 
-		// Check for empty 512-byte blocks.
-		for (sprs = 0; sprs < sz_left; sprs += 512) {
-			if (!isBlockEmpty(&buf[sprs], 512)) {
-				// 512-byte block is not empty.
-				lba_nonsparse = lba_count + (sprs / 512);
-				entry_dest->reader->write(&buf[sprs], lba_nonsparse, 1);
+		if (skipHoles && lba_count != 0 &&
+		    isSourceHole(entry_src->reader, extent, lba_count, lba_left))
+		{
+			// Empty source blocks are written as holes.
+			if (journal) {
+				journal->addChunk(entry_dest->reader, lba_count, nullptr, lba_left);
+			}
+			if (m_progress) {
+				m_progress->addSkipped(sz_left);
+			}
+		} else {
+			errno = 0;
+			if (entry_src->reader->read(buf, lba_count, lba_left) != lba_left) {
+				// Read error.
+				err = (errno != 0 ? errno : EIO);
+				ret = -err;
+				goto end;
+			}
+			fillJunk(buf, lba_count, lba_left);
+			if (m_progress) {
+				m_progress->addRead(sz_left);
+			}
+
+			// Check for empty, unused, or junk 512-byte blocks.
+			sz_written = 0;
+			for (sprs = 0; sprs < sz_left; sprs += 512) {
+				if (isScrubBlockUsed(usedMap, LBA_TO_BYTES(lba_count) + sprs) &&
+				    !isBlockEmpty(&buf[sprs], 512) &&
+				    !(stripJunk && junkDetector.check(&buf[sprs], LBA_TO_BYTES(lba_count) + sprs, 512)))
+				{
+					// 512-byte block is not empty.
+					lba_nonsparse = lba_count + (sprs / 512);
+					errno = 0;
+					if (entry_dest->reader->write(&buf[sprs], lba_nonsparse, 1) != 1) {
+						// Write error.
+						err = (errno != 0 ? errno : EIO);
+						ret = -err;
+						goto end;
+					}
+					sz_written += 512;
+				} else if (journal) {
+					// Block is written as a hole.
+					// Clear it so the journal has the correct CRC.
+					memset(&buf[sprs], 0, 512);
+				}
+			}
+			if (m_progress) {
+				m_progress->addWritten(sz_written);
+			}
+
+			if (journal) {
+				journal->addChunk(entry_dest->reader, lba_count, buf, lba_left);
 			}
 		}
 	}
 
+	if (m_progress && !m_progress->update(lba_copy_len)) {
+		// Stop processing.
+		err = ECANCELED;
+		ret = -ECANCELED;
+		goto end;
+	}
 	if (callback) {
 		bool bRet;
 		state.lba_processed = lba_copy_len;
@@ -348,7 +593,9 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 	}
 
 	// lba_nonsparse should be equal to lba_copy_len-1.
-	if (lba_nonsparse != lba_copy_len-1) {
+	// NOTE: If resuming after the last chunk was completed,
+	// the last LBA was already written.
+	if (lba_nonsparse != lba_copy_len-1 && lba_resume < lba_copy_len) {
 		// Last LBA was sparse.
 		// We'll need to write an actual zero block.
 		// TODO: Maybe not needed if ftruncate() succeeded?
@@ -360,7 +607,15 @@ int RvtH::copyToGcm(RvtH *rvth_dest, unsigned int bank_src, RvtH_Progress_Callba
 	// Finished extracting the disc image.
 	entry_dest->reader->flush();
 
+	// Junk blocks were written as holes.
+	// The caller must save the run list.
+	rvth_dest->m_junkRuns.swap(junkRuns);
+
 end:
+	if (ret != 0 && journal) {
+		// Save the completed chunks so the extraction can be resumed.
+		journal->checkpoint(rvth_dest->m_entries[0].reader);
+	}
 	free(buf);
 	if (err != 0) {
 		errno = err;
@@ -368,10 +623,375 @@ end:
 	return ret;
 }
 
+/**
+ * Copy a bank from this RVT-H HDD or standalone disc image to a plain disc image
+ * by cloning its data blocks (reflink). Holes in the source image are preserved,
+ * and zero blocks aren't allocated separately.
+ *
+ * This is only supported if both the source and destination are
+ * plain disc images on regular files on the same copy-on-write
+ * file system, the bank is aligned to the file system's block size,
+ * and the data doesn't need to be modified while copying.
+ * Otherwise, the regular copy loop must be used, since copying
+ * the data extents as-is would fully allocate zero blocks.
+ *
+ * @param reader_dest	[in] Destination disc image reader.
+ * @param bank_src	[in] Source bank number. (0-7)
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @param state		[in,out,opt] Progress callback state. (required if callback is set)
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ *         -ENOTSUP if reflinks aren't supported.
+ */
+int RvtH::copyToGcm_reflink(Reader *reader_dest, unsigned int bank_src,
+	RvtH_Progress_Callback callback, void *userdata,
+	RvtH_Progress_State *state)
+{
+	const RvtH_BankEntry *const entry_src = &m_entries[bank_src];
+	Reader *const reader_src = entry_src->reader;
+	if (!reader_src->isPlain() || !reader_dest->isPlain()) {
+		// Compressed or compacted disc image.
+		return -ENOTSUP;
+	}
+
+	RefFile *const f_src = reader_src->file();
+	RefFile *const f_dest = reader_dest->file();
+	if (f_src->isDevice() || f_src->isStream() ||
+	    f_dest->isDevice() || f_dest->isStream())
+	{
+		// Not a regular file.
+		return -ENOTSUP;
+	}
+
+	// Reflinks require block-aligned offsets.
+	// NOTE: RVT-H banks usually start on an odd LBA.
+	#define REFLINK_BLOCK_SIZE static_cast<int64_t>(4096)
+	const int64_t src_start = LBA_TO_BYTES(reader_src->lba_start());
+	const int64_t dest_start = LBA_TO_BYTES(reader_dest->lba_start());
+	if ((src_start % REFLINK_BLOCK_SIZE) != 0 || (dest_start % REFLINK_BLOCK_SIZE) != 0) {
+		// Not aligned.
+		return -ENOTSUP;
+	}
+
+	// If the disc header was zeroed by the RVT-H's "Flush" function,
+	// it has to be restored, so the regular copy loop must be used.
+	uint8_t sbuf[REFLINK_BLOCK_SIZE];
+	if (reader_src->read(sbuf, 0, 1) != 1) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+	const GCN_DiscHeader *const origHdr = (const GCN_DiscHeader*)sbuf;
+	if (origHdr->magic_wii != be32_to_cpu(WII_MAGIC) &&
+	    origHdr->magic_gcn != be32_to_cpu(GCN_MAGIC))
+	{
+		// Missing magic number.
+		return -ENOTSUP;
+	}
+
+	// Make sure any buffered writes (e.g. the SDK header) are on disk.
+	reader_dest->flush();
+
+	// Clone 32 MB at a time so the progress callback is updated.
+	// The unaligned tail (if any) is copied through userspace.
+	#define REFLINK_CHUNK static_cast<int64_t>(32*1024*1024)
+	const int64_t copy_len = LBA_TO_BYTES(entry_src->lba_len);
+	const int64_t clone_len = copy_len & ~(REFLINK_BLOCK_SIZE-1);
+	for (int64_t pos = 0; pos < clone_len; ) {
+		if (m_progress && !m_progress->update(static_cast<uint32_t>(BYTES_TO_LBA(pos)))) {
+			// Stop processing.
+			return -ECANCELED;
+		}
+		if (callback) {
+			state->lba_processed = static_cast<uint32_t>(BYTES_TO_LBA(pos));
+			if (!callback(state, userdata)) {
+				// Stop processing.
+				return -ECANCELED;
+			}
+		}
+
+		const int64_t len = std::min(clone_len - pos, REFLINK_CHUNK);
+		const int ret = f_src->cloneRange(src_start + pos, f_dest, dest_start + pos, len);
+		if (ret != 0) {
+			// NOTE: If -ENOTSUP is returned after some data was cloned,
+			// the regular copy loop will simply overwrite it.
+			return ret;
+		}
+		if (m_progress) {
+			// The data isn't read or written by us.
+			m_progress->addSkipped(len);
+		}
+		pos += len;
+	}
+
+	if (clone_len != copy_len) {
+		// Copy the remaining LBAs.
+		const unsigned int lba_tail = static_cast<unsigned int>(BYTES_TO_LBA(copy_len - clone_len));
+		const uint32_t lba_pos = static_cast<uint32_t>(BYTES_TO_LBA(clone_len));
+		if (reader_src->read(sbuf, lba_pos, lba_tail) != lba_tail) {
+			return (errno != 0 ? -errno : -EIO);
+		}
+		if (reader_dest->write(sbuf, lba_pos, lba_tail) != lba_tail) {
+			return (errno != 0 ? -errno : -EIO);
+		}
+		if (m_progress) {
+			m_progress->addRead(LBA_TO_BYTES(lba_tail));
+			m_progress->addWritten(LBA_TO_BYTES(lba_tail));
+		}
+	}
+
+	if (m_progress && !m_progress->update(entry_src->lba_len)) {
+		// Stop processing.
+		return -ECANCELED;
+	}
+	if (callback) {
+		state->lba_processed = entry_src->lba_len;
+		if (!callback(state, userdata)) {
+			// Stop processing.
+			return -ECANCELED;
+		}
+	}
+
+	// Finished extracting the disc image.
+	reader_dest->flush();
+	return 0;
+}
+
+/**
+ * Copy a bank from this RVT-H HDD or standalone disc image to a disc image writer.
+ * This is used for compressed and compacted disc image formats.
+ * @param writer	[in] Disc image writer. (Must be the same size as the bank.)
+ * @param bank_src	[in] Source bank number. (0-7)
+ * @param junkRuns	[out] Junk runs that were stripped. (only if RVTH_EXTRACT_STRIP_JUNK is set)
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @param flags		[in,opt] Flags. (See RvtH_Extract_Flags; only RVTH_EXTRACT_SCRUB and RVTH_EXTRACT_STRIP_JUNK are used here.)
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::copyToWriter(Writer *writer, unsigned int bank_src,
+	vector<RvtH_JunkRun> &junkRuns,
+	RvtH_Progress_Callback callback, void *userdata, unsigned int flags)
+{
+	// Callback state.
+	RvtH_Progress_State state;
+
+	// Scrub map. If empty, all blocks are copied.
+	vector<bool> usedMap;
+
+	// Holes in the source image don't need to be read,
+	// unless junk data has to be regenerated in them.
+	Reader::Extent extent = {0, 0};
+	const bool skipHoles = m_junkRuns.empty();
+
+	junkRuns.clear();
+	if (!writer) {
+		errno = EINVAL;
+		return -EINVAL;
+	} else if (bank_src >= m_bankCount) {
+		errno = ERANGE;
+		return -ERANGE;
+	}
+
+	// Check if the source bank can be extracted.
+	const RvtH_BankEntry *const entry_src = &m_entries[bank_src];
+	int ret = checkBankExtractable(entry_src);
+	if (ret != 0) {
+		return ret;
+	}
+	const uint32_t lba_copy_len = entry_src->lba_len;
+	if (writer->lba_len() != lba_copy_len || writer->lba_pos() != 0) {
+		// Writer doesn't match the bank.
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	// Junk data is only stripped from GameCube disc images.
+	// Wii junk data is encrypted along with the partition data.
+	JunkDetector junkDetector(junkRuns);
+	const bool stripJunk = ((flags & RVTH_EXTRACT_STRIP_JUNK) && entry_src->type == RVTH_BankType_GCN);
+
+	if (flags & RVTH_EXTRACT_SCRUB) {
+		// Determine which blocks are actually used.
+		// Unused blocks will be written as zeroes.
+		ret = getScrubMap(bank_src, usedMap);
+		if (ret != 0) {
+			return ret;
+		}
+	}
+
+	uint8_t *const buf = static_cast<uint8_t*>(malloc(BUF_SIZE));
+	if (!buf) {
+		// Error allocating memory.
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+
+	if (callback) {
+		// Initialize the callback state.
+		state.rvth = this;
+		state.rvth_gcm = nullptr;
+		state.bank_rvth = bank_src;
+		state.bank_gcm = 0;
+		state.type = RVTH_PROGRESS_EXTRACT;
+		state.lba_processed = 0;
+		state.lba_total = lba_copy_len;
+	}
+	if (m_progress) {
+		m_progress->begin(RVTH_PROGRESS_EXTRACT, lba_copy_len);
+	}
+
+	for (uint32_t lba_count = 0; lba_count < lba_copy_len; ) {
+		if (m_progress && !m_progress->update(lba_count)) {
+			// Stop processing.
+			ret = -ECANCELED;
+			break;
+		}
+		if (callback) {
+			state.lba_processed = lba_count;
+			if (!callback(&state, userdata)) {
+				// Stop processing.
+				ret = -ECANCELED;
+				break;
+			}
+		}
+
+		const uint32_t lba_buf = std::min(static_cast<uint32_t>(LBA_COUNT_BUF), lba_copy_len - lba_count);
+		if (skipHoles && lba_count != 0 &&
+		    isSourceHole(entry_src->reader, extent, lba_count, lba_buf))
+		{
+			// Empty source blocks don't need to be read.
+			memset(buf, 0, LBA_TO_BYTES(lba_buf));
+			if (m_progress) {
+				m_progress->addSkipped(LBA_TO_BYTES(lba_buf));
+			}
+		} else {
+			errno = 0;
+			if (entry_src->reader->read(buf, lba_count, lba_buf) != lba_buf) {
+				// Read error.
+				ret = -(errno != 0 ? errno : EIO);
+				break;
+			}
+			fillJunk(buf, lba_count, lba_buf);
+			if (m_progress) {
+				m_progress->addRead(LBA_TO_BYTES(lba_buf));
+			}
+		}
+
+		if (lba_count == 0) {
+			// Make sure we copy the disc header in if the
+			// header was zeroed by the RVT-H's "Flush" function.
+			const GCN_DiscHeader *const origHdr = (const GCN_DiscHeader*)buf;
+			if (origHdr->magic_wii != be32_to_cpu(WII_MAGIC) &&
+			    origHdr->magic_gcn != be32_to_cpu(GCN_MAGIC))
+			{
+				// Missing magic number. Need to restore the disc header.
+				memcpy(buf, &entry_src->discHeader, sizeof(entry_src->discHeader));
+			}
+		}
+
+		// Zero out unused and junk blocks.
+		const unsigned int sz = LBA_TO_BYTES(lba_buf);
+		const unsigned int block_size = (sz % 4096 == 0 ? 4096 : 512);
+		for (unsigned int sprs = 0; sprs < sz; sprs += block_size) {
+			const uint64_t offset = LBA_TO_BYTES(lba_count) + sprs;
+			if (!isScrubBlockUsed(usedMap, offset) ||
+			    (stripJunk && junkDetector.check(&buf[sprs], offset, block_size)))
+			{
+				memset(&buf[sprs], 0, block_size);
+			}
+		}
+
+		ret = writer->write(buf, lba_buf);
+		if (ret != 0) {
+			break;
+		}
+		if (m_progress) {
+			m_progress->addWritten(LBA_TO_BYTES(lba_buf));
+		}
+		lba_count += lba_buf;
+	}
+
+	if (ret == 0) {
+		// Write the disc image headers.
+		ret = writer->finish();
+	}
+	if (ret == 0 && m_progress && !m_progress->update(lba_copy_len)) {
+		// Stop processing.
+		ret = -ECANCELED;
+	}
+	if (ret == 0 && callback) {
+		state.lba_processed = lba_copy_len;
+		if (!callback(&state, userdata)) {
+			// Stop processing.
+			ret = -ECANCELED;
+		}
+	}
+
+	free(buf);
+	if (ret != 0) {
+		errno = -ret;
+	}
+	return ret;
+}
+
+/**
+ * Extract a disc image from this RVT-H disk image using a disc image writer.
+ * @param bank		[in] Bank number. (0-7)
+ * @param filename	[in] Destination filename.
+ * @param flags		[in] Flags. (See RvtH_Extract_Flags.)
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::extractToWriter(unsigned int bank, const TCHAR *filename,
+	unsigned int flags, RvtH_Progress_Callback callback, void *userdata)
+{
+	const RvtH_BankEntry *const entry = &m_entries[bank];
+	int ret = checkBankExtractable(entry);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// NOTE: Not checking for free disk space, since
+	// the final size of the disc image isn't known.
+	RefFile *const file = new RefFile(filename, true);
+	if (!file->isOpen()) {
+		// Error creating the disc image.
+		int err = file->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		file->unref();
+		errno = err;
+		return -err;
+	}
+
+	Writer *const writer = Writer::create(file, RVTH_EXTRACT_GET_FORMAT(flags), entry->lba_len);
+	file->unref();
+	if (!writer) {
+		// Error creating the writer.
+		ret = -(errno != 0 ? errno : EIO);
+		errno = -ret;
+		return ret;
+	}
+
+	vector<RvtH_JunkRun> junkRuns;
+	ret = copyToWriter(writer, bank, junkRuns, callback, userdata, flags);
+	delete writer;
+	if (ret == 0 && !RefFile::isStreamFilename(filename)) {
+		// Save the junk run list.
+		// If no junk was stripped, this removes any stale run list.
+		const tstring junk_filename = tstring(filename) + RVTH_JUNK_FILE_EXT;
+		ret = saveJunkRuns(junk_filename.c_str(), junkRuns);
+	}
+
+	// TODO: Delete the file on error?
+	return ret;
+}
+
 /**
  * Extract a disc image from this RVT-H disk image.
  * Compatibility wrapper; this function creates a new RvtH
  * using the GCM constructor and then copyToGcm().
+ * If filename is "-", the disc image is written to stdout.
  * @param bank		[in] Bank number. (0-7)
  * @param filename	[in] Destination filename.
  * @param recrypt_key	[in] Key for recryption. (-1 for default; otherwise, see RVL_CryptoType_e)
@@ -384,6 +1004,8 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 	int recrypt_key, unsigned int flags, RvtH_Progress_Callback callback, void *userdata)
 {
 	RvtH *rvth_dest = nullptr;
+	Journal *journal = nullptr;
+	bool resume = false;
 	int64_t diskFreeSpace_lba = 0;
 	int ret = 0;
 
@@ -404,10 +1026,49 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 
 	// Create a standalone disc image.
 	RvtH_BankEntry *const entry = &m_entries[bank];
+	// NOTE: Empty WBFS disc slots have a length of 0,
+	// so this must be checked before creating the image.
+	ret = checkBankExtractable(entry);
+	if (ret != 0) {
+		return ret;
+	}
 	const bool unenc_to_enc = (entry->type >= RVTH_BankType_Wii_SL &&
 				   entry->crypto_type == RVL_CryptoType_None &&
 				   recrypt_key > RVL_CryptoType_Unknown);
+	const RvtH_ExtractFormat_e format = RVTH_EXTRACT_GET_FORMAT(flags);
+	const bool isStream = RefFile::isStreamFilename(filename);
 	uint32_t gcm_lba_len;
+	uint32_t gcm_lba_needed;	// LBAs that still need to be written
+	if (format != RVTH_ExtractFormat_GCM || isStream) {
+		// Compressed and compacted disc images, as well as disc
+		// images written to stdout, are written sequentially,
+		// so they can't be encrypted or recrypted after copying.
+		// SDK headers aren't supported either.
+		// Junk data can't be stripped from a stream, since the
+		// junk run list is saved alongside the disc image.
+		if (format >= RVTH_ExtractFormat_MAX) {
+			errno = EINVAL;
+			ret = -EINVAL;
+		} else if (unenc_to_enc ||
+		    (recrypt_key > RVL_CryptoType_Unknown && entry->crypto_type != recrypt_key) ||
+		    (flags & RVTH_EXTRACT_PREPEND_SDK_HEADER) ||
+		    (isStream && (flags & RVTH_EXTRACT_STRIP_JUNK)))
+		{
+			errno = ENOTSUP;
+			ret = -ENOTSUP;
+		} else {
+			ret = extractToWriter(bank, filename, flags, callback, userdata);
+		}
+		goto end;
+	}
+	if (unenc_to_enc && (flags & RVTH_EXTRACT_SCRUB)) {
+		// FIXME: Scrubbing isn't supported when encrypting
+		// an unencrypted image, since the hashes for the
+		// entire partition are regenerated.
+		errno = ENOTSUP;
+		ret = -ENOTSUP;
+		goto end;
+	}
 	if (unenc_to_enc) {
 		// Converting from unencrypted to encrypted.
 		// Need to convert 31k sectors to 32k.
@@ -445,22 +1106,44 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 		gcm_lba_len += BYTES_TO_LBA(32768);
 	}
 
+	if (!unenc_to_enc && !(flags & RVTH_EXTRACT_STRIP_JUNK)) {
+		// Keep a resume journal next to the disc image.
+		// NOTE: Junk runs aren't saved until the extraction is
+		// finished, so images with stripped junk can't be resumed.
+		// Encrypting an unencrypted image changes the layout,
+		// so that can't be resumed either.
+		const tstring journal_filename = tstring(filename) + RVTH_JOURNAL_FILE_EXT;
+		journal = new Journal(journal_filename.c_str(), RVTH_JOURNAL_TYPE_EXTRACT,
+			bank, 0, entry, flags & ~RVTH_EXTRACT_RESUME);
+		if (flags & RVTH_EXTRACT_RESUME) {
+			resume = (journal->load() == 0);
+		}
+	}
+
 	// Check that we have enough free disk space.
 	// NOTE: We're not checking for sparse sectors.
+	// If resuming, the completed chunks are already in the disc image.
+	// (copyToGcm() may redo some of them if they fail verification.)
+	gcm_lba_needed = gcm_lba_len;
+	if (resume) {
+		const uint32_t lba_resume = journal->resumeLba();
+		gcm_lba_needed = (lba_resume < gcm_lba_len) ? (gcm_lba_len - lba_resume) : 0;
+	}
 	diskFreeSpace_lba = getDiskFreeSpace_lba(filename);
 	if (diskFreeSpace_lba < 0) {
 		// Error...
 		ret = static_cast<int>(diskFreeSpace_lba);
 		errno = -ret;
 		goto end;
-	} else if (diskFreeSpace_lba < gcm_lba_len) {
+	} else if (diskFreeSpace_lba < gcm_lba_needed) {
 		// Not enough free disk space.
 		errno = ENOSPC;
 		ret = -ENOSPC;
 		goto end;
 	}
 
-	rvth_dest = new RvtH(filename, gcm_lba_len, &ret);
+	// If resuming, the existing disc image is reopened.
+	rvth_dest = new RvtH(filename, gcm_lba_len, &ret, resume);
 	if (!rvth_dest->isOpen()) {
 		// Error creating the standalone disc image.
 		errno = EIO;
@@ -469,6 +1152,8 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 		}
 		goto end;
 	}
+	// Recryption runs on rvth_dest, so it needs our progress sink.
+	rvth_dest->setProgressSink(m_progress);
 
 	if (flags & RVTH_EXTRACT_PREPEND_SDK_HEADER) {
 		// Prepend 32k to the GCM.
@@ -532,7 +1217,12 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 	if (unenc_to_enc) {
 		ret = copyToGcm_doCrypt(rvth_dest, bank, callback, userdata);
 	} else {
-		ret = copyToGcm(rvth_dest, bank, callback, userdata);
+		ret = copyToGcm(rvth_dest, bank, callback, userdata, flags, journal);
+	}
+	if (ret == 0 && journal) {
+		// Copy is complete. Recryption modifies the disc image
+		// in place, so the journal is no longer valid.
+		journal->remove();
 	}
 	if (ret == 0 && recrypt_key > RVL_CryptoType_Unknown) {
 		// Recrypt the disc image.
@@ -541,9 +1231,16 @@ int RvtH::extract(unsigned int bank, const TCHAR *filename,
 				static_cast<RVL_CryptoType_e>(recrypt_key), callback, userdata);
 		}
 	}
+	if (ret == 0) {
+		// Save the junk run list.
+		// If no junk was stripped, this removes any stale run list.
+		const tstring junk_filename = tstring(filename) + RVTH_JUNK_FILE_EXT;
+		ret = rvth_dest->saveJunkRuns(junk_filename.c_str());
+	}
 
 end:
 	// TODO: Delete the file on error?
+	delete journal;
 	delete rvth_dest;
 	return ret;
 }
@@ -555,16 +1252,25 @@ end:
  * @param bank_src	[in] Source bank number. (0-7)
  * @param callback	[in,opt] Progress callback.
  * @param userdata	[in,opt] User data for progress callback.
+ * @param journal	[in,opt] Resume journal. If it has completed chunks, copying resumes after them.
  * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
  */
 int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
-	unsigned int bank_src, RvtH_Progress_Callback callback, void *userdata)
+	unsigned int bank_src, RvtH_Progress_Callback callback, void *userdata,
+	Journal *journal, ImportVerifier *verifier)
 {
 	uint32_t lba_copy_len;	// Total number of LBAs to copy. (entry_src->lba_len)
 	uint32_t lba_count;
+	uint32_t lba_resume;	// First LBA to copy. (non-zero if resuming)
 	uint32_t lba_buf_max;	// Highest LBA that can be written using the buffer.
 	uint8_t *buf = NULL;
 
+	// Holes in the source image don't need to be read,
+	// unless junk data has to be regenerated in them.
+	Reader::Extent extent = {0, 0};
+	const bool skipHoles = m_junkRuns.empty();
+	bool bufIsZero = false;
+
 	// Callback state.
 	RvtH_Progress_State state;
 
@@ -701,6 +1407,15 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 		return RVTH_ERROR_BANK_NOT_EMPTY_OR_DELETED;
 	}
 
+	// Save the original bank entries.
+	// If the import fails, the bank table isn't updated,
+	// so the entries are restored to match it.
+	RvtH_BankEntry entry_dest_orig, entry_dest2_orig;
+	memcpy(&entry_dest_orig, entry_dest, sizeof(entry_dest_orig));
+	if (entry_dest2) {
+		memcpy(&entry_dest2_orig, entry_dest2, sizeof(entry_dest2_orig));
+	}
+
 	// Make the destination RVT-H object writable.
 	ret = rvth_dest->makeWritable();
 	if (ret != 0) {
@@ -714,10 +1429,7 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 	}
 
 	// Reset the reader for the bank.
-	if (entry_dest->reader) {
-		delete entry_dest->reader;
-		entry_dest->reader = nullptr;
-	}
+	// NOTE: The original reader is released once the import succeeds.
 	// NOTE: Using the source LBA length, since we might be
 	// importing a dual-layer Wii image.
 	entry_dest->reader = Reader::open(rvth_dest->m_file,
@@ -728,21 +1440,21 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 		if (err == 0) {
 			err = EIO;
 		}
+		ret = -err;
 		goto end;
 	}
 
 	if (entry_dest2) {
 		// Clear the second bank entry.
-		if (entry_dest2->reader) {
-			delete entry_dest2->reader;
-			entry_dest2->reader = nullptr;
-		}
+		// NOTE: The original reader and partition table
+		// are released once the import succeeds.
+		entry_dest2->reader = nullptr;
 		entry_dest2->timestamp = -1;
 		entry_dest2->type = RVTH_BankType_Wii_DL_Bank2;
 		entry_dest2->region_code = 0xFF;
 		entry_dest2->is_deleted = false;
-		free(entry_dest2->ptbl);
 		entry_dest2->ptbl = nullptr;
+		entry_dest2->pt_count = 0;
 
 		// NOTE: We don't need to write the second bank table entry for,
 		// DL images, since it should already be empty and/or deleted.
@@ -787,6 +1499,30 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 	// There's no point in wiping the rest of the bank.
 	lba_copy_len = entry_src->lba_len;
 
+	lba_resume = 0;
+	if (journal) {
+		// Verify the chunks that were completed before
+		// the import was interrupted.
+		static_assert(RVTH_JOURNAL_CHUNK_LBA == LBA_COUNT_BUF,
+			"Journal chunk size must match the copy buffer size.");
+		journal->verify(entry_dest->reader, buf);
+		lba_resume = journal->resumeLba();
+
+		// NOTE: If the journal can't be written,
+		// copying continues without it.
+		journal->create();
+	}
+
+	if (verifier) {
+		// Start verifying at the resume point. Chunks that were
+		// completed before the import was interrupted aren't verified.
+		ret = verifier->start(lba_resume);
+		if (ret != 0) {
+			err = -ret;
+			goto end;
+		}
+	}
+
 	if (callback) {
 		// Initialize the callback state.
 		state.rvth = rvth_dest;
@@ -797,11 +1533,20 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 		state.lba_processed = 0;
 		state.lba_total = lba_copy_len;
 	}
+	if (m_progress) {
+		m_progress->begin(RVTH_PROGRESS_IMPORT, lba_copy_len);
+	}
 
 	// TODO: Special indicator.
 	// TODO: Optimize seeking? (Reader::write() seeks every time.)
 	lba_buf_max = entry_dest->lba_len & ~(LBA_COUNT_BUF-1);
-	for (lba_count = 0; lba_count < lba_buf_max; lba_count += LBA_COUNT_BUF) {
+	for (lba_count = lba_resume; lba_count < lba_buf_max; lba_count += LBA_COUNT_BUF) {
+		if (m_progress && !m_progress->update(lba_count)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
 		if (callback) {
 			bool bRet;
 			state.lba_processed = lba_count;
@@ -818,18 +1563,129 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 		// GCMs being imported generally won't have the first
 		// 16 KB zeroed out...
 
-		// TODO: Error handling.
-		entry_src->reader->read(buf, lba_count, LBA_COUNT_BUF);
-		entry_dest->reader->write(buf, lba_count, LBA_COUNT_BUF);
+		if (skipHoles && isSourceHole(entry_src->reader, extent, lba_count, LBA_COUNT_BUF)) {
+			// Empty source blocks don't need to be read.
+			// The bank may contain old data, so zeroes are written.
+			if (!bufIsZero) {
+				memset(buf, 0, BUF_SIZE);
+				bufIsZero = true;
+			}
+			if (m_progress) {
+				m_progress->addSkipped(BUF_SIZE);
+			}
+		} else {
+			errno = 0;
+			if (entry_src->reader->read(buf, lba_count, LBA_COUNT_BUF) != LBA_COUNT_BUF) {
+				// Read error.
+				err = (errno != 0 ? errno : EIO);
+				ret = -err;
+				goto end;
+			}
+			fillJunk(buf, lba_count, LBA_COUNT_BUF);
+			bufIsZero = false;
+			if (m_progress) {
+				m_progress->addRead(BUF_SIZE);
+			}
+		}
+		errno = 0;
+		if (entry_dest->reader->write(buf, lba_count, LBA_COUNT_BUF) != LBA_COUNT_BUF) {
+			// Write error.
+			err = (errno != 0 ? errno : EIO);
+			ret = -err;
+			goto end;
+		}
+		if (m_progress) {
+			m_progress->addWritten(BUF_SIZE);
+		}
+		if (journal) {
+			journal->addChunk(entry_dest->reader, lba_count,
+				(bufIsZero ? nullptr : buf), LBA_COUNT_BUF);
+		}
+		if (verifier) {
+			ret = verifier->addChunk(entry_dest->reader, lba_count,
+				(bufIsZero ? nullptr : buf), LBA_COUNT_BUF);
+			if (ret != 0) {
+				err = -ret;
+				goto end;
+			}
+			if (m_progress) {
+				m_progress->addHashed(BUF_SIZE);
+			}
+		}
 	}
 
 	// Process any remaining LBAs.
 	if (lba_count < lba_copy_len) {
 		const unsigned int lba_left = lba_copy_len - lba_count;
-		entry_src->reader->read(buf, lba_count, lba_left);
-		entry_dest->reader->write(buf, lba_count, lba_left);
+		if (m_progress && !m_progress->update(lba_count)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
+		if (skipHoles && isSourceHole(entry_src->reader, extent, lba_count, lba_left)) {
+			memset(buf, 0, LBA_TO_BYTES(lba_left));
+			if (m_progress) {
+				m_progress->addSkipped(LBA_TO_BYTES(lba_left));
+			}
+		} else {
+			errno = 0;
+			if (entry_src->reader->read(buf, lba_count, lba_left) != lba_left) {
+				// Read error.
+				err = (errno != 0 ? errno : EIO);
+				ret = -err;
+				goto end;
+			}
+			fillJunk(buf, lba_count, lba_left);
+			if (m_progress) {
+				m_progress->addRead(LBA_TO_BYTES(lba_left));
+			}
+		}
+		errno = 0;
+		if (entry_dest->reader->write(buf, lba_count, lba_left) != lba_left) {
+			// Write error.
+			err = (errno != 0 ? errno : EIO);
+			ret = -err;
+			goto end;
+		}
+		if (m_progress) {
+			m_progress->addWritten(LBA_TO_BYTES(lba_left));
+		}
+		if (journal) {
+			journal->addChunk(entry_dest->reader, lba_count, buf, lba_left);
+		}
+		if (verifier) {
+			ret = verifier->addChunk(entry_dest->reader, lba_count, buf, lba_left);
+			if (ret != 0) {
+				err = -ret;
+				goto end;
+			}
+			if (m_progress) {
+				m_progress->addHashed(LBA_TO_BYTES(lba_left));
+			}
+		}
+	}
+
+	if (verifier) {
+		// Wait for the rest of the written data to be verified.
+		// If anything doesn't match, the bank entry isn't written.
+		ret = verifier->finish(entry_dest->reader);
+		if (ret != 0) {
+			err = -ret;
+			goto end;
+		} else if (!verifier->errors().empty()) {
+			err = EIO;
+			ret = RVTH_ERROR_IMPORT_VERIFY_FAILED;
+			goto end;
+		}
 	}
 
+	if (m_progress && !m_progress->update(lba_copy_len)) {
+		// Stop processing.
+		err = ECANCELED;
+		ret = -ECANCELED;
+		goto end;
+	}
 	if (callback) {
 		bool bRet;
 		state.lba_processed = lba_copy_len;
@@ -846,33 +1702,401 @@ int RvtH::copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 	entry_dest->reader->flush();
 
 	// Update the bank table.
-	// TODO: Check for errors.
-	rvth_dest->writeBankEntry(bank_dest);
+	ret = rvth_dest->writeBankEntry(bank_dest);
+	if (ret != 0) {
+		err = (ret < 0 ? -ret : EIO);
+		goto end;
+	}
 
 	// Finished importing the disc image.
 
+end:
+	if (ret != 0 && verifier) {
+		verifier->cancel();
+	}
+	if (ret != 0 && journal && entry_dest->reader) {
+		// Save the completed chunks so the import can be resumed.
+		journal->checkpoint(entry_dest->reader);
+	}
+	if (ret != 0) {
+		// Restore the original bank entries.
+		if (entry_dest->reader != entry_dest_orig.reader) {
+			delete entry_dest->reader;
+		}
+		memcpy(entry_dest, &entry_dest_orig, sizeof(*entry_dest));
+		if (entry_dest2) {
+			memcpy(entry_dest2, &entry_dest2_orig, sizeof(*entry_dest2));
+		}
+	} else {
+		// Release the original readers and partition table.
+		delete entry_dest_orig.reader;
+		if (entry_dest2) {
+			delete entry_dest2_orig.reader;
+			free(entry_dest2_orig.ptbl);
+		}
+	}
+	free(buf);
+	if (err != 0) {
+		errno = err;
+	}
+	return ret;
+}
+
+/**
+ * Import a disc image from stdin into a bank on this RVT-H disk image.
+ *
+ * The disc image is copied sequentially until the end of the stream.
+ * If stdin is a pipe, splice() is used to move the data directly
+ * into the HDD without copying it through userspace.
+ *
+ * NOTE: Dual-layer Wii images can't be imported from a stream,
+ * since the image size isn't known until the stream ends.
+ *
+ * @param bank		[in] Bank number. (0-7)
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::importFromStream(unsigned int bank,
+	RvtH_Progress_Callback callback, void *userdata)
+{
+	RefFile *f_in = nullptr;
+	uint8_t *buf = nullptr;
+	size_t size;
+	int type;
+	uint64_t pos;		// Bytes copied.
+	uint64_t pos_max;	// Maximum number of bytes.
+	int64_t offset_start;	// Bank offset in the HDD.
+	bool eof;
+#ifdef HAVE_SPLICE
+	bool useSplice = false;
+#endif /* HAVE_SPLICE */
+
+	// Callback state.
+	RvtH_Progress_State state;
+
+	// Original bank entry, restored if the bank table can't be updated.
+	RvtH_BankEntry entry_orig;
+
+	int ret = 0;	// errno or RvtH_Errors
+	int err = 0;	// errno setting
+
+	if (!isHDD()) {
+		// Destination is not an HDD.
+		errno = EIO;
+		return RVTH_ERROR_NOT_HDD_IMAGE;
+	}
+
+	// Destination bank must be either empty or deleted.
+	RvtH_BankEntry *const entry = &m_entries[bank];
+	if (entry->type != RVTH_BankType_Empty && !entry->is_deleted) {
+		errno = EEXIST;
+		return RVTH_ERROR_BANK_NOT_EMPTY_OR_DELETED;
+	}
+
+	// Make the RVT-H object writable.
+	ret = makeWritable();
+	if (ret != 0) {
+		// Could not make the RVT-H object writable.
+		errno = (ret < 0 ? -ret : EROFS);
+		return ret;
+	}
+
+	// Open stdin.
+	f_in = new RefFile(_T("-"));
+	if (!f_in->isOpen()) {
+		err = f_in->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		f_in->unref();
+		errno = err;
+		return -err;
+	}
+
+	// Process 1 MB at a time.
+	buf = (uint8_t*)malloc(BUF_SIZE);
+	if (!buf) {
+		// Error allocating memory.
+		err = ENOMEM;
+		ret = -ENOMEM;
+		goto end;
+	}
+
+	// Read the first 1 MB to identify the disc image.
+	errno = 0;
+	size = f_in->read(buf, 1, BUF_SIZE);
+	if (size < sizeof(GCN_DiscHeader)) {
+		// Short read.
+		err = (errno != 0 ? errno : EIO);
+		ret = (errno != 0 ? -err : RVTH_ERROR_UNRECOGNIZED_FILE);
+		goto end;
+	}
+	eof = (size < BUF_SIZE);
+	type = rvth_disc_header_identify(reinterpret_cast<const GCN_DiscHeader*>(buf));
+	if (type != RVTH_BankType_GCN && type != RVTH_BankType_Wii_SL) {
+		// Not a GameCube or Wii disc image.
+		err = EIO;
+		ret = RVTH_ERROR_UNRECOGNIZED_FILE;
+		goto end;
+	}
+
+	// Image cannot be larger than a single bank.
+	// For extended bank tables, bank 1 is smaller.
+	pos_max = (bank == 0 && m_bankCount > 8)
+		? LBA_TO_BYTES(NHCD_EXTBANKTABLE_BANK_1_SIZE_LBA)
+		: LBA_TO_BYTES(NHCD_BANK_SIZE_LBA);
+
+	// NOTE: The bank entry is left as-is until the image has been
+	// copied, so if the import fails, it still matches the bank table.
+
+	if (callback) {
+		// Initialize the callback state.
+		// NOTE: The image size isn't known, so the
+		// maximum bank size is used as the total.
+		state.rvth = this;
+		state.rvth_gcm = nullptr;
+		state.bank_rvth = bank;
+		state.bank_gcm = 0;
+		state.type = RVTH_PROGRESS_IMPORT;
+		state.lba_processed = 0;
+		state.lba_total = static_cast<uint32_t>(BYTES_TO_LBA(pos_max));
+	}
+	if (m_progress) {
+		// NOTE: The maximum bank size is used as the total here, too.
+		m_progress->begin(RVTH_PROGRESS_IMPORT, static_cast<uint32_t>(BYTES_TO_LBA(pos_max)));
+		m_progress->addRead(size);
+	}
+
+	// Write the first block.
+	offset_start = LBA_TO_BYTES(entry->lba_start);
+	if (m_file->seeko(offset_start, SEEK_SET) != 0 ||
+	    m_file->write(buf, 1, size) != size)
+	{
+		// Write error.
+		err = (errno != 0 ? errno : EIO);
+		ret = -err;
+		goto end;
+	}
+	pos = size;
+	if (m_progress) {
+		m_progress->addWritten(size);
+	}
+
+#ifdef HAVE_SPLICE
+	if (!eof) {
+		// If stdin is a pipe, splice the rest of the image
+		// directly into the HDD.
+		struct stat sb;
+		if (fstat(f_in->fd(), &sb) == 0 && S_ISFIFO(sb.st_mode)) {
+			useSplice = true;
+			m_file->flush();
+		}
+	}
+#endif /* HAVE_SPLICE */
+
+	while (!eof && pos < pos_max) {
+		if (m_progress && !m_progress->update(static_cast<uint32_t>(BYTES_TO_LBA(pos)))) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
+		if (callback) {
+			state.lba_processed = static_cast<uint32_t>(BYTES_TO_LBA(pos));
+			if (!callback(&state, userdata)) {
+				// Stop processing.
+				err = ECANCELED;
+				ret = -ECANCELED;
+				goto end;
+			}
+		}
+
+		const size_t len = static_cast<size_t>(std::min(
+			static_cast<uint64_t>(BUF_SIZE), pos_max - pos));
+#ifdef HAVE_SPLICE
+		if (useSplice) {
+			loff_t off_out = offset_start + pos;
+			const ssize_t sret = splice(f_in->fd(), nullptr, m_file->fd(), &off_out,
+				len, SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (sret > 0) {
+				pos += sret;
+				if (m_progress) {
+					m_progress->addRead(sret);
+					m_progress->addWritten(sret);
+				}
+				continue;
+			} else if (sret == 0) {
+				// End of stream.
+				eof = true;
+				break;
+			} else if (errno == EINTR) {
+				continue;
+			} else if (errno == EINVAL) {
+				// The HDD doesn't support splice().
+				// Fall back to read() and write().
+				useSplice = false;
+			} else {
+				// Read or write error.
+				err = errno;
+				ret = -err;
+				goto end;
+			}
+		}
+#endif /* HAVE_SPLICE */
+
+		errno = 0;
+		size = f_in->read(buf, 1, len);
+		if (size != len) {
+			if (errno != 0) {
+				// Read error.
+				err = errno;
+				ret = -err;
+				goto end;
+			}
+			// End of stream.
+			eof = true;
+			if (size == 0) {
+				break;
+			}
+		}
+		if (m_progress) {
+			m_progress->addRead(size);
+		}
+		if (m_file->seeko(offset_start + pos, SEEK_SET) != 0 ||
+		    m_file->write(buf, 1, size) != size)
+		{
+			// Write error.
+			err = (errno != 0 ? errno : EIO);
+			ret = -err;
+			goto end;
+		}
+		pos += size;
+		if (m_progress) {
+			m_progress->addWritten(size);
+		}
+	}
+
+	if (!eof) {
+		// Bank is full. Make sure the stream has ended.
+		uint8_t dummy;
+		if (f_in->read(&dummy, 1, 1) != 0) {
+			// Image is too big.
+			err = ENOSPC;
+			ret = RVTH_ERROR_IMAGE_TOO_BIG;
+			goto end;
+		}
+	}
+
+	if (pos % LBA_SIZE != 0) {
+		// Zero-pad the last LBA.
+		const size_t pad = LBA_SIZE - (pos % LBA_SIZE);
+		memset(buf, 0, pad);
+		if (m_file->seeko(offset_start + pos, SEEK_SET) != 0 ||
+		    m_file->write(buf, 1, pad) != pad)
+		{
+			// Write error.
+			err = (errno != 0 ? errno : EIO);
+			ret = -err;
+			goto end;
+		}
+		pos += pad;
+	}
+	m_file->flush();
+
+	// Reinitialize the bank entry from the imported image.
+	// The original entry is kept until the bank table is updated.
+	memcpy(&entry_orig, entry, sizeof(entry_orig));
+	rvth_init_BankEntry(entry, m_file, static_cast<uint8_t>(type),
+		entry_orig.lba_start, static_cast<uint32_t>(BYTES_TO_LBA(pos)), nullptr);
+
+	// Update the bank table.
+	ret = writeBankEntry(bank, &entry->timestamp);
+	if (ret != 0) {
+		// The bank table wasn't updated.
+		// Restore the original bank entry.
+		err = (ret < 0 ? -ret : EIO);
+		delete entry->reader;
+		free(entry->ptbl);
+		memcpy(entry, &entry_orig, sizeof(*entry));
+		goto end;
+	}
+
+	// Release the original reader and partition table.
+	delete entry_orig.reader;
+	free(entry_orig.ptbl);
+
+	if (m_progress) {
+		m_progress->update(static_cast<uint32_t>(BYTES_TO_LBA(pos_max)));
+	}
+	if (callback) {
+		state.lba_processed = state.lba_total;
+		callback(&state, userdata);
+	}
+
 end:
 	free(buf);
+	f_in->unref();
 	if (err != 0) {
 		errno = err;
 	}
 	return ret;
 }
 
+/**
+ * Finish importing a disc image into a bank on this RVT-H disk image.
+ * Retail, fakesigned, and invalid Wii images are converted to debug.
+ * @param bank		[in] Bank number. (0-7)
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::importFinish(unsigned int bank,
+	RvtH_Progress_Callback callback, void *userdata, int ios_force)
+{
+	// Must convert to debug realsigned for use on RVT-H.
+	const RvtH_BankEntry *const entry = this->bankEntry(bank);
+	if (entry &&
+		(entry->type == RVTH_BankType_Wii_SL ||
+		 entry->type == RVTH_BankType_Wii_DL) &&
+		(entry->crypto_type == RVL_CryptoType_Retail ||
+		 entry->crypto_type == RVL_CryptoType_Korean ||
+		 entry->crypto_type == RVL_CryptoType_vWii ||
+	         entry->ticket.sig_status != RVL_SigStatus_OK ||
+		 entry->tmd.sig_status != RVL_SigStatus_OK ||
+		 (ios_force >= 3 && entry->ios_version != ios_force)))
+	{
+		// One of the following conditions:
+		// - Encryption: Retail, Korean, or vWii
+		// - Signature: Invalid
+		// - IOS requested does not match the TMD IOS
+		// Convert to Debug.
+		return recryptWiiPartitions(bank, RVL_CryptoType_Debug, callback, userdata, ios_force);
+	}
+
+	// No recryption needed.
+	// Write the identifier to indicate that this bank was imported.
+	return recryptID(bank);
+}
+
 /**
  * Import a disc image into this RVT-H disk image.
  * Compatibility wrapper; this function creates an RvtH object for the
  * RVT-H disk image and then copyToHDD().
+ * If filename is "-", the disc image is read from stdin.
  * @param bank		[in] Bank number. (0-7)
  * @param filename	[in] Source GCM filename.
  * @param callback	[in,opt] Progress callback.
  * @param userdata	[in,opt] User data for progress callback.
  * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+ * @param bank_src	[in,opt] Source bank number, for WBFS images with multiple discs.
  * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
  */
 int RvtH::import(unsigned int bank, const TCHAR *filename,
 	RvtH_Progress_Callback callback, void *userdata,
-	int ios_force)
+	int ios_force, unsigned int bank_src, unsigned int flags,
+	std::vector<RvtH_VerifyError> *verify_errors)
 {
 	if (!filename || filename[0] == 0) {
 		errno = EINVAL;
@@ -883,8 +2107,26 @@ int RvtH::import(unsigned int bank, const TCHAR *filename,
 		return -ERANGE;
 	}
 
-	// Open the standalone disc image.
 	int ret = 0;
+	if (RefFile::isStreamFilename(filename)) {
+		// Import the disc image from stdin.
+		if (bank_src != 0) {
+			// Streams only contain a single disc image.
+			errno = ERANGE;
+			return -ERANGE;
+		} else if (flags & RVTH_IMPORT_VERIFY) {
+			// TODO: Verify stream imports?
+			errno = ENOTSUP;
+			return -ENOTSUP;
+		}
+		ret = importFromStream(bank, callback, userdata);
+		if (ret == 0) {
+			ret = importFinish(bank, callback, userdata, ios_force);
+		}
+		return ret;
+	}
+
+	// Open the standalone disc image.
 	RvtH *const rvth_src = new RvtH(filename, &ret);
 	if (!rvth_src->isOpen()) {
 		// Error opening the standalone disc image.
@@ -893,8 +2135,10 @@ int RvtH::import(unsigned int bank, const TCHAR *filename,
 		}
 		delete rvth_src;
 		return ret;
-	} else if (rvth_src->isHDD() || rvth_src->bankCount() > 1) {
-		// Not a standalone disc image.
+	} else if (rvth_src->isHDD() ||
+		   (rvth_src->bankCount() > 1 && rvth_src->imageType() != RVTH_ImageType_WBFS))
+	{
+		// Not a standalone disc image or WBFS image.
 		delete rvth_src;
 		errno = EINVAL;
 		return RVTH_ERROR_IS_HDD_IMAGE;
@@ -904,39 +2148,49 @@ int RvtH::import(unsigned int bank, const TCHAR *filename,
 		delete rvth_src;
 		errno = EINVAL;
 		return RVTH_ERROR_NO_BANKS;
+	} else if (bank_src >= rvth_src->bankCount()) {
+		// Source bank number is out of range.
+		delete rvth_src;
+		errno = ERANGE;
+		return -ERANGE;
+	}
+
+	// Keep a resume journal next to the source disc image.
+	const tstring journal_filename = tstring(filename) + RVTH_JOURNAL_IMPORT_FILE_EXT;
+	Journal *const journal = new Journal(journal_filename.c_str(), RVTH_JOURNAL_TYPE_IMPORT,
+		bank_src, bank, rvth_src->bankEntry(bank_src), 0);
+	if (flags & RVTH_IMPORT_RESUME) {
+		// If there's no matching journal, the import starts over.
+		journal->load();
+	}
+
+	ImportVerifier *verifier = nullptr;
+	if (flags & RVTH_IMPORT_VERIFY) {
+		verifier = new ImportVerifier(m_file->filename(), m_entries[bank].lba_start,
+			rvth_src->bankEntry(bank_src)->lba_len);
 	}
 
 	// Copy the bank from the source GCM to the HDD.
 	// TODO: HDD to HDD?
 	// NOTE: `bank` parameter starts at 0, not 1.
-	ret = rvth_src->copyToHDD(this, bank, 0, callback, userdata);
+	// NOTE: The copy loop runs on rvth_src, so it needs our progress sink.
+	rvth_src->setProgressSink(m_progress);
+	ret = rvth_src->copyToHDD(this, bank, bank_src, callback, userdata, journal, verifier);
 	if (ret == 0) {
-		// Must convert to debug realsigned for use on RVT-H.
-		const RvtH_BankEntry *const entry = this->bankEntry(bank);
-		if (entry &&
-			(entry->type == RVTH_BankType_Wii_SL ||
-			 entry->type == RVTH_BankType_Wii_DL) &&
-			(entry->crypto_type == RVL_CryptoType_Retail ||
-			 entry->crypto_type == RVL_CryptoType_Korean ||
-			 entry->crypto_type == RVL_CryptoType_vWii ||
-		         entry->ticket.sig_status != RVL_SigStatus_OK ||
-			 entry->tmd.sig_status != RVL_SigStatus_OK ||
-			 (ios_force >= 3 && entry->ios_version != ios_force)))
-		{
-			// One of the following conditions:
-			// - Encryption: Retail, Korean, or vWii
-			// - Signature: Invalid
-			// - IOS requested does not match the TMD IOS
-			// Convert to Debug.
-			ret = recryptWiiPartitions(bank, RVL_CryptoType_Debug, callback, userdata, ios_force);
-		}
-		else
-		{
-			// No recryption needed.
-			// Write the identifier to indicate that this bank was imported.
-			ret = recryptID(bank);
+		// Copy is complete. The bank entry has been written,
+		// so the import can't be resumed after this point.
+		journal->remove();
+		ret = importFinish(bank, callback, userdata, ios_force);
+	} else if (ret == RVTH_ERROR_IMPORT_VERIFY_FAILED) {
+		// Resuming would skip the mismatched chunks,
+		// so the import has to start over.
+		journal->remove();
+		if (verify_errors) {
+			*verify_errors = verifier->errors();
 		}
 	}
+	delete verifier;
+	delete journal;
 	delete rvth_src;
 	return ret;
 }
@@ -21,6 +21,7 @@
 #include "rvth.hpp"
 #include "disc_header.hpp"
 #include "ptbl.h"
+#include "ProgressSink.hpp"
 #include "rvth_error.h"
 
 #include "byteswap.h"
@@ -561,6 +562,9 @@ int RvtH::copyToGcm_doCrypt(RvtH *rvth_dest, unsigned int bank_src,
 		state.lba_processed = 0;
 		state.lba_total = lba_copy_len;
 	}
+	if (m_progress) {
+		m_progress->begin(RVTH_PROGRESS_EXTRACT, lba_copy_len);
+	}
 
 	// Decrypt the title key.
 	ret = decrypt_title_key(&pthdr.ticket, titleKey, &entry_dest->crypto_type);
@@ -578,6 +582,12 @@ int RvtH::copyToGcm_doCrypt(RvtH *rvth_dest, unsigned int bank_src,
 	     lba_count_dec < lba_max_dec;
 	     lba_count_dec += LBA_COUNT_DEC, lba_count_enc += LBA_COUNT_ENC, pH3 += SHA1_DIGEST_SIZE)
 	{
+		if (m_progress && !m_progress->update(lba_count_dec)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
 		if (callback) {
 			bool bRet;
 			state.lba_processed = lba_count_dec;
@@ -600,12 +610,24 @@ int RvtH::copyToGcm_doCrypt(RvtH *rvth_dest, unsigned int bank_src,
 
 		// Write 64 encrypted sectors.
 		entry_dest->reader->write(buf_enc, data_lba_dest + lba_count_enc, LBA_COUNT_ENC);
+
+		if (m_progress) {
+			m_progress->addRead(GROUP_SIZE_DEC);
+			m_progress->addHashed(GROUP_SIZE_DEC);
+			m_progress->addWritten(GROUP_SIZE_ENC);
+		}
 	}
 
 	// If we have leftover, write a padded group.
 	if (lba_count_dec < lba_copy_len) {
 		const unsigned int lba_left = lba_copy_len - lba_count_dec;
 
+		if (m_progress && !m_progress->update(lba_count_dec)) {
+			// Stop processing.
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto end;
+		}
 		if (callback) {
 			bool bRet;
 			state.lba_processed = lba_count_dec;
@@ -627,6 +649,12 @@ int RvtH::copyToGcm_doCrypt(RvtH *rvth_dest, unsigned int bank_src,
 
 		// Write 64 encrypted sectors.
 		entry_dest->reader->write(buf_enc, data_lba_dest + lba_count_enc, LBA_COUNT_ENC);
+
+		if (m_progress) {
+			m_progress->addRead(LBA_TO_BYTES(lba_left));
+			m_progress->addHashed(GROUP_SIZE_DEC);
+			m_progress->addWritten(GROUP_SIZE_ENC);
+		}
 	}
 
 	/** Update the partition header. **/
@@ -660,6 +688,12 @@ int RvtH::copyToGcm_doCrypt(RvtH *rvth_dest, unsigned int bank_src,
 		game_pte->lba_start + BYTES_TO_LBA(sizeof(pthdr)),
 		BYTES_TO_LBA(sizeof(*H3_tbl)));
 
+	if (m_progress && !m_progress->update(lba_copy_len)) {
+		// Stop processing.
+		err = ECANCELED;
+		ret = -ECANCELED;
+		goto end;
+	}
 	if (callback) {
 		bool bRet;
 		state.lba_processed = lba_copy_len;
@@ -0,0 +1,359 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * journal.cpp: Resume journal for interrupted extract/import operations.  *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "journal.hpp"
+
+#include "byteswap.h"
+#include "nhcd_structs.h"
+#include "RefFile.hpp"
+#include "reader/Reader.hpp"
+
+// zlib
+#include <zlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+/**
+ * Calculate the CRC32 of a range of zero bytes.
+ * @param size Size, in bytes.
+ * @return CRC32.
+ */
+static uint32_t crc32_zero(size_t size)
+{
+	static const uint8_t zero_buf[65536] = { 0 };
+	uLong crc = crc32(0, nullptr, 0);
+	while (size > 0) {
+		const size_t len = std::min(size, sizeof(zero_buf));
+		crc = crc32(crc, zero_buf, static_cast<uInt>(len));
+		size -= len;
+	}
+	return static_cast<uint32_t>(crc);
+}
+
+/**
+ * Create a resume journal for a copy operation.
+ * The journal file isn't accessed until load() or create() is called.
+ * @param filename	[in] Journal filename.
+ * @param type		[in] Journal type.
+ * @param bank_src	[in] Source bank number.
+ * @param bank_dest	[in] Destination bank number.
+ * @param entry_src	[in] Source bank entry.
+ * @param flags		[in] Flags that affect the copied data. (e.g. RvtH_Extract_Flags)
+ */
+Journal::Journal(const TCHAR *filename, RvtH_Journal_Type type,
+	unsigned int bank_src, unsigned int bank_dest,
+	const RvtH_BankEntry *entry_src, unsigned int flags)
+	: m_filename(filename)
+	, m_file(nullptr)
+	, m_failed(false)
+	, m_dirty(0)
+{
+	assert(entry_src != nullptr);
+
+	memset(&m_header, 0, sizeof(m_header));
+	memcpy(m_header.magic, RVTH_JOURNAL_FILE_MAGIC, sizeof(m_header.magic));
+	m_header.version = RVTH_JOURNAL_FILE_VERSION;
+	m_header.type = type;
+	m_header.bank_src = bank_src;
+	m_header.bank_dest = bank_dest;
+	m_header.lba_start = entry_src->lba_start;
+	m_header.lba_len = entry_src->lba_len;
+	m_header.chunk_lba = RVTH_JOURNAL_CHUNK_LBA;
+	m_header.chunk_count = (entry_src->lba_len + RVTH_JOURNAL_CHUNK_LBA - 1) / RVTH_JOURNAL_CHUNK_LBA;
+	m_header.flags = flags;
+	static_assert(sizeof(m_header.disc_header) <= sizeof(entry_src->discHeader),
+		"disc_header is larger than GCN_DiscHeader");
+	memcpy(m_header.disc_header, &entry_src->discHeader, sizeof(m_header.disc_header));
+
+	m_bitmap.resize((m_header.chunk_count + 7) / 8);
+	m_crcs.resize(m_header.chunk_count);
+}
+
+Journal::~Journal()
+{
+	// NOTE: The journal file is left on disk so the
+	// operation can be resumed later.
+	if (m_file) {
+		m_file->unref();
+	}
+}
+
+/**
+ * Load the journal file from an interrupted operation.
+ * The journal is only loaded if it matches this operation.
+ * @return 0 on success; -ENOENT if there's no matching journal; or negative POSIX error code on error.
+ */
+int Journal::load(void)
+{
+	RefFile *const f_journal = new RefFile(m_filename.c_str());
+	if (!f_journal->isOpen()) {
+		int err = f_journal->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		f_journal->unref();
+		errno = err;
+		return -err;
+	}
+
+	int ret = 0;
+	RvtH_JournalFile_Header header;
+	errno = 0;
+	if (f_journal->read(&header, 1, sizeof(header)) != sizeof(header)) {
+		ret = (errno != 0 ? -errno : -EIO);
+	} else {
+		header.version		= be32_to_cpu(header.version);
+		header.type		= be32_to_cpu(header.type);
+		header.bank_src		= be32_to_cpu(header.bank_src);
+		header.bank_dest	= be32_to_cpu(header.bank_dest);
+		header.lba_start	= be32_to_cpu(header.lba_start);
+		header.lba_len		= be32_to_cpu(header.lba_len);
+		header.chunk_lba	= be32_to_cpu(header.chunk_lba);
+		header.chunk_count	= be32_to_cpu(header.chunk_count);
+		header.flags		= be32_to_cpu(header.flags);
+
+		if (memcmp(&header, &m_header, sizeof(header)) != 0) {
+			// Journal is for a different operation.
+			ret = -ENOENT;
+		}
+	}
+
+	if (ret == 0) {
+		vector<uint8_t> bitmap(m_bitmap.size());
+		vector<uint32_t> crcs(m_crcs.size());
+		errno = 0;
+		if (f_journal->read(bitmap.data(), 1, bitmap.size()) != bitmap.size() ||
+		    f_journal->read(crcs.data(), sizeof(uint32_t), crcs.size()) != crcs.size())
+		{
+			ret = (errno != 0 ? -errno : -EIO);
+		} else {
+#if SYS_BYTEORDER != SYS_BIG_ENDIAN
+			for (uint32_t &crc : crcs) {
+				crc = be32_to_cpu(crc);
+			}
+#endif /* SYS_BYTEORDER != SYS_BIG_ENDIAN */
+			m_bitmap.swap(bitmap);
+			m_crcs.swap(crcs);
+		}
+	}
+
+	f_journal->unref();
+	if (ret != 0) {
+		errno = -ret;
+	}
+	return ret;
+}
+
+/**
+ * Create the journal file.
+ * If a journal was loaded, its completed chunks are kept.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int Journal::create(void)
+{
+	if (m_file) {
+		m_file->unref();
+	}
+	m_file = new RefFile(m_filename.c_str(), true);
+	if (!m_file->isOpen()) {
+		int err = m_file->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		m_file->unref();
+		m_file = nullptr;
+		m_failed = true;
+		errno = err;
+		return -err;
+	}
+
+	m_failed = false;
+	return checkpoint(nullptr);
+}
+
+/**
+ * Verify completed chunks by reading them back from the destination.
+ * The first chunk and the last RVTH_JOURNAL_VERIFY_CHUNKS completed
+ * chunks are verified. If a chunk doesn't match, it and all chunks
+ * after it are marked as incomplete.
+ * Chunks that can't be read are handled as mismatches.
+ * @param reader_dest	[in] Destination disc image reader.
+ * @param buf		[in] Temporary buffer. (Must be at least one chunk.)
+ */
+void Journal::verify(Reader *reader_dest, uint8_t *buf)
+{
+	const uint32_t resume_chunk = firstIncompleteChunk();
+
+	// Verify the first chunk to make sure the destination
+	// is actually the one the journal was written for,
+	// then verify the end of the completed range.
+	const uint32_t tail_start = (resume_chunk > RVTH_JOURNAL_VERIFY_CHUNKS)
+		? (resume_chunk - RVTH_JOURNAL_VERIFY_CHUNKS)
+		: 1;
+	for (uint32_t chunk = 0; chunk < resume_chunk;
+	     chunk = (chunk == 0 ? tail_start : chunk + 1))
+	{
+		const uint32_t lba_start = chunk * m_header.chunk_lba;
+		const uint32_t lba_len = std::min(m_header.chunk_lba, m_header.lba_len - lba_start);
+
+		if (reader_dest->read(buf, lba_start, lba_len) != lba_len ||
+		    crc32(crc32(0, nullptr, 0), buf, static_cast<uInt>(LBA_TO_BYTES(lba_len))) != m_crcs[chunk])
+		{
+			// Chunk doesn't match. Mark it and
+			// all chunks after it as incomplete.
+			for (uint32_t i = chunk; i < m_header.chunk_count; i++) {
+				m_bitmap[i / 8] &= ~(0x80U >> (i % 8));
+			}
+			break;
+		}
+	}
+}
+
+/**
+ * Get the index of the first incomplete chunk.
+ * @return Chunk index. (chunk_count if all chunks are complete)
+ */
+uint32_t Journal::firstIncompleteChunk(void) const
+{
+	for (uint32_t i = 0; i < m_header.chunk_count; i++) {
+		if (!(m_bitmap[i / 8] & (0x80U >> (i % 8)))) {
+			return i;
+		}
+	}
+	return m_header.chunk_count;
+}
+
+/**
+ * Get the LBA to resume copying from.
+ * This is the first LBA of the first incomplete chunk.
+ * @return Resume LBA. (lba_len if all chunks are complete)
+ */
+uint32_t Journal::resumeLba(void) const
+{
+	const uint32_t chunk = firstIncompleteChunk();
+	return (chunk < m_header.chunk_count)
+		? (chunk * m_header.chunk_lba)
+		: m_header.lba_len;
+}
+
+/**
+ * Mark a chunk as completed.
+ * The journal is written after every RVTH_JOURNAL_CHECKPOINT_CHUNKS chunks.
+ * @param reader_dest	[in] Destination disc image reader. (Flushed before writing the journal.)
+ * @param lba_start	[in] Starting LBA of the chunk.
+ * @param data		[in] Chunk data as written to the destination. (If NULL, the chunk is all zeroes.)
+ * @param lba_len	[in] Length of the chunk, in LBAs.
+ */
+void Journal::addChunk(Reader *reader_dest, uint32_t lba_start, const uint8_t *data, uint32_t lba_len)
+{
+	assert(lba_start % m_header.chunk_lba == 0);
+	assert(lba_len == std::min(m_header.chunk_lba, m_header.lba_len - lba_start));
+	const uint32_t chunk = lba_start / m_header.chunk_lba;
+	if (chunk >= m_header.chunk_count) {
+		// Out of range.
+		return;
+	}
+
+	const size_t size = static_cast<size_t>(LBA_TO_BYTES(lba_len));
+	m_crcs[chunk] = (data)
+		? static_cast<uint32_t>(crc32(crc32(0, nullptr, 0), data, static_cast<uInt>(size)))
+		: crc32_zero(size);
+	m_bitmap[chunk / 8] |= (0x80U >> (chunk % 8));
+
+	if (++m_dirty >= RVTH_JOURNAL_CHECKPOINT_CHUNKS) {
+		// NOTE: Errors are ignored here. If the journal can't
+		// be written, the copy continues without it.
+		checkpoint(reader_dest);
+	}
+}
+
+/**
+ * Write the journal file.
+ * @param reader_dest	[in] Destination disc image reader. (Flushed before writing the journal.)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int Journal::checkpoint(Reader *reader_dest)
+{
+	m_dirty = 0;
+	if (!m_file || m_failed) {
+		// Journal isn't available.
+		return -EBADF;
+	}
+
+	// Make sure the completed chunks are actually written
+	// before marking them as complete in the journal.
+	if (reader_dest) {
+		reader_dest->flush();
+	}
+
+	RvtH_JournalFile_Header header = m_header;
+	header.version		= cpu_to_be32(header.version);
+	header.type		= cpu_to_be32(header.type);
+	header.bank_src		= cpu_to_be32(header.bank_src);
+	header.bank_dest	= cpu_to_be32(header.bank_dest);
+	header.lba_start	= cpu_to_be32(header.lba_start);
+	header.lba_len		= cpu_to_be32(header.lba_len);
+	header.chunk_lba	= cpu_to_be32(header.chunk_lba);
+	header.chunk_count	= cpu_to_be32(header.chunk_count);
+	header.flags		= cpu_to_be32(header.flags);
+
+#if SYS_BYTEORDER != SYS_BIG_ENDIAN
+	vector<uint32_t> crcs_be(m_crcs);
+	for (uint32_t &crc : crcs_be) {
+		crc = cpu_to_be32(crc);
+	}
+#else /* SYS_BYTEORDER == SYS_BIG_ENDIAN */
+	const vector<uint32_t> &crcs_be = m_crcs;
+#endif
+
+	// The journal is always the same size,
+	// so it's overwritten in place.
+	int ret = 0;
+	errno = 0;
+	if (m_file->seeko(0, SEEK_SET) != 0 ||
+	    m_file->write(&header, 1, sizeof(header)) != sizeof(header) ||
+	    m_file->write(m_bitmap.data(), 1, m_bitmap.size()) != m_bitmap.size() ||
+	    m_file->write(crcs_be.data(), sizeof(uint32_t), crcs_be.size()) != crcs_be.size() ||
+	    m_file->flush() != 0)
+	{
+		ret = (errno != 0 ? -errno : -EIO);
+		m_failed = true;
+	}
+
+	if (ret != 0) {
+		errno = -ret;
+	}
+	return ret;
+}
+
+/**
+ * Delete the journal file.
+ * This should be done once the operation has completed.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int Journal::remove(void)
+{
+	if (m_file) {
+		m_file->unref();
+		m_file = nullptr;
+	}
+	m_failed = true;
+
+	if (::_tremove(m_filename.c_str()) != 0 && errno != ENOENT) {
+		return -errno;
+	}
+	return 0;
+}
@@ -0,0 +1,185 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * journal.hpp: Resume journal for interrupted extract/import operations.  *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_JOURNAL_HPP__
+#define __RVTHTOOL_LIBRVTH_JOURNAL_HPP__
+
+#include "rvth.hpp"
+
+// C includes.
+#include <stdint.h>
+
+// C++ includes.
+#include <string>
+#include <vector>
+
+class RefFile;
+class Reader;
+
+// Resume journal file extensions.
+// Extraction journals are stored next to the extracted disc image.
+// Import journals are stored next to the disc image being imported,
+// since the destination is usually a device.
+#define RVTH_JOURNAL_FILE_EXT		_T(".resume")
+#define RVTH_JOURNAL_IMPORT_FILE_EXT	_T(".import.resume")
+
+// Chunk size, in LBAs. (1 MB; same as the copy buffer)
+#define RVTH_JOURNAL_CHUNK_LBA		2048U
+
+// The journal is written after every 32 completed chunks. (32 MB)
+#define RVTH_JOURNAL_CHECKPOINT_CHUNKS	32U
+
+// Number of completed chunks at the end of the completed range
+// that are read back and verified when resuming. This must be
+// larger than the checkpoint interval, since an interrupted
+// journal write may mark recent chunks as complete.
+#define RVTH_JOURNAL_VERIFY_CHUNKS	(RVTH_JOURNAL_CHECKPOINT_CHUNKS * 2)
+
+// Journal types.
+typedef enum {
+	RVTH_JOURNAL_TYPE_EXTRACT	= 1,	// Bank to standalone disc image
+	RVTH_JOURNAL_TYPE_IMPORT	= 2,	// Standalone disc image to bank
+} RvtH_Journal_Type;
+
+// Resume journal file header.
+// All fields are big-endian.
+// The header is followed by the completed chunk bitmap
+// (MSB first), and then a CRC32 for each chunk.
+#define RVTH_JOURNAL_FILE_MAGIC		"RVTHRSUM"
+#define RVTH_JOURNAL_FILE_VERSION	1
+typedef struct _RvtH_JournalFile_Header {
+	char magic[8];			// [0x000] "RVTHRSUM"
+	uint32_t version;		// [0x008] Version. (1)
+	uint32_t type;			// [0x00C] Journal type. (See RvtH_Journal_Type.)
+	uint32_t bank_src;		// [0x010] Source bank number.
+	uint32_t bank_dest;		// [0x014] Destination bank number.
+	uint32_t lba_start;		// [0x018] Starting LBA of the source bank.
+	uint32_t lba_len;		// [0x01C] Number of LBAs being copied.
+	uint32_t chunk_lba;		// [0x020] Chunk size, in LBAs.
+	uint32_t chunk_count;		// [0x024] Number of chunks.
+	uint32_t flags;			// [0x028] Flags that affect the copied data.
+	uint8_t disc_header[64];	// [0x02C] Start of the source disc header.
+} RvtH_JournalFile_Header;
+ASSERT_STRUCT(RvtH_JournalFile_Header, 0x6C);
+
+/**
+ * Resume journal for extract and import operations.
+ *
+ * The journal records which chunks of the destination have been
+ * completely written, along with a CRC32 of each chunk's contents
+ * as stored in the destination. If the operation is interrupted,
+ * it can be resumed from the last good chunk.
+ *
+ * Chunks must be completed in ascending order.
+ *
+ * The journal is best-effort: if it can't be written, the copy
+ * continues without it.
+ */
+class Journal
+{
+	public:
+		/**
+		 * Create a resume journal for a copy operation.
+		 * The journal file isn't accessed until load() or create() is called.
+		 * @param filename	[in] Journal filename.
+		 * @param type		[in] Journal type.
+		 * @param bank_src	[in] Source bank number.
+		 * @param bank_dest	[in] Destination bank number.
+		 * @param entry_src	[in] Source bank entry.
+		 * @param flags		[in] Flags that affect the copied data. (e.g. RvtH_Extract_Flags)
+		 */
+		Journal(const TCHAR *filename, RvtH_Journal_Type type,
+			unsigned int bank_src, unsigned int bank_dest,
+			const RvtH_BankEntry *entry_src, unsigned int flags);
+		~Journal();
+
+	private:
+		DISABLE_COPY(Journal)
+
+	public:
+		/**
+		 * Load the journal file from an interrupted operation.
+		 * The journal is only loaded if it matches this operation.
+		 * @return 0 on success; -ENOENT if there's no matching journal; or negative POSIX error code on error.
+		 */
+		int load(void);
+
+		/**
+		 * Create the journal file.
+		 * If a journal was loaded, its completed chunks are kept.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int create(void);
+
+		/**
+		 * Verify completed chunks by reading them back from the destination.
+		 * The first chunk and the last RVTH_JOURNAL_VERIFY_CHUNKS completed
+		 * chunks are verified. If a chunk doesn't match, it and all chunks
+		 * after it are marked as incomplete.
+		 * Chunks that can't be read are handled as mismatches.
+		 * @param reader_dest	[in] Destination disc image reader.
+		 * @param buf		[in] Temporary buffer. (Must be at least one chunk.)
+		 */
+		void verify(Reader *reader_dest, uint8_t *buf);
+
+		/**
+		 * Get the LBA to resume copying from.
+		 * This is the first LBA of the first incomplete chunk.
+		 * @return Resume LBA. (lba_len if all chunks are complete)
+		 */
+		uint32_t resumeLba(void) const;
+
+		/**
+		 * Mark a chunk as completed.
+		 * The journal is written after every RVTH_JOURNAL_CHECKPOINT_CHUNKS chunks.
+		 * @param reader_dest	[in] Destination disc image reader. (Flushed before writing the journal.)
+		 * @param lba_start	[in] Starting LBA of the chunk.
+		 * @param data		[in] Chunk data as written to the destination. (If NULL, the chunk is all zeroes.)
+		 * @param lba_len	[in] Length of the chunk, in LBAs.
+		 */
+		void addChunk(Reader *reader_dest, uint32_t lba_start, const uint8_t *data, uint32_t lba_len);
+
+		/**
+		 * Write the journal file.
+		 * @param reader_dest	[in] Destination disc image reader. (Flushed before writing the journal.)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int checkpoint(Reader *reader_dest);
+
+		/**
+		 * Delete the journal file.
+		 * This should be done once the operation has completed.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int remove(void);
+
+	private:
+		/**
+		 * Get the index of the first incomplete chunk.
+		 * @return Chunk index. (chunk_count if all chunks are complete)
+		 */
+		uint32_t firstIncompleteChunk(void) const;
+
+	private:
+		std::tstring m_filename;
+		RefFile *m_file;	// Journal file. (NULL if not created)
+		bool m_failed;		// True if writing the journal failed.
+
+		// Journal header. (host-endian)
+		RvtH_JournalFile_Header m_header;
+
+		// Completed chunk bitmap. (MSB first)
+		std::vector<uint8_t> m_bitmap;
+		// CRC32 of each chunk. (host-endian)
+		std::vector<uint32_t> m_crcs;
+
+		// Number of chunks completed since the last checkpoint.
+		unsigned int m_dirty;
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_JOURNAL_HPP__ */
@@ -0,0 +1,517 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * junk.cpp: GameCube/Wii junk data generator.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "junk.hpp"
+#include "rvth_error.h"
+#include "simd.h"
+
+#include "byteswap.h"
+#include "nhcd_structs.h"
+#include "RefFile.hpp"
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+// References:
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/LaggedFibonacciGenerator.cpp
+
+/** LaggedFibonacci **/
+
+LaggedFibonacci::LaggedFibonacci()
+	: m_position(0)
+{
+	memset(m_buffer, 0, sizeof(m_buffer));
+}
+
+/**
+ * Set the seed.
+ * The generator will be positioned at the start of the junk data.
+ * @param seed Seed. (host-endian)
+ */
+void LaggedFibonacci::setSeed(const uint32_t seed[SEED_SIZE])
+{
+	m_position = 0;
+	memcpy(m_buffer, seed, SEED_SIZE * sizeof(uint32_t));
+	initialize(false);
+}
+
+/**
+ * Skip junk data.
+ * @param count Number of bytes to skip.
+ */
+void LaggedFibonacci::skip(uint64_t count)
+{
+	count += m_position;
+	for (; count >= BUF_SIZE; count -= BUF_SIZE) {
+		forward();
+	}
+	m_position = static_cast<size_t>(count);
+}
+
+/**
+ * Generate junk data.
+ * @param out Output buffer.
+ * @param count Number of bytes to generate.
+ */
+void LaggedFibonacci::getBytes(uint8_t *out, size_t count)
+{
+	const uint8_t *const buf8 = reinterpret_cast<const uint8_t*>(m_buffer);
+	while (count > 0) {
+		const size_t len = std::min(count, BUF_SIZE - m_position);
+		memcpy(out, &buf8[m_position], len);
+		m_position += len;
+		out += len;
+		count -= len;
+
+		if (m_position == BUF_SIZE) {
+			forward();
+			m_position = 0;
+		}
+	}
+}
+
+/**
+ * Advance to the next junk data buffer.
+ */
+void LaggedFibonacci::forward(void)
+{
+#ifdef RVTH_HAS_SSE2
+	// Each word only depends on words that are at least
+	// LFG_J words earlier, so 4 words can be processed at once.
+	__m128i *const buf128 = reinterpret_cast<__m128i*>(m_buffer);
+	for (unsigned int i = 0; i < LFG_J; i += 4) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_buffer[i]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_buffer[i + LFG_K - LFG_J]));
+		_mm_storeu_si128(&buf128[i / 4], _mm_xor_si128(a, b));
+	}
+	unsigned int i;
+	for (i = LFG_J; i + 4 <= LFG_K; i += 4) {
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_buffer[i]));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&m_buffer[i - LFG_J]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&m_buffer[i]), _mm_xor_si128(a, b));
+	}
+	for (; i < LFG_K; i++) {
+		m_buffer[i] ^= m_buffer[i - LFG_J];
+	}
+#else /* !RVTH_HAS_SSE2 */
+	for (unsigned int i = 0; i < LFG_J; i++) {
+		m_buffer[i] ^= m_buffer[i + LFG_K - LFG_J];
+	}
+	for (unsigned int i = LFG_J; i < LFG_K; i++) {
+		m_buffer[i] ^= m_buffer[i - LFG_J];
+	}
+#endif /* RVTH_HAS_SSE2 */
+}
+
+/**
+ * Revert forward() for a range of words.
+ * @param start_word First word.
+ * @param end_word Last word, plus one.
+ */
+void LaggedFibonacci::backward(size_t start_word, size_t end_word)
+{
+	const size_t loop_end = std::max(static_cast<size_t>(LFG_J), start_word);
+	for (size_t i = std::min(end_word, static_cast<size_t>(LFG_K)); i > loop_end; i--) {
+		m_buffer[i - 1] ^= m_buffer[i - 1 - LFG_J];
+	}
+	for (size_t i = std::min(end_word, static_cast<size_t>(LFG_J)); i > start_word; i--) {
+		m_buffer[i - 1] ^= m_buffer[i - 1 + LFG_K - LFG_J];
+	}
+}
+
+/**
+ * Initialize the junk data buffer from the seed.
+ * @param check_existing_data If true, verify that the existing buffer matches the seed.
+ * @return True on success; false if check_existing_data is true and the buffer doesn't match.
+ */
+bool LaggedFibonacci::initialize(bool check_existing_data)
+{
+	for (unsigned int i = SEED_SIZE; i < LFG_K; i++) {
+		const uint32_t calculated = (m_buffer[i - 17] << 23) ^ (m_buffer[i - 16] >> 9) ^ m_buffer[i - 1];
+		if (check_existing_data) {
+			const uint32_t actual = (m_buffer[i] & 0xFF00FFFF) | ((m_buffer[i] << 2) & 0x00FC0000);
+			if ((calculated & 0xFFFCFFFF) != actual)
+				return false;
+		}
+		m_buffer[i] = calculated;
+	}
+
+	// The junk data is output with a shift of 18 instead of 16 for
+	// the third byte. Do that here so getBytes() is a plain copy.
+	for (unsigned int i = 0; i < LFG_K; i++) {
+		const uint32_t x = m_buffer[i];
+		m_buffer[i] = cpu_to_be32((x & 0xFF00FFFF) | ((x >> 2) & 0x00FF0000));
+	}
+
+	for (unsigned int i = 0; i < 4; i++) {
+		forward();
+	}
+	return true;
+}
+
+/**
+ * Recover the seed from the junk data buffer.
+ * The buffer must be positioned at the start of the junk data.
+ * @param seed_out Seed. (host-endian)
+ * @return True on success; false if the buffer isn't valid junk data.
+ */
+bool LaggedFibonacci::reinitialize(uint32_t seed_out[SEED_SIZE])
+{
+	for (unsigned int i = 0; i < 4; i++) {
+		backward();
+	}
+	for (unsigned int i = 0; i < LFG_K; i++) {
+		m_buffer[i] = be32_to_cpu(m_buffer[i]);
+	}
+
+	// Reconstruct the bits that were lost due to the shift of 18.
+	// Bits 16 and 17 of the first word can't be reconstructed,
+	// but they don't affect the output.
+	for (unsigned int i = 0; i < SEED_SIZE; i++) {
+		m_buffer[i] = (m_buffer[i] & 0xFF00FFFF) | ((m_buffer[i] << 2) & 0x00FC0000) |
+			(((m_buffer[i + 16] ^ m_buffer[i + 15]) << 9) & 0x00030000);
+	}
+	memcpy(seed_out, m_buffer, SEED_SIZE * sizeof(uint32_t));
+	return initialize(true);
+}
+
+/**
+ * Recover the seed from junk data.
+ * @param data		[in] Data. (Must be 32-bit aligned.)
+ * @param size		[in] Size of data.
+ * @param data_offset	[in] Offset of data relative to the start of the junk data.
+ * @param seed_out	[out] Seed. (host-endian)
+ * @return Number of bytes at the start of data that match the recovered seed.
+ */
+size_t LaggedFibonacci::getSeed(const uint8_t *data, size_t size, size_t data_offset, uint32_t seed_out[SEED_SIZE])
+{
+	// Only whole words are used to recover the seed.
+	const size_t bytes_to_skip = ((data_offset + 3) & ~(size_t)3) - data_offset;
+	if (size < bytes_to_skip + BUF_SIZE)
+		return 0;
+	const uint32_t *const data32 = reinterpret_cast<const uint32_t*>(data + bytes_to_skip);
+	const size_t data32_offset = (data_offset + bytes_to_skip) / 4;
+
+	// Quick check: Every word of junk data has the same value
+	// in bits 22-23 and 24-25 due to the shift of 18.
+	for (unsigned int i = 0; i < LFG_K; i++) {
+		const uint32_t x = be32_to_cpu(data32[i]);
+		if ((x & 0x00C00000) != ((x >> 2) & 0x00C00000))
+			return 0;
+	}
+
+	// Load the buffer and rewind it to the start of the junk data.
+	LaggedFibonacci lfg;
+	const size_t offset_mod_k = data32_offset % LFG_K;
+	const size_t offset_div_k = data32_offset / LFG_K;
+	memcpy(&lfg.m_buffer[offset_mod_k], data32, (LFG_K - offset_mod_k) * sizeof(uint32_t));
+	memcpy(lfg.m_buffer, &data32[LFG_K - offset_mod_k], offset_mod_k * sizeof(uint32_t));
+	lfg.backward(0, offset_mod_k);
+	for (size_t i = 0; i < offset_div_k; i++) {
+		lfg.backward();
+	}
+	if (!lfg.reinitialize(seed_out))
+		return 0;
+
+	// Count the number of matching bytes.
+	lfg.skip(data_offset);
+	size_t matched = 0;
+	uint8_t tmp[BUF_SIZE];
+	while (matched < size) {
+		const size_t len = std::min(size - matched, sizeof(tmp));
+		lfg.getBytes(tmp, len);
+		if (memcmp(tmp, &data[matched], len) != 0) {
+			// Find the first mismatch.
+			for (size_t i = 0; i < len; i++) {
+				if (tmp[i] != data[matched + i])
+					return matched + i;
+			}
+		}
+		matched += len;
+	}
+	return matched;
+}
+
+/** JunkDetector **/
+
+/**
+ * Create a junk detector.
+ * @param runs Run list. Detected junk runs will be appended.
+ */
+JunkDetector::JunkDetector(vector<RvtH_JunkRun> &runs)
+	: m_runs(runs)
+	, m_block(~0ULL)
+	, m_lfgPos(0)
+{
+	memset(m_seed, 0, sizeof(m_seed));
+}
+
+/**
+ * Check if a block consists entirely of junk data.
+ * If it does, it's added to the run list.
+ * @param data Block data. (Must be 32-bit aligned.)
+ * @param offset Offset of the block within the disc image. (Must be LBA-aligned.)
+ * @param size Size of the block. (Must be a multiple of LBA_SIZE, and must not cross a junk block.)
+ * @return True if the block is junk data; false if not.
+ */
+bool JunkDetector::check(const uint8_t *data, uint64_t offset, unsigned int size)
+{
+	assert(offset % LBA_SIZE == 0);
+	assert(size % LBA_SIZE == 0);
+	const uint64_t block = offset / RVTH_JUNK_BLOCK_SIZE;
+	const uint32_t pos = static_cast<uint32_t>(offset % RVTH_JUNK_BLOCK_SIZE);
+	assert(pos + size <= RVTH_JUNK_BLOCK_SIZE);
+
+	bool isJunk = false;
+	if (block == m_block) {
+		// We already have the seed for this junk block.
+		// Generate the junk data and compare it.
+		if (pos < m_lfgPos) {
+			m_lfg.setSeed(m_seed);
+			m_lfgPos = 0;
+		}
+		m_lfg.skip(pos - m_lfgPos);
+		m_tmp.resize(size);
+		m_lfg.getBytes(m_tmp.data(), size);
+		m_lfgPos = pos + size;
+		isJunk = (memcmp(m_tmp.data(), data, size) == 0);
+	} else {
+		// Try to recover the seed from the data.
+		uint32_t seed[LaggedFibonacci::SEED_SIZE];
+		if (LaggedFibonacci::getSeed(data, size, pos, seed) == size) {
+			memcpy(m_seed, seed, sizeof(m_seed));
+			m_block = block;
+			m_lfg.setSeed(m_seed);
+			m_lfg.skip(pos + size);
+			m_lfgPos = pos + size;
+			isJunk = true;
+		}
+	}
+	if (!isJunk)
+		return false;
+
+	// Add the block to the run list.
+	const uint32_t lba_start = static_cast<uint32_t>(BYTES_TO_LBA(offset));
+	const uint32_t lba_len = BYTES_TO_LBA(size);
+	if (!m_runs.empty()) {
+		RvtH_JunkRun &last = m_runs.back();
+		if (last.lba_start + last.lba_len == lba_start &&
+		    LBA_TO_BYTES(last.lba_start) / RVTH_JUNK_BLOCK_SIZE == block)
+		{
+			// Extend the previous run.
+			last.lba_len += lba_len;
+			return true;
+		}
+	}
+
+	RvtH_JunkRun run;
+	run.lba_start = lba_start;
+	run.lba_len = lba_len;
+	run.seed_offset = pos;
+	memcpy(run.seed, m_seed, sizeof(run.seed));
+	m_runs.push_back(run);
+	return true;
+}
+
+/** RvtH functions **/
+
+/**
+ * Load a junk run list for this standalone disc image.
+ * Holes in the junk runs will be filled with regenerated
+ * junk data when copying the disc image.
+ * The runs must be sorted, must not overlap, and must be
+ * within the disc image; otherwise, -EINVAL is returned.
+ * @param filename	[in] Junk run list filename.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::loadJunkRuns(const TCHAR *filename)
+{
+	m_junkRuns.clear();
+	if (isHDD()) {
+		// Junk runs are only supported for standalone disc images.
+		errno = EINVAL;
+		return RVTH_ERROR_IS_HDD_IMAGE;
+	}
+
+	RefFile *const f_junk = new RefFile(filename);
+	if (!f_junk->isOpen()) {
+		int err = f_junk->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		f_junk->unref();
+		errno = err;
+		return -err;
+	}
+
+	int ret = 0;
+	RvtH_JunkFile_Header header;
+	errno = 0;
+	if (f_junk->read(&header, 1, sizeof(header)) != sizeof(header)) {
+		ret = (errno != 0 ? -errno : -EIO);
+	} else if (memcmp(header.magic, RVTH_JUNK_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+		   be32_to_cpu(header.version) != RVTH_JUNK_FILE_VERSION)
+	{
+		// Not a junk run list.
+		ret = -EINVAL;
+	} else {
+		const uint32_t count = be32_to_cpu(header.count);
+		const uint32_t lba_len = (m_bankCount > 0 ? m_entries[0].lba_len : 0);
+		if (count > lba_len) {
+			// Runs can't overlap and can't be empty,
+			// so there can't be more runs than LBAs.
+			f_junk->unref();
+			errno = EINVAL;
+			return -EINVAL;
+		}
+		vector<RvtH_JunkRun> runs(count);
+		errno = 0;
+		if (f_junk->read(runs.data(), sizeof(RvtH_JunkRun), count) != count) {
+			ret = (errno != 0 ? -errno : -EIO);
+		} else {
+			uint32_t lba_prev_end = 0;	// End of the previous run.
+			for (RvtH_JunkRun &run : runs) {
+				run.lba_start = be32_to_cpu(run.lba_start);
+				run.lba_len = be32_to_cpu(run.lba_len);
+				run.seed_offset = be32_to_cpu(run.seed_offset);
+				for (uint32_t &seed : run.seed) {
+					seed = be32_to_cpu(seed);
+				}
+
+				if (run.lba_len == 0 || run.lba_start >= lba_len ||
+				    run.lba_len > lba_len - run.lba_start)
+				{
+					// Run is empty or out of range.
+					ret = -EINVAL;
+					break;
+				} else if (run.lba_start < lba_prev_end) {
+					// Runs must be sorted and must not overlap.
+					ret = -EINVAL;
+					break;
+				}
+				lba_prev_end = run.lba_start + run.lba_len;
+			}
+			if (ret == 0) {
+				m_junkRuns.swap(runs);
+			}
+		}
+	}
+
+	f_junk->unref();
+	if (ret != 0) {
+		errno = -ret;
+	}
+	return ret;
+}
+
+/**
+ * Save the junk run list for this standalone disc image.
+ * If there are no junk runs, the file will be deleted.
+ * @param filename	[in] Junk run list filename.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::saveJunkRuns(const TCHAR *filename) const
+{
+	return saveJunkRuns(filename, m_junkRuns);
+}
+
+/**
+ * Save a junk run list.
+ * If there are no junk runs, the file will be deleted.
+ * @param filename	[in] Junk run list filename.
+ * @param runs		[in] Junk run list.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::saveJunkRuns(const TCHAR *filename, const vector<RvtH_JunkRun> &runs)
+{
+	if (runs.empty()) {
+		// No junk runs. Delete the stale run list, if present.
+		if (_tremove(filename) != 0 && errno != ENOENT) {
+			return -errno;
+		}
+		return 0;
+	}
+
+	RefFile *const f_junk = new RefFile(filename, true);
+	if (!f_junk->isOpen()) {
+		int err = f_junk->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		f_junk->unref();
+		errno = err;
+		return -err;
+	}
+
+	RvtH_JunkFile_Header header;
+	memcpy(header.magic, RVTH_JUNK_FILE_MAGIC, sizeof(header.magic));
+	header.version = cpu_to_be32(RVTH_JUNK_FILE_VERSION);
+	header.count = cpu_to_be32(static_cast<uint32_t>(runs.size()));
+
+	vector<RvtH_JunkRun> runs_be(runs);
+	for (RvtH_JunkRun &run : runs_be) {
+		run.lba_start = cpu_to_be32(run.lba_start);
+		run.lba_len = cpu_to_be32(run.lba_len);
+		run.seed_offset = cpu_to_be32(run.seed_offset);
+		for (uint32_t &seed : run.seed) {
+			seed = cpu_to_be32(seed);
+		}
+	}
+
+	int ret = 0;
+	errno = 0;
+	if (f_junk->write(&header, 1, sizeof(header)) != sizeof(header) ||
+	    f_junk->write(runs_be.data(), sizeof(RvtH_JunkRun), runs_be.size()) != runs_be.size() ||
+	    f_junk->flush() != 0)
+	{
+		ret = (errno != 0 ? -errno : -EIO);
+	}
+
+	f_junk->unref();
+	if (ret != 0) {
+		errno = -ret;
+	}
+	return ret;
+}
+
+/**
+ * Regenerate junk data in a buffer.
+ * @param buf		[in/out] Buffer.
+ * @param lba_start	[in] Starting LBA of the buffer.
+ * @param lba_len	[in] Length of the buffer, in LBAs.
+ */
+void RvtH::fillJunk(uint8_t *buf, uint32_t lba_start, uint32_t lba_len) const
+{
+	if (m_junkRuns.empty())
+		return;
+
+	// Find the first run that ends after lba_start.
+	// Runs are sorted by LBA and don't overlap.
+	auto iter = std::upper_bound(m_junkRuns.cbegin(), m_junkRuns.cend(), lba_start,
+		[](uint32_t lba, const RvtH_JunkRun &run) {
+			return (lba < run.lba_start + run.lba_len);
+		});
+
+	const uint32_t lba_end = lba_start + lba_len;
+	LaggedFibonacci lfg;
+	for (; iter != m_junkRuns.cend() && iter->lba_start < lba_end; ++iter) {
+		const uint32_t ov_start = std::max(lba_start, iter->lba_start);
+		const uint32_t ov_end = std::min(lba_end, iter->lba_start + iter->lba_len);
+
+		lfg.setSeed(iter->seed);
+		lfg.skip(iter->seed_offset + LBA_TO_BYTES(ov_start - iter->lba_start));
+		lfg.getBytes(&buf[LBA_TO_BYTES(ov_start - lba_start)], LBA_TO_BYTES(ov_end - ov_start));
+	}
+}
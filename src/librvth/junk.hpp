@@ -0,0 +1,143 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * junk.hpp: GameCube/Wii junk data generator.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_JUNK_HPP__
+#define __RVTHTOOL_LIBRVTH_JUNK_HPP__
+
+#include "rvth.hpp"
+
+// C includes.
+#include <stddef.h>
+#include <stdint.h>
+
+// C++ includes.
+#include <vector>
+
+// Junk data is seeded separately for each 256 KB block.
+#define RVTH_JUNK_BLOCK_SIZE	0x40000U
+
+// Junk run list file extension. The run list is stored
+// next to the standalone disc image it belongs to.
+#define RVTH_JUNK_FILE_EXT	_T(".junk")
+
+// Junk run list file header.
+// All fields are big-endian.
+#define RVTH_JUNK_FILE_MAGIC	"RVTHJUNK"
+#define RVTH_JUNK_FILE_VERSION	1
+typedef struct _RvtH_JunkFile_Header {
+	char magic[8];		// [0x000] "RVTHJUNK"
+	uint32_t version;	// [0x008] Version. (1)
+	uint32_t count;		// [0x00C] Number of RvtH_JunkRun entries that follow.
+} RvtH_JunkFile_Header;
+ASSERT_STRUCT(RvtH_JunkFile_Header, 16);
+ASSERT_STRUCT(RvtH_JunkRun, 80);
+
+/**
+ * Lagged Fibonacci generator used for junk data
+ * on GameCube and Wii discs.
+ */
+class LaggedFibonacci
+{
+	public:
+		LaggedFibonacci();
+
+	public:
+		static const unsigned int SEED_SIZE = RVTH_JUNK_SEED_SIZE;
+
+	private:
+		static const unsigned int LFG_K = 521;
+		static const unsigned int LFG_J = 32;
+		static const unsigned int BUF_SIZE = LFG_K * 4;
+
+	public:
+		/**
+		 * Set the seed.
+		 * The generator will be positioned at the start of the junk data.
+		 * @param seed Seed. (host-endian)
+		 */
+		void setSeed(const uint32_t seed[SEED_SIZE]);
+
+		/**
+		 * Skip junk data.
+		 * @param count Number of bytes to skip.
+		 */
+		void skip(uint64_t count);
+
+		/**
+		 * Generate junk data.
+		 * @param out Output buffer.
+		 * @param count Number of bytes to generate.
+		 */
+		void getBytes(uint8_t *out, size_t count);
+
+		/**
+		 * Recover the seed from junk data.
+		 * @param data		[in] Data. (Must be 32-bit aligned.)
+		 * @param size		[in] Size of data.
+		 * @param data_offset	[in] Offset of data relative to the start of the junk data.
+		 * @param seed_out	[out] Seed. (host-endian)
+		 * @return Number of bytes at the start of data that match the recovered seed.
+		 */
+		static size_t getSeed(const uint8_t *data, size_t size, size_t data_offset, uint32_t seed_out[SEED_SIZE]);
+
+	private:
+		void forward(void);
+		void backward(size_t start_word = 0, size_t end_word = LFG_K);
+		bool initialize(bool check_existing_data);
+		bool reinitialize(uint32_t seed_out[SEED_SIZE]);
+
+	private:
+		// Junk data buffer. Stored in output byte order.
+		uint32_t m_buffer[LFG_K];
+		size_t m_position;
+};
+
+/**
+ * Detect junk data while copying a disc image.
+ * Blocks must be checked in ascending order.
+ */
+class JunkDetector
+{
+	public:
+		/**
+		 * Create a junk detector.
+		 * @param runs Run list. Detected junk runs will be appended.
+		 */
+		explicit JunkDetector(std::vector<RvtH_JunkRun> &runs);
+
+	private:
+		JunkDetector(const JunkDetector &) = delete;
+		JunkDetector &operator=(const JunkDetector &) = delete;
+
+	public:
+		/**
+		 * Check if a block consists entirely of junk data.
+		 * If it does, it's added to the run list.
+		 * @param data Block data. (Must be 32-bit aligned.)
+		 * @param offset Offset of the block within the disc image. (Must be LBA-aligned.)
+		 * @param size Size of the block. (Must be a multiple of LBA_SIZE, and must not cross a junk block.)
+		 * @return True if the block is junk data; false if not.
+		 */
+		bool check(const uint8_t *data, uint64_t offset, unsigned int size);
+
+	private:
+		std::vector<RvtH_JunkRun> &m_runs;
+
+		// Seed for the current junk block.
+		uint64_t m_block;	// Junk block index. (~0 if no seed)
+		uint32_t m_seed[LaggedFibonacci::SEED_SIZE];
+
+		// Generator, positioned at m_lfgPos within the current junk block.
+		LaggedFibonacci m_lfg;
+		uint32_t m_lfgPos;
+
+		// Temporary buffer for generated junk data.
+		std::vector<uint8_t> m_tmp;
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_JUNK_HPP__ */
@@ -83,6 +83,68 @@ TCHAR *rvth_get_device_serial_number(const TCHAR *filename, int *pErr);
  */
 void rvth_query_free(RvtH_QueryEntry *devs);
 
+/** Device hotplug monitoring **/
+
+// Device monitor event types.
+typedef enum {
+	RVTH_MONITOR_DEVICE_ADDED	= 0,	// RVT-H Reader was connected.
+	RVTH_MONITOR_DEVICE_REMOVED	= 1,	// RVT-H Reader was disconnected.
+} RvtH_Monitor_Event_e;
+
+/**
+ * Device monitor.
+ * Watches for RVT-H Readers being connected and disconnected.
+ */
+struct _RvtH_Monitor;
+typedef struct _RvtH_Monitor RvtH_Monitor;
+
+/**
+ * Device monitor callback.
+ * @param event		[in] Event type. (See RvtH_Monitor_Event_e.)
+ * @param entry		[in] Device entry. (Only valid during the callback; `next` is not used.)
+ * @param userdata	[in] User data specified when calling rvth_monitor_process().
+ */
+typedef void (*RvtH_Monitor_Callback)(RvtH_Monitor_Event_e event, const RvtH_QueryEntry *entry, void *userdata);
+
+/**
+ * Create a device monitor.
+ *
+ * RVT-H Readers that are already connected are reported as
+ * RVTH_MONITOR_DEVICE_ADDED events on the first call to
+ * rvth_monitor_process(), so a separate rvth_query_devices()
+ * call isn't needed.
+ *
+ * @param pErr	[out,opt] Pointer to store positive POSIX error code in on error. (0 on success)
+ * @return Device monitor, or NULL on error. (ENOSYS if not supported on this system)
+ */
+RvtH_Monitor *rvth_monitor_new(int *pErr);
+
+/**
+ * Get the file descriptor for a device monitor.
+ * This file descriptor becomes readable when events are pending.
+ * Use it with poll(), select(), or QSocketNotifier, and call
+ * rvth_monitor_process() when it's readable.
+ * @param mon	[in] Device monitor.
+ * @return File descriptor, or -1 on error.
+ */
+int rvth_monitor_get_fd(const RvtH_Monitor *mon);
+
+/**
+ * Process pending device monitor events.
+ * This function does not block.
+ * @param mon		[in] Device monitor.
+ * @param callback	[in] Callback function.
+ * @param userdata	[in,opt] User data for the callback function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int rvth_monitor_process(RvtH_Monitor *mon, RvtH_Monitor_Callback callback, void *userdata);
+
+/**
+ * Free a device monitor.
+ * @param mon	[in] Device monitor.
+ */
+void rvth_monitor_free(RvtH_Monitor *mon);
+
 #ifdef __cplusplus
 }
 #endif
@@ -65,30 +65,113 @@ static bool is_vid_pid_correct(struct udev_device *usb_dev)
 }
 
 /**
- * Scan all USB devices for RVT-H Readers.
- * @param pErr	[out,opt] Pointer to store positive POSIX error code in on error. (0 on success)
+ * Create a query entry for a block device if it's an RVT-H Reader.
+ * @param dev Block device.
+ * @return Allocated query entry, or NULL if it isn't an RVT-H Reader.
+ */
+static RvtH_QueryEntry *query_entry_new(struct udev_device *dev)
+{
+	RvtH_QueryEntry *entry;
+	struct udev_device *usb_dev, *scsi_dev;
+
+	const char *s_devnode;
+
+	const char *s_blk_size;
+	const char *s_usb_serial;
+	unsigned int hw_serial;
+
+	// udev_device_get_devnode() returns the path to the device node itself in /dev.
+	s_devnode = udev_device_get_devnode(dev);
+	if (!s_devnode) {
+		// No device node...
+		return NULL;
+	}
+
+	// The device pointed to by dev contains information about the
+	// block device. In order to get information about the USB device,
+	// get the parent device with the subsystem/devtype pair of
+	// "usb"/"usb_device". This will be several levels up the tree,
+	// but the function will find it.
+	// NOTE: This device is NOT referenced, and is cleaned up when
+	// dev is cleaned up.
+	scsi_dev = udev_device_get_parent_with_subsystem_devtype(dev, "scsi", "scsi_device");
+	usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
+	if (!scsi_dev || !usb_dev) {
+		// Parent SCSI and/or USB devices are missing.
+		// - No SCSI device: Not an HDD.
+		// - No USB device: Not an external HDD.
+		return NULL;
+	}
+
+	// Check if the VID/PID matches Nintendo RVT-H Reader.
+	if (!is_vid_pid_correct(usb_dev)) {
+		return NULL;
+	}
+
+	// Get the serial number.
+	s_usb_serial = udev_device_get_sysattr_value(usb_dev, "serial");
+	if (!s_usb_serial) {
+		// No serial number...
+		return NULL;
+	}
+	hw_serial = (unsigned int)strtoul(s_usb_serial, NULL, 10);
+
+	// Is the serial number valid?
+	// - Wired:    10xxxxxx
+	// - Wireless: 20xxxxxx
+	if (hw_serial < 10000000 || hw_serial > 29999999) {
+		// Not a valid serial number.
+		return NULL;
+	}
+
+	// Create the entry.
+	entry = malloc(sizeof(*entry));
+	if (!entry) {
+		// malloc() failed.
+		return NULL;
+	}
+	entry->next = NULL;
+
+	// Block device size.
+	// NOTE: Returns number of LBAs.
+	// Assuming blocks are 512 bytes.
+	// TODO: Get the actual LBA size.
+	s_blk_size = udev_device_get_sysattr_value(dev, "size");
+
+	// Copy the strings.
+	entry->device_name = strdup(s_devnode);
+	entry->usb_vendor = strdup_null(udev_device_get_sysattr_value(usb_dev, "manufacturer"));
+	entry->usb_product = strdup_null(udev_device_get_sysattr_value(usb_dev, "product"));
+	entry->usb_serial = rvth_create_full_serial_number(hw_serial);
+	entry->hdd_vendor = strdup_null(udev_device_get_sysattr_value(scsi_dev, "vendor"));
+	entry->hdd_model = strdup_null(udev_device_get_sysattr_value(scsi_dev, "model"));
+	entry->hdd_fwver = strdup_null(udev_device_get_sysattr_value(scsi_dev, "rev"));
+#ifdef RVTH_QUERY_ENABLE_HDD_SERIAL
+	// TODO: SCSI device serial number?
+	entry->hdd_serial = strdup_null(udev_device_get_sysattr_value(scsi_dev, "serial"));
+#endif /* RVTH_QUERY_ENABLE_HDD_SERIAL */
+	entry->size = (s_blk_size ? strtoull(s_blk_size, NULL, 10) * 512ULL : 0);
+
+	// NOTE: STORAGE_DEVICE_DESCRIPTOR has a serial number value
+	// for the HDD itself, but the RVT-H Reader USB bridge
+	// doesn't support this query.
+	return entry;
+}
+
+/**
+ * Scan all block devices for RVT-H Readers.
+ * @param udev	[in] udev object.
  * @return List of matching devices, or NULL if none were found.
  */
-RvtH_QueryEntry *rvth_query_devices(int *pErr)
+static RvtH_QueryEntry *query_devices_udev(struct udev *udev)
 {
 	RvtH_QueryEntry *list_head = NULL;
 	RvtH_QueryEntry *list_tail = NULL;
 
 	// Reference: http://www.signal11.us/oss/udev/
-	struct udev *udev;
 	struct udev_enumerate *enumerate;
 	struct udev_list_entry *devices, *dev_list_entry;
 
-	// Create the udev object.
-	udev = udev_new();
-	if (!udev) {
-		// Unable to create a udev object.
-		if (pErr) {
-			*pErr = ENOMEM;
-		}
-		return NULL;
-	}
-
 	// Create a list of the devices in the 'block' subsystem.
 	enumerate = udev_enumerate_new(udev);
 	udev_enumerate_add_match_subsystem(enumerate, "block");
@@ -97,124 +180,62 @@ RvtH_QueryEntry *rvth_query_devices(int *pErr)
 
 	// Go over the list of devices and find matching USB devices.
 	udev_list_entry_foreach(dev_list_entry, devices) {
-		struct udev_device *usb_dev, *scsi_dev;
+		RvtH_QueryEntry *entry;
 		struct udev_device *dev;
-
 		const char *path;
-		const char *s_devnode;
-
-		const char *s_blk_size;
-		const char *s_usb_serial;
-		unsigned int hw_serial;
 
 		// Get the filename of the /sys entry for the device
 		// and create a udev_device object (dev) representing it.
 		path = udev_list_entry_get_name(dev_list_entry);
 		dev = udev_device_new_from_syspath(udev, path);
-
-		// udev_device_get_devnode() returns the path to the device node itself in /dev.
-		s_devnode = udev_device_get_devnode(dev);
-		if (!s_devnode) {
-			// No device node...
-			udev_device_unref(dev);
-			continue;
-		}
-
-		// The device pointed to by dev contains information about the
-		// block device. In order to get information about the USB device,
-		// get the parent device with the subsystem/devtype pair of
-		// "usb"/"usb_device". This will be several levels up the tree,
-		// but the function will find it.
-		// NOTE: This device is NOT referenced, and is cleaned up when
-		// dev is cleaned up.
-		scsi_dev = udev_device_get_parent_with_subsystem_devtype(dev, "scsi", "scsi_device");
-		usb_dev = udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-		if (!scsi_dev || !usb_dev) {
-			// Parent SCSI and/or USB devices are missing.
-			// - No SCSI device: Not an HDD.
-			// - No USB device: Not an external HDD.
-			udev_device_unref(dev);
-			continue;
-		}
-	
-		// Check if the VID/PID matches Nintendo RVT-H Reader.
-		if (!is_vid_pid_correct(usb_dev)) {
-			udev_device_unref(dev);
-			continue;
-		}
-
-		// Get the serial number.
-		s_usb_serial = udev_device_get_sysattr_value(usb_dev, "serial");
-		if (!s_usb_serial) {
-			// No serial number...
-			udev_device_unref(dev);
+		if (!dev) {
 			continue;
 		}
-		hw_serial = (unsigned int)strtoul(s_usb_serial, NULL, 10);
 
-		// Is the serial number valid?
-		// - Wired:    10xxxxxx
-		// - Wireless: 20xxxxxx
-		if (hw_serial < 10000000 || hw_serial > 29999999) {
-			// Not a valid serial number.
-			udev_device_unref(dev);
+		entry = query_entry_new(dev);
+		udev_device_unref(dev);
+		if (!entry) {
+			// Not an RVT-H Reader.
 			continue;
 		}
 
-		// Create a list entry.
+		// Add the entry to the list.
 		if (!list_head) {
 			// New list head.
-			list_head = malloc(sizeof(*list_head));
-			if (!list_head) {
-				// malloc() failed.
-				udev_device_unref(dev);
-				break;
-			}
-			list_tail = list_head;
-			list_tail->next = NULL;
+			list_head = entry;
 		} else {
 			// Add an entry to the current list.
-			list_tail->next = malloc(sizeof(*list_tail));
-			if (!list_tail->next) {
-				// malloc() failed.
-				udev_device_unref(dev);
-				rvth_query_free(list_head);
-				list_head = NULL;
-				list_tail = NULL;
-				break;
-			}
-			list_tail->next = NULL;
+			list_tail->next = entry;
 		}
+		list_tail = entry;
+	}
 
-		// Block device size.
-		// NOTE: Returns number of LBAs.
-		// Assuming blocks are 512 bytes.
-		// TODO: Get the actual LBA size.
-		s_blk_size = udev_device_get_sysattr_value(dev, "size");
-
-		// Copy the strings.
-		list_tail->device_name = strdup(s_devnode);
-		list_tail->usb_vendor = strdup_null(udev_device_get_sysattr_value(usb_dev, "manufacturer"));
-		list_tail->usb_product = strdup_null(udev_device_get_sysattr_value(usb_dev, "product"));
-		list_tail->usb_serial = rvth_create_full_serial_number(hw_serial);
-		list_tail->hdd_vendor = strdup_null(udev_device_get_sysattr_value(scsi_dev, "vendor"));
-		list_tail->hdd_model = strdup_null(udev_device_get_sysattr_value(scsi_dev, "model"));
-		list_tail->hdd_fwver = strdup_null(udev_device_get_sysattr_value(scsi_dev, "rev"));
-#ifdef RVTH_QUERY_ENABLE_HDD_SERIAL
-		// TODO: SCSI device serial number?
-		list_tail->hdd_serial = strdup_null(udev_device_get_sysattr_value(scsi_dev, "serial"));
-#endif /* RVTH_QUERY_ENABLE_HDD_SERIAL */
-		list_tail->size = (s_blk_size ? strtoull(s_blk_size, NULL, 10) * 512ULL : 0);
+	// Free the enumerator object.
+	udev_enumerate_unref(enumerate);
+	return list_head;
+}
 
-		// NOTE: STORAGE_DEVICE_DESCRIPTOR has a serial number value
-		// for the HDD itself, but the RVT-H Reader USB bridge
-		// doesn't support this query.
+/**
+ * Scan all USB devices for RVT-H Readers.
+ * @param pErr	[out,opt] Pointer to store positive POSIX error code in on error. (0 on success)
+ * @return List of matching devices, or NULL if none were found.
+ */
+RvtH_QueryEntry *rvth_query_devices(int *pErr)
+{
+	RvtH_QueryEntry *list_head;
+	struct udev *udev;
 
-		udev_device_unref(dev);
+	// Create the udev object.
+	udev = udev_new();
+	if (!udev) {
+		// Unable to create a udev object.
+		if (pErr) {
+			*pErr = ENOMEM;
+		}
+		return NULL;
 	}
 
-	// Free the enumerator object.
-	udev_enumerate_unref(enumerate);
+	list_head = query_devices_udev(udev);
 	udev_unref(udev);
 
 	if (pErr) {
@@ -340,3 +361,194 @@ TCHAR *rvth_get_device_serial_number(const TCHAR *filename, int *pErr)
 	}
 	return s_full_serial;
 }
+
+/** Device hotplug monitoring **/
+
+struct _RvtH_Monitor {
+	struct udev *udev;
+	struct udev_monitor *mon;
+
+	// RVT-H Readers that are currently connected.
+	RvtH_QueryEntry *devs;
+
+	// If true, the devices in `devs` haven't been reported yet.
+	bool initial_pending;
+};
+
+/**
+ * Create a device monitor.
+ *
+ * RVT-H Readers that are already connected are reported as
+ * RVTH_MONITOR_DEVICE_ADDED events on the first call to
+ * rvth_monitor_process(), so a separate rvth_query_devices()
+ * call isn't needed.
+ *
+ * @param pErr	[out,opt] Pointer to store positive POSIX error code in on error. (0 on success)
+ * @return Device monitor, or NULL on error. (ENOSYS if not supported on this system)
+ */
+RvtH_Monitor *rvth_monitor_new(int *pErr)
+{
+	RvtH_Monitor *mon;
+	int err = 0;
+
+	mon = calloc(1, sizeof(*mon));
+	if (!mon) {
+		if (pErr) {
+			*pErr = ENOMEM;
+		}
+		return NULL;
+	}
+
+	// Create the udev object.
+	mon->udev = udev_new();
+	if (!mon->udev) {
+		// Unable to create a udev object.
+		err = ENOMEM;
+		goto fail;
+	}
+
+	// Listen for block device events from udevd.
+	// NOTE: Events are received *after* udev rules have been
+	// processed, so the device node permissions are set.
+	mon->mon = udev_monitor_new_from_netlink(mon->udev, "udev");
+	if (!mon->mon) {
+		err = ENOMEM;
+		goto fail;
+	}
+	udev_monitor_filter_add_match_subsystem_devtype(mon->mon, "block", NULL);
+	err = -udev_monitor_enable_receiving(mon->mon);
+	if (err != 0) {
+		goto fail;
+	}
+
+	// Get the devices that are already connected.
+	// NOTE: This is done after enabling receiving so devices
+	// connected in between won't be missed. Duplicate "add"
+	// events are ignored.
+	mon->devs = query_devices_udev(mon->udev);
+	mon->initial_pending = true;
+
+	if (pErr) {
+		*pErr = 0;
+	}
+	return mon;
+
+fail:
+	rvth_monitor_free(mon);
+	if (pErr) {
+		*pErr = (err > 0 ? err : EIO);
+	}
+	return NULL;
+}
+
+/**
+ * Get the file descriptor for a device monitor.
+ * This file descriptor becomes readable when events are pending.
+ * Use it with poll(), select(), or QSocketNotifier, and call
+ * rvth_monitor_process() when it's readable.
+ * @param mon	[in] Device monitor.
+ * @return File descriptor, or -1 on error.
+ */
+int rvth_monitor_get_fd(const RvtH_Monitor *mon)
+{
+	if (!mon || !mon->mon) {
+		return -1;
+	}
+	return udev_monitor_get_fd(mon->mon);
+}
+
+/**
+ * Process pending device monitor events.
+ * This function does not block.
+ * @param mon		[in] Device monitor.
+ * @param callback	[in] Callback function.
+ * @param userdata	[in,opt] User data for the callback function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int rvth_monitor_process(RvtH_Monitor *mon, RvtH_Monitor_Callback callback, void *userdata)
+{
+	struct udev_device *dev;
+
+	if (!mon || !callback) {
+		return -EINVAL;
+	}
+
+	if (mon->initial_pending) {
+		// Report the devices that were already connected.
+		const RvtH_QueryEntry *p;
+		for (p = mon->devs; p != NULL; p = p->next) {
+			callback(RVTH_MONITOR_DEVICE_ADDED, p, userdata);
+		}
+		mon->initial_pending = false;
+	}
+
+	// NOTE: The udev monitor socket is non-blocking, so this
+	// returns NULL once all pending events have been received.
+	while ((dev = udev_monitor_receive_device(mon->mon)) != NULL) {
+		const char *const action = udev_device_get_action(dev);
+		const char *const s_devnode = udev_device_get_devnode(dev);
+		RvtH_QueryEntry **pp;
+
+		if (!action || !s_devnode) {
+			udev_device_unref(dev);
+			continue;
+		}
+
+		// Find the device in the list of connected devices.
+		for (pp = &mon->devs; *pp != NULL; pp = &(*pp)->next) {
+			if (!strcmp((*pp)->device_name, s_devnode))
+				break;
+		}
+
+		if (!strcmp(action, "add")) {
+			RvtH_QueryEntry *entry;
+			if (*pp != NULL) {
+				// Device was already found.
+				udev_device_unref(dev);
+				continue;
+			}
+
+			entry = query_entry_new(dev);
+			if (entry) {
+				// RVT-H Reader was connected.
+				// Add it to the end of the list.
+				*pp = entry;
+				callback(RVTH_MONITOR_DEVICE_ADDED, entry, userdata);
+			}
+		} else if (!strcmp(action, "remove")) {
+			RvtH_QueryEntry *entry = *pp;
+			if (entry) {
+				// RVT-H Reader was disconnected.
+				// NOTE: The USB device's attributes are no longer
+				// available, so the saved entry is reported.
+				*pp = entry->next;
+				entry->next = NULL;
+				callback(RVTH_MONITOR_DEVICE_REMOVED, entry, userdata);
+				rvth_query_free(entry);
+			}
+		}
+
+		udev_device_unref(dev);
+	}
+
+	return 0;
+}
+
+/**
+ * Free a device monitor.
+ * @param mon	[in] Device monitor.
+ */
+void rvth_monitor_free(RvtH_Monitor *mon)
+{
+	if (!mon)
+		return;
+
+	rvth_query_free(mon->devs);
+	if (mon->mon) {
+		udev_monitor_unref(mon->mon);
+	}
+	if (mon->udev) {
+		udev_unref(mon->udev);
+	}
+	free(mon);
+}
@@ -584,3 +584,57 @@ TCHAR *rvth_get_device_serial_number(const TCHAR *filename, int *pErr)
 	SetupDiDestroyDeviceInfoList(hDevInfoSet);
 	return s_full_serial;
 }
+
+/** Device hotplug monitoring **/
+
+// TODO: Implement device monitoring using RegisterDeviceNotification().
+// This requires a window to receive WM_DEVICECHANGE messages.
+
+/**
+ * Create a device monitor.
+ * @param pErr	[out,opt] Pointer to store positive POSIX error code in on error. (0 on success)
+ * @return Device monitor, or NULL on error. (ENOSYS if not supported on this system)
+ */
+RvtH_Monitor *rvth_monitor_new(int *pErr)
+{
+	// Not supported on Windows yet.
+	if (pErr) {
+		*pErr = ENOSYS;
+	}
+	return NULL;
+}
+
+/**
+ * Get the file descriptor for a device monitor.
+ * @param mon	[in] Device monitor.
+ * @return File descriptor, or -1 on error.
+ */
+int rvth_monitor_get_fd(const RvtH_Monitor *mon)
+{
+	UNUSED(mon);
+	return -1;
+}
+
+/**
+ * Process pending device monitor events.
+ * @param mon		[in] Device monitor.
+ * @param callback	[in] Callback function.
+ * @param userdata	[in,opt] User data for the callback function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int rvth_monitor_process(RvtH_Monitor *mon, RvtH_Monitor_Callback callback, void *userdata)
+{
+	UNUSED(mon);
+	UNUSED(callback);
+	UNUSED(userdata);
+	return -ENOSYS;
+}
+
+/**
+ * Free a device monitor.
+ * @param mon	[in] Device monitor.
+ */
+void rvth_monitor_free(RvtH_Monitor *mon)
+{
+	UNUSED(mon);
+}
@@ -32,14 +32,8 @@
 #include <cerrno>
 #include <cstring>
 
-// CISO magic.
-static const char CISO_MAGIC[4] = {'C','I','S','O'};
-
-typedef struct PACKED _CisoHeader {
-	char magic[4];			// "CISO"
-	uint32_t block_size;		// LE32
-	uint8_t map[CISO_MAP_SIZE];	// 0 == unused; 1 == used; other == invalid
-} CisoHeader;
+// C++ includes.
+#include <algorithm>
 
 /**
  * Is a given disc image supported by the CISO reader?
@@ -260,9 +254,50 @@ uint32_t CisoReader::read(void *ptr, uint32_t lba_start, uint32_t lba_len)
 				}
 				return 0;
 			}
-			lbas_read++;
 		}
+		lbas_read++;
 	}
 
 	return lbas_read;
 }
+
+/**
+ * Find the next range of LBAs that may contain data.
+ * LBAs between lba_start and the returned extent are known
+ * to be empty, so they don't need to be read.
+ *
+ * Empty blocks are found using the CISO block map.
+ *
+ * @param lba_start	[in] Starting LBA.
+ * @param extent	[out] Data extent.
+ * @return True if an extent was found; false if the rest of the disc image is empty.
+ */
+bool CisoReader::nextExtent(uint32_t lba_start, Extent &extent)
+{
+	if (lba_start >= m_lba_len) {
+		// End of the disc image.
+		return false;
+	}
+
+	// Find the next used block.
+	const uint32_t block_count = (m_lba_len + m_block_size_lba - 1) / m_block_size_lba;
+	uint32_t block = lba_start / m_block_size_lba;
+	while (block < block_count && m_blockMap[block] == 0xFFFF) {
+		block++;
+	}
+	if (block >= block_count) {
+		// No more data.
+		return false;
+	}
+	const uint32_t ext_start = std::max(lba_start, block * m_block_size_lba);
+
+	// Find the end of the used blocks.
+	while (block < block_count && m_blockMap[block] != 0xFFFF) {
+		block++;
+	}
+	const uint32_t ext_end = std::min(m_lba_len, block * m_block_size_lba);
+
+	extent.lba_start = ext_start;
+	extent.lba_len = ext_end - ext_start;
+	return true;
+}
@@ -22,6 +22,7 @@
 #define __RVTHTOOL_LIBRVTH_READER_CISOREADER_HPP__
 
 #include "Reader.hpp"
+#include "ciso_structs.h"
 
 class CisoReader : public Reader
 {
@@ -63,15 +64,20 @@ class CisoReader : public Reader
 		 */
 		uint32_t read(void *ptr, uint32_t lba_start, uint32_t lba_len) final;
 
-	private:
-		#define CISO_HEADER_SIZE 0x8000
-		#define CISO_MAP_SIZE (CISO_HEADER_SIZE - sizeof(uint32_t) - (sizeof(char) * 4))
-
-		// 32 KB minimum block size (GCN/Wii sector)
-		// 16 MB maximum block size
-		#define CISO_BLOCK_SIZE_MIN (32768)
-		#define CISO_BLOCK_SIZE_MAX (16*1024*1024)
+		/**
+		 * Find the next range of LBAs that may contain data.
+		 * LBAs between lba_start and the returned extent are known
+		 * to be empty, so they don't need to be read.
+		 *
+		 * Empty blocks are found using the CISO block map.
+		 *
+		 * @param lba_start	[in] Starting LBA.
+		 * @param extent	[out] Data extent.
+		 * @return True if an extent was found; false if the rest of the disc image is empty.
+		 */
+		bool nextExtent(uint32_t lba_start, Extent &extent) final;
 
+	private:
 		// NOTE: reader.lba_len is the virtual image size.
 		// real_lba_len is the actual image size.
 		uint32_t m_real_lba_len;
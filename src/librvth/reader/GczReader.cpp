@@ -0,0 +1,339 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * GczReader.cpp: GCZ disc image reader class.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "GczReader.hpp"
+#include "gcz_structs.h"
+#include "byteswap.h"
+
+// For LBA_TO_BYTES()
+#include "nhcd_structs.h"
+
+// zlib
+#include <zlib.h>
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+
+/**
+ * Is a given disc image supported by the GCZ reader?
+ * @param sbuf	[in] Sector buffer. (first LBA of the disc)
+ * @param size	[in] Size of sbuf. (should be 512 or larger)
+ * @return True if supported; false if not.
+ */
+bool GczReader::isSupported(const uint8_t *sbuf, size_t size)
+{
+	assert(sbuf != NULL);
+	assert(size >= LBA_SIZE);
+	if (!sbuf || size < LBA_SIZE) {
+		return false;
+	}
+
+	// Check for GCZ magic.
+	const GCZ_Header *const gczHeader = reinterpret_cast<const GCZ_Header*>(sbuf);
+	if (gczHeader->magic != cpu_to_le32(GCZ_MAGIC)) {
+		// Invalid magic.
+		return false;
+	}
+
+	// Check if the block size is a supported power of two.
+	const uint32_t block_size = le32_to_cpu(gczHeader->block_size);
+	if (block_size < GCZ_BLOCK_SIZE_MIN || block_size > GCZ_BLOCK_SIZE_MAX ||
+	    (block_size & (block_size - 1)) != 0)
+	{
+		// Block size is out of range.
+		return false;
+	}
+
+	// The image must fit in the block count, and must be
+	// a multiple of the LBA size.
+	const uint64_t data_size = le64_to_cpu(gczHeader->data_size);
+	const uint32_t num_blocks = le32_to_cpu(gczHeader->num_blocks);
+	if (data_size == 0 || data_size % LBA_SIZE != 0 ||
+	    data_size > (uint64_t)num_blocks * block_size ||
+	    BYTES_TO_LBA(data_size) > UINT32_MAX)
+	{
+		// Invalid image size.
+		return false;
+	}
+
+	// This is a GCZ image file.
+	return true;
+}
+
+/**
+ * Create a GCZ reader for a disc image.
+ *
+ * NOTE: If lba_start == 0 and lba_len == 0, the entire file
+ * will be used.
+ *
+ * @param file		RefFile*.
+ * @param lba_start	[in] Starting LBA,
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Reader*, or NULL on error.
+ */
+GczReader::GczReader(RefFile *file, uint32_t lba_start, uint32_t lba_len)
+	: super(file, lba_start, lba_len)
+	, m_data_offset(0)
+	, m_compressed_data_size(0)
+	, m_block_size(0)
+	, m_cacheNext(0)
+{
+	int ret;
+	int err = 0;
+	size_t size;
+	uint32_t num_blocks;
+	uint64_t data_size;
+	GCZ_Header gczHeader;
+
+	for (unsigned int i = 0; i < GCZ_CACHE_BLOCKS; i++) {
+		m_cache[i].block_idx = ~0U;
+		m_cache[i].data = nullptr;
+	}
+
+	if (!isOpen()) {
+		// File wasn't opened.
+		return;
+	}
+
+	// Read the GCZ header.
+	ret = m_file->seeko(LBA_TO_BYTES(lba_start), SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		goto fail;
+	}
+	size = m_file->read(&gczHeader, 1, sizeof(gczHeader));
+	if (size != sizeof(gczHeader)) {
+		// Short read.
+		err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		goto fail;
+	}
+
+	// Validate the GCZ header.
+	// NOTE: isSupported() requires at least LBA_SIZE bytes,
+	// but it only checks the header.
+	{
+		uint8_t sbuf[LBA_SIZE];
+		memset(sbuf, 0, sizeof(sbuf));
+		memcpy(sbuf, &gczHeader, sizeof(gczHeader));
+		if (!isSupported(sbuf, sizeof(sbuf))) {
+			// Not a valid GCZ header.
+			err = EIO;
+			goto fail;
+		}
+	}
+	m_block_size = le32_to_cpu(gczHeader.block_size);
+	m_compressed_data_size = le64_to_cpu(gczHeader.compressed_data_size);
+	num_blocks = le32_to_cpu(gczHeader.num_blocks);
+	data_size = le64_to_cpu(gczHeader.data_size);
+
+	// Read the block pointers and hashes.
+	m_blockPointers.resize(num_blocks);
+	m_hashes.resize(num_blocks);
+	size = m_file->read(m_blockPointers.data(), sizeof(uint64_t), num_blocks);
+	if (size != num_blocks) {
+		// Short read.
+		err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		goto fail;
+	}
+	size = m_file->read(m_hashes.data(), sizeof(uint32_t), num_blocks);
+	if (size != num_blocks) {
+		// Short read.
+		err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		goto fail;
+	}
+#if SYS_BYTEORDER != SYS_LIL_ENDIAN
+	for (uint64_t &ptr : m_blockPointers) {
+		ptr = le64_to_cpu(ptr);
+	}
+	for (uint32_t &hash : m_hashes) {
+		hash = le32_to_cpu(hash);
+	}
+#endif /* SYS_BYTEORDER != SYS_LIL_ENDIAN */
+
+	// Compressed data starts after the tables.
+	m_data_offset = LBA_TO_BYTES(lba_start) + sizeof(gczHeader) +
+		((int64_t)num_blocks * (sizeof(uint64_t) + sizeof(uint32_t)));
+
+	// NOTE: reader.lba_len is the virtual image size.
+	m_lba_start = lba_start;
+	m_lba_len = static_cast<uint32_t>(BYTES_TO_LBA(data_size));
+
+	// Reader initialized.
+	m_type = RVTH_ImageType_GCM;
+	return;
+
+fail:
+	// Failed to initialize the reader.
+	m_file->unref();
+	m_file = nullptr;
+	errno = err;
+}
+
+GczReader::~GczReader()
+{
+	for (unsigned int i = 0; i < GCZ_CACHE_BLOCKS; i++) {
+		free(m_cache[i].data);
+	}
+
+	// Superclass will unreference the file.
+}
+
+/**
+ * Get a decompressed block.
+ * The block is decompressed into the block cache if necessary.
+ * @param block_idx	[in] Block index.
+ * @return Decompressed block, or nullptr on error.
+ */
+const uint8_t *GczReader::getBlock(uint32_t block_idx)
+{
+	assert(block_idx < m_blockPointers.size());
+
+	// Check if the block is already cached.
+	for (unsigned int i = 0; i < GCZ_CACHE_BLOCKS; i++) {
+		if (m_cache[i].block_idx == block_idx) {
+			return m_cache[i].data;
+		}
+	}
+
+	// Determine the compressed block size.
+	const uint64_t ptr = m_blockPointers[block_idx];
+	const bool uncompressed = !!(ptr & GCZ_BLOCK_UNCOMPRESSED);
+	const uint64_t comp_start = ptr & ~GCZ_BLOCK_UNCOMPRESSED;
+	const uint64_t comp_end = (block_idx + 1 < m_blockPointers.size())
+		? (m_blockPointers[block_idx + 1] & ~GCZ_BLOCK_UNCOMPRESSED)
+		: m_compressed_data_size;
+	if (comp_end < comp_start || comp_end - comp_start > compressBound(m_block_size) ||
+	    (uncompressed && comp_end - comp_start != m_block_size))
+	{
+		// Invalid block pointer.
+		errno = EIO;
+		return nullptr;
+	}
+	const unsigned int comp_size = static_cast<unsigned int>(comp_end - comp_start);
+
+	// Allocate the cache entry.
+	CacheEntry *const entry = &m_cache[m_cacheNext];
+	if (!entry->data) {
+		entry->data = static_cast<uint8_t*>(malloc(m_block_size));
+		if (!entry->data) {
+			errno = ENOMEM;
+			return nullptr;
+		}
+	}
+	entry->block_idx = ~0U;
+
+	// Read the compressed block.
+	m_compBuf.resize(comp_size);
+	int ret = m_file->seeko(m_data_offset + comp_start, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		if (errno == 0) {
+			errno = EIO;
+		}
+		return nullptr;
+	}
+	errno = 0;
+	size_t size = m_file->read(m_compBuf.data(), 1, comp_size);
+	if (size != comp_size) {
+		// Read error.
+		if (errno == 0) {
+			errno = EIO;
+		}
+		return nullptr;
+	}
+
+	// Verify the hash.
+	const uint32_t hash = adler32(adler32(0, nullptr, 0), m_compBuf.data(), comp_size);
+	if (hash != m_hashes[block_idx]) {
+		// Block is corrupted.
+		errno = EIO;
+		return nullptr;
+	}
+
+	if (uncompressed) {
+		memcpy(entry->data, m_compBuf.data(), m_block_size);
+	} else {
+		uLongf destLen = m_block_size;
+		if (uncompress(entry->data, &destLen, m_compBuf.data(), comp_size) != Z_OK) {
+			// Decompression error.
+			errno = EIO;
+			return nullptr;
+		}
+		if (destLen < m_block_size) {
+			// Short block. Zero out the rest.
+			memset(&entry->data[destLen], 0, m_block_size - destLen);
+		}
+	}
+
+	entry->block_idx = block_idx;
+	m_cacheNext = (m_cacheNext + 1) % GCZ_CACHE_BLOCKS;
+	return entry->data;
+}
+
+/**
+ * Read data from the disc image.
+ * @param ptr		[out] Read buffer.
+ * @param lba_start	[in] Starting LBA.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Number of LBAs read, or 0 on error.
+ */
+uint32_t GczReader::read(void *ptr, uint32_t lba_start, uint32_t lba_len)
+{
+	// LBA bounds checking.
+	// TODO: Check for overflow?
+	assert(lba_start + lba_len <= m_lba_len);
+	if (lba_start + lba_len > m_lba_len) {
+		// Out of range.
+		errno = EIO;
+		return 0;
+	}
+
+	uint8_t *ptr8 = static_cast<uint8_t*>(ptr);
+	uint64_t pos = LBA_TO_BYTES(lba_start);
+	uint64_t size_left = LBA_TO_BYTES(lba_len);
+	while (size_left > 0) {
+		const uint32_t block_idx = static_cast<uint32_t>(pos / m_block_size);
+		const uint32_t block_pos = static_cast<uint32_t>(pos % m_block_size);
+		const uint32_t len = static_cast<uint32_t>(
+			std::min(size_left, static_cast<uint64_t>(m_block_size - block_pos)));
+
+		const uint8_t *const block = getBlock(block_idx);
+		if (!block) {
+			// Error reading the block.
+			return 0;
+		}
+		memcpy(ptr8, &block[block_pos], len);
+
+		ptr8 += len;
+		pos += len;
+		size_left -= len;
+	}
+
+	return lba_len;
+}
@@ -0,0 +1,94 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * GczReader.hpp: GCZ disc image reader class.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_READER_GCZREADER_HPP__
+#define __RVTHTOOL_LIBRVTH_READER_GCZREADER_HPP__
+
+#include "Reader.hpp"
+
+// C++ includes.
+#include <vector>
+
+class GczReader : public Reader
+{
+	public:
+		/**
+		 * Create a GCZ reader for a disc image.
+		 *
+		 * NOTE: If lba_start == 0 and lba_len == 0, the entire file
+		 * will be used.
+		 *
+		 * @param file		RefFile*.
+		 * @param lba_start	[in] Starting LBA,
+		 * @param lba_len	[in] Length, in LBAs.
+		 */
+		GczReader(RefFile *file, uint32_t lba_start, uint32_t lba_len);
+		virtual ~GczReader();
+
+	private:
+		typedef Reader super;
+		DISABLE_COPY(GczReader)
+
+	public:
+		/**
+		 * Is a given disc image supported by the GCZ reader?
+		 * @param sbuf	[in] Sector buffer. (first LBA of the disc)
+		 * @param size	[in] Size of sbuf. (should be 512 or larger)
+		 * @return True if supported; false if not.
+		 */
+		static bool isSupported(const uint8_t *sbuf, size_t size);
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Read data from the disc image.
+		 * @param ptr		[out] Read buffer.
+		 * @param lba_start	[in] Starting LBA.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Number of LBAs read, or 0 on error.
+		 */
+		uint32_t read(void *ptr, uint32_t lba_start, uint32_t lba_len) final;
+
+	private:
+		/**
+		 * Get a decompressed block.
+		 * The block is decompressed into the block cache if necessary.
+		 * @param block_idx	[in] Block index.
+		 * @return Decompressed block, or nullptr on error.
+		 */
+		const uint8_t *getBlock(uint32_t block_idx);
+
+	private:
+		// Offset of the compressed data, in bytes.
+		int64_t m_data_offset;
+		// Size of the compressed data, in bytes.
+		uint64_t m_compressed_data_size;
+
+		// Block size, in bytes.
+		uint32_t m_block_size;
+
+		// Block pointers and Adler-32 hashes. (host-endian)
+		std::vector<uint64_t> m_blockPointers;
+		std::vector<uint32_t> m_hashes;
+
+		// Compressed block buffer.
+		std::vector<uint8_t> m_compBuf;
+
+		// Decompressed block cache.
+		// Entries are replaced in round-robin order.
+		#define GCZ_CACHE_BLOCKS 4
+		struct CacheEntry {
+			uint32_t block_idx;	// Block index. (~0 if empty)
+			uint8_t *data;		// Decompressed data.
+		};
+		CacheEntry m_cache[GCZ_CACHE_BLOCKS];
+		unsigned int m_cacheNext;
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_READER_GCZREADER_HPP__ */
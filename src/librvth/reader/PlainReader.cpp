@@ -31,6 +31,9 @@
 #include <cassert>
 #include <cerrno>
 
+// C++ includes.
+#include <algorithm>
+
 /**
  * Create a plain reader for a disc image.
  *
@@ -163,3 +166,50 @@ uint32_t PlainReader::write(const void *ptr, uint32_t lba_start, uint32_t lba_le
 	// Write the data.
 	return (uint32_t)m_file->write(ptr, LBA_SIZE, lba_len);
 }
+
+/**
+ * Find the next range of LBAs that may contain data.
+ * LBAs between lba_start and the returned extent are known
+ * to be empty, so they don't need to be read.
+ *
+ * Holes in sparse files are found using SEEK_DATA and SEEK_HOLE.
+ *
+ * @param lba_start	[in] Starting LBA.
+ * @param extent	[out] Data extent.
+ * @return True if an extent was found; false if the rest of the disc image is empty.
+ */
+bool PlainReader::nextExtent(uint32_t lba_start, Extent &extent)
+{
+	if (lba_start >= m_lba_len) {
+		// End of the disc image.
+		return false;
+	}
+
+	// Find the next data region.
+	const int64_t base = LBA_TO_BYTES(m_lba_start);
+	const int64_t data_pos = m_file->seekData(base + LBA_TO_BYTES(lba_start));
+	if (data_pos == -ENXIO) {
+		// No more data.
+		return false;
+	} else if (data_pos < 0) {
+		// Error. Treat the rest of the disc image as data.
+		return super::nextExtent(lba_start, extent);
+	}
+
+	// Round the data region outwards to LBA boundaries.
+	const uint64_t ext_start = BYTES_TO_LBA(data_pos - base);
+	if (ext_start >= m_lba_len) {
+		// Data is past the end of the disc image.
+		return false;
+	}
+	uint64_t ext_end = m_lba_len;
+	const int64_t hole_pos = m_file->seekHole(data_pos);
+	if (hole_pos >= 0) {
+		ext_end = std::min(ext_end,
+			static_cast<uint64_t>(BYTES_TO_LBA(hole_pos - base + LBA_SIZE - 1)));
+	}
+
+	extent.lba_start = static_cast<uint32_t>(ext_start);
+	extent.lba_len = static_cast<uint32_t>(ext_end - ext_start);
+	return true;
+}
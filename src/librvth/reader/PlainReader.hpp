@@ -63,6 +63,30 @@ class PlainReader : public Reader
 		 * @return Number of LBAs read, or 0 on error.
 		 */
 		uint32_t write(const void *ptr, uint32_t lba_start, uint32_t lba_len) final;
+
+	public:
+		/** Accessors **/
+
+		/**
+		 * Is this a plain disc image?
+		 * If true, each LBA maps directly to an LBA in the
+		 * underlying file, starting at lba_start().
+		 * @return True if this is a plain disc image; false if not.
+		 */
+		bool isPlain(void) const final { return true; }
+
+		/**
+		 * Find the next range of LBAs that may contain data.
+		 * LBAs between lba_start and the returned extent are known
+		 * to be empty, so they don't need to be read.
+		 *
+		 * Holes in sparse files are found using SEEK_DATA and SEEK_HOLE.
+		 *
+		 * @param lba_start	[in] Starting LBA.
+		 * @param extent	[out] Data extent.
+		 * @return True if an extent was found; false if the rest of the disc image is empty.
+		 */
+		bool nextExtent(uint32_t lba_start, Extent &extent) final;
 };
 
 #ifdef __cplusplus
@@ -22,6 +22,7 @@
 #include "PlainReader.hpp"
 #include "CisoReader.hpp"
 #include "WbfsReader.hpp"
+#include "GczReader.hpp"
 
 // For LBA_TO_BYTES()
 #include "nhcd_structs.h"
@@ -119,6 +120,9 @@ Reader *Reader::open(RefFile *file, uint32_t lba_start, uint32_t lba_len)
 	} else if (WbfsReader::isSupported(sbuf, sizeof(sbuf))) {
 		// This is a supported WBFS image.
 		return new WbfsReader(file, lba_start, lba_len);
+	} else if (GczReader::isSupported(sbuf, sizeof(sbuf))) {
+		// This is a supported GCZ image.
+		return new GczReader(file, lba_start, lba_len);
 	}
 
 	// Check for SDK headers.
@@ -171,3 +175,27 @@ void Reader::flush(void)
 {
 	m_file->flush();
 }
+
+/**
+ * Find the next range of LBAs that may contain data.
+ * LBAs between lba_start and the returned extent are known
+ * to be empty, so they don't need to be read.
+ *
+ * The default implementation treats the rest of the
+ * disc image as data.
+ *
+ * @param lba_start	[in] Starting LBA.
+ * @param extent	[out] Data extent.
+ * @return True if an extent was found; false if the rest of the disc image is empty.
+ */
+bool Reader::nextExtent(uint32_t lba_start, Extent &extent)
+{
+	if (lba_start >= m_lba_len) {
+		// End of the disc image.
+		return false;
+	}
+
+	extent.lba_start = lba_start;
+	extent.lba_len = m_lba_len - lba_start;
+	return true;
+}
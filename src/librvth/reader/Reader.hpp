@@ -103,6 +103,31 @@ class Reader
 		 */
 		void flush(void);
 
+	public:
+		/** Extents **/
+
+		/**
+		 * Range of LBAs that may contain data.
+		 */
+		struct Extent {
+			uint32_t lba_start;	// Starting LBA.
+			uint32_t lba_len;	// Length, in LBAs.
+		};
+
+		/**
+		 * Find the next range of LBAs that may contain data.
+		 * LBAs between lba_start and the returned extent are known
+		 * to be empty, so they don't need to be read.
+		 *
+		 * The default implementation treats the rest of the
+		 * disc image as data.
+		 *
+		 * @param lba_start	[in] Starting LBA.
+		 * @param extent	[out] Data extent.
+		 * @return True if an extent was found; false if the rest of the disc image is empty.
+		 */
+		virtual bool nextExtent(uint32_t lba_start, Extent &extent);
+
 	public:
 		/** Accessors **/
 
@@ -124,6 +149,20 @@ class Reader
 		 */
 		inline RvtH_ImageType_e type(void) const { return m_type; }
 
+		/**
+		 * Get the underlying file.
+		 * @return RefFile*.
+		 */
+		inline RefFile *file(void) const { return m_file; }
+
+		/**
+		 * Is this a plain disc image?
+		 * If true, each LBA maps directly to an LBA in the
+		 * underlying file, starting at lba_start().
+		 * @return True if this is a plain disc image; false if not.
+		 */
+		virtual bool isPlain(void) const { return false; }
+
 	public:
 		/** Special functions **/
 
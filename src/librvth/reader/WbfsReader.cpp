@@ -32,6 +32,9 @@
 #include <cerrno>
 #include <cstring>
 
+// C++ includes.
+#include <algorithm>
+
 #include "libwbfs.h"
 
 // WBFS magic.
@@ -192,6 +195,23 @@ static wbfs_t *readWbfsHeader(RefFile *file, uint32_t lba_start)
 
 	p->n_disc_open = 0;
 
+	// Read the free blocks table.
+	// This is only used for validating the wlba tables,
+	// so errors here aren't fatal.
+	if (p->freeblks_lba > 0 && p->n_wbfs_sec > 0) {
+		const size_t freeblks_sz = ALIGN_LBA(p->n_wbfs_sec / 8);
+		p->freeblks = (uint32_t*)malloc(freeblks_sz);
+		if (p->freeblks) {
+			if (file->seeko(LBA_TO_BYTES(lba_start) + ((int64_t)p->freeblks_lba << p->hd_sec_sz_s), SEEK_SET) != 0 ||
+			    file->read(p->freeblks, 1, freeblks_sz) != freeblks_sz)
+			{
+				// Error reading the free blocks table.
+				free(p->freeblks);
+				p->freeblks = NULL;
+			}
+		}
+	}
+
 end:
 	if (ret != 0) {
 		// Error...
@@ -217,6 +237,7 @@ static void freeWbfsHeader(wbfs_t *p)
 	assert(p->n_disc_open == 0);
 
 	// Free everything.
+	free(p->freeblks);
 	free(p->head);
 	free(p);
 }
@@ -226,67 +247,83 @@ static void freeWbfsHeader(wbfs_t *p)
  * @param file		RefFile*.
  * @param lba_start	[in] Starting LBA,
  * @param p		wbfs_t struct.
- * @param index		[in] Disc index.
- * @return Allocated wbfs_disc_t on success; non-zero on error.
+ * @param slot		[in] Disc slot in the WBFS disc table.
+ * @return Allocated wbfs_disc_t on success; NULL on error.
  */
-static wbfs_disc_t *openWbfsDisc(RefFile *file, uint32_t lba_start, wbfs_t *p, uint32_t index)
+static wbfs_disc_t *openWbfsDisc(RefFile *file, uint32_t lba_start, wbfs_t *p, uint32_t slot)
 {
 	// Based on libwbfs.c's wbfs_open_disc()
 	// and wbfs_get_disc_info().
 	const wbfs_head_t *const head = p->head;
-	uint32_t count = 0;
-	uint32_t i;
-	for (i = 0; i < p->max_disc; i++) {
-		if (head->disc_table[i]) {
-			if (count++ == index) {
-				// Found the disc table index.
-				int ret;
-				size_t size;
-
-				wbfs_disc_t *disc = (wbfs_disc_t*)malloc(sizeof(wbfs_disc_t));
-				if (!disc) {
-					// ENOMEM
-					return NULL;
-				}
-				disc->p = p;
-				disc->i = i;
-
-				// Read the disc header.
-				disc->header = (wbfs_disc_info_t*)malloc(p->disc_info_sz);
-				if (!disc->header) {
-					// ENOMEM
-					free(disc);
-					return NULL;
-				}
+	if (slot >= p->max_disc || !head->disc_table[slot]) {
+		// Disc slot is not in use.
+		return NULL;
+	}
 
-				ret = file->seeko(LBA_TO_BYTES(lba_start) + p->hd_sec_sz + (i*p->disc_info_sz), SEEK_SET);
-				if (ret != 0) {
-					// Seek error.
-					free(disc);
-					return NULL;
-				}
-				size = file->read(disc->header, 1, p->disc_info_sz);
-				if (size != p->disc_info_sz) {
-					// Error reading the disc information.
-					free(disc->header);
-					free(disc);
-					return NULL;
-				}
+	int ret;
+	size_t size;
 
-				// TODO: Byteswap wlba_table[] here?
-				// Removes unnecessary byteswaps when reading,
-				// but may not be necessary if we're not reading
-				// the entire disc.
+	wbfs_disc_t *disc = (wbfs_disc_t*)malloc(sizeof(wbfs_disc_t));
+	if (!disc) {
+		// ENOMEM
+		return NULL;
+	}
+	disc->p = p;
+	disc->i = slot;
 
-				// Disc information read successfully.
-				p->n_disc_open++;
-				return disc;
-			}
+	// Read the disc header.
+	disc->header = (wbfs_disc_info_t*)malloc(p->disc_info_sz);
+	if (!disc->header) {
+		// ENOMEM
+		free(disc);
+		return NULL;
+	}
+
+	ret = file->seeko(LBA_TO_BYTES(lba_start) + p->hd_sec_sz + (slot*p->disc_info_sz), SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		free(disc->header);
+		free(disc);
+		return NULL;
+	}
+	size = file->read(disc->header, 1, p->disc_info_sz);
+	if (size != p->disc_info_sz) {
+		// Error reading the disc information.
+		free(disc->header);
+		free(disc);
+		return NULL;
+	}
+
+	// TODO: Byteswap wlba_table[] here?
+	// Removes unnecessary byteswaps when reading,
+	// but may not be necessary if we're not reading
+	// the entire disc.
+
+	// Make sure all allocated blocks are valid.
+	// If the free blocks table was loaded, blocks that
+	// are marked as free are invalid, since they might
+	// be reused by another disc.
+	for (unsigned int i = 0; i < p->n_wbfs_sec_per_disc; i++) {
+		const unsigned int blk = be16_to_cpu(disc->header->wlba_table[i]);
+		if (blk == 0)
+			continue;
+
+		// NOTE: Block n is bit (n-1) in the free blocks table.
+		if (blk >= p->n_wbfs_sec ||
+		    (p->freeblks &&
+		     (be32_to_cpu(p->freeblks[(blk-1) / 32]) & (1U << ((blk-1) % 32)))))
+		{
+			// Invalid block.
+			free(disc->header);
+			free(disc);
+			errno = EIO;
+			return NULL;
 		}
 	}
 
-	// Disc not found.
-	return NULL;
+	// Disc information read successfully.
+	p->n_disc_open++;
+	return disc;
 }
 
 /**
@@ -349,6 +386,7 @@ WbfsReader::WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len)
 	, m_wlba_table(nullptr)
 {
 	int err = 0;
+	uint32_t slot;
 
 	if (!isOpen()) {
 		// File wasn't opened.
@@ -384,16 +422,94 @@ WbfsReader::WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len)
 	m_wbfs = readWbfsHeader(file, lba_start);
 	if (!m_wbfs) {
 		// Error reading the WBFS header.
+		err = EIO;
 		goto fail;
 	}
 
 	// Open the first disc.
-	m_wbfs_disc = openWbfsDisc(file, lba_start, m_wbfs, 0);
-	if (!m_wbfs_disc) {
+	for (slot = 0; slot < m_wbfs->max_disc; slot++) {
+		if (m_wbfs->head->disc_table[slot])
+			break;
+	}
+	err = openDisc(slot);
+	if (err != 0) {
 		// Error opening the WBFS disc.
 		goto fail;
 	}
 
+	// Reader initialized.
+	return;
+
+fail:
+	// Failed to initialize the reader.
+	closeDisc();
+	m_file->unref();
+	m_file = nullptr;
+	errno = err;
+	return;
+}
+
+/**
+ * Create a WBFS reader for a disc in an already-parsed WBFS image.
+ * @param file		RefFile*.
+ * @param lba_start	[in] Starting LBA,
+ * @param lba_len	[in] Length, in LBAs.
+ * @param wbfs		[in] Shared WBFS header.
+ * @param slot		[in] Disc slot in the WBFS disc table.
+ */
+WbfsReader::WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len,
+	wbfs_t *wbfs, unsigned int slot)
+	: super(file, lba_start, lba_len)
+	, m_real_lba_len(lba_len)
+	, m_block_size_lba(0)
+	, m_wbfs(wbfs)
+	, m_wbfs_disc(nullptr)
+	, m_wlba_table(nullptr)
+{
+	if (!isOpen()) {
+		// File wasn't opened.
+		m_wbfs = nullptr;
+		return;
+	}
+
+	m_lba_start = lba_start;
+	m_lba_len = 0;	// will be set after opening the disc
+	int err = openDisc(slot);
+	if (err != 0) {
+		// Error opening the WBFS disc.
+		closeDisc();
+		m_file->unref();
+		m_file = nullptr;
+		errno = err;
+	}
+}
+
+WbfsReader::~WbfsReader()
+{
+	// Free the WBFS structs.
+	closeDisc();
+
+	// Superclass will unreference the file.
+}
+
+/**
+ * Open a disc from the WBFS image.
+ * m_wbfs must have been set.
+ * @param slot	[in] Disc slot in the WBFS disc table.
+ * @return 0 on success; POSIX error code on error.
+ */
+int WbfsReader::openDisc(unsigned int slot)
+{
+	assert(m_wbfs != nullptr);
+	assert(m_wbfs_disc == nullptr);
+
+	errno = 0;
+	m_wbfs_disc = openWbfsDisc(m_file, m_lba_start, m_wbfs, slot);
+	if (!m_wbfs_disc) {
+		// Error opening the WBFS disc.
+		return (errno != 0 ? errno : EIO);
+	}
+
 	// Save important values for later.
 	m_wlba_table = m_wbfs_disc->header->wlba_table;
 	// TODO: Convert to shift amount?
@@ -402,37 +518,115 @@ WbfsReader::WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len)
 	// Get the size of the WBFS disc.
 	m_lba_len = BYTES_TO_LBA(getWbfsDiscSize(m_wlba_table, m_wbfs_disc));
 
-	// Reader initialized.
 	m_type = RVTH_ImageType_GCM;
-	return;
+	return 0;
+}
 
-fail:
-	// Failed to initialize the reader.
+/**
+ * Close the disc and release the WBFS header.
+ * The WBFS header is freed once all discs are closed.
+ */
+void WbfsReader::closeDisc(void)
+{
 	if (m_wbfs_disc) {
 		closeWbfsDisc(m_wbfs_disc);
 		m_wbfs_disc = nullptr;
+		m_wlba_table = nullptr;
 	}
 	if (m_wbfs) {
-		freeWbfsHeader(m_wbfs);
+		if (m_wbfs->n_disc_open == 0) {
+			freeWbfsHeader(m_wbfs);
+		}
 		m_wbfs = nullptr;
 	}
-	m_file->unref();
-	m_file = nullptr;
-	errno = err;
-	return;
 }
 
-WbfsReader::~WbfsReader()
+/**
+ * Open all discs in a WBFS image.
+ *
+ * The WBFS header and free blocks table are only read once,
+ * and they're shared by all of the returned readers.
+ *
+ * One reader is returned for each disc slot, up to and including
+ * the last slot that's in use. Unused slots, as well as discs
+ * that couldn't be opened, are returned as NULL.
+ * The caller must delete all of the returned readers.
+ *
+ * NOTE: If lba_start == 0 and lba_len == 0, the entire file
+ * will be used.
+ *
+ * @param file		RefFile*.
+ * @param lba_start	[in] Starting LBA,
+ * @param lba_len	[in] Length, in LBAs.
+ * @param readers	[out] Readers, one per disc slot.
+ * @return 0 on success; negative POSIX error code if no discs could be opened.
+ */
+int WbfsReader::openAll(RefFile *file, uint32_t lba_start, uint32_t lba_len,
+	std::vector<WbfsReader*> &readers)
 {
-	// Free the WBFS structs.
-	if (m_wbfs_disc) {
-		closeWbfsDisc(m_wbfs_disc);
+	assert(file != nullptr);
+	readers.clear();
+
+	if (lba_start == 0 && lba_len == 0) {
+		// Determine the maximum LBA.
+		errno = 0;
+		int64_t offset = file->size();
+		if (offset <= 0) {
+			// Empty file and/or seek error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		lba_len = (uint32_t)(offset / LBA_SIZE);
 	}
-	if (m_wbfs) {
-		freeWbfsHeader(m_wbfs);
+
+	// Read the WBFS header.
+	wbfs_t *const p = readWbfsHeader(file, lba_start);
+	if (!p) {
+		// Error reading the WBFS header.
+		return -EIO;
 	}
 
-	// Superclass will unreference the file.
+	// Find the last disc slot that's in use.
+	unsigned int slot_count = 0;
+	for (unsigned int i = 0; i < p->max_disc; i++) {
+		if (p->head->disc_table[i]) {
+			slot_count = i + 1;
+		}
+	}
+
+	// Hold a reference to the WBFS header while opening
+	// the discs so it isn't freed if a disc fails to open.
+	p->n_disc_open++;
+
+	int ret = 0;
+	readers.assign(slot_count, nullptr);
+	for (unsigned int i = 0; i < slot_count; i++) {
+		if (!p->head->disc_table[i]) {
+			// Slot is not in use.
+			continue;
+		}
+
+		// NOTE: If a disc can't be opened, its slot is left
+		// as NULL so the other discs are still accessible.
+		errno = 0;
+		WbfsReader *const reader = new WbfsReader(file, lba_start, lba_len, p, i);
+		if (!reader->isOpen()) {
+			// Error opening the disc.
+			ret = -(errno != 0 ? errno : EIO);
+			delete reader;
+			continue;
+		}
+		readers[i] = reader;
+	}
+
+	// Release the temporary reference.
+	p->n_disc_open--;
+	if (p->n_disc_open == 0) {
+		// No discs are open.
+		freeWbfsHeader(p);
+		readers.clear();
+		return (ret != 0 ? ret : -ENOENT);
+	}
+	return 0;
 }
 
 /**
@@ -489,9 +683,50 @@ uint32_t WbfsReader::read(void *ptr, uint32_t lba_start, uint32_t lba_len)
 				}
 				return 0;
 			}
-			lbas_read++;
 		}
+		lbas_read++;
 	}
 
 	return lbas_read;
 }
+
+/**
+ * Find the next range of LBAs that may contain data.
+ * LBAs between lba_start and the returned extent are known
+ * to be empty, so they don't need to be read.
+ *
+ * Empty blocks are found using the WBFS disc block table.
+ *
+ * @param lba_start	[in] Starting LBA.
+ * @param extent	[out] Data extent.
+ * @return True if an extent was found; false if the rest of the disc image is empty.
+ */
+bool WbfsReader::nextExtent(uint32_t lba_start, Extent &extent)
+{
+	if (lba_start >= m_lba_len) {
+		// End of the disc image.
+		return false;
+	}
+
+	// Find the next used block.
+	const uint32_t block_count = (m_lba_len + m_block_size_lba - 1) / m_block_size_lba;
+	uint32_t block = lba_start / m_block_size_lba;
+	while (block < block_count && be16_to_cpu(m_wlba_table[block]) == 0) {
+		block++;
+	}
+	if (block >= block_count) {
+		// No more data.
+		return false;
+	}
+	const uint32_t ext_start = std::max(lba_start, block * m_block_size_lba);
+
+	// Find the end of the used blocks.
+	while (block < block_count && be16_to_cpu(m_wlba_table[block]) != 0) {
+		block++;
+	}
+	const uint32_t ext_end = std::min(m_lba_len, block * m_block_size_lba);
+
+	extent.lba_start = ext_start;
+	extent.lba_len = ext_end - ext_start;
+	return true;
+}
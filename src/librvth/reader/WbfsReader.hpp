@@ -23,6 +23,9 @@
 
 #include "Reader.hpp"
 
+// C++ includes.
+#include <vector>
+
 struct wbfs_s;
 typedef struct wbfs_s wbfs_t;
 struct wbfs_disc_s;
@@ -45,6 +48,19 @@ class WbfsReader : public Reader
 		 */
 		WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len);
 
+	private:
+		/**
+		 * Create a WBFS reader for a disc in an already-parsed WBFS image.
+		 * @param file		RefFile*.
+		 * @param lba_start	[in] Starting LBA,
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @param wbfs		[in] Shared WBFS header.
+		 * @param slot		[in] Disc slot in the WBFS disc table.
+		 */
+		WbfsReader(RefFile *file, uint32_t lba_start, uint32_t lba_len,
+			wbfs_t *wbfs, unsigned int slot);
+
+	public:
 		virtual ~WbfsReader();
 
 	private:
@@ -60,6 +76,29 @@ class WbfsReader : public Reader
 		 */
 		static bool isSupported(const uint8_t *sbuf, size_t size);
 
+		/**
+		 * Open all discs in a WBFS image.
+		 *
+		 * The WBFS header and free blocks table are only read once,
+		 * and they're shared by all of the returned readers.
+		 *
+		 * One reader is returned for each disc slot, up to and including
+		 * the last slot that's in use. Unused slots, as well as discs
+		 * that couldn't be opened, are returned as NULL.
+		 * The caller must delete all of the returned readers.
+		 *
+		 * NOTE: If lba_start == 0 and lba_len == 0, the entire file
+		 * will be used.
+		 *
+		 * @param file		RefFile*.
+		 * @param lba_start	[in] Starting LBA,
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @param readers	[out] Readers, one per disc slot.
+		 * @return 0 on success; negative POSIX error code if no discs could be opened.
+		 */
+		static int openAll(RefFile *file, uint32_t lba_start, uint32_t lba_len,
+			std::vector<WbfsReader*> &readers);
+
 	public:
 		/** I/O functions **/
 
@@ -72,6 +111,34 @@ class WbfsReader : public Reader
 		 */
 		uint32_t read(void *ptr, uint32_t lba_start, uint32_t lba_len) final;
 
+		/**
+		 * Find the next range of LBAs that may contain data.
+		 * LBAs between lba_start and the returned extent are known
+		 * to be empty, so they don't need to be read.
+		 *
+		 * Empty blocks are found using the WBFS disc block table.
+		 *
+		 * @param lba_start	[in] Starting LBA.
+		 * @param extent	[out] Data extent.
+		 * @return True if an extent was found; false if the rest of the disc image is empty.
+		 */
+		bool nextExtent(uint32_t lba_start, Extent &extent) final;
+
+	private:
+		/**
+		 * Open a disc from the WBFS image.
+		 * m_wbfs must have been set.
+		 * @param slot	[in] Disc slot in the WBFS disc table.
+		 * @return 0 on success; POSIX error code on error.
+		 */
+		int openDisc(unsigned int slot);
+
+		/**
+		 * Close the disc and release the WBFS header.
+		 * The WBFS header is freed once all discs are closed.
+		 */
+		void closeDisc(void);
+
 	private:
 		// NOTE: reader.lba_len is the virtual image size.
 		// real_lba_len is the actual image size.
@@ -81,7 +148,7 @@ class WbfsReader : public Reader
 		uint32_t m_block_size_lba;
 
 		// WBFS structs.
-		wbfs_t *m_wbfs;			// WBFS image.
+		wbfs_t *m_wbfs;			// WBFS image. (shared by all discs)
 		wbfs_disc_t *m_wbfs_disc;	// Current disc.
 
 		const be16_t *m_wlba_table;	// Pointer to m_wbfs_disc->disc->header->wlba_table.
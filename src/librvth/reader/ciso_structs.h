@@ -0,0 +1,41 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * ciso_structs.h: CISO disc image structs.                                *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_READER_CISO_STRUCTS_H__
+#define __RVTHTOOL_LIBRVTH_READER_CISO_STRUCTS_H__
+
+#include <stdint.h>
+#include "libwiicrypto/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CISO_HEADER_SIZE 0x8000
+#define CISO_MAP_SIZE (CISO_HEADER_SIZE - sizeof(uint32_t) - (sizeof(char) * 4))
+
+// 32 KB minimum block size (GCN/Wii sector)
+// 16 MB maximum block size
+#define CISO_BLOCK_SIZE_MIN (32768)
+#define CISO_BLOCK_SIZE_MAX (16*1024*1024)
+
+// CISO magic.
+static const char CISO_MAGIC[4] = {'C','I','S','O'};
+
+typedef struct PACKED _CisoHeader {
+	char magic[4];			// "CISO"
+	uint32_t block_size;		// LE32
+	uint8_t map[CISO_MAP_SIZE];	// 0 == unused; 1 == used; other == invalid
+} CisoHeader;
+ASSERT_STRUCT(CisoHeader, CISO_HEADER_SIZE);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_LIBRVTH_READER_CISO_STRUCTS_H__ */
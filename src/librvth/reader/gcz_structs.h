@@ -0,0 +1,63 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * gcz_structs.h: GCZ (Dolphin compressed disc image) structs.             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// References:
+// - https://github.com/dolphin-emu/dolphin/blob/master/Source/Core/DiscIO/CompressedBlob.h
+
+#ifndef __RVTHTOOL_LIBRVTH_READER_GCZ_STRUCTS_H__
+#define __RVTHTOOL_LIBRVTH_READER_GCZ_STRUCTS_H__
+
+#include <stdint.h>
+#include "libwiicrypto/common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// GCZ magic.
+#define GCZ_MAGIC 0xB10BC001
+
+// GCZ sub types.
+#define GCZ_SUB_TYPE_GCN	0
+#define GCZ_SUB_TYPE_WII	1
+
+// Block pointer flag: If set, the block is stored uncompressed.
+#define GCZ_BLOCK_UNCOMPRESSED	(1ULL << 63)
+
+// Default block size used when writing GCZ images. (32 KB)
+#define GCZ_BLOCK_SIZE_DEFAULT	(32768)
+
+// Supported block sizes for reading.
+#define GCZ_BLOCK_SIZE_MIN	(512)
+#define GCZ_BLOCK_SIZE_MAX	(16*1024*1024)
+
+/**
+ * GCZ header.
+ * All fields are little-endian.
+ *
+ * The header is followed by:
+ * - uint64_t block_pointers[num_blocks]: Offsets relative to the
+ *   start of the compressed data. (See GCZ_BLOCK_UNCOMPRESSED.)
+ * - uint32_t hashes[num_blocks]: Adler-32 of each stored block.
+ * - Compressed data.
+ */
+typedef struct PACKED _GCZ_Header {
+	uint32_t magic;			// [0x000] GCZ_MAGIC
+	uint32_t sub_type;		// [0x004] Sub type (See GCZ_SUB_TYPE_*)
+	uint64_t compressed_data_size;	// [0x008] Size of the compressed data
+	uint64_t data_size;		// [0x010] Size of the uncompressed disc image
+	uint32_t block_size;		// [0x018] Block size
+	uint32_t num_blocks;		// [0x01C] Number of blocks
+} GCZ_Header;
+ASSERT_STRUCT(GCZ_Header, 32);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_LIBRVTH_READER_GCZ_STRUCTS_H__ */
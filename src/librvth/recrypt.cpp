@@ -18,8 +18,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.   *
  ***************************************************************************/
 
+#include "config.librvth.h"
+
 #include "rvth.hpp"
+#include "bank_init.h"
 #include "ptbl.h"
+#include "ProgressSink.hpp"
 #include "rvth_error.h"
 
 // For LBA_TO_BYTES()
@@ -36,6 +40,7 @@
 #include "libwiicrypto/rsaw.h"
 #include "libwiicrypto/priv_key_store.h"
 #include "libwiicrypto/sig_tools.h"
+#include "libwiicrypto/threadw.h"
 
 #include "byteswap.h"
 
@@ -47,6 +52,11 @@
 #include <cerrno>
 #include <cstddef>
 #include <cstring>
+#include <ctime>
+
+// C++ includes.
+#include <vector>
+using std::vector;
 
 // Sector buffer. (1 LBA)
 typedef union _sbuf1_t {
@@ -89,6 +99,21 @@ static const uint8_t id_pub[256] = {
 	0x2B,0xDF,0x94,0x14,0x0A,0x7B,0xE0,0xBA,0x40,0x29,0xC5,0x23,0x30,0x2C,0x14,0xC1
 };
 
+#if !defined(_WIN32) && (!defined(HAVE_GMTIME_R) || !defined(HAVE_LOCALTIME_R))
+// Serializes access to the static buffers used by gmtime() and localtime().
+static threadw_once_t tm_mutex_once = THREADW_ONCE_INIT;
+static threadw_mutex_t tm_mutex;
+
+/**
+ * Initialize tm_mutex.
+ * Called by threadw_once().
+ */
+static void tm_mutex_init(void)
+{
+	threadw_mutex_init(&tm_mutex);
+}
+#endif
+
 /**
  * @param id ID buffer.
  * @param size Size of `id`. (Must be >= 256 bytes.)
@@ -119,9 +144,24 @@ static int rvth_create_id(uint8_t *id, size_t size,
 	// Clear the buffer.
 	memset(buf, 0xFF, sizeof(buf));
 
-	// TODO: gmtime_r(), localtime_r()
-	tmbuf_utc = *gmtime(&now);
-	tmbuf_local = *localtime(&now);
+	// NOTE: This may be called from multiple threads,
+	// so the reentrant versions must be used.
+#if defined(_WIN32)
+	gmtime_s(&tmbuf_utc, &now);
+	localtime_s(&tmbuf_local, &now);
+#elif defined(HAVE_GMTIME_R) && defined(HAVE_LOCALTIME_R)
+	gmtime_r(&now, &tmbuf_utc);
+	localtime_r(&now, &tmbuf_local);
+#else
+	{
+		// No reentrant functions. Serialize access to the static buffers.
+		threadw_once(&tm_mutex_once, tm_mutex_init);
+		threadw_mutex_lock(&tm_mutex);
+		tmbuf_utc = *gmtime(&now);
+		tmbuf_local = *localtime(&now);
+		threadw_mutex_unlock(&tm_mutex);
+	}
+#endif
 
 	// Timezone offset.
 	tzoffset = ((tmbuf_local.tm_hour * 60) + (tmbuf_local.tm_min)) -
@@ -311,66 +351,37 @@ int RvtH::recryptID(unsigned int bank)
 }
 
 /**
- * Re-encrypt partitions in a Wii disc image.
- *
- * This operation will *wipe* the update partition, since installing
- * retail updates on a debug system and vice-versa can result in a brick.
- *
- * NOTE: This function only supports converting from one encryption to
- * another. It does not support converting unencrypted to encrypted or
- * vice-versa.
- *
- * NOTE 2: Any partitions that are already encrypted with the specified key
- * will be left as-is; however, the tickets and TMDs wlil be re-signed.
- *
- * @param bank		[in] Bank number. (0-7)
- * @param cryptoType	[in] New encryption type.
- * @param callback	[in,opt] Progress callback.
- * @param userdata	[in,opt] User data for progress callback.
- * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
- * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ * Get the AES key index for a Wii encryption type.
+ * @param cryptoType	[in] Encryption type.
+ * @return AES key index, or RVL_KEY_MAX if the encryption type is invalid.
  */
-int RvtH::recryptWiiPartitions(unsigned int bank,
-	RVL_CryptoType_e cryptoType,
-	RvtH_Progress_Callback callback, void *userdata,
-	int ios_force)
+static RVL_AES_Keys_e cryptoTypeToKeyIdx(RVL_CryptoType_e cryptoType)
 {
-	uint32_t lba_size;
-
-	int ret = 0;	// errno or RvtH_Errors
-
-	// Certificates.
-	const RVL_Cert_RSA2048 *cert_ticket;
-	const RVL_Cert_RSA4096_RSA2048 *cert_CA;
-	const RVL_Cert_RSA2048 *cert_TMD;
-	const char *issuer_TMD;
-
-	// Sector buffer.
-	sbuf1_t sbuf;
-	GCN_DiscHeader gcn;
-
-	// Partitions to re-encrypt.
-	// NOTE: This only contains the LBA starting address.
-	// The actual partition length is in the partition header.
-	// TODO: Unencrypted partitions will need special handling.
-	const pt_entry_t *pte;
-
-	// Callback state.
-	RvtH_Progress_State state;
-
-	if (cryptoType < RVL_CryptoType_Debug ||
-	    cryptoType >= RVL_CryptoType_MAX)
-	{
-		errno = EINVAL;
-		return -EINVAL;
-	} else if (bank >= m_bankCount) {
-		// Bank number is out of range.
-		errno = ERANGE;
-		return -ERANGE;
+	switch (cryptoType) {
+		case RVL_CryptoType_Debug:
+			return RVL_KEY_DEBUG;
+		case RVL_CryptoType_Retail:
+			return RVL_KEY_RETAIL;
+		case RVL_CryptoType_Korean:
+			// TODO: RVL_CryptoType_Korean_Debug?
+			return RVL_KEY_KOREAN;
+		case RVL_CryptoType_vWii:
+			// TODO: RVL_CryptoType_vWii_Debug?
+			return vWii_KEY_RETAIL;
+		default:
+			// Invalid key index.
+			return RVL_KEY_MAX;
 	}
+}
 
+/**
+ * Check if a bank can be recrypted.
+ * @param entry		[in] RvtH_BankEntry
+ * @return 0 if the bank can be recrypted; otherwise, see RvtH_Errors.
+ */
+static int checkRecryptBank(const RvtH_BankEntry *entry)
+{
 	// Check the bank type.
-	RvtH_BankEntry *const entry = &m_entries[bank];
 	switch (entry->type) {
 		case RVTH_BankType_Wii_SL:
 		case RVTH_BankType_Wii_DL:
@@ -402,64 +413,28 @@ int RvtH::recryptWiiPartitions(unsigned int bank,
 		return RVTH_ERROR_IS_UNENCRYPTED;
 	}
 
-	// Determine the key index.
-	RVL_AES_Keys_e toKey;
-	switch (cryptoType) {
-		case RVL_CryptoType_Debug:
-			toKey = RVL_KEY_DEBUG;
-			break;
-		case RVL_CryptoType_Retail:
-			toKey = RVL_KEY_RETAIL;
-			break;
-		case RVL_CryptoType_Korean:
-			// TODO: RVL_CryptoType_Korean_Debug?
-			toKey = RVL_KEY_KOREAN;
-			break;
-		case RVL_CryptoType_vWii:
-			// TODO: RVL_CryptoType_vWii_Debug?
-			toKey = vWii_KEY_RETAIL;
-			break;
-		default:
-			// Invalid key index.
-			return -EINVAL;
-	}
-
-	// NOTE: We're not checking for encryption/signature type,
-	// since we're doing that for each partition individually.
-
-	// Make the RVT-H object writable.
-	ret = this->makeWritable();
-	if (ret != 0) {
-		// Could not make the RVT-H object writable.
-		int err;
-		if (ret < 0) {
-			err = -ret;
-		} else {
-			err = EROFS;
-		}
-		errno = err;
-		return ret;
-	}
+	return 0;
+}
 
-	if (callback) {
-		// Initialize the callback state.
-		state.rvth = this;
-		state.rvth_gcm = NULL;
-		state.bank_rvth = bank;
-		state.bank_gcm = ~0;
-		// (0,1) because we're only recrypting the ticket(s) and TMD(s).
-		// lba_processed == 0 indicates we're starting.
-		// lba_processed == 1 indicates we're done.
-		state.type = RVTH_PROGRESS_RECRYPT;
-		state.lba_processed = 0;
-		state.lba_total = 1;
-		callback(&state, userdata);
-	}
+/**
+ * Read the GCN disc header and prepare the partition table for recryption.
+ *
+ * Update partitions are removed from the in-memory partition table.
+ * The updated partition table is *not* written to the disc image;
+ * call rvth_ptbl_write() afterwards.
+ *
+ * @param entry		[in] RvtH_BankEntry
+ * @param gcn		[out] GCN disc header.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+static int prepareRecryptBank(RvtH_BankEntry *entry, GCN_DiscHeader *gcn)
+{
+	sbuf1_t sbuf;
+	int ret;
 
 	// Get the GCN disc header.
-	Reader *const reader = entry->reader;
 	errno = 0;
-	lba_size = reader->read(&sbuf.u8, 0, 1);
+	const uint32_t lba_size = entry->reader->read(&sbuf.u8, 0, 1);
 	if (lba_size != 1) {
 		// Read error.
 		int err = errno;
@@ -469,7 +444,7 @@ int RvtH::recryptWiiPartitions(unsigned int bank,
 		}
 		return -err;
 	}
-	memcpy(&gcn, &sbuf.gcn, sizeof(gcn));
+	memcpy(gcn, &sbuf.gcn, sizeof(*gcn));
 
 	// Make sure the partition table is loaded.
 	ret = rvth_ptbl_load(entry);
@@ -489,13 +464,40 @@ int RvtH::recryptWiiPartitions(unsigned int bank,
 		return ret;
 	}
 
-	// Write the updated partition table.
-	ret = rvth_ptbl_write(entry);
-	if (ret != 0) {
-		// Unable to write the updated partition table.
-		errno = -ret;
-		return ret;
-	}
+	return 0;
+}
+
+/**
+ * Rebuild a partition header using the specified key.
+ *
+ * This function doesn't do any I/O, so it's safe to call
+ * from multiple threads for different partitions.
+ *
+ * @param hdr_new	[out] Rebuilt partition header.
+ * @param hdr_orig	[in] Original partition header.
+ * @param pte		[in] Partition table entry.
+ * @param gcn		[in] GCN disc header.
+ * @param toKey		[in] New encryption key.
+ * @param ios_force	[in] IOS version to force. (-1 to use the existing IOS)
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+static int rebuildPartitionHeader(RVL_PartitionHeader *hdr_new,
+	const RVL_PartitionHeader *hdr_orig,
+	const pt_entry_t *pte, const GCN_DiscHeader *gcn,
+	RVL_AES_Keys_e toKey, int ios_force)
+{
+	// Certificates.
+	const RVL_Cert_RSA2048 *cert_ticket;
+	const RVL_Cert_RSA4096_RSA2048 *cert_CA;
+	const RVL_Cert_RSA2048 *cert_TMD;
+	const char *issuer_TMD;
+
+	uint32_t data_pos;		// Current position in hdr_new->u8[].
+	uint32_t tmd_size, tmd_offset_orig;
+	RVL_TMD_Header *tmdHeader;
+	uint32_t cert_chain_size_new;
+	uint8_t *p_cert_chain;
+	int ret;
 
 	// Get the certificates.
 	if (toKey != RVL_KEY_DEBUG) {
@@ -512,169 +514,153 @@ int RvtH::recryptWiiPartitions(unsigned int bank,
 		issuer_TMD	= RVL_Cert_Issuers[RVL_CERT_ISSUER_DPKI_TMD];
 	}
 
-	// Process the other partitions.
-	pte = entry->ptbl;
-	for (unsigned int i = 0; i < entry->pt_count; i++, pte++) {
-		RVL_PartitionHeader hdr_orig;	// Original header
-		RVL_PartitionHeader hdr_new;	// Rebuilt header
-		uint32_t data_pos;		// Current position in hdr_new.u8[].
-		uint32_t tmd_size, tmd_offset_orig;
-		RVL_TMD_Header *tmdHeader;
-		uint32_t cert_chain_size_new;
-		uint8_t *p_cert_chain;
-
-		//uint32_t tmd_size, tmd_offset;
-
-		// Read the partition header.
-		errno = 0;
-		lba_size = reader->read(&hdr_orig, pte->lba_start, BYTES_TO_LBA(sizeof(hdr_orig.u8)));
-		if (lba_size != BYTES_TO_LBA(sizeof(hdr_orig))) {
-			// Read error.
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-				errno = EIO;
-			}
-			return -err;
-		}
-
-		// TODO: Check if the partition is already encrypted with the target keys.
-		// If it is, skip it.
-		memset(&hdr_new, 0, sizeof(hdr_new));
-
-		// Copy in the ticket.
-		memcpy(&hdr_new.ticket, &hdr_orig.ticket, sizeof(hdr_new.ticket));
-		// Recrypt the ticket. (This also updates the issuer.)
-		ret = sig_recrypt_ticket(&hdr_new.ticket, toKey);
-		if (ret != 0) {
-			// Error recrypting the ticket.
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-				errno = EIO;
-			}
-			return -err;
-		}
-		// Sign the ticket.
-		// TODO: Error checking.
-		// TODO: Support larger tickets.
-		if (likely(toKey != RVL_KEY_DEBUG)) {
-			// Retail: Fakesign the ticket.
-			// Dolphin and cIOSes ignore the signature anyway.
-			cert_fakesign_ticket((uint8_t*)&hdr_new.ticket, sizeof(hdr_new.ticket));
-		} else {
-			// Debug: Use the real signing keys.
-			// Debug IOS requires a valid signature.
-			cert_realsign_ticketOrTMD((uint8_t*)&hdr_new.ticket, sizeof(hdr_new.ticket), &rvth_privkey_RVL_dpki_ticket);
-		}
-
-		// Starting position.
-		data_pos = offsetof(RVL_PartitionHeader, data);
-		data_pos = ALIGN_BYTES(64, data_pos);
+	// TODO: Check if the partition is already encrypted with the target keys.
+	// If it is, skip it.
+	memset(hdr_new, 0, sizeof(*hdr_new));
 
-		// Copy in the TMD.
-		tmd_size = be32_to_cpu(hdr_orig.tmd_size);
-		tmd_offset_orig = be32_to_cpu(hdr_orig.tmd_offset) << 2;
-		if (data_pos + tmd_size > sizeof(hdr_new)) {
-			// Invalid...
+	// Copy in the ticket.
+	memcpy(&hdr_new->ticket, &hdr_orig->ticket, sizeof(hdr_new->ticket));
+	// Recrypt the ticket. (This also updates the issuer.)
+	ret = sig_recrypt_ticket(&hdr_new->ticket, toKey);
+	if (ret != 0) {
+		// Error recrypting the ticket.
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
 			errno = EIO;
-			return RVTH_ERROR_PARTITION_HEADER_CORRUPTED;
-		}
-		memcpy(&hdr_new.u8[data_pos], &hdr_orig.u8[tmd_offset_orig], tmd_size);
-
-		// Change the issuer.
-		tmdHeader = (RVL_TMD_Header*)&hdr_new.u8[data_pos];
-		// NOTE: MSVC Secure Overloads will change strncpy() to strncpy_s(),
-		// which doesn't clear the buffer. Hence, we'll need to explicitly
-		// clear the buffer first.
-		memset(tmdHeader->issuer, 0, sizeof(tmdHeader->issuer));
-		strncpy(tmdHeader->issuer, issuer_TMD, sizeof(tmdHeader->issuer));
-
-		// Change the IOS if necessary.
-		if (ios_force >= 3) {
-			uint32_t ios_uint = static_cast<uint32_t>(ios_force);
-			if (ios_uint != be32_to_cpu(tmdHeader->sys_version.lo)) {
-				tmdHeader->sys_version.lo = cpu_to_be32(ios_uint);
-			}
 		}
+		return -err;
+	}
+	// Sign the ticket.
+	// TODO: Support larger tickets.
+	if (likely(toKey != RVL_KEY_DEBUG)) {
+		// Retail: Fakesign the ticket.
+		// Dolphin and cIOSes ignore the signature anyway.
+		ret = cert_fakesign_ticket((uint8_t*)&hdr_new->ticket, sizeof(hdr_new->ticket));
+	} else {
+		// Debug: Use the real signing keys.
+		// Debug IOS requires a valid signature.
+		ret = cert_realsign_ticketOrTMD((uint8_t*)&hdr_new->ticket, sizeof(hdr_new->ticket), &rvth_privkey_RVL_dpki_ticket);
+	}
+	if (ret != 0) {
+		// Error signing the ticket.
+		errno = -ret;
+		return ret;
+	}
 
-		// Sign the TMD.
-		// TODO: Error checking.
-		if (likely(toKey != RVL_KEY_DEBUG)) {
-			// Retail: Fakesign the TMD.
-			// Dolphin and cIOSes ignore the signature anyway.
-			cert_fakesign_tmd(&hdr_new.u8[data_pos], tmd_size);
-		} else {
-			// Debug: Use the real signing keys.
-			// Debug IOS requires a valid signature.
-			cert_realsign_ticketOrTMD(&hdr_new.u8[data_pos], tmd_size, &rvth_privkey_RVL_dpki_tmd);
-		}
+	// Starting position.
+	data_pos = offsetof(RVL_PartitionHeader, data);
+	data_pos = ALIGN_BYTES(64, data_pos);
 
-		// TMD parameters.
-		hdr_new.tmd_size = hdr_orig.tmd_size;
-		hdr_new.tmd_offset = cpu_to_be32(data_pos >> 2);
-		data_pos += ALIGN_BYTES(64, tmd_size);
-
-		// Write the new certificate chain.
-		// NOTE: RVT-H images usually have a development certificate,
-		// which makes the debug cert chain 0xC40 bytes. The retail
-		// cert chain is 0xA00 bytes.
-		cert_chain_size_new = sizeof(*cert_ticket) + sizeof(*cert_CA) + sizeof(*cert_TMD);
-		if (data_pos + cert_chain_size_new > sizeof(hdr_new)) {
-			// Invalid...
-			errno = EIO;
-			return RVTH_ERROR_PARTITION_HEADER_CORRUPTED;
+	// Copy in the TMD.
+	tmd_size = be32_to_cpu(hdr_orig->tmd_size);
+	tmd_offset_orig = be32_to_cpu(hdr_orig->tmd_offset) << 2;
+	if (data_pos + tmd_size > sizeof(*hdr_new) ||
+	    tmd_offset_orig + tmd_size > sizeof(*hdr_orig))
+	{
+		// Invalid...
+		errno = EIO;
+		return RVTH_ERROR_PARTITION_HEADER_CORRUPTED;
+	}
+	memcpy(&hdr_new->u8[data_pos], &hdr_orig->u8[tmd_offset_orig], tmd_size);
+
+	// Change the issuer.
+	tmdHeader = (RVL_TMD_Header*)&hdr_new->u8[data_pos];
+	// NOTE: MSVC Secure Overloads will change strncpy() to strncpy_s(),
+	// which doesn't clear the buffer. Hence, we'll need to explicitly
+	// clear the buffer first.
+	memset(tmdHeader->issuer, 0, sizeof(tmdHeader->issuer));
+	strncpy(tmdHeader->issuer, issuer_TMD, sizeof(tmdHeader->issuer));
+
+	// Change the IOS if necessary.
+	if (ios_force >= 3) {
+		uint32_t ios_uint = static_cast<uint32_t>(ios_force);
+		if (ios_uint != be32_to_cpu(tmdHeader->sys_version.lo)) {
+			tmdHeader->sys_version.lo = cpu_to_be32(ios_uint);
 		}
+	}
 
-		// Certificate chain order for retail is Ticket, CA, TMD.
-		// TODO: Verify for debug! (and write the dev cert?)
-		// NOTE: WAD cert chain order is CA, Ticket, TMD...
-		// (CA, Ticket, TMD, Dev for debug)
-		// TODO: Verify all of this.
-		p_cert_chain = &hdr_new.u8[data_pos];
-		memcpy(p_cert_chain, cert_ticket, sizeof(*cert_ticket));
-		p_cert_chain += sizeof(*cert_ticket);
-		memcpy(p_cert_chain, cert_CA, sizeof(*cert_CA));
-		p_cert_chain += sizeof(*cert_CA);
-		memcpy(p_cert_chain, cert_TMD, sizeof(*cert_TMD));
-
-		hdr_new.cert_chain_size = cpu_to_be32(cert_chain_size_new);
-		hdr_new.cert_chain_offset = cpu_to_be32(data_pos >> 2);
-
-		// H3 table offset.
-		// Copied as-is, since we're not changing it.
-		hdr_new.h3_table_offset = hdr_orig.h3_table_offset;
-
-		// Data offset and size.
-		// TODO: If data size is 0, calculate it.
-		hdr_new.data_offset = hdr_orig.data_offset;
-		hdr_new.data_size = hdr_orig.data_size;
-
-		// Write the identifier.
-		// (Only if this area is empty!)
-		if (isBlockEmpty(&hdr_new.data[sizeof(hdr_new.data)-256], 256)) {
-			char ptid_buf[24];
-			snprintf(ptid_buf, sizeof(ptid_buf), "%up%u -> %up%u",
-				pte->vg, pte->pt_orig,
-				pte->vg, pte->pt);
-			rvth_create_id(&hdr_new.data[sizeof(hdr_new.data)-256], 256, &gcn, ptid_buf);
-		}
+	// Sign the TMD.
+	if (likely(toKey != RVL_KEY_DEBUG)) {
+		// Retail: Fakesign the TMD.
+		// Dolphin and cIOSes ignore the signature anyway.
+		ret = cert_fakesign_tmd(&hdr_new->u8[data_pos], tmd_size);
+	} else {
+		// Debug: Use the real signing keys.
+		// Debug IOS requires a valid signature.
+		ret = cert_realsign_ticketOrTMD(&hdr_new->u8[data_pos], tmd_size, &rvth_privkey_RVL_dpki_tmd);
+	}
+	if (ret != 0) {
+		// Error signing the TMD.
+		errno = -ret;
+		return ret;
+	}
 
-		// Write the new partition header.
-		errno = 0;
-		lba_size = reader->write(&hdr_new, pte->lba_start, BYTES_TO_LBA(sizeof(hdr_new.u8)));
-		if (lba_size != BYTES_TO_LBA(sizeof(hdr_new))) {
-			// Write error.
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-				errno = EIO;
-			}
-			return -err;
+	// TMD parameters.
+	hdr_new->tmd_size = hdr_orig->tmd_size;
+	hdr_new->tmd_offset = cpu_to_be32(data_pos >> 2);
+	data_pos += ALIGN_BYTES(64, tmd_size);
+
+	// Write the new certificate chain.
+	// NOTE: RVT-H images usually have a development certificate,
+	// which makes the debug cert chain 0xC40 bytes. The retail
+	// cert chain is 0xA00 bytes.
+	cert_chain_size_new = sizeof(*cert_ticket) + sizeof(*cert_CA) + sizeof(*cert_TMD);
+	if (data_pos + cert_chain_size_new > sizeof(*hdr_new)) {
+		// Invalid...
+		errno = EIO;
+		return RVTH_ERROR_PARTITION_HEADER_CORRUPTED;
+	}
+
+	// Certificate chain order for retail is Ticket, CA, TMD.
+	// TODO: Verify for debug! (and write the dev cert?)
+	// NOTE: WAD cert chain order is CA, Ticket, TMD...
+	// (CA, Ticket, TMD, Dev for debug)
+	// TODO: Verify all of this.
+	p_cert_chain = &hdr_new->u8[data_pos];
+	memcpy(p_cert_chain, cert_ticket, sizeof(*cert_ticket));
+	p_cert_chain += sizeof(*cert_ticket);
+	memcpy(p_cert_chain, cert_CA, sizeof(*cert_CA));
+	p_cert_chain += sizeof(*cert_CA);
+	memcpy(p_cert_chain, cert_TMD, sizeof(*cert_TMD));
+
+	hdr_new->cert_chain_size = cpu_to_be32(cert_chain_size_new);
+	hdr_new->cert_chain_offset = cpu_to_be32(data_pos >> 2);
+
+	// H3 table offset.
+	// Copied as-is, since we're not changing it.
+	hdr_new->h3_table_offset = hdr_orig->h3_table_offset;
+
+	// Data offset and size.
+	// TODO: If data size is 0, calculate it.
+	hdr_new->data_offset = hdr_orig->data_offset;
+	hdr_new->data_size = hdr_orig->data_size;
+
+	// Write the identifier.
+	// (Only if this area is empty!)
+	if (RvtH::isBlockEmpty(&hdr_new->data[sizeof(hdr_new->data)-256], 256)) {
+		char ptid_buf[24];
+		snprintf(ptid_buf, sizeof(ptid_buf), "%up%u -> %up%u",
+			pte->vg, pte->pt_orig,
+			pte->vg, pte->pt);
+		ret = rvth_create_id(&hdr_new->data[sizeof(hdr_new->data)-256], 256, gcn, ptid_buf);
+		if (ret != 0) {
+			// Error creating the identifier.
+			errno = -ret;
+			return ret;
 		}
 	}
 
-	// Update the bank entry.
+	return 0;
+}
+
+/**
+ * Update a bank entry's encryption and signature fields after recryption.
+ * @param entry		[in,out] RvtH_BankEntry
+ * @param toKey		[in] New encryption key.
+ */
+static void updateRecryptedBankEntry(RvtH_BankEntry *entry, RVL_AES_Keys_e toKey)
+{
 	switch (toKey) {
 		case RVL_KEY_RETAIL:
 			entry->crypto_type = RVL_CryptoType_Retail;
@@ -726,20 +712,509 @@ int RvtH::recryptWiiPartitions(unsigned int bank,
 			assert(false);
 			break;
 	}
+}
+
+/**
+ * Re-encrypt partitions in a Wii disc image.
+ *
+ * This operation will *wipe* the update partition, since installing
+ * retail updates on a debug system and vice-versa can result in a brick.
+ *
+ * NOTE: This function only supports converting from one encryption to
+ * another. It does not support converting unencrypted to encrypted or
+ * vice-versa.
+ *
+ * NOTE 2: Any partitions that are already encrypted with the specified key
+ * will be left as-is; however, the tickets and TMDs wlil be re-signed.
+ *
+ * @param bank		[in] Bank number. (0-7)
+ * @param cryptoType	[in] New encryption type.
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::recryptWiiPartitions(unsigned int bank,
+	RVL_CryptoType_e cryptoType,
+	RvtH_Progress_Callback callback, void *userdata,
+	int ios_force)
+{
+	uint32_t lba_size;
+
+	int ret = 0;	// errno or RvtH_Errors
+
+	GCN_DiscHeader gcn;
+
+	// Partitions to re-encrypt.
+	// NOTE: This only contains the LBA starting address.
+	// The actual partition length is in the partition header.
+	// TODO: Unencrypted partitions will need special handling.
+	const pt_entry_t *pte;
+
+	// Callback state.
+	RvtH_Progress_State state;
+
+	if (cryptoType < RVL_CryptoType_Debug ||
+	    cryptoType >= RVL_CryptoType_MAX)
+	{
+		errno = EINVAL;
+		return -EINVAL;
+	} else if (bank >= m_bankCount) {
+		// Bank number is out of range.
+		errno = ERANGE;
+		return -ERANGE;
+	}
+
+	// Check the bank type.
+	RvtH_BankEntry *const entry = &m_entries[bank];
+	ret = checkRecryptBank(entry);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Determine the key index.
+	const RVL_AES_Keys_e toKey = cryptoTypeToKeyIdx(cryptoType);
+	if (toKey >= RVL_KEY_MAX) {
+		// Invalid key index.
+		return -EINVAL;
+	}
+
+	// NOTE: We're not checking for encryption/signature type,
+	// since we're doing that for each partition individually.
+
+	// Make the RVT-H object writable.
+	ret = this->makeWritable();
+	if (ret != 0) {
+		// Could not make the RVT-H object writable.
+		int err;
+		if (ret < 0) {
+			err = -ret;
+		} else {
+			err = EROFS;
+		}
+		errno = err;
+		return ret;
+	}
+
+	if (callback) {
+		// Initialize the callback state.
+		state.rvth = this;
+		state.rvth_gcm = NULL;
+		state.bank_rvth = bank;
+		state.bank_gcm = ~0;
+		// (0,1) because we're only recrypting the ticket(s) and TMD(s).
+		// lba_processed == 0 indicates we're starting.
+		// lba_processed == 1 indicates we're done.
+		state.type = RVTH_PROGRESS_RECRYPT;
+		state.lba_processed = 0;
+		state.lba_total = 1;
+		callback(&state, userdata);
+	}
+	if (m_progress) {
+		m_progress->begin(RVTH_PROGRESS_RECRYPT, 1);
+	}
+
+	// Get the GCN disc header and the partition table.
+	ret = prepareRecryptBank(entry, &gcn);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Write the updated partition table.
+	Reader *const reader = entry->reader;
+	ret = rvth_ptbl_write(entry);
+	if (ret != 0) {
+		// Unable to write the updated partition table.
+		errno = -ret;
+		return ret;
+	}
+
+	// Process the other partitions.
+	pte = entry->ptbl;
+	for (unsigned int i = 0; i < entry->pt_count; i++, pte++) {
+		RVL_PartitionHeader hdr_orig;	// Original header
+		RVL_PartitionHeader hdr_new;	// Rebuilt header
+
+		// Read the partition header.
+		errno = 0;
+		lba_size = reader->read(&hdr_orig, pte->lba_start, BYTES_TO_LBA(sizeof(hdr_orig.u8)));
+		if (lba_size != BYTES_TO_LBA(sizeof(hdr_orig))) {
+			// Read error.
+			int err = errno;
+			if (err == 0) {
+				err = EIO;
+				errno = EIO;
+			}
+			return -err;
+		}
+
+		// Rebuild the partition header.
+		ret = rebuildPartitionHeader(&hdr_new, &hdr_orig, pte, &gcn, toKey, ios_force);
+		if (ret != 0) {
+			return ret;
+		}
+
+		// Write the new partition header.
+		errno = 0;
+		lba_size = reader->write(&hdr_new, pte->lba_start, BYTES_TO_LBA(sizeof(hdr_new.u8)));
+		if (lba_size != BYTES_TO_LBA(sizeof(hdr_new))) {
+			// Write error.
+			int err = errno;
+			if (err == 0) {
+				err = EIO;
+				errno = EIO;
+			}
+			return -err;
+		}
+	}
+
+	// Update the bank entry.
+	updateRecryptedBankEntry(entry, toKey);
+
+	// If this is an HDD, write the bank table entry.
+	if (isHDD()) {
+		// TODO: Check for errors.
+		this->writeBankEntry(bank);
+	}
+
+	// Finished processing the disc image.
+	reader->flush();
+
+	if (m_progress) {
+		m_progress->update(1);
+	}
+	if (callback) {
+		state.lba_processed = 1;
+		callback(&state, userdata);
+	}
 
-	// If this is an HDD, write the bank table entry.
-	if (isHDD()) {
-		// TODO: Check for errors.
-		this->writeBankEntry(bank);
-	}
-
-	// Finished processing the disc image.
-	reader->flush();
-
-	if (callback) {
-		state.lba_processed = 1;
-		callback(&state, userdata);
-	}
-
 	return ret;
 }
+
+/**
+ * Check if a signature status is valid for the specified signature type.
+ * Retail signatures are always fakesigned when recrypting, so fakesigned
+ * retail signatures are considered valid.
+ * @param sigStatus	[in] Signature status.
+ * @param sigType	[in] Signature type.
+ * @return True if valid; false if not.
+ */
+static inline bool isSigStatusValid(uint8_t sigStatus, RVL_SigType_e sigType)
+{
+	return (sigStatus == RVL_SigStatus_OK ||
+		(sigType == RVL_SigType_Retail && sigStatus == RVL_SigStatus_Fake));
+}
+
+// Partition header recryption job for recryptAllBanks().
+struct RecryptJob {
+	RvtH_BankEntry *entry;		// Bank entry
+	const pt_entry_t *pte;		// Partition table entry
+	const GCN_DiscHeader *gcn;	// GCN disc header
+	RVL_PartitionHeader hdr_orig;	// Original header
+	RVL_PartitionHeader hdr_new;	// Rebuilt header
+	int ret;			// Result
+};
+
+// Shared parameters for recryptAllBanks() worker threads.
+struct RecryptJobParams {
+	RecryptJob *jobs;
+	RVL_AES_Keys_e toKey;
+	int ios_force;
+};
+
+/**
+ * Worker function for recryptAllBanks().
+ * Rebuilds and signs a single partition header.
+ * @param index		[in] Job index.
+ * @param userdata	[in] RecryptJobParams
+ */
+static void recryptJobWorker(unsigned int index, void *userdata)
+{
+	const RecryptJobParams *const params = static_cast<const RecryptJobParams*>(userdata);
+	RecryptJob *const job = &params->jobs[index];
+	job->ret = rebuildPartitionHeader(&job->hdr_new, &job->hdr_orig,
+		job->pte, job->gcn, params->toKey, params->ios_force);
+}
+
+/**
+ * Discard the in-memory partition tables of banks prepared by recryptAllBanks().
+ * prepareRecryptBank() removes the update partitions from the in-memory
+ * partition table. If recryption fails, the partition tables are reloaded
+ * from the disk the next time they're needed.
+ * @param entries	[in,out] Bank entries.
+ * @param banks		[in] Bank numbers.
+ * @param count		[in] Number of banks in `banks` that were prepared.
+ */
+static void discardPreparedBanks(RvtH_BankEntry *entries,
+	const vector<unsigned int> &banks, size_t count)
+{
+	assert(count <= banks.size());
+	for (size_t i = 0; i < count; i++) {
+		RvtH_BankEntry *const entry = &entries[banks[i]];
+		free(entry->ptbl);
+		entry->ptbl = nullptr;
+		entry->pt_count = 0;
+	}
+}
+
+/**
+ * Re-encrypt all Wii banks on an RVT-H HDD image.
+ *
+ * All eligible banks are processed in a single pass:
+ * - Partition headers are read from all banks.
+ * - Tickets and TMDs are re-signed in parallel on worker threads.
+ * - Partition tables and headers are written in ascending LBA order,
+ *   followed by a single flush.
+ *
+ * Banks that can't be recrypted (empty, GCN, unencrypted, or the
+ * second bank of a dual-layer image) are skipped, as are banks that
+ * are already encrypted with the specified key and have valid
+ * signatures. As with recryptWiiPartitions(), update partitions
+ * will be removed from the recrypted banks.
+ *
+ * If an error occurs while reading or signing, nothing is written.
+ *
+ * @param cryptoType	[in] New encryption type.
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+ * @param pBankCount	[out,opt] Number of banks that were recrypted.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::recryptAllBanks(RVL_CryptoType_e cryptoType,
+	RvtH_Progress_Callback callback, void *userdata,
+	int ios_force, unsigned int *pBankCount)
+{
+	int ret = 0;	// errno or RvtH_Errors
+
+	// Callback state.
+	RvtH_Progress_State state;
+
+	if (pBankCount) {
+		*pBankCount = 0;
+	}
+
+	if (cryptoType < RVL_CryptoType_Debug ||
+	    cryptoType >= RVL_CryptoType_MAX)
+	{
+		errno = EINVAL;
+		return -EINVAL;
+	}
+
+	// Determine the key index.
+	const RVL_AES_Keys_e toKey = cryptoTypeToKeyIdx(cryptoType);
+	if (toKey >= RVL_KEY_MAX) {
+		// Invalid key index.
+		return -EINVAL;
+	}
+	const RVL_SigType_e sigType = (toKey == RVL_KEY_DEBUG)
+		? RVL_SigType_Debug : RVL_SigType_Retail;
+
+	// Find the banks that need to be recrypted.
+	vector<unsigned int> banks;
+	banks.reserve(m_bankCount);
+	for (unsigned int bank = 0; bank < m_bankCount; bank++) {
+		const RvtH_BankEntry *const entry = &m_entries[bank];
+		if (entry->is_deleted || checkRecryptBank(entry) != 0) {
+			// Bank can't be recrypted.
+			continue;
+		}
+
+		if (entry->crypto_type == cryptoType &&
+		    entry->ticket.sig_type == sigType &&
+		    entry->tmd.sig_type == sigType &&
+		    isSigStatusValid(entry->ticket.sig_status, sigType) &&
+		    isSigStatusValid(entry->tmd.sig_status, sigType))
+		{
+			// Already using the specified key with valid signatures.
+			continue;
+		}
+
+		banks.push_back(bank);
+	}
+	if (banks.empty()) {
+		// Nothing to do.
+		return 0;
+	}
+
+	// Make the RVT-H object writable.
+	ret = this->makeWritable();
+	if (ret != 0) {
+		// Could not make the RVT-H object writable.
+		int err;
+		if (ret < 0) {
+			err = -ret;
+		} else {
+			err = EROFS;
+		}
+		errno = err;
+		return ret;
+	}
+
+	if (callback) {
+		// Initialize the callback state.
+		state.rvth = this;
+		state.rvth_gcm = NULL;
+		state.bank_gcm = ~0;
+		// (0,1) for each bank, as in recryptWiiPartitions().
+		state.type = RVTH_PROGRESS_RECRYPT;
+		state.lba_total = 1;
+		state.lba_processed = 0;
+	}
+
+	// Read the disc headers and partition headers for all banks.
+	// NOTE: RecryptJob has pointers into gcn[], so it must not be resized.
+	vector<GCN_DiscHeader> gcn(banks.size());
+	vector<RecryptJob> jobs;
+	for (size_t i = 0; i < banks.size(); i++) {
+		RvtH_BankEntry *const entry = &m_entries[banks[i]];
+		if (callback) {
+			state.bank_rvth = banks[i];
+			callback(&state, userdata);
+		}
+
+		ret = prepareRecryptBank(entry, &gcn[i]);
+		if (ret != 0) {
+			// NOTE: prepareRecryptBank() may have loaded this
+			// bank's partition table, so discard it too.
+			discardPreparedBanks(m_entries, banks, i + 1);
+			return ret;
+		}
+
+		const pt_entry_t *pte = entry->ptbl;
+		for (unsigned int j = 0; j < entry->pt_count; j++, pte++) {
+			jobs.resize(jobs.size() + 1);
+			RecryptJob *const job = &jobs.back();
+			job->entry = entry;
+			job->pte = pte;
+			job->gcn = &gcn[i];
+			job->ret = 0;
+
+			// Read the partition header.
+			errno = 0;
+			const uint32_t lba_size = entry->reader->read(&job->hdr_orig,
+				pte->lba_start, BYTES_TO_LBA(sizeof(job->hdr_orig.u8)));
+			if (lba_size != BYTES_TO_LBA(sizeof(job->hdr_orig))) {
+				// Read error.
+				int err = errno;
+				if (err == 0) {
+					err = EIO;
+				}
+				discardPreparedBanks(m_entries, banks, i + 1);
+				errno = err;
+				return -err;
+			}
+		}
+	}
+
+	// Rebuild and sign the partition headers.
+	RecryptJobParams params;
+	params.jobs = jobs.data();
+	params.toKey = toKey;
+	params.ios_force = ios_force;
+	ret = threadw_parallel_for(static_cast<unsigned int>(jobs.size()), 0,
+		recryptJobWorker, &params);
+	if (ret != 0) {
+		discardPreparedBanks(m_entries, banks, banks.size());
+		errno = -ret;
+		return ret;
+	}
+	for (const RecryptJob &job : jobs) {
+		if (job.ret != 0) {
+			// Error rebuilding a partition header.
+			// Nothing has been written yet.
+			discardPreparedBanks(m_entries, banks, banks.size());
+			errno = (job.ret < 0 ? -job.ret : EIO);
+			return job.ret;
+		}
+	}
+
+	// Write the partition tables and partition headers.
+	// Banks are in ascending order, and each bank's partition table
+	// is sorted by LBA, so the writes are in ascending LBA order.
+	auto iter = jobs.cbegin();
+	for (size_t i = 0; i < banks.size(); i++) {
+		RvtH_BankEntry *const entry = &m_entries[banks[i]];
+
+		// Write the updated partition table.
+		ret = rvth_ptbl_write(entry);
+		if (ret != 0) {
+			// Unable to write the updated partition table.
+			// The partition tables will be reloaded from the disk.
+			discardPreparedBanks(m_entries, banks, banks.size());
+			errno = -ret;
+			return ret;
+		}
+
+		for (; iter != jobs.cend() && iter->entry == entry; ++iter) {
+			// Write the new partition header.
+			errno = 0;
+			const uint32_t lba_size = entry->reader->write(&iter->hdr_new,
+				iter->pte->lba_start, BYTES_TO_LBA(sizeof(iter->hdr_new.u8)));
+			if (lba_size != BYTES_TO_LBA(sizeof(iter->hdr_new))) {
+				// Write error.
+				int err = errno;
+				if (err == 0) {
+					err = EIO;
+				}
+				discardPreparedBanks(m_entries, banks, banks.size());
+				errno = err;
+				return -err;
+			}
+		}
+	}
+
+	// Flush all of the partition header writes at once.
+	m_file->flush();
+
+	// Update the bank entries.
+	// If this is an HDD, the bank table entries are written all at once.
+	const bool isHDD = this->isHDD();
+	bool inUpdate = false;
+	if (isHDD) {
+		ret = beginBankTableUpdate();
+		inUpdate = (ret == 0);
+	}
+	for (size_t i = 0; ret == 0 && i < banks.size(); i++) {
+		updateRecryptedBankEntry(&m_entries[banks[i]], toKey);
+		if (isHDD) {
+			ret = this->writeBankEntry(banks[i]);
+			if (ret != 0) {
+				// Unable to stage the bank table entry.
+				break;
+			}
+		}
+	}
+	if (inUpdate) {
+		// NOTE: The update has to be committed even if an entry
+		// couldn't be staged, since it ends the bank table update.
+		const int ret_commit = commitBankTableUpdate();
+		if (ret == 0) {
+			ret = ret_commit;
+		}
+	}
+	if (ret != 0) {
+		// The bank table wasn't updated, but the partitions have
+		// already been recrypted, so the original bank entries
+		// no longer match the disk. Reload the encryption
+		// information from the disk instead.
+		for (size_t i = 0; i < banks.size(); i++) {
+			rvth_init_BankEntry_crypto(&m_entries[banks[i]]);
+		}
+		errno = (ret < 0 ? -ret : EIO);
+		return ret;
+	}
+
+	if (callback) {
+		state.lba_processed = 1;
+		for (size_t i = 0; i < banks.size(); i++) {
+			state.bank_rvth = banks[i];
+			callback(&state, userdata);
+		}
+	}
+
+	if (pBankCount) {
+		*pBankCount = static_cast<unsigned int>(banks.size());
+	}
+	return 0;
+}
@@ -13,7 +13,10 @@
 #include "ptbl.h"
 #include "bank_init.h"
 #include "rvth_error.h"
+#include "junk.hpp"
+#include "rvth_time.h"
 #include "reader/Reader.hpp"
+#include "reader/WbfsReader.hpp"
 
 #include "libwiicrypto/byteswap.h"
 #include "libwiicrypto/cert.h"
@@ -23,9 +26,76 @@
 #include <assert.h>
 #include <ctype.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
+// C++ includes.
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+using std::wstring;
+
+/**
+ * Initialize a bank entry for a standalone disc image.
+ * NOTE: Not using rvth_init_BankEntry() here.
+ * @param entry		[out] Bank entry.
+ * @param reader	[in] Reader for the disc image. (entry takes ownership on success)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int initDiscBankEntry(RvtH_BankEntry *entry, Reader *reader)
+{
+	// Disc header.
+	union {
+		GCN_DiscHeader gcn;
+		uint8_t sbuf[LBA_SIZE];
+	} discHeader;
+
+	// Read the GCN disc header.
+	// NOTE: Since this is a standalone disc image, we'll just
+	// read the header directly.
+	errno = 0;
+	if (reader->read(discHeader.sbuf, 0, 1) != 1) {
+		// Read error.
+		return -(errno != 0 ? errno : EIO);
+	}
+
+	// Identify the disc type.
+	uint8_t type = rvth_disc_header_identify(&discHeader.gcn);
+	if (type == RVTH_BankType_Wii_SL &&
+	    reader->lba_len() > NHCD_BANK_WII_SL_SIZE_RVTR_LBA)
+	{
+		// Dual-layer image.
+		type = RVTH_BankType_Wii_DL;
+	}
+
+	// Initialize the bank entry.
+	entry->lba_start = reader->lba_start();
+	entry->lba_len = reader->lba_len();
+	entry->type = type;
+	entry->is_deleted = false;
+	entry->reader = reader;
+
+	// Timestamp.
+	// TODO: Get the timestamp from the file.
+	entry->timestamp = -1;
+
+	if (type != RVTH_BankType_Empty) {
+		// Copy the disc header.
+		memcpy(&entry->discHeader, &discHeader.gcn, sizeof(entry->discHeader));
+
+		// TODO: Error handling.
+		// Initialize the region code.
+		rvth_init_BankEntry_region(entry);
+		// Initialize the encryption status.
+		rvth_init_BankEntry_crypto(entry);
+		// Initialize the AppLoader error status.
+		rvth_init_BankEntry_AppLoader(entry);
+	}
+	return 0;
+}
+
 /**
  * Open a Wii or GameCube disc image.
  * @param f_img	[in] RefFile*
@@ -33,19 +103,11 @@
  */
 int RvtH::openGcm(RefFile *f_img)
 {
-	RvtH_BankEntry *entry;
 	int ret = 0;	// errno or RvtH_Errors
 	int err = 0;	// errno setting
 
 	Reader *reader = nullptr;
 	int64_t len;
-	uint8_t type;
-
-	// Disc header.
-	union {
-		GCN_DiscHeader gcn;
-		uint8_t sbuf[LBA_SIZE];
-	} discHeader;
 
 	// Get the file length.
 	// FIXME: This is obtained in rvth_open().
@@ -83,25 +145,6 @@ int RvtH::openGcm(RefFile *f_img)
 		goto fail;
 	}
 
-	// Read the GCN disc header.
-	// NOTE: Since this is a standalone disc image, we'll just
-	// read the header directly.
-	ret = reader->read(discHeader.sbuf, 0, 1);
-	if (ret < 0) {
-		// Error...
-		err = -ret;
-		goto fail;
-	}
-
-	// Identify the disc type.
-	type = rvth_disc_header_identify(&discHeader.gcn);
-	if (type == RVTH_BankType_Wii_SL &&
-	    reader->lba_len() > NHCD_BANK_WII_SL_SIZE_RVTR_LBA)
-	{
-		// Dual-layer image.
-		type = RVTH_BankType_Wii_DL;
-	}
-
 	// Allocate memory for a single RvtH_BankEntry object.
 	m_bankCount = 1;
 	m_imageType = reader->type();
@@ -117,32 +160,14 @@ int RvtH::openGcm(RefFile *f_img)
 	};
 
 	// Initialize the bank entry.
-	// NOTE: Not using rvth_init_BankEntry() here.
+	ret = initDiscBankEntry(m_entries, reader);
+	if (ret != 0) {
+		// Unable to read the disc header.
+		err = -ret;
+		goto fail;
+	}
 	m_file = f_img->ref();
 	m_NHCD_status = NHCD_STATUS_MISSING;
-	entry = m_entries;
-	entry->lba_start = reader->lba_start();
-	entry->lba_len = reader->lba_len();
-	entry->type = type;
-	entry->is_deleted = false;
-	entry->reader = reader;
-
-	// Timestamp.
-	// TODO: Get the timestamp from the file.
-	entry->timestamp = -1;
-
-	if (type != RVTH_BankType_Empty) {
-		// Copy the disc header.
-		memcpy(&entry->discHeader, &discHeader.gcn, sizeof(entry->discHeader));
-
-		// TODO: Error handling.
-		// Initialize the region code.
-		rvth_init_BankEntry_region(entry);
-		// Initialize the encryption status.
-		rvth_init_BankEntry_crypto(entry);
-		// Initialize the AppLoader error status.
-		rvth_init_BankEntry_AppLoader(entry);
-	}
 
 	// Disc image loaded.
 	return RVTH_ERROR_SUCCESS;
@@ -162,6 +187,83 @@ fail:
 	return ret;
 }
 
+/**
+ * Check if a file is a WBFS image.
+ * @param f_img	[in] RefFile*
+ * @return True if this is a WBFS image; false if not.
+ */
+bool RvtH::isWbfs(RefFile *f_img)
+{
+	uint8_t sbuf[LBA_SIZE];
+	if (f_img->seeko(0, SEEK_SET) != 0 ||
+	    f_img->read(sbuf, 1, sizeof(sbuf)) != sizeof(sbuf))
+	{
+		// Unable to read the first sector.
+		return false;
+	}
+	return WbfsReader::isSupported(sbuf, sizeof(sbuf));
+}
+
+/**
+ * Open a WBFS image.
+ * Each disc slot in the WBFS image is exposed as a bank.
+ * @param f_img	[in] RefFile*
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::openWbfs(RefFile *f_img)
+{
+	// Open all of the discs.
+	// The WBFS header is only parsed once.
+	vector<WbfsReader*> readers;
+	const int ret = WbfsReader::openAll(f_img, 0, 0, readers);
+	if (ret != 0) {
+		// Unable to open the WBFS image.
+		errno = -ret;
+		return ret;
+	}
+
+	// Allocate memory for the RvtH_BankEntry objects.
+	assert(!readers.empty());
+	m_entries = (RvtH_BankEntry*)calloc(readers.size(), sizeof(RvtH_BankEntry));
+	if (!m_entries) {
+		// Error allocating memory.
+		for (WbfsReader *reader : readers) {
+			delete reader;
+		}
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	m_bankCount = static_cast<unsigned int>(readers.size());
+	m_imageType = RVTH_ImageType_WBFS;
+	m_NHCD_status = NHCD_STATUS_MISSING;
+
+	for (unsigned int i = 0; i < m_bankCount; i++) {
+		RvtH_BankEntry *const entry = &m_entries[i];
+		if (!readers[i]) {
+			// Empty disc slot.
+			entry->type = RVTH_BankType_Empty;
+			entry->timestamp = -1;
+			continue;
+		}
+
+		const int ret_init = initDiscBankEntry(entry, readers[i]);
+		if (ret_init != 0) {
+			// Unable to read the disc header.
+			// Readers for the banks that were initialized
+			// are owned by their entries.
+			for (unsigned int j = i; j < m_bankCount; j++) {
+				delete readers[j];
+			}
+			errno = -ret_init;
+			return ret_init;
+		}
+	}
+
+	// WBFS image loaded.
+	m_file = f_img->ref();
+	return RVTH_ERROR_SUCCESS;
+}
+
 /**
  * Check for MBR and/or GPT.
  * @param f_img	[in] RefFile*
@@ -243,20 +345,82 @@ int RvtH::checkMBR(RefFile *f_img, bool *pMBR, bool *pGPT)
 	return 0;
 }
 
+/**
+ * Get the bank type and LBAs from an NHCD bank entry.
+ * @param nhcd_entry	[in] NHCD bank entry.
+ * @param bank		[in] Bank number.
+ * @param bankCount	[in] Number of banks.
+ * @param pLbaStart	[out] Starting LBA.
+ * @param pLbaLen	[out] Length, in LBAs. (0 if the bank size should be determined by rvth_init_BankEntry())
+ * @return Bank type. (See RvtH_BankType_e.)
+ */
+static uint8_t nhcd_entry_parse(const NHCD_BankEntry *nhcd_entry,
+	unsigned int bank, unsigned int bankCount,
+	uint32_t *pLbaStart, uint32_t *pLbaLen)
+{
+	uint32_t lba_start = 0, lba_len = 0;
+	uint8_t type;
+
+	// Check the type.
+	switch (be32_to_cpu(nhcd_entry->type)) {
+		default:
+			// Unknown bank type...
+			type = RVTH_BankType_Unknown;
+			break;
+		case NHCD_BankType_Empty:
+			// "Empty" bank. May have a deleted image.
+			type = RVTH_BankType_Empty;
+			break;
+		case NHCD_BankType_GCN:
+			// GameCube
+			type = RVTH_BankType_GCN;
+			break;
+		case NHCD_BankType_Wii_SL:
+			// Wii (single-layer)
+			type = RVTH_BankType_Wii_SL;
+			break;
+		case NHCD_BankType_Wii_DL:
+			// Wii (dual-layer)
+			// TODO: Cannot start in Bank 8.
+			type = RVTH_BankType_Wii_DL;
+			break;
+	}
+
+	// For valid types, use the listed LBAs if they're non-zero.
+	if (type >= RVTH_BankType_GCN) {
+		lba_start = be32_to_cpu(nhcd_entry->lba_start);
+		lba_len = be32_to_cpu(nhcd_entry->lba_len);
+	}
+
+	if (lba_start == 0 || lba_len == 0) {
+		// Invalid LBAs. Use the default starting offset.
+		// Bank size will be determined by rvth_init_BankEntry().
+		lba_start = NHCD_BANK_START_LBA(bank, bankCount);
+		lba_len = 0;
+	}
+
+	*pLbaStart = lba_start;
+	*pLbaLen = lba_len;
+	return type;
+}
+
 /**
  * Open an RVT-H disk image.
- * @param f_img	[in] RefFile*
+ * @param f_img		[in] RefFile*
+ * @param callback	[in,opt] Open callback.
+ * @param userdata	[in,opt] User data for the callback.
  * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
  */
-int RvtH::openHDD(RefFile *f_img)
+int RvtH::openHDD(RefFile *f_img, RvtH_Open_Callback callback, void *userdata)
 {
 	NHCD_BankTable_Header nhcd_header;
+	NHCD_BankEntry *nhcd_entries = nullptr;
 	RvtH_BankEntry *rvth_entry;
+	RvtH_Open_State state;
 	int ret = 0;	// errno or RvtH_Errors
 	int err = 0;	// errno setting
 
 	unsigned int i;
-	int64_t addr;
 	size_t size;
 
 	// Check the bank table header.
@@ -277,6 +441,12 @@ int RvtH::openHDD(RefFile *f_img)
 		? RVTH_ImageType_HDD_Reader
 		: RVTH_ImageType_HDD_Image);
 
+	// Open callback state.
+	state.rvth = this;
+	state.type = RVTH_OPEN_BANK_TABLE;
+	state.bank = UINT_MAX;
+	state.bank_count = 0;
+
 	// Check the magic number.
 	if (nhcd_header.magic == be32_to_cpu(NHCD_BANKTABLE_MAGIC)) {
 		// Magic number is correct.
@@ -317,6 +487,27 @@ int RvtH::openHDD(RefFile *f_img)
 		}
 
 		m_file = f_img->ref();
+		state.bank_count = m_bankCount;
+
+		if (callback) {
+			// Fill in the default bank table so the
+			// bank list can be shown before loading.
+			rvth_entry = m_entries;
+			lba_start = NHCD_BANK_START_LBA(0, 8);
+			for (i = 0; i < m_bankCount; i++, rvth_entry++, lba_start += NHCD_BANK_SIZE_LBA) {
+				rvth_entry->lba_start = lba_start;
+				rvth_entry->lba_len = NHCD_BANK_SIZE_LBA;
+				rvth_entry->type = RVTH_BankType_Empty;
+				rvth_entry->timestamp = -1;
+			}
+			if (!callback(&state, userdata)) {
+				err = ECANCELED;
+				ret = -ECANCELED;
+				goto fail;
+			}
+		}
+
+		state.type = RVTH_OPEN_BANK_LOADED;
 		rvth_entry = m_entries;
 		lba_start = NHCD_BANK_START_LBA(0, 8);
 		for (i = 0; i < m_bankCount; i++, rvth_entry++, lba_start += NHCD_BANK_SIZE_LBA) {
@@ -324,6 +515,15 @@ int RvtH::openHDD(RefFile *f_img)
 			rvth_init_BankEntry(rvth_entry, f_img,
 				RVTH_BankType_Empty,
 				lba_start, NHCD_BANK_SIZE_LBA, 0);
+
+			if (callback) {
+				state.bank = i;
+				if (!callback(&state, userdata)) {
+					err = ECANCELED;
+					ret = -ECANCELED;
+					goto fail;
+				}
+			}
 		}
 
 		// RVT-H image loaded.
@@ -358,90 +558,95 @@ int RvtH::openHDD(RefFile *f_img)
 		goto fail;
 	};
 
+	// Read all of the NHCD bank entries at once.
+	// This is much faster than reading them one at a time
+	// on slow devices, e.g. USB bridges.
+	nhcd_entries = (NHCD_BankEntry*)malloc(m_bankCount * sizeof(NHCD_BankEntry));
+	if (!nhcd_entries) {
+		// Error allocating memory.
+		err = errno;
+		if (err == 0) {
+			err = ENOMEM;
+		}
+		ret = -err;
+		goto fail;
+	}
+	size = f_img->seekoAndRead(LBA_TO_BYTES(NHCD_BANKTABLE_ADDRESS_LBA) + NHCD_BLOCK_SIZE, SEEK_SET,
+		nhcd_entries, 1, m_bankCount * sizeof(NHCD_BankEntry));
+	if (size != m_bankCount * sizeof(NHCD_BankEntry)) {
+		// Short read.
+		err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		ret = -err;
+		goto fail;
+	}
+
 	m_file = f_img->ref();
-	rvth_entry = m_entries;
-	addr = (uint32_t)(LBA_TO_BYTES(NHCD_BANKTABLE_ADDRESS_LBA) + NHCD_BLOCK_SIZE);
-	for (i = 0; i < m_bankCount; i++, rvth_entry++, addr += 512) {
-		NHCD_BankEntry nhcd_entry;
-		uint32_t lba_start = 0, lba_len = 0;
-		uint8_t type = RVTH_BankType_Unknown;
+	state.bank_count = m_bankCount;
+
+	if (callback) {
+		// Fill in the basic bank information from the bank table
+		// so the bank list can be shown before loading the banks.
+		rvth_entry = m_entries;
+		for (i = 0; i < m_bankCount; i++, rvth_entry++) {
+			if (i > 0 && (rvth_entry-1)->type == RVTH_BankType_Wii_DL) {
+				// Second bank for a dual-layer Wii image.
+				rvth_entry->type = RVTH_BankType_Wii_DL_Bank2;
+				rvth_entry->timestamp = -1;
+				continue;
+			}
+
+			rvth_entry->type = nhcd_entry_parse(&nhcd_entries[i], i, m_bankCount,
+				&rvth_entry->lba_start, &rvth_entry->lba_len);
+			rvth_entry->timestamp = (rvth_entry->type >= RVTH_BankType_GCN)
+				? rvth_timestamp_parse(nhcd_entries[i].timestamp)
+				: -1;
+		}
+
+		if (!callback(&state, userdata)) {
+			err = ECANCELED;
+			ret = -ECANCELED;
+			goto fail;
+		}
+	}
 
+	state.type = RVTH_OPEN_BANK_LOADED;
+	rvth_entry = m_entries;
+	for (i = 0; i < m_bankCount; i++, rvth_entry++) {
 		if (i > 0 && (rvth_entry-1)->type == RVTH_BankType_Wii_DL) {
 			// Second bank for a dual-layer Wii image.
+			memset(rvth_entry, 0, sizeof(*rvth_entry));
 			rvth_entry->type = RVTH_BankType_Wii_DL_Bank2;
 			rvth_entry->timestamp = -1;
-			continue;
-		}
+		} else {
+			uint32_t lba_start, lba_len;
+			const uint8_t type = nhcd_entry_parse(&nhcd_entries[i], i, m_bankCount,
+				&lba_start, &lba_len);
 
-		ret = f_img->seeko(addr, SEEK_SET);
-		if (ret != 0) {
-			// Seek error.
-			err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			ret = -err;
-			goto fail;
+			// Initialize the bank entry.
+			rvth_init_BankEntry(rvth_entry, f_img, type,
+				lba_start, lba_len, nhcd_entries[i].timestamp);
 		}
-		size = f_img->read(&nhcd_entry, 1, sizeof(nhcd_entry));
-		if (size != sizeof(nhcd_entry)) {
-			// Short read.
-			err = errno;
-			if (err == 0) {
-				err = EIO;
+
+		if (callback) {
+			state.bank = i;
+			if (!callback(&state, userdata)) {
+				err = ECANCELED;
+				ret = -ECANCELED;
+				goto fail;
 			}
-			ret = -err;
-			goto fail;
 		}
-
-		// Check the type.
-		switch (be32_to_cpu(nhcd_entry.type)) {
-			default:
-				// Unknown bank type...
-				type = RVTH_BankType_Unknown;
-				break;
-			case NHCD_BankType_Empty:
-				// "Empty" bank. May have a deleted image.
-				type = RVTH_BankType_Empty;
-				break;
-			case NHCD_BankType_GCN:
-				// GameCube
-				type = RVTH_BankType_GCN;
-				break;
-			case NHCD_BankType_Wii_SL:
-				// Wii (single-layer)
-				type = RVTH_BankType_Wii_SL;
-				break;
-			case NHCD_BankType_Wii_DL:
-				// Wii (dual-layer)
-				// TODO: Cannot start in Bank 8.
-				type = RVTH_BankType_Wii_DL;
-				break;
-		}
-
-		// For valid types, use the listed LBAs if they're non-zero.
-		if (type >= RVTH_BankType_GCN) {
-			lba_start = be32_to_cpu(nhcd_entry.lba_start);
-			lba_len = be32_to_cpu(nhcd_entry.lba_len);
-		}
-
-		if (lba_start == 0 || lba_len == 0) {
-			// Invalid LBAs. Use the default starting offset.
-			// Bank size will be determined by rvth_init_BankEntry().
-			lba_start = NHCD_BANK_START_LBA(i, m_bankCount);
-			lba_len = 0;
-		}
-
-		// Initialize the bank entry.
-		rvth_init_BankEntry(rvth_entry, f_img, type,
-			lba_start, lba_len, nhcd_entry.timestamp);
 	}
 
 	// RVT-H image loaded.
+	free(nhcd_entries);
 	return RVTH_ERROR_SUCCESS;
 
 fail:
 	// Failed to open the HDD image.
+	free(nhcd_entries);
 	if (m_file) {
 		m_file->unref();
 		m_file = nullptr;
@@ -456,13 +661,20 @@ fail:
  * Open an RVT-H disk image, GameCube disc image, or Wii disc image.
  * @param filename	[in] Filename.
  * @param pErr		[out,opt] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ * @param callback	[in,opt] Open callback.
+ * @param userdata	[in,opt] User data for the callback.
  */
-RvtH::RvtH(const TCHAR *filename, int *pErr)
+RvtH::RvtH(const TCHAR *filename, int *pErr, RvtH_Open_Callback callback, void *userdata)
 	: m_file(nullptr)
 	, m_bankCount(0)
 	, m_imageType(RVTH_ImageType_Unknown)
 	, m_NHCD_status(NHCD_STATUS_UNKNOWN)
 	, m_entries(nullptr)
+	, m_bankTable(nullptr)
+	, m_bankTableDirty(0)
+	, m_bankTableUpdateDepth(0)
+	, m_bankTableSnapshot(nullptr)
+	, m_progress(nullptr)
 {
 	// Open the disk image.
 	RefFile *const f_img = new RefFile(filename);
@@ -486,6 +698,21 @@ RvtH::RvtH(const TCHAR *filename, int *pErr)
 		if (pErr) {
 			*pErr = -errno;
 		}
+	} else if (isWbfs(f_img)) {
+		// WBFS image.
+		// This is checked first, since WBFS images with
+		// multiple discs may be larger than two banks.
+		errno = 0;
+		int err = openWbfs(f_img);
+		if (pErr) {
+			*pErr = err;
+		}
+		if (err == 0 && m_bankCount == 1) {
+			// Single-disc WBFS image.
+			// Load the junk run list, if present.
+			const tstring junk_filename = tstring(filename) + RVTH_JUNK_FILE_EXT;
+			loadJunkRuns(junk_filename.c_str());
+		}
 	} else if (len <= 2*LBA_TO_BYTES(NHCD_BANK_SIZE_LBA)) {
 		// Two banks or less.
 		// This is most likely a standalone disc image.
@@ -494,11 +721,18 @@ RvtH::RvtH(const TCHAR *filename, int *pErr)
 		if (pErr) {
 			*pErr = err;
 		}
+		if (err == 0) {
+			// Load the junk run list, if present.
+			// Errors are ignored; the image is still usable,
+			// but junk data will be read as zeroes.
+			const tstring junk_filename = tstring(filename) + RVTH_JUNK_FILE_EXT;
+			loadJunkRuns(junk_filename.c_str());
+		}
 	} else {
 		// More than two banks.
 		// This is most likely an RVT-H HDD image.
 		errno = 0;
-		int err = openHDD(f_img);
+		int err = openHDD(f_img, callback, userdata);
 		if (pErr) {
 			*pErr = err;
 		}
@@ -511,6 +745,13 @@ RvtH::RvtH(const TCHAR *filename, int *pErr)
 
 RvtH::~RvtH()
 {
+	// Commit any pending bank table updates.
+	assert(m_bankTableUpdateDepth == 0);
+	if (m_bankTableUpdateDepth > 0) {
+		m_bankTableUpdateDepth = 1;
+		commitBankTableUpdate();
+	}
+
 	// Close all bank entry files.
 	// RefFile has a reference count, so we have to clear the count.
 	for (unsigned int i = 0; i < m_bankCount; i++) {
@@ -40,6 +40,26 @@ struct Reader;
 typedef struct Reader Reader;
 #endif
 
+// Writer class
+#ifdef __cplusplus
+class Writer;
+#endif
+
+// Journal class
+#ifdef __cplusplus
+class Journal;
+#endif
+
+// ImportVerifier class
+#ifdef __cplusplus
+class ImportVerifier;
+#endif
+
+// ProgressSink class
+#ifdef __cplusplus
+class ProgressSink;
+#endif
+
 // RvtH forward declarations
 #ifdef __cplusplus
 class RvtH;
@@ -95,6 +115,8 @@ typedef enum {
 	RVTH_PROGRESS_EXTRACT,		// Extract image
 	RVTH_PROGRESS_IMPORT,		// Import image
 	RVTH_PROGRESS_RECRYPT,		// Recrypt image
+	RVTH_PROGRESS_SCAN,		// Scan for deleted images
+	RVTH_PROGRESS_USAGE,		// Scan bank usage
 } RvtH_Progress_Type;
 
 // Progress callback status.
@@ -119,6 +141,36 @@ typedef struct _RvtH_Progress_State {
 	uint32_t lba_total;
 } RvtH_Progress_State;
 
+/** Deleted image scanner **/
+
+// Scan result flags.
+typedef enum {
+	// Image is listed in the bank table and is not deleted.
+	RVTH_SCAN_FLAG_IN_BANK_TABLE	= (1U << 0),
+	// Disc header was wiped and was recovered from the game partition.
+	RVTH_SCAN_FLAG_HEADER_WIPED	= (1U << 1),
+	// Image does not start at a bank boundary.
+	RVTH_SCAN_FLAG_UNALIGNED	= (1U << 2),
+} RvtH_Scan_Flags;
+
+// Disc image found by RvtH::scanDeleted().
+typedef struct _RvtH_ScanResult {
+	uint32_t lba_start;		// Starting LBA.
+	uint8_t type;			// Bank type. (See RvtH_BankType_e.)
+	uint8_t flags;			// Flags. (See RvtH_Scan_Flags.)
+	int8_t bank;			// Bank slot at this address. (-1 if unaligned)
+	GCN_DiscHeader discHeader;	// Disc header.
+} RvtH_ScanResult;
+
+/** Import verification **/
+
+// Range of LBAs that didn't match the source image
+// when read back after importing.
+typedef struct _RvtH_VerifyError {
+	uint32_t lba_start;	// Starting LBA, relative to the start of the bank.
+	uint32_t lba_len;	// Length, in LBAs.
+} RvtH_VerifyError;
+
 /**
  * RVT-H progress callback.
  * @param state		[in] Current progress.
@@ -127,12 +179,90 @@ typedef struct _RvtH_Progress_State {
  */
 typedef bool (*RvtH_Progress_Callback)(const RvtH_Progress_State *state, void *userdata);
 
+/** Open callback **/
+
+// Open callback type.
+typedef enum {
+	RVTH_OPEN_BANK_TABLE	= 0,	// Bank table was read.
+	RVTH_OPEN_BANK_LOADED,		// A bank entry was fully initialized.
+} RvtH_Open_Type;
+
+// Open callback status.
+typedef struct _RvtH_Open_State {
+	const RvtH *rvth;	// RvtH being opened.
+	RvtH_Open_Type type;	// Open callback type.
+
+	// Bank that was initialized. (RVTH_OPEN_BANK_LOADED only)
+	// For RVTH_OPEN_BANK_TABLE, this is UINT_MAX.
+	unsigned int bank;
+	unsigned int bank_count;	// Number of banks.
+} RvtH_Open_State;
+
+/**
+ * RVT-H open callback.
+ *
+ * This is called from the RvtH constructor when opening an RVT-H
+ * HDD image or device. It isn't called for standalone disc images.
+ *
+ * - RVTH_OPEN_BANK_TABLE: The bank table was read. Each bank entry
+ *   only has its type, LBAs, and timestamp set; the disc header,
+ *   region, encryption, and signature fields are not set yet.
+ * - RVTH_OPEN_BANK_LOADED: The specified bank entry has been fully
+ *   initialized. The bank type may have changed, e.g. for deleted
+ *   banks or the second bank of a dual-layer image.
+ *
+ * Bank entries can be read using state->rvth->bankEntry() while
+ * the callback is running. The callback is called on the thread
+ * that is constructing the RvtH object.
+ *
+ * @param state		[in] Current state.
+ * @param userdata	[in] User data specified when calling the RvtH constructor.
+ * @return True to continue; false to abort.
+ */
+typedef bool (*RvtH_Open_Callback)(const RvtH_Open_State *state, void *userdata);
+
 #ifdef __cplusplus
 }
 #endif
 
 #ifdef __cplusplus
 
+// C++ includes.
+#include <vector>
+
+// Bank usage map resolution. (1 MiB)
+#define RVTH_USAGE_MAP_BLOCK_SIZE	(1024U*1024U)
+// Sparse block size used for usage calculations. (4 KB)
+#define RVTH_USAGE_SPARSE_BLOCK_SIZE	4096U
+
+// Bank usage information from RvtH::getBankUsage().
+struct RvtH_BankUsage {
+	uint32_t lba_len;	// Scanned length, in LBAs. (0 if the bank wasn't scanned)
+	uint64_t nonzero_bytes;	// Number of non-zero bytes.
+	uint64_t sparse_size;	// Size of a sparse extract: non-empty 4 KB blocks, in bytes.
+	uint64_t trimmed_size;	// Size with trailing empty 4 KB blocks removed, in bytes.
+
+	// Occupancy map: Number of non-empty 4 KB blocks in each 1 MiB. (0-256)
+	std::vector<uint16_t> map;
+};
+
+// Scrub map resolution. (32 KB; one Wii sector)
+#define RVTH_SCRUB_BLOCK_SIZE		(32U*1024U)
+
+// Number of 32-bit words in a junk data seed.
+#define RVTH_JUNK_SEED_SIZE		17
+
+// Junk data run.
+// Junk data is regenerated from the seed when reading holes
+// in a standalone disc image that was extracted with
+// RVTH_EXTRACT_STRIP_JUNK.
+struct RvtH_JunkRun {
+	uint32_t lba_start;	// Starting LBA.
+	uint32_t lba_len;	// Length, in LBAs.
+	uint32_t seed_offset;	// Offset of lba_start from the start of the seeded junk data, in bytes.
+	uint32_t seed[RVTH_JUNK_SEED_SIZE];	// Seed. (host-endian in memory)
+};
+
 /** Main class **/
 
 class RvtH {
@@ -144,10 +274,18 @@ class RvtH {
 		 * Check isOpen() after constructing the object to determine
 		 * if the file was opened successfully.
 		 *
+		 * If a callback is specified, it will be called after the bank
+		 * table is read and after each bank is initialized, so the bank
+		 * list can be shown before all banks are loaded. If the callback
+		 * returns false, opening is aborted with -ECANCELED.
+		 *
 		 * @param filename	[in] Filename.
 		 * @param pErr		[out,opt] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 * @param callback	[in,opt] Open callback.
+		 * @param userdata	[in,opt] User data for the callback.
 		 */
-		RvtH(const TCHAR *filename, int *pErr = nullptr);
+		RvtH(const TCHAR *filename, int *pErr = nullptr,
+			RvtH_Open_Callback callback = nullptr, void *userdata = nullptr);
 
 		/**
 		 * Create a writable RVT-H disc image object.
@@ -158,8 +296,9 @@ class RvtH {
 		 * @param filename	[in] Filename.
 		 * @param lba_len	[in] LBA length. (Will NOT be allocated initially.)
 		 * @param pErr		[out,opt] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 * @param reopen	[in,opt] If true, an existing file is reopened without truncating it.
 		 */
-		RvtH(const TCHAR *filename, uint32_t lba_len, int *pErr = nullptr);
+		RvtH(const TCHAR *filename, uint32_t lba_len, int *pErr = nullptr, bool reopen = false);
 
 		~RvtH();
 
@@ -173,6 +312,21 @@ class RvtH {
 		 */
 		int openGcm(RefFile *f_img);
 
+		/**
+		 * Check if a file is a WBFS image.
+		 * @param f_img	[in] RefFile*
+		 * @return True if this is a WBFS image; false if not.
+		 */
+		static bool isWbfs(RefFile *f_img);
+
+		/**
+		 * Open a WBFS image.
+		 * Each disc slot in the WBFS image is exposed as a bank.
+		 * @param f_img	[in] RefFile*
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int openWbfs(RefFile *f_img);
+
 		/**
 		 * Check for MBR and/or GPT.
 		 * @param f_img	[in] RefFile*
@@ -184,10 +338,12 @@ class RvtH {
 
 		/**
 		 * Open an RVT-H disk image.
-		 * @param f_img	[in] RefFile*
+		 * @param f_img		[in] RefFile*
+		 * @param callback	[in,opt] Open callback.
+		 * @param userdata	[in,opt] User data for the callback.
 		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
 		 */
-		int openHDD(RefFile *f_img);
+		int openHDD(RefFile *f_img, RvtH_Open_Callback callback, void *userdata);
 
 	public:
 		/** General utility functions. **/
@@ -217,6 +373,43 @@ class RvtH {
 		 */
 		int writeBankEntry(unsigned int bank, time_t *pTimestamp = nullptr);
 
+		/**
+		 * Write consecutive bank table entries to disk.
+		 * @param entries	[in] Bank table entries.
+		 * @param bank		[in] First bank number.
+		 * @param count		[in] Number of entries.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int writeBankTableEntries(const NHCD_BankEntry *entries, unsigned int bank, unsigned int count);
+
+	public:
+		/** Bank table updates (rvth_p.cpp) **/
+
+		/**
+		 * Begin a bank table update.
+		 *
+		 * Until the matching commitBankTableUpdate() call, bank table
+		 * entries are staged in memory instead of being written to the
+		 * device, and are then written as a single contiguous block.
+		 *
+		 * Updates may be nested. Staged entries are only written when
+		 * the outermost update is committed.
+		 *
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int beginBankTableUpdate(void);
+
+		/**
+		 * Commit a bank table update.
+		 *
+		 * If this is the outermost update, all staged bank table entries
+		 * are written to the device in one contiguous write, followed by
+		 * a single flush.
+		 *
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int commitBankTableUpdate(void);
+
 	private:
 		DISABLE_COPY(RvtH)
 
@@ -272,6 +465,23 @@ class RvtH {
 		 */
 		const RvtH_BankEntry *bankEntry(unsigned int bank, int *pErr = nullptr) const;
 
+		/**
+		 * Get the progress sink.
+		 * @return Progress sink, or nullptr if not set.
+		 */
+		inline ProgressSink *progressSink(void) const { return m_progress; }
+
+		/**
+		 * Set the progress sink.
+		 *
+		 * Extract and import functions update the progress sink
+		 * without blocking, and stop if it's cancelled. The progress
+		 * callback, if specified, is still called synchronously.
+		 *
+		 * @param progress	[in,opt] Progress sink. (not owned by this object; nullptr to clear)
+		 */
+		inline void setProgressSink(ProgressSink *progress) { m_progress = progress; }
+
 	public:
 		/** Write functions (write.cpp) **/
 
@@ -298,11 +508,15 @@ class RvtH {
 		 * @param bank_src	[in] Source bank number. (0-7)
 		 * @param callback	[in,opt] Progress callback.
 		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param flags		[in,opt] Flags. (See RvtH_Extract_Flags; only RVTH_EXTRACT_SCRUB and RVTH_EXTRACT_STRIP_JUNK are used here.)
+		 * @param journal	[in,opt] Resume journal. If it has completed chunks, copying resumes after them.
 		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
 		 */
 		int copyToGcm(RvtH *rvth_dest, unsigned int bank_src,
 			RvtH_Progress_Callback callback = nullptr,
-			void *userdata = nullptr);
+			void *userdata = nullptr,
+			unsigned int flags = 0,
+			Journal *journal = nullptr);
 
 		/**
 		 * Copy a bank from this RVT-H HDD or standalone disc image to a writable standalone disc image.
@@ -321,10 +535,73 @@ class RvtH {
 			RvtH_Progress_Callback callback = nullptr,
 			void *userdata = nullptr);
 
+		/**
+		 * Copy a bank from this RVT-H HDD or standalone disc image to a disc image writer.
+		 * This is used for compressed and compacted disc image formats.
+		 * @param writer	[in] Disc image writer. (Must be the same size as the bank.)
+		 * @param bank_src	[in] Source bank number. (0-7)
+		 * @param junkRuns	[out] Junk runs that were stripped. (only if RVTH_EXTRACT_STRIP_JUNK is set)
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param flags		[in,opt] Flags. (See RvtH_Extract_Flags; only RVTH_EXTRACT_SCRUB and RVTH_EXTRACT_STRIP_JUNK are used here.)
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int copyToWriter(Writer *writer, unsigned int bank_src,
+			std::vector<RvtH_JunkRun> &junkRuns,
+			RvtH_Progress_Callback callback = nullptr,
+			void *userdata = nullptr,
+			unsigned int flags = 0);
+
+	private:
+		/**
+		 * Copy a bank from this RVT-H HDD or standalone disc image to a plain disc image
+		 * by cloning its data blocks (reflink). Holes in the source image are preserved,
+		 * and zero blocks aren't allocated separately.
+		 *
+		 * This is only supported if both the source and destination are
+		 * plain disc images on regular files on the same copy-on-write
+		 * file system, the bank is aligned to the file system's block size,
+		 * and the data doesn't need to be modified while copying.
+		 *
+		 * @param reader_dest	[in] Destination disc image reader.
+		 * @param bank_src	[in] Source bank number. (0-7)
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param state		[in,out,opt] Progress callback state. (required if callback is set)
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 *         -ENOTSUP if reflinks aren't supported.
+		 */
+		int copyToGcm_reflink(Reader *reader_dest, unsigned int bank_src,
+			RvtH_Progress_Callback callback,
+			void *userdata,
+			RvtH_Progress_State *state);
+
+		/**
+		 * Extract a disc image from this RVT-H disk image using a disc image writer.
+		 * @param bank		[in] Bank number. (0-7)
+		 * @param filename	[in] Destination filename.
+		 * @param flags		[in] Flags. (See RvtH_Extract_Flags.)
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int extractToWriter(unsigned int bank, const TCHAR *filename,
+			unsigned int flags,
+			RvtH_Progress_Callback callback,
+			void *userdata);
+
+	public:
+
 		/**
 		 * Extract a disc image from this RVT-H disk image.
 		 * Compatibility wrapper; this function creates a new RvtH
 		 * using the GCM constructor and then copyToGcm().
+		 * If filename is "-", the disc image is written to stdout.
+		 *
+		 * When extracting to a plain disc image, a resume journal is kept
+		 * next to the disc image while copying. If RVTH_EXTRACT_RESUME is
+		 * set, an interrupted extraction of the same bank is resumed.
+		 *
 		 * @param bank		[in] Bank number. (0-7)
 		 * @param filename	[in] Destination filename.
 		 * @param recrypt_key	[in] Key for recryption. (-1 for default; otherwise, see RVL_CryptoType_e)
@@ -345,28 +622,193 @@ class RvtH {
 		 * @param bank_src	[in] Source bank number. (0-7)
 		 * @param callback	[in,opt] Progress callback.
 		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param journal	[in,opt] Resume journal. If it has completed chunks, copying resumes after them.
+		 * @param verifier	[in,opt] Read-back verifier. Written data is verified while copying.
 		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
 		 */
 		int copyToHDD(RvtH *rvth_dest, unsigned int bank_dest,
 			unsigned int bank_src,
 			RvtH_Progress_Callback callback = nullptr,
-			void *userdata = nullptr);
+			void *userdata = nullptr,
+			Journal *journal = nullptr,
+			ImportVerifier *verifier = nullptr);
+
+	private:
+		/**
+		 * Import a disc image from stdin into a bank on this RVT-H disk image.
+		 *
+		 * The disc image is copied sequentially until the end of the stream.
+		 * If stdin is a pipe, splice() is used to move the data directly
+		 * into the HDD without copying it through userspace.
+		 *
+		 * NOTE: Dual-layer Wii images can't be imported from a stream,
+		 * since the image size isn't known until the stream ends.
+		 *
+		 * @param bank		[in] Bank number. (0-7)
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int importFromStream(unsigned int bank,
+			RvtH_Progress_Callback callback,
+			void *userdata);
+
+		/**
+		 * Finish importing a disc image into a bank on this RVT-H disk image.
+		 * Retail, fakesigned, and invalid Wii images are converted to debug.
+		 * @param bank		[in] Bank number. (0-7)
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int importFinish(unsigned int bank,
+			RvtH_Progress_Callback callback,
+			void *userdata,
+			int ios_force);
+
+	public:
 
 		/**
 		 * Import a disc image into this RVT-H disk image.
 		 * Compatibility wrapper; this function creates an RvtH object for the
 		 * RVT-H disk image and then copyToHDD().
+		 * If filename is "-", the disc image is read from stdin.
+		 *
+		 * A resume journal is kept next to the source disc image while
+		 * copying. If RVTH_IMPORT_RESUME is set, an interrupted import
+		 * of the same disc image into the same bank is resumed.
+		 *
+		 * If RVTH_IMPORT_VERIFY is set, the imported data is read back
+		 * from the RVT-H while copying and compared against the data
+		 * that was written. If anything doesn't match, the mismatched
+		 * LBAs are stored in verify_errors, and
+		 * RVTH_ERROR_IMPORT_VERIFY_FAILED is returned.
+		 *
 		 * @param bank		[in] Bank number. (0-7)
 		 * @param filename	[in] Source GCM filename.
 		 * @param callback	[in,opt] Progress callback.
 		 * @param userdata	[in,opt] User data for progress callback.
 		 * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+		 * @param bank_src	[in,opt] Source bank number, for WBFS images with multiple discs.
+		 * @param flags		[in,opt] Flags. (See RvtH_Import_Flags.)
+		 * @param verify_errors	[out,opt] Mismatched LBA ranges, if RVTH_IMPORT_VERIFY is set.
 		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
 		 */
 		int import(unsigned int bank, const TCHAR *filename,
 			RvtH_Progress_Callback callback = nullptr,
 			void *userdata = nullptr,
-			int ios_force = -1);
+			int ios_force = -1,
+			unsigned int bank_src = 0,
+			unsigned int flags = 0,
+			std::vector<RvtH_VerifyError> *verify_errors = nullptr);
+
+	public:
+		/** Scanning functions (scan.cpp) **/
+
+		/**
+		 * Scan the entire HDD for GameCube and Wii disc images,
+		 * including images that are no longer in the bank table.
+		 *
+		 * The HDD is read sequentially in large chunks. Every LBA is
+		 * checked for GCN/Wii disc magic on a worker thread while the
+		 * next chunk is being read. Bank boundaries for all supported
+		 * bank table layouts are also checked for Wii images whose
+		 * disc header was wiped.
+		 *
+		 * @param results	[out] Disc images found, sorted by LBA.
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int scanDeleted(std::vector<RvtH_ScanResult> &results,
+			RvtH_Progress_Callback callback = nullptr,
+			void *userdata = nullptr);
+
+	public:
+		/** Usage functions (usage.cpp) **/
+
+		/**
+		 * Scan all banks to determine how much of each bank is in use.
+		 *
+		 * Banks are scanned in parallel using separate file handles.
+		 * Empty banks and the second bank of dual-layer Wii images
+		 * aren't scanned; their usage entries will have lba_len == 0.
+		 *
+		 * @param usage		[out] Usage information, indexed by bank number.
+		 * @param callback	[in,opt] Progress callback. (May be called from worker threads, but never concurrently.)
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int getBankUsage(std::vector<RvtH_BankUsage> &usage,
+			RvtH_Progress_Callback callback = nullptr,
+			void *userdata = nullptr);
+
+	public:
+		/** Junk data functions (junk.cpp) **/
+
+		/**
+		 * Load a junk run list for this standalone disc image.
+		 * Holes in the junk runs will be filled with regenerated
+		 * junk data when copying the disc image.
+		 * The runs must be sorted, must not overlap, and must be
+		 * within the disc image; otherwise, -EINVAL is returned.
+		 * @param filename	[in] Junk run list filename.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int loadJunkRuns(const TCHAR *filename);
+
+		/**
+		 * Save the junk run list for this standalone disc image.
+		 * If there are no junk runs, the file will be deleted.
+		 * @param filename	[in] Junk run list filename.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int saveJunkRuns(const TCHAR *filename) const;
+
+		/**
+		 * Save a junk run list.
+		 * If there are no junk runs, the file will be deleted.
+		 * @param filename	[in] Junk run list filename.
+		 * @param runs		[in] Junk run list.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		static int saveJunkRuns(const TCHAR *filename, const std::vector<RvtH_JunkRun> &runs);
+
+		/**
+		 * Get the junk run list.
+		 * @return Junk run list.
+		 */
+		inline const std::vector<RvtH_JunkRun> &junkRuns(void) const
+		{
+			return m_junkRuns;
+		}
+
+	private:
+		/**
+		 * Regenerate junk data in a buffer.
+		 * @param buf		[in/out] Buffer.
+		 * @param lba_start	[in] Starting LBA of the buffer.
+		 * @param lba_len	[in] Length of the buffer, in LBAs.
+		 */
+		void fillJunk(uint8_t *buf, uint32_t lba_start, uint32_t lba_len) const;
+
+	public:
+		/** Scrubbing functions (scrub.cpp) **/
+
+		/**
+		 * Determine which parts of a bank are actually used by the disc image.
+		 *
+		 * The FST is parsed to find all referenced files, along with the
+		 * boot block, apploader, and main DOL. Wii partitions are decrypted
+		 * as needed. If a partition can't be parsed, the entire partition
+		 * is marked as used.
+		 *
+		 * @param bank		[in] Bank number. (0-7)
+		 * @param usedMap	[out] Scrub map, with one entry per RVTH_SCRUB_BLOCK_SIZE bytes.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int getScrubMap(unsigned int bank, std::vector<bool> &usedMap);
 
 	public:
 		/** Recryption functions (recrypt.cpp) **/
@@ -398,6 +840,30 @@ class RvtH {
 			RvtH_Progress_Callback callback = nullptr,
 			void *userdata = nullptr,
 			int ios_force = -1);
+
+		/**
+		 * Re-encrypt all Wii banks on an RVT-H HDD image.
+		 *
+		 * All eligible banks are processed in a single pass. Tickets and
+		 * TMDs are signed in parallel, and the new partition headers are
+		 * written in ascending LBA order with a single flush.
+		 *
+		 * Banks that can't be recrypted, or that are already encrypted
+		 * with the specified key and have valid signatures, are skipped.
+		 * As with recryptWiiPartitions(), update partitions are removed.
+		 *
+		 * @param cryptoType	[in] New encryption type.
+		 * @param callback	[in,opt] Progress callback.
+		 * @param userdata	[in,opt] User data for progress callback.
+		 * @param ios_force	[in,opt] IOS version to force. (-1 to use the existing IOS)
+		 * @param pBankCount	[out,opt] Number of banks that were recrypted.
+		 * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		int recryptAllBanks(RVL_CryptoType_e cryptoType,
+			RvtH_Progress_Callback callback = nullptr,
+			void *userdata = nullptr,
+			int ios_force = -1,
+			unsigned int *pBankCount = nullptr);
 		
 	private:
 		// Reference-counted FILE*.
@@ -406,6 +872,7 @@ class RvtH {
 		// Number of banks.
 		// - RVT-H system or disk image: 8
 		// - Standalone disc image: 1
+		// - WBFS image: 1 per disc slot
 		unsigned int m_bankCount;
 
 		// Image type.
@@ -416,6 +883,26 @@ class RvtH {
 
 		// BankEntry objects.
 		RvtH_BankEntry *m_entries;
+
+		// Staged bank table for beginBankTableUpdate().
+		NHCD_BankEntry *m_bankTable;
+		uint32_t m_bankTableDirty;		// Bitfield of modified entries
+		unsigned int m_bankTableUpdateDepth;	// Nesting depth
+
+		// Bank entry fields saved by beginBankTableUpdate().
+		// If the update can't be committed, these are restored
+		// for the modified entries so they match the device.
+		struct BankEntrySnapshot {
+			time_t timestamp;
+			bool is_deleted;
+		};
+		BankEntrySnapshot *m_bankTableSnapshot;
+
+		// Junk data runs. (standalone disc images and single-disc WBFS images only)
+		std::vector<RvtH_JunkRun> m_junkRuns;
+
+		// Progress sink. (not owned by this object)
+		ProgressSink *m_progress;
 };
 
 #endif /* __cplusplus */
@@ -50,7 +50,10 @@ typedef enum {
 	// GCMs (single banks)
 	RVTH_ImageType_GCM,		// Standalone disc image
 	RVTH_ImageType_GCM_SDK,		// Standalone disc image with SDK header
-	// TODO: CISO/WBFS? (Handling as GCM for now.)
+	// TODO: CISO? (Handling as GCM for now.)
+
+	// WBFS (one bank per disc slot)
+	RVTH_ImageType_WBFS,		// WBFS image
 
 	RVTH_ImageType_MAX
 } RvtH_ImageType_e;
@@ -60,8 +63,54 @@ typedef enum {
 	// Prepend a 32 KB SDK header.
 	// Required for rvtwriter, NDEV ODEM, etc.
 	RVTH_EXTRACT_PREPEND_SDK_HEADER		= (1 << 0),
+
+	// Scrub unused data.
+	// Blocks that aren't referenced by the disc's FST
+	// (or boot files) are written as holes.
+	RVTH_EXTRACT_SCRUB			= (1 << 1),
+
+	// Strip junk data. (GameCube only)
+	// Blocks that contain the disc's padding junk are written
+	// as holes, and a run list is saved so the junk can be
+	// regenerated when the disc image is imported.
+	RVTH_EXTRACT_STRIP_JUNK			= (1 << 2),
+
+	// Resume an interrupted extraction.
+	// Plain disc images only. The resume journal is verified,
+	// and copying continues from the last good chunk.
+	RVTH_EXTRACT_RESUME			= (1 << 3),
 } RvtH_Extract_Flags;
 
+// RVT-H import flags.
+typedef enum {
+	// Resume an interrupted import.
+	// The resume journal is verified, and copying
+	// continues from the last good chunk.
+	RVTH_IMPORT_RESUME			= (1 << 0),
+
+	// Read back the imported data while copying
+	// and compare it against the data that was written.
+	// Not supported when importing from stdin.
+	RVTH_IMPORT_VERIFY			= (1 << 1),
+} RvtH_Import_Flags;
+
+// Disc image formats for extraction.
+typedef enum {
+	RVTH_ExtractFormat_GCM	= 0,	// Plain disc image
+	RVTH_ExtractFormat_GCZ	= 1,	// GCZ (zlib block-compressed)
+	RVTH_ExtractFormat_CISO	= 2,	// CISO (empty blocks omitted)
+	RVTH_ExtractFormat_WBFS	= 3,	// WBFS (single disc)
+
+	RVTH_ExtractFormat_MAX
+} RvtH_ExtractFormat_e;
+
+// The extraction format is stored in bits 8-15 of the extraction flags.
+#define RVTH_EXTRACT_FORMAT_SHIFT	8
+#define RVTH_EXTRACT_FORMAT_MASK	(0xFFU << RVTH_EXTRACT_FORMAT_SHIFT)
+#define RVTH_EXTRACT_FORMAT(format)	((unsigned int)(format) << RVTH_EXTRACT_FORMAT_SHIFT)
+#define RVTH_EXTRACT_GET_FORMAT(flags)	\
+	((RvtH_ExtractFormat_e)(((flags) & RVTH_EXTRACT_FORMAT_MASK) >> RVTH_EXTRACT_FORMAT_SHIFT))
+
 #ifdef __cplusplus
 }
 #endif
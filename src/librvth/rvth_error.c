@@ -99,6 +99,10 @@ const char *rvth_error(int err)
 
 		// tr: RVTH_ERROR_NDEV_GCN_NOT_SUPPORTED
 		"NDEV headers for GCN are currently unsupported.",
+
+		// 'import' command: Read-back verification.
+		// tr: RVTH_ERROR_IMPORT_VERIFY_FAILED
+		"Imported data doesn't match the source image.",
 	};
 	static_assert(ARRAY_SIZE(errtbl) == RVTH_ERROR_MAX, "Missing error descriptions!");
 
@@ -58,6 +58,9 @@ typedef enum {
 	// NDEV option.
 	RVTH_ERROR_NDEV_GCN_NOT_SUPPORTED	= 26,	// NDEV headers for GCN are currently unsupported.
 
+	// 'import' command: Read-back verification.
+	RVTH_ERROR_IMPORT_VERIFY_FAILED		= 27,	// Imported data doesn't match the source image.
+
 	RVTH_ERROR_MAX
 } RvtH_Errors;
 
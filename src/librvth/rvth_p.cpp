@@ -14,10 +14,12 @@
 
 #include "byteswap.h"
 #include "nhcd_structs.h"
+#include "simd.h"
 
 // C includes. (C++ namespace)
 #include <cassert>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 
 /**
@@ -59,10 +61,25 @@ int RvtH::makeWritable(void)
  */
 bool RvtH::isBlockEmpty(const uint8_t *block, unsigned int size)
 {
-	// Process the block using 64-bit pointers.
-	const uint64_t *block64 = (const uint64_t*)block;
 	unsigned int i;
 	assert(size % 64 == 0);
+
+#ifdef RVTH_HAS_SSE2
+	// Process the block using 128-bit SSE2 registers.
+	const __m128i *block128 = reinterpret_cast<const __m128i*>(block);
+	const __m128i zero = _mm_setzero_si128();
+	for (i = size/16/4; i > 0; i--, block128 += 4) {
+		const __m128i x = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128(&block128[0]), _mm_loadu_si128(&block128[1])),
+			_mm_or_si128(_mm_loadu_si128(&block128[2]), _mm_loadu_si128(&block128[3])));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF) {
+			// Non-zero block.
+			return false;
+		}
+	}
+#else /* !RVTH_HAS_SSE2 */
+	// Process the block using 64-bit pointers.
+	const uint64_t *block64 = (const uint64_t*)block;
 	for (i = size/8/8; i > 0; i--, block64 += 8) {
 		uint64_t x = block64[0];
 		x |= block64[1];
@@ -77,6 +94,7 @@ bool RvtH::isBlockEmpty(const uint8_t *block, unsigned int size)
 			return false;
 		}
 	}
+#endif /* RVTH_HAS_SSE2 */
 
 	// Block is all zeroes.
 	return true;
@@ -164,8 +182,31 @@ int RvtH::writeBankEntry(unsigned int bank, time_t *pTimestamp)
 		}
 	}
 
+	if (m_bankTableUpdateDepth > 0) {
+		// A bank table update is in progress.
+		// Stage the entry; it will be written by commitBankTableUpdate().
+		assert(m_bankTable != nullptr);
+		memcpy(&m_bankTable[bank], &nhcd_entry, sizeof(nhcd_entry));
+		m_bankTableDirty |= (1U << bank);
+		return 0;
+	}
+
 	// Write the bank entry.
-	ret = m_file->seeko(LBA_TO_BYTES(NHCD_BANKTABLE_ADDRESS_LBA + bank+1), SEEK_SET);
+	return writeBankTableEntries(&nhcd_entry, bank, 1);
+}
+
+/**
+ * Write consecutive bank table entries to disk.
+ * @param entries	[in] Bank table entries.
+ * @param bank		[in] First bank number.
+ * @param count		[in] Number of entries.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::writeBankTableEntries(const NHCD_BankEntry *entries, unsigned int bank, unsigned int count)
+{
+	assert(bank + count <= m_bankCount);
+
+	int ret = m_file->seeko(LBA_TO_BYTES(NHCD_BANKTABLE_ADDRESS_LBA + bank+1), SEEK_SET);
 	if (ret != 0) {
 		// Seek error.
 		if (errno == 0) {
@@ -173,8 +214,8 @@ int RvtH::writeBankEntry(unsigned int bank, time_t *pTimestamp)
 		}
 		return -errno;
 	}
-	size_t size = m_file->write(&nhcd_entry, 1, sizeof(nhcd_entry));
-	if (size != sizeof(nhcd_entry)) {
+	size_t size = m_file->write(entries, sizeof(*entries), count);
+	if (size != count) {
 		// Write error.
 		if (errno == 0) {
 			errno = EIO;
@@ -182,6 +223,150 @@ int RvtH::writeBankEntry(unsigned int bank, time_t *pTimestamp)
 		return -errno;
 	}
 
-	// Bank entry written successfully.
+	// Bank entries written successfully.
+	return 0;
+}
+
+/**
+ * Begin a bank table update.
+ *
+ * Until the matching commitBankTableUpdate() call, bank table entries
+ * are staged in memory instead of being written to the device. The
+ * modified entries are then written as a single contiguous block,
+ * which is much faster on RVT-H Readers, since every write to the
+ * device is synchronous.
+ *
+ * Updates may be nested. Staged entries are only written when the
+ * outermost update is committed.
+ *
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::beginBankTableUpdate(void)
+{
+	if (m_bankTableUpdateDepth > 0) {
+		// Nested update.
+		m_bankTableUpdateDepth++;
+		return 0;
+	}
+
+	if (!isHDD()) {
+		// Standalone disc image. No bank table.
+		errno = EINVAL;
+		return RVTH_ERROR_NOT_HDD_IMAGE;
+	}
+
+	// Make the RVT-H object writable.
+	int ret = makeWritable();
+	if (ret != 0) {
+		// Could not make the RVT-H object writable.
+		return ret;
+	}
+
+	// Load the current bank table entries.
+	// Entries between modified entries will be written back as-is.
+	assert(m_bankCount <= 32);
+	NHCD_BankEntry *const bankTable =
+		static_cast<NHCD_BankEntry*>(malloc(m_bankCount * sizeof(NHCD_BankEntry)));
+	if (!bankTable) {
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	errno = 0;
+	size_t size = m_file->seekoAndRead(LBA_TO_BYTES(NHCD_BANKTABLE_ADDRESS_LBA + 1), SEEK_SET,
+		bankTable, sizeof(NHCD_BankEntry), m_bankCount);
+	if (size != m_bankCount) {
+		// Read error.
+		if (errno == 0) {
+			errno = EIO;
+		}
+		ret = -errno;
+		free(bankTable);
+		return ret;
+	}
+
+	// Save the bank entry fields that are stored in the bank table,
+	// so they can be restored if the update can't be committed.
+	BankEntrySnapshot *const snapshot =
+		static_cast<BankEntrySnapshot*>(malloc(m_bankCount * sizeof(BankEntrySnapshot)));
+	if (!snapshot) {
+		free(bankTable);
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+	for (unsigned int i = 0; i < m_bankCount; i++) {
+		snapshot[i].timestamp = m_entries[i].timestamp;
+		snapshot[i].is_deleted = m_entries[i].is_deleted;
+	}
+
+	m_bankTable = bankTable;
+	m_bankTableSnapshot = snapshot;
+	m_bankTableDirty = 0;
+	m_bankTableUpdateDepth = 1;
 	return 0;
 }
+
+/**
+ * Commit a bank table update.
+ *
+ * If this is the outermost update, all staged bank table entries
+ * are written to the device in one contiguous write, followed by
+ * a single flush.
+ *
+ * If the write fails, the timestamp and deletion status of the
+ * modified bank entries are restored to their values from when
+ * the update began, so they match the bank table on the device.
+ *
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::commitBankTableUpdate(void)
+{
+	assert(m_bankTableUpdateDepth > 0);
+	if (m_bankTableUpdateDepth == 0) {
+		// No update is in progress.
+		errno = EINVAL;
+		return -EINVAL;
+	} else if (--m_bankTableUpdateDepth > 0) {
+		// Nested update. Wait for the outermost commit.
+		return 0;
+	}
+
+	int ret = 0;
+	if (m_bankTableDirty != 0) {
+		// Find the range of modified entries.
+		unsigned int first = 0, last = m_bankCount - 1;
+		while (!(m_bankTableDirty & (1U << first))) {
+			first++;
+		}
+		while (!(m_bankTableDirty & (1U << last))) {
+			last--;
+		}
+
+		// Write the modified entries.
+		ret = writeBankTableEntries(&m_bankTable[first], first, last - first + 1);
+		if (m_file->flush() != 0 && ret == 0) {
+			// Flush error.
+			if (errno == 0) {
+				errno = EIO;
+			}
+			ret = -errno;
+		}
+
+		if (ret != 0) {
+			// The bank table wasn't updated.
+			// Restore the modified bank entries.
+			for (unsigned int i = first; i <= last; i++) {
+				if (m_bankTableDirty & (1U << i)) {
+					m_entries[i].timestamp = m_bankTableSnapshot[i].timestamp;
+					m_entries[i].is_deleted = m_bankTableSnapshot[i].is_deleted;
+				}
+			}
+		}
+	}
+
+	free(m_bankTable);
+	free(m_bankTableSnapshot);
+	m_bankTable = nullptr;
+	m_bankTableSnapshot = nullptr;
+	m_bankTableDirty = 0;
+	return ret;
+}
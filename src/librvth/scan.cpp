@@ -0,0 +1,347 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * scan.cpp: Scan an RVT-H HDD for deleted disc images.                    *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "rvth.hpp"
+#include "rvth_error.h"
+#include "disc_header.hpp"
+#include "nhcd_structs.h"
+
+#include "RefFile.hpp"
+
+// libwiicrypto
+#include "libwiicrypto/threadw.h"
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+// Read buffer size for scanning. (32 MiB)
+#define SCAN_BUF_SIZE (32U*1024U*1024U)
+#define SCAN_BUF_LBA BYTES_TO_LBA(SCAN_BUF_SIZE)
+
+// Maximum number of bank slots. (Extended bank tables support up to 32 banks.)
+#define SCAN_MAX_BANKS 32
+
+// Disc magic found in a single LBA.
+struct ScanHit {
+	uint32_t lba;			// LBA
+	uint8_t type;			// Bank type. (See RvtH_BankType_e.)
+	GCN_DiscHeader discHeader;	// Disc header
+};
+
+/**
+ * Check every LBA in a chunk for GCN/Wii disc magic.
+ * This function doesn't do any I/O, so it can run on a worker thread.
+ * @param buf		[in] Chunk data.
+ * @param lba_start	[in] Starting LBA of the chunk.
+ * @param lba_count	[in] Number of LBAs in the chunk.
+ * @param hits		[out] Disc magic hits. (New hits are appended.)
+ */
+static void scanChunk(const uint8_t *buf, uint32_t lba_start, uint32_t lba_count, vector<ScanHit> *hits)
+{
+	for (uint32_t i = 0; i < lba_count; i++, buf += LBA_SIZE) {
+		const GCN_DiscHeader *const discHeader = reinterpret_cast<const GCN_DiscHeader*>(buf);
+		const int type = rvth_disc_header_identify(discHeader);
+		if (type < RVTH_BankType_GCN)
+			continue;
+
+		ScanHit hit;
+		hit.lba = lba_start + i;
+		hit.type = static_cast<uint8_t>(type);
+		memcpy(&hit.discHeader, discHeader, sizeof(hit.discHeader));
+		hits->push_back(hit);
+	}
+}
+
+// Chunk being scanned on a worker thread.
+struct ScanJob {
+	const uint8_t *buf;	// Chunk data
+	uint32_t lba_start;	// Starting LBA of the chunk
+	uint32_t lba_count;	// Number of LBAs in the chunk
+	vector<ScanHit> *hits;	// Disc magic hits
+};
+
+/**
+ * Scan a chunk on a worker thread.
+ * Called by threadw_thread_create().
+ * @param userdata	[in] ScanJob
+ */
+static void scanChunkThread(void *userdata)
+{
+	const ScanJob *const job = static_cast<const ScanJob*>(userdata);
+	scanChunk(job->buf, job->lba_start, job->lba_count, job->hits);
+}
+
+/**
+ * Get the bank slot for an LBA.
+ * All supported bank table layouts are checked.
+ * @param lba LBA.
+ * @return Bank slot, or -1 if the LBA isn't at a bank boundary.
+ */
+static int bankSlotForLBA(uint32_t lba)
+{
+	if (lba == NHCD_BANK_START_LBA(0, SCAN_MAX_BANKS)) {
+		// Bank 1 for extended bank tables.
+		return 0;
+	}
+
+	const uint32_t lba_bank1 = NHCD_BANK_START_LBA(0, 8);
+	if (lba < lba_bank1 || (lba - lba_bank1) % NHCD_BANK_SIZE_LBA != 0) {
+		// Not at a bank boundary.
+		return -1;
+	}
+	const uint32_t bank = (lba - lba_bank1) / NHCD_BANK_SIZE_LBA;
+	return (bank < SCAN_MAX_BANKS ? static_cast<int>(bank) : -1);
+}
+
+/**
+ * Get the nominal length of a disc image.
+ * Used to skip copies of the disc header within a disc image.
+ * @param type Bank type. (See RvtH_BankType_e.)
+ * @return Nominal length, in LBAs.
+ */
+static inline uint32_t nominalLengthForType(uint8_t type)
+{
+	switch (type) {
+		case RVTH_BankType_GCN:
+			return NHCD_BANK_GCN_SIZE_RETAIL_LBA;
+		case RVTH_BankType_Wii_DL:
+			return NHCD_BANK_WII_DL_SIZE_RVTR_LBA;
+		default:
+			return NHCD_BANK_WII_SL_SIZE_RVTR_LBA;
+	}
+}
+
+/**
+ * Scan the entire HDD for GameCube and Wii disc images,
+ * including images that are no longer in the bank table.
+ *
+ * The HDD is read sequentially in large chunks. Every LBA is
+ * checked for GCN/Wii disc magic on a worker thread while the
+ * next chunk is being read. Bank boundaries for all supported
+ * bank table layouts are also checked for Wii images whose
+ * disc header was wiped.
+ *
+ * @param results	[out] Disc images found, sorted by LBA.
+ * @param callback	[in,opt] Progress callback.
+ * @param userdata	[in,opt] User data for progress callback.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::scanDeleted(vector<RvtH_ScanResult> &results,
+	RvtH_Progress_Callback callback, void *userdata)
+{
+	results.clear();
+	if (!isHDD()) {
+		// Standalone disc image. No banks to scan.
+		errno = EINVAL;
+		return RVTH_ERROR_NOT_HDD_IMAGE;
+	}
+
+	// Get the HDD size.
+	errno = 0;
+	const int64_t fileSize = m_file->size();
+	if (fileSize <= 0) {
+		if (errno == 0) {
+			errno = EIO;
+		}
+		return -errno;
+	}
+	const int64_t lba_total64 = BYTES_TO_LBA(fileSize);
+	const uint32_t lba_total = (lba_total64 > (int64_t)UINT32_MAX)
+		? UINT32_MAX : static_cast<uint32_t>(lba_total64);
+
+	// Double-buffered so the next chunk can be read
+	// while the current chunk is being scanned.
+	uint8_t *bufs[2];
+	bufs[0] = static_cast<uint8_t*>(malloc(SCAN_BUF_SIZE));
+	bufs[1] = static_cast<uint8_t*>(malloc(SCAN_BUF_SIZE));
+	if (!bufs[0] || !bufs[1]) {
+		free(bufs[0]);
+		free(bufs[1]);
+		errno = ENOMEM;
+		return -ENOMEM;
+	}
+
+	// Callback state.
+	RvtH_Progress_State state;
+	if (callback) {
+		state.rvth = this;
+		state.rvth_gcm = nullptr;
+		state.bank_rvth = ~0;
+		state.bank_gcm = ~0;
+		state.type = RVTH_PROGRESS_SCAN;
+		state.lba_processed = 0;
+		state.lba_total = lba_total;
+		callback(&state, userdata);
+	}
+
+	int ret = 0;
+	vector<ScanHit> hits;
+	ScanJob job;
+	threadw_thread_t worker;
+	bool workerRunning = false;
+	unsigned int cur = 0;
+
+	ret = m_file->seeko(0, SEEK_SET);
+	if (ret != 0) {
+		if (errno == 0) {
+			errno = EIO;
+		}
+		ret = -errno;
+	}
+
+	for (uint32_t lba = 0; ret == 0 && lba < lba_total; cur ^= 1) {
+		const uint32_t lba_count = std::min(SCAN_BUF_LBA, lba_total - lba);
+
+		// Read the next chunk.
+		errno = 0;
+		const size_t size = m_file->read(bufs[cur], LBA_SIZE, lba_count);
+		if (size != lba_count) {
+			// Read error.
+			if (errno == 0) {
+				errno = EIO;
+			}
+			ret = -errno;
+			break;
+		}
+
+		// Wait for the previous chunk to finish scanning,
+		// then start scanning this chunk.
+		if (workerRunning) {
+			threadw_thread_join(worker);
+			workerRunning = false;
+		}
+		job.buf = bufs[cur];
+		job.lba_start = lba;
+		job.lba_count = lba_count;
+		job.hits = &hits;
+		if (threadw_thread_create(&worker, scanChunkThread, &job) == 0) {
+			workerRunning = true;
+		} else {
+			// Unable to start a worker thread.
+			// Scan the chunk on this thread instead.
+			scanChunk(bufs[cur], lba, lba_count, &hits);
+		}
+		lba += lba_count;
+
+		if (callback) {
+			state.lba_processed = lba;
+			if (!callback(&state, userdata)) {
+				// Stop scanning.
+				errno = ECANCELED;
+				ret = -ECANCELED;
+				break;
+			}
+		}
+	}
+	if (workerRunning) {
+		threadw_thread_join(worker);
+	}
+	free(bufs[0]);
+	free(bufs[1]);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Check the bank boundaries for all bank table layouts.
+	// rvth_disc_header_get() can recover the disc header
+	// for Wii images that were "flushed" on the RVT-H.
+	uint32_t lba_slots[SCAN_MAX_BANKS + 1];
+	unsigned int slot_count = 0;
+	lba_slots[slot_count++] = NHCD_BANK_START_LBA(0, SCAN_MAX_BANKS);
+	for (unsigned int bank = 0; bank < SCAN_MAX_BANKS; bank++) {
+		lba_slots[slot_count++] = NHCD_BANK_START_LBA(bank, 8);
+	}
+
+	auto iter = hits.cbegin();
+	for (unsigned int i = 0; i < slot_count; i++) {
+		const uint32_t lba_slot = lba_slots[i];
+		if (lba_slot >= lba_total)
+			break;
+
+		RvtH_ScanResult result;
+		int type = rvth_disc_header_get(m_file, lba_slot, &result.discHeader, nullptr);
+		if (type < RVTH_BankType_GCN)
+			continue;
+
+		result.lba_start = lba_slot;
+		result.type = static_cast<uint8_t>(type);
+		result.bank = static_cast<int8_t>(bankSlotForLBA(lba_slot));
+		result.flags = 0;
+
+		// If the disc magic wasn't found at this LBA,
+		// the disc header was recovered from the game partition.
+		while (iter != hits.cend() && iter->lba < lba_slot) {
+			++iter;
+		}
+		if (iter == hits.cend() || iter->lba != lba_slot) {
+			result.flags |= RVTH_SCAN_FLAG_HEADER_WIPED;
+		}
+		results.push_back(result);
+	}
+
+	// Add disc magic hits that aren't at bank boundaries,
+	// skipping any that are within a disc image that was
+	// already found. (e.g. unencrypted Wii partitions have
+	// a copy of the disc header)
+	auto res_iter = results.cbegin();
+	uint32_t lba_end = 0;
+	vector<RvtH_ScanResult> unaligned;
+	for (const ScanHit &hit : hits) {
+		// Check for aligned images that start before this hit.
+		for (; res_iter != results.cend() && res_iter->lba_start <= hit.lba; ++res_iter) {
+			lba_end = std::max(lba_end, res_iter->lba_start + nominalLengthForType(res_iter->type));
+		}
+		if (bankSlotForLBA(hit.lba) >= 0 || hit.lba < lba_end) {
+			// Already handled, or within a disc image.
+			continue;
+		}
+
+		RvtH_ScanResult result;
+		result.lba_start = hit.lba;
+		result.type = hit.type;
+		result.flags = RVTH_SCAN_FLAG_UNALIGNED;
+		result.bank = -1;
+		memcpy(&result.discHeader, &hit.discHeader, sizeof(result.discHeader));
+		unaligned.push_back(result);
+		lba_end = std::max(lba_end, hit.lba + nominalLengthForType(hit.type));
+	}
+	if (!unaligned.empty()) {
+		results.insert(results.end(), unaligned.cbegin(), unaligned.cend());
+		std::sort(results.begin(), results.end(),
+			[](const RvtH_ScanResult &a, const RvtH_ScanResult &b) {
+				return (a.lba_start < b.lba_start);
+			});
+	}
+
+	// Check which images are still in the bank table.
+	for (RvtH_ScanResult &result : results) {
+		for (unsigned int bank = 0; bank < m_bankCount; bank++) {
+			const RvtH_BankEntry *const entry = &m_entries[bank];
+			if (entry->lba_start == result.lba_start &&
+			    entry->type >= RVTH_BankType_GCN &&
+			    entry->type != RVTH_BankType_Wii_DL_Bank2 &&
+			    !entry->is_deleted)
+			{
+				result.flags |= RVTH_SCAN_FLAG_IN_BANK_TABLE;
+				break;
+			}
+		}
+	}
+
+	return 0;
+}
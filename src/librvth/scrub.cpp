@@ -0,0 +1,547 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * scrub.cpp: Determine which parts of a disc image are actually used.     *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "rvth.hpp"
+#include "ptbl.h"
+#include "rvth_error.h"
+
+#include "byteswap.h"
+#include "nhcd_structs.h"
+
+// Disc image reader.
+#include "reader/Reader.hpp"
+
+// libwiicrypto
+#include "libwiicrypto/aesw.h"
+#include "libwiicrypto/cert_store.h"
+#include "libwiicrypto/gcn_structs.h"
+#include "libwiicrypto/wii_structs.h"
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+// Encrypted Wii sectors: 1 KB of hashes, followed by 31 KB of user data.
+#define SECTOR_SIZE_ENC		(32*1024)
+#define SECTOR_SIZE_DEC		(31*1024)
+#define SECTOR_HASH_SIZE	(SECTOR_SIZE_ENC - SECTOR_SIZE_DEC)
+
+// Wii disc area before the first partition.
+// (disc header, volume group table, region settings)
+#define WII_DISC_HEADER_AREA_SIZE 0x50000
+
+// Maximum FST size. Anything larger is assumed to be garbage.
+#define FST_MAX_SIZE (64U*1024U*1024U)
+
+// Apploader header.
+#define APPLOADER_ADDRESS 0x2440
+#define APPLOADER_HEADER_SIZE 0x20
+
+// FST entry.
+// All fields are big-endian.
+typedef struct _FST_Entry {
+	uint32_t type_name;	// MSB: Type (0 == file, 1 == directory); low 24 bits: name offset.
+	uint32_t offset;	// File: Offset. (rshifted by 2 on Wii) Directory: Parent index.
+	uint32_t size;		// File: Size. Directory: Index of the next entry not in this directory.
+} FST_Entry;
+ASSERT_STRUCT(FST_Entry, 12);
+
+/**
+ * Mark a region of a bank as used.
+ * @param usedMap	[in/out] Scrub map.
+ * @param offset	[in] Starting offset, in bytes.
+ * @param size		[in] Size, in bytes.
+ */
+static void markUsed(vector<bool> &usedMap, uint64_t offset, uint64_t size)
+{
+	if (size == 0)
+		return;
+
+	const uint64_t first = offset / RVTH_SCRUB_BLOCK_SIZE;
+	uint64_t last = (offset + size - 1) / RVTH_SCRUB_BLOCK_SIZE;
+	if (first >= usedMap.size())
+		return;
+	if (last >= usedMap.size()) {
+		last = usedMap.size() - 1;
+	}
+	std::fill(usedMap.begin() + first, usedMap.begin() + last + 1, true);
+}
+
+/**
+ * Read user data from a GameCube disc image or a Wii partition.
+ * Offsets are relative to the start of the user data, as seen by
+ * the game. Encrypted Wii partitions are decrypted as needed.
+ */
+class ScrubDataReader
+{
+	public:
+		/**
+		 * Create a data reader.
+		 * @param reader	[in] Disc image reader.
+		 * @param data_start	[in] Start of the user data, in bytes. (relative to the bank)
+		 * @param data_end	[in] End of the user data, in bytes. (relative to the bank)
+		 * @param aesw		[in,opt] AES context with the title key set, or nullptr if unencrypted.
+		 */
+		ScrubDataReader(Reader *reader, uint64_t data_start, uint64_t data_end, AesCtx *aesw)
+			: m_reader(reader)
+			, m_data_start(data_start)
+			, m_data_end(data_end)
+			, m_aesw(aesw)
+			, m_sector_idx(~0ULL)
+		{ }
+
+	private:
+		ScrubDataReader(const ScrubDataReader &) = delete;
+		ScrubDataReader &operator=(const ScrubDataReader &) = delete;
+
+	public:
+		/**
+		 * Read user data.
+		 * @param buf		[out] Output buffer.
+		 * @param offset	[in] User data offset.
+		 * @param size		[in] Size, in bytes.
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int read(void *buf, uint64_t offset, size_t size);
+
+		/**
+		 * Mark the physical location of user data as used.
+		 * @param usedMap	[in/out] Scrub map.
+		 * @param offset	[in] User data offset.
+		 * @param size		[in] Size, in bytes.
+		 */
+		void markUsed(vector<bool> &usedMap, uint64_t offset, uint64_t size) const;
+
+	private:
+		/**
+		 * Read LBAs from the bank.
+		 * @param buf		[out] Output buffer.
+		 * @param offset	[in] Bank offset, in bytes. (Must be LBA-aligned.)
+		 * @param size		[in] Size, in bytes. (Must be a multiple of LBA_SIZE.)
+		 * @return 0 on success; negative POSIX error code on error.
+		 */
+		int readBank(uint8_t *buf, uint64_t offset, size_t size);
+
+	private:
+		Reader *m_reader;
+		uint64_t m_data_start;
+		uint64_t m_data_end;
+		AesCtx *m_aesw;
+
+		// Decrypted sector cache.
+		uint64_t m_sector_idx;
+		uint8_t m_sector[SECTOR_SIZE_ENC];
+};
+
+/**
+ * Read LBAs from the bank.
+ * @param buf		[out] Output buffer.
+ * @param offset	[in] Bank offset, in bytes. (Must be LBA-aligned.)
+ * @param size		[in] Size, in bytes. (Must be a multiple of LBA_SIZE.)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ScrubDataReader::readBank(uint8_t *buf, uint64_t offset, size_t size)
+{
+	assert(offset % LBA_SIZE == 0);
+	assert(size % LBA_SIZE == 0);
+	if (offset + size > m_data_end) {
+		// Out of range.
+		return -EIO;
+	}
+
+	const uint32_t lba_start = static_cast<uint32_t>(BYTES_TO_LBA(offset));
+	const uint32_t lba_len = static_cast<uint32_t>(BYTES_TO_LBA(size));
+	errno = 0;
+	if (m_reader->read(buf, lba_start, lba_len) != lba_len) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
+
+/**
+ * Read user data.
+ * @param buf		[out] Output buffer.
+ * @param offset	[in] User data offset.
+ * @param size		[in] Size, in bytes.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int ScrubDataReader::read(void *buf, uint64_t offset, size_t size)
+{
+	uint8_t *pDest = static_cast<uint8_t*>(buf);
+	int ret;
+
+	if (!m_aesw) {
+		// Unencrypted. Read the enclosing LBAs.
+		const uint64_t phys_start = m_data_start + offset;
+		const uint64_t lba_offset = phys_start & ~(uint64_t)(LBA_SIZE-1);
+		const size_t head = static_cast<size_t>(phys_start - lba_offset);
+		const size_t lba_size = (head + size + LBA_SIZE - 1) & ~(size_t)(LBA_SIZE-1);
+
+		vector<uint8_t> tmp(lba_size);
+		ret = readBank(tmp.data(), lba_offset, lba_size);
+		if (ret == 0) {
+			memcpy(pDest, &tmp[head], size);
+		}
+		return ret;
+	}
+
+	// Encrypted. Decrypt one sector at a time.
+	while (size > 0) {
+		const uint64_t sector_idx = offset / SECTOR_SIZE_DEC;
+		const size_t sector_offset = static_cast<size_t>(offset % SECTOR_SIZE_DEC);
+		const size_t chunk = std::min(size, static_cast<size_t>(SECTOR_SIZE_DEC) - sector_offset);
+
+		if (sector_idx != m_sector_idx) {
+			ret = readBank(m_sector, m_data_start + (sector_idx * SECTOR_SIZE_ENC), SECTOR_SIZE_ENC);
+			if (ret != 0) {
+				m_sector_idx = ~0ULL;
+				return ret;
+			}
+
+			// User data IV is stored within the encrypted H2 table.
+			aesw_set_iv(m_aesw, &m_sector[0x3D0], 16);
+			aesw_decrypt(m_aesw, &m_sector[SECTOR_HASH_SIZE], SECTOR_SIZE_DEC);
+			m_sector_idx = sector_idx;
+		}
+
+		memcpy(pDest, &m_sector[SECTOR_HASH_SIZE + sector_offset], chunk);
+		pDest += chunk;
+		offset += chunk;
+		size -= chunk;
+	}
+	return 0;
+}
+
+/**
+ * Mark the physical location of user data as used.
+ * @param usedMap	[in/out] Scrub map.
+ * @param offset	[in] User data offset.
+ * @param size		[in] Size, in bytes.
+ */
+void ScrubDataReader::markUsed(vector<bool> &usedMap, uint64_t offset, uint64_t size) const
+{
+	if (size == 0)
+		return;
+
+	uint64_t phys_start, phys_end;
+	if (!m_aesw) {
+		phys_start = m_data_start + offset;
+		phys_end = phys_start + size;
+	} else {
+		// Entire sectors are needed, including the hashes.
+		const uint64_t first = offset / SECTOR_SIZE_DEC;
+		const uint64_t last = (offset + size - 1) / SECTOR_SIZE_DEC;
+		phys_start = m_data_start + (first * SECTOR_SIZE_ENC);
+		phys_end = m_data_start + ((last + 1) * SECTOR_SIZE_ENC);
+	}
+
+	if (phys_start >= m_data_end)
+		return;
+	phys_end = std::min(phys_end, m_data_end);
+	::markUsed(usedMap, phys_start, phys_end - phys_start);
+}
+
+/**
+ * Mark all used data in a GameCube disc image or Wii partition.
+ * This includes the boot block, apploader, main DOL, FST, and all files.
+ * @param dr		[in] Data reader.
+ * @param isWii		[in] If true, offsets are rshifted by 2.
+ * @param usedMap	[in/out] Scrub map.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int scrubDataArea(ScrubDataReader &dr, bool isWii, vector<bool> &usedMap)
+{
+	const unsigned int shift = (isWii ? 2 : 0);
+	int ret;
+
+	// Boot block. The disc header, boot block, and
+	// boot info are all used, and are followed by the apploader.
+	GCN_Boot_Block bb2;
+	ret = dr.read(&bb2, GCN_Boot_Block_ADDRESS, sizeof(bb2));
+	if (ret != 0)
+		return ret;
+	dr.markUsed(usedMap, 0, APPLOADER_ADDRESS);
+
+	// Apploader.
+	uint8_t apl_hdr[APPLOADER_HEADER_SIZE];
+	ret = dr.read(apl_hdr, APPLOADER_ADDRESS, sizeof(apl_hdr));
+	if (ret != 0)
+		return ret;
+	uint32_t apl_size, apl_trailer;
+	memcpy(&apl_size, &apl_hdr[0x14], sizeof(apl_size));
+	memcpy(&apl_trailer, &apl_hdr[0x18], sizeof(apl_trailer));
+	dr.markUsed(usedMap, APPLOADER_ADDRESS, (uint64_t)APPLOADER_HEADER_SIZE +
+		be32_to_cpu(apl_size) + be32_to_cpu(apl_trailer));
+
+	// Main DOL.
+	const uint64_t dol_offset = (uint64_t)be32_to_cpu(bb2.bootFilePosition) << shift;
+	DOL_Header dol;
+	ret = dr.read(&dol, dol_offset, sizeof(dol));
+	if (ret != 0)
+		return ret;
+	uint64_t dol_size = sizeof(dol);
+	for (unsigned int i = 0; i < ARRAY_SIZE(dol.textData); i++) {
+		dol_size = std::max(dol_size, (uint64_t)be32_to_cpu(dol.textData[i]) + be32_to_cpu(dol.textLen[i]));
+	}
+	for (unsigned int i = 0; i < ARRAY_SIZE(dol.dataData); i++) {
+		dol_size = std::max(dol_size, (uint64_t)be32_to_cpu(dol.dataData[i]) + be32_to_cpu(dol.dataLen[i]));
+	}
+	dr.markUsed(usedMap, dol_offset, dol_size);
+
+	// FST.
+	const uint64_t fst_offset = (uint64_t)be32_to_cpu(bb2.FSTPosition) << shift;
+	const uint64_t fst_size = (uint64_t)be32_to_cpu(bb2.FSTLength) << shift;
+	if (fst_size < sizeof(FST_Entry) || fst_size > FST_MAX_SIZE) {
+		// Invalid FST.
+		return -EIO;
+	}
+	vector<uint8_t> fst(static_cast<size_t>(fst_size));
+	ret = dr.read(fst.data(), fst_offset, fst.size());
+	if (ret != 0)
+		return ret;
+	dr.markUsed(usedMap, fst_offset, fst_size);
+
+	// The root directory's size is the total number of entries.
+	const FST_Entry *const fst_entries = reinterpret_cast<const FST_Entry*>(fst.data());
+	const uint32_t entry_count = be32_to_cpu(fst_entries[0].size);
+	if (entry_count == 0 || entry_count > fst_size / sizeof(FST_Entry)) {
+		// Invalid FST.
+		return -EIO;
+	}
+	for (uint32_t i = 1; i < entry_count; i++) {
+		const FST_Entry *const fst_entry = &fst_entries[i];
+		if (be32_to_cpu(fst_entry->type_name) & 0xFF000000) {
+			// Directory.
+			continue;
+		}
+		dr.markUsed(usedMap, (uint64_t)be32_to_cpu(fst_entry->offset) << shift,
+			be32_to_cpu(fst_entry->size));
+	}
+
+	return 0;
+}
+
+/**
+ * Decrypt a Wii partition's title key.
+ * @param ticket	[in] Ticket.
+ * @param titleKey	[out] Output buffer for the title key. (Must be 16 bytes.)
+ * @param aesw		[in] AES context.
+ * @return 0 on success; non-zero on error.
+ */
+static int getTitleKey(const RVL_Ticket *ticket, uint8_t *titleKey, AesCtx *aesw)
+{
+	const uint8_t *commonKey;
+	switch (cert_get_issuer_from_name(ticket->issuer)) {
+		case RVL_CERT_ISSUER_PPKI_TICKET:
+			// Retail certificate.
+			switch (ticket->common_key_index) {
+				case 0:
+				default:
+					commonKey = RVL_AES_Keys[RVL_KEY_RETAIL];
+					break;
+				case 1:
+					commonKey = RVL_AES_Keys[RVL_KEY_KOREAN];
+					break;
+				case 2:
+					commonKey = RVL_AES_Keys[vWii_KEY_RETAIL];
+					break;
+			}
+			break;
+		case RVL_CERT_ISSUER_DPKI_TICKET:
+			// Debug certificate.
+			switch (ticket->common_key_index) {
+				case 0:
+				default:
+					commonKey = RVL_AES_Keys[RVL_KEY_DEBUG];
+					break;
+				case 1:
+					commonKey = RVL_AES_Keys[RVL_KEY_KOREAN_DEBUG];
+					break;
+				case 2:
+					commonKey = RVL_AES_Keys[vWii_KEY_DEBUG];
+					break;
+			}
+			break;
+		default:
+			// Unknown issuer, or not valid for ticket.
+			errno = EIO;
+			return RVTH_ERROR_ISSUER_UNKNOWN;
+	}
+
+	// IV is the 64-bit title ID, followed by zeroes.
+	uint8_t iv[16];
+	memcpy(iv, &ticket->title_id, 8);
+	memset(&iv[8], 0, 8);
+
+	memcpy(titleKey, ticket->enc_title_key, 16);
+	aesw_set_key(aesw, commonKey, 16);
+	aesw_set_iv(aesw, iv, sizeof(iv));
+	aesw_decrypt(aesw, titleKey, 16);
+	return 0;
+}
+
+/**
+ * Mark all used data in a Wii partition.
+ * @param reader	[in] Disc image reader.
+ * @param pte		[in] Partition table entry.
+ * @param encrypted	[in] If true, the partition is encrypted.
+ * @param usedMap	[in/out] Scrub map.
+ * @return 0 on success; non-zero on error.
+ */
+static int scrubWiiPartition(Reader *reader, const pt_entry_t *pte, bool encrypted, vector<bool> &usedMap)
+{
+	const uint64_t part_start = LBA_TO_BYTES(pte->lba_start);
+	const uint64_t part_end = part_start + LBA_TO_BYTES(pte->lba_len);
+
+	// Read the partition header.
+	RVL_PartitionHeader *const pthdr = static_cast<RVL_PartitionHeader*>(malloc(sizeof(*pthdr)));
+	if (!pthdr) {
+		return -ENOMEM;
+	}
+	errno = 0;
+	if (reader->read(pthdr, pte->lba_start, BYTES_TO_LBA(sizeof(*pthdr))) != BYTES_TO_LBA(sizeof(*pthdr))) {
+		const int ret = (errno != 0 ? -errno : -EIO);
+		free(pthdr);
+		return ret;
+	}
+
+	// Ticket, TMD, certificate chain, and H3 table.
+	const uint64_t data_offset = (uint64_t)be32_to_cpu(pthdr->data_offset) << 2;
+	if (data_offset < sizeof(*pthdr) || part_start + data_offset >= part_end) {
+		// Invalid data offset.
+		free(pthdr);
+		return -EIO;
+	}
+	markUsed(usedMap, part_start, data_offset);
+
+	int ret;
+	AesCtx *aesw = nullptr;
+	if (encrypted) {
+		uint8_t titleKey[16];
+		errno = 0;
+		aesw = aesw_new();
+		if (!aesw) {
+			free(pthdr);
+			return (errno != 0 ? -errno : -EIO);
+		}
+		ret = getTitleKey(&pthdr->ticket, titleKey, aesw);
+		if (ret != 0) {
+			aesw_free(aesw);
+			free(pthdr);
+			return ret;
+		}
+		aesw_set_key(aesw, titleKey, sizeof(titleKey));
+	}
+	free(pthdr);
+
+	ScrubDataReader dr(reader, part_start + data_offset, part_end, aesw);
+	ret = scrubDataArea(dr, true, usedMap);
+
+	if (aesw) {
+		aesw_free(aesw);
+	}
+	return ret;
+}
+
+/**
+ * Determine which parts of a bank are actually used by the disc image.
+ *
+ * The FST is parsed to find all referenced files, along with the
+ * boot block, apploader, and main DOL. Wii partitions are decrypted
+ * as needed. Unreferenced blocks can be written as holes when
+ * extracting; this doesn't affect used data, and each Wii sector
+ * contains its own copy of the H1 and H2 hashes.
+ *
+ * If a partition can't be parsed, the entire partition is marked
+ * as used, so scrubbing never removes data that might be needed.
+ *
+ * @param bank		[in] Bank number. (0-7)
+ * @param usedMap	[out] Scrub map, with one entry per RVTH_SCRUB_BLOCK_SIZE bytes.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::getScrubMap(unsigned int bank, vector<bool> &usedMap)
+{
+	usedMap.clear();
+	if (bank >= m_bankCount) {
+		errno = ERANGE;
+		return -ERANGE;
+	}
+
+	RvtH_BankEntry *const entry = &m_entries[bank];
+	switch (entry->type) {
+		case RVTH_BankType_GCN:
+		case RVTH_BankType_Wii_SL:
+		case RVTH_BankType_Wii_DL:
+			// Bank can be scrubbed.
+			break;
+
+		case RVTH_BankType_Empty:
+			// Bank is empty.
+			errno = ENOENT;
+			return RVTH_ERROR_BANK_EMPTY;
+
+		case RVTH_BankType_Wii_DL_Bank2:
+			// Second bank of a dual-layer Wii disc image.
+			errno = EIO;
+			return RVTH_ERROR_BANK_DL_2;
+
+		case RVTH_BankType_Unknown:
+		default:
+			// Unknown bank status...
+			errno = EIO;
+			return RVTH_ERROR_BANK_UNKNOWN;
+	}
+
+	Reader *const reader = entry->reader;
+	const uint64_t bank_size = LBA_TO_BYTES(reader->lba_len());
+	usedMap.assign(static_cast<size_t>((bank_size + RVTH_SCRUB_BLOCK_SIZE - 1) / RVTH_SCRUB_BLOCK_SIZE), false);
+
+	if (entry->type == RVTH_BankType_GCN) {
+		ScrubDataReader dr(reader, 0, bank_size, nullptr);
+		if (scrubDataArea(dr, false, usedMap) != 0) {
+			// Unable to parse the disc image.
+			// Keep everything.
+			usedMap.assign(usedMap.size(), true);
+		}
+		return 0;
+	}
+
+	// Wii disc header, volume group table, and region settings.
+	markUsed(usedMap, 0, WII_DISC_HEADER_AREA_SIZE);
+
+	int ret = rvth_ptbl_load(entry);
+	if (ret != 0) {
+		// Unable to load the partition table.
+		// Keep everything.
+		usedMap.assign(usedMap.size(), true);
+		return 0;
+	}
+
+	const bool encrypted = (entry->crypto_type != RVL_CryptoType_None);
+	const pt_entry_t *pte = entry->ptbl;
+	for (unsigned int i = 0; i < entry->pt_count; i++, pte++) {
+		if (pte->lba_start == 0)
+			continue;
+		if (scrubWiiPartition(reader, pte, encrypted, usedMap) != 0) {
+			// Unable to parse the partition.
+			// Keep the entire partition.
+			markUsed(usedMap, LBA_TO_BYTES(pte->lba_start), LBA_TO_BYTES(pte->lba_len));
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,20 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * simd.h: SIMD instruction set detection.                                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_SIMD_H__
+#define __RVTHTOOL_LIBRVTH_SIMD_H__
+
+// SSE2 is always available on amd64.
+// On i386, it's only used if the compiler is targeting SSE2.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define RVTH_HAS_SSE2 1
+#endif
+
+#endif /* __RVTHTOOL_LIBRVTH_SIMD_H__ */
@@ -0,0 +1,365 @@
+/***************************************************************************
+ * RVT-H Tool (librvth/tests)                                              *
+ * ExtractTest.cpp: Disc image extraction tests.                           *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+// Google Test
+#include "gtest/gtest.h"
+
+#include "librvth/rvth.hpp"
+#include "librvth/journal.hpp"
+#include "librvth/junk.hpp"
+#include "librvth/reader/Reader.hpp"
+#include "libwiicrypto/byteswap.h"
+
+// C includes. (C++ namespace)
+#include <cstdio>
+#include <cstring>
+
+// C++ includes.
+#include <string>
+#include <vector>
+using std::string;
+using std::vector;
+
+namespace LibRvtH { namespace Tests {
+
+// Test disc image layout:
+// - Header and pseudo-random data
+// - Zeroes
+// - Junk data
+// The image size is a multiple of the WBFS sector size.
+#define TEST_DISC_SIZE		(16U*1024*1024)
+#define TEST_DATA_SIZE		(4U*1024*1024)
+#define TEST_JUNK_OFFSET	(8U*1024*1024)
+
+// Filenames.
+#define TEST_SRC_FILENAME	_T("ExtractTest.src.gcm")
+#define TEST_EXT_FILENAME	_T("ExtractTest.ext")
+#define TEST_GCM_FILENAME	_T("ExtractTest.gcm")
+
+class ExtractTest : public ::testing::TestWithParam<RvtH_ExtractFormat_e>
+{
+	protected:
+		ExtractTest() { }
+
+	public:
+		static void SetUpTestCase(void);
+		static void TearDownTestCase(void);
+		void TearDown(void) final;
+
+	public:
+		/**
+		 * Remove a disc image and its junk run list and resume journal.
+		 * @param filename Disc image filename.
+		 */
+		static void removeImage(const TCHAR *filename);
+
+		/**
+		 * Read a disc image into memory using RvtH.
+		 * Holes in the disc image are read as zeroes,
+		 * so junk data is not regenerated.
+		 * @param filename	[in] Disc image filename.
+		 * @param data		[out] Disc image data.
+		 */
+		static void readImage(const TCHAR *filename, vector<uint8_t> &data);
+
+		/**
+		 * Test case suffix generator.
+		 * @param info Test parameter information.
+		 * @return Test case suffix.
+		 */
+		static string test_case_suffix_generator(const ::testing::TestParamInfo<RvtH_ExtractFormat_e> &info);
+
+	public:
+		// Source disc image data.
+		static vector<uint8_t> m_srcData;
+};
+
+vector<uint8_t> ExtractTest::m_srcData;
+
+/**
+ * Create the source disc image.
+ */
+void ExtractTest::SetUpTestCase(void)
+{
+	m_srcData.assign(TEST_DISC_SIZE, 0);
+
+	// Pseudo-random data. (xorshift32)
+	uint32_t x = 0x12345678;
+	for (unsigned int i = 0; i < TEST_DATA_SIZE; i += 4) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		memcpy(&m_srcData[i], &x, sizeof(x));
+	}
+
+	// GameCube disc header.
+	GCN_DiscHeader *const discHeader = reinterpret_cast<GCN_DiscHeader*>(m_srcData.data());
+	memset(discHeader, 0, sizeof(*discHeader));
+	memcpy(discHeader->id6, "RVTEST", 6);
+	discHeader->magic_gcn = cpu_to_be32(GCN_MAGIC);
+	strcpy(discHeader->game_title, "RVT-H Tool extraction test");
+
+	// Junk data. Each junk block has its own seed.
+	LaggedFibonacci lfg;
+	for (unsigned int i = TEST_JUNK_OFFSET; i < TEST_DISC_SIZE; i += RVTH_JUNK_BLOCK_SIZE) {
+		uint32_t seed[LaggedFibonacci::SEED_SIZE];
+		for (unsigned int j = 0; j < LaggedFibonacci::SEED_SIZE; j++) {
+			seed[j] = i ^ (j * 0x9E3779B9U);
+		}
+		lfg.setSeed(seed);
+		lfg.getBytes(&m_srcData[i], RVTH_JUNK_BLOCK_SIZE);
+	}
+
+	FILE *f = _tfopen(TEST_SRC_FILENAME, _T("wb"));
+	ASSERT_TRUE(f != nullptr);
+	size_t size = fwrite(m_srcData.data(), 1, m_srcData.size(), f);
+	fclose(f);
+	ASSERT_EQ(m_srcData.size(), size);
+}
+
+/**
+ * Remove the source disc image.
+ */
+void ExtractTest::TearDownTestCase(void)
+{
+	removeImage(TEST_SRC_FILENAME);
+	m_srcData.clear();
+}
+
+/**
+ * Remove the extracted disc images.
+ */
+void ExtractTest::TearDown(void)
+{
+	removeImage(TEST_EXT_FILENAME);
+	removeImage(TEST_GCM_FILENAME);
+}
+
+/**
+ * Remove a disc image and its junk run list and resume journal.
+ * @param filename Disc image filename.
+ */
+void ExtractTest::removeImage(const TCHAR *filename)
+{
+	_tremove(filename);
+	_tremove((tstring(filename) + RVTH_JUNK_FILE_EXT).c_str());
+	_tremove((tstring(filename) + RVTH_JOURNAL_FILE_EXT).c_str());
+}
+
+/**
+ * Read a disc image into memory using RvtH.
+ * Holes in the disc image are read as zeroes,
+ * so junk data is not regenerated.
+ * @param filename	[in] Disc image filename.
+ * @param data		[out] Disc image data.
+ */
+void ExtractTest::readImage(const TCHAR *filename, vector<uint8_t> &data)
+{
+	data.clear();
+
+	int err = 0;
+	RvtH rvth(filename, &err);
+	ASSERT_EQ(0, err);
+	ASSERT_TRUE(rvth.isOpen());
+	ASSERT_EQ(1U, rvth.bankCount());
+
+	const RvtH_BankEntry *const entry = rvth.bankEntry(0);
+	ASSERT_TRUE(entry != nullptr);
+	ASSERT_TRUE(entry->reader != nullptr);
+	ASSERT_EQ(BYTES_TO_LBA(TEST_DISC_SIZE), entry->lba_len);
+
+	data.resize(TEST_DISC_SIZE);
+	ASSERT_EQ(entry->lba_len, entry->reader->read(data.data(), 0, entry->lba_len));
+}
+
+/**
+ * Test case suffix generator.
+ * @param info Test parameter information.
+ * @return Test case suffix.
+ */
+string ExtractTest::test_case_suffix_generator(const ::testing::TestParamInfo<RvtH_ExtractFormat_e> &info)
+{
+	switch (info.param) {
+		case RVTH_ExtractFormat_GCM:	return "GCM";
+		case RVTH_ExtractFormat_GCZ:	return "GCZ";
+		case RVTH_ExtractFormat_CISO:	return "CISO";
+		case RVTH_ExtractFormat_WBFS:	return "WBFS";
+		default:			return "unknown";
+	}
+}
+
+/**
+ * Extract the disc image using a disc image writer,
+ * then read it back using the format's reader.
+ */
+TEST_P(ExtractTest, writerRoundTrip)
+{
+	const RvtH_ExtractFormat_e format = GetParam();
+
+	int err = 0;
+	RvtH rvth_src(TEST_SRC_FILENAME, &err);
+	ASSERT_EQ(0, err);
+	ASSERT_EQ(1U, rvth_src.bankCount());
+	ASSERT_EQ(RVTH_BankType_GCN, rvth_src.bankEntry(0)->type);
+	ASSERT_EQ(0, rvth_src.extract(0, TEST_EXT_FILENAME, -1, RVTH_EXTRACT_FORMAT(format)));
+
+	vector<uint8_t> data;
+	ASSERT_NO_FATAL_FAILURE(readImage(TEST_EXT_FILENAME, data));
+	EXPECT_TRUE(data == m_srcData);
+}
+
+/**
+ * Extract the disc image with junk data stripped, then
+ * extract it again as a plain disc image with the junk
+ * data regenerated.
+ */
+TEST_P(ExtractTest, junkRoundTrip)
+{
+	const RvtH_ExtractFormat_e format = GetParam();
+
+	int err = 0;
+	RvtH rvth_src(TEST_SRC_FILENAME, &err);
+	ASSERT_EQ(0, err);
+	ASSERT_EQ(0, rvth_src.extract(0, TEST_EXT_FILENAME, -1,
+		RVTH_EXTRACT_STRIP_JUNK | RVTH_EXTRACT_FORMAT(format)));
+
+	// The junk data must have been stripped.
+	vector<uint8_t> data;
+	ASSERT_NO_FATAL_FAILURE(readImage(TEST_EXT_FILENAME, data));
+	EXPECT_EQ(0, memcmp(data.data(), m_srcData.data(), TEST_JUNK_OFFSET));
+	const vector<uint8_t> zero(TEST_DISC_SIZE - TEST_JUNK_OFFSET, 0);
+	EXPECT_EQ(0, memcmp(&data[TEST_JUNK_OFFSET], zero.data(), zero.size()));
+
+	// Regenerate the junk data.
+	{
+		RvtH rvth_ext(TEST_EXT_FILENAME, &err);
+		ASSERT_EQ(0, err);
+		ASSERT_EQ(0, rvth_ext.extract(0, TEST_GCM_FILENAME, -1, 0));
+	}
+	ASSERT_NO_FATAL_FAILURE(readImage(TEST_GCM_FILENAME, data));
+	EXPECT_TRUE(data == m_srcData);
+}
+
+/**
+ * Progress callback that records the LBAs processed.
+ * @param state		[in] Current progress.
+ * @param userdata	[in] vector<uint32_t>* for lba_processed, with the
+ *			     cancellation LBA as the first element.
+ * @return True to continue; false to abort.
+ */
+static bool progress_callback(const RvtH_Progress_State *state, void *userdata)
+{
+	vector<uint32_t> *const lbas = static_cast<vector<uint32_t>*>(userdata);
+	lbas->push_back(state->lba_processed);
+	return (state->lba_processed < (*lbas)[0]);
+}
+
+/**
+ * Cancel an extraction partway through, then resume it.
+ */
+TEST_F(ExtractTest, resumeExtract)
+{
+	int err = 0;
+	RvtH rvth_src(TEST_SRC_FILENAME, &err);
+	ASSERT_EQ(0, err);
+
+	// Cancel the extraction halfway through.
+	const uint32_t lba_cancel = BYTES_TO_LBA(TEST_DISC_SIZE / 2);
+	vector<uint32_t> lbas(1, lba_cancel);
+	ASSERT_EQ(-ECANCELED, rvth_src.extract(0, TEST_GCM_FILENAME, -1, 0,
+		progress_callback, &lbas));
+
+	// Resume the extraction. Copying must not restart at LBA 0.
+	lbas.assign(1, ~0U);
+	ASSERT_EQ(0, rvth_src.extract(0, TEST_GCM_FILENAME, -1, RVTH_EXTRACT_RESUME,
+		progress_callback, &lbas));
+	ASSERT_GE(lbas.size(), 2U);
+	EXPECT_GT(lbas[1], 0U);
+	EXPECT_LE(lbas[1], lba_cancel);
+
+	// The journal must be removed once the extraction is complete.
+	FILE *f = _tfopen((tstring(TEST_GCM_FILENAME) + RVTH_JOURNAL_FILE_EXT).c_str(), _T("rb"));
+	EXPECT_TRUE(f == nullptr);
+	if (f) {
+		fclose(f);
+	}
+
+	vector<uint8_t> data;
+	ASSERT_NO_FATAL_FAILURE(readImage(TEST_GCM_FILENAME, data));
+	EXPECT_TRUE(data == m_srcData);
+}
+
+INSTANTIATE_TEST_CASE_P(ExtractFormat, ExtractTest,
+	::testing::Values(
+		RVTH_ExtractFormat_GCM,
+		RVTH_ExtractFormat_GCZ,
+		RVTH_ExtractFormat_CISO,
+		RVTH_ExtractFormat_WBFS
+	), ExtractTest::test_case_suffix_generator);
+
+/**
+ * Junk run lists that aren't sorted, or that have overlapping,
+ * empty, or out-of-range runs, must be rejected.
+ */
+TEST_F(ExtractTest, invalidJunkRunList)
+{
+	// Runs: {lba_start, lba_len}
+	static const uint32_t runs_valid[][2] = {{16, 8}, {24, 8}};
+	static const uint32_t runs_overlap[][2] = {{16, 8}, {20, 8}};
+	static const uint32_t runs_unsorted[][2] = {{24, 8}, {16, 8}};
+	static const uint32_t runs_empty[][2] = {{16, 0}};
+	static const uint32_t runs_out_of_range[][2] = {{16, BYTES_TO_LBA(TEST_DISC_SIZE)}};
+	static const struct {
+		const uint32_t (*runs)[2];
+		unsigned int count;
+		int ret;
+	} tests[] = {
+		{runs_valid, 2, 0},
+		{runs_overlap, 2, -EINVAL},
+		{runs_unsorted, 2, -EINVAL},
+		{runs_empty, 1, -EINVAL},
+		{runs_out_of_range, 1, -EINVAL},
+	};
+
+	int err = 0;
+	RvtH rvth(TEST_SRC_FILENAME, &err);
+	ASSERT_EQ(0, err);
+
+	const tstring junk_filename = tstring(TEST_GCM_FILENAME) + RVTH_JUNK_FILE_EXT;
+	for (const auto &test : tests) {
+		vector<RvtH_JunkRun> runs(test.count);
+		for (unsigned int i = 0; i < test.count; i++) {
+			memset(&runs[i], 0, sizeof(runs[i]));
+			runs[i].lba_start = test.runs[i][0];
+			runs[i].lba_len = test.runs[i][1];
+		}
+		ASSERT_EQ(0, RvtH::saveJunkRuns(junk_filename.c_str(), runs));
+		EXPECT_EQ(test.ret, rvth.loadJunkRuns(junk_filename.c_str()));
+	}
+}
+
+} }
+
+#ifdef _MSC_VER
+# define RVTH_CDECL __cdecl
+#else
+# define RVTH_CDECL
+#endif
+
+/**
+ * Test suite main function.
+ */
+int RVTH_CDECL main(int argc, char *argv[])
+{
+	fprintf(stderr, "librvth test suite: Disc image extraction tests.\n\n");
+	fflush(nullptr);
+
+	// coverity[fun_call_w_exception]: uncaught exceptions cause nonzero exit anyway, so don't warn.
+	::testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
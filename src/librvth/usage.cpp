@@ -0,0 +1,280 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * usage.cpp: Determine how much of each bank is in use.                   *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "rvth.hpp"
+#include "rvth_error.h"
+#include "nhcd_structs.h"
+#include "simd.h"
+
+#include "RefFile.hpp"
+#include "reader/Reader.hpp"
+
+// libwiicrypto
+#include "libwiicrypto/threadw.h"
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <atomic>
+#include <vector>
+using std::vector;
+
+// Read buffer size. (4 MiB; must be a multiple of the map block size)
+#define USAGE_BUF_SIZE (4U*1024U*1024U)
+#define USAGE_BUF_LBA BYTES_TO_LBA(USAGE_BUF_SIZE)
+static_assert(USAGE_BUF_SIZE % RVTH_USAGE_MAP_BLOCK_SIZE == 0,
+	"USAGE_BUF_SIZE must be a multiple of RVTH_USAGE_MAP_BLOCK_SIZE");
+
+/**
+ * Count the number of non-zero bytes in a block.
+ * @param block Block.
+ * @param size Block size. (Must be a multiple of 64 bytes.)
+ * @return Number of non-zero bytes.
+ */
+static unsigned int countNonZeroBytes(const uint8_t *block, unsigned int size)
+{
+	unsigned int count = 0;
+	assert(size % 64 == 0);
+
+#ifdef RVTH_HAS_SSE2
+	// Compare 16 bytes at a time. Each zero byte
+	// sets one bit in the movemask result.
+	const __m128i *block128 = reinterpret_cast<const __m128i*>(block);
+	const __m128i zero = _mm_setzero_si128();
+	for (unsigned int i = size/16; i > 0; i--, block128++) {
+		unsigned int mask = static_cast<unsigned int>(
+			_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block128), zero)));
+		// Count the zero bytes.
+		mask = mask - ((mask >> 1) & 0x5555);
+		mask = (mask & 0x3333) + ((mask >> 2) & 0x3333);
+		mask = (mask + (mask >> 4)) & 0x0F0F;
+		mask = (mask + (mask >> 8)) & 0x1F;
+		count += 16 - mask;
+	}
+#else /* !RVTH_HAS_SSE2 */
+	for (unsigned int i = 0; i < size; i++) {
+		count += (block[i] != 0);
+	}
+#endif /* RVTH_HAS_SSE2 */
+
+	return count;
+}
+
+// Shared state for getBankUsage() worker threads.
+struct UsageScanParams {
+	const TCHAR *filename;			// HDD filename
+	const RvtH_BankEntry *entries;		// Bank entries
+	vector<unsigned int> banks;		// Banks to scan
+	vector<RvtH_BankUsage> *usage;		// Usage information
+	vector<int> ret;			// Result for each bank
+
+	// Progress callback.
+	// The mutex ensures the callback is never called concurrently.
+	RvtH_Progress_Callback callback;
+	void *userdata;
+	RvtH_Progress_State state;
+	threadw_mutex_t mutex;
+	std::atomic<bool> cancel;
+};
+
+/**
+ * Scan a single bank for getBankUsage().
+ * @param params	[in] Shared parameters.
+ * @param bank		[in] Bank number.
+ * @param usage		[out] Usage information.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+static int scanBankUsage(UsageScanParams *params, unsigned int bank, RvtH_BankUsage *usage)
+{
+	const RvtH_BankEntry *const entry = &params->entries[bank];
+
+	// Open a separate file handle so banks can be read in parallel.
+	RefFile *const file = new RefFile(params->filename);
+	if (!file->isOpen()) {
+		int err = file->lastError();
+		if (err == 0) {
+			err = EIO;
+		}
+		file->unref();
+		return -err;
+	}
+	Reader *const reader = Reader::open(file, entry->lba_start, entry->lba_len);
+	file->unref();
+	if (!reader) {
+		return -EIO;
+	}
+
+	uint8_t *const buf = static_cast<uint8_t*>(malloc(USAGE_BUF_SIZE));
+	if (!buf) {
+		delete reader;
+		return -ENOMEM;
+	}
+
+	const uint32_t lba_len = reader->lba_len();
+	usage->lba_len = lba_len;
+	usage->nonzero_bytes = 0;
+	usage->sparse_size = 0;
+	usage->trimmed_size = 0;
+	usage->map.assign((LBA_TO_BYTES(lba_len) + RVTH_USAGE_MAP_BLOCK_SIZE - 1) / RVTH_USAGE_MAP_BLOCK_SIZE, 0);
+
+	int ret = 0;
+	for (uint32_t lba = 0; lba < lba_len; ) {
+		if (params->cancel.load()) {
+			ret = -ECANCELED;
+			break;
+		}
+
+		const uint32_t lba_count = std::min(USAGE_BUF_LBA, lba_len - lba);
+		errno = 0;
+		if (reader->read(buf, lba, lba_count) != lba_count) {
+			// Read error.
+			ret = -(errno != 0 ? errno : EIO);
+			break;
+		}
+
+		// Check each sparse block.
+		// A partial block at the end of the bank is zero-padded.
+		const unsigned int size = LBA_TO_BYTES(lba_count);
+		const unsigned int size_padded = (size + RVTH_USAGE_SPARSE_BLOCK_SIZE - 1) & ~(RVTH_USAGE_SPARSE_BLOCK_SIZE - 1);
+		memset(&buf[size], 0, size_padded - size);
+		const uint64_t offset = LBA_TO_BYTES(lba);
+		for (unsigned int pos = 0; pos < size_padded; pos += RVTH_USAGE_SPARSE_BLOCK_SIZE) {
+			const uint8_t *const block = &buf[pos];
+			if (RvtH::isBlockEmpty(block, RVTH_USAGE_SPARSE_BLOCK_SIZE))
+				continue;
+
+			usage->nonzero_bytes += countNonZeroBytes(block, RVTH_USAGE_SPARSE_BLOCK_SIZE);
+			usage->sparse_size += RVTH_USAGE_SPARSE_BLOCK_SIZE;
+			usage->trimmed_size = offset + pos + RVTH_USAGE_SPARSE_BLOCK_SIZE;
+			usage->map[(offset + pos) / RVTH_USAGE_MAP_BLOCK_SIZE]++;
+		}
+		lba += lba_count;
+
+		if (params->callback) {
+			threadw_mutex_lock(&params->mutex);
+			params->state.lba_processed += lba_count;
+			if (!params->callback(&params->state, params->userdata)) {
+				params->cancel = true;
+			}
+			threadw_mutex_unlock(&params->mutex);
+		}
+	}
+
+	// Don't count zero padding past the end of the bank.
+	const uint64_t bank_size = LBA_TO_BYTES(lba_len);
+	usage->sparse_size = std::min(usage->sparse_size, bank_size);
+	usage->trimmed_size = std::min(usage->trimmed_size, bank_size);
+
+	free(buf);
+	delete reader;
+	return ret;
+}
+
+/**
+ * Worker function for getBankUsage().
+ * @param index		[in] Index into UsageScanParams::banks.
+ * @param userdata	[in] UsageScanParams
+ */
+static void usageWorker(unsigned int index, void *userdata)
+{
+	UsageScanParams *const params = static_cast<UsageScanParams*>(userdata);
+	const unsigned int bank = params->banks[index];
+	params->ret[index] = scanBankUsage(params, bank, &(*params->usage)[bank]);
+}
+
+/**
+ * Scan all banks to determine how much of each bank is in use.
+ *
+ * Banks are scanned in parallel using separate file handles.
+ * Empty banks and the second bank of dual-layer Wii images
+ * aren't scanned; their usage entries will have lba_len == 0.
+ *
+ * @param usage		[out] Usage information, indexed by bank number.
+ * @param callback	[in,opt] Progress callback. (May be called from worker threads, but never concurrently.)
+ * @param userdata	[in,opt] User data for progress callback.
+ * @return Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+int RvtH::getBankUsage(vector<RvtH_BankUsage> &usage,
+	RvtH_Progress_Callback callback, void *userdata)
+{
+	usage.clear();
+	usage.resize(m_bankCount);
+	for (RvtH_BankUsage &u : usage) {
+		u.lba_len = 0;
+		u.nonzero_bytes = 0;
+		u.sparse_size = 0;
+		u.trimmed_size = 0;
+	}
+
+	UsageScanParams params;
+	params.filename = m_file->filename();
+	params.entries = m_entries;
+	params.usage = &usage;
+	params.callback = callback;
+	params.userdata = userdata;
+	params.cancel = false;
+
+	params.state.rvth = this;
+	params.state.rvth_gcm = nullptr;
+	params.state.bank_rvth = ~0;
+	params.state.bank_gcm = ~0;
+	params.state.type = RVTH_PROGRESS_USAGE;
+	params.state.lba_processed = 0;
+	params.state.lba_total = 0;
+
+	// Determine which banks need to be scanned.
+	for (unsigned int bank = 0; bank < m_bankCount; bank++) {
+		const RvtH_BankEntry *const entry = &m_entries[bank];
+		if (entry->type < RVTH_BankType_GCN ||
+		    entry->type == RVTH_BankType_Wii_DL_Bank2 ||
+		    !entry->reader)
+		{
+			// Nothing to scan.
+			continue;
+		}
+		params.banks.push_back(bank);
+		params.state.lba_total += entry->reader->lba_len();
+	}
+	if (params.banks.empty()) {
+		// Nothing to do.
+		return 0;
+	}
+	params.ret.assign(params.banks.size(), 0);
+
+	if (callback) {
+		callback(&params.state, userdata);
+	}
+
+	int ret = threadw_mutex_init(&params.mutex);
+	if (ret != 0) {
+		errno = -ret;
+		return ret;
+	}
+	ret = threadw_parallel_for(static_cast<unsigned int>(params.banks.size()), 0,
+		usageWorker, &params);
+	threadw_mutex_destroy(&params.mutex);
+	if (ret != 0) {
+		errno = -ret;
+		return ret;
+	}
+
+	for (int bank_ret : params.ret) {
+		if (bank_ret != 0) {
+			ret = bank_ret;
+			break;
+		}
+	}
+	return ret;
+}
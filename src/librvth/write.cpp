@@ -33,13 +33,19 @@
  * @param filename	[in] Filename.
  * @param lba_len	[in] LBA length. (Will NOT be allocated initially.)
  * @param pErr		[out,opt] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ * @param reopen	[in,opt] If true, an existing file is reopened without truncating it.
  */
-RvtH::RvtH(const TCHAR *filename, uint32_t lba_len, int *pErr)
+RvtH::RvtH(const TCHAR *filename, uint32_t lba_len, int *pErr, bool reopen)
 	: m_file(nullptr)
 	, m_bankCount(0)
 	, m_imageType(RVTH_ImageType_Unknown)
 	, m_NHCD_status(NHCD_STATUS_UNKNOWN)
 	, m_entries(nullptr)
+	, m_bankTable(nullptr)
+	, m_bankTableDirty(0)
+	, m_bankTableUpdateDepth(0)
+	, m_bankTableSnapshot(nullptr)
+	, m_progress(nullptr)
 {
 	RvtH_BankEntry *entry;
 
@@ -67,8 +73,19 @@ RvtH::RvtH(const TCHAR *filename, uint32_t lba_len, int *pErr)
 		goto fail;
 	};
 
-	// Attempt to create the file.
-	m_file = new RefFile(filename, true);
+	if (reopen) {
+		// Attempt to reopen an existing file.
+		m_file = new RefFile(filename);
+		if (!m_file->isOpen() || m_file->makeWritable() != 0) {
+			// Unable to reopen the file. Create it instead.
+			m_file->unref();
+			m_file = nullptr;
+		}
+	}
+	if (!m_file) {
+		// Attempt to create the file.
+		m_file = new RefFile(filename, true);
+	}
 	if (!m_file->isOpen()) {
 		// Error creating the file.
 		err = m_file->lastError();
@@ -173,13 +190,19 @@ int RvtH::deleteBank(unsigned int bank)
 	}
 
 	// Delete the bank and write the entry.
+	const time_t timestamp_orig = rvth_entry->timestamp;
 	rvth_entry->is_deleted = true;
 	rvth_entry->timestamp = -1;
 	ret = this->writeBankEntry(bank);
-	m_file->flush();
+	if (m_bankTableUpdateDepth == 0) {
+		// NOTE: If a bank table update is in progress,
+		// it will be flushed when it's committed.
+		m_file->flush();
+	}
 	if (ret != 0) {
 		// Error deleting the bank...
 		rvth_entry->is_deleted = false;
+		rvth_entry->timestamp = timestamp_orig;
 	}
 	return ret;
 }
@@ -253,12 +276,18 @@ int RvtH::undeleteBank(unsigned int bank)
 	}
 
 	// Undelete the bank and write the entry.
+	const time_t timestamp_orig = rvth_entry->timestamp;
 	rvth_entry->is_deleted = false;
 	ret = this->writeBankEntry(bank, &rvth_entry->timestamp);
-	m_file->flush();
+	if (m_bankTableUpdateDepth == 0) {
+		// NOTE: If a bank table update is in progress,
+		// it will be flushed when it's committed.
+		m_file->flush();
+	}
 	if (ret != 0) {
 		// Error undeleting the bank...
 		rvth_entry->is_deleted = true;
+		rvth_entry->timestamp = timestamp_orig;
 	}
 	return ret;
 }
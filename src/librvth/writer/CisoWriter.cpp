@@ -0,0 +1,203 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * CisoWriter.cpp: CISO disc image writer class.                           *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "CisoWriter.hpp"
+#include "reader/ciso_structs.h"
+#include "byteswap.h"
+#include "rvth.hpp"
+
+// For LBA_TO_BYTES()
+#include "nhcd_structs.h"
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+
+/**
+ * Create a CISO writer for a disc image.
+ * @param file		RefFile*. (Must be writable.)
+ * @param lba_len	[in] Length of the disc image, in LBAs.
+ */
+CisoWriter::CisoWriter(RefFile *file, uint32_t lba_len)
+	: super(file, lba_len)
+	, m_cisoHeader(nullptr)
+	, m_block_size(CISO_BLOCK_SIZE_MIN)
+	, m_num_blocks(0)
+	, m_blockIdx(0)
+	, m_physBlocks(0)
+	, m_blockBuf(nullptr)
+	, m_blockBufSize(0)
+{
+	if (!isOpen()) {
+		// File wasn't opened.
+		return;
+	}
+
+	// Use the smallest block size that allows the
+	// entire image to fit in the block map.
+	const uint64_t data_size = LBA_TO_BYTES(lba_len);
+	for (; m_block_size < CISO_BLOCK_SIZE_MAX; m_block_size <<= 1) {
+		if ((data_size + m_block_size - 1) / m_block_size <= CISO_MAP_SIZE)
+			break;
+	}
+	m_num_blocks = static_cast<uint32_t>((data_size + m_block_size - 1) / m_block_size);
+	if (m_num_blocks > CISO_MAP_SIZE) {
+		// Image is too big.
+		m_file->unref();
+		m_file = nullptr;
+		errno = EFBIG;
+		return;
+	}
+
+	m_cisoHeader = new CisoHeader;
+	memset(m_cisoHeader, 0, sizeof(*m_cisoHeader));
+	memcpy(m_cisoHeader->magic, CISO_MAGIC, sizeof(m_cisoHeader->magic));
+	m_cisoHeader->block_size = cpu_to_le32(m_block_size);
+
+	m_blockBuf = static_cast<uint8_t*>(malloc(m_block_size));
+	if (!m_blockBuf) {
+		// Error allocating memory.
+		m_file->unref();
+		m_file = nullptr;
+		errno = ENOMEM;
+		return;
+	}
+}
+
+CisoWriter::~CisoWriter()
+{
+	delete m_cisoHeader;
+	free(m_blockBuf);
+
+	// Superclass will unreference the file.
+}
+
+/**
+ * Write the block in the block buffer.
+ * Empty blocks are skipped, except for the last block.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int CisoWriter::flushBlock(void)
+{
+	assert(m_blockBufSize == m_block_size);
+	assert(m_blockIdx < m_num_blocks);
+
+	// CisoReader determines the image size using the last
+	// used block, so the last block must always be written.
+	if (m_blockIdx + 1 < m_num_blocks &&
+	    RvtH::isBlockEmpty(m_blockBuf, m_block_size))
+	{
+		// Empty block. Don't write it.
+		m_cisoHeader->map[m_blockIdx] = 0;
+	} else {
+		// Physical blocks are stored sequentially after the header.
+		int ret = m_file->seeko(CISO_HEADER_SIZE + ((int64_t)m_physBlocks * m_block_size), SEEK_SET);
+		if (ret != 0) {
+			// Seek error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		errno = 0;
+		if (m_file->write(m_blockBuf, 1, m_block_size) != m_block_size) {
+			// Write error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		m_cisoHeader->map[m_blockIdx] = 1;
+		m_physBlocks++;
+	}
+
+	m_blockIdx++;
+	m_blockBufSize = 0;
+	return 0;
+}
+
+/**
+ * Write data to the disc image.
+ * Data is appended after the previously-written data.
+ * @param ptr		[in] Write buffer.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int CisoWriter::write(const void *ptr, uint32_t lba_len)
+{
+	assert(m_lba_pos + lba_len <= m_lba_len);
+	if (lba_len > m_lba_len - m_lba_pos) {
+		// Out of range.
+		return -ERANGE;
+	}
+
+	const uint8_t *ptr8 = static_cast<const uint8_t*>(ptr);
+	size_t size_left = LBA_TO_BYTES(lba_len);
+	while (size_left > 0) {
+		const size_t len = std::min(size_left, static_cast<size_t>(m_block_size - m_blockBufSize));
+		memcpy(&m_blockBuf[m_blockBufSize], ptr8, len);
+		m_blockBufSize += static_cast<uint32_t>(len);
+		ptr8 += len;
+		size_left -= len;
+
+		if (m_blockBufSize == m_block_size) {
+			// Block is full.
+			int ret = flushBlock();
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+
+	m_lba_pos += lba_len;
+	return 0;
+}
+
+/**
+ * Finish writing the disc image.
+ * All LBAs must have been written.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int CisoWriter::finish(void)
+{
+	assert(m_lba_pos == m_lba_len);
+	if (m_lba_pos != m_lba_len) {
+		// Image is incomplete.
+		return -EINVAL;
+	}
+
+	// Zero-pad the last block.
+	int ret;
+	if (m_blockBufSize != 0) {
+		memset(&m_blockBuf[m_blockBufSize], 0, m_block_size - m_blockBufSize);
+		m_blockBufSize = m_block_size;
+		ret = flushBlock();
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	assert(m_blockIdx == m_num_blocks);
+
+	// Write the header.
+	ret = m_file->seeko(0, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	errno = 0;
+	if (m_file->write(m_cisoHeader, 1, sizeof(*m_cisoHeader)) != sizeof(*m_cisoHeader)) {
+		// Write error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	if (m_file->flush() != 0) {
+		// Flush error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * CisoWriter.hpp: CISO disc image writer class.                           *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_WRITER_CISOWRITER_HPP__
+#define __RVTHTOOL_LIBRVTH_WRITER_CISOWRITER_HPP__
+
+#include "Writer.hpp"
+
+struct _CisoHeader;
+
+class CisoWriter : public Writer
+{
+	public:
+		/**
+		 * Create a CISO writer for a disc image.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 */
+		CisoWriter(RefFile *file, uint32_t lba_len);
+		virtual ~CisoWriter();
+
+	private:
+		typedef Writer super;
+		DISABLE_COPY(CisoWriter)
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Write data to the disc image.
+		 * Data is appended after the previously-written data.
+		 * @param ptr		[in] Write buffer.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int write(const void *ptr, uint32_t lba_len) final;
+
+		/**
+		 * Finish writing the disc image.
+		 * All LBAs must have been written.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int finish(void) final;
+
+	private:
+		/**
+		 * Write the block in the block buffer.
+		 * Empty blocks are skipped, except for the last block.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int flushBlock(void);
+
+	private:
+		struct _CisoHeader *m_cisoHeader;
+		uint32_t m_block_size;		// Block size, in bytes
+		uint32_t m_num_blocks;		// Number of logical blocks
+		uint32_t m_blockIdx;		// Current logical block
+		uint32_t m_physBlocks;		// Physical blocks written
+
+		// Block buffer.
+		uint8_t *m_blockBuf;
+		uint32_t m_blockBufSize;	// Bytes in m_blockBuf
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_WRITER_CISOWRITER_HPP__ */
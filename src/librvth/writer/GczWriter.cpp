@@ -0,0 +1,259 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * GczWriter.cpp: GCZ disc image writer class.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "GczWriter.hpp"
+#include "reader/gcz_structs.h"
+#include "byteswap.h"
+
+// For LBA_TO_BYTES()
+#include "nhcd_structs.h"
+
+// libwiicrypto
+#include "libwiicrypto/gcn_structs.h"
+#include "libwiicrypto/threadw.h"
+
+// zlib
+#include <zlib.h>
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+
+/**
+ * Create a GCZ writer for a disc image.
+ * @param file		RefFile*. (Must be writable.)
+ * @param lba_len	[in] Length of the disc image, in LBAs.
+ */
+GczWriter::GczWriter(RefFile *file, uint32_t lba_len)
+	: super(file, lba_len)
+	, m_block_size(GCZ_BLOCK_SIZE_DEFAULT)
+	, m_sub_type(GCZ_SUB_TYPE_GCN)
+	, m_data_offset(0)
+	, m_compressed_size(0)
+	, m_blocksWritten(0)
+	, m_batchBuf(nullptr)
+	, m_batchSize(0)
+{
+	if (!isOpen()) {
+		// File wasn't opened.
+		return;
+	}
+
+	const uint64_t data_size = LBA_TO_BYTES(lba_len);
+	const uint32_t num_blocks = static_cast<uint32_t>(
+		(data_size + m_block_size - 1) / m_block_size);
+	m_blockPointers.resize(num_blocks);
+	m_hashes.resize(num_blocks);
+	m_data_offset = sizeof(GCZ_Header) +
+		((int64_t)num_blocks * (sizeof(uint64_t) + sizeof(uint32_t)));
+
+	m_batchBuf = static_cast<uint8_t*>(malloc(GCZ_BATCH_BLOCKS * m_block_size));
+	if (!m_batchBuf) {
+		// Error allocating memory.
+		m_file->unref();
+		m_file = nullptr;
+		errno = ENOMEM;
+		return;
+	}
+	m_compBlocks.resize(GCZ_BATCH_BLOCKS);
+}
+
+GczWriter::~GczWriter()
+{
+	free(m_batchBuf);
+
+	// Superclass will unreference the file.
+}
+
+/**
+ * Worker function for flushBatch().
+ * @param index		[in] Block index within the batch.
+ * @param userdata	[in] GczWriter
+ */
+void GczWriter::compressWorker(unsigned int index, void *userdata)
+{
+	GczWriter *const writer = static_cast<GczWriter*>(userdata);
+	const uint32_t block_size = writer->m_block_size;
+	const uint8_t *const src = &writer->m_batchBuf[(size_t)index * block_size];
+	CompressedBlock *const block = &writer->m_compBlocks[index];
+
+	block->data.resize(compressBound(block_size));
+	uLongf destLen = static_cast<uLongf>(block->data.size());
+	int ret = compress2(block->data.data(), &destLen, src, block_size, Z_DEFAULT_COMPRESSION);
+	if (ret == Z_OK && destLen < block_size) {
+		// Block compressed successfully.
+		block->data.resize(destLen);
+		block->uncompressed = false;
+	} else {
+		// Block didn't compress. Store it as-is.
+		block->data.assign(src, src + block_size);
+		block->uncompressed = true;
+	}
+}
+
+/**
+ * Compress the blocks in the batch buffer and write them.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int GczWriter::flushBatch(void)
+{
+	assert(m_batchSize % m_block_size == 0);
+	const unsigned int block_count = m_batchSize / m_block_size;
+	if (block_count == 0) {
+		// Nothing to do.
+		return 0;
+	}
+
+	// Compress the blocks in parallel.
+	int ret = threadw_parallel_for(block_count, 0, compressWorker, this);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Write the compressed blocks in order.
+	ret = m_file->seeko(m_data_offset + m_compressed_size, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	for (unsigned int i = 0; i < block_count; i++) {
+		const CompressedBlock *const block = &m_compBlocks[i];
+		const size_t size = block->data.size();
+
+		m_blockPointers[m_blocksWritten] = m_compressed_size |
+			(block->uncompressed ? GCZ_BLOCK_UNCOMPRESSED : 0);
+		m_hashes[m_blocksWritten] = adler32(adler32(0, nullptr, 0),
+			block->data.data(), static_cast<uInt>(size));
+
+		errno = 0;
+		if (m_file->write(block->data.data(), 1, size) != size) {
+			// Write error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		m_compressed_size += size;
+		m_blocksWritten++;
+	}
+
+	m_batchSize = 0;
+	return 0;
+}
+
+/**
+ * Write data to the disc image.
+ * Data is appended after the previously-written data.
+ * @param ptr		[in] Write buffer.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int GczWriter::write(const void *ptr, uint32_t lba_len)
+{
+	assert(m_lba_pos + lba_len <= m_lba_len);
+	if (lba_len > m_lba_len - m_lba_pos) {
+		// Out of range.
+		return -ERANGE;
+	}
+
+	const uint8_t *ptr8 = static_cast<const uint8_t*>(ptr);
+	if (m_lba_pos == 0 && lba_len >= BYTES_TO_LBA(sizeof(GCN_DiscHeader))) {
+		// Check the disc header to determine the sub type.
+		const GCN_DiscHeader *const discHeader = reinterpret_cast<const GCN_DiscHeader*>(ptr8);
+		m_sub_type = (discHeader->magic_wii == cpu_to_be32(WII_MAGIC))
+			? GCZ_SUB_TYPE_WII : GCZ_SUB_TYPE_GCN;
+	}
+
+	const size_t batch_buf_size = (size_t)GCZ_BATCH_BLOCKS * m_block_size;
+	size_t size_left = LBA_TO_BYTES(lba_len);
+	while (size_left > 0) {
+		const size_t len = std::min(size_left, batch_buf_size - m_batchSize);
+		memcpy(&m_batchBuf[m_batchSize], ptr8, len);
+		m_batchSize += static_cast<uint32_t>(len);
+		ptr8 += len;
+		size_left -= len;
+
+		if (m_batchSize == batch_buf_size) {
+			// Batch is full.
+			int ret = flushBatch();
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+
+	m_lba_pos += lba_len;
+	return 0;
+}
+
+/**
+ * Finish writing the disc image.
+ * All LBAs must have been written.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int GczWriter::finish(void)
+{
+	assert(m_lba_pos == m_lba_len);
+	if (m_lba_pos != m_lba_len) {
+		// Image is incomplete.
+		return -EINVAL;
+	}
+
+	// Zero-pad the last block.
+	const uint32_t partial = m_batchSize % m_block_size;
+	if (partial != 0) {
+		memset(&m_batchBuf[m_batchSize], 0, m_block_size - partial);
+		m_batchSize += m_block_size - partial;
+	}
+	int ret = flushBatch();
+	if (ret != 0) {
+		return ret;
+	}
+	assert(m_blocksWritten == m_blockPointers.size());
+
+	// Write the header and tables.
+	GCZ_Header gczHeader;
+	gczHeader.magic = cpu_to_le32(GCZ_MAGIC);
+	gczHeader.sub_type = cpu_to_le32(m_sub_type);
+	gczHeader.compressed_data_size = cpu_to_le64(m_compressed_size);
+	gczHeader.data_size = cpu_to_le64(LBA_TO_BYTES(m_lba_len));
+	gczHeader.block_size = cpu_to_le32(m_block_size);
+	gczHeader.num_blocks = cpu_to_le32(static_cast<uint32_t>(m_blockPointers.size()));
+
+#if SYS_BYTEORDER != SYS_LIL_ENDIAN
+	for (uint64_t &ptr : m_blockPointers) {
+		ptr = cpu_to_le64(ptr);
+	}
+	for (uint32_t &hash : m_hashes) {
+		hash = cpu_to_le32(hash);
+	}
+#endif /* SYS_BYTEORDER != SYS_LIL_ENDIAN */
+
+	ret = m_file->seeko(0, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	errno = 0;
+	if (m_file->write(&gczHeader, 1, sizeof(gczHeader)) != sizeof(gczHeader) ||
+	    m_file->write(m_blockPointers.data(), sizeof(uint64_t), m_blockPointers.size()) != m_blockPointers.size() ||
+	    m_file->write(m_hashes.data(), sizeof(uint32_t), m_hashes.size()) != m_hashes.size())
+	{
+		// Write error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	if (m_file->flush() != 0) {
+		// Flush error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
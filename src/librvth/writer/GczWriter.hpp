@@ -0,0 +1,91 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * GczWriter.hpp: GCZ disc image writer class.                             *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_WRITER_GCZWRITER_HPP__
+#define __RVTHTOOL_LIBRVTH_WRITER_GCZWRITER_HPP__
+
+#include "Writer.hpp"
+
+// C++ includes.
+#include <vector>
+
+class GczWriter : public Writer
+{
+	public:
+		/**
+		 * Create a GCZ writer for a disc image.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 */
+		GczWriter(RefFile *file, uint32_t lba_len);
+		virtual ~GczWriter();
+
+	private:
+		typedef Writer super;
+		DISABLE_COPY(GczWriter)
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Write data to the disc image.
+		 * Data is appended after the previously-written data.
+		 * @param ptr		[in] Write buffer.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int write(const void *ptr, uint32_t lba_len) final;
+
+		/**
+		 * Finish writing the disc image.
+		 * All LBAs must have been written.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int finish(void) final;
+
+	private:
+		/**
+		 * Compress the blocks in the batch buffer and write them.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int flushBatch(void);
+
+		/**
+		 * Worker function for flushBatch().
+		 * @param index		[in] Block index within the batch.
+		 * @param userdata	[in] GczWriter
+		 */
+		static void compressWorker(unsigned int index, void *userdata);
+
+	private:
+		// Number of blocks to compress in parallel. (8 MB)
+		#define GCZ_BATCH_BLOCKS 256
+
+		uint32_t m_block_size;		// Block size, in bytes
+		uint32_t m_sub_type;		// GCZ sub type
+		int64_t m_data_offset;		// Offset of the compressed data
+		uint64_t m_compressed_size;	// Compressed data written so far
+
+		// Block pointers and Adler-32 hashes. (host-endian)
+		std::vector<uint64_t> m_blockPointers;
+		std::vector<uint32_t> m_hashes;
+		uint32_t m_blocksWritten;
+
+		// Batch buffer. Blocks are compressed once it's full.
+		uint8_t *m_batchBuf;
+		uint32_t m_batchSize;		// Bytes in m_batchBuf
+
+		// Compressed blocks for the current batch.
+		struct CompressedBlock {
+			std::vector<uint8_t> data;	// Stored block data
+			bool uncompressed;		// True if stored uncompressed
+		};
+		std::vector<CompressedBlock> m_compBlocks;
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_WRITER_GCZWRITER_HPP__ */
@@ -0,0 +1,187 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * StreamWriter.cpp: Sequential disc image writer for pipes and stdout.    *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "config.librvth.h"
+#include "StreamWriter.hpp"
+#include "rvth.hpp"
+
+// For LBA_TO_BYTES()
+#include "nhcd_structs.h"
+
+// C includes.
+#include <sys/stat.h>
+#ifndef _WIN32
+# include <fcntl.h>
+# include <unistd.h>
+#endif /* !_WIN32 */
+#ifdef HAVE_VMSPLICE
+# include <sys/uio.h>
+#endif /* HAVE_VMSPLICE */
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+
+// C++ includes.
+#include <algorithm>
+
+// Zero buffer for empty blocks.
+// NOTE: This buffer must never be modified, since vmsplice()
+// passes references to its pages to the pipe.
+#define ZERO_BUF_SIZE 65536
+alignas(4096) static const uint8_t zero_buf[ZERO_BUF_SIZE] = {0};
+
+// Pipe buffer size to request. (1 MB)
+#define STREAM_PIPE_SIZE 1048576
+
+/**
+ * Create a stream writer for a disc image.
+ * @param file		RefFile*. (Must be writable.)
+ * @param lba_len	[in] Length of the disc image, in LBAs.
+ */
+StreamWriter::StreamWriter(RefFile *file, uint32_t lba_len)
+	: super(file, lba_len)
+	, m_isPipe(false)
+{
+	if (!isOpen()) {
+		// File wasn't opened.
+		return;
+	}
+
+#ifndef _WIN32
+	struct stat sb;
+	if (fstat(m_file->fd(), &sb) == 0 && S_ISFIFO(sb.st_mode)) {
+		m_isPipe = true;
+# ifdef F_SETPIPE_SZ
+		// Increase the pipe buffer size to reduce context switches.
+		// NOTE: Failure is not fatal.
+		fcntl(m_file->fd(), F_SETPIPE_SZ, STREAM_PIPE_SIZE);
+# endif /* F_SETPIPE_SZ */
+	}
+#endif /* !_WIN32 */
+}
+
+/**
+ * Write data to the file.
+ * @param ptr	[in] Data.
+ * @param size	[in] Size, in bytes.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int StreamWriter::writeData(const uint8_t *ptr, size_t size)
+{
+	errno = 0;
+	if (m_file->write(ptr, 1, size) != size) {
+		// Write error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
+
+/**
+ * Write zeroes to the file.
+ * @param size	[in] Size, in bytes.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int StreamWriter::writeZeroes(size_t size)
+{
+#ifdef HAVE_VMSPLICE
+	if (m_isPipe) {
+		// Splice the zero buffer into the pipe.
+		// This avoids copying the zeroes into the pipe buffer.
+		const int fd = m_file->fd();
+		while (size > 0) {
+			struct iovec iov;
+			iov.iov_base = const_cast<uint8_t*>(zero_buf);
+			iov.iov_len = std::min(size, static_cast<size_t>(ZERO_BUF_SIZE));
+			const ssize_t ret = vmsplice(fd, &iov, 1, 0);
+			if (ret < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				// vmsplice() isn't usable. Fall back to write().
+				m_isPipe = false;
+				break;
+			}
+			size -= ret;
+		}
+		if (size == 0) {
+			return 0;
+		}
+	}
+#endif /* HAVE_VMSPLICE */
+
+	while (size > 0) {
+		const size_t len = std::min(size, static_cast<size_t>(ZERO_BUF_SIZE));
+		int ret = writeData(zero_buf, len);
+		if (ret != 0) {
+			return ret;
+		}
+		size -= len;
+	}
+	return 0;
+}
+
+/**
+ * Write data to the disc image.
+ * Data is appended after the previously-written data.
+ * @param ptr		[in] Write buffer.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int StreamWriter::write(const void *ptr, uint32_t lba_len)
+{
+	assert(m_lba_pos + lba_len <= m_lba_len);
+	if (lba_len > m_lba_len - m_lba_pos) {
+		// Out of range.
+		return -ERANGE;
+	}
+
+	// Write runs of data and runs of empty blocks.
+	const uint8_t *const ptr8 = static_cast<const uint8_t*>(ptr);
+	const size_t size = LBA_TO_BYTES(lba_len);
+	const unsigned int block_size = (size % 4096 == 0 ? 4096 : LBA_SIZE);
+	size_t pos = 0;
+	while (pos < size) {
+		const bool empty = RvtH::isBlockEmpty(&ptr8[pos], block_size);
+		size_t run_end = pos + block_size;
+		while (run_end < size && RvtH::isBlockEmpty(&ptr8[run_end], block_size) == empty) {
+			run_end += block_size;
+		}
+
+		int ret = (empty
+			? writeZeroes(run_end - pos)
+			: writeData(&ptr8[pos], run_end - pos));
+		if (ret != 0) {
+			return ret;
+		}
+		pos = run_end;
+	}
+
+	m_lba_pos += lba_len;
+	return 0;
+}
+
+/**
+ * Finish writing the disc image.
+ * All LBAs must have been written.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int StreamWriter::finish(void)
+{
+	assert(m_lba_pos == m_lba_len);
+	if (m_lba_pos != m_lba_len) {
+		// Image is incomplete.
+		return -EINVAL;
+	}
+
+	if (m_file->flush() != 0) {
+		// Flush error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
@@ -0,0 +1,74 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * StreamWriter.hpp: Sequential disc image writer for pipes and stdout.    *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_WRITER_STREAMWRITER_HPP__
+#define __RVTHTOOL_LIBRVTH_WRITER_STREAMWRITER_HPP__
+
+#include "Writer.hpp"
+
+/**
+ * Plain disc image writer for non-seekable files.
+ *
+ * Every LBA is written in order, including empty LBAs,
+ * since holes can't be seeked over. If the file is a pipe,
+ * empty blocks are spliced from a shared zero buffer.
+ */
+class StreamWriter : public Writer
+{
+	public:
+		/**
+		 * Create a stream writer for a disc image.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 */
+		StreamWriter(RefFile *file, uint32_t lba_len);
+
+	private:
+		typedef Writer super;
+		DISABLE_COPY(StreamWriter)
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Write data to the disc image.
+		 * Data is appended after the previously-written data.
+		 * @param ptr		[in] Write buffer.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int write(const void *ptr, uint32_t lba_len) final;
+
+		/**
+		 * Finish writing the disc image.
+		 * All LBAs must have been written.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int finish(void) final;
+
+	private:
+		/**
+		 * Write data to the file.
+		 * @param ptr	[in] Data.
+		 * @param size	[in] Size, in bytes.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int writeData(const uint8_t *ptr, size_t size);
+
+		/**
+		 * Write zeroes to the file.
+		 * @param size	[in] Size, in bytes.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int writeZeroes(size_t size);
+
+	private:
+		bool m_isPipe;		// True if the file is a pipe.
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_WRITER_STREAMWRITER_HPP__ */
@@ -0,0 +1,256 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * WbfsWriter.cpp: WBFS disc image writer class.                           *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "WbfsWriter.hpp"
+#include "reader/libwbfs.h"
+#include "byteswap.h"
+#include "rvth.hpp"
+
+// For LBA_TO_BYTES()
+#include "nhcd_structs.h"
+
+// C includes.
+#include <stdlib.h>
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+// C++ includes.
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+// WBFS magic.
+static const char WBFS_MAGIC[4] = {'W','B','F','S'};
+
+// Wii sector size. (32 KB)
+#define WII_SEC_SZ_S 15
+// Maximum number of Wii sectors per disc. (dual-layer)
+#define WII_N_SEC_PER_DISC (143432*2)
+// Maximum number of WBFS sectors per disc.
+#define WBFS_N_SEC_PER_DISC (WII_N_SEC_PER_DISC >> (WBFS_WRITER_WBFS_SEC_SZ_S - WII_SEC_SZ_S))
+
+#define ALIGN_HD_SEC(x) (((x)+WBFS_WRITER_HD_SEC_SZ-1)&(~(size_t)(WBFS_WRITER_HD_SEC_SZ-1)))
+
+/**
+ * Create a WBFS writer for a disc image.
+ * @param file		RefFile*. (Must be writable.)
+ * @param lba_len	[in] Length of the disc image, in LBAs.
+ */
+WbfsWriter::WbfsWriter(RefFile *file, uint32_t lba_len)
+	: super(file, lba_len)
+	, m_num_blocks(0)
+	, m_blockIdx(0)
+	, m_physBlocks(1)	// Block 0 is the WBFS header.
+	, m_blockBuf(nullptr)
+	, m_blockBufSize(0)
+{
+	if (!isOpen()) {
+		// File wasn't opened.
+		return;
+	}
+
+	const uint64_t data_size = LBA_TO_BYTES(lba_len);
+	m_num_blocks = static_cast<uint32_t>(
+		(data_size + WBFS_WRITER_WBFS_SEC_SZ - 1) / WBFS_WRITER_WBFS_SEC_SZ);
+	if (m_num_blocks > WBFS_N_SEC_PER_DISC) {
+		// Image is too big.
+		m_file->unref();
+		m_file = nullptr;
+		errno = EFBIG;
+		return;
+	}
+	m_wlba_table.resize(WBFS_N_SEC_PER_DISC);
+	memset(m_discHeader, 0, sizeof(m_discHeader));
+
+	m_blockBuf = static_cast<uint8_t*>(malloc(WBFS_WRITER_WBFS_SEC_SZ));
+	if (!m_blockBuf) {
+		// Error allocating memory.
+		m_file->unref();
+		m_file = nullptr;
+		errno = ENOMEM;
+		return;
+	}
+}
+
+WbfsWriter::~WbfsWriter()
+{
+	free(m_blockBuf);
+
+	// Superclass will unreference the file.
+}
+
+/**
+ * Write the block in the block buffer.
+ * Empty blocks are skipped, except for the last block.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int WbfsWriter::flushBlock(void)
+{
+	assert(m_blockBufSize == WBFS_WRITER_WBFS_SEC_SZ);
+	assert(m_blockIdx < m_num_blocks);
+
+	if (m_blockIdx == 0) {
+		// Save a copy of the disc header.
+		memcpy(m_discHeader, m_blockBuf, sizeof(m_discHeader));
+	}
+
+	// WbfsReader determines the image size using the last
+	// used block, so the last block must always be written.
+	if (m_blockIdx + 1 < m_num_blocks &&
+	    RvtH::isBlockEmpty(m_blockBuf, WBFS_WRITER_WBFS_SEC_SZ))
+	{
+		// Empty block. Don't write it.
+		m_wlba_table[m_blockIdx] = 0;
+	} else {
+		// Physical blocks are allocated sequentially.
+		int ret = m_file->seeko((int64_t)m_physBlocks * WBFS_WRITER_WBFS_SEC_SZ, SEEK_SET);
+		if (ret != 0) {
+			// Seek error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		errno = 0;
+		if (m_file->write(m_blockBuf, 1, WBFS_WRITER_WBFS_SEC_SZ) != WBFS_WRITER_WBFS_SEC_SZ) {
+			// Write error.
+			return (errno != 0 ? -errno : -EIO);
+		}
+		m_wlba_table[m_blockIdx] = m_physBlocks;
+		m_physBlocks++;
+	}
+
+	m_blockIdx++;
+	m_blockBufSize = 0;
+	return 0;
+}
+
+/**
+ * Write data to the disc image.
+ * Data is appended after the previously-written data.
+ * @param ptr		[in] Write buffer.
+ * @param lba_len	[in] Length, in LBAs.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int WbfsWriter::write(const void *ptr, uint32_t lba_len)
+{
+	assert(m_lba_pos + lba_len <= m_lba_len);
+	if (lba_len > m_lba_len - m_lba_pos) {
+		// Out of range.
+		return -ERANGE;
+	}
+
+	const uint8_t *ptr8 = static_cast<const uint8_t*>(ptr);
+	size_t size_left = LBA_TO_BYTES(lba_len);
+	while (size_left > 0) {
+		const size_t len = std::min(size_left,
+			static_cast<size_t>(WBFS_WRITER_WBFS_SEC_SZ - m_blockBufSize));
+		memcpy(&m_blockBuf[m_blockBufSize], ptr8, len);
+		m_blockBufSize += static_cast<uint32_t>(len);
+		ptr8 += len;
+		size_left -= len;
+
+		if (m_blockBufSize == WBFS_WRITER_WBFS_SEC_SZ) {
+			// Block is full.
+			int ret = flushBlock();
+			if (ret != 0) {
+				return ret;
+			}
+		}
+	}
+
+	m_lba_pos += lba_len;
+	return 0;
+}
+
+/**
+ * Finish writing the disc image.
+ * All LBAs must have been written.
+ * @return Error code. (If negative, POSIX error.)
+ */
+int WbfsWriter::finish(void)
+{
+	assert(m_lba_pos == m_lba_len);
+	if (m_lba_pos != m_lba_len) {
+		// Image is incomplete.
+		return -EINVAL;
+	}
+
+	// Zero-pad the last block.
+	int ret;
+	if (m_blockBufSize != 0) {
+		memset(&m_blockBuf[m_blockBufSize], 0, WBFS_WRITER_WBFS_SEC_SZ - m_blockBufSize);
+		m_blockBufSize = WBFS_WRITER_WBFS_SEC_SZ;
+		ret = flushBlock();
+		if (ret != 0) {
+			return ret;
+		}
+	}
+	assert(m_blockIdx == m_num_blocks);
+
+	// Number of WBFS sectors in the "partition".
+	// This must be a multiple of 32 for the free blocks table.
+	// (libwbfs: n_wbfs_sec = n_hd_sec >> (wbfs_sec_sz_s - hd_sec_sz_s))
+	const uint32_t n_wbfs_sec = (m_physBlocks + 31U) & ~31U;
+	const uint32_t n_hd_sec = n_wbfs_sec << (WBFS_WRITER_WBFS_SEC_SZ_S - WBFS_WRITER_HD_SEC_SZ_S);
+
+	// Build the first WBFS sector:
+	// - wbfs_head_t
+	// - wbfs_disc_info_t for disc 0
+	// - Free blocks table at the end of the sector
+	const unsigned int freeblks_sz = n_wbfs_sec / 8;
+	// NOTE: libwbfs reads the table starting at freeblks_lba.
+	// (freeblks_lba = (wbfs_sec_sz - n_wbfs_sec/8) >> hd_sec_sz_s)
+	const unsigned int freeblks_offset = (WBFS_WRITER_WBFS_SEC_SZ - freeblks_sz) &
+		~(WBFS_WRITER_HD_SEC_SZ - 1);
+	vector<uint8_t> hdrBlock(WBFS_WRITER_WBFS_SEC_SZ);
+
+	wbfs_head_t *const head = reinterpret_cast<wbfs_head_t*>(hdrBlock.data());
+	memcpy(&head->magic, WBFS_MAGIC, sizeof(WBFS_MAGIC));
+	head->n_hd_sec = cpu_to_be32(n_hd_sec);
+	head->hd_sec_sz_s = WBFS_WRITER_HD_SEC_SZ_S;
+	head->wbfs_sec_sz_s = WBFS_WRITER_WBFS_SEC_SZ_S;
+	head->disc_table[0] = 1;
+
+	wbfs_disc_info_t *const discInfo = reinterpret_cast<wbfs_disc_info_t*>(
+		&hdrBlock[WBFS_WRITER_HD_SEC_SZ]);
+	memcpy(discInfo->disc_header_copy, m_discHeader, sizeof(discInfo->disc_header_copy));
+	for (unsigned int i = 0; i < WBFS_N_SEC_PER_DISC; i++) {
+		discInfo->wlba_table[i] = cpu_to_be16(m_wlba_table[i]);
+	}
+	assert(WBFS_WRITER_HD_SEC_SZ + ALIGN_HD_SEC(sizeof(wbfs_disc_info_t) + WBFS_N_SEC_PER_DISC*2)
+		<= freeblks_offset);
+
+	// Free blocks table: One bit per WBFS sector, starting at
+	// sector 1, stored as big-endian 32-bit words. 1 == free.
+	uint32_t *const freeblks = reinterpret_cast<uint32_t*>(&hdrBlock[freeblks_offset]);
+	for (uint32_t blk = m_physBlocks; blk < n_wbfs_sec; blk++) {
+		// NOTE: Sector n is bit (n-1).
+		const uint32_t bit = blk - 1;
+		freeblks[bit / 32] |= (1U << (bit % 32));
+	}
+	for (unsigned int i = 0; i < freeblks_sz / 4; i++) {
+		freeblks[i] = cpu_to_be32(freeblks[i]);
+	}
+
+	ret = m_file->seeko(0, SEEK_SET);
+	if (ret != 0) {
+		// Seek error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	errno = 0;
+	if (m_file->write(hdrBlock.data(), 1, hdrBlock.size()) != hdrBlock.size()) {
+		// Write error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	if (m_file->flush() != 0) {
+		// Flush error.
+		return (errno != 0 ? -errno : -EIO);
+	}
+	return 0;
+}
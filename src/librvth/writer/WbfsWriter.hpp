@@ -0,0 +1,87 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * WbfsWriter.hpp: WBFS disc image writer class.                           *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_WRITER_WBFSWRITER_HPP__
+#define __RVTHTOOL_LIBRVTH_WRITER_WBFSWRITER_HPP__
+
+#include "Writer.hpp"
+
+// C++ includes.
+#include <vector>
+
+/**
+ * WBFS disc image writer.
+ * This creates a WBFS file containing a single disc.
+ */
+class WbfsWriter : public Writer
+{
+	public:
+		/**
+		 * Create a WBFS writer for a disc image.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 */
+		WbfsWriter(RefFile *file, uint32_t lba_len);
+		virtual ~WbfsWriter();
+
+	private:
+		typedef Writer super;
+		DISABLE_COPY(WbfsWriter)
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Write data to the disc image.
+		 * Data is appended after the previously-written data.
+		 * @param ptr		[in] Write buffer.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int write(const void *ptr, uint32_t lba_len) final;
+
+		/**
+		 * Finish writing the disc image.
+		 * All LBAs must have been written.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int finish(void) final;
+
+	private:
+		/**
+		 * Write the block in the block buffer.
+		 * Empty blocks are skipped, except for the last block.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		int flushBlock(void);
+
+	private:
+		// WBFS parameters.
+		// NOTE: Only 512-byte HDD sectors and 2 MB WBFS sectors
+		// are supported when writing.
+		#define WBFS_WRITER_HD_SEC_SZ_S 9
+		#define WBFS_WRITER_HD_SEC_SZ (1U << WBFS_WRITER_HD_SEC_SZ_S)
+		#define WBFS_WRITER_WBFS_SEC_SZ_S 21
+		#define WBFS_WRITER_WBFS_SEC_SZ (1U << WBFS_WRITER_WBFS_SEC_SZ_S)
+
+		uint32_t m_num_blocks;		// Number of logical blocks
+		uint32_t m_blockIdx;		// Current logical block
+		uint16_t m_physBlocks;		// Physical blocks used, including the header block
+
+		// Copy of the disc header.
+		uint8_t m_discHeader[0x100];
+
+		// wlba table. (host-endian)
+		std::vector<uint16_t> m_wlba_table;
+
+		// Block buffer.
+		uint8_t *m_blockBuf;
+		uint32_t m_blockBufSize;	// Bytes in m_blockBuf
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_WRITER_WBFSWRITER_HPP__ */
@@ -0,0 +1,95 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * Writer.cpp: Disc image writer base class.                               *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "Writer.hpp"
+#include "GczWriter.hpp"
+#include "CisoWriter.hpp"
+#include "WbfsWriter.hpp"
+#include "StreamWriter.hpp"
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+
+Writer::Writer(RefFile *file, uint32_t lba_len)
+	: m_file(nullptr)
+	, m_lba_len(lba_len)
+	, m_lba_pos(0)
+{
+	// Validate parameters.
+	assert(file != nullptr);
+	assert(lba_len != 0);
+	if (!file || lba_len == 0) {
+		// Invalid parameters.
+		errno = EINVAL;
+		return;
+	} else if (!file->isWritable()) {
+		// File isn't writable.
+		errno = EROFS;
+		return;
+	}
+
+	// ref() the file.
+	m_file = file->ref();
+}
+
+Writer::~Writer()
+{
+	if (m_file) {
+		m_file->unref();
+	}
+}
+
+/**
+ * Create a Writer object for a disc image.
+ * @param file		RefFile*. (Must be writable.)
+ * @param format	[in] Disc image format. (Must not be RVTH_ExtractFormat_GCM, unless file is a stream.)
+ * @param lba_len	[in] Length of the disc image, in LBAs.
+ * @return Writer*, or NULL on error.
+ */
+Writer *Writer::create(RefFile *file, RvtH_ExtractFormat_e format, uint32_t lba_len)
+{
+	Writer *writer;
+	if (file && file->isStream()) {
+		// Streams can't be seeked, so only plain
+		// disc images can be written.
+		if (format != RVTH_ExtractFormat_GCM) {
+			errno = ESPIPE;
+			return nullptr;
+		}
+		writer = new StreamWriter(file, lba_len);
+	} else {
+		switch (format) {
+			case RVTH_ExtractFormat_GCZ:
+				writer = new GczWriter(file, lba_len);
+				break;
+			case RVTH_ExtractFormat_CISO:
+				writer = new CisoWriter(file, lba_len);
+				break;
+			case RVTH_ExtractFormat_WBFS:
+				writer = new WbfsWriter(file, lba_len);
+				break;
+
+			case RVTH_ExtractFormat_GCM:
+			default:
+				// Plain disc images are written using Reader.
+				assert(!"Unsupported Writer format.");
+				errno = EINVAL;
+				return nullptr;
+		}
+	}
+
+	if (!writer->isOpen()) {
+		// Error opening the writer.
+		const int err = errno;
+		delete writer;
+		errno = (err != 0 ? err : EIO);
+		return nullptr;
+	}
+	return writer;
+}
@@ -0,0 +1,100 @@
+/***************************************************************************
+ * RVT-H Tool (librvth)                                                    *
+ * Writer.hpp: Disc image writer base class.                               *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBRVTH_WRITER_WRITER_HPP__
+#define __RVTHTOOL_LIBRVTH_WRITER_WRITER_HPP__
+
+#include "libwiicrypto/common.h"
+#include "RefFile.hpp"
+#include "rvth_enums.h"
+
+#include <stdint.h>
+
+/**
+ * Disc image writer for compressed and compacted formats.
+ *
+ * Unlike Reader, data must be written sequentially, starting
+ * at LBA 0. finish() must be called after the entire image
+ * has been written in order to write the format's headers.
+ */
+class Writer
+{
+	protected:
+		/**
+		 * Writer base class.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 */
+		Writer(RefFile *file, uint32_t lba_len);
+	public:
+		virtual ~Writer();
+
+	private:
+		DISABLE_COPY(Writer)
+
+	public:
+		/**
+		 * Create a Writer object for a disc image.
+		 * @param file		RefFile*. (Must be writable.)
+		 * @param format	[in] Disc image format. (Must not be RVTH_ExtractFormat_GCM, unless file is a stream.)
+		 * @param lba_len	[in] Length of the disc image, in LBAs.
+		 * @return Writer*, or NULL on error.
+		 */
+		static Writer *create(RefFile *file, RvtH_ExtractFormat_e format, uint32_t lba_len);
+
+	public:
+		/**
+		 * Is the Writer object open?
+		 * @return True if open; false if not.
+		 */
+		inline bool isOpen(void) const
+		{
+			return (m_file != nullptr);
+		}
+
+	public:
+		/** I/O functions **/
+
+		/**
+		 * Write data to the disc image.
+		 * Data is appended after the previously-written data.
+		 * @param ptr		[in] Write buffer.
+		 * @param lba_len	[in] Length, in LBAs.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		virtual int write(const void *ptr, uint32_t lba_len) = 0;
+
+		/**
+		 * Finish writing the disc image.
+		 * All LBAs must have been written.
+		 * @return Error code. (If negative, POSIX error.)
+		 */
+		virtual int finish(void) = 0;
+
+	public:
+		/** Accessors **/
+
+		/**
+		 * Get the length of the disc image, in LBAs.
+		 * @return Length, in LBAs.
+		 */
+		inline uint32_t lba_len(void) const { return m_lba_len; }
+
+		/**
+		 * Get the number of LBAs written so far.
+		 * @return Number of LBAs written.
+		 */
+		inline uint32_t lba_pos(void) const { return m_lba_pos; }
+
+	protected:
+		RefFile *m_file;		// Disc image file
+		uint32_t m_lba_len;		// Length of image, in LBAs
+		uint32_t m_lba_pos;		// Number of LBAs written
+};
+
+#endif /* __RVTHTOOL_LIBRVTH_WRITER_WRITER_HPP__ */
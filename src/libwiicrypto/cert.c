@@ -576,7 +576,5 @@ int cert_realsign_ticketOrTMD(uint8_t *data, size_t size, const RSA2048PrivateKe
 	}
 
 	// Sign the TMD.
-	// TODO: Check for errors.
-	rsaw_rsa2048_sign(sig->sig, sizeof(sig->sig), key, hash, hash_size, doSHA256);
-	return 0;
+	return rsaw_rsa2048_sign(sig->sig, sizeof(sig->sig), key, hash, hash_size, doSHA256);
 }
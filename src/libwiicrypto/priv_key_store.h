@@ -31,6 +31,9 @@ extern "C" {
 // These private keys consist of p, q, a, b, and c.
 // Technically, only p and q are important, but calculating
 // a, b, and c is a pain.
+// NOTE: rsaw_rsa2048_sign() calculates a, b, and c the first
+// time a key is used and caches the result for the lifetime
+// of the process.
 
 extern const RSA2048PrivateKey rvth_privkey_RVL_dpki_ticket;
 extern const RSA2048PrivateKey rvth_privkey_RVL_dpki_tmd;
@@ -42,6 +42,10 @@ int rsaw_decrypt_signature(uint8_t *buf, const uint8_t *modulus,
 
 /**
  * Encrypt data using an RSA public key.
+ *
+ * The random number generator used for padding is seeded
+ * once per process. This function is thread-safe.
+ *
  * @param buf			[out] Output buffer.
  * @param buf_size		[in] Size of `buf`.
  * @param modulus		[in] Public key modulus.
@@ -72,6 +76,10 @@ typedef struct _RSA2048PrivateKey {
 
 /**
  * Create an RSA-2048 signature using an RSA private key.
+ *
+ * Prepared private keys are cached for the lifetime of the process.
+ * This function is thread-safe.
+ *
  * @param buf			[out] Output buffer.
  * @param buf_size		[in] Size of `buf`.
  * @param priv_key_data		[in] RSA2048PrivateKey struct.
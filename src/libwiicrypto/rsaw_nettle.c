@@ -19,6 +19,8 @@
  ***************************************************************************/
 
 #include "rsaw.h"
+#include "threadw.h"
+#include "common.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -42,6 +44,27 @@
 // Size of the buffer for random number generation.
 #define RANDOM_BUFFER_SIZE 1024
 
+// Process-wide random number generator.
+// Seeded once on first use; access is serialized by rng_mutex.
+static struct yarrow256_ctx rng_yarrow;
+static threadw_mutex_t rng_mutex;
+static int rng_err;	// Negative POSIX error code if seeding failed.
+static threadw_once_t rng_once = THREADW_ONCE_INIT;
+
+// Cache of prepared RSA private keys.
+// Preparing a key requires several bignum inversions, so the
+// prepared keys are kept for the lifetime of the process.
+// Once an entry has been added, it is never modified, so it
+// can be used for signing without holding priv_key_mutex.
+typedef struct _PrivKeyCacheEntry {
+	RSA2048PrivateKey data;		// Original key data.
+	struct rsa_private_key key;	// Prepared key.
+} PrivKeyCacheEntry;
+#define PRIV_KEY_CACHE_SIZE 8
+static PrivKeyCacheEntry priv_key_cache[PRIV_KEY_CACHE_SIZE];
+static unsigned int priv_key_cache_count;
+static threadw_mutex_t priv_key_mutex;
+
 /**
  * Decrypt an RSA signature.
  * @param buf		[out] Output buffer. (Must be `size` bytes.)
@@ -202,6 +225,31 @@ end:
 	return -err;
 }
 
+/**
+ * Initialize the process-wide RNG and key cache.
+ * Called by threadw_once().
+ */
+static void rsaw_init_once(void)
+{
+	threadw_mutex_init(&rng_mutex);
+	threadw_mutex_init(&priv_key_mutex);
+	rng_err = init_random(&rng_yarrow);
+}
+
+/**
+ * Get random data from the process-wide RNG.
+ * This function is thread-safe.
+ * @param ctx		[in] Yarrow context. (Must be &rng_yarrow.)
+ * @param length	[in] Number of bytes to generate.
+ * @param dst		[out] Output buffer.
+ */
+static void rsaw_random(void *ctx, size_t length, uint8_t *dst)
+{
+	threadw_mutex_lock(&rng_mutex);
+	yarrow256_random((struct yarrow256_ctx*)ctx, length, dst);
+	threadw_mutex_unlock(&rng_mutex);
+}
+
 /**
  * Encrypt data using an RSA public key.
  * @param buf			[out] Output buffer.
@@ -219,7 +267,6 @@ int rsaw_encrypt(uint8_t *buf, size_t buf_size,
 	const uint8_t *cleartext, size_t cleartext_size)
 {
 	struct rsa_public_key key;
-	struct yarrow256_ctx yarrow;
 
 	mpz_t ciphertext;
 	int ret = 0;
@@ -247,7 +294,11 @@ int rsaw_encrypt(uint8_t *buf, size_t buf_size,
 	mpz_init(ciphertext);
 
 	// Initialize the random number generator.
-	ret = init_random(&yarrow);
+	// This is only done once per process.
+	ret = threadw_once(&rng_once, rsaw_init_once);
+	if (ret == 0) {
+		ret = rng_err;
+	}
 	if (ret != 0) {
 		// Error initializing the random number generator.
 		goto end;
@@ -263,7 +314,7 @@ int rsaw_encrypt(uint8_t *buf, size_t buf_size,
 	}
 
 	// Encrypt the data.
-	if (!rsa_encrypt(&key, &yarrow, (nettle_random_func*)yarrow256_random,
+	if (!rsa_encrypt(&key, &rng_yarrow, (nettle_random_func*)rsaw_random,
 	    cleartext_size, cleartext, ciphertext))
 	{
 		// Error encrypting the data.
@@ -293,6 +344,103 @@ end:
 	return ret;
 }
 
+/**
+ * Prepare an RSA-2048 private key.
+ * @param key		[out] Initialized RSA private key.
+ * @param priv_key_data	[in] RSA2048PrivateKey struct.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int prepare_private_key(struct rsa_private_key *key,
+	const RSA2048PrivateKey *priv_key_data)
+{
+	struct {
+		mpz_t e;	// e
+		mpz_t p1;	// p-1
+		mpz_t q1;	// q-1
+		mpz_t phi;	// (p-1)*(q-1)
+		mpz_t d;	// 1 / (e mod phi)
+	} bncalc;
+	int ret = 0;
+
+	// Initialize the RSA private key.
+	rsa_private_key_init(key);
+	mpz_import(key->p, 1, 1, sizeof(priv_key_data->p), 1, 0, priv_key_data->p);
+	mpz_import(key->q, 1, 1, sizeof(priv_key_data->q), 1, 0, priv_key_data->q);
+
+	// Initialize the temporary bignums.
+	mpz_init(bncalc.e);
+	mpz_init(bncalc.p1);
+	mpz_init(bncalc.q1);
+	mpz_init(bncalc.phi);
+	mpz_init(bncalc.d);
+
+	// Calculate a, b, and c.
+	mpz_sub_ui(bncalc.p1, key->p, 1);
+	mpz_sub_ui(bncalc.q1, key->q, 1);
+	mpz_mul(bncalc.phi, bncalc.p1, bncalc.q1);
+	mpz_set_ui(bncalc.e, priv_key_data->e);
+	mpz_invert(bncalc.d, bncalc.e, bncalc.phi);
+	// a = d % (p - 1)
+	mpz_fdiv_r(key->a, bncalc.d, bncalc.p1);
+	// b = d % (q - 1)
+	mpz_fdiv_r(key->b, bncalc.d, bncalc.q1);
+	// c = q^{-1} (mod p)
+	mpz_invert(key->c, key->q, key->p);
+
+	if (!rsa_private_key_prepare(key)) {
+		// Error importing the private key.
+		rsa_private_key_clear(key);
+		ret = -EIO;
+	}
+
+	mpz_clear(bncalc.e);
+	mpz_clear(bncalc.p1);
+	mpz_clear(bncalc.q1);
+	mpz_clear(bncalc.phi);
+	mpz_clear(bncalc.d);
+	return ret;
+}
+
+/**
+ * Get a prepared RSA-2048 private key from the key cache.
+ * If the key isn't cached yet, it will be prepared and added.
+ * This function is thread-safe.
+ * @param priv_key_data	[in] RSA2048PrivateKey struct.
+ * @return Prepared private key, or NULL if the cache is full or an error occurred.
+ */
+static const struct rsa_private_key *get_cached_private_key(const RSA2048PrivateKey *priv_key_data)
+{
+	const struct rsa_private_key *ret = NULL;
+	unsigned int i;
+
+	if (threadw_once(&rng_once, rsaw_init_once) != 0) {
+		// Unable to initialize the key cache.
+		return NULL;
+	}
+
+	threadw_mutex_lock(&priv_key_mutex);
+	for (i = 0; i < priv_key_cache_count; i++) {
+		if (!memcmp(&priv_key_cache[i].data, priv_key_data, sizeof(*priv_key_data))) {
+			// Found the key.
+			ret = &priv_key_cache[i].key;
+			break;
+		}
+	}
+
+	if (!ret && priv_key_cache_count < PRIV_KEY_CACHE_SIZE) {
+		// Key isn't cached yet. Prepare it.
+		PrivKeyCacheEntry *const entry = &priv_key_cache[priv_key_cache_count];
+		if (prepare_private_key(&entry->key, priv_key_data) == 0) {
+			memcpy(&entry->data, priv_key_data, sizeof(entry->data));
+			priv_key_cache_count++;
+			ret = &entry->key;
+		}
+	}
+	threadw_mutex_unlock(&priv_key_mutex);
+
+	return ret;
+}
+
 /**
  * Create an RSA-2048 signature using an RSA private key.
  * @param buf			[out] Output buffer.
@@ -308,14 +456,9 @@ int rsaw_rsa2048_sign(uint8_t *buf, size_t buf_size,
 	const uint8_t *pHash, size_t hash_size,
 	int doSHA256)
 {
-	struct rsa_private_key key;
-	struct {
-		mpz_t e;	// e
-		mpz_t p1;	// p-1
-		mpz_t q1;	// q-1
-		mpz_t phi;	// (p-1)*(q-1)
-		mpz_t d;	// 1 / (e mod phi)
-	} bncalc;
+	const struct rsa_private_key *key;
+	struct rsa_private_key tmp_key;
+	bool is_tmp_key = false;
 	mpz_t signature;
 	int ret = 0;
 
@@ -325,7 +468,7 @@ int rsaw_rsa2048_sign(uint8_t *buf, size_t buf_size,
 	assert(priv_key_data != NULL);
 	assert(pHash != NULL);
 
-	if (!buf || buf_size == 0 || buf_size < 256 || !pHash) {
+	if (!buf || buf_size == 0 || buf_size < 256 || !priv_key_data || !pHash) {
 		// Invalid parameters.
 		errno = EINVAL;
 		return -EINVAL;
@@ -345,46 +488,30 @@ int rsaw_rsa2048_sign(uint8_t *buf, size_t buf_size,
 		}
 	}
 
-	// Initialize the temporary bignums.
-	mpz_init(bncalc.e);
-	mpz_init(bncalc.p1);
-	mpz_init(bncalc.q1);
-	mpz_init(bncalc.phi);
-	mpz_init(bncalc.d);
-
-	// Initialize the RSA private key.
-	rsa_private_key_init(&key);
-	mpz_import(key.p, 1, 1, sizeof(priv_key_data->p), 1, 0, priv_key_data->p);
-	mpz_import(key.q, 1, 1, sizeof(priv_key_data->q), 1, 0, priv_key_data->q);
-	if (!rsa_private_key_prepare(&key)) {
-		// Error importing the private key.
-		errno = EIO;
-		return -EIO;
+	// Get the prepared private key.
+	key = get_cached_private_key(priv_key_data);
+	if (!key) {
+		// Key cache is full. Prepare a temporary key.
+		ret = prepare_private_key(&tmp_key, priv_key_data);
+		if (ret != 0) {
+			// Error importing the private key.
+			errno = -ret;
+			return ret;
+		}
+		key = &tmp_key;
+		is_tmp_key = true;
 	}
 
-	// Calculate a, b, and c.
-	mpz_sub_ui(bncalc.p1, key.p, 1);
-	mpz_sub_ui(bncalc.q1, key.q, 1);
-	mpz_mul(bncalc.phi, bncalc.p1, bncalc.q1);
-	mpz_set_ui(bncalc.e, priv_key_data->e);
-	mpz_invert(bncalc.d, bncalc.e, bncalc.phi);
-	// a = d % (p - 1)
-	mpz_fdiv_r(key.a, bncalc.d, bncalc.p1);
-	// b = d % (q - 1)
-	mpz_fdiv_r(key.b, bncalc.d, bncalc.q1);
-	// c = q^{-1} (mod p)
-	mpz_invert(key.c, key.q, key.p);
-
 	// Create the signature.
 	mpz_init(signature);
 	if (!doSHA256) {
-		if (!rsa_sha1_sign_digest(&key, pHash, signature)) {
+		if (!rsa_sha1_sign_digest(key, pHash, signature)) {
 			// Error signing the SHA-1 hash.
 			ret = -EIO;
 			goto end;
 		}
 	} else {
-		if (!rsa_sha256_sign_digest(&key, pHash, signature)) {
+		if (!rsa_sha256_sign_digest(key, pHash, signature)) {
 			// Error signing the SHA-256 hash.
 			ret = -EIO;
 			goto end;
@@ -405,13 +532,10 @@ int rsaw_rsa2048_sign(uint8_t *buf, size_t buf_size,
 	mpz_export(buf, NULL, 1, buf_size, 1, 0, signature);
 
 end:
-	rsa_private_key_clear(&key);
+	if (is_tmp_key) {
+		rsa_private_key_clear(&tmp_key);
+	}
 	mpz_clear(signature);
-	mpz_clear(bncalc.e);
-	mpz_clear(bncalc.p1);
-	mpz_clear(bncalc.q1);
-	mpz_clear(bncalc.phi);
-	mpz_clear(bncalc.d);
 	if (ret != 0) {
 		errno = -ret;
 	}
@@ -0,0 +1,392 @@
+/***************************************************************************
+ * RVT-H Tool (libwiicrypto)                                               *
+ * threadw.c: Threading wrapper functions.                                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "threadw.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+# include <process.h>
+#else /* !_WIN32 */
+# include <unistd.h>
+#endif /* _WIN32 */
+
+// Maximum number of worker threads for threadw_parallel_for().
+#define THREADW_MAX_THREADS 64
+
+/**
+ * Run a function exactly once, even if called from multiple threads.
+ * All callers will block until the function has finished running.
+ * @param once_control	[in/out] Once control variable. (Initialize with THREADW_ONCE_INIT.)
+ * @param init_routine	[in] Initialization function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_once(threadw_once_t *once_control, void (*init_routine)(void))
+{
+	assert(once_control != NULL);
+	assert(init_routine != NULL);
+
+#ifdef _WIN32
+	switch (InterlockedCompareExchange(once_control, 1, 0)) {
+		case 0:
+			// We're the first caller.
+			init_routine();
+			InterlockedExchange(once_control, 2);
+			break;
+		case 1:
+			// Another thread is running the initialization function.
+			do {
+				Sleep(0);
+			} while (*once_control != 2);
+			break;
+		default:
+			// Already initialized.
+			break;
+	}
+	return 0;
+#else /* !_WIN32 */
+	return -pthread_once(once_control, init_routine);
+#endif /* _WIN32 */
+}
+
+/**
+ * Initialize a mutex.
+ * @param mutex	[out] Mutex.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_mutex_init(threadw_mutex_t *mutex)
+{
+	assert(mutex != NULL);
+#ifdef _WIN32
+	InitializeCriticalSection(mutex);
+	return 0;
+#else /* !_WIN32 */
+	return -pthread_mutex_init(mutex, NULL);
+#endif /* _WIN32 */
+}
+
+/**
+ * Destroy a mutex.
+ * @param mutex	[in] Mutex.
+ */
+void threadw_mutex_destroy(threadw_mutex_t *mutex)
+{
+	assert(mutex != NULL);
+#ifdef _WIN32
+	DeleteCriticalSection(mutex);
+#else /* !_WIN32 */
+	pthread_mutex_destroy(mutex);
+#endif /* _WIN32 */
+}
+
+/**
+ * Initialize an auto-reset event.
+ * The event is initially not signaled.
+ * @param event	[out] Event.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_event_init(threadw_event_t *event)
+{
+	assert(event != NULL);
+#ifdef _WIN32
+	*event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	return (*event != NULL ? 0 : -ENOMEM);
+#else /* !_WIN32 */
+	int ret = pthread_mutex_init(&event->mutex, NULL);
+	if (ret != 0) {
+		return -ret;
+	}
+	ret = pthread_cond_init(&event->cond, NULL);
+	if (ret != 0) {
+		pthread_mutex_destroy(&event->mutex);
+		return -ret;
+	}
+	event->signaled = 0;
+	return 0;
+#endif /* _WIN32 */
+}
+
+/**
+ * Destroy an event.
+ * @param event	[in] Event.
+ */
+void threadw_event_destroy(threadw_event_t *event)
+{
+	assert(event != NULL);
+#ifdef _WIN32
+	CloseHandle(*event);
+#else /* !_WIN32 */
+	pthread_cond_destroy(&event->cond);
+	pthread_mutex_destroy(&event->mutex);
+#endif /* _WIN32 */
+}
+
+/**
+ * Signal an event.
+ * If a thread is waiting, it wakes up and the event is reset.
+ * Otherwise, the event stays signaled until a thread waits on it.
+ * @param event	[in] Event.
+ */
+void threadw_event_set(threadw_event_t *event)
+{
+	assert(event != NULL);
+#ifdef _WIN32
+	SetEvent(*event);
+#else /* !_WIN32 */
+	pthread_mutex_lock(&event->mutex);
+	event->signaled = 1;
+	pthread_cond_signal(&event->cond);
+	pthread_mutex_unlock(&event->mutex);
+#endif /* _WIN32 */
+}
+
+/**
+ * Wait for an event to be signaled, then reset it.
+ * @param event	[in] Event.
+ */
+void threadw_event_wait(threadw_event_t *event)
+{
+	assert(event != NULL);
+#ifdef _WIN32
+	WaitForSingleObject(*event, INFINITE);
+#else /* !_WIN32 */
+	pthread_mutex_lock(&event->mutex);
+	while (!event->signaled) {
+		pthread_cond_wait(&event->cond, &event->mutex);
+	}
+	event->signaled = 0;
+	pthread_mutex_unlock(&event->mutex);
+#endif /* _WIN32 */
+}
+
+// Startup parameters for threadw_thread_create().
+typedef struct _ThreadStart {
+	threadw_thread_func func;	// Thread function.
+	void *userdata;			// User data for the thread function.
+} ThreadStart;
+
+#ifdef _WIN32
+static unsigned int __stdcall thread_start(void *param)
+#else /* !_WIN32 */
+static void *thread_start(void *param)
+#endif /* _WIN32 */
+{
+	// Copy the parameters so they can be freed.
+	ThreadStart start = *(ThreadStart*)param;
+	free(param);
+	start.func(start.userdata);
+#ifdef _WIN32
+	return 0;
+#else /* !_WIN32 */
+	return NULL;
+#endif /* _WIN32 */
+}
+
+/**
+ * Start a thread.
+ * threadw_thread_join() must be called to release the thread.
+ * @param thread	[out] Thread.
+ * @param func		[in] Thread function.
+ * @param userdata	[in] User data for the thread function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_thread_create(threadw_thread_t *thread, threadw_thread_func func, void *userdata)
+{
+	ThreadStart *start;
+	int ret;
+
+	assert(thread != NULL);
+	assert(func != NULL);
+	start = malloc(sizeof(*start));
+	if (!start) {
+		return -ENOMEM;
+	}
+	start->func = func;
+	start->userdata = userdata;
+
+#ifdef _WIN32
+	*thread = (HANDLE)_beginthreadex(NULL, 0, thread_start, start, 0, NULL);
+	ret = (*thread != NULL ? 0 : (errno != 0 ? -errno : -EAGAIN));
+#else /* !_WIN32 */
+	ret = -pthread_create(thread, NULL, thread_start, start);
+#endif /* _WIN32 */
+	if (ret != 0) {
+		free(start);
+	}
+	return ret;
+}
+
+/**
+ * Wait for a thread to finish and release it.
+ * @param thread	[in] Thread.
+ */
+void threadw_thread_join(threadw_thread_t thread)
+{
+#ifdef _WIN32
+	WaitForSingleObject(thread, INFINITE);
+	CloseHandle(thread);
+#else /* !_WIN32 */
+	pthread_join(thread, NULL);
+#endif /* _WIN32 */
+}
+
+/**
+ * Get the number of logical CPUs in the system.
+ * @return Number of logical CPUs. (Always at least 1.)
+ */
+unsigned int threadw_cpu_count(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return (si.dwNumberOfProcessors > 0 ? (unsigned int)si.dwNumberOfProcessors : 1);
+#elif defined(_SC_NPROCESSORS_ONLN)
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0 ? (unsigned int)n : 1);
+#else
+	return 1;
+#endif
+}
+
+// Shared state for threadw_parallel_for().
+typedef struct _ParallelForState {
+	threadw_mutex_t mutex;		// Protects next_index.
+	unsigned int next_index;	// Next work item to hand out.
+	unsigned int count;		// Total number of work items.
+	threadw_work_func func;		// Work function.
+	void *userdata;			// User data for the work function.
+} ParallelForState;
+
+/**
+ * Worker thread loop for threadw_parallel_for().
+ * @param state ParallelForState.
+ */
+static void parallel_for_worker(ParallelForState *state)
+{
+	for (;;) {
+		unsigned int index;
+
+		threadw_mutex_lock(&state->mutex);
+		index = state->next_index;
+		if (index < state->count) {
+			state->next_index++;
+		}
+		threadw_mutex_unlock(&state->mutex);
+
+		if (index >= state->count) {
+			// No more work items.
+			break;
+		}
+		state->func(index, state->userdata);
+	}
+}
+
+#ifdef _WIN32
+static unsigned int __stdcall parallel_for_thread(void *param)
+{
+	parallel_for_worker((ParallelForState*)param);
+	return 0;
+}
+#else /* !_WIN32 */
+static void *parallel_for_thread(void *param)
+{
+	parallel_for_worker((ParallelForState*)param);
+	return NULL;
+}
+#endif /* _WIN32 */
+
+/**
+ * Run a work function for each index in [0, count) using a pool of worker threads.
+ *
+ * Work items are handed out in ascending order, but may finish in
+ * any order. The calling thread also processes work items, and this
+ * function does not return until all work items have been processed.
+ *
+ * @param count		[in] Number of work items.
+ * @param max_threads	[in] Maximum number of threads to use. (0 for the number of logical CPUs)
+ * @param func		[in] Work function.
+ * @param userdata	[in] User data for the work function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_parallel_for(unsigned int count, unsigned int max_threads,
+	threadw_work_func func, void *userdata)
+{
+	ParallelForState state;
+#ifdef _WIN32
+	HANDLE threads[THREADW_MAX_THREADS];
+#else /* !_WIN32 */
+	pthread_t threads[THREADW_MAX_THREADS];
+#endif /* _WIN32 */
+	unsigned int thread_count = 0;
+	unsigned int i;
+	int ret;
+
+	assert(func != NULL);
+	if (!func) {
+		errno = EINVAL;
+		return -EINVAL;
+	} else if (count == 0) {
+		// Nothing to do.
+		return 0;
+	}
+
+	if (max_threads == 0) {
+		max_threads = threadw_cpu_count();
+	}
+	if (max_threads > count) {
+		max_threads = count;
+	}
+	if (max_threads > THREADW_MAX_THREADS) {
+		max_threads = THREADW_MAX_THREADS;
+	}
+
+	ret = threadw_mutex_init(&state.mutex);
+	if (ret != 0) {
+		errno = -ret;
+		return ret;
+	}
+	state.next_index = 0;
+	state.count = count;
+	state.func = func;
+	state.userdata = userdata;
+
+	// Start the worker threads.
+	// The calling thread counts as one of the workers.
+	// If a thread can't be created, the remaining
+	// threads will pick up its work items.
+	for (i = 1; i < max_threads; i++) {
+#ifdef _WIN32
+		HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, parallel_for_thread, &state, 0, NULL);
+		if (!hThread)
+			break;
+		threads[thread_count++] = hThread;
+#else /* !_WIN32 */
+		if (pthread_create(&threads[thread_count], NULL, parallel_for_thread, &state) != 0)
+			break;
+		thread_count++;
+#endif /* _WIN32 */
+	}
+
+	// Process work items on this thread, too.
+	parallel_for_worker(&state);
+
+	// Wait for the worker threads to finish.
+	for (i = 0; i < thread_count; i++) {
+#ifdef _WIN32
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+#else /* !_WIN32 */
+		pthread_join(threads[i], NULL);
+#endif /* _WIN32 */
+	}
+
+	threadw_mutex_destroy(&state.mutex);
+	return 0;
+}
@@ -0,0 +1,203 @@
+/***************************************************************************
+ * RVT-H Tool (libwiicrypto)                                               *
+ * threadw.h: Threading wrapper functions.                                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_LIBWIICRYPTO_THREADW_H__
+#define __RVTHTOOL_LIBWIICRYPTO_THREADW_H__
+
+#ifdef _WIN32
+# include <windows.h>
+#else /* !_WIN32 */
+# include <pthread.h>
+#endif /* _WIN32 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** One-time initialization **/
+
+#ifdef _WIN32
+// NOTE: InitOnceExecuteOnce() requires Vista, so we're
+// using a simple interlocked state variable instead.
+// 0 == not initialized; 1 == initializing; 2 == initialized
+typedef volatile LONG threadw_once_t;
+# define THREADW_ONCE_INIT 0
+#else /* !_WIN32 */
+typedef pthread_once_t threadw_once_t;
+# define THREADW_ONCE_INIT PTHREAD_ONCE_INIT
+#endif /* _WIN32 */
+
+/**
+ * Run a function exactly once, even if called from multiple threads.
+ * All callers will block until the function has finished running.
+ * @param once_control	[in/out] Once control variable. (Initialize with THREADW_ONCE_INIT.)
+ * @param init_routine	[in] Initialization function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_once(threadw_once_t *once_control, void (*init_routine)(void));
+
+/** Mutexes **/
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION threadw_mutex_t;
+#else /* !_WIN32 */
+typedef pthread_mutex_t threadw_mutex_t;
+#endif /* _WIN32 */
+
+/**
+ * Initialize a mutex.
+ * @param mutex	[out] Mutex.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_mutex_init(threadw_mutex_t *mutex);
+
+/**
+ * Destroy a mutex.
+ * @param mutex	[in] Mutex.
+ */
+void threadw_mutex_destroy(threadw_mutex_t *mutex);
+
+/**
+ * Lock a mutex.
+ * @param mutex	[in] Mutex.
+ */
+static inline void threadw_mutex_lock(threadw_mutex_t *mutex)
+{
+#ifdef _WIN32
+	EnterCriticalSection(mutex);
+#else /* !_WIN32 */
+	pthread_mutex_lock(mutex);
+#endif /* _WIN32 */
+}
+
+/**
+ * Unlock a mutex.
+ * @param mutex	[in] Mutex.
+ */
+static inline void threadw_mutex_unlock(threadw_mutex_t *mutex)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(mutex);
+#else /* !_WIN32 */
+	pthread_mutex_unlock(mutex);
+#endif /* _WIN32 */
+}
+
+/** Events **/
+
+#ifdef _WIN32
+typedef HANDLE threadw_event_t;
+#else /* !_WIN32 */
+typedef struct _threadw_event_t {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int signaled;
+} threadw_event_t;
+#endif /* _WIN32 */
+
+// NOTE: Condition variables require Vista on Windows, so an
+// auto-reset event is used for signaling between threads.
+// Waiters should check their own state (protected by a mutex)
+// before waiting, and setters should set the event after
+// updating that state. Since the event stays signaled until
+// a waiter wakes up, no wakeups are lost.
+
+/**
+ * Initialize an auto-reset event.
+ * The event is initially not signaled.
+ * @param event	[out] Event.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_event_init(threadw_event_t *event);
+
+/**
+ * Destroy an event.
+ * @param event	[in] Event.
+ */
+void threadw_event_destroy(threadw_event_t *event);
+
+/**
+ * Signal an event.
+ * If a thread is waiting, it wakes up and the event is reset.
+ * Otherwise, the event stays signaled until a thread waits on it.
+ * @param event	[in] Event.
+ */
+void threadw_event_set(threadw_event_t *event);
+
+/**
+ * Wait for an event to be signaled, then reset it.
+ * @param event	[in] Event.
+ */
+void threadw_event_wait(threadw_event_t *event);
+
+/** Threads **/
+
+#ifdef _WIN32
+typedef HANDLE threadw_thread_t;
+#else /* !_WIN32 */
+typedef pthread_t threadw_thread_t;
+#endif /* _WIN32 */
+
+/**
+ * Thread function for threadw_thread_create().
+ * @param userdata	[in] User data.
+ */
+typedef void (*threadw_thread_func)(void *userdata);
+
+/**
+ * Start a thread.
+ * threadw_thread_join() must be called to release the thread.
+ * @param thread	[out] Thread.
+ * @param func		[in] Thread function.
+ * @param userdata	[in] User data for the thread function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_thread_create(threadw_thread_t *thread, threadw_thread_func func, void *userdata);
+
+/**
+ * Wait for a thread to finish and release it.
+ * @param thread	[in] Thread.
+ */
+void threadw_thread_join(threadw_thread_t thread);
+
+/** Worker threads **/
+
+/**
+ * Get the number of logical CPUs in the system.
+ * @return Number of logical CPUs. (Always at least 1.)
+ */
+unsigned int threadw_cpu_count(void);
+
+/**
+ * Work function for threadw_parallel_for().
+ * @param index		[in] Work item index.
+ * @param userdata	[in] User data.
+ */
+typedef void (*threadw_work_func)(unsigned int index, void *userdata);
+
+/**
+ * Run a work function for each index in [0, count) using a pool of worker threads.
+ *
+ * Work items are handed out in ascending order, but may finish in
+ * any order. The calling thread also processes work items, and this
+ * function does not return until all work items have been processed.
+ *
+ * @param count		[in] Number of work items.
+ * @param max_threads	[in] Maximum number of threads to use. (0 for the number of logical CPUs)
+ * @param func		[in] Work function.
+ * @param userdata	[in] User data for the work function.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int threadw_parallel_for(unsigned int count, unsigned int max_threads,
+	threadw_work_func func, void *userdata);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_LIBWIICRYPTO_THREADW_H__ */
@@ -121,6 +121,45 @@ typedef struct PACKED _WUP_Content_Entry {
 ASSERT_STRUCT(WUP_Content_Entry, 0x30);
 #pragma pack()
 
+/**
+ * Content type bit for hashed contents. (see RVL_Content_Type_e)
+ * Hashed contents are stored as 64 KB blocks, each of which has
+ * a hash area and a data area, and have a separate .h3 file.
+ */
+#define WUP_CONTENT_TYPE_HASHED 0x0002
+
+/**
+ * Hashed content block. (64 KB)
+ * The hash area is encrypted using a zero IV.
+ * The data area is encrypted using H0[block number % 16] as the IV.
+ *
+ * H0 == hash of a single block's data area
+ * H1 == hash of 16 H0 hashes
+ * H2 == hash of 16 H1 hashes
+ * H3 == hash of 16 H2 hashes, stored in the .h3 file
+ * H4 == hash of the .h3 file, stored in the content entry
+ */
+#define WUP_HASHED_BLOCK_SIZE 0x10000
+#define WUP_HASHED_BLOCK_DATA_SIZE 0xFC00
+typedef struct _WUP_Hashed_Block {
+	// One hash area covers a 1 MB superblock.
+	struct {
+		// 16 H0 hashes, each of which covers the data area (63 KB) of one 64 KB block.
+		// For every megabyte of data, all 64 KB blocks have the same H0 hashes.
+		uint8_t h0[16][20];	// [0x000]
+		// 16 H1 hashes, each of which covers the H0 table for a given 1 MB block.
+		// For every 16 MB of data, all 64 KB blocks have the same H1 hashes.
+		uint8_t h1[16][20];	// [0x140]
+		// 16 H2 hashes, each of which covers the H1 table for a given 16 MB block.
+		// For every 256 MB of data, all 64 KB blocks have the same H2 hashes.
+		uint8_t h2[16][20];	// [0x280]
+
+		uint8_t unused[64];	// [0x3C0]
+	} hashes;
+	uint8_t data[WUP_HASHED_BLOCK_DATA_SIZE];	// [0x400]
+} WUP_Hashed_Block;
+ASSERT_STRUCT(WUP_Hashed_Block, WUP_HASHED_BLOCK_SIZE);
+
 #ifdef __cplusplus
 }
 #endif
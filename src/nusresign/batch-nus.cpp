@@ -0,0 +1,492 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * batch-nus.cpp: Batch resigning of NUS directories.                      *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "batch-nus.hpp"
+#include "resign-nus.hpp"
+
+#include "libwiicrypto/common.h"
+#include "libwiicrypto/threadw.h"
+
+// C includes.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+# define NULL_DEVICE _T("NUL")
+#else /* !_WIN32 */
+# include <dirent.h>
+# include <sys/stat.h>
+# define NULL_DEVICE _T("/dev/null")
+#endif /* _WIN32 */
+
+// C++ includes.
+#include <algorithm>
+#include <string>
+#include <vector>
+using std::string;
+using std::tstring;
+using std::vector;
+
+// Maximum length of a job's summary message.
+#define BATCH_MESSAGE_MAX 1024
+
+/**
+ * A single NUS directory to resign.
+ */
+struct BatchJob {
+	tstring name;		// Directory, relative to the root. (for the report)
+	tstring nus_dir;	// NUS directory.
+	int ret;		// resign_nus() return value
+	string message;		// Summary message on error.
+	string from_key;	// Original key, e.g. "retail". (empty if unknown)
+	string to_key;		// New key, e.g. "debug". (empty if unknown)
+};
+
+/**
+ * Batch processing parameters.
+ * Shared by all worker threads.
+ */
+struct BatchParams {
+	BatchJob *jobs;
+	unsigned int count;
+	int recrypt_key;
+
+	// Output stream used if a job's log can't be created.
+	FILE *f_null;
+
+	// Progress. (protected by mutex)
+	threadw_mutex_t mutex;
+	unsigned int done;
+};
+
+/**
+ * Concatenate a directory and a filename.
+ * @param dir		[in] Directory.
+ * @param filename	[in] Filename.
+ * @return Path.
+ */
+static tstring path_join(const tstring &dir, const TCHAR *filename)
+{
+	tstring path = dir;
+	if (path.empty() || (path[path.size()-1] != _T('/') && path[path.size()-1] != DIR_SEP_CHR)) {
+		path += DIR_SEP_CHR;
+	}
+	path += filename;
+	return path;
+}
+
+/**
+ * Check if a path is a regular file.
+ * @param path Path.
+ * @return True if it's a file; false if it isn't or it can't be accessed.
+ */
+static bool is_file(const tstring &path)
+{
+#ifdef _WIN32
+	DWORD attrs = GetFileAttributes(path.c_str());
+	return (attrs != INVALID_FILE_ATTRIBUTES && !(attrs & FILE_ATTRIBUTE_DIRECTORY));
+#else /* !_WIN32 */
+	struct stat sb;
+	return (stat(path.c_str(), &sb) == 0 && S_ISREG(sb.st_mode));
+#endif /* _WIN32 */
+}
+
+/**
+ * Check if a directory is an NUS directory.
+ * @param dir Directory.
+ * @return True if it has both title.tik and title.tmd.
+ */
+static bool is_nus_dir(const tstring &dir)
+{
+	return is_file(path_join(dir, _T("title.tik"))) &&
+	       is_file(path_join(dir, _T("title.tmd")));
+}
+
+/**
+ * List the subdirectories of a directory.
+ * Symbolic links (reparse points on Windows) are skipped
+ * so the search can't loop.
+ * @param dir		[in] Directory.
+ * @param subdirs	[out] Subdirectory names, sorted.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int list_subdirs(const tstring &dir, vector<tstring> &subdirs)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATA findData;
+	HANDLE hFind = FindFirstFile(path_join(dir, _T("*")).c_str(), &findData);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return (GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -ENOENT);
+	}
+
+	do {
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+		    (findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ||
+		    !_tcscmp(findData.cFileName, _T(".")) ||
+		    !_tcscmp(findData.cFileName, _T("..")))
+		{
+			continue;
+		}
+		subdirs.push_back(findData.cFileName);
+	} while (FindNextFile(hFind, &findData));
+	FindClose(hFind);
+#else /* !_WIN32 */
+	DIR *pDir = opendir(dir.c_str());
+	if (!pDir) {
+		return -errno;
+	}
+
+	struct dirent *dirent;
+	while ((dirent = readdir(pDir)) != nullptr) {
+		if (!strcmp(dirent->d_name, ".") || !strcmp(dirent->d_name, "..")) {
+			continue;
+		}
+		struct stat sb;
+		if (lstat(path_join(dir, dirent->d_name).c_str(), &sb) != 0 || !S_ISDIR(sb.st_mode)) {
+			// Not a directory, or it can't be accessed.
+			continue;
+		}
+		subdirs.push_back(dirent->d_name);
+	}
+	closedir(pDir);
+#endif /* _WIN32 */
+
+	// Process the directories in a consistent order.
+	std::sort(subdirs.begin(), subdirs.end());
+	return 0;
+}
+
+/**
+ * Find NUS directories.
+ * NUS directories aren't searched any further.
+ * @param dir		[in] Directory to search.
+ * @param name		[in] Directory name relative to the root. (empty for the root)
+ * @param depth		[in] Current depth.
+ * @param jobs		[in,out] Job list.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int find_nus_dirs(const tstring &dir, const tstring &name, unsigned int depth, vector<BatchJob> &jobs)
+{
+	if (is_nus_dir(dir)) {
+		BatchJob job;
+		job.name = (name.empty() ? _T(".") : name);
+		job.nus_dir = dir;
+		job.ret = 0;
+		jobs.push_back(std::move(job));
+		return 0;
+	} else if (depth >= BATCH_MAX_DEPTH) {
+		// Too deep.
+		return 0;
+	}
+
+	vector<tstring> subdirs;
+	int ret = list_subdirs(dir, subdirs);
+	if (ret != 0) {
+		// Only errors reading the root directory are fatal.
+		return (depth == 0 ? ret : 0);
+	}
+
+	for (const tstring &subdir : subdirs) {
+		const tstring sub_name = (name.empty() ? subdir : path_join(name, subdir.c_str()));
+		ret = find_nus_dirs(path_join(dir, subdir.c_str()), sub_name, depth + 1, jobs);
+		if (ret != 0) {
+			break;
+		}
+	}
+	return ret;
+}
+
+/**
+ * Get the results from a job's log.
+ * Error messages are kept for the summary, and the
+ * conversion keys are taken from the status message.
+ * @param f_log	[in] Job log.
+ * @param job	[in,out] Job.
+ */
+static void parse_log(FILE *f_log, BatchJob *job)
+{
+	char line[512];
+
+	rewind(f_log);
+	while (fgets(line, sizeof(line), f_log)) {
+		// Remove the trailing newline.
+		size_t len = strlen(line);
+		while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r')) {
+			line[--len] = 0;
+		}
+
+		char from_key[16], to_key[16];
+		if (sscanf(line, "Converting NUS from %15s to %15[^.]", from_key, to_key) == 2) {
+			job->from_key = from_key;
+			job->to_key = to_key;
+		} else if (job->ret != 0 && !strncmp(line, "*** ERROR", 9)) {
+			if (!job->message.empty()) {
+				job->message += "; ";
+			}
+			job->message += &line[4];
+		}
+	}
+
+	if (job->message.size() > BATCH_MESSAGE_MAX) {
+		job->message.resize(BATCH_MESSAGE_MAX);
+	}
+}
+
+/**
+ * Resign a single NUS directory.
+ * Called by threadw_parallel_for().
+ * @param index		[in] Job index.
+ * @param userdata	[in] BatchParams.
+ */
+static void batch_worker(unsigned int index, void *userdata)
+{
+	BatchParams *const params = static_cast<BatchParams*>(userdata);
+	BatchJob *const job = &params->jobs[index];
+
+	// Output is written to a temporary log so it
+	// can be summarized without interleaving.
+	FILE *f_log = tmpfile();
+	FILE *const f_out = (f_log ? f_log : params->f_null);
+
+	// NOTE: The NUS information isn't printed, since
+	// resign_nus() parses the ticket and TMD itself.
+	job->ret = resign_nus(job->nus_dir.c_str(), params->recrypt_key, false, f_out, f_out);
+
+	if (f_log) {
+		fflush(f_log);
+		parse_log(f_log, job);
+		fclose(f_log);
+	}
+
+	// Show the progress.
+	threadw_mutex_lock(&params->mutex);
+	params->done++;
+	fprintf(stderr, "\rProcessed %u of %u NUS directories...", params->done, params->count);
+	fflush(stderr);
+	threadw_mutex_unlock(&params->mutex);
+}
+
+/**
+ * Write a string to a JSON file.
+ * @param f JSON file.
+ * @param s String. (If NULL, writes null.)
+ */
+static void json_write_string(FILE *f, const char *s)
+{
+	if (!s) {
+		fputs("null", f);
+		return;
+	}
+
+	fputc('"', f);
+	for (; *s != 0; s++) {
+		const unsigned char chr = static_cast<unsigned char>(*s);
+		switch (chr) {
+			case '"':
+				fputs("\\\"", f);
+				break;
+			case '\\':
+				fputs("\\\\", f);
+				break;
+			case '\n':
+				fputs("\\n", f);
+				break;
+			case '\r':
+				fputs("\\r", f);
+				break;
+			case '\t':
+				fputs("\\t", f);
+				break;
+			default:
+				if (chr < 0x20) {
+					fprintf(f, "\\u%04X", chr);
+				} else {
+					fputc(chr, f);
+				}
+				break;
+		}
+	}
+	fputc('"', f);
+}
+
+/**
+ * Write a TCHAR string to a JSON file.
+ * @param f JSON file.
+ * @param s String.
+ */
+static void json_write_tstring(FILE *f, const tstring &s)
+{
+#ifdef _UNICODE
+	// Convert to UTF-8.
+	int len = WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, nullptr, 0, nullptr, nullptr);
+	if (len <= 0) {
+		json_write_string(f, nullptr);
+		return;
+	}
+	string s8(len, 0);
+	WideCharToMultiByte(CP_UTF8, 0, s.c_str(), -1, &s8[0], len, nullptr, nullptr);
+	json_write_string(f, s8.c_str());
+#else /* !_UNICODE */
+	json_write_string(f, s.c_str());
+#endif /* _UNICODE */
+}
+
+/**
+ * Write the JSON report.
+ * @param json_filename	[in] JSON filename.
+ * @param root_dir	[in] Root directory.
+ * @param params	[in] BatchParams.
+ * @param failed	[in] Number of failed jobs.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int write_json_report(const TCHAR *json_filename, const TCHAR *root_dir,
+	const BatchParams *params, unsigned int failed)
+{
+	FILE *f_json = _tfopen(json_filename, _T("w"));
+	if (!f_json) {
+		return -errno;
+	}
+
+	fputs("{\n\t\"command\": \"resign-batch\",\n\t\"root\": ", f_json);
+	json_write_tstring(f_json, root_dir);
+	fprintf(f_json, ",\n\t\"total\": %u,\n\t\"ok\": %u,\n\t\"failed\": %u,\n\t\"titles\": [",
+		params->count, params->count - failed, failed);
+	for (unsigned int i = 0; i < params->count; i++) {
+		const BatchJob *const job = &params->jobs[i];
+		fputs((i > 0 ? ",\n\t\t{\"dir\": " : "\n\t\t{\"dir\": "), f_json);
+		json_write_tstring(f_json, job->name);
+		fputs(", \"from\": ", f_json);
+		json_write_string(f_json, (!job->from_key.empty() ? job->from_key.c_str() : nullptr));
+		fputs(", \"to\": ", f_json);
+		json_write_string(f_json, (!job->to_key.empty() ? job->to_key.c_str() : nullptr));
+		fprintf(f_json, ", \"status\": \"%s\", \"error\": %d, \"message\": ",
+			(job->ret == 0 ? "ok" : "failed"), job->ret);
+		json_write_string(f_json, (!job->message.empty() ? job->message.c_str() : nullptr));
+		fputc('}', f_json);
+	}
+	fputs((params->count > 0 ? "\n\t]\n}\n" : "]\n}\n"), f_json);
+
+	int ret = 0;
+	if (ferror(f_json)) {
+		ret = -EIO;
+	}
+	if (fclose(f_json) != 0 && ret == 0) {
+		ret = -errno;
+	}
+	return ret;
+}
+
+/**
+ * 'resign-batch' command.
+ *
+ * The root directory and its subdirectories are searched for NUS
+ * directories, i.e. directories that have both title.tik and title.tmd.
+ * NUS directories aren't searched any further. Each NUS directory
+ * is resigned in place.
+ *
+ * @param root_dir	[in] Root directory.
+ * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param jobs		[in] Maximum number of NUS directories to resign at once. (0 for the number of CPUs)
+ * @param json_filename	[in,opt] If not NULL, write a JSON report to this file.
+ * @return 0 if all NUS directories were resigned successfully; 1 if any failed; negative POSIX error code on error.
+ */
+int resign_nus_batch(const TCHAR *root_dir, int recrypt_key, unsigned int jobs, const TCHAR *json_filename)
+{
+	// Find the NUS directories.
+	vector<BatchJob> batch_jobs;
+	int ret = find_nus_dirs(root_dir, tstring(), 0, batch_jobs);
+	if (ret != 0) {
+		fputs("*** ERROR reading '", stderr);
+		_fputts(root_dir, stderr);
+		fprintf(stderr, "': %s\n", strerror(-ret));
+		return ret;
+	}
+	if (batch_jobs.empty()) {
+		fputs("*** ERROR: No NUS directories found in '", stderr);
+		_fputts(root_dir, stderr);
+		fputs("'.\n", stderr);
+		return -ENOENT;
+	}
+
+	BatchParams params;
+	params.jobs = batch_jobs.data();
+	params.count = static_cast<unsigned int>(batch_jobs.size());
+	params.recrypt_key = recrypt_key;
+	params.done = 0;
+	params.f_null = _tfopen(NULL_DEVICE, _T("w"));
+	if (!params.f_null) {
+		return -errno;
+	}
+	ret = threadw_mutex_init(&params.mutex);
+	if (ret != 0) {
+		fclose(params.f_null);
+		return ret;
+	}
+
+	if (jobs == 0) {
+		jobs = threadw_cpu_count();
+	}
+	printf("Resigning %u NUS director%s using %u job%s...\n",
+		params.count, (params.count != 1 ? "ies" : "y"),
+		jobs, (jobs != 1 ? "s" : ""));
+	fflush(stdout);
+
+	// NOTE: Certificates, prepared private keys, and the random number
+	// generator are process-wide in libwiicrypto, so the signing state
+	// is set up once and shared by all jobs.
+	ret = threadw_parallel_for(params.count, jobs, batch_worker, &params);
+	fputc('\n', stderr);
+	threadw_mutex_destroy(&params.mutex);
+	fclose(params.f_null);
+	if (ret != 0) {
+		return ret;
+	}
+
+	// Print the summary.
+	unsigned int failed = 0;
+	putchar('\n');
+	for (const BatchJob &job : batch_jobs) {
+		if (job.ret == 0) {
+			fputs("OK:     ", stdout);
+			_fputts(job.name.c_str(), stdout);
+			if (!job.from_key.empty()) {
+				printf(" (%s -> %s)", job.from_key.c_str(), job.to_key.c_str());
+			}
+		} else {
+			failed++;
+			fputs("FAILED: ", stdout);
+			_fputts(job.name.c_str(), stdout);
+			if (!job.message.empty()) {
+				printf(": %s", job.message.c_str());
+			} else if (job.ret < 0) {
+				printf(": %s", strerror(-job.ret));
+			} else {
+				printf(": error %d", job.ret);
+			}
+		}
+		putchar('\n');
+	}
+	printf("\n%u NUS director%s processed: %u OK, %u failed.\n",
+		params.count, (params.count != 1 ? "ies" : "y"),
+		params.count - failed, failed);
+
+	if (json_filename) {
+		ret = write_json_report(json_filename, root_dir, &params, failed);
+		if (ret != 0) {
+			fputs("*** ERROR writing JSON report '", stderr);
+			_fputts(json_filename, stderr);
+			fprintf(stderr, "': %s\n", strerror(-ret));
+			return ret;
+		}
+	}
+
+	return (failed > 0 ? 1 : 0);
+}
@@ -0,0 +1,42 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * batch-nus.hpp: Batch resigning of NUS directories.                      *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_NUSRESIGN_BATCH_NUS_HPP__
+#define __RVTHTOOL_NUSRESIGN_BATCH_NUS_HPP__
+
+#include "tcharx.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum subdirectory depth searched for NUS directories.
+#define BATCH_MAX_DEPTH 16
+
+/**
+ * 'resign-batch' command.
+ *
+ * The root directory and its subdirectories are searched for NUS
+ * directories, i.e. directories that have both title.tik and title.tmd.
+ * NUS directories aren't searched any further. Each NUS directory
+ * is resigned in place.
+ *
+ * @param root_dir	[in] Root directory.
+ * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param jobs		[in] Maximum number of NUS directories to resign at once. (0 for the number of CPUs)
+ * @param json_filename	[in,opt] If not NULL, write a JSON report to this file.
+ * @return 0 if all NUS directories were resigned successfully; 1 if any failed; negative POSIX error code on error.
+ */
+int resign_nus_batch(const TCHAR *root_dir, int recrypt_key, unsigned int jobs, const TCHAR *json_filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_NUSRESIGN_BATCH_NUS_HPP__ */
@@ -0,0 +1,464 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * decrypt-nus.cpp: Decrypt the contents of an NUS directory. (Wii U)      *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "decrypt-nus.hpp"
+#include "nus-fns.hpp"
+
+// libwiicrypto
+#include "libwiicrypto/common.h"
+#include "libwiicrypto/aesw.h"
+#include "libwiicrypto/byteswap.h"
+#include "libwiicrypto/threadw.h"
+#include "libwiicrypto/wiiu_structs.h"
+
+// C includes.
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+# include <direct.h>
+#endif /* _WIN32 */
+
+// C++ includes.
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+using std::tstring;
+using std::unique_ptr;
+using std::vector;
+
+// Buffer size for decrypting contents.
+// (Must be a multiple of the 64 KB hashed block size.)
+#define DECRYPT_BUFFER_SIZE (1024*1024)
+
+// Maximum number of contents to decrypt at once.
+// Each content uses one buffer, so memory usage is
+// bounded regardless of the content sizes.
+#define DECRYPT_MAX_CONTENT_JOBS 16
+
+/**
+ * Content being decrypted.
+ */
+struct ContentDecrypt {
+	const WUP_Content_Entry *entry;
+	char cid[16];		// Content ID, for messages
+	tstring sf_app;		// Encrypted content filename
+	tstring sf_out;		// Decrypted content filename
+
+	// Results
+	int ret;		// 0 on success; negative POSIX error code on error
+	const char *err_op;	// Operation that failed: "opening", "reading", "writing"
+	int64_t out_size;	// Size of the decrypted content
+};
+
+/**
+ * Decrypt hashed blocks and remove their hash areas.
+ * The data areas are moved to the start of the buffer.
+ * @param aesw		[in] AES context, with the title key set.
+ * @param buf		[in,out] Buffer containing encrypted hashed blocks.
+ * @param size		[in] Size of the buffer. (Must be a multiple of WUP_HASHED_BLOCK_SIZE.)
+ * @param block_number	[in] Block number of the first block.
+ * @return Size of the decrypted data.
+ */
+static uint32_t decrypt_hashed_blocks(AesCtx *aesw, uint8_t *buf, uint32_t size, uint32_t block_number)
+{
+	static const uint8_t zero_iv[16] = {0};
+	assert(size % WUP_HASHED_BLOCK_SIZE == 0);
+
+	uint8_t *dest = buf;
+	for (uint32_t pos = 0; pos < size; pos += WUP_HASHED_BLOCK_SIZE, block_number++) {
+		WUP_Hashed_Block *const block = reinterpret_cast<WUP_Hashed_Block*>(&buf[pos]);
+
+		// Decrypt the hashes. (zero IV)
+		aesw_set_iv(aesw, zero_iv, sizeof(zero_iv));
+		aesw_decrypt(aesw, reinterpret_cast<uint8_t*>(&block->hashes), sizeof(block->hashes));
+
+		// Decrypt the data.
+		// IV is one of the decrypted hashes.
+		aesw_set_iv(aesw, block->hashes.h0[block_number % 16], 16);
+		aesw_decrypt(aesw, block->data, sizeof(block->data));
+
+		// Remove the hash area.
+		// NOTE: The destination never overlaps data that
+		// hasn't been moved yet, but may overlap this block.
+		memmove(dest, block->data, sizeof(block->data));
+		dest += sizeof(block->data);
+	}
+
+	return static_cast<uint32_t>(dest - buf);
+}
+
+/**
+ * Decrypt a content.
+ * @param cd		[in,out] Content being decrypted.
+ * @param title_key	[in] Decrypted title key.
+ * @return 0 on success; negative POSIX error code on error. (cd->err_op is set.)
+ */
+static int decrypt_content(ContentDecrypt *cd, const uint8_t title_key[16])
+{
+	const WUP_Content_Entry *const entry = cd->entry;
+
+	int64_t data_sz = be64_to_cpu(entry->size);
+	const bool hashed = !!(entry->type & cpu_to_be16(WUP_CONTENT_TYPE_HASHED));
+	int64_t in_size, out_size;
+	if (hashed) {
+		// TODO: Verify that the content is a multiple of 64 KB?
+		const int64_t block_count = data_sz / WUP_HASHED_BLOCK_SIZE;
+		in_size = block_count * WUP_HASHED_BLOCK_SIZE;
+		out_size = block_count * WUP_HASHED_BLOCK_DATA_SIZE;
+	} else {
+		// NOTE: AES works on 16-byte blocks, so we have to
+		// read and decrypt the full 16-byte block.
+		in_size = ALIGN_BYTES(16, data_sz);
+		out_size = data_sz;
+	}
+	cd->out_size = out_size;
+
+	FILE *const f_in = _tfopen(cd->sf_app.c_str(), _T("rb"));
+	if (!f_in) {
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		cd->err_op = "opening";
+		return -err;
+	}
+
+	FILE *const f_out = _tfopen(cd->sf_out.c_str(), _T("wb"));
+	if (!f_out) {
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		fclose(f_in);
+		cd->err_op = "creating";
+		return -err;
+	}
+
+	int ret = 0;
+	uint8_t *buf = nullptr;
+	AesCtx *const aesw = aesw_new();
+	if (!aesw) {
+		ret = -ENOMEM;
+		cd->err_op = "decrypting";
+		goto end;
+	}
+
+	// Set the title key and IV.
+	// IV is the 2-byte content index, followed by zeroes.
+	// (Hashed contents set the IV for each block.)
+	uint8_t iv[16];
+	memcpy(iv, &entry->index, 2);
+	memset(&iv[2], 0, 14);
+	aesw_set_key(aesw, title_key, 16);
+	aesw_set_iv(aesw, iv, sizeof(iv));
+
+	// Allocate memory.
+	buf = static_cast<uint8_t*>(malloc(DECRYPT_BUFFER_SIZE));
+	if (!buf) {
+		ret = -ENOMEM;
+		cd->err_op = "decrypting";
+		goto end;
+	}
+
+	// Read the content, decrypt it, and write it.
+	for (int64_t offset = 0; offset < in_size; offset += DECRYPT_BUFFER_SIZE) {
+		uint32_t size = DECRYPT_BUFFER_SIZE;
+		if (in_size - offset < size) {
+			size = static_cast<uint32_t>(in_size - offset);
+		}
+
+		ret = nus_read_at(f_in, buf, size, offset);
+		if (ret != 0) {
+			cd->err_op = "reading";
+			goto end;
+		}
+
+		uint32_t out_len;
+		if (hashed) {
+			out_len = decrypt_hashed_blocks(aesw, buf, size,
+				static_cast<uint32_t>(offset / WUP_HASHED_BLOCK_SIZE));
+		} else {
+			// CBC state carries over from the previous chunk.
+			aesw_decrypt(aesw, buf, size);
+
+			// NOTE: Only the actual content is written, not the
+			// aligned data required for decryption.
+			out_len = size;
+			if (out_len > out_size - offset) {
+				out_len = static_cast<uint32_t>(out_size - offset);
+			}
+		}
+
+		errno = 0;
+		if (fwrite(buf, 1, out_len, f_out) != out_len) {
+			ret = -errno;
+			if (ret == 0) {
+				ret = -EIO;
+			}
+			cd->err_op = "writing";
+			goto end;
+		}
+	}
+
+	if (fflush(f_out) != 0) {
+		ret = -errno;
+		if (ret == 0) {
+			ret = -EIO;
+		}
+		cd->err_op = "writing";
+	}
+
+end:
+	free(buf);
+	aesw_free(aesw);
+	fclose(f_in);
+	fclose(f_out);
+	if (ret != 0) {
+		// Don't leave a partially-decrypted content behind.
+		_tremove(cd->sf_out.c_str());
+	}
+	return ret;
+}
+
+/**
+ * Parameters for decrypting contents in parallel.
+ */
+struct DecryptParams {
+	const uint8_t *title_key;
+	ContentDecrypt *cds;
+};
+
+/**
+ * Decrypt a content.
+ * Called by threadw_parallel_for().
+ * @param index		[in] Content index.
+ * @param userdata	[in] DecryptParams
+ */
+static void decrypt_content_worker(unsigned int index, void *userdata)
+{
+	const DecryptParams *const params = static_cast<const DecryptParams*>(userdata);
+	ContentDecrypt *const cd = &params->cds[index];
+	cd->ret = decrypt_content(cd, params->title_key);
+}
+
+/**
+ * 'decrypt' command.
+ *
+ * Each content is decrypted to a file with the same name in the
+ * output directory. Hashed contents have the hash area of each
+ * 64 KB block removed, so only the data areas are written.
+ *
+ * @param nus_dir	[in] NUS directory.
+ * @param out_dir	[in] Output directory. (Created if it doesn't exist.)
+ * @param jobs		[in] Maximum number of threads. (0 for the number of CPUs)
+ * @return 0 if all contents were decrypted; 1 if any contents failed; negative POSIX error code on error.
+ */
+int decrypt_nus(const TCHAR *nus_dir, const TCHAR *out_dir, unsigned int jobs)
+{
+	if (!_tcscmp(nus_dir, out_dir)) {
+		fputs("*** ERROR: Output directory must be different from the NUS directory.\n", stderr);
+		return -EINVAL;
+	}
+
+	// Construct the filenames.
+	tstring sf_tik = nus_dir;
+	sf_tik += DIR_SEP_CHR;
+	sf_tik += _T("title.tik");
+
+	tstring sf_tmd = nus_dir;
+	sf_tmd += DIR_SEP_CHR;
+	sf_tmd += _T("title.tmd");
+
+	// Open the ticket and TMD.
+	FILE *f_tik = _tfopen(sf_tik.c_str(), _T("rb"));
+	if (!f_tik) {
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		fprintf(stderr, "*** ERROR opening ticket file: %s\n", strerror(err));
+		return -err;
+	}
+
+	FILE *f_tmd = _tfopen(sf_tmd.c_str(), _T("rb"));
+	if (!f_tmd) {
+		fclose(f_tik);
+
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		fprintf(stderr, "*** ERROR opening TMD file: %s\n", strerror(err));
+		return -err;
+	}
+
+	// Get the ticket and TMD sizes.
+	fseeko(f_tik, 0, SEEK_END);
+	const size_t tik_size = ftello(f_tik);
+	if (tik_size < sizeof(WUP_Ticket)) {
+		fclose(f_tik);
+		fclose(f_tmd);
+		fprintf(stderr, "*** ERROR reading ticket file: Too small.\n");
+		return -EIO;
+	} else if (tik_size > (64*1024)) {
+		fclose(f_tik);
+		fclose(f_tmd);
+		fprintf(stderr, "*** ERROR reading ticket file: Too big.\n");
+		return -EIO;
+	}
+	fseeko(f_tmd, 0, SEEK_END);
+	const size_t tmd_size = ftello(f_tmd);
+	if (tmd_size < (sizeof(WUP_TMD_Header) + sizeof(WUP_TMD_ContentInfoTable))) {
+		fclose(f_tik);
+		fclose(f_tmd);
+		fprintf(stderr, "*** ERROR reading TMD file: Too small.\n");
+		return -EIO;
+	} else if (tmd_size > (128*1024)) {
+		fclose(f_tik);
+		fclose(f_tmd);
+		fprintf(stderr, "*** ERROR reading TMD file: Too big.\n");
+		return -EIO;
+	}
+	rewind(f_tik);
+	rewind(f_tmd);
+
+	// Read the ticket and TMD.
+	unique_ptr<uint8_t[]> tik_data(new uint8_t[tik_size]);
+	unique_ptr<uint8_t[]> tmd_data(new uint8_t[tmd_size]);
+	errno = 0;
+	if (fread(tik_data.get(), 1, tik_size, f_tik) != tik_size ||
+	    fread(tmd_data.get(), 1, tmd_size, f_tmd) != tmd_size)
+	{
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		fclose(f_tik);
+		fclose(f_tmd);
+		fprintf(stderr, "*** ERROR reading ticket or TMD file: %s\n", strerror(err));
+		return -err;
+	}
+	fclose(f_tik);
+	fclose(f_tmd);
+	const WUP_Ticket *const pTicket = reinterpret_cast<const WUP_Ticket*>(tik_data.get());
+
+	// Decrypt the title key.
+	uint8_t title_key[16];
+	int ret = nus_decrypt_title_key(pTicket, nus_get_common_key(pTicket), title_key);
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR decrypting the title key: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	// Create the output directory.
+#ifdef _WIN32
+	ret = _tmkdir(out_dir);
+#else /* !_WIN32 */
+	ret = _tmkdir(out_dir, 0777);
+#endif /* _WIN32 */
+	if (ret != 0 && errno != EEXIST) {
+		ret = -errno;
+		fputs("*** ERROR creating output directory '", stderr);
+		_fputts(out_dir, stderr);
+		fprintf(stderr, "': %s\n", strerror(-ret));
+		return ret;
+	}
+
+	// Collect the TMD content entries.
+	const WUP_TMD_ContentInfoTable *const cinfotbl =
+		reinterpret_cast<const WUP_TMD_ContentInfoTable*>(&tmd_data[sizeof(WUP_TMD_Header)]);
+	const WUP_ContentInfo *cinfo = cinfotbl->info;
+	const WUP_ContentInfo *const cinfo_end = &cinfo[WUP_CONTENTINFO_ENTRIES];
+
+	size_t cstart = sizeof(WUP_TMD_Header) + sizeof(WUP_TMD_ContentInfoTable);
+	vector<ContentDecrypt> cds;
+	for (; cinfo < cinfo_end; cinfo++) {
+		const unsigned int indexOffset = be16_to_cpu(cinfo->indexOffset);
+		const unsigned int commandCount = be16_to_cpu(cinfo->commandCount);
+		if (indexOffset == 0 && commandCount == 0) {
+			// End of table.
+			break;
+		}
+
+		const size_t pos = cstart + (indexOffset * sizeof(WUP_Content_Entry));
+		const size_t len = (commandCount * sizeof(WUP_Content_Entry));
+		if (pos + len > tmd_size) {
+			// Out of bounds.
+			continue;
+		}
+
+		const WUP_Content_Entry *p =
+			reinterpret_cast<const WUP_Content_Entry*>(&tmd_data[pos]);
+		const WUP_Content_Entry *const p_end = &p[commandCount];
+		for (; p < p_end; p++) {
+			// FIXME: Content ID or content index?
+			// Assuming content ID for filename, content index for IV.
+			TCHAR cidbuf[16];
+			_sntprintf(cidbuf, ARRAY_SIZE(cidbuf), _T("%08x.app"), be32_to_cpu(p->content_id));
+
+			cds.emplace_back();
+			ContentDecrypt &cd = cds.back();
+			cd.entry = p;
+			snprintf(cd.cid, sizeof(cd.cid), "%08x", be32_to_cpu(p->content_id));
+			cd.sf_app = nus_dir;
+			cd.sf_app += DIR_SEP_CHR;
+			cd.sf_app += cidbuf;
+			cd.sf_out = out_dir;
+			cd.sf_out += DIR_SEP_CHR;
+			cd.sf_out += cidbuf;
+			cd.ret = 0;
+			cd.err_op = nullptr;
+			cd.out_size = 0;
+		}
+	}
+
+	if (cds.empty()) {
+		fputs("*** ERROR: TMD has no contents.\n", stderr);
+		return -ENOENT;
+	}
+
+	// Decrypt the contents in parallel.
+	// Each content is read, decrypted, and written sequentially
+	// by a single thread, so the I/O stays sequential per file.
+	if (jobs == 0) {
+		jobs = threadw_cpu_count();
+	}
+	const unsigned int content_count = static_cast<unsigned int>(cds.size());
+	const unsigned int content_jobs = std::min(std::min(jobs, content_count),
+		static_cast<unsigned int>(DECRYPT_MAX_CONTENT_JOBS));
+
+	_tprintf(_T("Decrypting %u content(s) from %s to %s...\n"), content_count, nus_dir, out_dir);
+
+	DecryptParams params;
+	params.title_key = title_key;
+	params.cds = cds.data();
+	ret = threadw_parallel_for(content_count, content_jobs, decrypt_content_worker, &params);
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR decrypting contents: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	// Print the results in TMD order.
+	ret = 0;
+	for (const ContentDecrypt &cd : cds) {
+		printf("#%d: %s.app: ", be16_to_cpu(cd.entry->index), cd.cid);
+		if (cd.ret != 0) {
+			printf("*** ERROR %s content: %s\n", cd.err_op, strerror(-cd.ret));
+			ret = 1;
+		} else {
+			printf("%llu bytes [OK]\n", static_cast<unsigned long long>(cd.out_size));
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,37 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * decrypt-nus.hpp: Decrypt the contents of an NUS directory. (Wii U)      *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_NUSRESIGN_DECRYPT_NUS_HPP__
+#define __RVTHTOOL_NUSRESIGN_DECRYPT_NUS_HPP__
+
+#include "tcharx.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 'decrypt' command.
+ *
+ * Each content is decrypted to a file with the same name in the
+ * output directory. Hashed contents have the hash area of each
+ * 64 KB block removed, so only the data areas are written.
+ *
+ * @param nus_dir	[in] NUS directory.
+ * @param out_dir	[in] Output directory. (Created if it doesn't exist.)
+ * @param jobs		[in] Maximum number of threads. (0 for the number of CPUs)
+ * @return 0 if all contents were decrypted; 1 if any contents failed; negative POSIX error code on error.
+ */
+int decrypt_nus(const TCHAR *nus_dir, const TCHAR *out_dir, unsigned int jobs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_NUSRESIGN_DECRYPT_NUS_HPP__ */
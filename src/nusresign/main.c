@@ -11,6 +11,7 @@
 
 // C includes.
 #include <getopt.h>
+#include <limits.h>
 #include <locale.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -26,6 +27,8 @@
 
 #include "resign-nus.hpp"
 #include "print-info.hpp"
+#include "decrypt-nus.hpp"
+#include "batch-nus.hpp"
 
 #ifdef __GNUC__
 # define ATTR_PRINTF(fmt, args) __attribute__ ((format (printf, (fmt), (args))))
@@ -77,14 +80,29 @@ static void print_help(const TCHAR *argv0)
 		" - Resigns the specified NUS directory in place.\n"
 		"   Default converts Retail NUS to Debug, and Debug NUS to retail.\n"
 		"\n"
+		"resign-batch rootdir/\n"
+		" - Resigns all NUS directories found in rootdir/ and its\n"
+		"   subdirectories in place. Multiple NUS directories are resigned\n"
+		"   in parallel, and a summary is shown once all of them have\n"
+		"   been processed.\n"
+		"\n"
 		"verify nusdir/\n"
 		" - Verify the content hashes.\n"
 		"\n"
+		"decrypt nusdir/ outdir/\n"
+		" - Decrypt the contents to outdir/. Hash areas are removed\n"
+		"   from hashed contents, leaving only the content data.\n"
+		"\n"
 		"Options:\n"
 		"\n"
 		"  -k, --recrypt=KEY         Recrypt the WAD using the specified KEY:\n"
 		"                            default, retail, debug\n"
 		"                            Recrypting to retail will blank out the signatures.\n"
+		"  -j, --jobs=N              Use up to N threads for verification and\n"
+		"                            decryption, or resign up to N NUS\n"
+		"                            directories at once in batch mode.\n"
+		"                            Default is the number of CPUs.\n"
+		"      --json=FILE           Write a JSON report to FILE in batch mode.\n"
 		"  -h, --help                Display this help and exit.\n"
 		"\n"
 		, stdout);
@@ -99,6 +117,13 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 	// Other values are from RVL_CryptoType_e.
 	int recrypt_key = -1;
 
+	// Number of threads for verification, decryption, and batch mode.
+	// jobs == 0: Use the number of CPUs.
+	unsigned int jobs = 0;
+
+	// JSON report filename for batch mode.
+	const TCHAR *json_filename = NULL;
+
 	((void)argc);
 	((void)argv);
 
@@ -125,12 +150,14 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 	while (true) {
 		static const struct option long_options[] = {
 			{_T("recrypt"),	required_argument,	0, _T('k')},
+			{_T("jobs"),	required_argument,	0, _T('j')},
+			{_T("json"),	required_argument,	0, _T('J')},
 			{_T("help"),	no_argument,		0, _T('h')},
 
 			{NULL, 0, 0, 0}
 		};
 
-		int c = getopt_long(argc, argv, _T("k:h"), long_options, NULL);
+		int c = getopt_long(argc, argv, _T("k:j:h"), long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -155,6 +182,23 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 				}
 				break;
 
+			case _T('j'): {
+				// Number of threads for verification, decryption, and batch mode.
+				TCHAR *endptr = NULL;
+				unsigned long n = (optarg ? _tcstoul(optarg, &endptr, 10) : 0);
+				if (!optarg || *endptr != 0 || n == 0 || n > UINT_MAX) {
+					print_error(argv[0], _T("invalid number of jobs '%s'"), (optarg ? optarg : _T("")));
+					return EXIT_FAILURE;
+				}
+				jobs = (unsigned int)n;
+				break;
+			}
+
+			case _T('J'):
+				// JSON report for batch mode.
+				json_filename = optarg;
+				break;
+
 			case _T('h'):
 				print_help(argv[0]);
 				return EXIT_SUCCESS;
@@ -188,7 +232,7 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 
 		ret = 0;
 		for (i = optind+1; i < argc; i++) {
-			ret |= print_nus_info(argv[i], false);
+			ret |= print_nus_info(argv[i], false, jobs);
 		}
 	} else if (!_tcscmp(argv[optind], _T("verify"))) {
 		// Verify a WAD.
@@ -200,15 +244,32 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 
 		ret = 0;
 		for (i = optind+1; i < argc; i++) {
-			ret |= print_nus_info(argv[i], true);
+			ret |= print_nus_info(argv[i], true, jobs);
+		}
+	} else if (!_tcscmp(argv[optind], _T("resign-batch"))) {
+		// Resign a tree of NUS directories.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("root directory not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = resign_nus_batch(argv[optind+1], recrypt_key, jobs, json_filename);
+	} else if (!_tcscmp(argv[optind], _T("decrypt"))) {
+		// Decrypt an NUS directory.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("NUS directory not specified"));
+			return EXIT_FAILURE;
+		} else if (argc < optind+3) {
+			print_error(argv[0], _T("output directory not specified"));
+			return EXIT_FAILURE;
 		}
+		ret = decrypt_nus(argv[optind+1], argv[optind+2], jobs);
 	} else if (!_tcscmp(argv[optind], _T("resign"))) {
 		// Resign an NUS directory.
 		if (argc < optind+2) {
 			print_error(argv[0], _T("NUS directory not specified"));
 			return EXIT_FAILURE;
 		}
-		ret = resign_nus(argv[optind+1], recrypt_key);
+		ret = resign_nus(argv[optind+1], recrypt_key, true, stdout, stderr);
 	} else {
 		// If the "command" corresponds to a valid directory,
 		// assume it's a filename and handle it as 'info'.
@@ -219,7 +280,7 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 			int i;
 			ret = 0;
 			for (i = optind; i < argc; i++) {
-				ret |= print_nus_info(argv[i], false);
+				ret |= print_nus_info(argv[i], false, jobs);
 			}
 		} else {
 			// Not a filename.
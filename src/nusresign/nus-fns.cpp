@@ -0,0 +1,115 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * nus-fns.cpp: General NUS functions.                                     *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "nus-fns.hpp"
+
+// libwiicrypto
+#include "libwiicrypto/aesw.h"
+#include "libwiicrypto/cert.h"
+
+// C includes.
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <io.h>
+#else /* !_WIN32 */
+# include <sys/types.h>
+# include <unistd.h>
+#endif /* _WIN32 */
+
+/**
+ * Determine the common key used to encrypt a ticket's title key.
+ * NOTE: May use CTR since CTR and WUP have the same certificates.
+ * @param pTicket	[in] Ticket.
+ * @return WUP_KEY_DEBUG for debug tickets; WUP_KEY_RETAIL otherwise.
+ */
+RVL_AES_Keys_e nus_get_common_key(const WUP_Ticket *pTicket)
+{
+	switch (cert_get_issuer_from_name(pTicket->issuer)) {
+		default:	// TODO: Show an error instead?
+		case CTR_CERT_ISSUER_PPKI_TICKET:
+		case WUP_CERT_ISSUER_PPKI_TICKET:
+			return WUP_KEY_RETAIL;
+		case CTR_CERT_ISSUER_DPKI_TICKET:
+		case WUP_CERT_ISSUER_DPKI_TICKET:
+			return WUP_KEY_DEBUG;
+	}
+}
+
+/**
+ * Decrypt a ticket's title key.
+ * @param pTicket	[in] Ticket.
+ * @param encKey	[in] Common key. (from nus_get_common_key())
+ * @param title_key	[out] Decrypted title key.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int nus_decrypt_title_key(const WUP_Ticket *pTicket, RVL_AES_Keys_e encKey, uint8_t title_key[16])
+{
+	AesCtx *const aesw = aesw_new();
+	if (!aesw) {
+		return -ENOMEM;
+	}
+
+	// IV is the 64-bit title ID, followed by zeroes.
+	uint8_t iv[16];
+	memcpy(iv, &pTicket->title_id, 8);
+	memset(&iv[8], 0, 8);
+
+	// Decrypt the title key.
+	memcpy(title_key, pTicket->enc_title_key, 16);
+	aesw_set_key(aesw, RVL_AES_Keys[encKey], 16);
+	aesw_set_iv(aesw, iv, sizeof(iv));
+	aesw_decrypt(aesw, title_key, 16);
+	aesw_free(aesw);
+	return 0;
+}
+
+/**
+ * Read data from a file at the specified offset.
+ * The file position isn't used, so multiple threads
+ * can read from the same file at once.
+ * @param f		[in] Opened file.
+ * @param buf		[out] Buffer.
+ * @param size		[in] Number of bytes to read.
+ * @param offset	[in] Starting offset.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int nus_read_at(FILE *f, uint8_t *buf, uint32_t size, int64_t offset)
+{
+#ifdef _WIN32
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f));
+	OVERLAPPED ov;
+	DWORD dwRead;
+
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = (DWORD)offset;
+	ov.OffsetHigh = (DWORD)(offset >> 32);
+	if (!ReadFile(hFile, buf, size, &dwRead, &ov) || dwRead != size) {
+		return -EIO;
+	}
+	return 0;
+#else /* !_WIN32 */
+	while (size > 0) {
+		ssize_t ret = pread(fileno(f), buf, size, (off_t)offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		} else if (ret == 0) {
+			// Short read.
+			return -EIO;
+		}
+		buf += ret;
+		size -= (uint32_t)ret;
+		offset += ret;
+	}
+	return 0;
+#endif /* _WIN32 */
+}
@@ -0,0 +1,55 @@
+/***************************************************************************
+ * RVT-H Tool: NUS Resigner                                                *
+ * nus-fns.hpp: General NUS functions.                                     *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_NUSRESIGN_NUS_FNS_HPP__
+#define __RVTHTOOL_NUSRESIGN_NUS_FNS_HPP__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "libwiicrypto/cert_store.h"
+#include "libwiicrypto/wiiu_structs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Determine the common key used to encrypt a ticket's title key.
+ * NOTE: May use CTR since CTR and WUP have the same certificates.
+ * @param pTicket	[in] Ticket.
+ * @return WUP_KEY_DEBUG for debug tickets; WUP_KEY_RETAIL otherwise.
+ */
+RVL_AES_Keys_e nus_get_common_key(const WUP_Ticket *pTicket);
+
+/**
+ * Decrypt a ticket's title key.
+ * @param pTicket	[in] Ticket.
+ * @param encKey	[in] Common key. (from nus_get_common_key())
+ * @param title_key	[out] Decrypted title key.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int nus_decrypt_title_key(const WUP_Ticket *pTicket, RVL_AES_Keys_e encKey, uint8_t title_key[16]);
+
+/**
+ * Read data from a file at the specified offset.
+ * The file position isn't used, so multiple threads
+ * can read from the same file at once.
+ * @param f		[in] Opened file.
+ * @param buf		[out] Buffer.
+ * @param size		[in] Number of bytes to read.
+ * @param offset	[in] Starting offset.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+int nus_read_at(FILE *f, uint8_t *buf, uint32_t size, int64_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_NUSRESIGN_NUS_FNS_HPP__ */
@@ -7,12 +7,14 @@
  ***************************************************************************/
 
 #include "print-info.hpp"
+#include "nus-fns.hpp"
 
 // libwiicrypto
 #include "libwiicrypto/aesw.h"
 #include "libwiicrypto/byteswap.h"
 #include "libwiicrypto/cert.h"
 #include "libwiicrypto/sig_tools.h"
+#include "libwiicrypto/threadw.h"
 #include "libwiicrypto/wiiu_structs.h"
 
 // Nettle
@@ -27,13 +29,31 @@
 #include <string.h>
 
 // C++ includes.
+#include <algorithm>
 #include <memory>
 #include <string>
+#include <vector>
+using std::string;
 using std::tstring;
 using std::unique_ptr;
+using std::vector;
 
 // Buffer size for verifying contents.
-#define READ_BUFFER_SIZE (1024*1024)
+// Contents are read in chunks of this size using positional
+// reads, so multiple threads can read the same file at once.
+// (Must be a multiple of the 64 KB hashed block size.)
+#define READ_BUFFER_SIZE (4*1024*1024)
+
+// Maximum number of threads for verifying contents.
+// Each thread uses one READ_BUFFER_SIZE buffer.
+#define VERIFY_MAX_JOBS 16
+
+// Number of hashed blocks covered by a single H3 hash. (256 MB)
+// Hashed contents are verified in ranges of this size.
+#define H3_RANGE_BLOCKS (16*16*16)
+
+// Maximum number of incorrect hashes listed for each content.
+#define VERIFY_MAX_BAD_LISTED 32
 
 /**
  * Is an issuer retail or debug?
@@ -71,351 +91,535 @@ static const char *issuer_type(RVL_Cert_Issuer issuer)
 }
 
 /**
- * Verify a content entry.
- * @param nus_dir	[in] NUS directory.
- * @param title_key	[in] Decrypted title key.
- * @param entry		[in] Content entry.
- * @return 0 if the content is verified; 1 if not; negative POSIX error code on error.
+ * Hash mismatch in a hashed content.
  */
-static int verify_content(const TCHAR *nus_dir, const uint8_t title_key[16], const WUP_Content_Entry *entry)
-{
-	// Construct the filenames.
-	// FIXME: Content ID or content index?
-	// Assuming content ID for filename, content index for IV.
-	TCHAR cidbuf[16];
-	_sntprintf(cidbuf, ARRAY_SIZE(cidbuf), _T("%08x"), be32_to_cpu(entry->content_id));
-	tstring sf_app = nus_dir;
-	sf_app += DIR_SEP_CHR;
-	sf_app += cidbuf;
-	sf_app += _T(".app");
-
-	const bool hasH3 = !!(entry->type & cpu_to_be16(0x0002));
-	tstring sf_h3;
-	if (hasH3) {
-		// H3 file is present.
-		// TODO: How is it checked?
-		sf_h3 = nus_dir;
-		sf_h3 += DIR_SEP_CHR;
-		sf_h3 += cidbuf;
-		sf_h3 += _T(".h3");
-	}
-
-	FILE *f_content = _tfopen(sf_app.c_str(), _T("rb"));
-	if (!f_content) {
-		// Error opening the content file.
-		int err = errno;
-		if (err == 0) {
-			err = EIO;
-		}
-		printf("- *** ERROR opening %s.app: %s\n", cidbuf, strerror(err));
-		return -err;
-	}
+struct BadHash {
+	uint32_t block;		// Block number
+	unsigned int level;	// Hash level (H0-H3)
+};
+
+/**
+ * Content being verified.
+ */
+struct ContentVerify {
+	const WUP_Content_Entry *entry;
+	char cid[16];		// Content ID, for error messages
+	tstring sf_app;		// Content filename
+	bool hasH3;
 
 	// H3 table depends on the size of the contents.
 	// One H3 hash == 256 MB data
 	unique_ptr<uint8_t[]> hash_h3;
-	size_t hash_h3_len = 0;
-	if (hasH3) {
-		FILE *f_h3 = _tfopen(sf_h3.c_str(), _T("rb"));
-		if (!f_h3) {
-			// Error opening the H3 file.
-			fclose(f_content);
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			printf("- *** ERROR opening %s.h3: %s\n", cidbuf, strerror(err));
-			return -err;
-		}
+	size_t hash_h3_len;
 
-		// Get the size.
-		// Should be at least SHA1_DIGEST_SIZE and a multiple of SHA1_DIGEST_SIZE.
-		// Maximum of 256*20 bytes for the H3 file, or 64 GB of coverage.
-		fseeko(f_h3, 0, SEEK_END);
-		hash_h3_len = ftello(f_h3);
-		if (hash_h3_len == 0 || hash_h3_len % SHA1_DIGEST_SIZE != 0 || hash_h3_len > (SHA1_DIGEST_SIZE * 256)) {
-			// Invalid size.
-			fclose(f_h3);
-			fclose(f_content);
-			printf("- *** ERROR reading %s.h3: Size is incorrect\n", cidbuf);
-			return -EIO;
-		}
+	// Error loading the H3 table.
+	// If set, the content isn't verified.
+	string err_msg;
 
-		rewind(f_h3);
-		hash_h3.reset(new uint8_t[hash_h3_len]);
-		errno = 0;
-		size_t size = fread(hash_h3.get(), 1, hash_h3_len, f_h3);
-		if (size != hash_h3_len) {
-			// Read error.
-			int err = errno;
-			if (errno == 0) {
-				err = EIO;
-			}
-			fclose(f_content);
-			printf("- *** ERROR reading %s.h3: %s\n", cidbuf, strerror(err));
-			return -err;
-		}
-	}
+	// Verification tasks for this content.
+	unsigned int task_start;
+	unsigned int task_count;
+};
 
-	AesCtx *const aesw = aesw_new();
-	if (!aesw) {
-		// Error initializing AES...
-		fclose(f_content);
-		return -ENOMEM;
+/**
+ * Content verification task.
+ * Hashed contents are split into H3 ranges so multiple
+ * threads can verify a single large content at once.
+ */
+struct VerifyTask {
+	ContentVerify *cv;
+	uint32_t block_start;	// First block in this range (hashed contents only)
+	uint32_t block_count;	// Number of blocks in this range (hashed contents only)
+
+	// Results
+	int err;		// 0 on success; negative POSIX error code on error
+	bool open_failed;	// If true, err is from opening the content file.
+	uint8_t digest[SHA1_DIGEST_SIZE];	// Content SHA-1 (non-hashed contents only)
+	unsigned int bad_count[4];		// Number of incorrect H0-H3 hashes
+	vector<BadHash> bad;			// Incorrect hashes, up to VERIFY_MAX_BAD_LISTED
+};
+
+/**
+ * Parameters for verify_task_worker().
+ */
+struct VerifyParams {
+	const uint8_t *title_key;	// Decrypted title key
+	VerifyTask *tasks;
+};
+
+/**
+ * Record an incorrect hash.
+ * @param task		[in,out] Verification task.
+ * @param block_number	[in] Block number.
+ * @param level		[in] Hash level. (H0-H3)
+ */
+static inline void add_bad_hash(VerifyTask *task, uint32_t block_number, unsigned int level)
+{
+	task->bad_count[level]++;
+	if (task->bad.size() < VERIFY_MAX_BAD_LISTED) {
+		BadHash bad_hash;
+		bad_hash.block = block_number;
+		bad_hash.level = level;
+		task->bad.push_back(bad_hash);
 	}
+}
 
+/**
+ * Verify a content that doesn't have an H3 table.
+ * A single SHA-1 is used for the whole content.
+ * @param f_content	[in] Opened content file.
+ * @param aesw		[in] AES context, with the title key set.
+ * @param entry		[in] Content entry.
+ * @param buf		[in] Read buffer. (READ_BUFFER_SIZE)
+ * @param digest	[out] SHA-1 of the decrypted content.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int verify_unhashed(FILE *f_content, AesCtx *aesw, const WUP_Content_Entry *entry,
+	uint8_t *buf, uint8_t digest[SHA1_DIGEST_SIZE])
+{
 	// IV is the 2-byte content index, followed by zeroes.
 	uint8_t iv[16];
 	memcpy(iv, &entry->index, 2);
 	memset(&iv[2], 0, 14);
-	aesw_set_key(aesw, title_key, 16);
 	aesw_set_iv(aesw, iv, sizeof(iv));
 
-	// Read buffer.
-	unique_ptr<uint8_t[]> buf(new uint8_t[READ_BUFFER_SIZE]);
+	const int64_t data_sz = be64_to_cpu(entry->size);
+	struct sha1_ctx sha1;
+	sha1_init(&sha1);
+	for (int64_t offset = 0; offset < data_sz; offset += READ_BUFFER_SIZE) {
+		uint32_t size = READ_BUFFER_SIZE;
+		if (data_sz - offset < size) {
+			size = (uint32_t)(data_sz - offset);
+		}
 
-	// Read the content, decrypt it, and hash it.
-	// TODO: Verify size; check fseeko() errors.
-	int64_t data_sz = be64_to_cpu(entry->size);
+		// NOTE: AES works on 16-byte blocks, so we have to
+		// read and decrypt the full 16-byte block. The SHA-1
+		// is only taken for the actual used data, though.
+		const uint32_t size_align = ALIGN_BYTES(16, size);
+		int ret = nus_read_at(f_content, buf, size_align, offset);
+		if (ret != 0) {
+			return ret;
+		}
 
-	int ret = 0;
-	if (!hasH3) {
-		// No H3 table. A single SHA-1 is used for the whole content.
-		struct sha1_ctx sha1;
-		sha1_init(&sha1);
-		for (; data_sz >= READ_BUFFER_SIZE; data_sz -= READ_BUFFER_SIZE) {
-			errno = 0;
-			size_t size = fread(buf.get(), 1, READ_BUFFER_SIZE, f_content);
-			if (size != READ_BUFFER_SIZE) {
-				ret = errno;
-				if (ret == 0) {
-					ret = -EIO;
-				}
-				goto end;
-			}
+		// CBC state carries over from the previous chunk.
+		aesw_decrypt(aesw, buf, size_align);
+		sha1_update(&sha1, size, buf);
+	}
+
+	sha1_digest(&sha1, SHA1_DIGEST_SIZE, digest);
+	return 0;
+}
 
-			// Decrypt the data.
-			aesw_decrypt(aesw, buf.get(), READ_BUFFER_SIZE);
+/**
+ * Verify a single block in a hashed content.
+ * @param aesw		[in] AES context, with the title key set.
+ * @param task		[in,out] Verification task.
+ * @param block		[in,out] Encrypted block. (Decrypted in place.)
+ * @param block_number	[in] Block number.
+ */
+static void verify_hashed_block(AesCtx *aesw, VerifyTask *task, WUP_Hashed_Block *block, uint32_t block_number)
+{
+	static const uint8_t zero_iv[16] = {0};
+	const ContentVerify *const cv = task->cv;
+	sha1_ctx sha1;
+	uint8_t digest[SHA1_DIGEST_SIZE];
+
+	// Decrypt the hashes. (zero IV)
+	aesw_set_iv(aesw, zero_iv, sizeof(zero_iv));
+	aesw_decrypt(aesw, reinterpret_cast<uint8_t*>(&block->hashes), sizeof(block->hashes));
+
+	// Decrypt the data.
+	// IV is one of the decrypted hashes.
+	const uint8_t *const pHashH0_expected = block->hashes.h0[block_number % 16];
+	aesw_set_iv(aesw, pHashH0_expected, 16);
+	aesw_decrypt(aesw, block->data, sizeof(block->data));
+
+	// Verify the H0 hash.
+	sha1_init(&sha1);
+	sha1_update(&sha1, sizeof(block->data), block->data);
+	sha1_digest(&sha1, sizeof(digest), digest);
+	if (memcmp(digest, pHashH0_expected, sizeof(digest)) != 0) {
+		add_bad_hash(task, block_number, 0);
+	}
 
-			// Update the SHA-1.
-			sha1_update(&sha1, READ_BUFFER_SIZE, buf.get());
-		}
+	if (block_number % 16 == 0) {
+		// Verify the H1 hash. (New H0 table)
+		// TODO: Verify that the other identical H0 hash tables match.
+		sha1_init(&sha1);
+		sha1_update(&sha1, sizeof(block->hashes.h0), &block->hashes.h0[0][0]);
+		sha1_digest(&sha1, sizeof(digest), digest);
 
-		// Remaining data.
-		if (data_sz > 0) {
-			// NOTE: AES works on 16-byte blocks, so we have to
-			// read and decrypt the full 16-byte block. The SHA-1
-			// is only taken for the actual used data, though.
-			uint32_t data_sz_align = ALIGN_BYTES(16, data_sz);
-
-			errno = 0;
-			size_t size = fread(buf.get(), 1, data_sz_align, f_content);
-			if (size != data_sz_align) {
-				ret = errno;
-				if (ret == 0) {
-					ret = -EIO;
-				}
-				goto end;
-			}
+		unsigned int h1_idx = (block_number / 16) % 16;
+		if (memcmp(digest, block->hashes.h1[h1_idx], sizeof(digest))) {
+			add_bad_hash(task, block_number, 1);
+		}
+	}
 
-			// Decrypt the data.
-			aesw_decrypt(aesw, buf.get(), data_sz_align);
+	if (block_number % (16*16) == 0) {
+		// Verify the H2 hash. (New H1 table)
+		// TODO: Verify that the other identical H1 hash tables match.
+		sha1_init(&sha1);
+		sha1_update(&sha1, sizeof(block->hashes.h1), &block->hashes.h1[0][0]);
+		sha1_digest(&sha1, sizeof(digest), digest);
 
-			// Update the SHA-1.
-			// NOTE: Only uses the actual content, not the
-			// aligned data required for decryption.
-			sha1_update(&sha1, data_sz, buf.get());
+		unsigned int h2_idx = (block_number / (16*16)) % 16;
+		if (memcmp(digest, block->hashes.h2[h2_idx], sizeof(digest))) {
+			add_bad_hash(task, block_number, 2);
 		}
+	}
 
-		// Finalize the SHA-1 and compare it.
-		uint8_t digest[SHA1_DIGEST_SIZE];
+	if (block_number % H3_RANGE_BLOCKS == 0) {
+		// Verify the H3 hash. (New H2 table)
+		// TODO: Verify that the other identical H2 hash tables match.
+		sha1_init(&sha1);
+		sha1_update(&sha1, sizeof(block->hashes.h2), &block->hashes.h2[0][0]);
 		sha1_digest(&sha1, sizeof(digest), digest);
-		fputs("- Expected SHA-1: ", stdout);
-		for (size_t size = 0; size < sizeof(entry->sha1_hash); size++) {
-			printf("%02x", entry->sha1_hash[size]);
+
+		size_t h3_byte_pos = (block_number / H3_RANGE_BLOCKS) * SHA1_DIGEST_SIZE;
+		if (h3_byte_pos + SHA1_DIGEST_SIZE > cv->hash_h3_len) {
+			// Out of bounds...
+			add_bad_hash(task, block_number, 3);
+		} else if (memcmp(digest, &cv->hash_h3[h3_byte_pos], sizeof(digest))) {
+			add_bad_hash(task, block_number, 3);
 		}
-		putchar('\n');
-		printf("- Actual SHA-1:   ");
-		for (size_t size = 0; size < sizeof(digest); size++) {
-			printf("%02x", digest[size]);
+	}
+}
+
+/**
+ * Verify a range of blocks in a hashed content.
+ * @param f_content	[in] Opened content file.
+ * @param aesw		[in] AES context, with the title key set.
+ * @param task		[in,out] Verification task.
+ * @param buf		[in] Read buffer. (READ_BUFFER_SIZE)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int verify_hashed_range(FILE *f_content, AesCtx *aesw, VerifyTask *task, uint8_t *buf)
+{
+	static const uint32_t buf_blocks = READ_BUFFER_SIZE / WUP_HASHED_BLOCK_SIZE;
+	const uint32_t block_end = task->block_start + task->block_count;
+
+	uint32_t block_number = task->block_start;
+	while (block_number < block_end) {
+		const uint32_t count = std::min(buf_blocks, block_end - block_number);
+		int ret = nus_read_at(f_content, buf, count * WUP_HASHED_BLOCK_SIZE,
+			(int64_t)block_number * WUP_HASHED_BLOCK_SIZE);
+		if (ret != 0) {
+			return ret;
 		}
-		if (!memcmp(digest, entry->sha1_hash, SHA1_DIGEST_SIZE)) {
-			fputs(" [OK]\n", stdout);
-		} else {
-			fputs(" [ERROR]\n", stdout);
-			ret = 1;
+
+		WUP_Hashed_Block *block = reinterpret_cast<WUP_Hashed_Block*>(buf);
+		for (uint32_t i = 0; i < count; i++, block++, block_number++) {
+			verify_hashed_block(aesw, task, block, block_number);
 		}
-	} else {
-		// Has an H3 table. Content is encrypted in 64 KB blocks.
-		// H3 hash is the hash of all H2 tables for every 256 MB block.
-		// IV starts in hashes[block number % 16].
-		// TODO: Verify that the content is a multiple of 64 KB?
-		struct EncBlock {
-			// One hash block covers a 1 MB superblock.
-			struct {
-				// 16 H0 hashes, each of which covers the data area (63 KB) of one 64 KB block.
-				// For every megabyte of data, all 64 KB blocks have the same H0 hashes.
-				uint8_t h0[16][SHA1_DIGEST_SIZE];
-				// 16 H1 hashes, each of which covers the H0 table for a given 1 MB block.
-				// For every 16 MB of data, all 64 KB blocks have the same H1 hashes.
-				uint8_t h1[16][SHA1_DIGEST_SIZE];
-				// 16 H2 hashes, each of which covers the H1 table for a given 16 MB block.
-				// For every 256 MB of data, all 64 KB blocks have the same H2 hashes.
-				uint8_t h2[16][SHA1_DIGEST_SIZE];
-
-				// Unused
-				uint8_t unused[64];
-			} hashes;
-			uint8_t data[0xFC00];
-		};
-
-		// H0 == hash of a single block
-		// H1 == hash of 16 H0 hashes
-		// H2 == hash of 16 H1 hashes
-		// H3 == hash of all H2 hashes
-		// H4 == hash of the H3 hash, stored in the content entry
-
-		// Were any bad hashes found?
-		unsigned int bad_hash[4] = {0, 0, 0, 0};
-
-		#define ENC_BLOCK_SIZE 0x10000
-		#define DEC_BLOCK_SIZE 0xFC00
-
-		// Zero IV for hashes.
-		uint8_t zero_iv[16];
-		memset(zero_iv, 0, sizeof(zero_iv));
-
-		EncBlock *const block = reinterpret_cast<EncBlock*>(buf.get());
-		unsigned int block_number = 0;
-		for (; data_sz >= ENC_BLOCK_SIZE; data_sz -= ENC_BLOCK_SIZE, block_number++) {
-			sha1_ctx sha1;
-			uint8_t digest[SHA1_DIGEST_SIZE];
-
-			errno = 0;
-			size_t size = fread(block, 1, sizeof(*block), f_content);
-			if (size != sizeof(*block)) {
-				ret = errno;
-				if (ret == 0) {
-					ret = -EIO;
-				}
-				goto end;
-			}
+	}
 
-			// Decrypt the hashes. (zero IV)
-			aesw_set_iv(aesw, zero_iv, sizeof(zero_iv));
-			aesw_decrypt(aesw, reinterpret_cast<uint8_t*>(&block->hashes), sizeof(block->hashes));
-
-			// Decrypt the data.
-			// IV is one of the decrypted hashes.
-			const uint8_t *const pHashH0_expected = block->hashes.h0[block_number % 16];
-			aesw_set_iv(aesw, pHashH0_expected, 16);
-			aesw_decrypt(aesw, block->data, sizeof(block->data));
-
-			// Verify the H0 hash.
-			sha1_init(&sha1);
-			sha1_update(&sha1, sizeof(block->data), block->data);
-			sha1_digest(&sha1, sizeof(digest), digest);
-			if (memcmp(digest, pHashH0_expected, sizeof(digest)) != 0) {
-				// TODO: Print an error here?
-				//fprintf(stderr, "- *** ERROR: H0 hash bad at block %u\n", block_number);
-				bad_hash[0]++;
-				ret = 1;
-			}
+	return 0;
+}
 
-			if (block_number % 16 == 0) {
-				// Verify the H1 hash. (New H0 table)
-				// TODO: Verify that the other identical H0 hash tables match.
-				sha1_init(&sha1);
-				sha1_update(&sha1, sizeof(block->hashes.h0), &block->hashes.h0[0][0]);
-				sha1_digest(&sha1, sizeof(digest), digest);
+/**
+ * Verification task worker for threadw_parallel_for().
+ * @param index		[in] Task index.
+ * @param userdata	[in] VerifyParams
+ */
+static void verify_task_worker(unsigned int index, void *userdata)
+{
+	const VerifyParams *const params = static_cast<const VerifyParams*>(userdata);
+	VerifyTask *const task = &params->tasks[index];
+	const ContentVerify *const cv = task->cv;
 
-				unsigned int h1_idx = (block_number / 16) % 16;
-				if (memcmp(digest, block->hashes.h1[h1_idx], sizeof(digest))) {
-					bad_hash[1]++;
-				}
-			}
+	// Each task has its own file handle.
+	FILE *f_content = _tfopen(cv->sf_app.c_str(), _T("rb"));
+	if (!f_content) {
+		// Error opening the content file.
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		task->err = -err;
+		task->open_failed = true;
+		return;
+	}
 
-			if (block_number % (16*16) == 0) {
-				// Verify the H2 hash. (New H1 table)
-				// TODO: Verify that the other identical H1 hash tables match.
-				sha1_init(&sha1);
-				sha1_update(&sha1, sizeof(block->hashes.h1), &block->hashes.h1[0][0]);
-				sha1_digest(&sha1, sizeof(digest), digest);
+	AesCtx *const aesw = aesw_new();
+	if (!aesw) {
+		// Error initializing AES...
+		fclose(f_content);
+		task->err = -ENOMEM;
+		return;
+	}
+	aesw_set_key(aesw, params->title_key, 16);
 
-				unsigned int h2_idx = (block_number / (16*16)) % 16;
-				if (memcmp(digest, block->hashes.h2[h2_idx], sizeof(digest))) {
-					bad_hash[2]++;
-				}
-			}
+	unique_ptr<uint8_t[]> buf(new uint8_t[READ_BUFFER_SIZE]);
+	if (!cv->hasH3) {
+		task->err = verify_unhashed(f_content, aesw, cv->entry, buf.get(), task->digest);
+	} else {
+		task->err = verify_hashed_range(f_content, aesw, task, buf.get());
+	}
 
-			if (block_number % (16*16*16) == 0) {
-				// Verify the H3 hash. (New H2 table)
-				// TODO: Verify that the other identical H2 hash tables match.
-				sha1_init(&sha1);
-				sha1_update(&sha1, sizeof(block->hashes.h2), &block->hashes.h2[0][0]);
-				sha1_digest(&sha1, sizeof(digest), digest);
-
-				unsigned int h3_byte_pos = (block_number / (16*16*16)) * SHA1_DIGEST_SIZE;
-				if (h3_byte_pos + SHA1_DIGEST_SIZE > hash_h3_len) {
-					// Out of bounds...
-					bad_hash[3]++;
-				} else {
-					if (memcmp(digest, &hash_h3[h3_byte_pos], sizeof(digest))) {
-						bad_hash[3]++;
-					}
-				}
-			}
+	fclose(f_content);
+	aesw_free(aesw);
+}
+
+/**
+ * Load the H3 table for a content.
+ * @param nus_dir	[in] NUS directory.
+ * @param cv		[in,out] Content being verified.
+ * @return 0 on success; negative POSIX error code on error. (cv->err_msg is set.)
+ */
+static int load_h3_table(const TCHAR *nus_dir, ContentVerify *cv)
+{
+	char msgbuf[128];
+
+	TCHAR cidbuf[16];
+	_sntprintf(cidbuf, ARRAY_SIZE(cidbuf), _T("%08x"), be32_to_cpu(cv->entry->content_id));
+	tstring sf_h3 = nus_dir;
+	sf_h3 += DIR_SEP_CHR;
+	sf_h3 += cidbuf;
+	sf_h3 += _T(".h3");
+
+	FILE *f_h3 = _tfopen(sf_h3.c_str(), _T("rb"));
+	if (!f_h3) {
+		// Error opening the H3 file.
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
 		}
+		snprintf(msgbuf, sizeof(msgbuf), "ERROR opening %s.h3: %s", cv->cid, strerror(err));
+		cv->err_msg = msgbuf;
+		return -err;
+	}
 
-		bool showH4status = true;
-		for (unsigned int i = 0; i < 3; i++) {
-			if (bad_hash[i] != 0) {
-				printf("- ERROR: %u H%u hash(es) were incorrect.\n", bad_hash[i], i);
-				showH4status = false;
-				ret = 1;
-			}
+	// Get the size.
+	// Should be at least SHA1_DIGEST_SIZE and a multiple of SHA1_DIGEST_SIZE.
+	// Maximum of 256*20 bytes for the H3 file, or 64 GB of coverage.
+	fseeko(f_h3, 0, SEEK_END);
+	cv->hash_h3_len = ftello(f_h3);
+	if (cv->hash_h3_len == 0 || cv->hash_h3_len % SHA1_DIGEST_SIZE != 0 || cv->hash_h3_len > (SHA1_DIGEST_SIZE * 256)) {
+		// Invalid size.
+		fclose(f_h3);
+		snprintf(msgbuf, sizeof(msgbuf), "ERROR reading %s.h3: Size is incorrect", cv->cid);
+		cv->err_msg = msgbuf;
+		return -EIO;
+	}
+
+	rewind(f_h3);
+	cv->hash_h3.reset(new uint8_t[cv->hash_h3_len]);
+	errno = 0;
+	size_t size = fread(cv->hash_h3.get(), 1, cv->hash_h3_len, f_h3);
+	if (size != cv->hash_h3_len) {
+		// Read error.
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
 		}
+		fclose(f_h3);
+		snprintf(msgbuf, sizeof(msgbuf), "ERROR reading %s.h3: %s", cv->cid, strerror(err));
+		cv->err_msg = msgbuf;
+		return -err;
+	}
+
+	fclose(f_h3);
+	return 0;
+}
+
+/**
+ * Print a SHA-1 comparison.
+ * @param expected	[in] Expected SHA-1.
+ * @param actual	[in] Actual SHA-1.
+ * @param suffix	[in] Suffix for each line. ("" for none)
+ * @param show_status	[in] If true, show [OK] or [ERROR].
+ * @return 0 if the hashes match or the status isn't shown; 1 if they don't match.
+ */
+static int print_sha1_compare(const uint8_t *expected, const uint8_t *actual,
+	const char *suffix, bool show_status)
+{
+	fputs("- Expected SHA-1: ", stdout);
+	for (size_t size = 0; size < SHA1_DIGEST_SIZE; size++) {
+		printf("%02x", expected[size]);
+	}
+	printf("%s\n", suffix);
+	printf("- Actual SHA-1:   ");
+	for (size_t size = 0; size < SHA1_DIGEST_SIZE; size++) {
+		printf("%02x", actual[size]);
+	}
+
+	if (!show_status) {
+		printf("%s\n", suffix);
+		return 0;
+	} else if (!memcmp(actual, expected, SHA1_DIGEST_SIZE)) {
+		printf(" [OK]%s\n", suffix);
+		return 0;
+	}
+	printf(" [ERROR]%s\n", suffix);
+	return 1;
+}
 
-		// Verify the H4 SHA-1, which is stored in the content entry.
-		uint8_t digest[SHA1_DIGEST_SIZE];
-		sha1_ctx sha1_h4;
-		sha1_init(&sha1_h4);
-		sha1_update(&sha1_h4, hash_h3_len, hash_h3.get());
-		sha1_digest(&sha1_h4, sizeof(digest), digest);
-		fputs("- Expected SHA-1: ", stdout);
-		for (size_t size = 0; size < sizeof(entry->sha1_hash); size++) {
-			printf("%02x", entry->sha1_hash[size]);
+/**
+ * Print the verification results for a content.
+ * @param cv		[in] Content.
+ * @param tasks		[in] Verification tasks. (all contents)
+ * @return 0 if the content is verified; 1 if not; negative POSIX error code on error.
+ */
+static int print_content_verify(const ContentVerify *cv, const VerifyTask *tasks)
+{
+	if (!cv->err_msg.empty()) {
+		// Error loading the H3 table.
+		printf("- *** %s\n", cv->err_msg.c_str());
+		return -EIO;
+	}
+
+	const VerifyTask *const task_start = &tasks[cv->task_start];
+	const VerifyTask *const task_end = &task_start[cv->task_count];
+	for (const VerifyTask *task = task_start; task < task_end; task++) {
+		if (task->err != 0) {
+			printf("- *** ERROR %s %s.app: %s\n",
+				(task->open_failed ? "opening" : "reading"),
+				cv->cid, strerror(-task->err));
+			return task->err;
 		}
-		fputs(" (H4)\n", stdout);
-		printf("- Actual SHA-1:   ");
-		for (size_t size = 0; size < sizeof(digest); size++) {
-			printf("%02x", digest[size]);
+	}
+
+	if (!cv->hasH3) {
+		return print_sha1_compare(cv->entry->sha1_hash, task_start->digest, "", true);
+	}
+
+	// Were any bad hashes found?
+	unsigned int bad_hash[4] = {0, 0, 0, 0};
+	for (const VerifyTask *task = task_start; task < task_end; task++) {
+		for (unsigned int i = 0; i < 4; i++) {
+			bad_hash[i] += task->bad_count[i];
 		}
-		if (showH4status) {
-			if (!memcmp(digest, entry->sha1_hash, SHA1_DIGEST_SIZE)) {
-				fputs(" [OK] (H4)\n", stdout);
-			} else {
-				fputs(" [ERROR] (H4)\n", stdout);
-				ret = 1;
+	}
+
+	int ret = 0;
+	bool showH4status = true;
+	for (unsigned int i = 0; i < 4; i++) {
+		if (bad_hash[i] != 0) {
+			printf("- ERROR: %u H%u hash(es) were incorrect.\n", bad_hash[i], i);
+			showH4status = false;
+			ret = 1;
+		}
+	}
+
+	if (ret != 0) {
+		// List the incorrect hashes by block number.
+		// Tasks are in block order, so the list is sorted.
+		unsigned int listed = 0;
+		unsigned int total = 0;
+		for (const VerifyTask *task = task_start; task < task_end; task++) {
+			for (const BadHash &bad : task->bad) {
+				if (listed < VERIFY_MAX_BAD_LISTED) {
+					printf("- *** H%u hash mismatch at block %u\n", bad.level, bad.block);
+					listed++;
+				}
+			}
+			for (unsigned int i = 0; i < 4; i++) {
+				total += task->bad_count[i];
 			}
-		} else {
-			fputs(" (H4)\n", stdout);
+		}
+		if (total > listed) {
+			printf("- *** (%u more hash mismatches not shown)\n", total - listed);
 		}
 	}
 
-end:
-	fclose(f_content);
-	aesw_free(aesw);
+	// Verify the H4 SHA-1, which is stored in the content entry.
+	uint8_t digest[SHA1_DIGEST_SIZE];
+	sha1_ctx sha1_h4;
+	sha1_init(&sha1_h4);
+	sha1_update(&sha1_h4, cv->hash_h3_len, cv->hash_h3.get());
+	sha1_digest(&sha1_h4, sizeof(digest), digest);
+	if (print_sha1_compare(cv->entry->sha1_hash, digest, " (H4)", showH4status) != 0) {
+		ret = 1;
+	}
 	return ret;
 }
 
+/**
+ * Verify contents in parallel.
+ * Hashed contents are split into 256 MB H3 ranges, which are
+ * verified as separate tasks, so large contents can use multiple
+ * threads. The results are stored in the tasks, and must be
+ * printed using print_content_verify().
+ * @param nus_dir	[in] NUS directory.
+ * @param title_key	[in] Decrypted title key.
+ * @param cvs		[in,out] Contents to verify.
+ * @param tasks		[out] Verification tasks.
+ * @param jobs		[in] Maximum number of threads. (0 for the number of CPUs)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int verify_contents(const TCHAR *nus_dir, const uint8_t title_key[16],
+	vector<ContentVerify> &cvs, vector<VerifyTask> &tasks, unsigned int jobs)
+{
+	for (ContentVerify &cv : cvs) {
+		// Construct the filenames.
+		// FIXME: Content ID or content index?
+		// Assuming content ID for filename, content index for IV.
+		TCHAR cidbuf[16];
+		_sntprintf(cidbuf, ARRAY_SIZE(cidbuf), _T("%08x"), be32_to_cpu(cv.entry->content_id));
+		snprintf(cv.cid, sizeof(cv.cid), "%08x", be32_to_cpu(cv.entry->content_id));
+		cv.sf_app = nus_dir;
+		cv.sf_app += DIR_SEP_CHR;
+		cv.sf_app += cidbuf;
+		cv.sf_app += _T(".app");
+
+		cv.hasH3 = !!(cv.entry->type & cpu_to_be16(WUP_CONTENT_TYPE_HASHED));
+		cv.hash_h3_len = 0;
+		cv.task_start = static_cast<unsigned int>(tasks.size());
+		cv.task_count = 0;
+		if (cv.hasH3 && load_h3_table(nus_dir, &cv) != 0) {
+			// Error loading the H3 table.
+			// The content won't be verified.
+			continue;
+		}
+
+		// Hashed contents have one task per H3 range.
+		// TODO: Verify that the content is a multiple of 64 KB?
+		const uint32_t nblocks = cv.hasH3
+			? static_cast<uint32_t>(be64_to_cpu(cv.entry->size) / WUP_HASHED_BLOCK_SIZE)
+			: 0;
+		uint32_t block = 0;
+		do {
+			VerifyTask task;
+			task.cv = &cv;
+			task.block_start = block;
+			task.block_count = std::min<uint32_t>(H3_RANGE_BLOCKS, nblocks - block);
+			task.err = 0;
+			task.open_failed = false;
+			memset(task.digest, 0, sizeof(task.digest));
+			memset(task.bad_count, 0, sizeof(task.bad_count));
+			tasks.push_back(std::move(task));
+			cv.task_count++;
+			block += H3_RANGE_BLOCKS;
+		} while (block < nblocks);
+	}
+
+	if (tasks.empty()) {
+		// Nothing to verify.
+		return 0;
+	}
+
+	if (jobs == 0) {
+		jobs = threadw_cpu_count();
+	}
+	if (jobs > VERIFY_MAX_JOBS) {
+		jobs = VERIFY_MAX_JOBS;
+	}
+
+	VerifyParams params;
+	params.title_key = title_key;
+	params.tasks = tasks.data();
+	return threadw_parallel_for(static_cast<unsigned int>(tasks.size()), jobs,
+		verify_task_worker, &params);
+}
+
 /**
  * 'info' command.
  * @param nus_dir	[in] NUS directory.
- * @param verify	[in] If true, verify the contents. [TODO]
+ * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_nus_info(const TCHAR *nus_dir, bool verify)
+int print_nus_info(const TCHAR *nus_dir, bool verify, unsigned int jobs)
 {
 	// Construct the filenames.
 	tstring sf_tik = nus_dir;
@@ -519,21 +723,8 @@ int print_nus_info(const TCHAR *nus_dir, bool verify)
 	// Determine the encryption key in use.
 	// NOTE: May use CTR since CTR and WUP have the same certificates.
 	RVL_Cert_Issuer issuer_ticket = cert_get_issuer_from_name(pTicket->issuer);
-	RVL_AES_Keys_e encKey;
-	const char *s_encKey;
-	switch (issuer_ticket) {
-		default:	// TODO: Show an error instead?
-		case CTR_CERT_ISSUER_PPKI_TICKET:
-		case WUP_CERT_ISSUER_PPKI_TICKET:
-			encKey = WUP_KEY_RETAIL;
-			s_encKey = "Retail";
-			break;
-		case CTR_CERT_ISSUER_DPKI_TICKET:
-		case WUP_CERT_ISSUER_DPKI_TICKET:
-			encKey = WUP_KEY_DEBUG;
-			s_encKey = "Debug";
-			break;
-	}
+	const RVL_AES_Keys_e encKey = nus_get_common_key(pTicket);
+	const char *const s_encKey = (encKey == WUP_KEY_DEBUG ? "Debug" : "Retail");
 	printf("- Encryption:    %s\n", s_encKey);
 
 	// Check the ticket issuer and signature.
@@ -608,25 +799,13 @@ int print_nus_info(const TCHAR *nus_dir, bool verify)
 	// Decrypted title key for contents verification.
 	uint8_t title_key[16];
 	if (verify) {
-		AesCtx *const aesw = aesw_new();
-		if (aesw) {
-			// IV is the 64-bit title ID, followed by zeroes.
-			uint8_t iv[16];
-			memcpy(iv, &pTicket->title_id, 8);
-			memset(&iv[8], 0, 8);
-
-			// Decrypt the title key.
-			memcpy(title_key, pTicket->enc_title_key, sizeof(title_key));
-			aesw_set_key(aesw, RVL_AES_Keys[encKey], 16);
-			aesw_set_iv(aesw, iv, sizeof(iv));
-			aesw_decrypt(aesw, title_key, sizeof(title_key));
-		} else {
+		if (nus_decrypt_title_key(pTicket, encKey, title_key) != 0) {
 			// TODO: Print a warning message indicating we can't decrypt.
 			verify = false;
 		}
 	}
 
-	// Print the TMD contents info.
+	// Collect the TMD content entries.
 	// TODO: Show the separate contents tables?
 	// We're lumping everything together right now.
 	const uint16_t boot_index = be16_to_cpu(pTmdHeader->rvl.boot_index);
@@ -636,7 +815,7 @@ int print_nus_info(const TCHAR *nus_dir, bool verify)
 	const WUP_ContentInfo *const cinfo_end = &cinfo[WUP_CONTENTINFO_ENTRIES];
 
 	size_t cstart = sizeof(WUP_TMD_Header) + sizeof(WUP_TMD_ContentInfoTable);
-	int ret = 0;
+	vector<ContentVerify> cvs;
 	for (; cinfo < cinfo_end; cinfo++) {
 		const unsigned int indexOffset = be16_to_cpu(cinfo->indexOffset);
 		const unsigned int commandCount = be16_to_cpu(cinfo->commandCount);
@@ -652,32 +831,48 @@ int print_nus_info(const TCHAR *nus_dir, bool verify)
 			continue;
 		}
 
-		// Print the entries.
 		const WUP_Content_Entry *p =
 			reinterpret_cast<const WUP_Content_Entry*>(&tmd_data[pos]);
 		const WUP_Content_Entry *const p_end = &p[commandCount];
 		for (; p < p_end; p++) {
-			// TODO: Show the actual table index, or just the
-			// index field in the entry?
-			uint16_t content_index = be16_to_cpu(p->index);
-			printf("#%d: ID=%08x, type=%04X, size=%u",
-				be16_to_cpu(p->index),
-				be32_to_cpu(p->content_id),
-				be16_to_cpu(p->type),
-				(uint32_t)be64_to_cpu(p->size));
-			if (content_index == boot_index) {
-				fputs(", bootable", stdout);
-			}
-			putchar('\n');
-
-			if (verify) {
-				// Verify the content.
-				// TODO: Only decrypt the title key once?
-				// TODO: Return failure if any contents fail.
-				int vret = verify_content(nus_dir, title_key, p);
-				if (vret != 0) {
-					ret = 1;
-				}
+			cvs.emplace_back();
+			cvs.back().entry = p;
+		}
+	}
+
+	// Verify the contents in parallel.
+	// The results are printed in TMD order below.
+	vector<VerifyTask> tasks;
+	if (verify) {
+		int vret = verify_contents(nus_dir, title_key, cvs, tasks, jobs);
+		if (vret != 0) {
+			fprintf(stderr, "*** ERROR verifying contents: %s\n", strerror(-vret));
+			return vret;
+		}
+	}
+
+	// Print the entries.
+	int ret = 0;
+	for (const ContentVerify &cv : cvs) {
+		const WUP_Content_Entry *const p = cv.entry;
+
+		// TODO: Show the actual table index, or just the
+		// index field in the entry?
+		uint16_t content_index = be16_to_cpu(p->index);
+		printf("#%d: ID=%08x, type=%04X, size=%u",
+			be16_to_cpu(p->index),
+			be32_to_cpu(p->content_id),
+			be16_to_cpu(p->type),
+			(uint32_t)be64_to_cpu(p->size));
+		if (content_index == boot_index) {
+			fputs(", bootable", stdout);
+		}
+		putchar('\n');
+
+		if (verify) {
+			int vret = print_content_verify(&cv, tasks.data());
+			if (vret != 0) {
+				ret = 1;
 			}
 		}
 	}
@@ -25,10 +25,11 @@ extern "C" {
 /**
  * 'info' command.
  * @param nus_dir	[in] NUS directory.
- * @param verify	[in] If true, verify the contents. [TODO]
+ * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_nus_info(const TCHAR *nus_dir, bool verify);
+int print_nus_info(const TCHAR *nus_dir, bool verify, unsigned int jobs);
 
 #ifdef __cplusplus
 }
@@ -126,16 +126,21 @@ static void updateExtraCerts(uint8_t *data, size_t size, bool isTMD, RVL_PKI pki
  * 'resign' command.
  * @param nus_dir	[in] NUS directory.
  * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param show_info	[in] If true, print the NUS information first. (always printed to stdout)
+ * @param f_out		[in] Output stream for status messages.
+ * @param f_err		[in] Output stream for error messages.
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int resign_nus(const TCHAR *nus_dir, int recrypt_key)
+int resign_nus(const TCHAR *nus_dir, int recrypt_key, bool show_info, FILE *f_out, FILE *f_err)
 {
-	// Print the NUS information.
-	// TODO: Should we verify the hashes?
-	int ret = print_nus_info(nus_dir, false);
-	if (ret != 0) {
-		// Error printing the NUS information.
-		return ret;
+	if (show_info) {
+		// Print the NUS information.
+		// TODO: Should we verify the hashes?
+		int ret = print_nus_info(nus_dir, false, 1);
+		if (ret != 0) {
+			// Error printing the NUS information.
+			return ret;
+		}
 	}
 
 	// Construct the filenames.
@@ -154,7 +159,7 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR opening ticket file: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR opening ticket file: %s\n", strerror(err));
 		return -err;
 	}
 
@@ -166,7 +171,7 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR opening TMD file: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR opening TMD file: %s\n", strerror(err));
 		return -err;
 	}
 
@@ -176,12 +181,12 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 	if (tik_size < sizeof(WUP_Ticket)) {
 		fclose(f_tik);
 		fclose(f_tmd);
-		fprintf(stderr, "*** ERROR reading ticket file: Too small.\n");
+		fprintf(f_err, "*** ERROR reading ticket file: Too small.\n");
 		return -EIO;
 	} else if (tik_size > (64*1024)) {
 		fclose(f_tik);
 		fclose(f_tmd);
-		fprintf(stderr, "*** ERROR reading ticket file: Too big.\n");
+		fprintf(f_err, "*** ERROR reading ticket file: Too big.\n");
 		return -EIO;
 	}
 	fseeko(f_tmd, 0, SEEK_END);
@@ -189,12 +194,12 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 	if (tmd_size < (sizeof(WUP_TMD_Header) + sizeof(WUP_TMD_ContentInfoTable))) {
 		fclose(f_tik);
 		fclose(f_tmd);
-		fprintf(stderr, "*** ERROR reading TMD file: Too small.\n");
+		fprintf(f_err, "*** ERROR reading TMD file: Too small.\n");
 		return -EIO;
 	} else if (tmd_size > (128*1024)) {
 		fclose(f_tik);
 		fclose(f_tmd);
-		fprintf(stderr, "*** ERROR reading TMD file: Too big.\n");
+		fprintf(f_err, "*** ERROR reading TMD file: Too big.\n");
 		return -EIO;
 	}
 	rewind(f_tik);
@@ -227,8 +232,10 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 			s_fromKey = "debug";
 			break;
 		default:
-			fputs("*** ERROR: NUS ticket has an unknown issuer.\n", stderr);
-			printf("issuer: %s == %d\n", pTicket->issuer, cert_get_issuer_from_name(pTicket->issuer));
+			fputs("*** ERROR: NUS ticket has an unknown issuer.\n", f_err);
+			fprintf(f_err, "issuer: %s == %d\n", pTicket->issuer, cert_get_issuer_from_name(pTicket->issuer));
+			fclose(f_tik);
+			fclose(f_tmd);
 			return 1;
 	}
 
@@ -241,7 +248,9 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 	} else {
 		// If the specified key matches the current key, fail.
 		if (recrypt_key == src_key) {
-			fputs("*** ERROR: Cannot recrypt to the same key.\n", stderr);
+			fputs("*** ERROR: Cannot recrypt to the same key.\n", f_err);
+			fclose(f_tik);
+			fclose(f_tmd);
 			return 2;
 		}
 	}
@@ -274,12 +283,14 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		default:
 			// Shouldn't get here...
 			assert(!"Invalid crypto type...");
+			fclose(f_tik);
+			fclose(f_tmd);
 			return 3;
 	}
 	s_issuer_xs = RVL_Cert_Issuers[issuer_xs];
 	s_issuer_cp = RVL_Cert_Issuers[issuer_cp];
 
-	printf("Converting NUS from %s to %s...\n", s_fromKey, s_toKey);
+	fprintf(f_out, "Converting NUS from %s to %s...\n", s_fromKey, s_toKey);
 
 	/** Ticket fixups **/
 
@@ -289,11 +300,11 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		case 0x10004:
 			break;
 		case 0x30004:
-			fprintf(stderr, "*** Changing ticket signature type from Disc to Installable.\n");
+			fprintf(f_err, "*** Changing ticket signature type from Disc to Installable.\n");
 			pTicket->signature_type = cpu_to_be32(0x10004);
 			break;
 		default:
-			fprintf(stderr, "*** ERROR: Ticket has unsupported signature type: 0x%08X\n",
+			fprintf(f_err, "*** ERROR: Ticket has unsupported signature type: 0x%08X\n",
 				be32_to_cpu(pTicket->signature_type));
 			fclose(f_tik);
 			fclose(f_tmd);
@@ -303,11 +314,11 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		case 0x10004:
 			break;
 		case 0x30004:
-			fprintf(stderr, "*** Changing TMD signature type from Disc to Installable.\n");
+			fprintf(f_err, "*** Changing TMD signature type from Disc to Installable.\n");
 			pTmdHeader->rvl.signature_type = cpu_to_be32(0x10004);
 			break;
 		default:
-			fprintf(stderr, "*** ERROR: TMD has unsupported signature type: 0x%08X\n",
+			fprintf(f_err, "*** ERROR: TMD has unsupported signature type: 0x%08X\n",
 				be32_to_cpu(pTmdHeader->rvl.signature_type));
 			fclose(f_tik);
 			fclose(f_tmd);
@@ -380,10 +391,19 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 	// Write the new ticket and TMD.
 	rewind(f_tik);
 	rewind(f_tmd);
-	fwrite(tik_data.get(), 1, tik_size, f_tik);
-	fwrite(tmd_data.get(), 1, tmd_size, f_tmd);
-	fclose(f_tik);
-	fclose(f_tmd);
+	errno = 0;
+	size_t size_tik = fwrite(tik_data.get(), 1, tik_size, f_tik);
+	size_t size_tmd = fwrite(tmd_data.get(), 1, tmd_size, f_tmd);
+	int ret_tik = fclose(f_tik);
+	int ret_tmd = fclose(f_tmd);
+	if (size_tik != tik_size || size_tmd != tmd_size || ret_tik != 0 || ret_tmd != 0) {
+		int err = errno;
+		if (err == 0) {
+			err = EIO;
+		}
+		fprintf(f_err, "*** ERROR writing ticket or TMD file: %s\n", strerror(err));
+		return -err;
+	}
 
 	// Write title.cert.
 	tstring sf_cert = nus_dir;
@@ -395,7 +415,7 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR: Unable to write title.cert: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR: Unable to write title.cert: %s\n", strerror(err));
 		return -err;
 	}
 
@@ -420,6 +440,6 @@ int resign_nus(const TCHAR *nus_dir, int recrypt_key)
 
 	fclose(f_cert);
 
-	printf("NUS resigning complete.\n");
+	fputs("NUS resigning complete.\n", f_out);
 	return 0;
 }
@@ -11,6 +11,10 @@
 
 #include "tcharx.h"
 #include <stdint.h>
+#include <stdio.h>
+
+// TODO: Custom stdbool.x instead of libwiicrypto/common.h.
+#include "libwiicrypto/common.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,9 +24,12 @@ extern "C" {
  * 'resign' command.
  * @param nus_dir	[in] NUS directory.
  * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param show_info	[in] If true, print the NUS information first. (always printed to stdout)
+ * @param f_out		[in] Output stream for status messages.
+ * @param f_err		[in] Output stream for error messages.
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int resign_nus(const TCHAR *nus_dir, int recrypt_key);
+int resign_nus(const TCHAR *nus_dir, int recrypt_key, bool show_info, FILE *f_out, FILE *f_err);
 
 #ifdef __cplusplus
 }
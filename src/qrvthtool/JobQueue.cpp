@@ -0,0 +1,817 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * JobQueue.cpp: Extract/import job queue and scheduler.                   *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "JobQueue.hpp"
+
+// Worker object for the worker threads.
+#include "WorkerObject.hpp"
+
+// C includes. (C++ namespace)
+#include <cassert>
+
+// Qt includes.
+#include <QtCore/QFileInfo>
+#include <QtCore/QList>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+
+// Progress polling interval, in milliseconds.
+#define JOBQUEUE_PROGRESS_INTERVAL	250
+
+/** JobQueuePrivate **/
+
+class JobQueuePrivate
+{
+	public:
+		explicit JobQueuePrivate(JobQueue *q);
+		~JobQueuePrivate();
+
+	protected:
+		JobQueue *const q_ptr;
+		Q_DECLARE_PUBLIC(JobQueue)
+	private:
+		Q_DISABLE_COPY(JobQueuePrivate)
+
+	public:
+		struct Job {
+			JobQueue::JobType type;
+			JobQueue::JobState state;
+
+			QString rvthFilename;
+			unsigned int bank;
+			QString gcmFilename;
+			int recryption_key;
+			unsigned int flags;
+
+			// Last status message.
+			QString message;
+
+			// Progress, from WorkerObject::progress().
+			// Not valid until progress_max is non-zero.
+			int progress_value;
+			int progress_max;
+
+			// Cancel was requested while the job was running.
+			bool cancelRequested;
+
+			// Worker thread and object. (only while running)
+			QThread *workerThread;
+			WorkerObject *workerObject;
+		};
+
+		// Jobs, in the order they were queued.
+		QList<Job*> jobs;
+
+		// Maximum number of jobs that can run at once.
+		int maxJobs;
+
+		// Polls the progress of running jobs.
+		// Only active while jobs are running.
+		QTimer *progressTimer;
+
+		/**
+		 * Queue a job and start it if possible.
+		 * @param job Job. (Ownership is transferred to the queue.)
+		 */
+		void addJob(Job *job);
+
+		/**
+		 * Find the job that's using the specified worker object.
+		 * @param workerObject Worker object.
+		 * @return Row number, or -1 if not found.
+		 */
+		int findJob(const QObject *workerObject) const;
+
+		/**
+		 * Check if two jobs can't run at the same time.
+		 * @param a First job.
+		 * @param b Second job.
+		 * @return True if the jobs conflict.
+		 */
+		static bool jobsConflict(const Job *a, const Job *b);
+
+		/**
+		 * Compare two filenames.
+		 * Filenames are case-insensitive on Windows.
+		 * @param a First filename.
+		 * @param b Second filename.
+		 * @return True if the filenames are the same.
+		 */
+		static inline bool isSameFile(const QString &a, const QString &b)
+		{
+#ifdef Q_OS_WIN
+			return (a.compare(b, Qt::CaseInsensitive) == 0);
+#else /* !Q_OS_WIN */
+			return (a == b);
+#endif /* Q_OS_WIN */
+		}
+
+		/**
+		 * Start as many queued jobs as possible.
+		 */
+		void startQueuedJobs(void);
+
+		/**
+		 * Start a queued job.
+		 * @param row Row number.
+		 */
+		void startJob(int row);
+
+		/**
+		 * Stop a job's worker thread after its process has finished.
+		 * @param job Job.
+		 */
+		void stopWorkerThread(Job *job);
+
+		/**
+		 * Notify the view that a job's status has changed.
+		 * @param row Row number.
+		 */
+		void emitJobChanged(int row);
+};
+
+JobQueuePrivate::JobQueuePrivate(JobQueue *q)
+	: q_ptr(q)
+	, maxJobs(JOBQUEUE_DEFAULT_MAX_JOBS)
+	, progressTimer(new QTimer(q))
+{
+	progressTimer->setInterval(JOBQUEUE_PROGRESS_INTERVAL);
+	QObject::connect(progressTimer, &QTimer::timeout,
+		q, &JobQueue::progressTimer_timeout);
+}
+
+JobQueuePrivate::~JobQueuePrivate()
+{
+	// Cancel all running jobs and wait for their threads to exit.
+	for (Job *job : jobs) {
+		if (job->workerObject) {
+			job->workerObject->cancel();
+		}
+		if (job->workerThread) {
+			job->workerThread->quit();
+			do {
+				job->workerThread->wait(250);
+			} while (job->workerThread->isRunning());
+		}
+		delete job->workerObject;
+		delete job;
+	}
+}
+
+/**
+ * Queue a job and start it if possible.
+ * @param job Job. (Ownership is transferred to the queue.)
+ */
+void JobQueuePrivate::addJob(Job *job)
+{
+	Q_Q(JobQueue);
+
+	job->state = JobQueue::STATE_QUEUED;
+	job->progress_value = 0;
+	job->progress_max = 0;
+	job->cancelRequested = false;
+	job->workerThread = nullptr;
+	job->workerObject = nullptr;
+
+	const int row = jobs.size();
+	q->beginInsertRows(QModelIndex(), row, row);
+	jobs.append(job);
+	q->endInsertRows();
+
+	startQueuedJobs();
+	emit q->activeJobsChanged();
+}
+
+/**
+ * Find the job that's using the specified worker object.
+ * @param workerObject Worker object.
+ * @return Row number, or -1 if not found.
+ */
+int JobQueuePrivate::findJob(const QObject *workerObject) const
+{
+	if (!workerObject) {
+		return -1;
+	}
+
+	const int count = jobs.size();
+	for (int row = 0; row < count; row++) {
+		if (jobs[row]->workerObject == workerObject) {
+			return row;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Check if two jobs can't run at the same time.
+ * @param a First job.
+ * @param b Second job.
+ * @return True if the jobs conflict.
+ */
+bool JobQueuePrivate::jobsConflict(const Job *a, const Job *b)
+{
+	if (isSameFile(a->gcmFilename, b->gcmFilename)) {
+		// Both jobs are using the same disc image.
+		return true;
+	}
+
+	if (!isSameFile(a->rvthFilename, b->rvthFilename)) {
+		// Different RVT-H devices or images.
+		return false;
+	}
+
+	// Imports write the bank table, and a dual-layer image
+	// uses two banks, so only one import can run per RVT-H.
+	// Extractions of other banks can run at the same time.
+	return (a->bank == b->bank ||
+		a->type == JobQueue::JOB_IMPORT ||
+		b->type == JobQueue::JOB_IMPORT);
+}
+
+/**
+ * Start as many queued jobs as possible.
+ */
+void JobQueuePrivate::startQueuedJobs(void)
+{
+	Q_Q(JobQueue);
+	int running = q->runningJobCount();
+	const int count = jobs.size();
+	for (int row = 0; row < count && running < maxJobs; row++) {
+		const Job *const job = jobs[row];
+		if (job->state != JobQueue::STATE_QUEUED)
+			continue;
+
+		// Don't start the job if it conflicts with a running job,
+		// or with an earlier job that's still queued. Otherwise,
+		// a later job could overtake an earlier job on the same bank.
+		bool canStart = true;
+		for (int i = 0; i < count; i++) {
+			const Job *const other = jobs[i];
+			if (i == row)
+				continue;
+			if (other->state == JobQueue::STATE_RUNNING ||
+			    (other->state == JobQueue::STATE_QUEUED && i < row))
+			{
+				if (jobsConflict(job, other)) {
+					canStart = false;
+					break;
+				}
+			}
+		}
+
+		if (canStart) {
+			startJob(row);
+			running++;
+		}
+	}
+}
+
+/**
+ * Start a queued job.
+ * @param row Row number.
+ */
+void JobQueuePrivate::startJob(int row)
+{
+	Q_Q(JobQueue);
+	Job *const job = jobs[row];
+	assert(job->state == JobQueue::STATE_QUEUED);
+
+	// Create the worker thread and object.
+	// The worker object opens its own RvtH object on the worker thread.
+	job->workerThread = new QThread(q);
+	job->workerObject = new WorkerObject();
+	job->workerObject->moveToThread(job->workerThread);
+	job->workerObject->setRvtHFilename(job->rvthFilename);
+	job->workerObject->setBank(job->bank);
+	job->workerObject->setGcmFilename(job->gcmFilename);
+	job->workerObject->setRecryptionKey(job->recryption_key);
+	job->workerObject->setFlags(job->flags);
+
+	switch (job->type) {
+		case JobQueue::JOB_EXTRACT:
+			QObject::connect(job->workerThread, &QThread::started,
+				job->workerObject, &WorkerObject::doExtract);
+			break;
+		case JobQueue::JOB_IMPORT:
+			QObject::connect(job->workerThread, &QThread::started,
+				job->workerObject, &WorkerObject::doImport);
+			break;
+		default:
+			// FIXME
+			assert(false);
+			break;
+	}
+	QObject::connect(job->workerObject, &WorkerObject::finished,
+		q, &JobQueue::workerObject_finished);
+
+	job->state = JobQueue::STATE_RUNNING;
+	job->message = JobQueue::tr("Opening the RVT-H Reader...");
+	emitJobChanged(row);
+
+	// Start the thread.
+	// Progress will be polled using the progress timer.
+	job->workerThread->start();
+	progressTimer->start();
+}
+
+/**
+ * Stop a job's worker thread after its process has finished.
+ * @param job Job.
+ */
+void JobQueuePrivate::stopWorkerThread(Job *job)
+{
+	// Make sure the thread exits.
+	// NOTE: Connecting WorkerObject::finished() to QThread::quit()
+	// might not work if the slots get run in the wrong order.
+	job->workerThread->quit();
+	do {
+		job->workerThread->wait(250);
+	} while (job->workerThread->isRunning());
+	job->workerThread->deleteLater();
+	job->workerThread = nullptr;
+
+	// NOTE: Need to use deleteLater() to prevent race conditions.
+	job->workerObject->deleteLater();
+	job->workerObject = nullptr;
+}
+
+/**
+ * Notify the view that a job's status has changed.
+ * @param row Row number.
+ */
+void JobQueuePrivate::emitJobChanged(int row)
+{
+	Q_Q(JobQueue);
+	emit q->dataChanged(q->index(row, JobQueue::COL_STATUS),
+		q->index(row, JobQueue::COL_MESSAGE));
+}
+
+/** JobQueue **/
+
+JobQueue::JobQueue(QObject *parent)
+	: super(parent)
+	, d_ptr(new JobQueuePrivate(this))
+{ }
+
+JobQueue::~JobQueue()
+{
+	delete d_ptr;
+}
+
+/** Qt Model/View interface. **/
+
+int JobQueue::rowCount(const QModelIndex& parent) const
+{
+	Q_UNUSED(parent);
+	Q_D(const JobQueue);
+	return d->jobs.size();
+}
+
+int JobQueue::columnCount(const QModelIndex& parent) const
+{
+	Q_UNUSED(parent);
+	return COL_MAX;
+}
+
+QVariant JobQueue::data(const QModelIndex& index, int role) const
+{
+	Q_D(const JobQueue);
+	if (!index.isValid())
+		return QVariant();
+	if (index.row() >= d->jobs.size())
+		return QVariant();
+
+	const JobQueuePrivate::Job *const job = d->jobs[index.row()];
+	switch (role) {
+		case Qt::DisplayRole:
+			switch (index.column()) {
+				case COL_JOB: {
+					const QString gcmFilenameOnly = QFileInfo(job->gcmFilename).fileName();
+					if (job->type == JOB_IMPORT) {
+						return tr("Import %1 to Bank %2")
+							.arg(gcmFilenameOnly).arg(job->bank+1);
+					}
+					return tr("Extract Bank %1 to %2")
+						.arg(job->bank+1).arg(gcmFilenameOnly);
+				}
+
+				case COL_STATUS:
+					switch (job->state) {
+						case STATE_QUEUED:	return tr("Queued");
+						case STATE_RUNNING:
+							return (job->cancelRequested
+								? tr("Cancelling")
+								: tr("Running"));
+						case STATE_FINISHED:	return tr("Finished");
+						case STATE_FAILED:	return tr("Failed");
+						case STATE_CANCELLED:	return tr("Cancelled");
+						default:
+							break;
+					}
+					break;
+
+				case COL_PROGRESS:
+					if (job->state == STATE_FINISHED) {
+						return QString::number(100) + QChar(L'%');
+					} else if (job->state == STATE_RUNNING && job->progress_max > 0) {
+						const int percent = static_cast<int>(
+							(static_cast<qint64>(job->progress_value) * 100) / job->progress_max);
+						return QString::number(percent) + QChar(L'%');
+					}
+					break;
+
+				case COL_MESSAGE:
+					return job->message;
+
+				default:
+					break;
+			}
+			break;
+
+		case Qt::ToolTipRole:
+			if (index.column() == COL_JOB) {
+				// Show the full filenames.
+				return tr("RVT-H Reader: %1\nDisc image: %2")
+					.arg(job->rvthFilename).arg(job->gcmFilename);
+			} else if (index.column() == COL_MESSAGE) {
+				// Messages may be too long for the column.
+				return job->message;
+			}
+			break;
+
+		case Qt::TextAlignmentRole:
+			if (index.column() == COL_PROGRESS) {
+				// Right-align the percentage.
+				return static_cast<int>(Qt::AlignRight | Qt::AlignVCenter);
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	// Default value.
+	return QVariant();
+}
+
+QVariant JobQueue::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	Q_UNUSED(orientation);
+
+	switch (role) {
+		case Qt::DisplayRole:
+			switch (section) {
+				case COL_JOB:		return tr("Job");
+				case COL_STATUS:	return tr("Status");
+				case COL_PROGRESS:	return tr("Progress");
+				case COL_MESSAGE:	return tr("Message");
+
+				default:
+					break;
+			}
+			break;
+
+		case Qt::TextAlignmentRole:
+			// Center-align the text.
+			return Qt::AlignHCenter;
+	}
+
+	// Default value.
+	return QVariant();
+}
+
+/** Properties **/
+
+/**
+ * Get the maximum number of jobs that can run at once.
+ * @return Maximum number of jobs.
+ */
+int JobQueue::maxConcurrentJobs(void) const
+{
+	Q_D(const JobQueue);
+	return d->maxJobs;
+}
+
+/**
+ * Set the maximum number of jobs that can run at once.
+ * If the limit is raised, queued jobs are started immediately.
+ * Lowering the limit doesn't affect jobs that are already running.
+ * @param maxJobs Maximum number of jobs. (1 to JOBQUEUE_MAX_JOBS_LIMIT)
+ */
+void JobQueue::setMaxConcurrentJobs(int maxJobs)
+{
+	Q_D(JobQueue);
+	if (maxJobs < 1) {
+		maxJobs = 1;
+	} else if (maxJobs > JOBQUEUE_MAX_JOBS_LIMIT) {
+		maxJobs = JOBQUEUE_MAX_JOBS_LIMIT;
+	}
+	if (d->maxJobs == maxJobs)
+		return;
+
+	d->maxJobs = maxJobs;
+	emit maxConcurrentJobsChanged(maxJobs);
+	d->startQueuedJobs();
+}
+
+/** Jobs **/
+
+/**
+ * Queue an extraction job.
+ * @param rvthFilename RVT-H filename.
+ * @param bank Bank number.
+ * @param gcmFilename Destination GCM filename.
+ * @param recryption_key Recryption key. (-1 for no recryption)
+ * @param flags Extraction flags.
+ */
+void JobQueue::addExtractJob(const QString &rvthFilename, unsigned int bank,
+	const QString &gcmFilename, int recryption_key, unsigned int flags)
+{
+	Q_D(JobQueue);
+	JobQueuePrivate::Job *const job = new JobQueuePrivate::Job;
+	job->type = JOB_EXTRACT;
+	job->rvthFilename = rvthFilename;
+	job->bank = bank;
+	job->gcmFilename = gcmFilename;
+	job->recryption_key = recryption_key;
+	job->flags = flags;
+	d->addJob(job);
+}
+
+/**
+ * Queue an import job.
+ * @param rvthFilename RVT-H filename.
+ * @param bank Bank number.
+ * @param gcmFilename Source GCM filename.
+ */
+void JobQueue::addImportJob(const QString &rvthFilename, unsigned int bank,
+	const QString &gcmFilename)
+{
+	Q_D(JobQueue);
+	JobQueuePrivate::Job *const job = new JobQueuePrivate::Job;
+	job->type = JOB_IMPORT;
+	job->rvthFilename = rvthFilename;
+	job->bank = bank;
+	job->gcmFilename = gcmFilename;
+	job->recryption_key = -1;
+	job->flags = 0;
+	d->addJob(job);
+}
+
+/**
+ * Get the number of jobs that are queued or running.
+ * @return Number of active jobs.
+ */
+int JobQueue::activeJobCount(void) const
+{
+	Q_D(const JobQueue);
+	int count = 0;
+	for (const JobQueuePrivate::Job *job : d->jobs) {
+		if (job->state == STATE_QUEUED || job->state == STATE_RUNNING) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Get the number of jobs that are running.
+ * @return Number of running jobs.
+ */
+int JobQueue::runningJobCount(void) const
+{
+	Q_D(const JobQueue);
+	int count = 0;
+	for (const JobQueuePrivate::Job *job : d->jobs) {
+		if (job->state == STATE_RUNNING) {
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Is a queued or running job using the specified bank?
+ * Imports count as using every bank on the RVT-H,
+ * since they may change the bank table layout.
+ * @param rvthFilename RVT-H filename.
+ * @param bank Bank number.
+ * @return True if the bank is in use by a job.
+ */
+bool JobQueue::isBankBusy(const QString &rvthFilename, unsigned int bank) const
+{
+	Q_D(const JobQueue);
+	for (const JobQueuePrivate::Job *job : d->jobs) {
+		if (job->state != STATE_QUEUED && job->state != STATE_RUNNING)
+			continue;
+		if (!JobQueuePrivate::isSameFile(job->rvthFilename, rvthFilename))
+			continue;
+		if (job->bank == bank || job->type == JOB_IMPORT) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Get the combined progress of all running jobs.
+ * @param pValue	[out] Progress value.
+ * @param pMax		[out] Progress maximum.
+ * @return True if any running job has reported progress.
+ */
+bool JobQueue::totalProgress(int *pValue, int *pMax) const
+{
+	Q_D(const JobQueue);
+	qint64 value = 0, max = 0;
+	for (const JobQueuePrivate::Job *job : d->jobs) {
+		if (job->state == STATE_RUNNING && job->progress_max > 0) {
+			value += job->progress_value;
+			max += job->progress_max;
+		}
+	}
+
+	if (max <= 0) {
+		*pValue = 0;
+		*pMax = 0;
+		return false;
+	}
+
+	// Progress is in LBAs, so the total may not fit in an int.
+	// Report it in tenths of a percent.
+	*pValue = static_cast<int>((value * 1000) / max);
+	*pMax = 1000;
+	return true;
+}
+
+/**
+ * Can the job in the specified row be cancelled?
+ * @param row Row number.
+ * @return True if the job is queued or running.
+ */
+bool JobQueue::canCancel(int row) const
+{
+	Q_D(const JobQueue);
+	if (row < 0 || row >= d->jobs.size())
+		return false;
+
+	const JobQueuePrivate::Job *const job = d->jobs[row];
+	return (job->state == STATE_QUEUED ||
+		(job->state == STATE_RUNNING && !job->cancelRequested));
+}
+
+/**
+ * Cancel the job in the specified row.
+ * Queued jobs are cancelled immediately; running jobs
+ * are cancelled at the next progress update.
+ * @param row Row number.
+ */
+void JobQueue::cancelJob(int row)
+{
+	Q_D(JobQueue);
+	if (!canCancel(row))
+		return;
+
+	JobQueuePrivate::Job *const job = d->jobs[row];
+	if (job->state == STATE_QUEUED) {
+		// Job hasn't started yet.
+		job->state = STATE_CANCELLED;
+		job->message = tr("Cancelled before starting.");
+		d->emitJobChanged(row);
+
+		// Jobs that were waiting for this job may be able to start now.
+		d->startQueuedJobs();
+		emit activeJobsChanged();
+		return;
+	}
+
+	// Job is running. The worker object will stop
+	// at the next progress update and emit finished().
+	// TODO: Delete the destination .gcm if necessary?
+	// TODO: If importing, restore the old bank entry?
+	job->cancelRequested = true;
+	job->workerObject->cancel();
+	d->emitJobChanged(row);
+}
+
+/**
+ * Cancel all queued and running jobs.
+ */
+void JobQueue::cancelAll(void)
+{
+	Q_D(JobQueue);
+
+	// Cancel the queued jobs first so they don't
+	// start when the running jobs are cancelled.
+	const int count = d->jobs.size();
+	for (int row = 0; row < count; row++) {
+		JobQueuePrivate::Job *const job = d->jobs[row];
+		if (job->state == STATE_QUEUED) {
+			job->state = STATE_CANCELLED;
+			job->message = tr("Cancelled before starting.");
+			d->emitJobChanged(row);
+		}
+	}
+	for (int row = 0; row < count; row++) {
+		cancelJob(row);
+	}
+
+	emit activeJobsChanged();
+}
+
+/**
+ * Remove finished, failed, and cancelled jobs from the queue.
+ */
+void JobQueue::clearFinished(void)
+{
+	Q_D(JobQueue);
+	for (int row = d->jobs.size() - 1; row >= 0; row--) {
+		JobQueuePrivate::Job *const job = d->jobs[row];
+		if (job->state == STATE_QUEUED || job->state == STATE_RUNNING)
+			continue;
+
+		beginRemoveRows(QModelIndex(), row, row);
+		d->jobs.removeAt(row);
+		delete job;
+		endRemoveRows();
+	}
+}
+
+/**
+ * Poll the progress of all running jobs.
+ */
+void JobQueue::progressTimer_timeout(void)
+{
+	Q_D(JobQueue);
+	const int count = d->jobs.size();
+	for (int row = 0; row < count; row++) {
+		JobQueuePrivate::Job *const job = d->jobs[row];
+		if (job->state != STATE_RUNNING || !job->workerObject)
+			continue;
+
+		QString text;
+		int progress_value, progress_max;
+		if (!job->workerObject->progress(&text, &progress_value, &progress_max))
+			continue;
+
+		if (progress_value >= 0 && progress_max >= 0) {
+			if (text == job->message &&
+			    progress_value == job->progress_value &&
+			    progress_max == job->progress_max)
+			{
+				// No change.
+				continue;
+			}
+			job->progress_value = progress_value;
+			job->progress_max = progress_max;
+		} else if (text == job->message) {
+			// No change.
+			continue;
+		}
+		job->message = text;
+		d->emitJobChanged(row);
+
+		emit jobProgress(text);
+	}
+}
+
+/** Worker object slots **/
+
+/**
+ * A job's process is finished.
+ * @param text Status text.
+ * @param err Error code. (0 on success)
+ */
+void JobQueue::workerObject_finished(const QString &text, int err)
+{
+	Q_D(JobQueue);
+	const int row = d->findJob(sender());
+	if (row < 0)
+		return;
+
+	JobQueuePrivate::Job *const job = d->jobs[row];
+	d->stopWorkerThread(job);
+
+	if (err == 0) {
+		job->state = STATE_FINISHED;
+	} else if (job->cancelRequested) {
+		job->state = STATE_CANCELLED;
+	} else {
+		job->state = STATE_FAILED;
+	}
+	job->message = text;
+	d->emitJobChanged(row);
+
+	emit jobFinished(job->type, job->rvthFilename, job->bank, text, err);
+
+	// Start the next jobs.
+	d->startQueuedJobs();
+	if (runningJobCount() == 0) {
+		d->progressTimer->stop();
+	}
+	emit activeJobsChanged();
+}
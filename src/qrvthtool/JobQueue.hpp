@@ -0,0 +1,226 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * JobQueue.hpp: Extract/import job queue and scheduler.                   *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_QRVTHTOOL_JOBQUEUE_HPP__
+#define __RVTHTOOL_QRVTHTOOL_JOBQUEUE_HPP__
+
+// Qt includes.
+#include <QtCore/QAbstractListModel>
+
+// Default maximum number of jobs that can run at once.
+#define JOBQUEUE_DEFAULT_MAX_JOBS	1
+// Upper limit for the maximum number of jobs that can run at once.
+#define JOBQUEUE_MAX_JOBS_LIMIT		8
+
+/**
+ * Queue of extract and import jobs.
+ *
+ * Each job runs on its own worker thread, using its own RvtH object
+ * opened from the job's RVT-H filename, so jobs don't depend on the
+ * RvtH object shown in the main window.
+ *
+ * Up to maxConcurrentJobs jobs run at once. Jobs that would conflict
+ * with a running job, or with an earlier queued job, wait their turn:
+ * - Jobs on the same bank of the same RVT-H.
+ * - Imports into the same RVT-H, since they write the bank table
+ *   and dual-layer images use two banks.
+ * - Jobs using the same disc image file.
+ *
+ * This class is also the model for the job queue view.
+ */
+class JobQueuePrivate;
+class JobQueue : public QAbstractListModel
+{
+	Q_OBJECT
+	typedef QAbstractListModel super;
+
+	Q_PROPERTY(int maxConcurrentJobs READ maxConcurrentJobs WRITE setMaxConcurrentJobs NOTIFY maxConcurrentJobsChanged)
+
+	public:
+		explicit JobQueue(QObject *parent = nullptr);
+		virtual ~JobQueue();
+
+	protected:
+		JobQueuePrivate *const d_ptr;
+		Q_DECLARE_PRIVATE(JobQueue)
+	private:
+		Q_DISABLE_COPY(JobQueue)
+
+	public:
+		enum Column {
+			COL_JOB,		// Job description
+			COL_STATUS,		// Queued, Running, etc.
+			COL_PROGRESS,		// Percentage
+			COL_MESSAGE,		// Last status message
+
+			COL_MAX
+		};
+
+		enum JobType {
+			JOB_EXTRACT,
+			JOB_IMPORT,
+		};
+
+		enum JobState {
+			STATE_QUEUED,
+			STATE_RUNNING,
+			STATE_FINISHED,
+			STATE_FAILED,
+			STATE_CANCELLED,
+		};
+
+		// Qt Model/View interface.
+		int rowCount(const QModelIndex& parent = QModelIndex()) const final;
+		int columnCount(const QModelIndex& parent = QModelIndex()) const final;
+
+		QVariant data(const QModelIndex& index, int role) const final;
+		QVariant headerData(int section, Qt::Orientation orientation, int role) const final;
+
+	public:
+		/** Properties **/
+
+		/**
+		 * Get the maximum number of jobs that can run at once.
+		 * @return Maximum number of jobs.
+		 */
+		int maxConcurrentJobs(void) const;
+
+		/**
+		 * Set the maximum number of jobs that can run at once.
+		 * If the limit is raised, queued jobs are started immediately.
+		 * Lowering the limit doesn't affect jobs that are already running.
+		 * @param maxJobs Maximum number of jobs. (1 to JOBQUEUE_MAX_JOBS_LIMIT)
+		 */
+		void setMaxConcurrentJobs(int maxJobs);
+
+	public:
+		/** Jobs **/
+
+		/**
+		 * Queue an extraction job.
+		 * @param rvthFilename RVT-H filename.
+		 * @param bank Bank number.
+		 * @param gcmFilename Destination GCM filename.
+		 * @param recryption_key Recryption key. (-1 for no recryption)
+		 * @param flags Extraction flags.
+		 */
+		void addExtractJob(const QString &rvthFilename, unsigned int bank,
+			const QString &gcmFilename, int recryption_key, unsigned int flags);
+
+		/**
+		 * Queue an import job.
+		 * @param rvthFilename RVT-H filename.
+		 * @param bank Bank number.
+		 * @param gcmFilename Source GCM filename.
+		 */
+		void addImportJob(const QString &rvthFilename, unsigned int bank,
+			const QString &gcmFilename);
+
+		/**
+		 * Get the number of jobs that are queued or running.
+		 * @return Number of active jobs.
+		 */
+		int activeJobCount(void) const;
+
+		/**
+		 * Get the number of jobs that are running.
+		 * @return Number of running jobs.
+		 */
+		int runningJobCount(void) const;
+
+		/**
+		 * Is a queued or running job using the specified bank?
+		 * Imports count as using every bank on the RVT-H,
+		 * since they may change the bank table layout.
+		 * @param rvthFilename RVT-H filename.
+		 * @param bank Bank number.
+		 * @return True if the bank is in use by a job.
+		 */
+		bool isBankBusy(const QString &rvthFilename, unsigned int bank) const;
+
+		/**
+		 * Get the combined progress of all running jobs.
+		 * @param pValue	[out] Progress value.
+		 * @param pMax		[out] Progress maximum.
+		 * @return True if any running job has reported progress.
+		 */
+		bool totalProgress(int *pValue, int *pMax) const;
+
+		/**
+		 * Can the job in the specified row be cancelled?
+		 * @param row Row number.
+		 * @return True if the job is queued or running.
+		 */
+		bool canCancel(int row) const;
+
+	signals:
+		/**
+		 * The maximum number of jobs has changed.
+		 * @param maxJobs Maximum number of jobs.
+		 */
+		void maxConcurrentJobsChanged(int maxJobs);
+
+		/**
+		 * A job has reported progress.
+		 * @param text Status text.
+		 */
+		void jobProgress(const QString &text);
+
+		/**
+		 * A job has finished.
+		 * @param type Job type.
+		 * @param rvthFilename RVT-H filename.
+		 * @param bank Bank number.
+		 * @param text Status text.
+		 * @param err Error code. (0 on success)
+		 */
+		void jobFinished(JobQueue::JobType type, const QString &rvthFilename,
+			unsigned int bank, const QString &text, int err);
+
+		/**
+		 * The set of queued and running jobs has changed.
+		 * This is emitted when jobs are added, finished, or cancelled.
+		 */
+		void activeJobsChanged(void);
+
+	public slots:
+		/**
+		 * Cancel the job in the specified row.
+		 * Queued jobs are cancelled immediately; running jobs
+		 * are cancelled at the next progress update.
+		 * @param row Row number.
+		 */
+		void cancelJob(int row);
+
+		/**
+		 * Cancel all queued and running jobs.
+		 */
+		void cancelAll(void);
+
+		/**
+		 * Remove finished, failed, and cancelled jobs from the queue.
+		 */
+		void clearFinished(void);
+
+	protected slots:
+		/**
+		 * Poll the progress of all running jobs.
+		 */
+		void progressTimer_timeout(void);
+
+		/** Worker object slots **/
+
+		/**
+		 * A job's process is finished.
+		 * @param text Status text.
+		 * @param err Error code. (0 on success)
+		 */
+		void workerObject_finished(const QString &text, int err);
+};
+
+#endif /* __RVTHTOOL_QRVTHTOOL_JOBQUEUE_HPP__ */
@@ -0,0 +1,221 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * RvtHLoader.cpp: Open an RvtH object on a worker thread.                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "RvtHLoader.hpp"
+
+// C includes. (C++ namespace)
+#include <cassert>
+#include <cerrno>
+
+// C++ includes.
+#include <atomic>
+
+/** RvtHLoaderPrivate **/
+
+class RvtHLoaderPrivate
+{
+	public:
+		explicit RvtHLoaderPrivate(RvtHLoader *q)
+			: q_ptr(q)
+			, rvth(nullptr)
+			, cancel(false) { }
+
+		~RvtHLoaderPrivate()
+		{
+			delete rvth;
+		}
+
+	protected:
+		RvtHLoader *const q_ptr;
+		Q_DECLARE_PUBLIC(RvtHLoader)
+	private:
+		Q_DISABLE_COPY(RvtHLoaderPrivate)
+
+	public:
+		QString filename;
+
+		// RvtH object that was opened.
+		RvtH *rvth;
+
+		// Cancel opening.
+		// Set by cancel(), which may be called from any thread.
+		std::atomic<bool> cancel;
+
+	public:
+		/**
+		 * Copy a bank entry for use outside of the RvtH object.
+		 * @param entry Bank entry.
+		 * @return Copy of the bank entry, without the Reader and partition table.
+		 */
+		static RvtH_BankEntry copyBankEntry(const RvtH_BankEntry *entry);
+
+		/**
+		 * RVT-H open callback.
+		 * @param state		[in] Current state.
+		 * @param userdata	[in] User data specified when calling the RvtH constructor.
+		 * @return True to continue; false to abort.
+		 */
+		static bool open_callback(const RvtH_Open_State *state, void *userdata);
+};
+
+/**
+ * Copy a bank entry for use outside of the RvtH object.
+ * @param entry Bank entry.
+ * @return Copy of the bank entry, without the Reader and partition table.
+ */
+RvtH_BankEntry RvtHLoaderPrivate::copyBankEntry(const RvtH_BankEntry *entry)
+{
+	RvtH_BankEntry copy = *entry;
+	copy.reader = nullptr;
+	copy.pt_count = 0;
+	copy.ptbl = nullptr;
+	return copy;
+}
+
+/**
+ * RVT-H open callback.
+ * @param state		[in] Current state.
+ * @param userdata	[in] User data specified when calling the RvtH constructor.
+ * @return True to continue; false to abort.
+ */
+bool RvtHLoaderPrivate::open_callback(const RvtH_Open_State *state, void *userdata)
+{
+	RvtHLoader *const q = static_cast<RvtHLoader*>(userdata);
+	RvtHLoaderPrivate *const d = q->d_func();
+	if (d->cancel) {
+		// Opening was cancelled.
+		return false;
+	}
+
+	// NOTE: The RvtH object isn't modified while the callback
+	// is running, so the bank entries can be copied here.
+	switch (state->type) {
+		case RVTH_OPEN_BANK_TABLE: {
+			QVector<RvtH_BankEntry> entries;
+			entries.reserve(state->bank_count);
+			for (unsigned int i = 0; i < state->bank_count; i++) {
+				entries.append(copyBankEntry(state->rvth->bankEntry(i)));
+			}
+			emit q->bankTableLoaded(state->rvth->imageType(), entries);
+			break;
+		}
+
+		case RVTH_OPEN_BANK_LOADED:
+			emit q->bankLoaded(state->bank,
+				copyBankEntry(state->rvth->bankEntry(state->bank)));
+			break;
+
+		default:
+			assert(!"Invalid open callback type.");
+			break;
+	}
+
+	return true;
+}
+
+/** RvtHLoader **/
+
+RvtHLoader::RvtHLoader(QObject *parent)
+	: super(parent)
+	, d_ptr(new RvtHLoaderPrivate(this))
+{
+	// Register the metatypes used by the signals.
+	// NOTE: The signals are usually emitted across threads.
+	qRegisterMetaType<RvtH_BankEntry>("RvtH_BankEntry");
+	qRegisterMetaType<QVector<RvtH_BankEntry> >("QVector<RvtH_BankEntry>");
+}
+
+RvtHLoader::~RvtHLoader()
+{
+	delete d_ptr;
+}
+
+/** Properties **/
+
+/**
+ * Get the filename to open.
+ * @return Filename.
+ */
+QString RvtHLoader::filename(void) const
+{
+	Q_D(const RvtHLoader);
+	return d->filename;
+}
+
+/**
+ * Set the filename to open.
+ * @param filename Filename.
+ */
+void RvtHLoader::setFilename(const QString &filename)
+{
+	Q_D(RvtHLoader);
+	d->filename = filename;
+}
+
+/**
+ * Take ownership of the RvtH object that was opened.
+ * This should be called after finished() is emitted.
+ * If it isn't called, the RvtH object is deleted
+ * when the RvtHLoader is deleted.
+ * @return RvtH object, or nullptr if it wasn't opened.
+ */
+RvtH *RvtHLoader::takeRvtH(void)
+{
+	Q_D(RvtHLoader);
+	RvtH *const rvth = d->rvth;
+	d->rvth = nullptr;
+	return rvth;
+}
+
+/** Slots **/
+
+/**
+ * Open the RvtH object.
+ */
+void RvtHLoader::doOpen(void)
+{
+	Q_D(RvtHLoader);
+	assert(d->rvth == nullptr);
+	if (d->filename.isEmpty()) {
+		emit finished(-EINVAL);
+		return;
+	} else if (d->cancel) {
+		emit finished(-ECANCELED);
+		return;
+	}
+
+	int err = 0;
+#ifdef _WIN32
+	RvtH *const rvth = new RvtH(reinterpret_cast<const wchar_t*>(d->filename.utf16()), &err,
+		RvtHLoaderPrivate::open_callback, this);
+#else /* !_WIN32 */
+	RvtH *const rvth = new RvtH(d->filename.toUtf8().constData(), &err,
+		RvtHLoaderPrivate::open_callback, this);
+#endif /* _WIN32 */
+	if (!rvth->isOpen() || err != 0) {
+		// Unable to open the RVT-H Reader disk image.
+		if (err == 0) {
+			err = -EIO;
+		}
+		delete rvth;
+	} else {
+		d->rvth = rvth;
+	}
+
+	emit finished(err);
+}
+
+/**
+ * Cancel opening the RvtH object.
+ * This may be called from any thread.
+ */
+void RvtHLoader::cancel(void)
+{
+	Q_D(RvtHLoader);
+	d->cancel = true;
+}
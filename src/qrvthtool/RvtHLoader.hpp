@@ -0,0 +1,115 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * RvtHLoader.hpp: Open an RvtH object on a worker thread.                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_QRVTHTOOL_RVTHLOADER_HPP__
+#define __RVTHTOOL_QRVTHTOOL_RVTHLOADER_HPP__
+
+// librvth
+#include "librvth/rvth.hpp"
+
+// Qt includes.
+#include <QtCore/QMetaType>
+#include <QtCore/QObject>
+#include <QtCore/QVector>
+
+/**
+ * Opens an RvtH object on a worker thread.
+ *
+ * Opening an RVT-H Reader reads the disc header, partition tables,
+ * tickets, and TMDs for every bank, and checks the signatures.
+ * This can take a while, especially over slow USB bridges.
+ *
+ * Move this object to a QThread and connect QThread::started()
+ * to doOpen(). Bank entries are reported as they're loaded.
+ * The bank entries in the signals are copies; the Reader and
+ * partition table pointers are cleared, since they're owned by
+ * the RvtH object that's still being loaded.
+ */
+class RvtHLoaderPrivate;
+class RvtHLoader : public QObject
+{
+	Q_OBJECT
+	typedef QObject super;
+
+	Q_PROPERTY(QString filename READ filename WRITE setFilename)
+
+	public:
+		explicit RvtHLoader(QObject *parent = nullptr);
+		virtual ~RvtHLoader();
+
+	protected:
+		RvtHLoaderPrivate *const d_ptr;
+		Q_DECLARE_PRIVATE(RvtHLoader)
+	private:
+		Q_DISABLE_COPY(RvtHLoader)
+
+	public:
+		/** Properties **/
+
+		/**
+		 * Get the filename to open.
+		 * @return Filename.
+		 */
+		QString filename(void) const;
+
+		/**
+		 * Set the filename to open.
+		 * @param filename Filename.
+		 */
+		void setFilename(const QString &filename);
+
+		/**
+		 * Take ownership of the RvtH object that was opened.
+		 * This should be called after finished() is emitted.
+		 * If it isn't called, the RvtH object is deleted
+		 * when the RvtHLoader is deleted.
+		 * @return RvtH object, or nullptr if it wasn't opened.
+		 */
+		RvtH *takeRvtH(void);
+
+	signals:
+		/**
+		 * The bank table has been read.
+		 * Only the bank types, LBAs, and timestamps are set.
+		 * (RVT-H Readers and HDD images only)
+		 * @param imageType Image type. (See RvtH_ImageType_e.)
+		 * @param entries Bank entries.
+		 */
+		void bankTableLoaded(int imageType, const QVector<RvtH_BankEntry> &entries);
+
+		/**
+		 * A bank entry has been fully loaded.
+		 * (RVT-H Readers and HDD images only)
+		 * @param bank Bank number.
+		 * @param entry Bank entry.
+		 */
+		void bankLoaded(unsigned int bank, const RvtH_BankEntry &entry);
+
+		/**
+		 * Opening is finished.
+		 * Call takeRvtH() to get the RvtH object.
+		 * @param err Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		void finished(int err);
+
+	public slots:
+		/**
+		 * Open the RvtH object.
+		 */
+		void doOpen(void);
+
+		/**
+		 * Cancel opening the RvtH object.
+		 * This may be called from any thread.
+		 */
+		void cancel(void);
+};
+
+Q_DECLARE_METATYPE(RvtH_BankEntry)
+
+#endif /* __RVTHTOOL_QRVTHTOOL_RVTHLOADER_HPP__ */
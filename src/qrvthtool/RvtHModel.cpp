@@ -49,6 +49,39 @@ class RvtHModelPrivate
 	public:
 		RvtH *rvth;
 
+		// Preliminary bank table.
+		// Shown while the RvtH object is being opened.
+		// Only used if rvth is nullptr.
+		QVector<RvtH_BankEntry> tblEntries;
+		QVector<bool> tblLoaded;
+		RvtH_ImageType_e tblImageType;
+
+		/**
+		 * Get the number of banks.
+		 * @return Number of banks.
+		 */
+		unsigned int bankCount(void) const;
+
+		/**
+		 * Get a bank entry.
+		 * @param bank Bank number.
+		 * @return Bank entry, or nullptr if out of range.
+		 */
+		const RvtH_BankEntry *bankEntry(unsigned int bank) const;
+
+		/**
+		 * Get the image type.
+		 * @return Image type.
+		 */
+		RvtH_ImageType_e imageType(void) const;
+
+		/**
+		 * Has the specified bank been fully loaded?
+		 * @param bank Bank number.
+		 * @return True if loaded; false if not.
+		 */
+		bool isBankLoaded(unsigned int bank) const;
+
 		// Style variables.
 		struct style_t {
 			/**
@@ -107,11 +140,66 @@ QIcon RvtHModelPrivate::ms_icons[RvtHModel::ICON_MAX];
 RvtHModelPrivate::RvtHModelPrivate(RvtHModel *q)
 	: q_ptr(q)
 	, rvth(nullptr)
+	, tblImageType(RVTH_ImageType_Unknown)
 {
 	// Initialize the style variables.
 	style.init();
 }
 
+/**
+ * Get the number of banks.
+ * @return Number of banks.
+ */
+unsigned int RvtHModelPrivate::bankCount(void) const
+{
+	if (rvth) {
+		return rvth->bankCount();
+	}
+	return static_cast<unsigned int>(tblEntries.size());
+}
+
+/**
+ * Get a bank entry.
+ * @param bank Bank number.
+ * @return Bank entry, or nullptr if out of range.
+ */
+const RvtH_BankEntry *RvtHModelPrivate::bankEntry(unsigned int bank) const
+{
+	if (rvth) {
+		return rvth->bankEntry(bank);
+	} else if (bank < static_cast<unsigned int>(tblEntries.size())) {
+		return &tblEntries[bank];
+	}
+	return nullptr;
+}
+
+/**
+ * Get the image type.
+ * @return Image type.
+ */
+RvtH_ImageType_e RvtHModelPrivate::imageType(void) const
+{
+	if (rvth) {
+		return rvth->imageType();
+	}
+	return tblImageType;
+}
+
+/**
+ * Has the specified bank been fully loaded?
+ * @param bank Bank number.
+ * @return True if loaded; false if not.
+ */
+bool RvtHModelPrivate::isBankLoaded(unsigned int bank) const
+{
+	if (rvth) {
+		return true;
+	} else if (bank < static_cast<unsigned int>(tblLoaded.size())) {
+		return tblLoaded[bank];
+	}
+	return false;
+}
+
 /**
  * Initialize the style variables.
  */
@@ -206,18 +294,22 @@ QIcon RvtHModelPrivate::loadIcon(const QString &dir, const QString &name)
  */
 RvtHModel::IconID RvtHModelPrivate::iconIDForBank(unsigned int bank) const
 {
-	if (!rvth) {
+	if (bankCount() == 0) {
 		// No RVT-H Reader image.
 		return RvtHModel::ICON_MAX;
+	} else if (!isBankLoaded(bank)) {
+		// Bank is still being loaded.
+		// The signature and encryption types aren't known yet.
+		return RvtHModel::ICON_MAX;
 	}
 
-	const RvtH_BankEntry *entry = rvth->bankEntry(bank);
+	const RvtH_BankEntry *entry = bankEntry(bank);
 	assert(entry != nullptr);
 	if (!entry) {
 		// No bank entry here...
 		return RvtHModel::ICON_MAX;
 	}
-	const RvtH_ImageType_e imageType = rvth->imageType();
+	const RvtH_ImageType_e imageType = this->imageType();
 
 	switch (entry->type) {
 		default:
@@ -229,8 +321,8 @@ RvtHModel::IconID RvtHModelPrivate::iconIDForBank(unsigned int bank) const
 
 		case RVTH_BankType_GCN:
 			// GameCube.
-			if (imageType == RVTH_ImageType_GCM) {
-				// Standalone GCM. Use the retail icon.
+			if (imageType == RVTH_ImageType_GCM || imageType == RVTH_ImageType_WBFS) {
+				// Standalone GCM or WBFS. Use the retail icon.
 				return RvtHModel::ICON_GCN;
 			} else {
 				// GCM with SDK header, or RVT-H Reader.
@@ -322,17 +414,14 @@ int RvtHModel::rowCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent);
 	Q_D(const RvtHModel);
-	if (d->rvth) {
-		return d->rvth->bankCount();
-	}
-	return 0;
+	return d->bankCount();
 }
 
 int RvtHModel::columnCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent);
 	Q_D(const RvtHModel);
-	if (d->rvth) {
+	if (d->bankCount() > 0) {
 		return COL_MAX;
 	}
 	return 0;
@@ -341,14 +430,14 @@ int RvtHModel::columnCount(const QModelIndex& parent) const
 QVariant RvtHModel::data(const QModelIndex& index, int role) const
 {
 	Q_D(const RvtHModel);
-	if (!d->rvth || !index.isValid())
+	if (!index.isValid())
 		return QVariant();
 	if (index.row() >= rowCount())
 		return QVariant();
 
 	// Get the bank entry.
 	const unsigned int bank = static_cast<unsigned int>(index.row());
-	const RvtH_BankEntry *const entry = d->rvth->bankEntry(bank);
+	const RvtH_BankEntry *const entry = d->bankEntry(bank);
 	if (!entry) {
 		// No entry...
 		return QVariant();
@@ -408,6 +497,15 @@ QVariant RvtHModel::data(const QModelIndex& index, int role) const
 	// TODO: Move some of this to RvtHItemDelegate?
 	switch (role) {
 		case Qt::DisplayRole:
+			if (!d->isBankLoaded(bank) && index.column() != COL_BANKNUM) {
+				// Bank is still being loaded.
+				// Only the bank number is known.
+				if (index.column() == COL_TITLE) {
+					return tr("Loading...");
+				}
+				return QVariant();
+			}
+
 			// TODO: Cache these?
 			switch (index.column()) {
 				case COL_BANKNUM: {
@@ -575,38 +673,101 @@ void RvtHModel::setRvtH(RvtH *rvth)
 
 	// NOTE: No signals, since librvth is a C library.
 
-	// Disconnect the Card's changed() signal if a Card is already set.
-	if (d->rvth) {
+	const int oldBankCount = static_cast<int>(d->bankCount());
+	const int newBankCount = (rvth ? static_cast<int>(rvth->bankCount()) : 0);
+	if (rvth && !d->rvth && oldBankCount > 0 && oldBankCount == newBankCount) {
+		// Replacing the preliminary bank table with the
+		// RvtH object that was loaded. Update the rows in
+		// place so the current selection is kept.
+		d->rvth = rvth;
+		d->tblEntries.clear();
+		d->tblLoaded.clear();
+		emit dataChanged(index(0, 0), index(newBankCount - 1, COL_MAX - 1));
+		return;
+	}
+
+	if (oldBankCount > 0) {
 		// Notify the view that we're about to remove all rows.
-		const int bankCount = d->rvth->bankCount();
-		if (bankCount > 0) {
-			beginRemoveRows(QModelIndex(), 0, (bankCount - 1));
-		}
+		beginRemoveRows(QModelIndex(), 0, (oldBankCount - 1));
+	}
 
-		d->rvth = nullptr;
+	d->rvth = nullptr;
+	d->tblEntries.clear();
+	d->tblLoaded.clear();
 
+	if (oldBankCount > 0) {
 		// Done removing rows.
-		if (bankCount > 0) {
-			endRemoveRows();
-		}
+		endRemoveRows();
 	}
 
 	if (rvth) {
 		// Notify the view that we're about to add rows.
-		const int bankCount = rvth->bankCount();
-		if (bankCount > 0) {
-			beginInsertRows(QModelIndex(), 0, (bankCount - 1));
+		if (newBankCount > 0) {
+			beginInsertRows(QModelIndex(), 0, (newBankCount - 1));
 		}
 
 		d->rvth = rvth;
 
 		// Done adding rows.
-		if (bankCount > 0) {
+		if (newBankCount > 0) {
 			endInsertRows();
 		}
 	}
 }
 
+/**
+ * Show a preliminary bank table while an RVT-H Reader
+ * disk image is being opened.
+ *
+ * The bank entries only need the bank types, LBAs, and
+ * timestamps. Banks are shown as loading until they're
+ * updated using updateBankEntry(). Calling setRvtH()
+ * replaces the preliminary bank table.
+ *
+ * @param imageType Image type. (See RvtH_ImageType_e.)
+ * @param entries Bank entries.
+ */
+void RvtHModel::setBankTable(int imageType, const QVector<RvtH_BankEntry> &entries)
+{
+	Q_D(RvtHModel);
+
+	// Remove the current banks.
+	setRvtH(nullptr);
+
+	if (entries.isEmpty()) {
+		// No banks.
+		return;
+	}
+
+	// Notify the view that we're about to add rows.
+	beginInsertRows(QModelIndex(), 0, (entries.size() - 1));
+
+	d->tblImageType = static_cast<RvtH_ImageType_e>(imageType);
+	d->tblEntries = entries;
+	d->tblLoaded.fill(false, entries.size());
+
+	// Done adding rows.
+	endInsertRows();
+}
+
+/**
+ * Update a bank entry in the preliminary bank table.
+ * @param bank Bank number.
+ * @param entry Fully-loaded bank entry.
+ */
+void RvtHModel::updateBankEntry(unsigned int bank, const RvtH_BankEntry &entry)
+{
+	Q_D(RvtHModel);
+	if (d->rvth || bank >= static_cast<unsigned int>(d->tblEntries.size())) {
+		// No preliminary bank table, or out of range.
+		return;
+	}
+
+	d->tblEntries[bank] = entry;
+	d->tblLoaded[bank] = true;
+	forceBankUpdate(bank);
+}
+
 /**
  * Load an icon.
  * @param id Icon ID.
@@ -649,10 +810,7 @@ void RvtHModel::themeChanged_slot(void)
 void RvtHModel::forceBankUpdate(unsigned int bank)
 {
 	Q_D(RvtHModel);
-	if (!d->rvth)
-		return;
-
-	const unsigned int bankCount = d->rvth->bankCount();
+	const unsigned int bankCount = d->bankCount();
 	if (bank >= bankCount) {
 		// Out of range.
 		return;
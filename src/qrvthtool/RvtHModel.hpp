@@ -22,9 +22,11 @@
 #define __RVTHTOOL_QRVTHTOOL_RVTHMODEL_HPP__
 
 class RvtH;
+struct _RvtH_BankEntry;
 
 // Qt includes.
 #include <QtCore/QAbstractListModel>
+#include <QtCore/QVector>
 
 class RvtHModelPrivate;
 class RvtHModel : public QAbstractListModel
@@ -85,6 +87,27 @@ class RvtHModel : public QAbstractListModel
 		 */
 		void setRvtH(RvtH *rvth);
 
+		/**
+		 * Show a preliminary bank table while an RVT-H Reader
+		 * disk image is being opened.
+		 *
+		 * The bank entries only need the bank types, LBAs, and
+		 * timestamps. Banks are shown as loading until they're
+		 * updated using updateBankEntry(). Calling setRvtH()
+		 * replaces the preliminary bank table.
+		 *
+		 * @param imageType Image type. (See RvtH_ImageType_e.)
+		 * @param entries Bank entries.
+		 */
+		void setBankTable(int imageType, const QVector<struct _RvtH_BankEntry> &entries);
+
+		/**
+		 * Update a bank entry in the preliminary bank table.
+		 * @param bank Bank number.
+		 * @param entry Fully-loaded bank entry.
+		 */
+		void updateBankEntry(unsigned int bank, const struct _RvtH_BankEntry &entry);
+
 		/**
 		 * Load an icon.
 		 * @param id Icon ID.
@@ -22,6 +22,8 @@
 
 // librvth
 #include "librvth/nhcd_structs.h"
+#include "librvth/rvth_error.h"
+#include "librvth/ProgressSink.hpp"
 
 // C includes. (C++ namespace)
 #include <cassert>
@@ -40,8 +42,7 @@ class WorkerObjectPrivate
 			, rvth(nullptr)
 			, bank(~0U)
 			, recryption_key(-1)
-			, flags(0U)
-			, cancel(false) { }
+			, flags(0U) { }
 
 	protected:
 		WorkerObject *const q_ptr;
@@ -55,90 +56,78 @@ class WorkerObjectPrivate
 		int recryption_key;
 		unsigned int flags;
 
+		QString rvthFilename;
 		QString gcmFilename;
 		QString gcmFilenameOnly;
 
-		// Cancel the current process.
-		// TODO: Mutex?
-		bool cancel;
+		// Progress of the current process.
+		// Updated by the copy loops without blocking, and polled
+		// by the UI using WorkerObject::progress().
+		// Cancelled by cancel(), which may be called from any thread.
+		ProgressSink progress;
 
 	public:
 		/**
-		 * RVT-H progress callback.
-		 * @param state		[in] Current progress.
-		 * @param userdata	[in] User data specified when calling the RVT-H function.
-		 * @return True to continue; false to abort.
+		 * Get the RvtH object for the current process.
+		 * If the RVT-H object isn't set, a new RvtH object
+		 * is opened using the RVT-H filename.
+		 * @param pErr	[out] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 * @return RvtH object, or nullptr on error. (Release it with releaseRvtH().)
 		 */
-		static bool progress_callback(const RvtH_Progress_State *state, void *userdata);
+		RvtH *getRvtH(int *pErr);
+
+		/**
+		 * Release an RvtH object returned by getRvtH().
+		 * @param rvth RvtH object.
+		 */
+		void releaseRvtH(RvtH *rvth);
 };
 
 /** WorkerObjectPrivate **/
 
 /**
- * RVT-H progress callback.
- * @param state		[in] Current progress.
- * @param userdata	[in] User data specified when calling the RVT-H function.
- * @return True to continue; false to abort.
+ * Get the RvtH object for the current process.
+ * If the RVT-H object isn't set, a new RvtH object
+ * is opened using the RVT-H filename.
+ * @param pErr	[out] Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ * @return RvtH object, or nullptr on error. (Release it with releaseRvtH().)
  */
-bool WorkerObjectPrivate::progress_callback(const RvtH_Progress_State *state, void *userdata)
+RvtH *WorkerObjectPrivate::getRvtH(int *pErr)
 {
-	WorkerObjectPrivate *const d = static_cast<WorkerObjectPrivate*>(userdata);
-	WorkerObject *const q = d->q_ptr;
-
-	// TODO: Don't show the bank number if the source image is a standalone disc image.
-	#define MEGABYTE (1048576 / LBA_SIZE)
-	QString text;
-	switch (state->type) {
-		case RVTH_PROGRESS_EXTRACT:
-			text = WorkerObject::tr("Extracting Bank %1 to %2: %L3 MiB / %L4 MiB copied...")
-				.arg(d->bank+1)
-				.arg(d->gcmFilenameOnly)
-				.arg(state->lba_processed / MEGABYTE)
-				.arg(state->lba_total / MEGABYTE);
-			break;
-		case RVTH_PROGRESS_IMPORT:
-			text = WorkerObject::tr("Importing from %1 to Bank %2: %L3 MiB / %L4 MiB copied...")
-				.arg(d->gcmFilenameOnly)
-				.arg(d->bank+1)
-				.arg(state->lba_processed / MEGABYTE)
-				.arg(state->lba_total / MEGABYTE);
-			break;
-		case RVTH_PROGRESS_RECRYPT:
-			if (state->lba_total <= 1) {
-				// TODO: Encryption types?
-				if (state->lba_processed == 0) {
-					text = WorkerObject::tr("Recrypting the ticket(s) and TMD(s)...");
-				}
-			} else {
-				// TODO: This doesn't seem to be used yet...
-				text = WorkerObject::tr("Recrypting Bank %1 to %2: %L3 MiB / %L4 MiB copied...")
-					.arg(d->bank+1)
-					.arg(d->gcmFilenameOnly)
-					.arg(state->lba_processed / MEGABYTE)
-					.arg(state->lba_total / MEGABYTE);
-			}
-			break;
-		default:
-			// FIXME
-			assert(false);
-			return false;
+	*pErr = 0;
+	if (this->rvth) {
+		return this->rvth;
+	} else if (rvthFilename.isEmpty()) {
+		*pErr = -EINVAL;
+		return nullptr;
 	}
 
-	// Update the progress bar.
-	if (state->type != RVTH_PROGRESS_RECRYPT) {
-		// Progress is valid.
-		emit q->updateStatus(text,
-			static_cast<int>(state->lba_processed),
-			static_cast<int>(state->lba_total));
-	} else {
-		// Progress is not useful here.
-		// Specify -1 for the values.
-		emit q->updateStatus(text, -1, -1);
+#ifdef _WIN32
+	RvtH *const rvth_tmp = new RvtH(reinterpret_cast<const wchar_t*>(rvthFilename.utf16()), pErr);
+#else /* !_WIN32 */
+	RvtH *const rvth_tmp = new RvtH(rvthFilename.toUtf8().constData(), pErr);
+#endif /* _WIN32 */
+	if (!rvth_tmp->isOpen() || *pErr != 0) {
+		if (*pErr == 0) {
+			*pErr = -EIO;
+		}
+		delete rvth_tmp;
+		return nullptr;
 	}
+	return rvth_tmp;
+}
 
-	// Return `true` to continue.
-	// If `cancel` is set, return `false` to cancel.
-	return !d->cancel;
+/**
+ * Release an RvtH object returned by getRvtH().
+ * @param rvth RvtH object.
+ */
+void WorkerObjectPrivate::releaseRvtH(RvtH *rvth)
+{
+	rvth->setProgressSink(nullptr);
+	if (rvth != this->rvth) {
+		// Opened by getRvtH().
+		delete rvth;
+	}
 }
 
 /** WorkerObject **/
@@ -148,6 +137,11 @@ WorkerObject::WorkerObject(QObject *parent)
 	, d_ptr(new WorkerObjectPrivate(this))
 { }
 
+WorkerObject::~WorkerObject()
+{
+	delete d_ptr;
+}
+
 /** Properties **/
 
 /**
@@ -190,6 +184,31 @@ void WorkerObject::setBank(unsigned int bank)
 	d->bank = bank;
 }
 
+/**
+ * Get the RVT-H filename.
+ * @return RVT-H filename.
+ */
+QString WorkerObject::rvthFilename(void) const
+{
+	Q_D(const WorkerObject);
+	return d->rvthFilename;
+}
+
+/**
+ * Set the RVT-H filename.
+ *
+ * If the RVT-H object isn't set, a separate RvtH object is
+ * opened for this file on the worker thread, so the process
+ * doesn't depend on the RvtH object shown in the UI.
+ *
+ * @param filename RVT-H filename.
+ */
+void WorkerObject::setRvtHFilename(const QString &filename)
+{
+	Q_D(WorkerObject);
+	d->rvthFilename = filename;
+}
+
 /**
  * Get the GCM filename.
  * For extract: This will be the destination GCM.
@@ -255,22 +274,92 @@ void WorkerObject::setFlags(unsigned int flags)
 	d->flags = flags;
 }
 
+/** Progress **/
+
+/**
+ * Get the current progress.
+ *
+ * The process doesn't report progress using signals, since
+ * that would slow down the copy loop. Instead, the UI should
+ * poll this function periodically while the process is running.
+ *
+ * This may be called from any thread.
+ *
+ * @param pText Status text.
+ * @param pProgressValue Progress value. (-1 if progress isn't valid.)
+ * @param pProgressMax Progress maximum. (-1 if progress isn't valid.)
+ * @return True if progress is available; false if the process hasn't started copying.
+ */
+bool WorkerObject::progress(QString *pText, int *pProgressValue, int *pProgressMax) const
+{
+	Q_D(const WorkerObject);
+	RvtH_Progress_Snapshot snapshot;
+	d->progress.snapshot(&snapshot);
+
+	// TODO: Don't show the bank number if the source image is a standalone disc image.
+	#define MEGABYTE (1048576 / LBA_SIZE)
+	const unsigned int mib_per_sec = static_cast<unsigned int>(snapshot.throughput / 1048576);
+	switch (snapshot.type) {
+		case RVTH_PROGRESS_UNKNOWN:
+			// Not copying yet.
+			return false;
+		case RVTH_PROGRESS_EXTRACT:
+			*pText = tr("Extracting Bank %1 to %2: %L3 MiB / %L4 MiB copied (%L5 MiB/s)...")
+				.arg(d->bank+1)
+				.arg(d->gcmFilenameOnly)
+				.arg(snapshot.lba_processed / MEGABYTE)
+				.arg(snapshot.lba_total / MEGABYTE)
+				.arg(mib_per_sec);
+			break;
+		case RVTH_PROGRESS_IMPORT:
+			*pText = tr("Importing from %1 to Bank %2: %L3 MiB / %L4 MiB copied (%L5 MiB/s)...")
+				.arg(d->gcmFilenameOnly)
+				.arg(d->bank+1)
+				.arg(snapshot.lba_processed / MEGABYTE)
+				.arg(snapshot.lba_total / MEGABYTE)
+				.arg(mib_per_sec);
+			break;
+		case RVTH_PROGRESS_RECRYPT:
+			// TODO: Encryption types?
+			*pText = tr("Recrypting the ticket(s) and TMD(s)...");
+			break;
+		default:
+			// FIXME
+			assert(false);
+			return false;
+	}
+
+	// Update the progress bar.
+	if (snapshot.type != RVTH_PROGRESS_RECRYPT) {
+		// Progress is valid.
+		*pProgressValue = static_cast<int>(snapshot.lba_processed);
+		*pProgressMax = static_cast<int>(snapshot.lba_total);
+	} else {
+		// Progress is not useful here.
+		// Specify -1 for the values.
+		*pProgressValue = -1;
+		*pProgressMax = -1;
+	}
+	return true;
+}
+
 /** Worker functions **/
 
 /**
  * Cancel the current process.
+ * This may be called from any thread.
  */
 void WorkerObject::cancel(void)
 {
 	Q_D(WorkerObject);
-	d->cancel = true;
+	d->progress.cancel();
 }
 
 /**
  * Start an extraction process.
  *
  * The following properties must be set before calling this function:
- * - rvth
+ * - rvth or rvthFilename
  * - bank
  * - gcmFilename
  *
@@ -280,34 +369,45 @@ void WorkerObject::cancel(void)
  */
 void WorkerObject::doExtract(void)
 {
-	// NOTE: Callback is set to use the private class.
 	Q_D(WorkerObject);
-	if (!d->rvth) {
+	if (!d->rvth && d->rvthFilename.isEmpty()) {
 		emit finished(tr("doExtract() ERROR: rvth object is not set."), -EINVAL);
 		return;
-	} else if (d->bank >= d->rvth->bankCount()) {
-		if (d->bank == ~0U) {
-			emit finished(tr("doExtract() ERROR: Bank number is not set."), -EINVAL);
-		} else {
-			emit finished(tr("doExtract() ERROR: Bank number %1 is out of range.")
-				.arg(d->bank+1), -ERANGE);
-		}
+	} else if (d->bank == ~0U) {
+		emit finished(tr("doExtract() ERROR: Bank number is not set."), -EINVAL);
 		return;
 	} else if (d->gcmFilename.isEmpty()) {
 		emit finished(tr("doExtract() ERROR: gcmFilename is not set."), -EINVAL);
 		return;
 	}
 
-	d->cancel = false;
+	int ret = 0;
+	RvtH *const rvth = d->getRvtH(&ret);
+	if (!rvth) {
+		emit finished(tr("doExtract() ERROR opening %1: %2")
+			.arg(d->rvthFilename)
+			.arg(QString::fromUtf8(rvth_error(ret))), ret);
+		return;
+	} else if (d->bank >= rvth->bankCount()) {
+		d->releaseRvtH(rvth);
+		emit finished(tr("doExtract() ERROR: Bank number %1 is out of range.")
+			.arg(d->bank+1), -ERANGE);
+		return;
+	}
+
+	// NOTE: If cancel() was called before the process started,
+	// the copy loop will abort at the first progress update.
+	rvth->setProgressSink(&d->progress);
 #ifdef _WIN32
-	int ret = d->rvth->extract(d->bank,
+	ret = rvth->extract(d->bank,
 		reinterpret_cast<const wchar_t*>(d->gcmFilename.utf16()),
-		d->recryption_key, d->flags, d->progress_callback, d);
+		d->recryption_key, d->flags);
 #else /* !_WIN32 */
-	int ret = d->rvth->extract(d->bank,
+	ret = rvth->extract(d->bank,
 		d->gcmFilename.toUtf8().constData(),
-		d->recryption_key, d->flags, d->progress_callback, d);
+		d->recryption_key, d->flags);
 #endif /* _WIN32 */
+	d->releaseRvtH(rvth);
 
 	if (ret == 0) {
 		// Successfully extracted.
@@ -324,40 +424,49 @@ void WorkerObject::doExtract(void)
  * Start an import process.
  *
  * The following properties must be set before calling this function:
- * - rvth
+ * - rvth or rvthFilename
  * - bank
  * - gcmFilename
  */
 void WorkerObject::doImport(void)
 {
-	// NOTE: Callback is set to use the private class.
 	Q_D(WorkerObject);
-	if (!d->rvth) {
+	if (!d->rvth && d->rvthFilename.isEmpty()) {
 		emit finished(tr("doImport() ERROR: rvth object is not set."), -EINVAL);
 		return;
-	} else if (d->bank >= d->rvth->bankCount()) {
-		if (d->bank == ~0U) {
-			emit finished(tr("doImport() ERROR: Bank number is not set."), -EINVAL);
-		} else {
-			emit finished(tr("doImport() ERROR: Bank number %1 is out of range.")
-				.arg(d->bank+1), -ERANGE);
-		}
+	} else if (d->bank == ~0U) {
+		emit finished(tr("doImport() ERROR: Bank number is not set."), -EINVAL);
 		return;
 	} else if (d->gcmFilename.isEmpty()) {
 		emit finished(tr("doImport() ERROR: gcmFilename is not set."), -EINVAL);
 		return;
 	}
 
-	d->cancel = false;
+	int ret = 0;
+	RvtH *const rvth = d->getRvtH(&ret);
+	if (!rvth) {
+		emit finished(tr("doImport() ERROR opening %1: %2")
+			.arg(d->rvthFilename)
+			.arg(QString::fromUtf8(rvth_error(ret))), ret);
+		return;
+	} else if (d->bank >= rvth->bankCount()) {
+		d->releaseRvtH(rvth);
+		emit finished(tr("doImport() ERROR: Bank number %1 is out of range.")
+			.arg(d->bank+1), -ERANGE);
+		return;
+	}
+
+	// NOTE: If cancel() was called before the process started,
+	// the copy loop will abort at the first progress update.
+	rvth->setProgressSink(&d->progress);
 #ifdef _WIN32
-	int ret = d->rvth->import(d->bank,
-		reinterpret_cast<const wchar_t*>(d->gcmFilename.utf16()),
-		d->progress_callback, d);
+	ret = rvth->import(d->bank,
+		reinterpret_cast<const wchar_t*>(d->gcmFilename.utf16()));
 #else /* !_WIN32 */
-	int ret = d->rvth->import(d->bank,
-		d->gcmFilename.toUtf8().constData(),
-		d->progress_callback, d);
+	ret = rvth->import(d->bank,
+		d->gcmFilename.toUtf8().constData());
 #endif /* _WIN32 */
+	d->releaseRvtH(rvth);
 
 	if (ret == 0) {
 		// Successfully extracted.
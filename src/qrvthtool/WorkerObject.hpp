@@ -36,12 +36,14 @@ class WorkerObject : public QObject
 	typedef QObject super;
 
 	Q_PROPERTY(RvtH* rvth READ rvth WRITE setRvtH)
+	Q_PROPERTY(QString rvthFilename READ rvthFilename WRITE setRvtHFilename)
 	Q_PROPERTY(unsigned int bank READ bank WRITE setBank)
 	Q_PROPERTY(QString gcmFilename READ gcmFilename WRITE setGcmFilename)
 	Q_PROPERTY(int recryptionKey READ recryptionKey WRITE setRecryptionKey)
 	
 	public:
 		explicit WorkerObject(QObject *parent = nullptr);
+		virtual ~WorkerObject();
 
 	protected:
 		WorkerObjectPrivate *const d_ptr;
@@ -64,6 +66,23 @@ class WorkerObject : public QObject
 		 */
 		void setRvtH(RvtH *rvth);
 
+		/**
+		 * Get the RVT-H filename.
+		 * @return RVT-H filename.
+		 */
+		QString rvthFilename(void) const;
+
+		/**
+		 * Set the RVT-H filename.
+		 *
+		 * If the RVT-H object isn't set, a separate RvtH object is
+		 * opened for this file on the worker thread, so the process
+		 * doesn't depend on the RvtH object shown in the UI.
+		 *
+		 * @param filename RVT-H filename.
+		 */
+		void setRvtHFilename(const QString &filename);
+
 		/**
 		 * Get the RVT-H bank number.
 		 * @return RVT-H bank number. (~0 if not set)
@@ -116,16 +135,27 @@ class WorkerObject : public QObject
 		 */
 		void setFlags(unsigned int flags);
 
-	signals:
-		/** Signals **/
+	public:
+		/** Progress **/
 
 		/**
-		 * Update the status bar.
-		 * @param text Status bar text.
-		 * @param progress_value Progress bar value. (If -1, ignore this.)
-		 * @param progress_max Progress bar maximum. (If -1, ignore this.)
+		 * Get the current progress.
+		 *
+		 * The process doesn't report progress using signals, since
+		 * that would slow down the copy loop. Instead, the UI should
+		 * poll this function periodically while the process is running.
+		 *
+		 * This may be called from any thread.
+		 *
+		 * @param pText Status text.
+		 * @param pProgressValue Progress value. (-1 if progress isn't valid.)
+		 * @param pProgressMax Progress maximum. (-1 if progress isn't valid.)
+		 * @return True if progress is available; false if the process hasn't started copying.
 		 */
-		void updateStatus(const QString &text, int progress_value, int progress_max);
+		bool progress(QString *pText, int *pProgressValue, int *pProgressMax) const;
+
+	signals:
+		/** Signals **/
 
 		/**
 		 * Process is finished.
@@ -139,6 +169,7 @@ class WorkerObject : public QObject
 
 		/**
 		 * Cancel the current process.
+		 * This may be called from any thread.
 		 */
 		void cancel(void);
 
@@ -146,7 +177,7 @@ class WorkerObject : public QObject
 		 * Start an extraction process.
 		 *
 		 * The following properties must be set before calling this function:
-		 * - rvth
+		 * - rvth or rvthFilename
 		 * - bank
 		 * - gcmFilename
 		 *
@@ -160,7 +191,7 @@ class WorkerObject : public QObject
 		 * Start an import process.
 		 *
 		 * The following properties must be set before calling this function:
-		 * - rvth
+		 * - rvth or rvthFilename
 		 * - bank
 		 * - gcmFilename
 		 */
@@ -0,0 +1,219 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * JobQueueView.cpp: Job queue view widget.                                *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "JobQueueView.hpp"
+#include "JobQueue.hpp"
+
+// Qt includes.
+#include <QtCore/QEvent>
+#include <QtWidgets/QHeaderView>
+
+/** JobQueueViewPrivate **/
+
+#include "ui_JobQueueView.h"
+class JobQueueViewPrivate
+{
+	public:
+		explicit JobQueueViewPrivate(JobQueueView *q);
+
+	protected:
+		JobQueueView *const q_ptr;
+		Q_DECLARE_PUBLIC(JobQueueView)
+	private:
+		Q_DISABLE_COPY(JobQueueViewPrivate)
+
+	public:
+		// UI
+		Ui::JobQueueView ui;
+
+		JobQueue *jobQueue;
+
+		/**
+		 * Get the row number of the selected job.
+		 * @return Row number, or -1 if no job is selected.
+		 */
+		int selectedRow(void) const;
+};
+
+JobQueueViewPrivate::JobQueueViewPrivate(JobQueueView *q)
+	: q_ptr(q)
+	, jobQueue(nullptr)
+{ }
+
+/**
+ * Get the row number of the selected job.
+ * @return Row number, or -1 if no job is selected.
+ */
+int JobQueueViewPrivate::selectedRow(void) const
+{
+	if (!jobQueue)
+		return -1;
+
+	const QItemSelectionModel *const selectionModel = ui.lstJobs->selectionModel();
+	if (!selectionModel || !selectionModel->hasSelection())
+		return -1;
+
+	const QModelIndex index = selectionModel->currentIndex();
+	return (index.isValid() ? index.row() : -1);
+}
+
+/** JobQueueView **/
+
+JobQueueView::JobQueueView(QWidget *parent)
+	: super(parent)
+	, d_ptr(new JobQueueViewPrivate(this))
+{
+	Q_D(JobQueueView);
+	d->ui.setupUi(this);
+
+	d->ui.spnMaxJobs->setRange(1, JOBQUEUE_MAX_JOBS_LIMIT);
+	d->ui.spnMaxJobs->setValue(JOBQUEUE_DEFAULT_MAX_JOBS);
+}
+
+JobQueueView::~JobQueueView()
+{
+	delete d_ptr;
+}
+
+/**
+ * Get the JobQueue being displayed.
+ * @return JobQueue.
+ */
+JobQueue *JobQueueView::jobQueue(void) const
+{
+	Q_D(const JobQueueView);
+	return d->jobQueue;
+}
+
+/**
+ * Set the JobQueue being displayed.
+ * @param jobQueue JobQueue.
+ */
+void JobQueueView::setJobQueue(JobQueue *jobQueue)
+{
+	Q_D(JobQueueView);
+
+	if (d->jobQueue) {
+		// Disconnect slots from the existing JobQueue.
+		disconnect(d->jobQueue, &QObject::destroyed,
+			   this, &JobQueueView::jobQueue_destroyed_slot);
+		disconnect(d->jobQueue, &JobQueue::maxConcurrentJobsChanged,
+			   this, &JobQueueView::jobQueue_maxConcurrentJobsChanged);
+		disconnect(d->jobQueue, &QAbstractItemModel::dataChanged,
+			   this, &JobQueueView::updateBtnCancelJob);
+		disconnect(d->jobQueue, &QAbstractItemModel::rowsRemoved,
+			   this, &JobQueueView::updateBtnCancelJob);
+	}
+
+	d->jobQueue = jobQueue;
+	d->ui.lstJobs->setModel(jobQueue);
+
+	if (d->jobQueue) {
+		// Connect slots to the new JobQueue.
+		connect(d->jobQueue, &QObject::destroyed,
+			this, &JobQueueView::jobQueue_destroyed_slot);
+		connect(d->jobQueue, &JobQueue::maxConcurrentJobsChanged,
+			this, &JobQueueView::jobQueue_maxConcurrentJobsChanged);
+		connect(d->jobQueue, &QAbstractItemModel::dataChanged,
+			this, &JobQueueView::updateBtnCancelJob);
+		connect(d->jobQueue, &QAbstractItemModel::rowsRemoved,
+			this, &JobQueueView::updateBtnCancelJob);
+
+		// NOTE: setModel() creates a new selection model.
+		connect(d->ui.lstJobs->selectionModel(), &QItemSelectionModel::currentChanged,
+			this, &JobQueueView::updateBtnCancelJob);
+
+		// The message column should use the remaining space.
+		d->ui.lstJobs->header()->setStretchLastSection(true);
+		d->ui.lstJobs->resizeColumnToContents(JobQueue::COL_STATUS);
+		d->ui.lstJobs->resizeColumnToContents(JobQueue::COL_PROGRESS);
+
+		d->ui.spnMaxJobs->setValue(d->jobQueue->maxConcurrentJobs());
+	}
+
+	updateBtnCancelJob();
+}
+
+/**
+ * Widget state has changed.
+ * @param event State change event.
+ */
+void JobQueueView::changeEvent(QEvent *event)
+{
+	if (event->type() == QEvent::LanguageChange) {
+		// Retranslate the UI.
+		Q_D(JobQueueView);
+		d->ui.retranslateUi(this);
+	}
+
+	// Pass the event to the base class.
+	super::changeEvent(event);
+}
+
+/** UI widget slots **/
+
+void JobQueueView::on_btnCancelJob_clicked(void)
+{
+	Q_D(JobQueueView);
+	const int row = d->selectedRow();
+	if (row >= 0) {
+		d->jobQueue->cancelJob(row);
+	}
+	updateBtnCancelJob();
+}
+
+void JobQueueView::on_btnClearFinished_clicked(void)
+{
+	Q_D(JobQueueView);
+	if (d->jobQueue) {
+		d->jobQueue->clearFinished();
+	}
+}
+
+void JobQueueView::on_spnMaxJobs_valueChanged(int value)
+{
+	Q_D(JobQueueView);
+	if (d->jobQueue) {
+		d->jobQueue->setMaxConcurrentJobs(value);
+	}
+}
+
+/**
+ * Update the "enabled" status of the Cancel Job button.
+ */
+void JobQueueView::updateBtnCancelJob(void)
+{
+	Q_D(JobQueueView);
+	const int row = d->selectedRow();
+	d->ui.btnCancelJob->setEnabled(row >= 0 && d->jobQueue->canCancel(row));
+}
+
+/**
+ * The JobQueue's maximum number of jobs has changed.
+ * @param maxJobs Maximum number of jobs.
+ */
+void JobQueueView::jobQueue_maxConcurrentJobsChanged(int maxJobs)
+{
+	Q_D(JobQueueView);
+	// NOTE: QSpinBox doesn't emit valueChanged() if the value is the same.
+	d->ui.spnMaxJobs->setValue(maxJobs);
+}
+
+/**
+ * The JobQueue object was destroyed.
+ * @param obj QObject that was destroyed.
+ */
+void JobQueueView::jobQueue_destroyed_slot(QObject *obj)
+{
+	Q_D(JobQueueView);
+	if (obj == d->jobQueue) {
+		// Our JobQueue was destroyed.
+		d->jobQueue = nullptr;
+		d->ui.btnCancelJob->setEnabled(false);
+	}
+}
@@ -0,0 +1,74 @@
+/***************************************************************************
+ * RVT-H Tool (qrvthtool)                                                  *
+ * JobQueueView.hpp: Job queue view widget.                                *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_QRVTHTOOL_WIDGETS_JOBQUEUEVIEW_HPP__
+#define __RVTHTOOL_QRVTHTOOL_WIDGETS_JOBQUEUEVIEW_HPP__
+
+#include <QWidget>
+
+class JobQueue;
+
+class JobQueueViewPrivate;
+class JobQueueView : public QWidget
+{
+	Q_OBJECT
+	typedef QWidget super;
+
+	public:
+		explicit JobQueueView(QWidget *parent = nullptr);
+		virtual ~JobQueueView();
+
+	protected:
+		JobQueueViewPrivate *const d_ptr;
+		Q_DECLARE_PRIVATE(JobQueueView)
+	private:
+		Q_DISABLE_COPY(JobQueueView)
+
+	public:
+		/**
+		 * Get the JobQueue being displayed.
+		 * @return JobQueue.
+		 */
+		JobQueue *jobQueue(void) const;
+
+		/**
+		 * Set the JobQueue being displayed.
+		 * @param jobQueue JobQueue.
+		 */
+		void setJobQueue(JobQueue *jobQueue);
+
+	protected:
+		// State change event. (Used for switching the UI language at runtime.)
+		void changeEvent(QEvent *event) final;
+
+	protected slots:
+		/** UI widget slots **/
+
+		void on_btnCancelJob_clicked(void);
+		void on_btnClearFinished_clicked(void);
+		void on_spnMaxJobs_valueChanged(int value);
+
+		/**
+		 * Update the "enabled" status of the Cancel Job button.
+		 */
+		void updateBtnCancelJob(void);
+
+		/**
+		 * The JobQueue's maximum number of jobs has changed.
+		 * @param maxJobs Maximum number of jobs.
+		 */
+		void jobQueue_maxConcurrentJobsChanged(int maxJobs);
+
+		/**
+		 * The JobQueue object was destroyed.
+		 * @param obj QObject that was destroyed.
+		 */
+		void jobQueue_destroyed_slot(QObject *obj);
+};
+
+#endif /* __RVTHTOOL_QRVTHTOOL_WIDGETS_JOBQUEUEVIEW_HPP__ */
@@ -17,8 +17,10 @@
 
 #include "RvtHModel.hpp"
 #include "RvtHSortFilterProxyModel.hpp"
+#include "RvtHLoader.hpp"
 #include "MessageSound.hpp"
 
+#include "widgets/JobQueueView.hpp"
 #include "widgets/MessageWidgetStack.hpp"
 #include "windows/SelectDeviceDialog.hpp"
 
@@ -29,6 +31,7 @@
 #include <QtCore/QThread>
 #include <QtGui/QCloseEvent>
 #include <QtWidgets/QComboBox>
+#include <QtWidgets/QDockWidget>
 #include <QtWidgets/QFileDialog>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QProgressBar>
@@ -37,9 +40,6 @@
 // RVL_CryptoType_e
 #include "libwiicrypto/sig_tools.h"
 
-// Worker object for the worker thread.
-#include "WorkerObject.hpp"
-
 // Taskbar Button Manager.
 #include "TaskbarButtonManager/TaskbarButtonManager.hpp"
 #include "TaskbarButtonManager/TaskbarButtonManagerFactory.hpp"
@@ -76,6 +76,16 @@ class QRvtHToolWindowPrivate
 		// Filename.
 		QString filename;
 
+		// RvtH loader.
+		// If not nullptr, the RVT-H Reader disk image is being
+		// opened on loaderThread, and rvth is nullptr.
+		RvtHLoader *loader;
+		QThread *loaderThread;
+
+		// Bank to select once the RVT-H Reader disk image is opened.
+		// (-1 for none)
+		int reselectBank;
+
 		// TODO: Config class like mcrecover?
 		QString lastPath;
 
@@ -93,6 +103,13 @@ class QRvtHToolWindowPrivate
 		// NHCD tables and disabled otherwise.
 		bool write_enabled;
 
+		/**
+		 * Stop opening the current RVT-H Reader disk image.
+		 * The loader's result is ignored. The loader and its
+		 * thread are deleted once the loader finishes.
+		 */
+		void abortLoader(void);
+
 		/**
 		 * Update the RVT-H Reader disk image's QTreeView.
 		 */
@@ -140,9 +157,10 @@ class QRvtHToolWindowPrivate
 		QToolButton *btnCancel;
 		QProgressBar *progressBar;
 
-		// Worker thread.
-		QThread *workerThread;
-		WorkerObject *workerObject;
+		// Extract/import job queue.
+		JobQueue *jobQueue;
+		QDockWidget *dockJobQueue;
+		JobQueueView *jobQueueView;
 
 		// UI busy counter
 		int uiBusyCounter;
@@ -150,10 +168,18 @@ class QRvtHToolWindowPrivate
 		// Taskbar Button Manager.
 		TaskbarButtonManager *taskbarButtonManager;
 
-	public:
-		// Update status.
-		bool updateStatus_didInitialUpdate;
-		int updateStatus_bank;
+		/**
+		 * Get the bank number of the selected bank.
+		 * @return Bank number, or -1 if no bank is selected.
+		 */
+		int selectedBank(void) const;
+
+		/**
+		 * Update the status bar's progress bar and the
+		 * taskbar button using the combined progress
+		 * of all running jobs.
+		 */
+		void updateJobProgress(void);
 };
 
 QRvtHToolWindowPrivate::QRvtHToolWindowPrivate(QRvtHToolWindow *q)
@@ -161,38 +187,53 @@ QRvtHToolWindowPrivate::QRvtHToolWindowPrivate(QRvtHToolWindow *q)
 	, rvth(nullptr)
 	, model(new RvtHModel(q))
 	, proxyModel(new RvtHSortFilterProxyModel(q))
+	, loader(nullptr)
+	, loaderThread(nullptr)
+	, reselectBank(-1)
 	, lastIconID(RvtHModel::ICON_MAX)
 	, cols_init(false)
 	, write_enabled(false)
 	, lblRecryptionKey(nullptr)
 	, cboRecryptionKey(nullptr)
 	, lblMessage(nullptr)
+	, btnCancel(nullptr)
 	, progressBar(nullptr)
-	, workerThread(nullptr)
-	, workerObject(nullptr)
+	, jobQueue(new JobQueue(q))
+	, dockJobQueue(nullptr)
+	, jobQueueView(nullptr)
 	, uiBusyCounter(0)
 	, taskbarButtonManager(nullptr)
-	, updateStatus_didInitialUpdate(false)
-	, updateStatus_bank(0)
 {
 	// Connect the RvtHModel slots.
 	QObject::connect(model, &RvtHModel::layoutChanged,
 			 q, &QRvtHToolWindow::rvthModel_layoutChanged);
 	QObject::connect(model, &RvtHModel::rowsInserted,
 			 q, &QRvtHToolWindow::rvthModel_rowsInserted);
+
+	// Connect the JobQueue slots.
+	QObject::connect(jobQueue, &JobQueue::jobProgress,
+			 q, &QRvtHToolWindow::jobQueue_jobProgress);
+	QObject::connect(jobQueue, &JobQueue::jobFinished,
+			 q, &QRvtHToolWindow::jobQueue_jobFinished);
+	QObject::connect(jobQueue, &JobQueue::activeJobsChanged,
+			 q, &QRvtHToolWindow::jobQueue_activeJobsChanged);
 }
 
 QRvtHToolWindowPrivate::~QRvtHToolWindowPrivate()
 {
-	if (workerThread) {
-		// Worker thread is still running...
-		// TODO: Cancel it instead of simply quitting.
-		workerThread->quit();
-		do {
-			workerThread->wait(250);
-		} while (workerThread->isRunning());
+	// Cancel any running jobs and wait for them to stop.
+	// NOTE: The window can't be closed while jobs are running,
+	// so this should only happen if the program is exiting.
+	delete jobQueue;
+
+	if (loader) {
+		// Stop opening the RVT-H Reader disk image.
+		// NOTE: The loader and its thread are deleted
+		// once the thread finishes.
+		loader->cancel();
+		loaderThread->quit();
+		loaderThread->wait();
 	}
-	delete workerObject;
 
 	// NOTE: Delete the RvtHModel first to prevent issues later.
 	delete model;
@@ -201,12 +242,36 @@ QRvtHToolWindowPrivate::~QRvtHToolWindowPrivate()
 	}
 }
 
+/**
+ * Stop opening the current RVT-H Reader disk image.
+ * The loader's result is ignored. The loader and its
+ * thread are deleted once the loader finishes.
+ */
+void QRvtHToolWindowPrivate::abortLoader(void)
+{
+	if (!loader)
+		return;
+
+	// NOTE: The loader's signals are still delivered, but
+	// the slots ignore signals from loaders other than the
+	// current one.
+	loader->cancel();
+	loader = nullptr;
+	loaderThread = nullptr;
+	reselectBank = -1;
+	lblMessage->clear();
+}
+
 /**
  * Update the RVT-H Reader disk image's QTreeView.
  */
 void QRvtHToolWindowPrivate::updateLstBankList(void)
 {
-	if (!rvth) {
+	if (loader) {
+		// RVT-H Reader disk image is being opened.
+		ui.grpBankList->setTitle(QRvtHToolWindow::tr("Opening %1...")
+			.arg(getDisplayFilename(filename)));
+	} else if (!rvth) {
 		// Set the group box's title.
 		ui.grpBankList->setTitle(QRvtHToolWindow::tr("No RVT-H Reader disk image loaded."));
 	} else {
@@ -261,6 +326,11 @@ void QRvtHToolWindowPrivate::updateLstBankList(void)
 				imageType = QRvtHToolWindow::tr("SDK Disc Image");
 				break;
 
+			// WBFS (one bank per disc slot)
+			case RVTH_ImageType_WBFS:
+				imageType = QRvtHToolWindow::tr("WBFS Image");
+				break;
+
 			default:
 				break;
 		}
@@ -280,8 +350,9 @@ void QRvtHToolWindowPrivate::updateLstBankList(void)
 		}
 	}
 
-	// Show the QTreeView headers if an RVT-H Reader disk image is loaded.
-	ui.lstBankList->setHeaderHidden(!rvth);
+	// Show the QTreeView headers if an RVT-H Reader disk image is loaded
+	// or if the bank table is being shown while it's being opened.
+	ui.lstBankList->setHeaderHidden(model->rowCount() == 0);
 
 	// Resize the columns to fit the contents.
 	int num_sections = model->columnCount();
@@ -297,7 +368,8 @@ void QRvtHToolWindowPrivate::updateActionEnableStatus(void)
 {
 	if (!rvth) {
 		// No RVT-H Reader image is loaded.
-		ui.actionClose->setEnabled(false);
+		// If it's still being opened, Close cancels opening it.
+		ui.actionClose->setEnabled(loader != nullptr);
 		ui.actionExtract->setEnabled(false);
 		ui.actionImport->setEnabled(false);
 		ui.actionDelete->setEnabled(false);
@@ -317,6 +389,10 @@ void QRvtHToolWindowPrivate::updateActionEnableStatus(void)
 			// True if using an actual RVT-H Reader with valid NHCD table;
 			// false otherwise.
 			if (this->write_enabled) {
+				// Banks used by queued or running jobs can't be deleted or undeleted.
+				const int bank = selectedBank();
+				const bool busy = (bank >= 0 && jobQueue->isBankBusy(filename, bank));
+
 				if (entry->type == RVTH_BankType_Empty) {
 					// Bank is empty.
 					// Enable Import; disable Delete and Undelete.
@@ -328,8 +404,8 @@ void QRvtHToolWindowPrivate::updateActionEnableStatus(void)
 					// Enable Import and Undelete if the bank is deleted.
 					// Enable Delete if the bank is not deleted.
 					ui.actionImport->setEnabled(entry->is_deleted);
-					ui.actionUndelete->setEnabled(entry->is_deleted);
-					ui.actionDelete->setEnabled(!entry->is_deleted);
+					ui.actionUndelete->setEnabled(entry->is_deleted && !busy);
+					ui.actionDelete->setEnabled(!entry->is_deleted && !busy);
 				}
 			} else {
 				// Not an RVT-H Reader. Disable all writing functions.
@@ -445,6 +521,51 @@ QString QRvtHToolWindowPrivate::getDisplayFilename(const QString &filename)
 	return rfn;
 }
 
+/**
+ * Get the bank number of the selected bank.
+ * @return Bank number, or -1 if no bank is selected.
+ */
+int QRvtHToolWindowPrivate::selectedBank(void) const
+{
+	// Only one bank can be selected.
+	const QItemSelectionModel *const selectionModel = ui.lstBankList->selectionModel();
+	if (!selectionModel->hasSelection())
+		return -1;
+
+	const QModelIndex index = selectionModel->currentIndex();
+	if (!index.isValid())
+		return -1;
+
+	// TODO: Sort proxy model like in mcrecover.
+	return proxyModel->mapToSource(index).row();
+}
+
+/**
+ * Update the status bar's progress bar and the
+ * taskbar button using the combined progress
+ * of all running jobs.
+ */
+void QRvtHToolWindowPrivate::updateJobProgress(void)
+{
+	int progress_value, progress_max;
+	if (!jobQueue->totalProgress(&progress_value, &progress_max)) {
+		// No progress has been reported yet.
+		return;
+	}
+
+	if (progressBar->maximum() != progress_max) {
+		progressBar->setMaximum(progress_max);
+	}
+	progressBar->setValue(progress_value);
+
+	if (taskbarButtonManager) {
+		if (taskbarButtonManager->progressBarMax() != progress_max) {
+			taskbarButtonManager->setProgressBarMax(progress_max);
+		}
+		taskbarButtonManager->setProgressBarValue(progress_value);
+	}
+}
+
 /**
  * Initialize the toolbar.
  */
@@ -593,6 +714,16 @@ QRvtHToolWindow::QRvtHToolWindow(QWidget *parent)
 	d->progressBar->setMinimumWidth(320);
 	d->progressBar->setMaximumWidth(320);
 
+	/** Job queue **/
+	// The dock widget is hidden until a job is queued.
+	d->jobQueueView = new JobQueueView();
+	d->jobQueueView->setJobQueue(d->jobQueue);
+	d->dockJobQueue = new QDockWidget(tr("Job Queue"), this);
+	d->dockJobQueue->setObjectName(QLatin1String("dockJobQueue"));
+	d->dockJobQueue->setWidget(d->jobQueueView);
+	d->dockJobQueue->setVisible(false);
+	this->addDockWidget(Qt::BottomDockWidgetArea, d->dockJobQueue);
+
 	// Connect the lstBankList selection signal.
 	connect(d->ui.lstBankList->selectionModel(), &QItemSelectionModel::selectionChanged,
 		this, &QRvtHToolWindow::lstBankList_selectionModel_selectionChanged);
@@ -610,95 +741,63 @@ QRvtHToolWindow::~QRvtHToolWindow()
 
 /**
  * Open an RVT-H Reader disk image.
+ *
+ * The disk image is opened on a worker thread. For RVT-H Readers
+ * and HDD images, the bank table is shown as soon as it's read,
+ * and each bank is filled in once it's loaded.
+ *
  * @param filename Filename.
  */
 void QRvtHToolWindow::openRvtH(const QString &filename)
 {
 	Q_D(QRvtHToolWindow);
 
+	// Stop opening the previous image, if it's still being opened.
+	d->abortLoader();
+
 	if (d->rvth) {
 		d->model->setRvtH(nullptr);
 		delete d->rvth;
+		d->rvth = nullptr;
 	}
 
-	// Open the specified RVT-H Reader disk image.
-	int err = 0;
-#ifdef _WIN32
-	RvtH *const rvth_tmp = new RvtH(reinterpret_cast<const wchar_t*>(filename.utf16()), &err);
-#else /* !_WIN32 */
-	RvtH *const rvth_tmp = new RvtH(filename.toUtf8().constData(), &err);
-#endif
-	if (!rvth_tmp->isOpen() || err != 0) {
-		// Unable to open the RVT-H Reader disk image.
-		const QString errMsg = tr("An error occurred while opening '%1': %2")
-			.arg(d->getDisplayFilename(filename))
-			.arg(QString::fromUtf8(rvth_error(err)));
-		d->ui.msgWidget->showMessage(errMsg, MessageWidget::ICON_CRITICAL);
-		delete d->rvth;
-		return;
-	}
-
-	d->rvth = rvth_tmp;
 	d->filename = filename;
-	d->model->setRvtH(d->rvth);
-
 	d->nhcd_status.clear();
 	d->write_enabled = false;
 
-	// Check the NHCD table status.
-	bool checkNHCD = false;
-	switch (d->rvth->imageType()) {
-		case RVTH_ImageType_HDD_Reader:
-		case RVTH_ImageType_HDD_Image:
-			// NHCD table should be present.
-			checkNHCD = true;
-			break;
-
-		default:
-			// No NHCD table here.
-			break;
-	}
-
-	if (checkNHCD) {
-		QString message;
-		switch (d->rvth->nhcd_status()) {
-			case NHCD_STATUS_OK:
-				if (d->rvth->imageType() == RVTH_ImageType_HDD_Reader) {
-					d->write_enabled = true;
-				}
-				break;
-
-			default:
-			case NHCD_STATUS_UNKNOWN:
-			case NHCD_STATUS_MISSING:
-				message = tr("NHCD table is missing.");
-				d->nhcd_status = QLatin1String("!NHCD");
-				break;
-
-			case NHCD_STATUS_HAS_MBR:
-				message = tr("This appears to be a PC MBR-partitioned HDD.");
-				d->nhcd_status = QLatin1String("MBR?");
-				break;
-
-			case NHCD_STATUS_HAS_GPT:
-				message = tr("This appears to be a PC GPT-partitioned HDD.");
-				d->nhcd_status = QLatin1String("GPT?");
-				break;
-		}
-
-		if (!message.isEmpty()) {
-			message += QChar(L'\n') + tr("Using defaults. Writing will be disabled.");
-			d->ui.msgWidget->showMessage(message, MessageWidget::ICON_CRITICAL);
-		}
-	}
+	// Open the specified RVT-H Reader disk image on a worker thread.
+	d->loaderThread = new QThread();
+	d->loader = new RvtHLoader();
+	d->loader->setFilename(filename);
+	d->loader->moveToThread(d->loaderThread);
+
+	connect(d->loaderThread, &QThread::started,
+		d->loader, &RvtHLoader::doOpen);
+	connect(d->loader, &RvtHLoader::bankTableLoaded,
+		this, &QRvtHToolWindow::loader_bankTableLoaded);
+	connect(d->loader, &RvtHLoader::bankLoaded,
+		this, &QRvtHToolWindow::loader_bankLoaded);
+	connect(d->loader, &RvtHLoader::finished,
+		this, &QRvtHToolWindow::loader_finished);
+
+	// Stop the thread once the loader is finished, and delete
+	// the loader and its thread once the thread has stopped.
+	// NOTE: This is connected after loader_finished(), so
+	// loader_finished() is called before the loader is deleted.
+	connect(d->loader, &RvtHLoader::finished,
+		d->loaderThread, &QThread::quit);
+	connect(d->loaderThread, &QThread::finished,
+		d->loader, &QObject::deleteLater);
+	connect(d->loaderThread, &QThread::finished,
+		d->loaderThread, &QObject::deleteLater);
+
+	d->lblMessage->setText(tr("Opening %1...").arg(d->getDisplayFilename(filename)));
+	d->loaderThread->start();
 
 	// Update the UI.
 	d->updateLstBankList();
 	d->updateWindowTitle();
-
-	// FIXME: If a file is opened from the command line,
-	// QTreeView sort-of selects the first file.
-	// (Signal is emitted, but nothing is highlighted.)
+	d->updateActionEnableStatus();
 }
 
 /**
@@ -707,11 +806,14 @@ void QRvtHToolWindow::openRvtH(const QString &filename)
 void QRvtHToolWindow::closeRvtH(void)
 {
 	Q_D(QRvtHToolWindow);
-	if (!d->rvth) {
+	if (!d->rvth && !d->loader) {
 		// Not open...
 		return;
 	}
 
+	// Stop opening the image, if it's still being opened.
+	d->abortLoader();
+
 	d->model->setRvtH(nullptr);
 	delete d->rvth;
 	d->rvth = nullptr;
@@ -786,10 +888,18 @@ void QRvtHToolWindow::showEvent(QShowEvent *event)
 void QRvtHToolWindow::closeEvent(QCloseEvent *event)
 {
 	Q_D(QRvtHToolWindow);
-	if (d->uiBusyCounter > 0 || d->workerObject ||
-	    (d->workerThread && d->workerThread->isRunning())) {
-		// UI is busy, or the worker thread is running.
+	if (d->uiBusyCounter > 0) {
+		// UI is busy.
+		// Ignore the close event.
+		event->ignore();
+		return;
+	} else if (d->jobQueue->activeJobCount() > 0) {
+		// Jobs are queued or running.
 		// Ignore the close event.
+		d->ui.msgWidget->showMessage(
+			tr("Jobs are still queued or running. Cancel them before exiting."),
+			MessageWidget::ICON_WARNING, 10000);
+		d->dockJobQueue->setVisible(true);
 		event->ignore();
 		return;
 	}
@@ -886,11 +996,11 @@ void QRvtHToolWindow::on_actionOpenDiskImage_triggered(void)
 	// On Linux, Qt shows an extra space after the filter name, since
 	// it doesn't show the extension. Not sure about Windows...
 	const QString allSupportedFilter = tr("All Supported Files") +
-		QLatin1String(" (*.img *.bin *.gcm *.wbfs *.ciso *.cso *.iso)");
+		QLatin1String(" (*.img *.bin *.gcm *.wbfs *.ciso *.cso *.gcz *.iso)");
 	const QString hddFilter = tr("RVT-H Reader Disk Image Files") +
 		QLatin1String(" (*.img *.bin)");
 	const QString gcmFilter = tr("GameCube/Wii Disc Image Files") +
-		QLatin1String(" (*.gcm *.wbfs *.ciso *.cso *.iso)");
+		QLatin1String(" (*.gcm *.wbfs *.ciso *.cso *.gcz *.iso)");
 	const QString allFilter = tr("All Files") + QLatin1String(" (*)");
 
 	// NOTE: Using a QFileDialog instead of QFileDialog::getOpenFileName()
@@ -944,7 +1054,7 @@ void QRvtHToolWindow::on_actionOpenDevice_triggered(void)
 void QRvtHToolWindow::on_actionClose_triggered(void)
 {
 	Q_D(QRvtHToolWindow);
-	if (!d->rvth)
+	if (!d->rvth && !d->loader)
 		return;
 
 	closeRvtH();
@@ -977,23 +1087,11 @@ void QRvtHToolWindow::on_actionExtract_triggered(void)
 {
 	Q_D(QRvtHToolWindow);
 
-	if (d->workerObject || (d->workerThread && d->workerThread->isRunning())) {
-		// Worker thread is already running.
-		return;
-	}
-
 	// Only one bank can be selected.
-	QItemSelectionModel *const selectionModel = d->ui.lstBankList->selectionModel();
-	if (!selectionModel->hasSelection())
+	const int bank = d->selectedBank();
+	if (bank < 0)
 		return;
 
-	QModelIndex index = d->ui.lstBankList->selectionModel()->currentIndex();
-	if (!index.isValid())
-		return;
-
-	// TODO: Sort proxy model like in mcrecover.
-	const unsigned int bank = d->proxyModel->mapToSource(index).row();
-
 	// Prompt the user for a save location.
 	QString filename = QFileDialog::getSaveFileName(this,
 		tr("Extract Disc Image"),
@@ -1004,52 +1102,19 @@ void QRvtHToolWindow::on_actionExtract_triggered(void)
 	if (filename.isEmpty())
 		return;
 
-	// Disable the main UI widgets.
-	markUiBusy();
-
-	// Show the progress bar and cancel button.
-	d->btnCancel->setVisible(true);
-	d->progressBar->setVisible(true);
-	d->progressBar->setMaximum(100);
-	d->progressBar->setValue(0);
-
-	// Initial message.
-	const QString filenameOnly = d->getDisplayFilename(filename);
-	d->lblMessage->setText(tr("Extracting Bank %1 to %2:")
-		.arg(bank+1).arg(filenameOnly));
-
 	// Recryption key.
 	const int recryption_key = d->cboRecryptionKey->currentData().toInt();
 
 	// TODO: NDEV flag?
 	const unsigned int flags = 0;
 
-	// Update status.
-	// NOTE: We don't need to do an initial update for extract.
-	d->updateStatus_didInitialUpdate = true;
-	d->updateStatus_bank = bank;
-
-	// Create the worker thread and object.
-	d->workerThread = new QThread(this);
-	d->workerObject = new WorkerObject();
-	d->workerObject->moveToThread(d->workerThread);
-	d->workerObject->setRvtH(d->rvth);
-	d->workerObject->setBank(bank);
-	d->workerObject->setGcmFilename(filename);
-	d->workerObject->setRecryptionKey(recryption_key);
-	d->workerObject->setFlags(flags);
-
-	connect(d->workerThread, &QThread::started,
-		d->workerObject, &WorkerObject::doExtract);
-	connect(d->workerObject, &WorkerObject::updateStatus,
-		this, &QRvtHToolWindow::workerObject_updateStatus);
-	connect(d->workerObject, &WorkerObject::finished,
-		this, &QRvtHToolWindow::workerObject_finished);
-
-	// Start the thread.
-	// Progress will be updated using callback signals.
-	// TODO: Watchdog timer in case the thread fails?
-	d->workerThread->start();
+	// Queue the extraction job.
+	// It will be started once a job slot is available.
+	const QString filenameOnly = d->getDisplayFilename(filename);
+	d->lblMessage->setText(tr("Queued extracting Bank %1 to %2.")
+		.arg(bank+1).arg(filenameOnly));
+	d->dockJobQueue->setVisible(true);
+	d->jobQueue->addExtractJob(d->filename, bank, filename, recryption_key, flags);
 }
 
 /**
@@ -1059,71 +1124,29 @@ void QRvtHToolWindow::on_actionImport_triggered(void)
 {
 	Q_D(QRvtHToolWindow);
 
-	if (d->workerObject || (d->workerThread && d->workerThread->isRunning())) {
-		// Worker thread is already running.
-		return;
-	}
-
 	// Only one bank can be selected.
-	QItemSelectionModel *const selectionModel = d->ui.lstBankList->selectionModel();
-	if (!selectionModel->hasSelection())
-		return;
-
-	QModelIndex index = d->ui.lstBankList->selectionModel()->currentIndex();
-	if (!index.isValid())
+	const int bank = d->selectedBank();
+	if (bank < 0)
 		return;
 
-	// TODO: Sort proxy model like in mcrecover.
-	const unsigned int bank = d->proxyModel->mapToSource(index).row();
-
 	// Prompt the user to select a disc image.
 	QString filename = QFileDialog::getOpenFileName(this,
 		tr("Import Disc Image"),
 		QString(),	// Default filename (TODO)
 		// TODO: Remove extra space from the filename filter?
-		tr("GameCube/Wii Disc Images") + QLatin1String(" (*.gcm *.wbfs *.ciso);;") +
+		tr("GameCube/Wii Disc Images") + QLatin1String(" (*.gcm *.wbfs *.ciso *.gcz);;") +
 		tr("All Files") + QLatin1String(" (*)"));
 	if (filename.isEmpty())
 		return;
 
-	// Disable the main UI widgets.
-	markUiBusy();
-
-	// Show the progress bar and cancel button.
-	d->btnCancel->setVisible(true);
-	d->progressBar->setVisible(true);
-	d->progressBar->setMaximum(100);
-	d->progressBar->setValue(0);
-
-	// Initial message.
+	// Queue the import job.
+	// It will be started once a job slot is available and
+	// any earlier jobs on this RVT-H Reader have finished.
 	const QString filenameOnly = d->getDisplayFilename(filename);
-	d->lblMessage->setText(tr("Importing %1 to Bank %2:")
+	d->lblMessage->setText(tr("Queued importing %1 to Bank %2.")
 		.arg(filenameOnly).arg(bank+1));
-
-	// Update status.
-	// NOTE: We *do* need to do an initial update for import.
-	d->updateStatus_didInitialUpdate = false;
-	d->updateStatus_bank = bank;
-
-	// Create the worker thread and object.
-	d->workerThread = new QThread(this);
-	d->workerObject = new WorkerObject();
-	d->workerObject->moveToThread(d->workerThread);
-	d->workerObject->setRvtH(d->rvth);
-	d->workerObject->setBank(bank);
-	d->workerObject->setGcmFilename(filename);
-
-	connect(d->workerThread, &QThread::started,
-		d->workerObject, &WorkerObject::doImport);
-	connect(d->workerObject, &WorkerObject::updateStatus,
-		this, &QRvtHToolWindow::workerObject_updateStatus);
-	connect(d->workerObject, &WorkerObject::finished,
-		this, &QRvtHToolWindow::workerObject_finished);
-
-	// Start the thread.
-	// Progress will be updated using callback signals.
-	// TODO: Watchdog timer in case the thread fails?
-	d->workerThread->start();
+	d->dockJobQueue->setVisible(true);
+	d->jobQueue->addImportJob(d->filename, bank, filename);
 }
 
 /**
@@ -1133,24 +1156,17 @@ void QRvtHToolWindow::on_actionDelete_triggered(void)
 {
 	Q_D(QRvtHToolWindow);
 
-	if (d->workerObject || (d->workerThread && d->workerThread->isRunning())) {
-		// Worker thread is already running.
-		return;
-	}
-
 	// TODO: Prompt the user to confirm?
 
 	// Only one bank can be selected.
-	QItemSelectionModel *const selectionModel = d->ui.lstBankList->selectionModel();
-	if (!selectionModel->hasSelection())
+	const int bank = d->selectedBank();
+	if (bank < 0)
 		return;
 
-	QModelIndex index = d->ui.lstBankList->selectionModel()->currentIndex();
-	if (!index.isValid())
+	if (d->jobQueue->isBankBusy(d->filename, bank)) {
+		// A queued or running job is using this bank.
 		return;
-
-	// TODO: Sort proxy model like in mcrecover.
-	const unsigned int bank = d->proxyModel->mapToSource(index).row();
+	}
 
 	// Delete the selected bank.
 	int ret = d->rvth->deleteBank(bank);
@@ -1185,22 +1201,15 @@ void QRvtHToolWindow::on_actionUndelete_triggered(void)
 {
 	Q_D(QRvtHToolWindow);
 
-	if (d->workerObject || (d->workerThread && d->workerThread->isRunning())) {
-		// Worker thread is already running.
-		return;
-	}
-
 	// Only one bank can be selected.
-	QItemSelectionModel *const selectionModel = d->ui.lstBankList->selectionModel();
-	if (!selectionModel->hasSelection())
+	const int bank = d->selectedBank();
+	if (bank < 0)
 		return;
 
-	QModelIndex index = d->ui.lstBankList->selectionModel()->currentIndex();
-	if (!index.isValid())
+	if (d->jobQueue->isBankBusy(d->filename, bank)) {
+		// A queued or running job is using this bank.
 		return;
-
-	// TODO: Sort proxy model like in mcrecover.
-	const unsigned int bank = d->proxyModel->mapToSource(index).row();
+	}
 
 	// Undelete the selected bank.
 	int ret = d->rvth->undeleteBank(bank);
@@ -1282,104 +1291,245 @@ void QRvtHToolWindow::lstBankList_selectionModel_selectionChanged(
 	d->updateActionEnableStatus();
 }
 
-/** Worker object slots **/
+/** RvtHLoader slots **/
 
 /**
- * Update the status bar.
- * @param text Status bar text.
- * @param progress_value Progress bar value. (If -1, ignore this.)
- * @param progress_max Progress bar maximum. (If -1, ignore this.)
+ * The bank table has been read.
+ * @param imageType Image type. (See RvtH_ImageType_e.)
+ * @param entries Bank entries.
  */
-void QRvtHToolWindow::workerObject_updateStatus(const QString &text, int progress_value, int progress_max)
+void QRvtHToolWindow::loader_bankTableLoaded(int imageType, const QVector<RvtH_BankEntry> &entries)
 {
 	Q_D(QRvtHToolWindow);
-	d->lblMessage->setText(text);
+	if (sender() != d->loader) {
+		// Image was closed or another image was opened.
+		return;
+	}
 
-	// TODO: "Error" state.
-	if (progress_value >= 0 && progress_max >= 0) {
-		if (!d->updateStatus_didInitialUpdate) {
-			// Update the RVT-H model.
-			d->model->forceBankUpdate(d->updateStatus_bank);
-			d->updateStatus_didInitialUpdate = true;
-		}
+	// Show the bank table while the banks are being loaded.
+	d->model->setBankTable(imageType, entries);
+	d->updateLstBankList();
+}
+
+/**
+ * A bank entry has been fully loaded.
+ * @param bank Bank number.
+ * @param entry Bank entry.
+ */
+void QRvtHToolWindow::loader_bankLoaded(unsigned int bank, const RvtH_BankEntry &entry)
+{
+	Q_D(QRvtHToolWindow);
+	if (sender() != d->loader) {
+		// Image was closed or another image was opened.
+		return;
+	}
+
+	d->model->updateBankEntry(bank, entry);
+	d->lblMessage->setText(tr("Opening %1... (Bank %2 of %3)")
+		.arg(d->getDisplayFilename(d->filename))
+		.arg(bank + 1).arg(d->model->rowCount()));
+}
+
+/**
+ * Opening the RVT-H Reader disk image is finished.
+ * @param err Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+ */
+void QRvtHToolWindow::loader_finished(int err)
+{
+	Q_D(QRvtHToolWindow);
+	RvtHLoader *const loader = qobject_cast<RvtHLoader*>(sender());
+	assert(loader != nullptr);
+	if (!loader)
+		return;
+
+	if (loader != d->loader) {
+		// Image was closed or another image was opened.
+		// The RvtH object, if any, is deleted with the loader.
+		return;
+	}
+
+	RvtH *const rvth_tmp = loader->takeRvtH();
+	d->loader = nullptr;
+	d->loaderThread = nullptr;
+	const int reselectBank = d->reselectBank;
+	d->reselectBank = -1;
+
+	if (!rvth_tmp) {
+		// Unable to open the RVT-H Reader disk image.
+		const QString errMsg = tr("An error occurred while opening '%1': %2")
+			.arg(d->getDisplayFilename(d->filename))
+			.arg(QString::fromUtf8(rvth_error(err)));
+		d->ui.msgWidget->showMessage(errMsg, MessageWidget::ICON_CRITICAL);
+		d->lblMessage->clear();
+
+		// Remove the preliminary bank table.
+		d->model->setRvtH(nullptr);
+		d->filename.clear();
+		d->nhcd_status.clear();
+		d->updateLstBankList();
+		d->updateWindowTitle();
+		d->updateActionEnableStatus();
+		return;
+	}
+
+	d->rvth = rvth_tmp;
+	d->model->setRvtH(d->rvth);
+	d->lblMessage->clear();
+
+	// Check the NHCD table status.
+	bool checkNHCD = false;
+	switch (d->rvth->imageType()) {
+		case RVTH_ImageType_HDD_Reader:
+		case RVTH_ImageType_HDD_Image:
+			// NHCD table should be present.
+			checkNHCD = true;
+			break;
+
+		default:
+			// No NHCD table here.
+			break;
+	}
+
+	if (checkNHCD) {
+		QString message;
+		switch (d->rvth->nhcd_status()) {
+			case NHCD_STATUS_OK:
+				if (d->rvth->imageType() == RVTH_ImageType_HDD_Reader) {
+					d->write_enabled = true;
+				}
+				break;
+
+			default:
+			case NHCD_STATUS_UNKNOWN:
+			case NHCD_STATUS_MISSING:
+				message = tr("NHCD table is missing.");
+				d->nhcd_status = QLatin1String("!NHCD");
+				break;
 
-		if (d->progressBar->maximum() != progress_max) {
-			d->progressBar->setMaximum(progress_max);
+			case NHCD_STATUS_HAS_MBR:
+				message = tr("This appears to be a PC MBR-partitioned HDD.");
+				d->nhcd_status = QLatin1String("MBR?");
+				break;
+
+			case NHCD_STATUS_HAS_GPT:
+				message = tr("This appears to be a PC GPT-partitioned HDD.");
+				d->nhcd_status = QLatin1String("GPT?");
+				break;
 		}
-		d->progressBar->setValue(progress_value);
 
-		if (d->taskbarButtonManager) {
-			if (d->taskbarButtonManager->progressBarMax() != progress_max) {
-				d->taskbarButtonManager->setProgressBarMax(progress_max);
-			}
-			d->taskbarButtonManager->setProgressBarValue(progress_value);
+		if (!message.isEmpty()) {
+			message += QChar(L'\n') + tr("Using defaults. Writing will be disabled.");
+			d->ui.msgWidget->showMessage(message, MessageWidget::ICON_CRITICAL);
 		}
 	}
+
+	// Update the UI.
+	d->updateLstBankList();
+	d->updateWindowTitle();
+
+	if (reselectBank >= 0 && reselectBank < d->model->rowCount()) {
+		// Reselect the bank.
+		d->ui.lstBankList->setCurrentIndex(
+			d->proxyModel->mapFromSource(d->model->index(reselectBank, 0)));
+	}
+
+	// If a bank was selected while the banks were being loaded,
+	// the selection was kept, but the bank entry view wasn't set.
+	const int bank = d->selectedBank();
+	d->ui.bevBankEntryView->setBankEntry(bank >= 0 ? d->rvth->bankEntry(bank) : nullptr);
+	d->updateActionEnableStatus();
+
+	// FIXME: If a file is opened from the command line,
+	// QTreeView sort-of selects the first file.
+	// (Signal is emitted, but nothing is highlighted.)
 }
 
+/** Job queue slots **/
+
 /**
- * Process is finished.
- * @param text Status bar text.
- * @param err Error code. (0 on success)
+ * A job has reported progress.
+ * @param text Status text.
  */
-void QRvtHToolWindow::workerObject_finished(const QString &text, int err)
+void QRvtHToolWindow::jobQueue_jobProgress(const QString &text)
 {
 	Q_D(QRvtHToolWindow);
 	d->lblMessage->setText(text);
+	d->updateJobProgress();
+}
 
-	// Hide the Cancel button.
-	d->btnCancel->setVisible(false);
+/**
+ * A job has finished.
+ * @param type Job type.
+ * @param rvthFilename RVT-H filename.
+ * @param bank Bank number.
+ * @param text Status text.
+ * @param err Error code. (0 on success)
+ */
+void QRvtHToolWindow::jobQueue_jobFinished(JobQueue::JobType type, const QString &rvthFilename,
+	unsigned int bank, const QString &text, int err)
+{
+	Q_D(QRvtHToolWindow);
+	d->lblMessage->setText(text);
 
 	if (err == 0) {
 		// Process completed.
-		d->progressBar->setValue(d->progressBar->maximum());
 		MessageSound::play(QMessageBox::Information, text, this);
 	} else {
 		// Process failed.
-		// TODO: Change progress bar to red?
-		// TOOD: Critical vs. warning.
+		// TODO: Critical vs. warning.
 		MessageSound::play(QMessageBox::Warning, text, this);
 	}
 
-	// TODO: Hide the progress bar on success after 5 seconds.
-	// TODO: Same with taskbar button, but for now, just clear it.
-	if (d->taskbarButtonManager) {
-		d->taskbarButtonManager->clearProgressBar();
+	if (type == JobQueue::JOB_IMPORT && d->rvth && rvthFilename == d->filename) {
+		// The import job used its own RvtH object, so the bank
+		// table shown here is out of date. Reopen the RVT-H Reader.
+		// NOTE: This is done even if the import failed, since
+		// the bank entry may have been modified.
+		// The bank is reselected once it's opened.
+		openRvtH(d->filename);
+		d->reselectBank = static_cast<int>(bank);
 	}
+}
 
-	// Make sure the thread exits.
-	// NOTE: Connecting WorkerObject::finished() to QThread::quit()
-	// might not work if the slots get run in the wrong order.
-	// NOTE 2: QThread::wait() doesn't return if the thread has
-	// finished before it's called, even though the documentation
-	// says it does...
-	d->workerThread->quit();
-	do {
-		d->workerThread->wait(250);
-	} while (d->workerThread->isRunning());
-	d->workerThread->deleteLater();
-	d->workerThread = nullptr;
-
-	// Delete the worker object. It'll be created again for the next process.
-	// NOTE: Need to use deleteLater() to prevent race conditions.
-	d->workerObject->deleteLater();
-	d->workerObject = nullptr;
-
-	// Enable the main UI widgets.
-	markUiNotBusy();
+/**
+ * The set of queued and running jobs has changed.
+ */
+void QRvtHToolWindow::jobQueue_activeJobsChanged(void)
+{
+	Q_D(QRvtHToolWindow);
+
+	// Show the progress bar and cancel button while jobs are active.
+	const bool active = (d->jobQueue->activeJobCount() > 0);
+	d->btnCancel->setVisible(active);
+	if (active) {
+		if (!d->progressBar->isVisible()) {
+			d->progressBar->setMaximum(100);
+			d->progressBar->setValue(0);
+			d->progressBar->setVisible(true);
+		}
+		d->updateJobProgress();
+	} else {
+		// All jobs are finished.
+		// TODO: Hide the progress bar on success after 5 seconds.
+		d->progressBar->setValue(d->progressBar->maximum());
+		if (d->taskbarButtonManager) {
+			d->taskbarButtonManager->clearProgressBar();
+		}
+	}
+
+	// Banks may have become available for Delete and Undelete.
+	d->updateActionEnableStatus();
 }
 
 /**
  * Cancel button was pressed.
+ * This cancels all queued and running jobs.
  */
 void QRvtHToolWindow::btnCancel_clicked(void)
 {
 	Q_D(QRvtHToolWindow);
-	// TODO: Make sure there's no race conditions.
-	if (d->workerObject) {
-		// TODO: Delete the destination .gcm if necessary?
-		// TODO: If importing, restore the old bank entry?
-		// (may need librvth changes)
-		d->workerObject->cancel();
-	}
+	// TODO: Delete the destination .gcm if necessary?
+	// TODO: If importing, restore the old bank entry?
+	// (may need librvth changes)
+	d->jobQueue->cancelAll();
 }
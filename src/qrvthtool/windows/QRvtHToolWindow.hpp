@@ -24,6 +24,11 @@
 class QItemSelection;
 #include <QMainWindow>
 
+// Job queue.
+#include "JobQueue.hpp"
+// RvtH loader.
+#include "RvtHLoader.hpp"
+
 class QRvtHToolWindowPrivate;
 class QRvtHToolWindow : public QMainWindow
 {
@@ -43,6 +48,7 @@ class QRvtHToolWindow : public QMainWindow
 	public:
 		/**
 		 * Open an RVT-H Reader disk image.
+		 * The disk image is opened on a worker thread.
 		 * @param filename Filename.
 		 */
 		void openRvtH(const QString &filename);
@@ -97,25 +103,56 @@ class QRvtHToolWindow : public QMainWindow
 			const QItemSelection& selected, const QItemSelection& deselected);
 
 	protected slots:
-		/** Worker object slots **/
+		/** RvtHLoader slots **/
+
+		/**
+		 * The bank table has been read.
+		 * @param imageType Image type. (See RvtH_ImageType_e.)
+		 * @param entries Bank entries.
+		 */
+		void loader_bankTableLoaded(int imageType, const QVector<RvtH_BankEntry> &entries);
 
 		/**
-		 * Update the status bar.
-		 * @param text Status bar text.
-		 * @param progress_value Progress bar value. (If -1, ignore this.)
-		 * @param progress_max Progress bar maximum. (If -1, ignore this.)
+		 * A bank entry has been fully loaded.
+		 * @param bank Bank number.
+		 * @param entry Bank entry.
 		 */
-		void workerObject_updateStatus(const QString &text, int progress_value, int progress_max);
+		void loader_bankLoaded(unsigned int bank, const RvtH_BankEntry &entry);
 
 		/**
-		 * Process is finished.
-		 * @param text Status bar text.
+		 * Opening the RVT-H Reader disk image is finished.
+		 * @param err Error code. (If negative, POSIX error; otherwise, see RvtH_Errors.)
+		 */
+		void loader_finished(int err);
+
+	protected slots:
+		/** Job queue slots **/
+
+		/**
+		 * A job has reported progress.
+		 * @param text Status text.
+		 */
+		void jobQueue_jobProgress(const QString &text);
+
+		/**
+		 * A job has finished.
+		 * @param type Job type.
+		 * @param rvthFilename RVT-H filename.
+		 * @param bank Bank number.
+		 * @param text Status text.
 		 * @param err Error code. (0 on success)
 		 */
-		void workerObject_finished(const QString &text, int err);
+		void jobQueue_jobFinished(JobQueue::JobType type, const QString &rvthFilename,
+			unsigned int bank, const QString &text, int err);
+
+		/**
+		 * The set of queued and running jobs has changed.
+		 */
+		void jobQueue_activeJobsChanged(void);
 
 		/**
 		 * Cancel button was pressed.
+		 * This cancels all queued and running jobs.
 		 */
 		void btnCancel_clicked(void);
 };
@@ -31,8 +31,12 @@
 # include <windows.h>
 #endif
 
+// C includes. (C++ namespace)
+#include <cassert>
+
 // Qt includes.
 #include <QtCore/QLocale>
+#include <QtCore/QSocketNotifier>
 #include <QPushButton>
 
 /** SelectDeviceDialogPrivate **/
@@ -42,6 +46,7 @@ class SelectDeviceDialogPrivate
 {
 	public:
 		explicit SelectDeviceDialogPrivate(SelectDeviceDialog *q);
+		~SelectDeviceDialogPrivate();
 
 	protected:
 		SelectDeviceDialog *const q_ptr;
@@ -65,6 +70,15 @@ class SelectDeviceDialogPrivate
 		QVector<QString> vecSerialNumbers;
 		QVector<int64_t> vecHDDSizes;
 
+#ifdef HAVE_QUERY
+		// Device hotplug monitor.
+		// If the monitor is available, the device list is
+		// updated when RVT-H Readers are connected or
+		// disconnected, so refreshing isn't necessary.
+		RvtH_Monitor *monitor;
+		QSocketNotifier *monitorNotifier;
+#endif /* HAVE_QUERY */
+
 	private:
 		static inline int calc_frac_part(int64_t size, int64_t mask);
 
@@ -78,15 +92,64 @@ class SelectDeviceDialogPrivate
 	public:
 		// Refresh the device list.
 		void refreshDeviceList(void);
+
+#ifdef HAVE_QUERY
+		/**
+		 * Add a device to the device list.
+		 * If the device is already listed, it's updated.
+		 * @param entry Device entry.
+		 */
+		void addDevice(const RvtH_QueryEntry *entry);
+
+		/**
+		 * Remove a device from the device list.
+		 * @param deviceName Device name.
+		 */
+		void removeDevice(const QString &deviceName);
+
+		/**
+		 * Start the device hotplug monitor.
+		 * The device list is populated from the monitor.
+		 * @return True if the monitor was started; false if not.
+		 */
+		bool startMonitor(void);
+
+		/**
+		 * Device monitor callback.
+		 * @param event		[in] Event type. (See RvtH_Monitor_Event_e.)
+		 * @param entry		[in] Device entry.
+		 * @param userdata	[in] SelectDeviceDialogPrivate*
+		 */
+		static void monitor_callback(RvtH_Monitor_Event_e event, const RvtH_QueryEntry *entry, void *userdata);
+#endif /* HAVE_QUERY */
+
+		/**
+		 * Update the "OK" button's enabled state.
+		 */
+		void updateBtnOk(void);
 };
 
 SelectDeviceDialogPrivate::SelectDeviceDialogPrivate(SelectDeviceDialog *q)
 	: q_ptr(q)
+	, sel_hddSize(0)
+#ifdef HAVE_QUERY
+	, monitor(nullptr)
+	, monitorNotifier(nullptr)
+#endif /* HAVE_QUERY */
 {
 	// Get the RVT-H Reader icon.
 	rvthReaderIcon = RvtHModel::getIcon(RvtHModel::ICON_RVTH);
 }
 
+SelectDeviceDialogPrivate::~SelectDeviceDialogPrivate()
+{
+#ifdef HAVE_QUERY
+	// Delete the notifier before closing the monitor's socket.
+	delete monitorNotifier;
+	rvth_monitor_free(monitor);
+#endif /* HAVE_QUERY */
+}
+
 inline int SelectDeviceDialogPrivate::calc_frac_part(int64_t size, int64_t mask)
 {
 	float f = (float)(size & (mask - 1)) / (float)mask;
@@ -195,7 +258,6 @@ void SelectDeviceDialogPrivate::refreshDeviceList(void)
 	ui.lstDevices->clear();
 	ui.buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
 
-	// TODO: Automatically update on device hotplug?
 	vecDeviceNames.clear();
 	vecSerialNumbers.clear();
 	vecHDDSizes.clear();
@@ -246,46 +308,8 @@ void SelectDeviceDialogPrivate::refreshDeviceList(void)
 	}
 
 	// Found devices.
-	const RvtH_QueryEntry *p = devs;
-	for (; p != NULL; p = p->next) {
-		if (!p->device_name) {
-			// No device name. Skip it.
-			continue;
-		}
-
-		// Device name and serial number.
-#ifdef _WIN32
-		QString deviceName = QString::fromUtf16(
-			reinterpret_cast<const char16_t*>(p->device_name));
-		QString serialNumber;
-		if (p->usb_serial) {
-			serialNumber = QString::fromUtf16(
-			reinterpret_cast<const char16_t*>(p->usb_serial));
-		}
-#else /* !_WIN32 */
-		QString deviceName = QString::fromUtf8(p->device_name);
-		QString serialNumber;
-		if (p->usb_serial) {
-			serialNumber = QString::fromUtf8(p->usb_serial);
-		}
-#endif /* _WIN32 */
-		int64_t hddSize = p->size;
-
-		// Create the string.
-		QString text = deviceName + QChar(L'\n') +
-			serialNumber + QChar(L'\n') +
-			format_size(hddSize);
-
-		// Create the QListWidgetItem.
-		// TODO: Verify that QListWidget takes ownership.
-		// TODO: Switch to QListView and use a model.
-		QListWidgetItem *const item = new QListWidgetItem(rvthReaderIcon, text, ui.lstDevices);
-		item->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
-
-		// Save the device information.
-		vecDeviceNames.append(deviceName);
-		vecSerialNumbers.append(serialNumber);
-		vecHDDSizes.append(hddSize);
+	for (const RvtH_QueryEntry *p = devs; p != NULL; p = p->next) {
+		addDevice(p);
 	}
 
 	rvth_query_free(devs);
@@ -297,6 +321,166 @@ void SelectDeviceDialogPrivate::refreshDeviceList(void)
 #endif /* HAVE_QUERY */
 }
 
+#ifdef HAVE_QUERY
+/**
+ * Add a device to the device list.
+ * If the device is already listed, it's updated.
+ * @param entry Device entry.
+ */
+void SelectDeviceDialogPrivate::addDevice(const RvtH_QueryEntry *entry)
+{
+	if (!entry->device_name) {
+		// No device name. Skip it.
+		return;
+	}
+
+	// Device name and serial number.
+#ifdef _WIN32
+	QString deviceName = QString::fromUtf16(
+		reinterpret_cast<const char16_t*>(entry->device_name));
+	QString serialNumber;
+	if (entry->usb_serial) {
+		serialNumber = QString::fromUtf16(
+		reinterpret_cast<const char16_t*>(entry->usb_serial));
+	}
+#else /* !_WIN32 */
+	QString deviceName = QString::fromUtf8(entry->device_name);
+	QString serialNumber;
+	if (entry->usb_serial) {
+		serialNumber = QString::fromUtf8(entry->usb_serial);
+	}
+#endif /* _WIN32 */
+	int64_t hddSize = entry->size;
+
+	// Create the string.
+	QString text = deviceName + QChar(L'\n') +
+		serialNumber + QChar(L'\n') +
+		format_size(hddSize);
+
+	const int row = vecDeviceNames.indexOf(deviceName);
+	if (row >= 0) {
+		// Device is already listed. Update it.
+		ui.lstDevices->item(row)->setText(text);
+		vecSerialNumbers[row] = serialNumber;
+		vecHDDSizes[row] = hddSize;
+		return;
+	}
+
+	// Create the QListWidgetItem.
+	// TODO: Verify that QListWidget takes ownership.
+	// TODO: Switch to QListView and use a model.
+	QListWidgetItem *const item = new QListWidgetItem(rvthReaderIcon, text, ui.lstDevices);
+	item->setTextAlignment(Qt::AlignLeft | Qt::AlignVCenter);
+
+	// Save the device information.
+	vecDeviceNames.append(deviceName);
+	vecSerialNumbers.append(serialNumber);
+	vecHDDSizes.append(hddSize);
+}
+
+/**
+ * Remove a device from the device list.
+ * @param deviceName Device name.
+ */
+void SelectDeviceDialogPrivate::removeDevice(const QString &deviceName)
+{
+	const int row = vecDeviceNames.indexOf(deviceName);
+	if (row < 0) {
+		// Device isn't listed.
+		return;
+	}
+
+	delete ui.lstDevices->takeItem(row);
+	vecDeviceNames.remove(row);
+	vecSerialNumbers.remove(row);
+	vecHDDSizes.remove(row);
+
+	// The selected device may have been removed.
+	updateBtnOk();
+}
+
+/**
+ * Start the device hotplug monitor.
+ * The device list is populated from the monitor.
+ * @return True if the monitor was started; false if not.
+ */
+bool SelectDeviceDialogPrivate::startMonitor(void)
+{
+	assert(monitor == nullptr);
+	monitor = rvth_monitor_new(nullptr);
+	if (!monitor) {
+		// Device monitoring isn't available.
+		return false;
+	}
+
+	const int fd = rvth_monitor_get_fd(monitor);
+	if (fd < 0) {
+		rvth_monitor_free(monitor);
+		monitor = nullptr;
+		return false;
+	}
+
+	Q_Q(SelectDeviceDialog);
+	monitorNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, q);
+	QObject::connect(monitorNotifier, &QSocketNotifier::activated,
+			 q, &SelectDeviceDialog::monitor_activated);
+
+	// Clear the device list.
+	// Devices that are already connected are reported
+	// the first time the monitor is processed.
+	ui.lstDevices->clear();
+	ui.buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+	vecDeviceNames.clear();
+	vecSerialNumbers.clear();
+	vecHDDSizes.clear();
+	ui.lstDevices->setNoItemText(
+		SelectDeviceDialog::tr("No RVT-H Reader devices found."));
+
+	rvth_monitor_process(monitor, monitor_callback, this);
+	return true;
+}
+
+/**
+ * Device monitor callback.
+ * @param event		[in] Event type. (See RvtH_Monitor_Event_e.)
+ * @param entry		[in] Device entry.
+ * @param userdata	[in] SelectDeviceDialogPrivate*
+ */
+void SelectDeviceDialogPrivate::monitor_callback(RvtH_Monitor_Event_e event, const RvtH_QueryEntry *entry, void *userdata)
+{
+	SelectDeviceDialogPrivate *const d = static_cast<SelectDeviceDialogPrivate*>(userdata);
+	switch (event) {
+		case RVTH_MONITOR_DEVICE_ADDED:
+			d->addDevice(entry);
+			break;
+
+		case RVTH_MONITOR_DEVICE_REMOVED:
+			if (entry->device_name) {
+#ifdef _WIN32
+				d->removeDevice(QString::fromUtf16(
+					reinterpret_cast<const char16_t*>(entry->device_name)));
+#else /* !_WIN32 */
+				d->removeDevice(QString::fromUtf8(entry->device_name));
+#endif /* _WIN32 */
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+#endif /* HAVE_QUERY */
+
+/**
+ * Update the "OK" button's enabled state.
+ */
+void SelectDeviceDialogPrivate::updateBtnOk(void)
+{
+	// Enable the "OK" button if exactly one item is selected.
+	ui.buttonBox->button(QDialogButtonBox::Ok)->setEnabled(
+		ui.lstDevices->selectionModel()->selectedIndexes().size() == 1);
+}
+
 /** SelectDeviceDialog **/
 
 SelectDeviceDialog::SelectDeviceDialog(QWidget *parent)
@@ -319,8 +503,6 @@ SelectDeviceDialog::SelectDeviceDialog(QWidget *parent)
 	this->setWindowIcon(QIcon());
 #endif /* Q_OS_MAC */
 
-	// TODO: Add device hotplug detection.
-
 	// Change the "Reset" button to "Refresh".
 	QPushButton *const btnRefresh = d->ui.buttonBox->button(QDialogButtonBox::Reset);
 	btnRefresh->setText(tr("&Refresh"));
@@ -331,8 +513,16 @@ SelectDeviceDialog::SelectDeviceDialog(QWidget *parent)
 	// NOTE: Qt automatically interprets this as "Right" if an RTL language is in use.
 	d->ui.lstDevices->setDecorationPosition(QStyleOptionViewItem::Left);
 
-	// Refresh the device list.
-	d->refreshDeviceList();
+	// Start the device hotplug monitor, if available.
+	// Otherwise, refresh the device list.
+	// NOTE: The Refresh button is still available, since
+	// it can be used to recheck permissions errors.
+#ifdef HAVE_QUERY
+	if (!d->startMonitor())
+#endif /* HAVE_QUERY */
+	{
+		d->refreshDeviceList();
+	}
 
 	// Connect the lstDevices selection signal.
 	connect(d->ui.lstDevices->selectionModel(), &QItemSelectionModel::selectionChanged,
@@ -464,6 +654,21 @@ void SelectDeviceDialog::refresh(void)
 	d->refreshDeviceList();
 }
 
+/** Device monitor slots **/
+
+/**
+ * The device monitor has pending events.
+ */
+void SelectDeviceDialog::monitor_activated(void)
+{
+#ifdef HAVE_QUERY
+	Q_D(SelectDeviceDialog);
+	if (d->monitor) {
+		rvth_monitor_process(d->monitor, SelectDeviceDialogPrivate::monitor_callback, d);
+	}
+#endif /* HAVE_QUERY */
+}
+
 /** lstDevices slots **/
 
 void SelectDeviceDialog::lstDevices_selectionModel_selectionChanged(
@@ -471,10 +676,11 @@ void SelectDeviceDialog::lstDevices_selectionModel_selectionChanged(
 {
 	Q_UNUSED(deselected)
 
+	Q_UNUSED(selected)
+
 	// Enable the "OK" button if exactly one item is selected.
 	Q_D(SelectDeviceDialog);
-	d->ui.buttonBox->button(QDialogButtonBox::Ok)->setEnabled(
-		selected.indexes().size() == 1);
+	d->updateBtnOk();
 }
 
 void SelectDeviceDialog::on_lstDevices_doubleClicked(const QModelIndex &index)
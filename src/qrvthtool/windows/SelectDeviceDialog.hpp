@@ -74,6 +74,9 @@ class SelectDeviceDialog : public QDialog
 		void done(int r) final;
 		void refresh(void);
 
+		// Device monitor slots
+		void monitor_activated(void);
+
 		// lstDevices slots
 		void lstDevices_selectionModel_selectionChanged(
 			const QItemSelection& selected, const QItemSelection& deselected);
@@ -29,26 +29,30 @@
 #include <cassert>
 #include <cerrno>
 #include <cstdlib>
+#include <cstring>
+
+// C++ includes.
+#include <vector>
 
 /**
  * RVT-H progress callback.
  * @param state		[in] Current progress.
- * @param userdata	[in] User data specified when calling the RVT-H function.
+ * @param userdata	[in] FILE* to print progress to. (If NULL, uses stdout.)
  * @return True to continue; false to abort.
  */
 static bool progress_callback(const RvtH_Progress_State *state, void *userdata)
 {
-	UNUSED(userdata);
+	FILE *const out = (userdata ? static_cast<FILE*>(userdata) : stdout);
 
 	#define MEGABYTE (1048576 / LBA_SIZE)
 	switch (state->type) {
 		case RVTH_PROGRESS_EXTRACT:
-			printf("\rExtracting: %4u MiB / %4u MiB copied...",
+			fprintf(out, "\rExtracting: %4u MiB / %4u MiB copied...",
 				state->lba_processed / MEGABYTE,
 				state->lba_total / MEGABYTE);
 			break;
 		case RVTH_PROGRESS_IMPORT:
-			printf("\rImporting: %4u MiB / %4u MiB copied...",
+			fprintf(out, "\rImporting: %4u MiB / %4u MiB copied...",
 				state->lba_processed / MEGABYTE,
 				state->lba_total / MEGABYTE);
 			break;
@@ -56,11 +60,11 @@ static bool progress_callback(const RvtH_Progress_State *state, void *userdata)
 			if (state->lba_total <= 1) {
 				// TODO: Encryption types?
 				if (state->lba_processed == 0) {
-					printf("\rRecrypting the ticket(s) and TMD(s)...");
+					fputs("\rRecrypting the ticket(s) and TMD(s)...", out);
 				}
 			} else {
 				// TODO: This doesn't seem to be used yet...
-				printf("\rRecrypting: %4u MiB / %4u MiB processed...",
+				fprintf(out, "\rRecrypting: %4u MiB / %4u MiB processed...",
 					state->lba_processed / MEGABYTE,
 					state->lba_total / MEGABYTE);
 			}
@@ -73,9 +77,9 @@ static bool progress_callback(const RvtH_Progress_State *state, void *userdata)
 
 	if (state->lba_processed == state->lba_total) {
 		// Finished processing.
-		putchar('\n');
+		fputc('\n', out);
 	}
-	fflush(stdout);
+	fflush(out);
 	return true;
 }
 
@@ -126,6 +130,20 @@ int extract(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fi
 		bank = 0;
 	}
 
+	if (!_tcscmp(gcm_filename, _T("-"))) {
+		// Writing the disc image to stdout.
+		// Status messages are printed to stderr.
+		fprintf(stderr, "Extracting Bank %u to stdout...\n", bank+1);
+		ret = rvth->extract(bank, gcm_filename, recrypt_key, flags, progress_callback, stderr);
+		if (ret == 0) {
+			fprintf(stderr, "Bank %u extracted to stdout successfully.\n", bank+1);
+		} else {
+			fprintf(stderr, "*** ERROR: rvth_extract() failed: %s\n", rvth_error(ret));
+		}
+		delete rvth;
+		return ret;
+	}
+
 	// Print the bank information.
 	// TODO: Make sure the bank type is valid before printing the newline.
 	print_bank(rvth, bank);
@@ -153,10 +171,12 @@ int extract(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fi
  * @param rvth_filename	RVT-H device or disk image filename.
  * @param s_bank	Bank number (as a string).
  * @param gcm_filename	Filename of the GCM image to import.
+ * @param s_bank_src	Source disc number in a WBFS image (as a string). (If NULL, assumes disc 1.)
  * @param ios_force	IOS version to force. (-1 to use the existing IOS)
+ * @param flags		[in] Flags. (See RvtH_Import_Flags.)
  * @return 0 on success; non-zero on error.
  */
-int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_filename, int ios_force)
+int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_filename, const TCHAR *s_bank_src, int ios_force, unsigned int flags)
 {
 	// TODO: Verification for overwriting images.
 
@@ -187,6 +207,20 @@ int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fil
 	print_bank(rvth, bank);
 	putchar('\n');
 
+	if (!_tcscmp(gcm_filename, _T("-"))) {
+		// Reading the disc image from stdin.
+		// The source disc can't be opened ahead of time.
+		printf("Importing stdin into Bank %u...\n", bank+1);
+		ret = rvth->import(bank, gcm_filename, progress_callback, nullptr, ios_force, 0, flags);
+		if (ret == 0) {
+			printf("stdin imported to Bank %u successfully.\n", bank+1);
+		} else {
+			fprintf(stderr, "*** ERROR: rvth_import() failed: %s\n", rvth_error(ret));
+		}
+		delete rvth;
+		return ret;
+	}
+
 	// Print the source disc information.
 	// This requires temporarily opening the source disc here.
 	RvtH *const rvth_src_tmp = new RvtH(gcm_filename, &ret);
@@ -198,14 +232,38 @@ int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fil
 		delete rvth;
 		return ret;
 	}
+
+	// Validate the source disc number.
+	unsigned int bank_src = 0;
+	if (s_bank_src) {
+		bank_src = (unsigned int)_tcstoul(s_bank_src, &endptr, 10) - 1;
+		if (*endptr != 0 || bank_src >= rvth_src_tmp->bankCount()) {
+			fputs("*** ERROR: Invalid source disc number '", stderr);
+			_fputts(s_bank_src, stderr);
+			fputs("'.\n", stderr);
+			delete rvth_src_tmp;
+			delete rvth;
+			return -EINVAL;
+		}
+	} else if (rvth_src_tmp->bankCount() > 1 && !rvth_src_tmp->isHDD()) {
+		// WBFS image with multiple discs.
+		fputs("*** ERROR: '", stderr);
+		_fputts(gcm_filename, stderr);
+		fprintf(stderr, "' contains %u discs. Specify a source disc number.\n",
+			rvth_src_tmp->bankCount());
+		delete rvth_src_tmp;
+		delete rvth;
+		return -EINVAL;
+	}
+
 	fputs("Source disc image:\n", stdout);
-	print_bank(rvth_src_tmp, 0);
+	print_bank(rvth_src_tmp, bank_src);
 	putchar('\n');
 
 	// If this is a Wii image and the IOS version doesn't match
 	// the forced version, print a notice.
 	if (ios_force >= 3) {
-		const RvtH_BankEntry *const entry = rvth_src_tmp->bankEntry(0);
+		const RvtH_BankEntry *const entry = rvth_src_tmp->bankEntry(bank_src);
 		if (entry &&
 			(entry->type == RVTH_BankType_Wii_SL ||
 			 entry->type == RVTH_BankType_Wii_DL))
@@ -221,7 +279,8 @@ int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fil
 	fputs("Importing '", stdout);
 	_fputts(gcm_filename, stdout);
 	printf("' into Bank %u...\n", bank+1);
-	ret = rvth->import(bank, gcm_filename, progress_callback, nullptr, ios_force);
+	std::vector<RvtH_VerifyError> verify_errors;
+	ret = rvth->import(bank, gcm_filename, progress_callback, nullptr, ios_force, bank_src, flags, &verify_errors);
 	if (ret == 0) {
 		fputc('\'', stdout);
 		_fputts(gcm_filename, stdout);
@@ -229,6 +288,13 @@ int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fil
 	} else {
 		// TODO: Delete the gcm file?
 		fprintf(stderr, "*** ERROR: rvth_import() failed: %s\n", rvth_error(ret));
+		if (!verify_errors.empty()) {
+			fputs("Mismatched LBAs, relative to the start of the bank:\n", stderr);
+			for (const RvtH_VerifyError &error : verify_errors) {
+				fprintf(stderr, "- 0x%08X-0x%08X (%u LBAs)\n", error.lba_start,
+					error.lba_start + error.lba_len - 1, error.lba_len);
+			}
+		}
 	}
 
 	delete rvth;
@@ -31,10 +31,12 @@ int extract(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_fi
  * @param rvth_filename	RVT-H device or disk image filename.
  * @param s_bank	Bank number (as a string).
  * @param gcm_filename	Filename of the GCM image to import.
+ * @param s_bank_src	Source disc number in a WBFS image (as a string). (If NULL, assumes disc 1.)
  * @param ios_force	IOS version to force. (-1 to use the existing IOS)
+ * @param flags		[in] Flags. (See RvtH_Import_Flags.)
  * @return 0 on success; non-zero on error.
  */
-int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_filename, int ios_force);
+int import(const TCHAR *rvth_filename, const TCHAR *s_bank, const TCHAR *gcm_filename, const TCHAR *s_bank_src, int ios_force, unsigned int flags);
 
 #ifdef __cplusplus
 }
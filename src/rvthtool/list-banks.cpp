@@ -69,6 +69,8 @@ int print_bank(const RvtH *rvth, unsigned int bank)
 		}
 		if (is_hdd) {
 			printf("Bank %u: ", bank+1);
+		} else if (bank_count > 1) {
+			printf("Disc %u: ", bank+1);
 		} else {
 			fputs("Disc image: ", stdout);
 		}
@@ -114,6 +116,8 @@ int print_bank(const RvtH *rvth, unsigned int bank)
 
 	if (is_hdd) {
 		printf("Bank %u: ", bank+1);
+	} else if (bank_count > 1) {
+		printf("Disc %u: ", bank+1);
 	} else {
 		fputs("Disc image: ", stdout);
 	}
@@ -328,6 +332,9 @@ int list_banks(const TCHAR *rvth_filename)
 		case RVTH_ImageType_GCM_SDK:
 			fputs("Type: GCM Disc Image (with SDK headers)\n", stdout);
 			break;
+		case RVTH_ImageType_WBFS:
+			fputs("Type: WBFS Image\n", stdout);
+			break;
 		default:
 			// Should not get here...
 			assert(!"Should not get here...");
@@ -380,6 +387,11 @@ int list_banks(const TCHAR *rvth_filename)
 		}
 		printf("%u bank%s]\n", bank_count, (bank_count != 1 ? "s" : ""));
 		putchar('\n');
+	} else if (rvth->imageType() == RVTH_ImageType_WBFS) {
+		// WBFS image. Each disc slot is a bank.
+		const unsigned int bank_count = rvth->bankCount();
+		printf("WBFS Disc Table: [%u slot%s]\n", bank_count, (bank_count != 1 ? "s" : ""));
+		putchar('\n');
 	}
 
 	print_bank_table(rvth);
@@ -28,6 +28,8 @@
 #include "list-banks.hpp"
 #include "extract.h"
 #include "undelete.h"
+#include "recrypt.h"
+#include "usage.h"
 #include "query.h"
 
 #ifdef _MSC_VER
@@ -95,21 +97,39 @@ static void print_help(const TCHAR *argv0)
 		"\n"
 		"extract " DEVICE_NAME_EXAMPLE " bank# disc.gcm\n"
 		"- Extract the specified bank number from rvth.img to disc.gcm.\n"
+		"  If disc.gcm is '-', the disc image is written to stdout.\n"
 		"\n"
-		"import " DEVICE_NAME_EXAMPLE " bank# disc.gcm\n"
+		"import " DEVICE_NAME_EXAMPLE " bank# disc.gcm [disc#]\n"
 		"- Import disc.gcm into rvth.img at the specified bank number.\n"
+		"  If disc.gcm is a WBFS image with multiple discs, disc# selects\n"
+		"  the disc to import. If disc.gcm is '-', the disc image is read\n"
+		"  from stdin. (Dual-layer images can't be imported from stdin.)\n"
 		"  The destination bank must be either empty or deleted.\n"
 		"  [This command only works with RVT-H Readers, not disk images.]\n"
 		"\n"
-		"delete " DEVICE_NAME_EXAMPLE " bank#\n"
-		"- Delete the specified bank number from the specified RVT-H device.\n"
+		"delete " DEVICE_NAME_EXAMPLE " bank# [bank#...]\n"
+		"- Delete the specified bank number(s) from the specified RVT-H device.\n"
 		"  This does NOT wipe the disc image.\n"
 		"  [This command only works with RVT-H Readers, not disk images.]\n"
 		"\n"
-		"undelete " DEVICE_NAME_EXAMPLE " bank#\n"
-		"- Undelete the specified bank number from the specified RVT-H device.\n"
+		"undelete " DEVICE_NAME_EXAMPLE " bank# [bank#...]\n"
+		"- Undelete the specified bank number(s) from the specified RVT-H device.\n"
 		"  [This command only works with RVT-H Readers, not disk images.]\n"
 		"\n"
+		"scan-deleted " DEVICE_NAME_EXAMPLE "\n"
+		"- Scan the entire RVT-H device for GameCube and Wii disc images,\n"
+		"  including images that are no longer in the bank table.\n"
+		"\n"
+		"usage " DEVICE_NAME_EXAMPLE " [bank#]\n"
+		"- Show how much of each bank on the specified RVT-H device is in use.\n"
+		"  If a bank number is specified, a usage map will be shown for that bank.\n"
+		"\n"
+		"recrypt-all " DEVICE_NAME_EXAMPLE "\n"
+		"- Recrypt all Wii banks on the specified RVT-H device in one pass\n"
+		"  using the key specified with --recrypt. (Default is debug.)\n"
+		"  Banks already using that key with valid signatures are skipped.\n"
+		"  Update partitions will be removed from recrypted banks.\n"
+		"\n"
 		"query\n"
 		"- Query all available RVT-H Reader devices and list them.\n"
 #ifndef HAVE_QUERY
@@ -121,12 +141,28 @@ static void print_help(const TCHAR *argv0)
 		"\n"
 		"Options:\n"
 		"\n"
-		"  -k, --recrypt=KEY         Recrypt the image using the specified KEY:\n"
+		"  -k, --recrypt=KEY,        Recrypt the image using the specified KEY:\n"
+		"      --key=KEY\n"
 		"                            default, retail, korean, debug\n"
 		"                            Recrypting to retail will use fakesigning.\n"
 		"                            Importing to RVT-H will always use debug keys.\n"
 		"  -N, --ndev                Prepend extracted images with a 32 KB header\n"
 		"                            required by official SDK tools.\n"
+		"  -s, --scrub               Scrub extracted images. Data that isn't\n"
+		"                            referenced by the disc's file system will\n"
+		"                            be written as holes in a sparse file.\n"
+		"  -J, --strip-junk          Strip junk data from extracted GameCube\n"
+		"                            images. Junk data is written as holes, and\n"
+		"                            is regenerated when the image is imported.\n"
+		"  -f, --format=FORMAT       Disc image format for extracted images:\n"
+		"                            gcm (default), gcz, ciso, wbfs\n"
+		"                            Non-GCM formats can't be recrypted.\n"
+		"  -r, --resume              Resume an interrupted extraction or import.\n"
+		"                            A resume journal is kept next to the GCM\n"
+		"                            while copying. The end of the completed\n"
+		"                            data is verified before continuing.\n"
+		"  -V, --verify              Read back imported data while copying and\n"
+		"                            compare it against the source image.\n"
 #ifdef SHOW_HIDDEN_OPTIONS
 		"  -I, --ios=xx              Force IOSxx when importing a disc image to\n"
 		"                            an RVT-H Reader."
@@ -139,7 +175,13 @@ static void print_help(const TCHAR *argv0)
 int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 {
 	int ret;
+	int i;
 	unsigned int flags = 0;
+	unsigned int import_flags = 0;
+
+	// If a disc image is being streamed through stdout,
+	// informational messages must be printed to stderr.
+	FILE *msg_out = stdout;
 
 	// Key to use for recryption.
 	// -1 == default; no recryption, except when importing retail to RVT-H.
@@ -158,17 +200,24 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 	// Set the C locale.
 	setlocale(LC_ALL, "");
 
-	puts("RVT-H Tool v" VERSION_STRING "\n"
+	for (i = 1; i < argc; i++) {
+		if (!_tcscmp(argv[i], _T("-"))) {
+			msg_out = stderr;
+			break;
+		}
+	}
+
+	fputs("RVT-H Tool v" VERSION_STRING "\n"
 		"Copyright (c) 2018-2019 by David Korth.\n"
-		"This program is NOT licensed or endorsed by Nintendo Co, Ltd."
-	);
+		"This program is NOT licensed or endorsed by Nintendo Co, Ltd.\n"
+		, msg_out);
 #ifdef RP_GIT_VERSION
-	puts(RP_GIT_VERSION);
+	fputs(RP_GIT_VERSION "\n", msg_out);
 # ifdef RP_GIT_DESCRIBE
-	puts(RP_GIT_DESCRIBE);
+	fputs(RP_GIT_DESCRIBE "\n", msg_out);
 # endif
 #endif
-	putchar('\n');
+	fputc('\n', msg_out);
 
 	// TODO: getopt().
 	// Unicode getopt() for Windows:
@@ -177,14 +226,20 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 	while (true) {
 		static const struct option long_options[] = {
 			{_T("recrypt"),	required_argument,	0, _T('k')},
+			{_T("key"),	required_argument,	0, _T('k')},
 			{_T("ndev"),	no_argument,		0, _T('N')},
+			{_T("scrub"),	no_argument,		0, _T('s')},
+			{_T("strip-junk"), no_argument,		0, _T('J')},
+			{_T("format"),	required_argument,	0, _T('f')},
+			{_T("resume"),	no_argument,		0, _T('r')},
+			{_T("verify"),	no_argument,		0, _T('V')},
 			{_T("ios"),	required_argument,	0, _T('I')},
 			{_T("help"),	no_argument,		0, _T('h')},
 
 			{NULL, 0, 0, 0}
 		};
 
-		int c = getopt_long(argc, argv, _T("k:NI:h"), long_options, NULL);
+		int c = getopt_long(argc, argv, _T("k:NsJf:rVI:h"), long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -220,6 +275,47 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 				flags |= RVTH_EXTRACT_PREPEND_SDK_HEADER;
 				break;
 
+			case 's':
+				// Scrub unused data.
+				// TODO: Show error if not using 'extract'?
+				flags |= RVTH_EXTRACT_SCRUB;
+				break;
+
+			case 'J':
+				// Strip junk data.
+				// TODO: Show error if not using 'extract'?
+				flags |= RVTH_EXTRACT_STRIP_JUNK;
+				break;
+
+			case 'f':
+				// Disc image format.
+				// TODO: Show error if not using 'extract'?
+				flags &= ~RVTH_EXTRACT_FORMAT_MASK;
+				if (!_tcsicmp(optarg, _T("gcm"))) {
+					flags |= RVTH_EXTRACT_FORMAT(RVTH_ExtractFormat_GCM);
+				} else if (!_tcsicmp(optarg, _T("gcz"))) {
+					flags |= RVTH_EXTRACT_FORMAT(RVTH_ExtractFormat_GCZ);
+				} else if (!_tcsicmp(optarg, _T("ciso"))) {
+					flags |= RVTH_EXTRACT_FORMAT(RVTH_ExtractFormat_CISO);
+				} else if (!_tcsicmp(optarg, _T("wbfs"))) {
+					flags |= RVTH_EXTRACT_FORMAT(RVTH_ExtractFormat_WBFS);
+				} else {
+					print_error(argv[0], _T("unknown disc image format '%s'"), optarg);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'r':
+				// Resume an interrupted extraction or import.
+				flags |= RVTH_EXTRACT_RESUME;
+				import_flags |= RVTH_IMPORT_RESUME;
+				break;
+
+			case 'V':
+				// Verify imported data.
+				import_flags |= RVTH_IMPORT_VERIFY;
+				break;
+
 			case 'I': {
 				// Force an IOS version.
 				char *endptr;
@@ -286,21 +382,43 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 			print_error(argv[0], _T("missing parameters for 'import'"));
 			return EXIT_FAILURE;
 		}
-		ret = import(argv[optind+1], argv[optind+2], argv[optind+3], ios_force);
+		ret = import(argv[optind+1], argv[optind+2], argv[optind+3],
+			(argc > optind+4 ? argv[optind+4] : NULL), ios_force, import_flags);
 	} else if (!_tcscmp(argv[optind], _T("delete"))) {
 		// Delete a bank.
-		if (argc < 3) {
+		if (argc < optind+3) {
 			print_error(argv[0], _T("missing parameters for 'delete'"));
 			return EXIT_FAILURE;
 		}
-		ret = delete_bank(argv[optind+1], argv[optind+2]);
+		ret = delete_bank(argv[optind+1], (const TCHAR *const *)&argv[optind+2], argc-(optind+2));
 	} else if (!_tcscmp(argv[optind], _T("undelete"))) {
 		// Undelete a bank.
-		if (argc < 3) {
+		if (argc < optind+3) {
 			print_error(argv[0], _T("missing parameters for 'undelete'"));
 			return EXIT_FAILURE;
 		}
-		ret = undelete_bank(argv[optind+1], argv[optind+2]);
+		ret = undelete_bank(argv[optind+1], (const TCHAR *const *)&argv[optind+2], argc-(optind+2));
+	} else if (!_tcscmp(argv[optind], _T("scan-deleted"))) {
+		// Scan for deleted disc images.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("RVT-H device or disk image not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = scan_deleted(argv[optind+1]);
+	} else if (!_tcscmp(argv[optind], _T("usage"))) {
+		// Show bank usage.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("RVT-H device or disk image not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = show_usage(argv[optind+1], (argc >= optind+3 ? argv[optind+2] : NULL));
+	} else if (!_tcscmp(argv[optind], _T("recrypt-all"))) {
+		// Recrypt all banks.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("RVT-H device or disk image not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = recrypt_all(argv[optind+1], recrypt_key, ios_force);
 	} else if (!_tcscmp(argv[optind], _T("query"))) {
 		// Query RVT-H Reader devices.
 		// NOTE: Not checking HAVE_QUERY. If querying isn't available,
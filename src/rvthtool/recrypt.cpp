@@ -0,0 +1,83 @@
+/***************************************************************************
+ * RVT-H Tool                                                              *
+ * recrypt.cpp: Recrypt banks in an RVT-H disk image.                      *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "recrypt.h"
+
+#include "librvth/rvth.hpp"
+#include "librvth/rvth_error.h"
+#include "libwiicrypto/sig_tools.h"
+
+// C includes. (C++ namespace)
+#include <cerrno>
+#include <cstdio>
+
+/**
+ * RVT-H progress callback for recrypt-all.
+ * @param state		[in] Current progress.
+ * @param userdata	[in] User data specified when calling the RVT-H function.
+ * @return True to continue; false to abort.
+ */
+static bool progress_callback(const RvtH_Progress_State *state, void *userdata)
+{
+	UNUSED(userdata);
+
+	if (state->type != RVTH_PROGRESS_RECRYPT)
+		return true;
+
+	if (state->lba_processed == 0) {
+		printf("Reading Bank %u...\n", state->bank_rvth+1);
+	} else {
+		printf("Bank %u recrypted.\n", state->bank_rvth+1);
+	}
+	fflush(stdout);
+	return true;
+}
+
+/**
+ * 'recrypt-all' command.
+ * @param rvth_filename	[in] RVT-H device or disk image filename.
+ * @param recrypt_key	[in] Key for recryption. (-1 for default, which is debug)
+ * @param ios_force	[in] IOS version to force. (-1 to use the existing IOS)
+ * @return 0 on success; non-zero on error.
+ */
+int recrypt_all(const TCHAR *rvth_filename, int recrypt_key, int ios_force)
+{
+	// Open the RVT-H device or disk image.
+	int ret;
+	RvtH *const rvth = new RvtH(rvth_filename, &ret);
+	if (ret != 0 || !rvth->isOpen()) {
+		fputs("*** ERROR opening RVT-H device '", stderr);
+		_fputts(rvth_filename, stderr);
+		fprintf(stderr, "': %s\n", rvth_error(ret));
+		delete rvth;
+		return ret;
+	}
+
+	// RVT-H Readers require debug keys, so use debug
+	// encryption if no key was specified.
+	const RVL_CryptoType_e cryptoType = (recrypt_key >= 0)
+		? static_cast<RVL_CryptoType_e>(recrypt_key)
+		: RVL_CryptoType_Debug;
+
+	unsigned int bankCount = 0;
+	printf("Recrypting all banks using %s keys...\n",
+		RVL_CryptoType_toString(cryptoType));
+	ret = rvth->recryptAllBanks(cryptoType, progress_callback, nullptr, ios_force, &bankCount);
+	if (ret == 0) {
+		if (bankCount == 0) {
+			fputs("No banks needed to be recrypted.\n", stdout);
+		} else {
+			printf("%u bank(s) recrypted successfully.\n", bankCount);
+		}
+	} else {
+		fprintf(stderr, "*** ERROR: rvth_recrypt_all() failed: %s\n", rvth_error(ret));
+	}
+
+	delete rvth;
+	return ret;
+}
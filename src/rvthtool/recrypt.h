@@ -0,0 +1,31 @@
+/***************************************************************************
+ * RVT-H Tool                                                              *
+ * recrypt.h: Recrypt banks in an RVT-H disk image.                        *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_RVTHTOOL_RECRYPT_H__
+#define __RVTHTOOL_RVTHTOOL_RECRYPT_H__
+
+#include "tcharx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 'recrypt-all' command.
+ * @param rvth_filename	[in] RVT-H device or disk image filename.
+ * @param recrypt_key	[in] Key for recryption. (-1 for default, which is debug)
+ * @param ios_force	[in] IOS version to force. (-1 to use the existing IOS)
+ * @return 0 on success; non-zero on error.
+ */
+int recrypt_all(const TCHAR *rvth_filename, int recrypt_key, int ios_force);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_RVTHTOOL_RECRYPT_H__ */
@@ -26,13 +26,20 @@
 #include <errno.h>
 #include <stdlib.h>
 
+// C++ includes.
+#include <vector>
+using std::vector;
+
 /**
- * 'delete' command.
+ * Delete or undelete one or more banks.
  * @param rvth_filename	RVT-H device or disk image filename.
- * @param s_bank	Bank number (as a string).
+ * @param s_banks	Bank numbers (as strings).
+ * @param bank_count	Number of bank numbers in s_banks.
+ * @param undelete	If true, undelete the banks; otherwise, delete them.
  * @return 0 on success; non-zero on error.
  */
-int delete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank)
+static int delete_or_undelete_banks(const TCHAR *rvth_filename,
+	const TCHAR *const *s_banks, int bank_count, bool undelete)
 {
 	// Open the disk image.
 	int ret;
@@ -45,42 +52,133 @@ int delete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank)
 		return ret;
 	}
 
-	// Validate the bank number.
-	TCHAR *endptr;
-	unsigned int bank = (unsigned int)_tcstoul(s_bank, &endptr, 10) - 1;
-	if (*endptr != 0 || bank > rvth->bankCount()) {
-		fputs("*** ERROR: Invalid bank number '", stderr);
-		_fputts(s_bank, stderr);
-		fputs("'.\n", stderr);
+	// Validate the bank numbers.
+	unsigned int *const banks = (unsigned int*)malloc(bank_count * sizeof(unsigned int));
+	if (!banks) {
 		delete rvth;
-		return -EINVAL;
+		return -ENOMEM;
+	}
+	for (int i = 0; i < bank_count; i++) {
+		TCHAR *endptr;
+		banks[i] = (unsigned int)_tcstoul(s_banks[i], &endptr, 10) - 1;
+		if (*endptr != 0 || banks[i] >= rvth->bankCount()) {
+			fputs("*** ERROR: Invalid bank number '", stderr);
+			_fputts(s_banks[i], stderr);
+			fputs("'.\n", stderr);
+			free(banks);
+			delete rvth;
+			return -EINVAL;
+		}
 	}
 
-	// Print the bank information.
-	// TODO: Make sure the bank type is valid before printing the newline.
-	print_bank(rvth, bank);
-	putchar('\n');
+	// Stage the bank table changes so the device is only written to once.
+	ret = rvth->beginBankTableUpdate();
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR: rvth_begin_bank_table_update() failed: %s\n", rvth_error(ret));
+		free(banks);
+		delete rvth;
+		return ret;
+	}
+
+	int err = 0;
+	for (int i = 0; i < bank_count; i++) {
+		const unsigned int bank = banks[i];
+
+		// Print the bank information.
+		// TODO: Make sure the bank type is valid before printing the newline.
+		print_bank(rvth, bank);
+		putchar('\n');
+
+		// Delete or undelete the bank.
+		if (!undelete) {
+			ret = rvth->deleteBank(bank);
+			if (ret == 0) {
+				printf("Bank %u deleted.\n", bank+1);
+			} else {
+				fprintf(stderr, "*** ERROR: rvth_delete() failed: %s\n", rvth_error(ret));
+			}
+		} else {
+			ret = rvth->undeleteBank(bank);
+			if (ret == 0) {
+				printf("Bank %u undeleted.\n", bank+1);
+			} else {
+				fprintf(stderr, "*** ERROR: rvth_undelete() failed: %s\n", rvth_error(ret));
+			}
+		}
+		if (ret != 0 && err == 0) {
+			err = ret;
+		}
+	}
 
-	// Delete the bank.
-	ret = rvth->deleteBank(bank);
-	if (ret == 0) {
-		printf("Bank %u deleted.\n", bank+1);
-	} else {
-		// TODO: Delete the gcm file?
-		fprintf(stderr, "*** ERROR: rvth_delete() failed: %s\n", rvth_error(ret));
+	// Write the bank table changes.
+	ret = rvth->commitBankTableUpdate();
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR: rvth_commit_bank_table_update() failed: %s\n", rvth_error(ret));
+		if (err == 0) {
+			err = ret;
+		}
 	}
 
+	free(banks);
 	delete rvth;
-	return ret;
+	return err;
+}
+
+/**
+ * 'delete' command.
+ * @param rvth_filename	RVT-H device or disk image filename.
+ * @param s_banks	Bank numbers (as strings).
+ * @param bank_count	Number of bank numbers in s_banks.
+ * @return 0 on success; non-zero on error.
+ */
+int delete_bank(const TCHAR *rvth_filename, const TCHAR *const *s_banks, int bank_count)
+{
+	return delete_or_undelete_banks(rvth_filename, s_banks, bank_count, false);
 }
 
 /**
  * 'undelete' command.
  * @param rvth_filename	RVT-H device or disk image filename.
- * @param s_bank	Bank number (as a string).
+ * @param s_banks	Bank numbers (as strings).
+ * @param bank_count	Number of bank numbers in s_banks.
  * @return 0 on success; non-zero on error.
  */
-int undelete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank)
+int undelete_bank(const TCHAR *rvth_filename, const TCHAR *const *s_banks, int bank_count)
+{
+	return delete_or_undelete_banks(rvth_filename, s_banks, bank_count, true);
+}
+
+/**
+ * RVT-H progress callback for scan-deleted.
+ * @param state		[in] Current progress.
+ * @param userdata	[in] User data specified when calling the RVT-H function.
+ * @return True to continue; false to abort.
+ */
+static bool scan_progress_callback(const RvtH_Progress_State *state, void *userdata)
+{
+	UNUSED(userdata);
+
+	#define MEGABYTE (1048576 / LBA_SIZE)
+	if (state->type != RVTH_PROGRESS_SCAN)
+		return true;
+
+	printf("\rScanning: %6u MiB / %6u MiB scanned...",
+		state->lba_processed / MEGABYTE,
+		state->lba_total / MEGABYTE);
+	if (state->lba_processed == state->lba_total) {
+		// Finished processing.
+		putchar('\n');
+	}
+	fflush(stdout);
+	return true;
+}
+
+/**
+ * 'scan-deleted' command.
+ * @param rvth_filename	RVT-H device or disk image filename.
+ * @return 0 on success; non-zero on error.
+ */
+int scan_deleted(const TCHAR *rvth_filename)
 {
 	// Open the disk image.
 	int ret;
@@ -93,31 +191,73 @@ int undelete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank)
 		return ret;
 	}
 
-	// Validate the bank number.
-	TCHAR *endptr;
-	unsigned int bank = (unsigned int)_tcstoul(s_bank, &endptr, 10) - 1;
-	if (*endptr != 0 || bank > rvth->bankCount()) {
-		fputs("*** ERROR: Invalid bank number '", stderr);
-		_fputts(s_bank, stderr);
-		fputs("'.\n", stderr);
+	fputs("Scanning '", stdout);
+	_fputts(rvth_filename, stdout);
+	fputs("' for disc images...\n", stdout);
+
+	vector<RvtH_ScanResult> results;
+	ret = rvth->scanDeleted(results, scan_progress_callback);
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR: rvth_scan_deleted() failed: %s\n", rvth_error(ret));
 		delete rvth;
-		return -EINVAL;
+		return ret;
 	}
 
-	// Print the bank information.
-	// TODO: Make sure the bank type is valid before printing the newline.
-	print_bank(rvth, bank);
 	putchar('\n');
+	if (results.empty()) {
+		fputs("No disc images were found.\n", stdout);
+		delete rvth;
+		return 0;
+	}
+
+	unsigned int recoverable = 0;
+	for (const RvtH_ScanResult &result : results) {
+		const char *s_type;
+		switch (result.type) {
+			case RVTH_BankType_GCN:
+				s_type = "GameCube";
+				break;
+			case RVTH_BankType_Wii_SL:
+				s_type = "Wii";
+				break;
+			case RVTH_BankType_Wii_DL:
+				s_type = "Wii (Dual-Layer)";
+				break;
+			default:
+				s_type = "Unknown";
+				break;
+		}
 
-	// Undelete the bank.
-	ret = rvth->undeleteBank(bank);
-	if (ret == 0) {
-		printf("Bank %u undeleted.\n", bank+1);
-	} else {
-		// TODO: Delete the gcm file?
-		fprintf(stderr, "*** ERROR: rvth_undelete() failed: %s\n", rvth_error(ret));
+		if (result.bank >= 0) {
+			printf("Bank %d: ", result.bank+1);
+		} else {
+			fputs("Unaligned: ", stdout);
+		}
+		printf("%s\n", s_type);
+		printf("- LBA start:   0x%08X\n", result.lba_start);
+		printf("- Game ID:     %.6s\n", result.discHeader.id6);
+		printf("- Title:       %.64s\n", result.discHeader.game_title);
+
+		fputs("- Status:      ", stdout);
+		if (result.flags & RVTH_SCAN_FLAG_IN_BANK_TABLE) {
+			fputs("In bank table\n", stdout);
+		} else {
+			recoverable++;
+			if (result.flags & RVTH_SCAN_FLAG_UNALIGNED) {
+				fputs("Not in bank table; not at a bank boundary\n", stdout);
+			} else {
+				fputs("Not in bank table; recoverable\n", stdout);
+			}
+		}
+		if (result.flags & RVTH_SCAN_FLAG_HEADER_WIPED) {
+			fputs("- NOTE: Disc header was wiped; recovered from the game partition.\n", stdout);
+		}
+		putchar('\n');
 	}
 
+	printf("%u disc image(s) found; %u not in the bank table.\n",
+		(unsigned int)results.size(), recoverable);
+
 	delete rvth;
-	return ret;
+	return 0;
 }
@@ -18,18 +18,27 @@ extern "C" {
 /**
  * 'delete' command.
  * @param rvth_filename	RVT-H device or disk image filename.
- * @param s_bank	Bank number (as a string).
+ * @param s_banks	Bank numbers (as strings).
+ * @param bank_count	Number of bank numbers in s_banks.
  * @return 0 on success; non-zero on error.
  */
-int delete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank);
+int delete_bank(const TCHAR *rvth_filename, const TCHAR *const *s_banks, int bank_count);
 
 /**
  * 'undelete' command.
  * @param rvth_filename	RVT-H device or disk image filename.
- * @param s_bank	Bank number (as a string).
+ * @param s_banks	Bank numbers (as strings).
+ * @param bank_count	Number of bank numbers in s_banks.
  * @return 0 on success; non-zero on error.
  */
-int undelete_bank(const TCHAR *rvth_filename, const TCHAR *s_bank);
+int undelete_bank(const TCHAR *rvth_filename, const TCHAR *const *s_banks, int bank_count);
+
+/**
+ * 'scan-deleted' command.
+ * @param rvth_filename	RVT-H device or disk image filename.
+ * @return 0 on success; non-zero on error.
+ */
+int scan_deleted(const TCHAR *rvth_filename);
 
 #ifdef __cplusplus
 }
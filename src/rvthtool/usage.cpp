@@ -0,0 +1,190 @@
+/***************************************************************************
+ * RVT-H Tool                                                              *
+ * usage.cpp: Show how much of each bank is in use.                        *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "usage.h"
+#include "librvth/rvth.hpp"
+#include "librvth/rvth_error.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// C++ includes.
+#include <vector>
+using std::vector;
+
+// Number of map blocks per line in the usage map.
+#define USAGE_MAP_WIDTH 64
+
+/**
+ * RVT-H progress callback for usage.
+ * @param state		[in] Current progress.
+ * @param userdata	[in] User data specified when calling the RVT-H function.
+ * @return True to continue; false to abort.
+ */
+static bool usage_progress_callback(const RvtH_Progress_State *state, void *userdata)
+{
+	UNUSED(userdata);
+
+	#define MEGABYTE (1048576 / LBA_SIZE)
+	if (state->type != RVTH_PROGRESS_USAGE)
+		return true;
+
+	printf("\rScanning: %6u MiB / %6u MiB scanned...",
+		state->lba_processed / MEGABYTE,
+		state->lba_total / MEGABYTE);
+	if (state->lba_processed == state->lba_total) {
+		// Finished processing.
+		putchar('\n');
+	}
+	fflush(stdout);
+	return true;
+}
+
+/**
+ * Print a size in MiB.
+ * @param title Title.
+ * @param size Size, in bytes.
+ * @param total Total size, in bytes. (for percentage)
+ */
+static void print_size(const char *title, uint64_t size, uint64_t total)
+{
+	printf("- %-13s%8.1f MiB", title, (double)size / 1048576.0);
+	if (total != 0) {
+		printf(" (%5.1f%%)", (double)size * 100.0 / (double)total);
+	}
+	putchar('\n');
+}
+
+/**
+ * Print the usage map for a bank.
+ * Each character represents RVTH_USAGE_MAP_BLOCK_SIZE bytes.
+ * @param usage Bank usage.
+ */
+static void print_usage_map(const RvtH_BankUsage &usage)
+{
+	static const unsigned int blocks_per_map =
+		RVTH_USAGE_MAP_BLOCK_SIZE / RVTH_USAGE_SPARSE_BLOCK_SIZE;
+
+	printf("Usage map: (each character is %u MiB)\n", RVTH_USAGE_MAP_BLOCK_SIZE / 1048576);
+	fputs("  ' ' = empty, '.' = <25%, 'o' = <75%, '#' = >=75% in use\n", stdout);
+
+	const size_t count = usage.map.size();
+	for (size_t i = 0; i < count; i += USAGE_MAP_WIDTH) {
+		printf("%6u MiB |", (unsigned int)(i * (RVTH_USAGE_MAP_BLOCK_SIZE / 1048576)));
+		for (size_t j = i; j < i + USAGE_MAP_WIDTH && j < count; j++) {
+			const unsigned int blocks = usage.map[j];
+			char chr;
+			if (blocks == 0) {
+				chr = ' ';
+			} else if (blocks < blocks_per_map / 4) {
+				chr = '.';
+			} else if (blocks < (blocks_per_map * 3) / 4) {
+				chr = 'o';
+			} else {
+				chr = '#';
+			}
+			putchar(chr);
+		}
+		fputs("|\n", stdout);
+	}
+}
+
+/**
+ * 'usage' command.
+ * @param rvth_filename	RVT-H device or disk image filename.
+ * @param s_bank	[opt] Bank number (as a string). If specified, a usage map will be printed for this bank.
+ * @return 0 on success; non-zero on error.
+ */
+int show_usage(const TCHAR *rvth_filename, const TCHAR *s_bank)
+{
+	// Open the disk image.
+	int ret;
+	RvtH *const rvth = new RvtH(rvth_filename, &ret);
+	if (ret != 0 || !rvth->isOpen()) {
+		fputs("*** ERROR opening RVT-H device '", stderr);
+		_fputts(rvth_filename, stderr);
+		fprintf(stderr, "': %s\n", rvth_error(ret));
+		delete rvth;
+		return ret;
+	}
+
+	// Validate the bank number.
+	unsigned int map_bank = ~0U;
+	if (s_bank) {
+		TCHAR *endptr;
+		map_bank = (unsigned int)_tcstoul(s_bank, &endptr, 10) - 1;
+		if (*endptr != 0 || map_bank >= rvth->bankCount()) {
+			fputs("*** ERROR: Invalid bank number '", stderr);
+			_fputts(s_bank, stderr);
+			fputs("'.\n", stderr);
+			delete rvth;
+			return -EINVAL;
+		}
+	}
+
+	fputs("Scanning '", stdout);
+	_fputts(rvth_filename, stdout);
+	fputs("' for used blocks...\n", stdout);
+
+	vector<RvtH_BankUsage> usage;
+	ret = rvth->getBankUsage(usage, usage_progress_callback);
+	if (ret != 0) {
+		fprintf(stderr, "*** ERROR: rvth_get_bank_usage() failed: %s\n", rvth_error(ret));
+		delete rvth;
+		return ret;
+	}
+	putchar('\n');
+
+	uint64_t total_size = 0, total_sparse = 0;
+	const unsigned int bank_count = rvth->bankCount();
+	for (unsigned int bank = 0; bank < bank_count; bank++) {
+		const RvtH_BankUsage &u = usage[bank];
+		if (u.lba_len == 0) {
+			// Not scanned.
+			continue;
+		}
+		const RvtH_BankEntry *const entry = rvth->bankEntry(bank);
+
+		if (rvth->isHDD()) {
+			printf("Bank %u:%s\n", bank+1, (entry->is_deleted ? " [DELETED]" : ""));
+		} else {
+			fputs("Disc image:\n", stdout);
+		}
+		printf("- Game ID:     %.6s\n", entry->discHeader.id6);
+		const uint64_t size = LBA_TO_BYTES((uint64_t)u.lba_len);
+		print_size("Size:", size, 0);
+		print_size("Non-zero:", u.nonzero_bytes, size);
+		print_size("Sparse size:", u.sparse_size, size);
+		print_size("Trimmed size:", u.trimmed_size, size);
+		putchar('\n');
+
+		total_size += size;
+		total_sparse += u.sparse_size;
+	}
+
+	if (total_size != 0) {
+		printf("Total: %.1f MiB allocated; %.1f MiB in use.\n",
+			(double)total_size / 1048576.0, (double)total_sparse / 1048576.0);
+	} else {
+		fputs("No banks contain disc images.\n", stdout);
+	}
+
+	if (s_bank) {
+		putchar('\n');
+		const RvtH_BankUsage &u = usage[map_bank];
+		if (u.lba_len != 0) {
+			print_usage_map(u);
+		} else {
+			printf("Bank %u is empty.\n", map_bank+1);
+		}
+	}
+
+	delete rvth;
+	return 0;
+}
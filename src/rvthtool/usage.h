@@ -0,0 +1,30 @@
+/***************************************************************************
+ * RVT-H Tool                                                              *
+ * usage.h: Show how much of each bank is in use.                          *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_RVTHTOOL_USAGE_H__
+#define __RVTHTOOL_RVTHTOOL_USAGE_H__
+
+#include "tcharx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * 'usage' command.
+ * @param rvth_filename	RVT-H device or disk image filename.
+ * @param s_bank	[opt] Bank number (as a string). If specified, a usage map will be printed for this bank.
+ * @return 0 on success; non-zero on error.
+ */
+int show_usage(const TCHAR *rvth_filename, const TCHAR *s_bank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_RVTHTOOL_USAGE_H__ */
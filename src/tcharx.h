@@ -35,6 +35,7 @@ typedef char TCHAR;
 // stdio.h
 #define _fputts(s, stream) fputs((s), (stream))
 #define _fputtc(c, stream) fputc((c), (stream))
+#define _fgetts(s, n, stream) fgets((s), (n), (stream))
 
 #define _tfopen(filename, mode)		fopen((filename), (mode))
 #define _tmkdir(path, mode)		mkdir((path), (mode))
@@ -0,0 +1,761 @@
+/***************************************************************************
+ * RVT-H Tool: WAD Resigner                                                *
+ * batch.c: Batch processing of WAD files.                                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#include "batch.h"
+#include "print-info.h"
+#include "resign-wad.h"
+#include "wad-fns.h"
+
+#include "libwiicrypto/common.h"
+#include "libwiicrypto/threadw.h"
+
+// C includes.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+# include <windows.h>
+# include <direct.h>
+# define DIR_SEP_CHR _T('\\')
+# define NULL_DEVICE _T("NUL")
+#else /* !_WIN32 */
+# include <dirent.h>
+# include <sys/stat.h>
+# define DIR_SEP_CHR _T('/')
+# define NULL_DEVICE _T("/dev/null")
+#endif /* _WIN32 */
+
+/**
+ * A single WAD file to process.
+ */
+typedef struct _BatchJob {
+	TCHAR *name;		// Filename as listed. (for the summary)
+	TCHAR *src_path;	// Source WAD.
+	TCHAR *dest_path;	// Destination WAD. (resign only)
+	int ret;		// resign_wad() or print_wad_info() return value
+	char *message;		// Summary message on error. (may be NULL)
+} BatchJob;
+
+/**
+ * Batch processing parameters.
+ * Shared by all worker threads.
+ */
+typedef struct _BatchParams {
+	BatchJob *jobs;
+	unsigned int count;
+	bool verify;		// If true, verify instead of resigning.
+	int recrypt_key;
+	int output_format;
+
+	// Output stream for the jobs' output.
+	// Only the summary is printed, so this is the null device.
+	FILE *f_null;
+
+	// Progress. (protected by mutex)
+	threadw_mutex_t mutex;
+	unsigned int done;
+} BatchParams;
+
+/**
+ * Concatenate a directory and a filename.
+ * @param dir		[in] Directory.
+ * @param filename	[in] Filename.
+ * @return Allocated path, or NULL on error.
+ */
+static TCHAR *path_join(const TCHAR *dir, const TCHAR *filename)
+{
+	const size_t dir_len = _tcslen(dir);
+	const size_t filename_len = _tcslen(filename);
+	size_t pos = dir_len;
+	TCHAR *path = malloc((dir_len + 1 + filename_len + 1) * sizeof(TCHAR));
+	if (!path) {
+		return NULL;
+	}
+
+	memcpy(path, dir, dir_len * sizeof(TCHAR));
+	if (dir_len == 0 || (dir[dir_len-1] != _T('/') && dir[dir_len-1] != DIR_SEP_CHR)) {
+		path[pos++] = DIR_SEP_CHR;
+	}
+	memcpy(&path[pos], filename, (filename_len + 1) * sizeof(TCHAR));
+	return path;
+}
+
+/**
+ * Get the filename portion of a path.
+ * @param path Path.
+ * @return Filename.
+ */
+static const TCHAR *path_filename(const TCHAR *path)
+{
+	const TCHAR *slash = _tcsrchr(path, _T('/'));
+#ifdef _WIN32
+	const TCHAR *bslash = _tcsrchr(path, _T('\\'));
+	if (bslash > slash) {
+		slash = bslash;
+	}
+#endif /* _WIN32 */
+	return (slash ? slash + 1 : path);
+}
+
+/**
+ * Check if a filename has a WAD file extension. (.wad or .bwf)
+ * @param filename Filename.
+ * @return True if it does; false if it doesn't.
+ */
+static bool is_wad_filename(const TCHAR *filename)
+{
+	const TCHAR *ext = _tcsrchr(filename, _T('.'));
+	if (!ext) {
+		return false;
+	}
+	return (!_tcsicmp(ext, _T(".wad")) || !_tcsicmp(ext, _T(".bwf")));
+}
+
+/**
+ * Check if a path is a directory.
+ * @param path Path.
+ * @return 1 if it's a directory; 0 if it isn't; negative POSIX error code on error.
+ */
+static int is_directory(const TCHAR *path)
+{
+#ifdef _WIN32
+	DWORD attrs = GetFileAttributes(path);
+	if (attrs == INVALID_FILE_ATTRIBUTES) {
+		return -ENOENT;
+	}
+	return !!(attrs & FILE_ATTRIBUTE_DIRECTORY);
+#else /* !_WIN32 */
+	struct stat sb;
+	if (stat(path, &sb) != 0) {
+		return -errno;
+	}
+	return !!S_ISDIR(sb.st_mode);
+#endif /* _WIN32 */
+}
+
+/**
+ * Check if two paths refer to the same file.
+ * Paths are compared by file identity, so different spellings
+ * of the same path, symlinks, and hard links are detected.
+ * @param path_a Path A.
+ * @param path_b Path B.
+ * @return True if both paths exist and refer to the same file; false if not.
+ */
+static bool is_same_file(const TCHAR *path_a, const TCHAR *path_b)
+{
+#ifdef _WIN32
+	BY_HANDLE_FILE_INFORMATION info_a, info_b;
+	BOOL bRet_a, bRet_b;
+	HANDLE hFile_a, hFile_b;
+
+	hFile_a = CreateFile(path_a, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile_a == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	hFile_b = CreateFile(path_b, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile_b == INVALID_HANDLE_VALUE) {
+		CloseHandle(hFile_a);
+		return false;
+	}
+
+	bRet_a = GetFileInformationByHandle(hFile_a, &info_a);
+	bRet_b = GetFileInformationByHandle(hFile_b, &info_b);
+	CloseHandle(hFile_a);
+	CloseHandle(hFile_b);
+	if (!bRet_a || !bRet_b) {
+		return false;
+	}
+	return (info_a.dwVolumeSerialNumber == info_b.dwVolumeSerialNumber &&
+		info_a.nFileIndexHigh == info_b.nFileIndexHigh &&
+		info_a.nFileIndexLow == info_b.nFileIndexLow);
+#else /* !_WIN32 */
+	struct stat sb_a, sb_b;
+	if (stat(path_a, &sb_a) != 0 || stat(path_b, &sb_b) != 0) {
+		return false;
+	}
+	return (sb_a.st_dev == sb_b.st_dev && sb_a.st_ino == sb_b.st_ino);
+#endif /* _WIN32 */
+}
+
+/**
+ * Add a job to the job list.
+ * @param pJobs		[in/out] Job list.
+ * @param pCount	[in/out] Number of jobs.
+ * @param pAlloc	[in/out] Number of jobs allocated.
+ * @param name		[in] Filename as listed.
+ * @param src_path	[in] Source WAD. (takes ownership)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int add_job(BatchJob **pJobs, unsigned int *pCount, unsigned int *pAlloc,
+	const TCHAR *name, TCHAR *src_path)
+{
+	BatchJob *job;
+
+	if (!src_path) {
+		return -ENOMEM;
+	}
+	if (*pCount == *pAlloc) {
+		unsigned int new_alloc = (*pAlloc > 0 ? *pAlloc * 2 : 64);
+		BatchJob *new_jobs = realloc(*pJobs, new_alloc * sizeof(**pJobs));
+		if (!new_jobs) {
+			free(src_path);
+			return -ENOMEM;
+		}
+		*pJobs = new_jobs;
+		*pAlloc = new_alloc;
+	}
+
+	job = &(*pJobs)[*pCount];
+	memset(job, 0, sizeof(*job));
+	job->name = _tcsdup(name);
+	job->src_path = src_path;
+	if (!job->name) {
+		free(src_path);
+		return -ENOMEM;
+	}
+	(*pCount)++;
+	return 0;
+}
+
+/**
+ * Compare two jobs by name. (for qsort)
+ */
+static int compare_jobs(const void *a, const void *b)
+{
+	return _tcscmp(((const BatchJob*)a)->name, ((const BatchJob*)b)->name);
+}
+
+/**
+ * Compare two jobs by destination filename. (for qsort)
+ * Used to find jobs that would write to the same output WAD.
+ */
+static int compare_jobs_dest(const void *a, const void *b)
+{
+	const BatchJob *const job_a = *(const BatchJob *const *)a;
+	const BatchJob *const job_b = *(const BatchJob *const *)b;
+#ifdef _WIN32
+	// Windows filenames are case-insensitive.
+	return _tcsicmp(path_filename(job_a->name), path_filename(job_b->name));
+#else /* !_WIN32 */
+	return _tcscmp(path_filename(job_a->name), path_filename(job_b->name));
+#endif /* _WIN32 */
+}
+
+/**
+ * Check for jobs that would write to the same output WAD.
+ * Output WADs use the same filenames as the input WADs, so WADs
+ * with the same filename in different directories would collide.
+ * @param jobs	[in] Job list.
+ * @param count	[in] Number of jobs.
+ * @return 0 if all output filenames are unique; -EEXIST if not; negative POSIX error code on error.
+ */
+static int check_duplicate_dest(const BatchJob *jobs, unsigned int count)
+{
+	const BatchJob **sorted;
+	unsigned int i;
+	int ret = 0;
+
+	if (count < 2) {
+		return 0;
+	}
+	sorted = malloc(count * sizeof(*sorted));
+	if (!sorted) {
+		return -ENOMEM;
+	}
+	for (i = 0; i < count; i++) {
+		sorted[i] = &jobs[i];
+	}
+	qsort(sorted, count, sizeof(*sorted), compare_jobs_dest);
+
+	for (i = 1; i < count; i++) {
+		if (compare_jobs_dest(&sorted[i-1], &sorted[i]) != 0) {
+			continue;
+		}
+		fputs("*** ERROR: '", stderr);
+		_fputts(sorted[i-1]->name, stderr);
+		fputs("' and '", stderr);
+		_fputts(sorted[i]->name, stderr);
+		fputs("' would have the same output filename.\n", stderr);
+		ret = -EEXIST;
+	}
+
+	free(sorted);
+	return ret;
+}
+
+/**
+ * List the WAD files in a directory.
+ * Subdirectories are not searched.
+ * @param dir		[in] Directory.
+ * @param pJobs		[out] Job list.
+ * @param pCount	[out] Number of jobs.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int list_wads_in_dir(const TCHAR *dir, BatchJob **pJobs, unsigned int *pCount)
+{
+	unsigned int alloc = 0;
+	int ret = 0;
+
+#ifdef _WIN32
+	WIN32_FIND_DATA findData;
+	HANDLE hFind;
+	TCHAR *pattern = path_join(dir, _T("*"));
+	if (!pattern) {
+		return -ENOMEM;
+	}
+	hFind = FindFirstFile(pattern, &findData);
+	free(pattern);
+	if (hFind == INVALID_HANDLE_VALUE) {
+		return (GetLastError() == ERROR_FILE_NOT_FOUND ? 0 : -ENOENT);
+	}
+
+	do {
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ||
+		    !is_wad_filename(findData.cFileName))
+		{
+			continue;
+		}
+		ret = add_job(pJobs, pCount, &alloc, findData.cFileName,
+			path_join(dir, findData.cFileName));
+	} while (ret == 0 && FindNextFile(hFind, &findData));
+	FindClose(hFind);
+#else /* !_WIN32 */
+	struct dirent *dirent;
+	DIR *pDir = opendir(dir);
+	if (!pDir) {
+		return -errno;
+	}
+
+	while (ret == 0 && (dirent = readdir(pDir)) != NULL) {
+		TCHAR *src_path;
+		if (!is_wad_filename(dirent->d_name)) {
+			continue;
+		}
+		src_path = path_join(dir, dirent->d_name);
+		if (src_path && is_directory(src_path) != 0) {
+			// Directory, or it can't be accessed.
+			free(src_path);
+			continue;
+		}
+		ret = add_job(pJobs, pCount, &alloc, dirent->d_name, src_path);
+	}
+	closedir(pDir);
+#endif /* _WIN32 */
+
+	if (ret == 0 && *pCount > 1) {
+		// Process the files in a consistent order.
+		qsort(*pJobs, *pCount, sizeof(**pJobs), compare_jobs);
+	}
+	return ret;
+}
+
+/**
+ * List the WAD files in a list file.
+ * Each line has one WAD filename. Blank lines and lines
+ * starting with '#' are ignored.
+ * @param list_filename	[in] List file.
+ * @param pJobs		[out] Job list.
+ * @param pCount	[out] Number of jobs.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int list_wads_in_file(const TCHAR *list_filename, BatchJob **pJobs, unsigned int *pCount)
+{
+	unsigned int alloc = 0;
+	TCHAR line[4096];
+	int ret = 0;
+
+	FILE *f_list = _tfopen(list_filename, _T("r"));
+	if (!f_list) {
+		return -errno;
+	}
+
+	while (ret == 0 && _fgetts(line, (int)ARRAY_SIZE(line), f_list)) {
+		// Remove the trailing newline.
+		size_t len = _tcslen(line);
+		while (len > 0 && (line[len-1] == _T('\n') || line[len-1] == _T('\r'))) {
+			line[--len] = 0;
+		}
+		if (len == 0 || line[0] == _T('#')) {
+			continue;
+		}
+		ret = add_job(pJobs, pCount, &alloc, line, _tcsdup(line));
+	}
+	if (ret == 0 && ferror(f_list)) {
+		ret = -EIO;
+	}
+	fclose(f_list);
+	return ret;
+}
+
+/**
+ * Process a single WAD file.
+ * Called by threadw_parallel_for().
+ * @param index		[in] Job index.
+ * @param userdata	[in] BatchParams.
+ */
+static void batch_worker(unsigned int index, void *userdata)
+{
+	BatchParams *const params = (BatchParams*)userdata;
+	BatchJob *const job = &params->jobs[index];
+	WAD_Status_t status;
+
+	// Error messages are collected in the WAD status
+	// for the summary, so the output is discarded.
+	status.message[0] = 0;
+	if (params->verify) {
+		// WADs are already processed in parallel, so each
+		// WAD's contents are verified on a single thread.
+		job->ret = print_wad_info(job->src_path, true, 1,
+			params->f_null, params->f_null, &status);
+	} else {
+		job->ret = resign_wad(job->src_path, job->dest_path,
+			params->recrypt_key, params->output_format,
+			params->f_null, params->f_null, &status);
+	}
+
+	if (job->ret != 0 && status.message[0] != 0) {
+		job->message = strdup(status.message);
+	}
+
+	// Show the progress.
+	threadw_mutex_lock(&params->mutex);
+	params->done++;
+	fprintf(stderr, "\rProcessed %u of %u WAD files...", params->done, params->count);
+	fflush(stderr);
+	threadw_mutex_unlock(&params->mutex);
+}
+
+/**
+ * Write a string to a JSON file.
+ * @param f JSON file.
+ * @param s String. (If NULL, writes null.)
+ */
+static void json_write_string(FILE *f, const char *s)
+{
+	if (!s) {
+		fputs("null", f);
+		return;
+	}
+
+	fputc('"', f);
+	for (; *s != 0; s++) {
+		const unsigned char chr = (unsigned char)*s;
+		switch (chr) {
+			case '"':
+				fputs("\\\"", f);
+				break;
+			case '\\':
+				fputs("\\\\", f);
+				break;
+			case '\n':
+				fputs("\\n", f);
+				break;
+			case '\r':
+				fputs("\\r", f);
+				break;
+			case '\t':
+				fputs("\\t", f);
+				break;
+			default:
+				if (chr < 0x20) {
+					fprintf(f, "\\u%04X", chr);
+				} else {
+					fputc(chr, f);
+				}
+				break;
+		}
+	}
+	fputc('"', f);
+}
+
+/**
+ * Write a TCHAR string to a JSON file.
+ * @param f JSON file.
+ * @param s String. (If NULL, writes null.)
+ */
+static void json_write_tstring(FILE *f, const TCHAR *s)
+{
+#ifdef _UNICODE
+	// Convert to UTF-8.
+	char *s8 = NULL;
+	if (s) {
+		int len = WideCharToMultiByte(CP_UTF8, 0, s, -1, NULL, 0, NULL, NULL);
+		if (len > 0) {
+			s8 = malloc(len);
+			if (s8) {
+				WideCharToMultiByte(CP_UTF8, 0, s, -1, s8, len, NULL, NULL);
+			}
+		}
+	}
+	json_write_string(f, s8);
+	free(s8);
+#else /* !_UNICODE */
+	json_write_string(f, s);
+#endif /* _UNICODE */
+}
+
+/**
+ * Write the JSON summary.
+ * @param json_filename	[in] JSON filename.
+ * @param command	[in] Command name.
+ * @param params	[in] BatchParams.
+ * @param failed	[in] Number of failed jobs.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int write_json_summary(const TCHAR *json_filename, const char *command,
+	const BatchParams *params, unsigned int failed)
+{
+	unsigned int i;
+	int ret = 0;
+
+	FILE *f_json = _tfopen(json_filename, _T("w"));
+	if (!f_json) {
+		return -errno;
+	}
+
+	fputs("{\n\t\"command\": ", f_json);
+	json_write_string(f_json, command);
+	fprintf(f_json, ",\n\t\"total\": %u,\n\t\"ok\": %u,\n\t\"failed\": %u,\n\t\"files\": [",
+		params->count, params->count - failed, failed);
+	for (i = 0; i < params->count; i++) {
+		const BatchJob *const job = &params->jobs[i];
+		fputs((i > 0 ? ",\n\t\t{\"file\": " : "\n\t\t{\"file\": "), f_json);
+		json_write_tstring(f_json, job->name);
+		if (!params->verify) {
+			fputs(", \"output\": ", f_json);
+			json_write_tstring(f_json, job->dest_path);
+		}
+		fprintf(f_json, ", \"status\": \"%s\", \"error\": %d, \"message\": ",
+			(job->ret == 0 ? "ok" : "failed"), job->ret);
+		json_write_string(f_json, job->message);
+		fputc('}', f_json);
+	}
+	fputs((params->count > 0 ? "\n\t]\n}\n" : "]\n}\n"), f_json);
+
+	if (ferror(f_json)) {
+		ret = -EIO;
+	}
+	if (fclose(f_json) != 0 && ret == 0) {
+		ret = -errno;
+	}
+	return ret;
+}
+
+/**
+ * Run a batch.
+ * @param command	[in] Command name.
+ * @param in_path	[in] Input directory or list of WAD files.
+ * @param out_dir	[in] Output directory. (NULL to verify)
+ * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param output_format	[in] Output format. (-1 for default)
+ * @param jobs		[in] Maximum number of WADs to process at once. (0 for automatic)
+ * @param json_filename	[in,opt] If not NULL, write a JSON summary to this file.
+ * @return 0 if all WADs were processed successfully; 1 if any WADs failed; negative POSIX error code on error.
+ */
+static int run_batch(const char *command, const TCHAR *in_path, const TCHAR *out_dir,
+	int recrypt_key, int output_format, unsigned int jobs, const TCHAR *json_filename)
+{
+	BatchParams params;
+	unsigned int i, failed = 0;
+	int ret;
+
+	memset(&params, 0, sizeof(params));
+	params.verify = (out_dir == NULL);
+	params.recrypt_key = recrypt_key;
+	params.output_format = output_format;
+
+	// Get the list of WAD files.
+	ret = is_directory(in_path);
+	if (ret > 0) {
+		ret = list_wads_in_dir(in_path, &params.jobs, &params.count);
+	} else if (ret == 0) {
+		ret = list_wads_in_file(in_path, &params.jobs, &params.count);
+	}
+	if (ret != 0) {
+		fputs("*** ERROR reading '", stderr);
+		_fputts(in_path, stderr);
+		fprintf(stderr, "': %s\n", strerror(-ret));
+		goto end;
+	}
+	if (params.count == 0) {
+		fputs("*** ERROR: No WAD files found in '", stderr);
+		_fputts(in_path, stderr);
+		fputs("'.\n", stderr);
+		ret = -ENOENT;
+		goto end;
+	}
+
+	if (out_dir) {
+		// Make sure the output filenames are unique
+		// before anything is written.
+		ret = check_duplicate_dest(params.jobs, params.count);
+		if (ret != 0) {
+			goto end;
+		}
+
+		// Create the output directory.
+#ifdef _WIN32
+		ret = _tmkdir(out_dir);
+#else /* !_WIN32 */
+		ret = _tmkdir(out_dir, 0777);
+#endif /* _WIN32 */
+		if (ret != 0 && errno != EEXIST) {
+			ret = -errno;
+			fputs("*** ERROR creating output directory '", stderr);
+			_fputts(out_dir, stderr);
+			fprintf(stderr, "': %s\n", strerror(-ret));
+			goto end;
+		}
+		ret = 0;
+
+		// Output WADs use the same filenames as the input WADs.
+		for (i = 0; i < params.count; i++) {
+			BatchJob *const job = &params.jobs[i];
+			job->dest_path = path_join(out_dir, path_filename(job->name));
+			if (!job->dest_path) {
+				ret = -ENOMEM;
+				goto end;
+			}
+			if (is_same_file(job->src_path, job->dest_path)) {
+				// Resigning would overwrite the source WAD.
+				fputs("*** ERROR: Output directory '", stderr);
+				_fputts(out_dir, stderr);
+				fputs("' is the same as the input directory.\n", stderr);
+				ret = -EINVAL;
+				goto end;
+			}
+		}
+	}
+
+	params.f_null = _tfopen(NULL_DEVICE, _T("w"));
+	if (!params.f_null) {
+		ret = -errno;
+		goto end;
+	}
+	ret = threadw_mutex_init(&params.mutex);
+	if (ret != 0) {
+		fclose(params.f_null);
+		params.f_null = NULL;
+		goto end;
+	}
+
+	// Limit the number of jobs to the memory budget.
+	if (jobs == 0) {
+		jobs = threadw_cpu_count();
+	}
+	if (jobs > BATCH_MEMORY_BUDGET / BATCH_JOB_MEMORY) {
+		jobs = BATCH_MEMORY_BUDGET / BATCH_JOB_MEMORY;
+	}
+
+	printf("%s %u WAD file%s using %u job%s...\n",
+		(params.verify ? "Verifying" : "Resigning"),
+		params.count, (params.count != 1 ? "s" : ""),
+		jobs, (jobs != 1 ? "s" : ""));
+	fflush(stdout);
+
+	// NOTE: Certificates, keys, and the random number generator are
+	// process-wide in libwiicrypto, so they're shared by all jobs.
+	ret = threadw_parallel_for(params.count, jobs, batch_worker, &params);
+	fputc('\n', stderr);
+	threadw_mutex_destroy(&params.mutex);
+	fclose(params.f_null);
+	params.f_null = NULL;
+	if (ret != 0) {
+		goto end;
+	}
+
+	// Print the summary.
+	putchar('\n');
+	for (i = 0; i < params.count; i++) {
+		const BatchJob *const job = &params.jobs[i];
+		if (job->ret == 0) {
+			fputs("OK:     ", stdout);
+			_fputts(job->name, stdout);
+		} else {
+			failed++;
+			fputs("FAILED: ", stdout);
+			_fputts(job->name, stdout);
+			if (job->message) {
+				printf(": %s", job->message);
+			} else if (job->ret < 0) {
+				printf(": %s", strerror(-job->ret));
+			} else {
+				printf(": error %d", job->ret);
+			}
+		}
+		putchar('\n');
+	}
+	printf("\n%u WAD file%s processed: %u OK, %u failed.\n",
+		params.count, (params.count != 1 ? "s" : ""),
+		params.count - failed, failed);
+
+	if (json_filename) {
+		ret = write_json_summary(json_filename, command, &params, failed);
+		if (ret != 0) {
+			fputs("*** ERROR writing JSON summary '", stderr);
+			_fputts(json_filename, stderr);
+			fprintf(stderr, "': %s\n", strerror(-ret));
+			goto end;
+		}
+	}
+
+	ret = (failed > 0 ? 1 : 0);
+
+end:
+	for (i = 0; i < params.count; i++) {
+		free(params.jobs[i].name);
+		free(params.jobs[i].src_path);
+		free(params.jobs[i].dest_path);
+		free(params.jobs[i].message);
+	}
+	free(params.jobs);
+	return ret;
+}
+
+/**
+ * 'resign-batch' command.
+ *
+ * The input can either be a directory, in which case all .wad and .bwf
+ * files in the directory are processed, or a text file listing one WAD
+ * filename per line. Output WADs are written to the output directory
+ * using the same filenames.
+ *
+ * @param in_path	[in] Input directory or list of WAD files.
+ * @param out_dir	[in] Output directory. (Created if it doesn't exist.)
+ * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param output_format	[in] Output format. (-1 for default)
+ * @param jobs		[in] Maximum number of WADs to process at once. (0 for automatic)
+ * @param json_filename	[in,opt] If not NULL, write a JSON summary to this file.
+ * @return 0 if all WADs were processed successfully; 1 if any WADs failed; negative POSIX error code on error.
+ */
+int resign_batch(const TCHAR *in_path, const TCHAR *out_dir, int recrypt_key, int output_format,
+	unsigned int jobs, const TCHAR *json_filename)
+{
+	return run_batch("resign-batch", in_path, out_dir, recrypt_key, output_format, jobs, json_filename);
+}
+
+/**
+ * 'verify-batch' command.
+ *
+ * The input can either be a directory, in which case all .wad and .bwf
+ * files in the directory are processed, or a text file listing one WAD
+ * filename per line.
+ *
+ * @param in_path	[in] Input directory or list of WAD files.
+ * @param jobs		[in] Maximum number of WADs to process at once. (0 for automatic)
+ * @param json_filename	[in,opt] If not NULL, write a JSON summary to this file.
+ * @return 0 if all WADs were verified successfully; 1 if any WADs failed; negative POSIX error code on error.
+ */
+int verify_batch(const TCHAR *in_path, unsigned int jobs, const TCHAR *json_filename)
+{
+	return run_batch("verify-batch", in_path, NULL, -1, -1, jobs, json_filename);
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+ * RVT-H Tool: WAD Resigner                                                *
+ * batch.h: Batch processing of WAD files.                                 *
+ *                                                                         *
+ * Copyright (c) 2018-2020 by David Korth.                                 *
+ * SPDX-License-Identifier: GPL-2.0-or-later                               *
+ ***************************************************************************/
+
+#ifndef __RVTHTOOL_WADRESIGN_BATCH_H__
+#define __RVTHTOOL_WADRESIGN_BATCH_H__
+
+#include "tcharx.h"
+#include "wad-fns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Memory budget for batch processing.
+// The number of WAD files processed at once is limited so
+// the per-job buffers fit within this budget.
+#define BATCH_MEMORY_BUDGET (64*1024*1024)
+
+// Worst-case memory usage for a single job:
+// read buffer, plus the TMD when verifying.
+#define BATCH_JOB_MEMORY (READ_BUFFER_SIZE + WAD_TMD_SIZE_MAX)
+
+/**
+ * 'resign-batch' command.
+ *
+ * The input can either be a directory, in which case all .wad and .bwf
+ * files in the directory are processed, or a text file listing one WAD
+ * filename per line. Output WADs are written to the output directory
+ * using the same filenames.
+ *
+ * @param in_path	[in] Input directory or list of WAD files.
+ * @param out_dir	[in] Output directory. (Created if it doesn't exist.)
+ * @param recrypt_key	[in] Key for recryption. (-1 for default)
+ * @param output_format	[in] Output format. (-1 for default)
+ * @param jobs		[in] Maximum number of WADs to process at once. (0 for automatic)
+ * @param json_filename	[in,opt] If not NULL, write a JSON summary to this file.
+ * @return 0 if all WADs were processed successfully; 1 if any WADs failed; negative POSIX error code on error.
+ */
+int resign_batch(const TCHAR *in_path, const TCHAR *out_dir, int recrypt_key, int output_format,
+	unsigned int jobs, const TCHAR *json_filename);
+
+/**
+ * 'verify-batch' command.
+ *
+ * The input can either be a directory, in which case all .wad and .bwf
+ * files in the directory are processed, or a text file listing one WAD
+ * filename per line.
+ *
+ * @param in_path	[in] Input directory or list of WAD files.
+ * @param jobs		[in] Maximum number of WADs to process at once. (0 for automatic)
+ * @param json_filename	[in,opt] If not NULL, write a JSON summary to this file.
+ * @return 0 if all WADs were verified successfully; 1 if any WADs failed; negative POSIX error code on error.
+ */
+int verify_batch(const TCHAR *in_path, unsigned int jobs, const TCHAR *json_filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RVTHTOOL_WADRESIGN_BATCH_H__ */
@@ -16,6 +16,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
+#include <limits.h>
 
 #include "libwiicrypto/sig_tools.h"
 
@@ -23,6 +24,7 @@
 # include "libwiicrypto/win32/secoptions.h"
 #endif /* _WIN32 */
 
+#include "batch.h"
 #include "print-info.h"
 #include "resign-wad.h"
 
@@ -81,6 +83,16 @@ static void print_help(const TCHAR *argv0)
 		"verify file.wad\n"
 		" - Verify the content hashes.\n"
 		"\n"
+		"resign-batch in_dir out_dir\n"
+		" - Resigns all WADs in in_dir and writes them to out_dir.\n"
+		"   in_dir can also be a text file with one WAD filename per line.\n"
+		"   Multiple WADs are processed in parallel, and a summary\n"
+		"   is shown once all WADs have been processed.\n"
+		"\n"
+		"verify-batch in_dir\n"
+		" - Verify the content hashes of all WADs in in_dir.\n"
+		"   in_dir can also be a text file with one WAD filename per line.\n"
+		"\n"
 		"Options:\n"
 		"\n"
 		"  -k, --recrypt=KEY         Recrypt the WAD using the specified KEY:\n"
@@ -88,6 +100,10 @@ static void print_help(const TCHAR *argv0)
 		"                            Recrypting to retail will use fakesigning.\n"
 		"  -f, --format=FMT          Use the specified format FMT:\n"
 		"                            default, wad, bwf\n"
+		"  -j, --jobs=N              Use up to N threads for verification, or\n"
+		"                            process up to N WADs at once in batch mode.\n"
+		"                            Default is the number of CPUs.\n"
+		"      --json=FILE           Write a JSON summary to FILE in batch mode.\n"
 		"  -h, --help                Display this help and exit.\n"
 		"\n"
 		, stdout);
@@ -107,6 +123,11 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 	// Other values are from WAD_Format_e.
 	int output_format = -1;
 
+	// Number of threads for verification and batch mode.
+	// jobs == 0: Use the number of CPUs.
+	unsigned int jobs = 0;
+	const TCHAR *json_filename = NULL;
+
 	((void)argc);
 	((void)argv);
 
@@ -135,12 +156,14 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 			{_T("recrypt"),	required_argument,	0, _T('k')},
 			{_T("format"),	required_argument,	0, _T('f')},
 			{_T("ndev"),	no_argument,		0, _T('N')},
+			{_T("jobs"),	required_argument,	0, _T('j')},
+			{_T("json"),	required_argument,	0, _T('J')},
 			{_T("help"),	no_argument,		0, _T('h')},
 
 			{NULL, 0, 0, 0}
 		};
 
-		int c = getopt_long(argc, argv, _T("k:f:Nh"), long_options, NULL);
+		int c = getopt_long(argc, argv, _T("k:f:Nj:h"), long_options, NULL);
 		if (c == -1)
 			break;
 
@@ -187,6 +210,23 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 				}
 				break;
 
+			case _T('j'): {
+				// Number of threads for verification and batch mode.
+				TCHAR *endptr = NULL;
+				unsigned long n = (optarg ? _tcstoul(optarg, &endptr, 10) : 0);
+				if (!optarg || *endptr != 0 || n == 0 || n > UINT_MAX) {
+					print_error(argv[0], _T("invalid number of jobs '%s'"), (optarg ? optarg : _T("")));
+					return EXIT_FAILURE;
+				}
+				jobs = (unsigned int)n;
+				break;
+			}
+
+			case _T('J'):
+				// JSON summary for batch mode.
+				json_filename = optarg;
+				break;
+
 			case _T('h'):
 				print_help(argv[0]);
 				return EXIT_SUCCESS;
@@ -220,7 +260,7 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 
 		ret = 0;
 		for (i = optind; i < argc; i++) {
-			ret |= print_wad_info(argv[i], false);
+			ret |= print_wad_info(argv[i], false, jobs, stdout, stderr, NULL);
 		}
 	} else if (!_tcscmp(argv[optind], _T("verify"))) {
 		// Verify a WAD.
@@ -232,7 +272,7 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 
 		ret = 0;
 		for (i = optind+1; i < argc; i++) {
-			ret |= print_wad_info(argv[i], true);
+			ret |= print_wad_info(argv[i], true, jobs, stdout, stderr, NULL);
 		}
 	} else if (!_tcscmp(argv[optind], _T("resign"))) {
 		// Resign a WAD.
@@ -243,7 +283,25 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 			print_error(argv[0], _T("Output WAD filename not specified"));
 			return EXIT_FAILURE;
 		}
-		ret = resign_wad(argv[optind+1], argv[optind+2], recrypt_key, output_format);
+		ret = resign_wad(argv[optind+1], argv[optind+2], recrypt_key, output_format, stdout, stderr, NULL);
+	} else if (!_tcscmp(argv[optind], _T("resign-batch"))) {
+		// Resign a directory of WADs.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("Input directory not specified"));
+			return EXIT_FAILURE;
+		} else if (argc < optind+3) {
+			print_error(argv[0], _T("Output directory not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = resign_batch(argv[optind+1], argv[optind+2], recrypt_key, output_format,
+			jobs, json_filename);
+	} else if (!_tcscmp(argv[optind], _T("verify-batch"))) {
+		// Verify a directory of WADs.
+		if (argc < optind+2) {
+			print_error(argv[0], _T("Input directory not specified"));
+			return EXIT_FAILURE;
+		}
+		ret = verify_batch(argv[optind+1], jobs, json_filename);
 	} else {
 		// If the "command" contains a slash or dot (or backslash on Windows),
 		// assume it's a filename and handle it as 'info'.
@@ -270,7 +328,7 @@ int RVTH_CDECL _tmain(int argc, TCHAR *argv[])
 			int i;
 			ret = 0;
 			for (i = optind; i < argc; i++) {
-				ret |= print_wad_info(argv[i], false);
+				ret |= print_wad_info(argv[i], false, jobs, stdout, stderr, NULL);
 			}
 		} else {
 			// Not a filename.
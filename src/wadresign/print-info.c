@@ -14,20 +14,34 @@
 #include "libwiicrypto/byteswap.h"
 #include "libwiicrypto/cert.h"
 #include "libwiicrypto/sig_tools.h"
+#include "libwiicrypto/threadw.h"
 #include "libwiicrypto/wii_wad.h"
 
 // Nettle SHA-1
 #include <nettle/sha1.h>
 
 // C includes.
+#include <assert.h>
 #include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+# include <windows.h>
+# include <io.h>
+#else /* !_WIN32 */
+# include <sys/types.h>
+# include <unistd.h>
+#endif /* _WIN32 */
+
 #define ISALNUM(c) isalnum((unsigned char)c)
 
+// Maximum number of contents to verify at once.
+// Each content uses one read buffer.
+#define VERIFY_MAX_CONTENT_JOBS 16
+
 typedef union _WAD_Header {
 	Wii_WAD_Header wad;
 	Wii_WAD_Header_BWF bwf;
@@ -110,33 +124,60 @@ const char *identify_wad_type(const uint8_t *buf, size_t buf_len, bool *pIsBWF)
 }
 
 /**
- * Verify a content entry.
+ * Read data from the WAD file at the specified offset.
+ * The file position isn't used, so this can be called
+ * from multiple threads at once.
  * @param f_wad		[in] Opened WAD file.
+ * @param buf		[out] Output buffer.
+ * @param size		[in] Number of bytes to read.
+ * @param offset	[in] Offset in the WAD file.
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int read_at(FILE *f_wad, uint8_t *buf, uint32_t size, int64_t offset)
+{
+#ifdef _WIN32
+	HANDLE hFile = (HANDLE)_get_osfhandle(_fileno(f_wad));
+	OVERLAPPED ov;
+	DWORD dwRead;
+
+	memset(&ov, 0, sizeof(ov));
+	ov.Offset = (DWORD)offset;
+	ov.OffsetHigh = (DWORD)(offset >> 32);
+	if (!ReadFile(hFile, buf, size, &dwRead, &ov) || dwRead != size) {
+		return -EIO;
+	}
+	return 0;
+#else /* !_WIN32 */
+	while (size > 0) {
+		ssize_t ret = pread(fileno(f_wad), buf, size, (off_t)offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		} else if (ret == 0) {
+			// Short read.
+			return -EIO;
+		}
+		buf += ret;
+		size -= (uint32_t)ret;
+		offset += ret;
+	}
+	return 0;
+#endif /* _WIN32 */
+}
+
+/**
+ * Decrypt a ticket's title key.
  * @param encKey	[in] Encryption key.
  * @param ticket	[in] Ticket.
- * @param content	[in] Content entry.
- * @param content_addr	[in] Content address.
- * @return 0 if the content is verified; 1 if not; negative POSIX error code on error.
+ * @param title_key	[out] Decrypted title key.
+ * @return 0 on success; negative POSIX error code on error.
  */
-static int verify_content(FILE *f_wad, RVL_AES_Keys_e encKey,
-	const RVL_Ticket *ticket, const RVL_Content_Entry *content,
-	uint32_t content_addr)
+static int decrypt_title_key(RVL_AES_Keys_e encKey, const RVL_Ticket *ticket, uint8_t title_key[16])
 {
-	int ret = 0;
-	size_t size;
-
-	struct sha1_ctx sha1;
 	uint8_t iv[16];
-	uint8_t title_key[16];
-	uint32_t data_sz;
-
-	// AES context.
 	AesCtx *aesw;
 
-	uint8_t *buf = NULL;	// 1 MB buffer
-	uint8_t digest[SHA1_DIGEST_SIZE];
-
-	// TODO: Pass in an aesw context for less overhead.
 	errno = 0;
 	aesw = aesw_new();
 	if (!aesw) {
@@ -152,96 +193,149 @@ static int verify_content(FILE *f_wad, RVL_AES_Keys_e encKey,
 	memset(&iv[8], 0, 8);
 
 	// Decrypt the title key with the common key.
-	memcpy(title_key, ticket->enc_title_key, sizeof(title_key));
+	memcpy(title_key, ticket->enc_title_key, 16);
 	aesw_set_key(aesw, RVL_AES_Keys[encKey], sizeof(RVL_AES_Keys[encKey]));
 	aesw_set_iv(aesw, iv, sizeof(iv));
-	aesw_decrypt(aesw, title_key, sizeof(title_key));
+	aesw_decrypt(aesw, title_key, 16);
+	aesw_free(aesw);
+	return 0;
+}
 
-	// Set the title key and new IV.
-	// IV is the 2-byte content index, followed by zeroes.
-	memcpy(iv, &content->index, 2);
-	memset(&iv[2], 0, 14);
-	aesw_set_key(aesw, title_key, sizeof(title_key));
-	aesw_set_iv(aesw, iv, sizeof(iv));
+/**
+ * Verify a content entry.
+ * @param f_wad		[in] Opened WAD file.
+ * @param title_key	[in] Decrypted title key.
+ * @param content	[in] Content entry.
+ * @param content_addr	[in] Content address.
+ * @param digest	[out] SHA-1 of the decrypted content.
+ * @return 0 if the SHA-1 was calculated; negative POSIX error code on error.
+ */
+static int verify_content(FILE *f_wad, const uint8_t title_key[16],
+	const RVL_Content_Entry *content, uint32_t content_addr,
+	uint8_t digest[SHA1_DIGEST_SIZE])
+{
+	AesCtx *aesw;
+	struct sha1_ctx sha1;
+	uint8_t iv[16];
+	uint8_t *buf;
+	uint32_t data_sz, offset;
+	int ret = 0;
+
+	errno = 0;
+	aesw = aesw_new();
+	if (!aesw) {
+		ret = -errno;
+		if (ret == 0) {
+			ret = -EIO;
+		}
+		return ret;
+	}
 
-	// Allocate memory.
 	buf = malloc(READ_BUFFER_SIZE);
 	if (!buf) {
 		aesw_free(aesw);
 		return -ENOMEM;
 	}
 
+	// Set the title key and IV.
+	// IV is the 2-byte content index, followed by zeroes.
+	memcpy(iv, &content->index, 2);
+	memset(&iv[2], 0, 14);
+	aesw_set_key(aesw, title_key, 16);
+	aesw_set_iv(aesw, iv, sizeof(iv));
+
 	// Read the content, decrypt it, and hash it.
-	// TODO: Verify size; check fseeko() errors.
 	sha1_init(&sha1);
 	data_sz = (uint32_t)be64_to_cpu(content->size);
-	fseeko(f_wad, content_addr, SEEK_SET);
-	for (; data_sz >= READ_BUFFER_SIZE; data_sz -= READ_BUFFER_SIZE) {
-		errno = 0;
-		size = fread(buf, 1, READ_BUFFER_SIZE, f_wad);
-		if (size != READ_BUFFER_SIZE) {
-			ret = errno;
-			if (ret == 0) {
-				ret = -EIO;
-			}
-			goto end;
+	for (offset = 0; offset < data_sz; offset += READ_BUFFER_SIZE) {
+		uint32_t size = data_sz - offset;
+		if (size > READ_BUFFER_SIZE) {
+			size = READ_BUFFER_SIZE;
 		}
 
-		// Decrypt the data.
-		aesw_decrypt(aesw, buf, READ_BUFFER_SIZE);
-
-		// Update the SHA-1.
-		sha1_update(&sha1, READ_BUFFER_SIZE, buf);
-	}
-
-	// Remaining data.
-	if (data_sz > 0) {
 		// NOTE: AES works on 16-byte blocks, so we have to
-		// read and decrypt the full 16-byte block. The SHA-1
-		// is only taken for the actual used data, though.
-		uint32_t data_sz_align = ALIGN_BYTES(16, data_sz);
-
-		errno = 0;
-		size = fread(buf, 1, data_sz_align, f_wad);
-		if (size != data_sz_align) {
-			ret = errno;
-			if (ret == 0) {
-				ret = -EIO;
-			}
-			goto end;
+		// read and decrypt the full 16-byte block. The
+		// SHA-1 is of the actual data, though.
+		// NOTE 2: READ_BUFFER_SIZE is a multiple of 16,
+		// so only the last chunk might not be aligned.
+		ret = read_at(f_wad, buf, ALIGN_BYTES(16, size), (int64_t)content_addr + offset);
+		if (ret != 0) {
+			break;
 		}
+		// CBC state carries over from the previous chunk.
+		aesw_decrypt(aesw, buf, ALIGN_BYTES(16, size));
+		sha1_update(&sha1, size, buf);
+	}
+	if (ret == 0) {
+		sha1_digest(&sha1, SHA1_DIGEST_SIZE, digest);
+	}
 
-		// Decrypt the data.
-		aesw_decrypt(aesw, buf, data_sz_align);
+	free(buf);
+	aesw_free(aesw);
+	return ret;
+}
 
-		// Update the SHA-1.
-		// NOTE: Only uses the actual content, not the
-		// aligned data required for decryption.
-		sha1_update(&sha1, data_sz, buf);
-	}
+/**
+ * Content verification result.
+ */
+typedef struct _VerifyResult {
+	int ret;				// verify_content() return value
+	uint8_t digest[SHA1_DIGEST_SIZE];	// SHA-1 of the decrypted content
+} VerifyResult;
+
+/**
+ * Parameters for verifying contents in parallel.
+ */
+typedef struct _VerifyParams {
+	FILE *f_wad;
+	const uint8_t *title_key;
+	const RVL_Content_Entry *contents;
+	const uint32_t *content_addrs;
+	VerifyResult *results;
+} VerifyParams;
+
+/**
+ * Verify a content entry.
+ * Called by threadw_parallel_for().
+ * @param index		[in] Content table index.
+ * @param userdata	[in] VerifyParams
+ */
+static void verify_content_worker(unsigned int index, void *userdata)
+{
+	const VerifyParams *const params = (const VerifyParams*)userdata;
+	VerifyResult *const result = &params->results[index];
+	result->ret = verify_content(params->f_wad, params->title_key,
+		&params->contents[index], params->content_addrs[index],
+		result->digest);
+}
+
+/**
+ * Print a content's SHA-1 and compare it to the TMD.
+ * @param content	[in] Content entry.
+ * @param digest	[in] SHA-1 of the decrypted content.
+ * @param f_out		[in] Output stream.
+ * @return 0 if the SHA-1 matches; 1 if it doesn't.
+ */
+static int print_content_sha1(const RVL_Content_Entry *content,
+	const uint8_t digest[SHA1_DIGEST_SIZE], FILE *f_out)
+{
+	size_t i;
 
-	// Finalize the SHA-1 and compare it.
-	sha1_digest(&sha1, sizeof(digest), digest);
-	fputs("- Expected SHA-1: ", stdout);
-	for (size = 0; size < sizeof(content->sha1_hash); size++) {
-		printf("%02x", content->sha1_hash[size]);
+	fputs("- Expected SHA-1: ", f_out);
+	for (i = 0; i < sizeof(content->sha1_hash); i++) {
+		fprintf(f_out, "%02x", content->sha1_hash[i]);
 	}
-	putchar('\n');
-	printf("- Actual SHA-1:   ");
-	for (size = 0; size < sizeof(digest); size++) {
-		printf("%02x", digest[size]);
+	fputc('\n', f_out);
+	fprintf(f_out, "- Actual SHA-1:   ");
+	for (i = 0; i < SHA1_DIGEST_SIZE; i++) {
+		fprintf(f_out, "%02x", digest[i]);
 	}
 	if (!memcmp(digest, content->sha1_hash, SHA1_DIGEST_SIZE)) {
-		fputs(" [OK]\n", stdout);
-	} else {
-		fputs(" [ERROR]\n", stdout);
-		ret = 1;
+		fputs(" [OK]\n", f_out);
+		return 0;
 	}
-
-end:
-	free(buf);
-	aesw_free(aesw);
-	return ret;
+	fputs(" [ERROR]\n", f_out);
+	return 1;
 }
 
 /**
@@ -249,9 +343,14 @@ end:
  * @param f_wad		[in] Opened WAD file.
  * @param wad_filename	[in] WAD filename. (for error messages)
  * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
+int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify, unsigned int jobs,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status)
 {
 	int ret;
 	size_t size;
@@ -282,19 +381,26 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	const char *s_invalidKey = NULL;
 
 	// Contents.
-	unsigned int nbr_cont, nbr_cont_actual;
+	unsigned int nbr_cont, nbr_cont_actual, i;
 	uint16_t boot_index;
-	const RVL_Content_Entry *content;
+	const RVL_Content_Entry *contents;
 	uint32_t content_addr;
+	uint32_t *content_addrs = NULL;
+	VerifyResult *results = NULL;
 
 	// Read the WAD header.
 	rewind(f_wad);
+	errno = 0;
 	size = fread(&header, 1, sizeof(header), f_wad);
 	if (size != sizeof(header)) {
 		int err = errno;
-		fputs("*** ERROR reading WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "': %s\n", strerror(err));
+		if (err == 0) {
+			err = EIO;
+		}
+		fputs("*** ERROR reading WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "': %s\n", strerror(err));
+		wad_status_add(status, "Error reading WAD file: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -304,9 +410,10 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	s_wad_type = identify_wad_type((const uint8_t*)&header, sizeof(header), &isBWF);
 	if (!s_wad_type) {
 		// Unrecognized WAD type.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' is not valid.\n");
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' is not valid.\n");
+		wad_status_add(status, "WAD file is not valid.");
 		ret = 1;
 		goto end;
 	}
@@ -319,41 +426,46 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	}
 	if (ret != 0) {
 		// Unable to get WAD information.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' is not valid.");
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' is not valid.");
+		wad_status_add(status, "WAD file is not valid.");
 		ret = 2;
 		goto end;
 	}
 
 	// Verify the ticket and TMD sizes.
 	if (wadInfo.ticket_size < sizeof(RVL_Ticket)) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' ticket size is too small. (%u; should be %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' ticket size is too small. (%u; should be %u)\n",
 			wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
+		wad_status_add(status, "Ticket size is too small. (%u; should be %u)", wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
 		ret = 3;
 		goto end;
 	} else if (wadInfo.ticket_size > WAD_TICKET_SIZE_MAX) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' ticket size is too big. (%u; should be %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' ticket size is too big. (%u; should be %u)\n",
 			wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
+		wad_status_add(status, "Ticket size is too big. (%u; should be %u)", wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
 		ret = 4;
 		goto end;
 	} else if (wadInfo.tmd_size < sizeof(RVL_TMD_Header)) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' TMD size is too small. (%u; should be at least %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' TMD size is too small. (%u; should be at least %u)\n",
 			wadInfo.tmd_size, (uint32_t)sizeof(RVL_TMD_Header));
+		wad_status_add(status, "TMD size is too small. (%u; should be at least %u)", wadInfo.tmd_size, (uint32_t)sizeof(RVL_TMD_Header));
 		ret = 5;
 		goto end;
 	} else if (wadInfo.tmd_size > WAD_TMD_SIZE_MAX) {
 		// Too big.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' TMD size is too big. (%u; should be less than 1 MB)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' TMD size is too big. (%u; should be less than 1 MB)\n",
 			wadInfo.tmd_size);
+		wad_status_add(status, "TMD size is too big. (%u; should be less than 1 MB)", wadInfo.tmd_size);
 		ret = 6;
 		goto end;
 	}
@@ -361,7 +473,8 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	// Load the ticket and TMD.
 	ticket_u8 = malloc(wadInfo.ticket_size);
 	if (!ticket_u8) {
-		fprintf(stderr, "*** ERROR: Unable to allocate %u bytes for the ticket.\n", wadInfo.ticket_size);
+		fprintf(f_err, "*** ERROR: Unable to allocate %u bytes for the ticket.\n", wadInfo.ticket_size);
+		wad_status_add(status, "Unable to allocate %u bytes for the ticket.", wadInfo.ticket_size);
 		ret = 7;
 		goto end;
 	}
@@ -369,9 +482,10 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	size = fread(ticket_u8, 1, wadInfo.ticket_size, f_wad);
 	if (size != wadInfo.ticket_size) {
 		// Read error.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fputs("': Unable to read the ticket.\n", stderr);
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fputs("': Unable to read the ticket.\n", f_err);
+		wad_status_add(status, "Unable to read the ticket.");
 		ret = 8;
 		goto end;
 	}
@@ -379,7 +493,8 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 
 	tmd_u8 = malloc(wadInfo.tmd_size);
 	if (!tmd_u8) {
-		fprintf(stderr, "*** ERROR: Unable to allocate %u bytes for the TMD.\n", wadInfo.tmd_size);
+		fprintf(f_err, "*** ERROR: Unable to allocate %u bytes for the TMD.\n", wadInfo.tmd_size);
+		wad_status_add(status, "Unable to allocate %u bytes for the TMD.", wadInfo.tmd_size);
 		ret = 9;
 		goto end;
 	}
@@ -387,18 +502,19 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	size = fread(tmd_u8, 1, wadInfo.tmd_size, f_wad);
 	if (size != wadInfo.tmd_size) {
 		// Read error.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fputs("': Unable to read the TMD.\n", stderr);
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fputs("': Unable to read the TMD.\n", f_err);
+		wad_status_add(status, "Unable to read the TMD.");
 		ret = 10;
 		goto end;
 	}
 	tmdHeader = (const RVL_TMD_Header*)tmd_u8;
 
 	// NOTE: Using TMD for most information.
-	_tprintf(_T("%s:\n"), wad_filename);
-	printf("Type: %s\n", s_wad_type);
-	printf("- Title ID:      %08X-%08X\n", be32_to_cpu(tmdHeader->title_id.hi), be32_to_cpu(tmdHeader->title_id.lo));
+	_ftprintf(f_out, _T("%s:\n"), wad_filename);
+	fprintf(f_out, "Type: %s\n", s_wad_type);
+	fprintf(f_out, "- Title ID:      %08X-%08X\n", be32_to_cpu(tmdHeader->title_id.hi), be32_to_cpu(tmdHeader->title_id.lo));
 
 	// Game ID, but only if all characters are alphanumeric.
 	if (ISALNUM(tmdHeader->title_id.u8[4]) &&
@@ -406,13 +522,13 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 	    ISALNUM(tmdHeader->title_id.u8[6]) &&
 	    ISALNUM(tmdHeader->title_id.u8[7]))
 	{
-		printf("- Game ID:       %.4s\n",
+		fprintf(f_out, "- Game ID:       %.4s\n",
 			(const char*)&tmdHeader->title_id.u8[4]);
 	}
 
 	// Title version
 	title_version = be16_to_cpu(tmdHeader->title_version);
-	printf("- Title version: %u.%u (v%u)\n",
+	fprintf(f_out, "- Title version: %u.%u (v%u)\n",
 		title_version >> 8, title_version & 0xFF, title_version);
 
 	// IOS version
@@ -423,7 +539,7 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 			ios_version = (uint8_t)ios_tid_lo;
 		}
 	}
-	printf("- IOS version:   %u\n", ios_version);
+	fprintf(f_out, "- IOS version:   %u\n", ios_version);
 
 	// Determine the encryption key in use.
 	issuer_ticket = cert_get_issuer_from_name(ticket->issuer);
@@ -480,101 +596,161 @@ int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify)
 			}
 			break;
 	}
-	printf("- Encryption:    %s\n", s_encKey);
+	fprintf(f_out, "- Encryption:    %s\n", s_encKey);
 
 	// Check the ticket issuer and signature.
 	s_issuer_ticket = issuer_type(issuer_ticket);
 	sig_status_ticket = sig_verify(ticket_u8, wadInfo.ticket_size);
-	printf("- Ticket Signature: %s%s\n",
+	fprintf(f_out, "- Ticket Signature: %s%s\n",
 		s_issuer_ticket, RVL_SigStatus_toString_stsAppend(sig_status_ticket));
 
 	// Check the TMD issuer and signature.
 	s_issuer_tmd = issuer_type(cert_get_issuer_from_name(tmdHeader->issuer));
 	sig_status_tmd = sig_verify(tmd_u8, wadInfo.tmd_size);
-	printf("- TMD Signature:    %s%s\n",
+	fprintf(f_out, "- TMD Signature:    %s%s\n",
 		s_issuer_tmd, RVL_SigStatus_toString_stsAppend(sig_status_tmd));
 
-	putchar('\n');
+	fputc('\n', f_out);
 
 	if (wadInfo.ticket_size > sizeof(RVL_Ticket)) {
-		fputs("*** WARNING: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "' ticket size is too big. (%u; should be %u)\n\n",
+		fputs("*** WARNING: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "' ticket size is too big. (%u; should be %u)\n\n",
 			wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
 	}
 	if (s_invalidKey) {
 		// Invalid common key index for retail.
 		// NOTE: A good number of retail WADs have an
 		// incorrect common key index for some reason.
-		fputs("*** WARNING: WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "': Invalid common key index %u.\n",
+		fputs("*** WARNING: WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "': Invalid common key index %u.\n",
 			ticket->common_key_index);
-		fprintf(stderr, "*** Assuming %s common key based on game ID.\n\n", s_invalidKey);
+		fprintf(f_err, "*** Assuming %s common key based on game ID.\n\n", s_invalidKey);
 	}
 
 	// Print the contents.
-	fputs("Contents:\n", stderr);
+	fputs("Contents:\n", f_err);
 	nbr_cont = be16_to_cpu(tmdHeader->nbr_cont);
 	boot_index = be16_to_cpu(tmdHeader->boot_index);
 
 	// Make sure the TMD is big enough.
 	// TODO: Show an error if it's not?
-	content = (const RVL_Content_Entry*)(&tmd_u8[sizeof(*tmdHeader)]);
-	nbr_cont_actual = (wadInfo.tmd_size - sizeof(*tmdHeader)) / sizeof(*content);
+	contents = (const RVL_Content_Entry*)(&tmd_u8[sizeof(*tmdHeader)]);
+	nbr_cont_actual = (wadInfo.tmd_size - sizeof(*tmdHeader)) / sizeof(*contents);
 	if (nbr_cont > nbr_cont_actual) {
 		nbr_cont = nbr_cont_actual;
 	}
 
+	// Get the content addresses.
 	// TODO: Validate against data_size.
+	content_addrs = malloc((nbr_cont + 1) * sizeof(*content_addrs));
+	if (!content_addrs) {
+		ret = -ENOMEM;
+		goto end;
+	}
 	content_addr = wadInfo.data_address;
+	for (i = 0; i < nbr_cont; i++) {
+		content_addrs[i] = content_addr;
+		content_addr += (uint32_t)be64_to_cpu(contents[i].size);
+		if (likely(!isBWF)) {
+			content_addr = ALIGN_BYTES(64, content_addr);
+		}
+	}
+
+	if (verify && nbr_cont > 0) {
+		// Verify the contents in parallel.
+		// The results are printed in TMD order below.
+		VerifyParams params;
+		uint8_t title_key[16];
+		unsigned int content_jobs;
+
+		results = calloc(nbr_cont, sizeof(*results));
+		if (!results) {
+			ret = -ENOMEM;
+			goto end;
+		}
+		ret = decrypt_title_key(encKey, ticket, title_key);
+		if (ret != 0) {
+			goto end;
+		}
+
+		if (jobs == 0) {
+			jobs = threadw_cpu_count();
+		}
+		content_jobs = (jobs < nbr_cont ? jobs : nbr_cont);
+		if (content_jobs > VERIFY_MAX_CONTENT_JOBS) {
+			content_jobs = VERIFY_MAX_CONTENT_JOBS;
+		}
+
+		params.f_wad = f_wad;
+		params.title_key = title_key;
+		params.contents = contents;
+		params.content_addrs = content_addrs;
+		params.results = results;
+		ret = threadw_parallel_for(nbr_cont, content_jobs, verify_content_worker, &params);
+		if (ret != 0) {
+			goto end;
+		}
+	}
+
 	ret = 0;
-	for (; nbr_cont > 0; nbr_cont--, content++) {
+	for (i = 0; i < nbr_cont; i++) {
+		const RVL_Content_Entry *const content = &contents[i];
+
 		// TODO: Show the actual table index, or just the
 		// index field in the entry?
 		uint16_t content_index = be16_to_cpu(content->index);
-		printf("#%d: ID=%08x, type=%04X, size=%u",
+		fprintf(f_out, "#%d: ID=%08x, type=%04X, size=%u",
 			be16_to_cpu(content->index),
 			be32_to_cpu(content->content_id),
 			be16_to_cpu(content->type),
 			(uint32_t)be64_to_cpu(content->size));
 		if (content_index == boot_index) {
-			fputs(", bootable", stdout);
+			fputs(", bootable", f_out);
 		}
-		putchar('\n');
+		fputc('\n', f_out);
 
 		if (verify) {
-			// Verify the content.
-			// TODO: Only decrypt the title key once?
-			// TODO: Return failure if any contents fail.
-			int vret = verify_content(f_wad, encKey, ticket, content, content_addr);
+			// Check the content's SHA-1.
+			int vret = results[i].ret;
+			if (vret != 0) {
+				fprintf(f_err, "*** ERROR reading content #%d: %s\n",
+					content_index, strerror(-vret));
+				wad_status_add(status, "Error reading content #%d: %s", content_index, strerror(-vret));
+				ret = 1;
+				continue;
+			}
+
+			vret = print_content_sha1(content, results[i].digest, f_out);
 			if (vret != 0) {
+				wad_status_add(status, "#%d: SHA-1 mismatch", content_index);
 				if (ret == 0 && encKey == vWii_KEY_RETAIL) {
 					// Check if this might be valid with the retail common key.
-					vret = verify_content(f_wad, RVL_KEY_RETAIL, ticket, content, content_addr);
-					if (vret == 0) {
+					uint8_t title_key[16];
+					uint8_t digest[SHA1_DIGEST_SIZE];
+					if (decrypt_title_key(RVL_KEY_RETAIL, ticket, title_key) == 0 &&
+					    verify_content(f_wad, title_key, content, content_addrs[i], digest) == 0 &&
+					    print_content_sha1(content, digest, f_out) == 0)
+					{
 						vWii_crypt_error = true;
 					}
 				}
 				ret = 1;
 			}
 		}
-
-		// Next content.
-		content_addr += (uint32_t)be64_to_cpu(content->size);
-		if (likely(!isBWF)) {
-			content_addr = ALIGN_BYTES(64, content_addr);
-		}
 	}
-	putchar('\n');
+	fputc('\n', f_out);
 
 	if (vWii_crypt_error) {
-		printf("*** WARNING: This WAD file should be encrypted using the vWii common\n"
+		fprintf(f_out, "*** WARNING: This WAD file should be encrypted using the vWii common\n"
 		       "    key, but it's actually encrypted with the retail common key.\n");
 		// FIXME: Add a way to fix this and indicate how to fix it.
 	}
 
 end:
+	free(results);
+	free(content_addrs);
 	free(ticket_u8);
 	free(tmd_u8);
 	return ret;
@@ -584,9 +760,14 @@ end:
  * 'info' command.
  * @param wad_filename	[in] WAD filename.
  * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_wad_info(const TCHAR *wad_filename, bool verify)
+int print_wad_info(const TCHAR *wad_filename, bool verify, unsigned int jobs,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status)
 {
 	int ret;
 
@@ -594,14 +775,15 @@ int print_wad_info(const TCHAR *wad_filename, bool verify)
 	FILE *f_wad = _tfopen(wad_filename, _T("rb"));
 	if (!f_wad) {
 		int err = errno;
-		fputs("*** ERROR opening WAD file '", stderr);
-		_fputts(wad_filename, stderr);
-		fprintf(stderr, "': %s\n", strerror(err));
+		fputs("*** ERROR opening WAD file '", f_err);
+		_fputts(wad_filename, f_err);
+		fprintf(f_err, "': %s\n", strerror(err));
+		wad_status_add(status, "Error opening WAD file: %s", strerror(err));
 		return -err;
 	}
 
 	// Print the WAD info.
-	ret = print_wad_info_FILE(f_wad, wad_filename, verify);
+	ret = print_wad_info_FILE(f_wad, wad_filename, verify, jobs, f_out, f_err, status);
 	fclose(f_wad);
 	return ret;
 }
@@ -13,6 +13,7 @@
 #include <stdio.h>
 
 #include "tcharx.h"
+#include "wad-fns.h"
 
 // TODO: Custom stdbool.x instead of libwiicrypto/common.h.
 #include "libwiicrypto/cert_store.h"
@@ -40,17 +41,27 @@ const char *identify_wad_type(const uint8_t *buf, size_t buf_len, bool *pIsBWF);
  * @param f_wad		[in] Opened WAD file.
  * @param wad_filename	[in] WAD filename. (for error messages)
  * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify);
+int print_wad_info_FILE(FILE *f_wad, const TCHAR *wad_filename, bool verify, unsigned int jobs,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status);
 
 /**
  * 'info' command.
  * @param wad_filename	[in] WAD filename.
  * @param verify	[in] If true, verify the contents.
+ * @param jobs		[in] Maximum number of threads for verification. (0 for the number of CPUs)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int print_wad_info(const TCHAR *wad_filename, bool verify);
+int print_wad_info(const TCHAR *wad_filename, bool verify, unsigned int jobs,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status);
 
 #ifdef __cplusplus
 }
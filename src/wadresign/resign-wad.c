@@ -6,6 +6,8 @@
  * SPDX-License-Identifier: GPL-2.0-or-later                               *
  ***************************************************************************/
 
+#include "config.wadresign.h"
+
 #include "resign-wad.h"
 #include "print-info.h"
 #include "wad-fns.h"
@@ -26,6 +28,14 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+# include <sys/types.h>
+# include <unistd.h>
+#endif /* !_WIN32 */
+#ifdef HAVE_SENDFILE
+# include <sys/sendfile.h>
+#endif /* HAVE_SENDFILE */
+
 #define ISALNUM(c) isalnum((unsigned char)c)
 
 typedef union _WAD_Header {
@@ -53,15 +63,133 @@ static inline void fpAlign(FILE *fp)
 	}
 }
 
+/**
+ * Check if an error from copy_file_range() or sendfile() means
+ * in-kernel copying isn't supported for these files.
+ * @param err POSIX error code.
+ * @return True if the copy should be retried using another method.
+ */
+static inline bool is_copy_unsupported(int err)
+{
+	// NOTE: EOPNOTSUPP may be equal to ENOTSUP.
+	return (err == ENOSYS || err == EXDEV || err == EINVAL ||
+		err == EOPNOTSUPP || err == ENOTSUP);
+}
+
+/**
+ * Copy a section of the source WAD to the destination WAD.
+ *
+ * Resigning doesn't modify the contents, so the section is copied
+ * in the kernel if possible. copy_file_range() may share the data
+ * blocks on copy-on-write file systems; sendfile() at least avoids
+ * copying the data through userspace. Otherwise, stdio is used.
+ *
+ * On return, the destination file pointer is at the end of the section.
+ *
+ * @param f_dest	[in] Destination WAD.
+ * @param f_src		[in] Source WAD.
+ * @param src_offset	[in] Starting offset in the source WAD.
+ * @param size		[in] Number of bytes to copy.
+ * @param buf		[in] Read buffer. (for stdio)
+ * @return 0 on success; negative POSIX error code on error.
+ */
+static int copy_wad_section(FILE *f_dest, FILE *f_src, int64_t src_offset, uint32_t size, rdbuf_t *buf)
+{
+	int64_t dest_offset;
+	uint32_t copied = 0;
+	size_t sz;
+
+	// Flush the destination so the file descriptor can be used directly.
+	if (fflush(f_dest) != 0) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+	dest_offset = ftello(f_dest);
+	if (dest_offset < 0) {
+		return (errno != 0 ? -errno : -EIO);
+	}
+
+#ifdef HAVE_COPY_FILE_RANGE
+	{
+		loff_t off_in = src_offset;
+		loff_t off_out = dest_offset;
+		while (copied < size) {
+			ssize_t ret = copy_file_range(fileno(f_src), &off_in,
+				fileno(f_dest), &off_out, size - copied, 0);
+			if (ret > 0) {
+				copied += (uint32_t)ret;
+			} else if (ret == 0) {
+				// Source WAD is too short.
+				return -EIO;
+			} else if (errno != EINTR) {
+				if (!is_copy_unsupported(errno)) {
+					return -errno;
+				}
+				break;
+			}
+		}
+	}
+#endif /* HAVE_COPY_FILE_RANGE */
+
+#ifdef HAVE_SENDFILE
+	if (copied < size) {
+		// sendfile() writes at the destination's file position.
+		off_t off_in = (off_t)(src_offset + copied);
+		if (lseek(fileno(f_dest), (off_t)(dest_offset + copied), SEEK_SET) < 0) {
+			return -errno;
+		}
+		while (copied < size) {
+			ssize_t ret = sendfile(fileno(f_dest), fileno(f_src), &off_in, size - copied);
+			if (ret > 0) {
+				copied += (uint32_t)ret;
+			} else if (ret == 0) {
+				// Source WAD is too short.
+				return -EIO;
+			} else if (errno != EINTR) {
+				if (!is_copy_unsupported(errno)) {
+					return -errno;
+				}
+				break;
+			}
+		}
+	}
+#endif /* HAVE_SENDFILE */
+
+	// Copy anything that's left using stdio, one megabyte at a time.
+	if (fseeko(f_dest, dest_offset + copied, SEEK_SET) != 0 ||
+	    fseeko(f_src, src_offset + copied, SEEK_SET) != 0)
+	{
+		return (errno != 0 ? -errno : -EIO);
+	}
+	for (; copied < size; copied += (uint32_t)sz) {
+		sz = size - copied;
+		if (sz > sizeof(buf->u8)) {
+			sz = sizeof(buf->u8);
+		}
+
+		errno = 0;
+		if (fread(buf->u8, 1, sz, f_src) != sz ||
+		    fwrite(buf->u8, 1, sz, f_dest) != sz)
+		{
+			return (errno != 0 ? -errno : -EIO);
+		}
+	}
+
+	return 0;
+}
+
 /**
  * 'resign' command.
  * @param src_wad	[in] Source WAD.
  * @param dest_wad	[in] Destination WAD.
  * @param recrypt_key	[in] Key for recryption. (-1 for default)
  * @param output_format	[in] Output format. (-1 for default)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int output_format)
+int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int output_format,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status)
 {
 	int ret;
 	size_t size;
@@ -105,18 +233,19 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fputs("*** ERROR opening source WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "': %s\n", strerror(err));
+		fputs("*** ERROR opening source WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "': %s\n", strerror(err));
+		wad_status_add(status, "Error opening source WAD file: %s", strerror(err));
 		return -err;
 	}
 
 	// Print the WAD information.
 	// TODO: Should we verify the SHA-1s?
-	ret = print_wad_info_FILE(f_src_wad, src_wad, false);
+	ret = print_wad_info_FILE(f_src_wad, src_wad, false, 1, f_out, f_err, status);
 	if (ret != 0) {
 		// Error printing the WAD information.
-		return ret;
+		goto end;
 	}
 
 	// Re-read the WAD header and parse the addresses.
@@ -128,9 +257,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fputs("*** ERROR reading WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "': %s\n", strerror(err));
+		fputs("*** ERROR reading WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "': %s\n", strerror(err));
+		wad_status_add(status, "Error reading WAD file: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -141,9 +271,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	// it's a BroadOn WAD or not.
 	if (identify_wad_type((const uint8_t*)&srcHeader, sizeof(srcHeader), &isSrcBwf) == NULL) {
 		// Unrecognized WAD type.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' is not valid.\n");
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' is not valid.\n");
+		wad_status_add(status, "WAD file is not valid.");
 		ret = 1;
 		goto end;
 	}
@@ -156,49 +287,55 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	}
 	if (ret != 0) {
 		// Unable to get WAD information.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' is not valid.");
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' is not valid.");
+		wad_status_add(status, "WAD file is not valid.");
 		ret = 2;
 		goto end;
 	}
 
 	// Verify the various sizes.
 	if (wadInfo.ticket_size < sizeof(RVL_Ticket)) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' ticket size is too small. (%u; should be %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' ticket size is too small. (%u; should be %u)\n",
 			wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
+		wad_status_add(status, "Ticket size is too small. (%u; should be %u)", wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
 		ret = 3;
 		goto end;
 	} else if (wadInfo.ticket_size > WAD_TICKET_SIZE_MAX) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' ticket size is too big. (%u; should be %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' ticket size is too big. (%u; should be %u)\n",
 			wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
+		wad_status_add(status, "Ticket size is too big. (%u; should be %u)", wadInfo.ticket_size, (uint32_t)sizeof(RVL_Ticket));
 		ret = 4;
 		goto end;
 	} else if (wadInfo.tmd_size < sizeof(RVL_TMD_Header)) {
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' TMD size is too small. (%u; should be at least %u)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' TMD size is too small. (%u; should be at least %u)\n",
 			wadInfo.tmd_size, (uint32_t)sizeof(RVL_TMD_Header));
+		wad_status_add(status, "TMD size is too small. (%u; should be at least %u)", wadInfo.tmd_size, (uint32_t)sizeof(RVL_TMD_Header));
 		ret = 5;
 		goto end;
 	} else if (wadInfo.tmd_size > WAD_TMD_SIZE_MAX) {
 		// Too big.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' TMD size is too big. (%u; should be less than 1 MB)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' TMD size is too big. (%u; should be less than 1 MB)\n",
 			wadInfo.tmd_size);
+		wad_status_add(status, "TMD size is too big. (%u; should be less than 1 MB)", wadInfo.tmd_size);
 		ret = 6;
 		goto end;
 	} else if (wadInfo.meta_size > WAD_META_SIZE_MAX) {
 		// Too big.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' metadata size is too big. (%u; should be less than 1 MB)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' metadata size is too big. (%u; should be less than 1 MB)\n",
 			wadInfo.meta_size);
+		wad_status_add(status, "Metadata size is too big. (%u; should be less than 1 MB)", wadInfo.meta_size);
 		ret = 7;
 		goto end;
 	}
@@ -210,9 +347,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		// Data size is the rest of the file.
 		if (src_file_size < wadInfo.data_address) {
 			// Not valid...
-			fputs("*** ERROR: WAD file '", stderr);
-			_fputts(src_wad, stderr);
-			fputs("' data size is invalid.\n", stderr);
+			fputs("*** ERROR: WAD file '", f_err);
+			_fputts(src_wad, f_err);
+			fputs("' data size is invalid.\n", f_err);
+			wad_status_add(status, "Data size is invalid.");
 			ret = 8;
 			goto end;
 		}
@@ -221,16 +359,18 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		// Verify the data size.
 		if (src_file_size < wadInfo.data_address) {
 			// File is too small.
-			fputs("*** ERROR: WAD file '", stderr);
-			_fputts(src_wad, stderr);
-			fputs("' data address is invalid.\n", stderr);
+			fputs("*** ERROR: WAD file '", f_err);
+			_fputts(src_wad, f_err);
+			fputs("' data address is invalid.\n", f_err);
+			wad_status_add(status, "Data address is invalid.");
 			ret = 9;
 			goto end;
 		} else if (src_file_size - wadInfo.data_address < wadInfo.data_size) {
 			// Data size is too small.
-			fputs("*** ERROR: WAD file '", stderr);
-			_fputts(src_wad, stderr);
-			fputs("' data size is invalid.\n", stderr);
+			fputs("*** ERROR: WAD file '", f_err);
+			_fputts(src_wad, f_err);
+			fputs("' data size is invalid.\n", f_err);
+			wad_status_add(status, "Data size is invalid.");
 			ret = 10;
 			goto end;
 		}
@@ -240,10 +380,11 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 
 	if (wadInfo.data_size > WAD_DATA_SIZE_MAX) {
 		// Maximum of 128 MB.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fprintf(stderr, "' data size is too big. (%u; should be less than 128 MB)\n",
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fprintf(f_err, "' data size is too big. (%u; should be less than 128 MB)\n",
 			wadInfo.data_size);
+		wad_status_add(status, "Data size is too big. (%u; should be less than 128 MB)", wadInfo.data_size);
 		ret = 11;
 		goto end;
 	}
@@ -251,7 +392,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	// Allocate the memory buffer.
 	buf = malloc(sizeof(*buf));
 	if (!buf) {
-		fputs("*** ERROR: Unable to allocate memory buffer.\n", stderr);
+		fputs("*** ERROR: Unable to allocate memory buffer.\n", f_err);
+		wad_status_add(status, "Unable to allocate memory buffer.");
 		ret = 12;
 		goto end;
 	}
@@ -261,9 +403,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	size = fread(buf, 1, wadInfo.ticket_size, f_src_wad);
 	if (size != wadInfo.ticket_size) {
 		// Read error.
-		fputs("*** ERROR: WAD file '", stderr);
-		_fputts(src_wad, stderr);
-		fputs("': Unable to read the ticket.\n", stderr);
+		fputs("*** ERROR: WAD file '", f_err);
+		_fputts(src_wad, f_err);
+		fputs("': Unable to read the ticket.\n", f_err);
+		wad_status_add(status, "Unable to read the ticket.");
 		ret = 13;
 		goto end;
 	}
@@ -306,9 +449,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			s_fromKey = "debug";
 			break;
 		default:
-			fputs("*** ERROR: WAD file '", stderr);
-			_fputts(src_wad, stderr);
-			fputs("': Unknown issuer.\n", stderr);
+			fputs("*** ERROR: WAD file '", f_err);
+			_fputts(src_wad, f_err);
+			fputs("': Unknown issuer.\n", f_err);
+			wad_status_add(status, "Unknown issuer.");
 			ret = 14;
 			goto end;
 	}
@@ -330,7 +474,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			default:
 				// Should not happen...
 				assert(!"src_key: Invalid cryptoType.");
-				fputs("*** ERROR: Unable to select encryption key.\n", stderr);
+				fputs("*** ERROR: Unable to select encryption key.\n", f_err);
+				wad_status_add(status, "Unable to select encryption key.");
 				ret = 15;
 				goto end;
 		}
@@ -357,7 +502,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		// Allow the same key only if converting to a different format.
 		if (isSrcBwf == isDestBwf) {
 			// No point in recrypting to the same key and format...
-			fputs("*** ERROR: Cannot recrypt to the same key and format.\n", stderr);
+			fputs("*** ERROR: Cannot recrypt to the same key and format.\n", f_err);
+			wad_status_add(status, "Cannot recrypt to the same key and format.");
 			ret = 16;
 			goto end;
 		}
@@ -387,16 +533,17 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			// Invalid key index.
 			// This should not happen...
 			assert(!"recrypt_key: Invalid key index.");
-			fputs("*** ERROR: Invalid recrypt_key value.\n", stderr);
+			fputs("*** ERROR: Invalid recrypt_key value.\n", f_err);
+			wad_status_add(status, "Invalid recrypt_key value.");
 			ret = 17;
 			goto end;
 	}
 
-	printf("Converting from %s to %s [", s_fromKey, s_toKey);
-	fputs(isSrcBwf ? "bwf" : "wad", stdout);
-	fputs("->", stdout);
-	fputs(isDestBwf ? "bwf" : "wad", stdout);
-	fputs("]...\n", stdout);
+	fprintf(f_out, "Converting from %s to %s [", s_fromKey, s_toKey);
+	fputs(isSrcBwf ? "bwf" : "wad", f_out);
+	fputs("->", f_out);
+	fputs(isDestBwf ? "bwf" : "wad", f_out);
+	fputs("]...\n", f_out);
 
 	// Open the destination WAD file.
 	errno = 0;
@@ -406,9 +553,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fputs("*** ERROR opening destination WAD file '", stderr);
-		_fputts(dest_wad, stderr);
-		fprintf(stderr, "' for write: %s\n", strerror(err));
+		fputs("*** ERROR opening destination WAD file '", f_err);
+		_fputts(dest_wad, f_err);
+		fprintf(f_err, "' for write: %s\n", strerror(err));
+		wad_status_add(status, "Error opening destination WAD file for write: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -454,7 +602,7 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (!isDestBwf) {
 			// bwf->wad
 			Wii_WAD_Header outHeader;
-			printf("Converting the BroadOn WAD header to standard WAD format...\n");
+			fprintf(f_out, "Converting the BroadOn WAD header to standard WAD format...\n");
 			data_offset = 0;
 
 			// Type is 'Is' for most WADs, 'ib' for boot2.
@@ -495,7 +643,7 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (isDestBwf) {
 			// wad->bwf
 			Wii_WAD_Header_BWF outHeader;
-			printf("Converting the standard WAD header to BroadOn WAD format...\n");
+			fprintf(f_out, "Converting the standard WAD header to BroadOn WAD format...\n");
 
 			outHeader.header_size = cpu_to_be32(sizeof(outHeader));
 			outHeader.data_offset = cpu_to_be32(data_offset);
@@ -525,7 +673,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD header: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD header: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD header: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -536,7 +685,7 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	}
 
 	// Write the certificates.
-	printf("Writing certificate chain...\n");
+	fprintf(f_out, "Writing certificate chain...\n");
 	errno = 0;
 	size = fwrite(cert_CA, 1, sizeof(*cert_CA), f_dest_wad);
 	if (size != sizeof(*cert_CA)) {
@@ -544,7 +693,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD certificate chain: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -555,7 +705,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD certificate chain: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -566,7 +717,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD certificate chain: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -578,7 +730,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			if (err == 0) {
 				err = EIO;
 			}
-			fprintf(stderr, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+			fprintf(f_err, "*** ERROR writing destination WAD certificate chain: %s\n", strerror(err));
+			wad_status_add(status, "Error writing destination WAD certificate chain: %s", strerror(err));
 			ret = -err;
 			goto end;
 		}
@@ -594,7 +747,7 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 	assert(wadInfo.crl_size == 0);
 
 	// Recrypt the ticket and TMD.
-	printf("Recrypting the ticket and TMD...\n");
+	fprintf(f_out, "Recrypting the ticket and TMD...\n");
 
 	// Ticket is already loaded, so recrypt and resign it.
 	errno = 0;
@@ -605,7 +758,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR recrypting the ticket: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR recrypting the ticket: %s\n", strerror(err));
+		wad_status_add(status, "Error recrypting the ticket: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -629,7 +783,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD ticket: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD ticket: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD ticket: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -648,7 +803,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR reading source WAD TMD: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR reading source WAD TMD: %s\n", strerror(err));
+		wad_status_add(status, "Error reading source WAD TMD: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -679,7 +835,8 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 		if (err == 0) {
 			err = EIO;
 		}
-		fprintf(stderr, "*** ERROR writing destination WAD TMD: %s\n", strerror(err));
+		fprintf(f_err, "*** ERROR writing destination WAD TMD: %s\n", strerror(err));
+		wad_status_add(status, "Error writing destination WAD TMD: %s", strerror(err));
 		ret = -err;
 		goto end;
 	}
@@ -697,92 +854,29 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			if (err == 0) {
 				err = EIO;
 			}
-			fprintf(stderr, "*** ERROR seeking in destination WAD: %s\n", strerror(err));
-			ret = -err;
-			goto end;
-		}
-	}
-
-	// Copy the data, one megabyte at a time.
-	// TODO: Show progress? (WADs are small enough that this probably isn't needed...)
-	// TODO: Check for fseeko() errors.
-	printf("Copying the WAD data...\n");
-	data_sz = wadInfo.data_size;
-	fseeko(f_src_wad, wadInfo.data_address, SEEK_SET);
-	for (; data_sz >= sizeof(buf->u8); data_sz -= sizeof(buf->u8)) {
-		errno = 0;
-		size = fread(buf->u8, 1, sizeof(buf->u8), f_src_wad);
-		if (size != sizeof(buf->u8)) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR reading source WAD data: %s\n", strerror(err));
-			ret = -err;
-			goto end;
-		}
-
-		errno = 0;
-		size = fwrite(buf->u8, 1, sizeof(buf->u8), f_dest_wad);
-		if (size != sizeof(buf->u8)) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR writing destination WAD data: %s\n", strerror(err));
+			fprintf(f_err, "*** ERROR seeking in destination WAD: %s\n", strerror(err));
+			wad_status_add(status, "Error seeking in destination WAD: %s", strerror(err));
 			ret = -err;
 			goto end;
 		}
 	}
 
-	// Remaining data.
-	if (data_sz > 0) {
-		// NOTE: AES operates with 16-byte block sizes, so we have to
-		// round data_sz up to the next 16 bytes.
-		data_sz = ALIGN_BYTES(16, data_sz);
-
-		errno = 0;
-		size = fread(buf->u8, 1, data_sz, f_src_wad);
-		if (size != data_sz) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR reading source WAD data: %s\n", strerror(err));
-			ret = -err;
-			goto end;
-		}
-
-		errno = 0;
-		size = fwrite(buf->u8, 1, data_sz, f_dest_wad);
-		if (size != data_sz) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR writing destination WAD data: %s\n", strerror(err));
-			ret = -err;
-			goto end;
-		}
+	// Copy the data.
+	// NOTE: AES operates with 16-byte block sizes, so we have to
+	// round data_sz up to the next 16 bytes.
+	fprintf(f_out, "Copying the WAD data...\n");
+	data_sz = ALIGN_BYTES(16, wadInfo.data_size);
+	ret = copy_wad_section(f_dest_wad, f_src_wad, wadInfo.data_address, data_sz, buf);
+	if (ret != 0) {
+		fprintf(f_err, "*** ERROR copying WAD data: %s\n", strerror(-ret));
+		wad_status_add(status, "Error copying WAD data: %s", strerror(-ret));
+		goto end;
 	}
 
 	// Copy the metadata.
 	// FIXME: Copy before the data if the output format is BWF.
 	if (wadInfo.meta_size != 0) {
-		printf("Copying the WAD metadata...\n");
-
-		fseeko(f_src_wad, wadInfo.meta_address, SEEK_SET);
-		errno = 0;
-		size = fread(buf->u8, 1, wadInfo.meta_size, f_src_wad);
-		if (size != wadInfo.meta_size) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR reading source WAD metadata: %s\n", strerror(err));
-			ret = -err;
-			goto end;
-		}
+		fprintf(f_out, "Copying the WAD metadata...\n");
 
 		// FIXME: 64-byte alignment on BWF?
 		if (!isDestBwf) {
@@ -790,14 +884,10 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 			fpAlign(f_dest_wad);
 		}
 
-		size = fwrite(buf->u8, 1, wadInfo.meta_size, f_dest_wad);
-		if (size != wadInfo.meta_size) {
-			int err = errno;
-			if (err == 0) {
-				err = EIO;
-			}
-			fprintf(stderr, "*** ERROR writing destination WAD metadata: %s\n", strerror(err));
-			ret = -err;
+		ret = copy_wad_section(f_dest_wad, f_src_wad, wadInfo.meta_address, wadInfo.meta_size, buf);
+		if (ret != 0) {
+			fprintf(f_err, "*** ERROR copying WAD metadata: %s\n", strerror(-ret));
+			wad_status_add(status, "Error copying WAD metadata: %s", strerror(-ret));
 			goto end;
 		}
 	}
@@ -822,14 +912,15 @@ int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int
 				if (err == 0) {
 					err = EIO;
 				}
-				fprintf(stderr, "*** ERROR writing destination WAD padding: %s\n", strerror(err));
+				fprintf(f_err, "*** ERROR writing destination WAD padding: %s\n", strerror(err));
+				wad_status_add(status, "Error writing destination WAD padding: %s", strerror(err));
 				ret = -err;
 				goto end;
 			}
 		}
 	}
 
-	printf("WAD resigning complete.\n");
+	fprintf(f_out, "WAD resigning complete.\n");
 	ret = 0;
 
 end:
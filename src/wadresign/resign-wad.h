@@ -10,7 +10,9 @@
 #define __RVTHTOOL_WADRESIGN_RESIGN_WAD_H__
 
 #include "tcharx.h"
+#include "wad-fns.h"
 #include <stdint.h>
+#include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,9 +32,13 @@ typedef enum {
  * @param dest_wad	[in] Destination WAD.
  * @param recrypt_key	[in] Key for recryption. (-1 for default)
  * @param output_format	[in] Output format. (-1 for default)
+ * @param f_out		[in] Output stream. (usually stdout)
+ * @param f_err		[in] Error stream. (usually stderr)
+ * @param status	[out,opt] WAD status. (Error messages are added here.)
  * @return 0 on success; negative POSIX error code or positive ID code on error.
  */
-int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int output_format);
+int resign_wad(const TCHAR *src_wad, const TCHAR *dest_wad, int recrypt_key, int output_format,
+	FILE *f_out, FILE *f_err, WAD_Status_t *status);
 
 #ifdef __cplusplus
 }
@@ -11,6 +11,11 @@
 #include "libwiicrypto/byteswap.h"
 #include "libwiicrypto/common.h"
 
+// C includes.
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
 /**
  * Get WAD info for a standard WAD file.
  * @param pWadHeader	[in] WAD header.
@@ -113,3 +118,33 @@ int getWadInfo_BWF(const Wii_WAD_Header_BWF *pWadHeader, WAD_Info_t *pWadInfo)
 	pWadInfo->data_size = 0;
 	return 0;
 }
+
+/**
+ * Add an error message to a WAD status.
+ * If the status already has messages, the new message is appended.
+ * @param status	[in,out,opt] WAD status. (If NULL, nothing is done.)
+ * @param fmt		[in] printf()-style format string.
+ */
+void wad_status_add(WAD_Status_t *status, const char *fmt, ...)
+{
+	va_list ap;
+	size_t len;
+
+	if (!status) {
+		return;
+	}
+
+	len = strlen(status->message);
+	if (len > 0) {
+		if (len + 2 >= sizeof(status->message)) {
+			// No space left.
+			return;
+		}
+		memcpy(&status->message[len], "; ", 3);
+		len += 2;
+	}
+
+	va_start(ap, fmt);
+	vsnprintf(&status->message[len], sizeof(status->message) - len, fmt, ap);
+	va_end(ap);
+}
@@ -32,6 +32,18 @@ extern "C" {
 // Maximum metadata size supported by wadresign.
 #define WAD_META_SIZE_MAX (1024*1024)
 
+// Maximum length of a WAD status message.
+#define WAD_STATUS_MESSAGE_MAX 1024
+
+/**
+ * WAD processing status.
+ * Error messages are collected here so batch processing
+ * can summarize them without parsing the output.
+ */
+typedef struct _WAD_Status_t {
+	char message[WAD_STATUS_MESSAGE_MAX];	// Error messages, separated by "; ". (empty if none)
+} WAD_Status_t;
+
 /**
  * Struct of WAD section addresses and sizes.
  * Parsed from the WAD header.
@@ -67,6 +79,14 @@ int getWadInfo(const Wii_WAD_Header *pWadHeader, WAD_Info_t *pWadInfo);
  */
 int getWadInfo_BWF(const Wii_WAD_Header_BWF *pWadHeader, WAD_Info_t *pWadInfo);
 
+/**
+ * Add an error message to a WAD status.
+ * If the status already has messages, the new message is appended.
+ * @param status	[in,out,opt] WAD status. (If NULL, nothing is done.)
+ * @param fmt		[in] printf()-style format string.
+ */
+void wad_status_add(WAD_Status_t *status, const char *fmt, ...);
+
 #ifdef __cplusplus
 }
 #endif